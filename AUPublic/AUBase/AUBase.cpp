@@ -10,25 +10,15 @@ Part of Core Audio AUBase Classes
 #include "AUDispatch.h"
 #include "AUInputElement.h"
 #include "AUOutputElement.h"
+#include "AUSignpost.h"
 #include <algorithm>
 #include <syslog.h>
 #include "CAAudioChannelLayout.h"
+#include "CADenormalGuard.h"
 #include "CAHostTimeBase.h"
 #include "CAVectorUnit.h"
 #include "CAXException.h"
 
-#if TARGET_OS_MAC && (TARGET_CPU_X86 || TARGET_CPU_X86_64)
-	// our compiler does ALL floating point with SSE
-	inline int  GETCSR ()    { int _result; asm volatile ("stmxcsr %0" : "=m" (*&_result) ); return _result; }
-	inline void SETCSR (int a)    { int _temp = a; asm volatile( "ldmxcsr %0" : : "m" (*&_temp ) ); }
-
-	#define DISABLE_DENORMALS int _savemxcsr = GETCSR(); SETCSR(_savemxcsr | 0x8040);
-	#define RESTORE_DENORMALS SETCSR(_savemxcsr);
-#else
-	#define DISABLE_DENORMALS
-	#define RESTORE_DENORMALS
-#endif
-
 static bool sAUBaseCFStringsInitialized = false;
 // this is used for the presets
 static CFStringRef kUntitledString = NULL;
@@ -43,6 +33,7 @@ static CFStringRef kRenderQualityString = NULL;
 static CFStringRef kCPULoadString = NULL;
 static CFStringRef kElementNameString = NULL;
 static CFStringRef kPartString = NULL;
+static CFStringRef kBinaryStateString = NULL;
 
 SInt32 AUBase::sVectorUnitType = kVecUninitialized;
 
@@ -63,12 +54,14 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 	mRenderCallbacksTouched(false),
 	mRenderThreadID (NULL),
 	mWantsRenderThreadID (false),
+	mDenormalProtection (true),
 	mLastRenderError(0),
 	mUsesFixedBlockSize(false),
 	mBuffersAllocated(false),
 	mLogString (NULL),
     mNickName (NULL),
-	mAUMutex(NULL)
+	mAUMutex(NULL),
+	mRealtimeMutex(NULL)
 	#if !CA_NO_AU_UI_FEATURES
 		,
 		mContextName(NULL)
@@ -89,6 +82,7 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 		kCPULoadString = CFSTR(kAUPresetCPULoadKey);
 		kElementNameString = CFSTR(kAUPresetElementNameKey);
 		kPartString = CFSTR(kAUPresetPartKey);
+		kBinaryStateString = CFSTR(kAUBinaryStateKey);
 		sAUBaseCFStringsInitialized = true;
 	}
 
@@ -122,6 +116,7 @@ AUBase::~AUBase()
 #endif
 	if (mLogString) delete [] mLogString;
     if (mNickName) CFRelease(mNickName);
+	delete mRealtimeMutex;
 }
 
 //_____________________________________________________________________________
@@ -1085,6 +1080,30 @@ OSStatus			AUBase::GetPropertyInfo(		AudioUnitPropertyID				inID,
 													UInt32 &						outDataSize,
 													Boolean &						outWritable)
 {
+	if (inScope == kAudioUnitScope_Global) {
+		switch (inID) {
+		case kAudioUnitCustomProperty_RenderTiming:
+			outDataSize = sizeof(AURenderTimingStatistics);
+			outWritable = true;
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTimingThreshold:
+			outDataSize = sizeof(Float32);
+			outWritable = true;
+			return noErr;
+		case kAudioUnitCustomProperty_DenormalProtection:
+		case kAudioUnitCustomProperty_RenderTraceDump:
+		case kAudioUnitCustomProperty_RenderTraceOnOverrun:
+			outDataSize = sizeof(UInt32);
+			outWritable = true;
+			return noErr;
+		case kAudioUnitCustomProperty_MutexStatistics:
+			if (mRealtimeMutex == NULL)
+				break;
+			outDataSize = sizeof(AURealtimeMutexStatistics);
+			outWritable = true;
+			return noErr;
+		}
+	}
 	return kAudioUnitErr_InvalidProperty;
 }
 
@@ -1096,6 +1115,30 @@ OSStatus			AUBase::GetProperty(			AudioUnitPropertyID 			inID,
 													AudioUnitElement			 	inElement,
 													void *							outData)
 {
+	if (inScope == kAudioUnitScope_Global) {
+		switch (inID) {
+		case kAudioUnitCustomProperty_RenderTiming:
+			mRenderTiming.GetStatistics(*(AURenderTimingStatistics *)outData);
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTimingThreshold:
+			*(Float32 *)outData = mRenderTiming.OverrunThreshold();
+			return noErr;
+		case kAudioUnitCustomProperty_DenormalProtection:
+			*(UInt32 *)outData = mDenormalProtection;
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTraceDump:
+			*(UInt32 *)outData = mRenderTrace.NumDumps();
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTraceOnOverrun:
+			*(UInt32 *)outData = mRenderTrace.DumpsOnOverrun();
+			return noErr;
+		case kAudioUnitCustomProperty_MutexStatistics:
+			if (mRealtimeMutex == NULL)
+				break;
+			mRealtimeMutex->GetStatistics(*(AURealtimeMutexStatistics *)outData);
+			return noErr;
+		}
+	}
 	return kAudioUnitErr_InvalidProperty;
 }
 
@@ -1108,6 +1151,41 @@ OSStatus			AUBase::SetProperty(			AudioUnitPropertyID 			inID,
 													const void *					inData,
 													UInt32 							inDataSize)
 {
+	if (inScope == kAudioUnitScope_Global) {
+		switch (inID) {
+		case kAudioUnitCustomProperty_RenderTiming:
+			mRenderTiming.Reset();
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTimingThreshold:
+		{
+			if (inDataSize < sizeof(Float32))
+				return kAudioUnitErr_InvalidPropertyValue;
+			Float32 threshold = *(const Float32 *)inData;
+			if (!(threshold > 0.f))
+				return kAudioUnitErr_InvalidPropertyValue;
+			mRenderTiming.SetOverrunThreshold(threshold);
+			return noErr;
+		}
+		case kAudioUnitCustomProperty_DenormalProtection:
+			if (inDataSize < sizeof(UInt32))
+				return kAudioUnitErr_InvalidPropertyValue;
+			SetDenormalProtection(*(const UInt32 *)inData != 0);
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTraceDump:
+			mRenderTrace.RequestDump();
+			return noErr;
+		case kAudioUnitCustomProperty_RenderTraceOnOverrun:
+			if (inDataSize < sizeof(UInt32))
+				return kAudioUnitErr_InvalidPropertyValue;
+			mRenderTrace.SetDumpsOnOverrun(*(const UInt32 *)inData != 0);
+			return noErr;
+		case kAudioUnitCustomProperty_MutexStatistics:
+			if (mRealtimeMutex == NULL)
+				break;
+			mRealtimeMutex->ResetStatistics();
+			return noErr;
+		}
+	}
 	return kAudioUnitErr_InvalidProperty;
 }
 
@@ -1372,6 +1450,17 @@ void				AUBase::SetWantsRenderThreadID (bool inFlag)
 		mRenderThreadID = NULL;
 }
 
+//_____________________________________________________________________________
+//
+void				AUBase::UseRealtimeMutex ()
+{
+	if (mRealtimeMutex != NULL)
+		return;
+	mRealtimeMutex = new AURealtimeMutex("AUBase realtime mutex", *this);
+	mAUMutex = mRealtimeMutex;
+	SetWantsRenderThreadID(true);
+}
+
 //_____________________________________________________________________________
 //
 
@@ -1385,11 +1474,13 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 {
 	OSStatus theError;
 	RenderCallbackList::iterator rcit;
+	UInt64 renderStart = CAHostTimeBase::GetTheCurrentTime();
 	
 	AUTRACE(kCATrace_AUBaseRenderStart, mComponentInstance, (uintptr_t)this, inBusNumber, inFramesToProcess, (uintptr_t)ioData.mBuffers[0].mData);
-	DISABLE_DENORMALS
+	CADenormalGuard denormalGuard(mDenormalProtection);
 	
 	try {
+		AU_SIGNPOST_INTERVAL("Render");
 		ca_require(IsInitialized(), Uninitialized);
 		ca_require(mAudioUnitAPIVersion >= 2, ParamErr);
 		if (inFramesToProcess > mMaxFramesPerSlice) {
@@ -1440,6 +1531,8 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 			#endif
 		}
 		
+		AcquireParameterBlocks();
+		
 		AudioUnitRenderActionFlags flags;
 		if (mRenderCallbacksTouched) {
 			mRenderCallbacks.update();
@@ -1480,6 +1573,9 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		if (!mParamList.empty())
 			mParamList.clear();
 
+		UInt64 renderEnd = CAHostTimeBase::GetTheCurrentTime();
+		bool overrun = mRenderTiming.EndCycle(renderStart, renderEnd, inFramesToProcess, output->GetStreamFormat().mSampleRate, denormalGuard.Engaged());
+		mRenderTrace.EndCycle(renderStart, renderEnd, inFramesToProcess, overrun, mRenderTiming.OverrunThreshold());
 	}
 	catch (OSStatus err) {
 		theError = err;
@@ -1490,7 +1586,6 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		goto errexit;
 	}
 done:	
-	RESTORE_DENORMALS
 	AUTRACE(kCATrace_AUBaseRenderEnd, mComponentInstance, (intptr_t)this, theError, ioActionFlags, CATrace_ablData(ioData));
 	
 	return theError;
@@ -1513,7 +1608,7 @@ OSStatus	AUBase::DoProcess (	AudioUnitRenderActionFlags  &		ioActionFlags,
 {
 	OSStatus theError;
 	AUTRACE(kCATrace_AUBaseRenderStart, mComponentInstance, (intptr_t)this, -1, inFramesToProcess, 0);
-	DISABLE_DENORMALS
+	CADenormalGuard denormalGuard(mDenormalProtection);
 
 	try {		
 	
@@ -1559,6 +1654,8 @@ OSStatus	AUBase::DoProcess (	AudioUnitRenderActionFlags  &		ioActionFlags,
 			#endif
 		}
 		
+		AcquireParameterBlocks();
+		
 		if (NeedsToRender (inTimeStamp)) {
 			theError = ProcessBufferLists (ioActionFlags, ioData, ioData, inFramesToProcess);
 		} else
@@ -1574,7 +1671,6 @@ OSStatus	AUBase::DoProcess (	AudioUnitRenderActionFlags  &		ioActionFlags,
 		goto errexit;
 	}
 done:	
-	RESTORE_DENORMALS
 	AUTRACE(kCATrace_AUBaseRenderEnd, mComponentInstance, (intptr_t)this, theError, ioActionFlags, CATrace_ablData(ioData));
 	
 	return theError;
@@ -1597,7 +1693,7 @@ OSStatus	AUBase::DoProcessMultiple (	AudioUnitRenderActionFlags  & ioActionFlags
 							   AudioBufferList **					ioOutputBufferLists)
 {
 	OSStatus theError;
-	DISABLE_DENORMALS
+	CADenormalGuard denormalGuard(mDenormalProtection);
 	
 	try {
 		
@@ -1680,6 +1776,8 @@ OSStatus	AUBase::DoProcessMultiple (	AudioUnitRenderActionFlags  & ioActionFlags
 #endif
 		}
 		
+		AcquireParameterBlocks();
+		
 		if (NeedsToRender (inTimeStamp)) {
 			theError = ProcessMultipleBufferLists (ioActionFlags, inFramesToProcess, inNumberInputBufferLists, inInputBufferLists, inNumberOutputBufferLists, ioOutputBufferLists);
 		} else
@@ -1694,7 +1792,6 @@ OSStatus	AUBase::DoProcessMultiple (	AudioUnitRenderActionFlags  & ioActionFlags
 		goto errexit;
 	}
 done:	
-	RESTORE_DENORMALS
 	
 	return theError;
 	
@@ -1962,6 +2059,15 @@ OSStatus			AUBase::SaveState(		CFPropertyListRef * outData)
 // save all this in the data section of the dictionary
 	CFDictionarySetValue(dict, kDataString, data);
 	CFRelease (data);
+
+// fifth step -> save the unit's own state, packed, if it has any
+	AUBinaryStateWriter binaryState;
+	SaveBinaryState (binaryState);
+	CFDataRef binaryData = binaryState.CopyData();
+	if (binaryData != NULL) {
+		CFDictionarySetValue(dict, kBinaryStateString, binaryData);
+		CFRelease (binaryData);
+	}
 	
 //OK - now we're going to do some properties 	
 //save the preset name...
@@ -2075,6 +2181,13 @@ OSStatus			AUBase::RestoreState(	CFPropertyListRef	plist)
         }
 	}
 
+// fifth step -> restore the unit's own state; a blob of another version or byte order is left out,
+// and the one read stays open for the sections the unit reads later
+	mRestoredBinaryState.Close();
+	CFDataRef binaryData = reinterpret_cast<CFDataRef>(CFDictionaryGetValue (dict, kBinaryStateString));
+	if (binaryData != NULL && mRestoredBinaryState.Open(binaryData))
+		RestoreBinaryState (mRestoredBinaryState);
+
 //OK - now we're going to do some properties
 //restore the preset name...
 	CFStringRef name = reinterpret_cast<CFStringRef>(CFDictionaryGetValue (dict, kNameString));
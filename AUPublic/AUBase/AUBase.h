@@ -25,6 +25,11 @@ Part of Core Audio AUBase Classes
 #include "AUInputElement.h"
 #include "AUOutputElement.h"
 #include "AUBuffer.h"
+#include "AURenderTiming.h"
+#include "AURenderTrace.h"
+#include "AUBinaryState.h"
+#include "AUParameterBlock.h"
+#include "AURealtimeMutex.h"
 #include "CAMath.h"
 #include "CAThreadSafeList.h"
 #include "CAVectorUnit.h"
@@ -354,6 +359,16 @@ public:
     /*! @method SaveExtendedScopes */
 	virtual void                SaveExtendedScopes(		CFMutableDataRef				outData) {};
 
+	/*! @method SaveBinaryState */
+	// adds the unit's own state to the packed blob SaveState() stores beside the parameters (see
+	// AUBinaryState.h); nothing by default, and a state with no sections stores no blob
+	virtual void				SaveBinaryState(		AUBinaryStateWriter &			ioWriter) {}
+
+	/*! @method RestoreBinaryState */
+	// called by RestoreState() after the parameters, with the state's blob if it has one this build
+	// can read
+	virtual void				RestoreBinaryState(		const AUBinaryStateReader &		inReader) {}
+
 	/*! @method RestoreState */
 	virtual OSStatus			RestoreState(			CFPropertyListRef				inData);
 
@@ -746,6 +761,20 @@ protected:
 	/*! @method SetWantsRenderThreadID */
 	void						SetWantsRenderThreadID (bool inFlag);
 	
+	/*! @method UseRealtimeMutex */
+	// gives the unit an AURealtimeMutex as its mutex, which the render thread only ever tries, and
+	// has it note its render thread; call from the constructor
+	void						UseRealtimeMutex ();
+	
+	/*! @method DenormalProtection */
+	bool						DenormalProtection () const { return mDenormalProtection; }
+	
+	/*! @method SetDenormalProtection */
+	// whether DoRender, DoProcess and DoProcessMultiple flush denormals to zero for the length of the
+	// call (see CADenormalGuard); on by default, and also set through
+	// kAudioUnitCustomProperty_DenormalProtection
+	void						SetDenormalProtection (bool inFlag) { mDenormalProtection = inFlag; }
+	
 	/*! @method SetRenderError */
 	OSStatus					SetRenderError (OSStatus inErr)
 	{
@@ -786,6 +815,14 @@ private:
 		return result;
 	}
 
+	/*! @method AcquireParameterBlocks */
+	void						AcquireParameterBlocks ()
+	{
+		for (size_t i = 0; i < mParameterBlocks.size(); ++i)
+			if (mParameterBlocks[i]->Acquire())
+				ParameterBlockChanged(*mParameterBlocks[i]);
+	}
+
 	/*! @method HasIcon */
 	bool						HasIcon ();
 
@@ -859,6 +896,27 @@ protected:
 	
 	/*! @method CurrentRenderTime */
 	const AudioTimeStamp &		CurrentRenderTime () const { return mCurrentRenderTime; }
+
+	/*! @method RenderTiming */
+	AURenderTiming &			RenderTiming () { return mRenderTiming; }
+
+	/*! @method RenderTrace */
+	// a subclass reports each cycle's voices, events and source to it while rendering
+	AURenderTrace &				RenderTrace () { return mRenderTrace; }
+	
+	/*! @method RestoredBinaryState */
+	// the blob of the state last restored, still open, so that a large section can be read when it is
+	// needed rather than by RestoreBinaryState(); closed if that state had none
+	const AUBinaryStateReader &	RestoredBinaryState () const { return mRestoredBinaryState; }
+	
+	/*! @method RegisterParameterBlock */
+	// adds a block whose newest version is taken at the top of every render cycle, before the
+	// pre-render notifications; register blocks from the constructor, never while rendering
+	void						RegisterParameterBlock (AUParameterBlockBase &inBlock) { mParameterBlocks.push_back(&inBlock); }
+	
+	/*! @method ParameterBlockChanged */
+	// called on the render thread for each registered block that took a new version this cycle
+	virtual void				ParameterBlockChanged (AUParameterBlockBase &inBlock) { }
 	
 	// ________________________________________________________________________
 	//	Private data members to discourage hacking in subclasses
@@ -922,17 +980,31 @@ private:
 	
 	/*! @var mWantsRenderThreadID */
 	bool						mWantsRenderThreadID;
+	
+	/*! @var mDenormalProtection */
+	bool						mDenormalProtection;
 		
 	/*! @var mCurrentRenderTime */
 	AudioTimeStamp				mCurrentRenderTime;
 	
 	/*! @var mMaxFramesPerSlice */
 	UInt32						mMaxFramesPerSlice;
+
+	/*! @var mRenderTiming */
+	AURenderTiming				mRenderTiming;
+
+	/*! @var mRenderTrace */
+	AURenderTrace				mRenderTrace;
+	
+	/*! @var mParameterBlocks */
+	std::vector<AUParameterBlockBase *>	mParameterBlocks;
 	
 	/*! @var mLastRenderError */
 	OSStatus					mLastRenderError;
 	/*! @var mCurrentPreset */
 	AUPreset					mCurrentPreset;
+	/*! @var mRestoredBinaryState */
+	AUBinaryStateReader			mRestoredBinaryState;
 	
 protected:
 	/*! @var mUsesFixedBlockSize */
@@ -964,6 +1036,10 @@ protected:
 	CAMutex *					mAUMutex;
 
 private:
+	/*! @var mRealtimeMutex */
+	// mAUMutex, if UseRealtimeMutex made it
+	AURealtimeMutex *			mRealtimeMutex;
+	
 	/*! @var sVectorUnitType */
 	static SInt32	sVectorUnitType;
 
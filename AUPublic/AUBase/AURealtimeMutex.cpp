@@ -0,0 +1,107 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AURealtimeMutex.h"
+#include "AUBase.h"
+#include "CAHostTimeBase.h"
+
+//_____________________________________________________________________________
+//
+AURealtimeMutex::AURealtimeMutex(const char *inName, const AUBase &inOwner)
+	: CAMutex(inName), mOwner(inOwner), mHoldStart(0),
+	  mNumHolds(0), mNumContendedHolds(0), mTotalHoldSeconds(0), mMaxHoldSeconds(0),
+	  mNumRenderThreadAttempts(0), mNumRenderThreadContended(0)
+{
+}
+
+//_____________________________________________________________________________
+//
+bool	AURealtimeMutex::Lock()
+{
+	bool wasLocked;
+	if (mOwner.InRenderThread()) {
+		if (!Try(wasLocked))
+			throw OSStatus(kAudioUnitErr_CannotDoInCurrentContext);
+		return wasLocked;
+	}
+	// a try first, so that only the locks that had to wait are counted as contended
+	if (CAMutex::Try(wasLocked)) {
+		if (wasLocked)
+			BeginHold();
+		return wasLocked;
+	}
+	wasLocked = CAMutex::Lock();
+	if (wasLocked) {
+		BeginHold();
+		++mNumContendedHolds;
+	}
+	return wasLocked;
+}
+
+//_____________________________________________________________________________
+//
+void	AURealtimeMutex::Unlock()
+{
+	if (mHoldStart != 0 && IsOwnedByCurrentThread()) {
+		Float64 held = CAHostTimeBase::ConvertToNanos(CAHostTimeBase::GetTheCurrentTime() - mHoldStart) * 1.0e-9;
+		mTotalHoldSeconds += held;
+		if (held > mMaxHoldSeconds)
+			mMaxHoldSeconds = held;
+		mHoldStart = 0;
+	}
+	CAMutex::Unlock();
+}
+
+//_____________________________________________________________________________
+//
+bool	AURealtimeMutex::Try(bool &outWasLocked)
+{
+	if (!mOwner.InRenderThread()) {
+		bool isFree = CAMutex::Try(outWasLocked);
+		if (outWasLocked)
+			BeginHold();
+		return isFree;
+	}
+	mNumRenderThreadAttempts.fetch_add(1, std::memory_order_relaxed);
+	bool isFree = CAMutex::Try(outWasLocked);
+	if (!isFree)
+		mNumRenderThreadContended.fetch_add(1, std::memory_order_relaxed);
+	return isFree;
+}
+
+//_____________________________________________________________________________
+//
+void	AURealtimeMutex::BeginHold()
+{
+	mHoldStart = CAHostTimeBase::GetTheCurrentTime();
+	++mNumHolds;
+}
+
+//_____________________________________________________________________________
+//
+void	AURealtimeMutex::GetStatistics(AURealtimeMutexStatistics &outStatistics) const
+{
+	outStatistics.mNumRenderThreadAttempts = mNumRenderThreadAttempts.load(std::memory_order_relaxed);
+	outStatistics.mNumRenderThreadContended = mNumRenderThreadContended.load(std::memory_order_relaxed);
+	outStatistics.mNumHolds = mNumHolds;
+	outStatistics.mNumContendedHolds = mNumContendedHolds;
+	outStatistics.mMeanHoldSeconds = mNumHolds > 0 ? mTotalHoldSeconds / mNumHolds : 0;
+	outStatistics.mMaxHoldSeconds = mMaxHoldSeconds;
+}
+
+//_____________________________________________________________________________
+//
+void	AURealtimeMutex::ResetStatistics()
+{
+	mNumRenderThreadAttempts.store(0, std::memory_order_relaxed);
+	mNumRenderThreadContended.store(0, std::memory_order_relaxed);
+	mNumHolds = mHoldStart != 0 ? 1 : 0;	// the hold under way, usually the caller's, still counts
+	mNumContendedHolds = 0;
+	mTotalHoldSeconds = 0;
+	mMaxHoldSeconds = 0;
+}
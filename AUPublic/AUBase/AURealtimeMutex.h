@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AURealtimeMutex_h__
+#define __AURealtimeMutex_h__
+
+#include "CAMutex.h"
+#include <atomic>
+
+class AUBase;
+
+typedef struct AURealtimeMutexStatistics
+{
+	UInt64					mNumRenderThreadAttempts;	// locks and tries on the render thread
+	UInt64					mNumRenderThreadContended;	// of them, found it held and went without
+	UInt64					mNumHolds;					// outermost holds off the render thread
+	UInt64					mNumContendedHolds;			// of them, had to wait for it
+	Float64					mMeanHoldSeconds;
+	Float64					mMaxHoldSeconds;
+} AURealtimeMutexStatistics;
+
+enum {
+	// read/write, global scope, units that called AUBase::UseRealtimeMutex only:
+	// AURealtimeMutexStatistics since the unit was opened or the statistics last reset; setting it,
+	// with any value, resets them
+	kAudioUnitCustomProperty_MutexStatistics			= 65624
+};
+
+/*
+	AURealtimeMutex is the unit mutex (AUBase::GetMutex) of a unit that called
+	AUBase::UseRealtimeMutex. The dispatchers take that mutex around property and state changes, and
+	around parameter calls, which a host may also make from its render thread. On the unit's render
+	thread (AUBase::InRenderThread) the mutex is only ever tried: if another thread holds it, Lock()
+	throws kAudioUnitErr_CannotDoInCurrentContext before the call does anything, so the call fails
+	and leaves the unit as it was instead of blocking the cycle. Code of the unit's own that may run
+	on either thread can use CAMutex::Tryer and keep its previous state when HasLock() is false.
+
+	Every other thread locks as usual, and the mutex times its outermost holds and counts the waits,
+	so that kAudioUnitCustomProperty_MutexStatistics shows what the render thread would run into.
+	The hold statistics are only written by the thread holding the mutex, and read under it by the
+	dispatcher; the render thread's counts are atomic.
+*/
+class AURealtimeMutex : public CAMutex
+{
+public:
+	AURealtimeMutex(const char *inName, const AUBase &inOwner);
+
+	virtual bool		Lock();
+	virtual void		Unlock();
+	virtual bool		Try(bool &outWasLocked);
+
+	// hold the mutex for either; the render thread's counts may move while they are read or reset
+	void				GetStatistics(AURealtimeMutexStatistics &outStatistics) const;
+	void				ResetStatistics();
+
+private:
+	void				BeginHold();
+
+	const AUBase &		mOwner;
+	UInt64				mHoldStart;		// host time, 0 while the render thread holds the mutex
+	UInt64				mNumHolds;
+	UInt64				mNumContendedHolds;
+	Float64				mTotalHoldSeconds;
+	Float64				mMaxHoldSeconds;
+	std::atomic<UInt64>	mNumRenderThreadAttempts;
+	std::atomic<UInt64>	mNumRenderThreadContended;
+};
+
+#endif // __AURealtimeMutex_h__
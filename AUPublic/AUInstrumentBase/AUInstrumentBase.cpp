@@ -8,6 +8,9 @@ Part of Core Audio AUInstrument Base Classes
 
 #include "AUInstrumentBase.h"
 #include "AUMIDIDefs.h"
+#include "AUSignpost.h"
+#include "CARealtimeDebugPrintf.h"
+#include <algorithm>
 
 #if DEBUG
 	#define DEBUG_PRINT 0
@@ -28,13 +31,32 @@ AUInstrumentBase::AUInstrumentBase(
 	: MusicDeviceBase(inInstance, numInputs, numOutputs, numGroups), 
 	mAbsoluteSampleFrame(0),
 	mEventQueue(kEventQueueSize),
+	mScheduledEvents(kMaxScheduledEvents),
+	mNumScheduledEvents(0),
+	mCycleEvents(kEventQueueSize + kMaxScheduledEvents),
 	mNumNotes(0),
 	mNumActiveNotes(0),
 	mMaxActiveNotes(0),
+	mShedMaxActiveNotes(0),
 	mNotes(0),
 	mNoteSize(0),
+	mSilentFramesCleared(0),
+	mEventSliceFrames(0),
+	mNumMonoBuses(1),
+	mMonoOversampling(1),
+	mRenderBlockFrames(0),
+	mBlockFrames(0),
+	mBlockFifoStart(0),
+	mBlockFifoFrames(0),
+	mBlockFifoSilent(true),
+	mDSPKernels(&CADSPKernels::Default()),
+	mQuality(kNumQualitySteps),
+	mLoadShedding(0),
+	mOutputBufferListsValid(false),
 	mInitNumPartEls(numParts)
 {
+	memset(mGlobalParameters, 0, sizeof(mGlobalParameters));
+	memset(mGlobalParameterEnds, 0, sizeof(mGlobalParameterEnds));
 #if DEBUG_PRINT
 	printf("new AUInstrumentBase\n");
 #endif
@@ -82,6 +104,7 @@ void		AUInstrumentBase::SetNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, Syn
 #endif
 	mNumNotes = inNumNotes;
 	mMaxActiveNotes = inMaxActiveNotes;
+	mShedMaxActiveNotes = std::max(inMaxActiveNotes - inMaxActiveNotes / 4, 1U);
 	mNoteSize = inNoteDataSize;
 	mNotes = inNotes;
 	
@@ -91,8 +114,35 @@ void		AUInstrumentBase::SetNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, Syn
 			note->Reset();
 			mFreeNotes.AddNote(note);
 	}
+	
+	// size the groups' render scratch for these notes, off the render thread
+	UInt32 numGroups = Groups().GetNumberOfElements();
+	for (UInt32 j = 0; j < numGroups; ++j)
+	{
+		SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
+		group->PrepareToRender(GetMaxFramesPerSlice() * mMonoOversampling, mNumNotes, mNumMonoBuses);
+	}
 }
 
+void		AUInstrumentBase::SetVoiceRenderWorkers(UInt32 inNumWorkers)
+{
+	// the workers render the mono notes, at the oversampled rate
+	mRenderWorkers.Start(inNumWorkers, GetMaxFramesPerSlice() * mMonoOversampling,
+						 GetOutput(0)->GetStreamFormat().mSampleRate * mMonoOversampling);
+#if DEBUG_PRINT_RENDER
+	CARealtimeDebugPrintf::Reserve(mRenderWorkers.NumSlots());
+#endif
+}
+
+void		AUInstrumentBase::MixMonoBuses(AudioBufferList &ioBus, const Float32 *const *inBuses, UInt32 inNumBuses,
+										   UInt32 inNumberFrames)
+{
+	for (UInt32 bus = 0; bus < inNumBuses; ++bus)
+		if (inBuses[bus] != NULL)
+			SynthGroupElement::MixMonoIntoBus(*mDSPKernels, ioBus, inBuses[bus], inNumberFrames);
+}
+
+
 UInt32		AUInstrumentBase::CountActiveNotes()
 {
 	// debugging tool.
@@ -110,7 +160,7 @@ void		AUInstrumentBase::AddFreeNote(SynthNote* inNote)
 {
 	// Fast-released notes are already considered inactive and have already decr'd the active count
 	if (inNote->GetState() < kNoteState_FastReleased) {
-		DecNumActiveNotes();
+		NoteInactive(inNote);
 	}
 #if DEBUG_PRINT_NOTE
 	else {
@@ -118,7 +168,15 @@ void		AUInstrumentBase::AddFreeNote(SynthNote* inNote)
 	}
 	printf("AUInstrumentBase::AddFreeNote (%p)  mNumActiveNotes %lu\n", inNote, mNumActiveNotes);
 #endif
-	mFreeNotes.AddNote(inNote);
+	FreeNotesFor(inNote).AddNote(inNote);
+}
+
+// a note stops counting against the polyphony, its part's included
+void		AUInstrumentBase::NoteInactive(SynthNote* inNote)
+{
+	DecNumActiveNotes();
+	if (SynthPartElement *part = NotePart(inNote))
+		--part->mNumActiveNotes;
 }
 
 OSStatus			AUInstrumentBase::Initialize()
@@ -138,13 +196,107 @@ TO DO:
 	// override to call SetNotes
 	
 	mNoteIDCounter = 128; // reset this every time we initialise
+#if DEBUG_PRINT_RENDER
+	// the render thread's log ring, made here so that its first DebugPrintfRT doesn't allocate
+	CARealtimeDebugPrintf::Reserve(1);
+#endif
 	mAbsoluteSampleFrame = 0;
+	mSilentTimeout.Reset();
+	mSilentFramesCleared = 0;	// the output buffers may have been reallocated
+	mDSPKernels = &CADSPKernels::ForVectorUnit(GetVectorUnitType());
+	mQuality.Reset();
+	RenderTiming().RecordQualityLevel(0);
+	
+	// the render blocks must fit the groups' scratch, which is sized for the maximum frames per slice
+	mBlockFrames = mRenderBlockFrames;
+	while (mBlockFrames > GetMaxFramesPerSlice())
+		mBlockFrames >>= 1;
+	size_t fifoFloats = 0, numBuffers = 0;
+	for (UInt32 j = 0; j < Outputs().GetNumberOfElements(); ++j)
+	{
+		const CAStreamBasicDescription &format = GetOutput(j)->GetStreamFormat();
+		numBuffers += format.NumberChannelStreams();
+		fifoFloats += size_t(format.NumberChannelStreams()) * mBlockFrames * (format.mBytesPerFrame / sizeof(Float32));
+	}
+	mBlockFifo.assign(fifoFloats, 0.f);
+	mBlockOutputData.assign(numBuffers, NULL);
+	mBlockFifoStart = mBlockFifoFrames = 0;
+	mBlockFifoSilent = true;
+	
+	// the parameters are all defined by now; find the ones the snapshot carries
+	AUElement *globals = Globals();
+	std::vector<AudioUnitParameterID> ids(globals->GetNumberOfParameters());
+	if (!ids.empty())
+		globals->GetParameterList(&ids[0]);
+	mSnapshotParameterIDs.clear();
+	for (size_t i = 0; i < ids.size(); ++i)
+		if (ids[i] < kMaxSnapshotParameters)
+			mSnapshotParameterIDs.push_back(ids[i]);
+	SnapshotGlobalParameters();
 	return noErr;
 }
 
+void				AUInstrumentBase::SnapshotGlobalParameters(UInt32 inNumberFrames, UInt32 inOffsetFrames)
+{
+	AUElement *globals = Globals();
+	for (size_t i = 0; i < mSnapshotParameterIDs.size(); ++i)
+	{
+		AudioUnitParameterID paramID = mSnapshotParameterIDs[i];
+		mGlobalParameters[paramID] = mGlobalParameterEnds[paramID] = globals->GetParameter(paramID);
+	}
+	
+	// ScheduleParameter() has already applied the immediate events. A ramp gives its value on frame
+	// 0 as the start, if it has begun by then, and its value at the end of the buffer as the end; a
+	// later ramp overrides an earlier one. The parameter is left at the end value for the next call.
+	// A render block is a buffer of its own, inOffsetFrames into the host's.
+	for (size_t i = 0; i < mParamList.size(); ++i)
+	{
+		const AudioUnitParameterEvent &event = mParamList[i];
+		if (event.eventType != kParameterEvent_Ramped)
+			continue;
+		SInt32 rampStart = event.eventValues.ramp.startBufferOffset - SInt32(inOffsetFrames);
+		UInt32 duration = event.eventValues.ramp.durationInFrames;
+		if (rampStart >= SInt32(inNumberFrames) || rampStart + SInt64(duration) <= 0)
+			continue;
+		Float32 from = event.eventValues.ramp.startValue, to = event.eventValues.ramp.endValue;
+		Float32 perFrame = duration ? (to - from) / Float32(duration) : 0.f;
+		SInt64 endFrame = std::min(SInt64(inNumberFrames), rampStart + SInt64(duration));
+		Float32 endValue = from + perFrame * Float32(endFrame - rampStart);
+		
+		AUElement *element = GetElement(event.scope, event.element);
+		if (!element) continue;
+		element->SetParameter(event.parameter, endValue);
+		if (event.scope == kAudioUnitScope_Global && event.element == 0 && event.parameter < kMaxSnapshotParameters)
+		{
+			if (rampStart <= 0)
+				mGlobalParameters[event.parameter] = from - perFrame * Float32(rampStart);
+			mGlobalParameterEnds[event.parameter] = endValue;
+		}
+	}
+}
+
+void				AUInstrumentBase::ReallocateBuffers()
+{
+	MusicDeviceBase::ReallocateBuffers();
+	UInt32 numGroups = Groups().GetNumberOfElements();
+	mGroupElements.resize(numGroups);
+	for (UInt32 j = 0; j < numGroups; ++j)
+		mGroupElements[j] = (SynthGroupElement*)Groups().GetElement(j);
+	UInt32 numOutputs = Outputs().GetNumberOfElements();
+	mOutputElements.resize(numOutputs);
+	for (UInt32 j = 0; j < numOutputs; ++j)
+		mOutputElements[j] = GetOutput(j);
+	mOutputBufferLists.assign(numOutputs, NULL);
+	mOutputBufferListsValid = false;
+	mSilentFramesCleared = 0;
+}
+
 void				AUInstrumentBase::Cleanup()
 {
+	mRenderWorkers.Stop();
 	mFreeNotes.Empty();
+	for (UInt32 i = 0; i < Parts().GetNumberOfElements(); ++i)
+		reinterpret_cast<SynthPartElement*>(Parts().GetElement(i))->mFreeNotes.Empty();
 }
 
 
@@ -158,16 +310,26 @@ OSStatus			AUInstrumentBase::Reset(			AudioUnitScope 					inScope,
 	{
 		// kill all notes..
 		mFreeNotes.Empty();
+		for (UInt32 i = 0; i < Parts().GetNumberOfElements(); ++i)
+		{
+			SynthPartElement *part = reinterpret_cast<SynthPartElement*>(Parts().GetElement(i));
+			part->mFreeNotes.Empty();
+			part->mNumActiveNotes = 0;
+		}
 		for (UInt32 i=0; i<mNumNotes; ++i)
 		{
 			SynthNote *note = GetNote(i);
 			if (note->IsSounding()) 
 				note->Kill(0);
 			note->ListRemove();
-			mFreeNotes.AddNote(note);
+			FreeNotesFor(note).AddNote(note);
 		}
 		mNumActiveNotes = 0;
 		mAbsoluteSampleFrame = 0;
+		mSilentTimeout.Reset();
+		mSilentFramesCleared = 0;
+		mBlockFifoStart = mBlockFifoFrames = 0;
+		mBlockFifoSilent = true;
 
 		// empty lists.
 		UInt32 numGroups = Groups().GetNumberOfElements();
@@ -183,57 +345,98 @@ OSStatus			AUInstrumentBase::Reset(			AudioUnitScope 					inScope,
 void		AUInstrumentBase::PerformEvents(const AudioTimeStamp& inTimeStamp)
 {
 #if DEBUG_PRINT_RENDER
-	printf("AUInstrumentBase::PerformEvents\n");
+	DebugPrintfRT("AUInstrumentBase::PerformEvents");
 #endif
-	SynthEvent *event;
-	SynthGroupElement *group;
-	
-	while ((event = mEventQueue.ReadItem()) != NULL)
+	AU_SIGNPOST_INTERVAL("PerformEvents");
+	// take everything queued so far with one acquire, and hand it all back with one release
+	UInt32 numEvents = mEventQueue.ReadableItems();
+	for (UInt32 i = 0; i < numEvents; ++i)
 	{
+		SynthEvent *event = mEventQueue.ReadItemAt(i);
+		PerformEvent(event, event->GetOffsetSampleFrame());
+	}
+	if (numEvents)
+		mEventQueue.AdvanceReadPtr(numEvents);
+	for (UInt32 i = 0; i < mNumScheduledEvents; ++i)
+		PerformEvent(&mScheduledEvents[i], mScheduledEvents[i].GetOffsetSampleFrame());
+	RenderTrace().AddEvents(numEvents + mNumScheduledEvents);
+}
+
+bool		AUInstrumentBase::ScheduleEvent(UInt32 inEventType, MusicDeviceGroupID inGroupID, NoteInstanceID inNoteID,
+											UInt32 inOffsetSampleFrame, const MusicDeviceNoteParams *inParams)
+{
+	if (mNumScheduledEvents == kMaxScheduledEvents || (inParams && inParams->argCount > 3))
+		return false;
+	if (mNumScheduledEvents)
+		inOffsetSampleFrame = std::max(inOffsetSampleFrame, mScheduledEvents[mNumScheduledEvents - 1].GetOffsetSampleFrame());
+	mScheduledEvents[mNumScheduledEvents++].Set(inEventType, inGroupID, inNoteID, inOffsetSampleFrame, inParams);
+	return true;
+}
+
+// lays the first inNumQueued events of the queue and the scheduled ones out in mCycleEvents, merged by
+// offset, each keeping its own order; returns how many there are in all
+UInt32		AUInstrumentBase::MergeScheduledEvents(UInt32 inNumQueued)
+{
+	if (mNumScheduledEvents == 0)
+		return inNumQueued;
+	UInt32 queued = 0, scheduled = 0, numEvents = 0;
+	while (queued < inNumQueued || scheduled < mNumScheduledEvents)
+	{
+		if (scheduled == mNumScheduledEvents || (queued < inNumQueued
+				&& mEventQueue.ReadItemAt(queued)->GetOffsetSampleFrame() <= mScheduledEvents[scheduled].GetOffsetSampleFrame()))
+			mCycleEvents[numEvents++] = mEventQueue.ReadItemAt(queued++);
+		else
+			mCycleEvents[numEvents++] = &mScheduledEvents[scheduled++];
+	}
+	return numEvents;
+}
+
+// inOffsetSampleFrame is the event's frame in the render call (or slice) it is performed in
+void		AUInstrumentBase::PerformEvent(SynthEvent *inEvent, UInt32 inOffsetSampleFrame)
+{
 #if DEBUG_PRINT_RENDER
-		printf("event %08X %d\n", event, event->GetEventType());
+	DebugPrintfRT("event %p %d", inEvent, inEvent->GetEventType());
 #endif
-		switch(event->GetEventType())
-		{
-			case SynthEvent::kEventType_NoteOn :
-				RealTimeStartNote(GetElForGroupID (event->GetGroupID()), event->GetNoteID(),
-									event->GetOffsetSampleFrame(), *event->GetParams());
-				break;
-			case SynthEvent::kEventType_NoteOff :
-				RealTimeStopNote(event->GetGroupID(), event->GetNoteID(),
-					event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_SustainOn :
-				group = GetElForGroupID (event->GetGroupID());
-				group->SustainOn(event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_SustainOff :
-				group = GetElForGroupID (event->GetGroupID());
-				group->SustainOff(event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_SostenutoOn :
-				group = GetElForGroupID (event->GetGroupID());
-				group->SostenutoOn(event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_SostenutoOff :
-				group = GetElForGroupID (event->GetGroupID());
-				group->SostenutoOff(event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_AllNotesOff :
-				group = GetElForGroupID (event->GetGroupID());
-				group->AllNotesOff(event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_AllSoundOff :
-				group = GetElForGroupID (event->GetGroupID());
-				group->AllSoundOff(event->GetOffsetSampleFrame());
-				break;
-			case SynthEvent::kEventType_ResetAllControllers :
-				group = GetElForGroupID (event->GetGroupID());
-				group->ResetAllControllers(event->GetOffsetSampleFrame());
-				break;
-		}
-		
-		mEventQueue.AdvanceReadPtr();
+	SynthGroupElement *group;
+	
+	switch(inEvent->GetEventType())
+	{
+		case SynthEvent::kEventType_NoteOn :
+			RealTimeStartNote(GetElForGroupID (inEvent->GetGroupID()), inEvent->GetNoteID(),
+								inOffsetSampleFrame, *inEvent->GetParams());
+			break;
+		case SynthEvent::kEventType_NoteOff :
+			RealTimeStopNote(inEvent->GetGroupID(), inEvent->GetNoteID(),
+				inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_SustainOn :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->SustainOn(inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_SustainOff :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->SustainOff(inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_SostenutoOn :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->SostenutoOn(inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_SostenutoOff :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->SostenutoOff(inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_AllNotesOff :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->AllNotesOff(inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_AllSoundOff :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->AllSoundOff(inOffsetSampleFrame);
+			break;
+		case SynthEvent::kEventType_ResetAllControllers :
+			group = GetElForGroupID (inEvent->GetGroupID());
+			group->ResetAllControllers(inOffsetSampleFrame);
+			break;
 	}
 }
 
@@ -242,30 +445,295 @@ OSStatus			AUInstrumentBase::Render(   AudioUnitRenderActionFlags &	ioActionFlag
 												const AudioTimeStamp &			inTimeStamp,
 												UInt32							inNumberFrames)
 {
-	PerformEvents(inTimeStamp);
+	// turned off, the controller goes back to full quality once
+	if (mLoadShedding || mQuality.Level() != 0)
+		UpdateQuality();
+	RenderTrace().SetActiveVoices(NumActiveNotes());
+	mNumScheduledEvents = 0;
+	ScheduleRenderEvents(inTimeStamp, inNumberFrames);
+	
+	if (mBlockFrames)
+		return RenderBlocks(ioActionFlags, inTimeStamp, inNumberFrames);
+	
+	// notes read the parameters from the snapshot for the whole call
+	SnapshotGlobalParameters(inNumberFrames);
+	BeginRenderCycle(inNumberFrames);
+	
+	// sliced rendering performs the events as it reaches them
+	UInt32 numQueued = 0, numEvents = 0;
+	if (mEventSliceFrames) {
+		numQueued = mEventQueue.ReadableItems();
+		numEvents = MergeScheduledEvents(numQueued);
+		RenderTrace().AddEvents(numEvents);
+	} else
+		PerformEvents(inTimeStamp);
 
-	AUScope &outputs = Outputs();
-	UInt32 numOutputs = outputs.GetNumberOfElements();
+	// once no group has a note left in its lists the output is silent, after the latency and
+	// tail time the subclass reports
+	UInt32 numGroups = UInt32(mGroupElements.size());
+	bool silent = numEvents == 0 && !IsSoundingWithoutNotes();
+	for (UInt32 j = 0; j < numGroups && silent; ++j)
+		silent = !mGroupElements[j]->IsSounding();
+	mSilentTimeout.Process(inNumberFrames, UInt32(GetSampleRate() * (GetLatency() + GetTailTime())), silent);
+
+	PrepareOutputBuffers(inNumberFrames, silent);
+	mAbsoluteSampleFrame += inNumberFrames;
+
+	if (silent)
+	{
+		ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+		return noErr;
+	}
+
+	if (numEvents == 0)
+		return RenderSlice(inTimeStamp, 0, inNumberFrames);
+
+	// each slice starts with the events due in its first mEventSliceFrames frames and runs up to the
+	// next event's frame
+	OSStatus err = noErr;
+	UInt32 event = 0, sliceStart = 0;
+	while (sliceStart < inNumberFrames && err == noErr)
+	{
+		UInt32 sliceEnd = inNumberFrames;
+		for (; event < numEvents; ++event)
+		{
+			SynthEvent *item = CycleEvent(event);
+			UInt32 offset = item->GetOffsetSampleFrame();
+			if (offset >= sliceStart + mEventSliceFrames && offset < inNumberFrames) {
+				sliceEnd = offset;
+				break;
+			}
+			PerformEvent(item, offset > sliceStart ? offset - sliceStart : 0);
+		}
+		
+		SliceOutputBuffers(sliceStart, sliceEnd - sliceStart);
+		err = RenderSlice(inTimeStamp, sliceStart, sliceEnd - sliceStart);
+		SliceOutputBuffers(-SInt32(sliceStart), inNumberFrames);
+		sliceStart = sliceEnd;
+	}
+	// a failed slice must not lose the note-offs behind it
+	for (; event < numEvents; ++event)
+		PerformEvent(CycleEvent(event), 0);
+	mEventQueue.AdvanceReadPtr(numQueued);
+	return err;
+}
+
+// steps the quality by the last cycle's load, before anything of this one is rendered
+void				AUInstrumentBase::UpdateQuality()
+{
+	UInt32 previous = mQuality.Level();
+	if (mLoadShedding) {
+		if (!mQuality.Update(Float32(RenderTiming().LastLoad())))
+			return;
+	} else
+		mQuality.Reset();
+	UInt32 level = mQuality.Level();
+	
+	// the notes over the cut polyphony fast-release, quietest first, as voice stealing would have
+	// released them; each one steal takes leaves the active count
+	if (level >= kQualityStep_Polyphony && previous < kQualityStep_Polyphony)
+		for (UInt32 i = 0; i < mNumNotes && NumActiveNotes() > MaxActiveNotes(); ++i)
+			VoiceStealing(0, false);
+	
+	QualityLevelChanged(level);
+	RenderTiming().RecordQualityLevel(level);
+}
+
+// sizes every output for the cycle and zeroes it. A silent cycle leaves our own output buffers zeroed,
+// so the next silent cycle need not clear them again; buffers the host supplies are cleared every cycle.
+void				AUInstrumentBase::PrepareOutputBuffers(UInt32 inNumberFrames, bool inSilent)
+{
+	bool stillClear = inSilent && inNumberFrames <= mSilentFramesCleared;
+	UInt32 numOutputs = UInt32(mOutputElements.size());
 	for (UInt32 j = 0; j < numOutputs; ++j)
 	{
-		GetOutput(j)->PrepareBuffer(inNumberFrames);	// AUBase::DoRenderBus() only does this for the first output element
-		AudioBufferList& bufferList = GetOutput(j)->GetBufferList();
+		AUOutputElement *output = mOutputElements[j];
+		output->PrepareBuffer(inNumberFrames);	// AUBase::DoRenderBus() only does this for the first output element
+		if (!mOutputBufferListsValid && j < mOutputBufferLists.size())
+			mOutputBufferLists[j] = &output->GetBufferList();
+		if (stillClear && output->WillAllocateBuffer())
+			continue;
+		AudioBufferList& bufferList = output->GetBufferList();
 		for (UInt32 k = 0; k < bufferList.mNumberBuffers; ++k)
 		{
 			memset(bufferList.mBuffers[k].mData, 0, bufferList.mBuffers[k].mDataByteSize);
 		}
 	}
-	UInt32 numGroups = Groups().GetNumberOfElements();
+	mOutputBufferListsValid = numOutputs == mOutputBufferLists.size();
+	if (!inSilent)
+		mSilentFramesCleared = 0;
+	else if (!stillClear)
+		mSilentFramesCleared = inNumberFrames;
+}
+
+// renders mBlockFrames at a time. The frames of the last block that the call has no room for stay in
+// the FIFO and open the next call, which starts its own blocks after them.
+OSStatus			AUInstrumentBase::RenderBlocks(AudioUnitRenderActionFlags &ioActionFlags, const AudioTimeStamp &inTimeStamp,
+												UInt32 inNumberFrames)
+{
+	UInt32 numQueued = mEventQueue.ReadableItems();
+	UInt32 numEvents = MergeScheduledEvents(numQueued);
+	RenderTrace().AddEvents(numEvents);
+	UInt32 numGroups = UInt32(mGroupElements.size());
+	bool silent = numEvents == 0 && (mBlockFifoFrames == 0 || mBlockFifoSilent) && !IsSoundingWithoutNotes();
+	for (UInt32 j = 0; j < numGroups && silent; ++j)
+		silent = !mGroupElements[j]->IsSounding();
+	mSilentTimeout.Process(inNumberFrames, UInt32(GetSampleRate() * (GetLatency() + GetTailTime())), silent);
+
+	PrepareOutputBuffers(inNumberFrames, silent);
+	mAbsoluteSampleFrame += inNumberFrames;
+
+	if (silent)
+	{
+		UInt32 skip = std::min(mBlockFifoFrames, inNumberFrames);
+		mBlockFifoStart += skip;
+		mBlockFifoFrames -= skip;
+		ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+		return noErr;
+	}
+
+	// the frames rendered last call come first
+	UInt32 done = std::min(mBlockFifoFrames, inNumberFrames);
+	CopyFromBlockFifo(mBlockFifoStart, 0, done);
+	mBlockFifoStart += done;
+	mBlockFifoFrames -= done;
+
+	// each block starts with the events due in it, at their offset within it; an event whose frames
+	// the FIFO already holds comes at the start of the next block
+	OSStatus err = noErr;
+	UInt32 event = 0;
+	while (done < inNumberFrames && err == noErr)
+	{
+		UInt32 blockEnd = done + mBlockFrames;
+		for (; event < numEvents; ++event)
+		{
+			SynthEvent *item = CycleEvent(event);
+			UInt32 offset = item->GetOffsetSampleFrame();
+			if (offset >= blockEnd && offset < inNumberFrames)
+				break;
+			PerformEvent(item, offset > done ? std::min(offset - done, mBlockFrames - 1) : 0);
+		}
+
+		AudioTimeStamp blockTime = inTimeStamp;
+		blockTime.mSampleTime += done;
+		SnapshotGlobalParameters(mBlockFrames, done);
+		BeginRenderCycle(mBlockFrames);
+
+		if (blockEnd <= inNumberFrames)
+		{
+			SliceOutputBuffers(done, mBlockFrames);
+			err = RenderSlice(blockTime, 0, mBlockFrames);
+			SliceOutputBuffers(-SInt32(done), inNumberFrames);
+			done = blockEnd;
+			continue;
+		}
+
+		SwapBlockFifo(true, mBlockFrames);
+		err = RenderSlice(blockTime, 0, mBlockFrames);
+		SwapBlockFifo(false, inNumberFrames);
+		CopyFromBlockFifo(0, done, inNumberFrames - done);
+		mBlockFifoStart = inNumberFrames - done;
+		mBlockFifoFrames = blockEnd - inNumberFrames;
+		done = inNumberFrames;
+
+		// a silent remainder lets the next call skip rendering when nothing else sounds
+		mBlockFifoSilent = true;
+		const Float32 *buffer = mBlockFifo.empty() ? NULL : &mBlockFifo[0];
+		for (UInt32 j = 0; j < mOutputElements.size(); ++j)
+		{
+			AUOutputElement *output = mOutputElements[j];
+			UInt32 floatsPerFrame = output->GetStreamFormat().mBytesPerFrame / sizeof(Float32);
+			for (UInt32 k = 0; k < output->GetBufferList().mNumberBuffers; ++k, buffer += mBlockFrames * floatsPerFrame)
+				for (UInt32 i = mBlockFifoStart * floatsPerFrame; i < mBlockFrames * floatsPerFrame && mBlockFifoSilent; ++i)
+					mBlockFifoSilent = buffer[i] == 0.f;
+		}
+	}
+	// a failed block must not lose the note-offs behind it
+	for (; event < numEvents; ++event)
+		PerformEvent(CycleEvent(event), 0);
+	mEventQueue.AdvanceReadPtr(numQueued);
+	return err;
+}
+
+// points the outputs at the FIFO, zeroed, for a block of inNumberFrames, or back at their own buffers
+// of inNumberFrames
+void				AUInstrumentBase::SwapBlockFifo(bool inIntoFifo, UInt32 inNumberFrames)
+{
+	Float32 *buffer = mBlockFifo.empty() ? NULL : &mBlockFifo[0];
+	size_t index = 0;
+	UInt32 numOutputs = UInt32(mOutputElements.size());
+	for (UInt32 j = 0; j < numOutputs; ++j)
+	{
+		AUOutputElement *output = mOutputElements[j];
+		UInt32 bytesPerFrame = output->GetStreamFormat().mBytesPerFrame;
+		AudioBufferList &bufferList = output->GetBufferList();
+		for (UInt32 k = 0; k < bufferList.mNumberBuffers && index < mBlockOutputData.size(); ++k, ++index)
+		{
+			if (inIntoFifo) {
+				mBlockOutputData[index] = bufferList.mBuffers[k].mData;
+				bufferList.mBuffers[k].mData = buffer;
+				memset(buffer, 0, inNumberFrames * bytesPerFrame);
+			} else
+				bufferList.mBuffers[k].mData = mBlockOutputData[index];
+			bufferList.mBuffers[k].mDataByteSize = inNumberFrames * bytesPerFrame;
+			buffer += mBlockFrames * (bytesPerFrame / sizeof(Float32));
+		}
+	}
+}
+
+void				AUInstrumentBase::CopyFromBlockFifo(UInt32 inFifoStart, UInt32 inOutputStart, UInt32 inNumFrames)
+{
+	if (inNumFrames == 0)
+		return;
+	const Float32 *buffer = &mBlockFifo[0];
+	UInt32 numOutputs = UInt32(mOutputElements.size());
+	for (UInt32 j = 0; j < numOutputs; ++j)
+	{
+		AUOutputElement *output = mOutputElements[j];
+		UInt32 bytesPerFrame = output->GetStreamFormat().mBytesPerFrame;
+		AudioBufferList &bufferList = output->GetBufferList();
+		for (UInt32 k = 0; k < bufferList.mNumberBuffers; ++k)
+		{
+			memcpy((char *)bufferList.mBuffers[k].mData + inOutputStart * bytesPerFrame,
+					(const char *)buffer + inFifoStart * bytesPerFrame, inNumFrames * bytesPerFrame);
+			buffer += mBlockFrames * (bytesPerFrame / sizeof(Float32));
+		}
+	}
+}
+
+OSStatus			AUInstrumentBase::RenderSlice(const AudioTimeStamp &inTimeStamp, UInt32 inOffsetFrames, UInt32 inNumFrames)
+{
+	BeginRenderSlice(inOffsetFrames, inNumFrames);
+	AUScope &outputs = Outputs();
+	UInt32 numGroups = UInt32(mGroupElements.size());
 	for (UInt32 j = 0; j < numGroups; ++j)
 	{
-		SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
-		OSStatus err = group->Render((SInt64)inTimeStamp.mSampleTime, inNumberFrames, outputs);
+		SynthGroupElement *group = mGroupElements[j];
+		OSStatus err = group->Render((SInt64)inTimeStamp.mSampleTime + inOffsetFrames, inNumFrames, outputs);
 		if (err) return err;
 	}
-	mAbsoluteSampleFrame += inNumberFrames;
+	EndRenderSlice(inOffsetFrames, inNumFrames);
 	return noErr;
 }
 
+// moves every output's buffers inMoveFrames on and sizes them to inNumFrames, so the groups render
+// a slice as if it were a whole buffer
+void				AUInstrumentBase::SliceOutputBuffers(SInt32 inMoveFrames, UInt32 inNumFrames)
+{
+	UInt32 numOutputs = UInt32(mOutputElements.size());
+	for (UInt32 j = 0; j < numOutputs; ++j)
+	{
+		AUOutputElement *output = mOutputElements[j];
+		UInt32 bytesPerFrame = output->GetStreamFormat().mBytesPerFrame;
+		AudioBufferList &bufferList = output->GetBufferList();
+		for (UInt32 k = 0; k < bufferList.mNumberBuffers; ++k)
+		{
+			bufferList.mBuffers[k].mData = (char *)bufferList.mBuffers[k].mData + inMoveFrames * SInt32(bytesPerFrame);
+			bufferList.mBuffers[k].mDataByteSize = inNumFrames * bytesPerFrame;
+		}
+	}
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	AUInstrumentBase::ValidFormat
 //
@@ -294,6 +762,48 @@ bool				AUInstrumentBase::StreamFormatWritable(	AudioUnitScope					scope,
 	return IsInitialized() ? false : true;
 }
 
+OSStatus			AUInstrumentBase::GetPropertyInfo(		AudioUnitPropertyID				inID,
+															AudioUnitScope					inScope,
+															AudioUnitElement				inElement,
+															UInt32 &						outDataSize,
+															Boolean &						outWritable)
+{
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LoadShedding) {
+		outDataSize = sizeof(UInt32);
+		outWritable = true;
+		return noErr;
+	}
+	return MusicDeviceBase::GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
+}
+
+OSStatus			AUInstrumentBase::GetProperty(			AudioUnitPropertyID 			inID,
+															AudioUnitScope 					inScope,
+															AudioUnitElement			 	inElement,
+															void *							outData)
+{
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LoadShedding) {
+		*(UInt32 *)outData = mLoadShedding;
+		return noErr;
+	}
+	return MusicDeviceBase::GetProperty(inID, inScope, inElement, outData);
+}
+
+// takes effect at the next render cycle, which also owns the controller's state
+OSStatus			AUInstrumentBase::SetProperty(			AudioUnitPropertyID 			inID,
+															AudioUnitScope 					inScope,
+															AudioUnitElement 				inElement,
+															const void *					inData,
+															UInt32 							inDataSize)
+{
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LoadShedding) {
+		if (inDataSize < sizeof(UInt32))
+			return kAudioUnitErr_InvalidPropertyValue;
+		mLoadShedding = *(const UInt32 *)inData != 0;
+		return noErr;
+	}
+	return MusicDeviceBase::SetProperty(inID, inScope, inElement, inData, inDataSize);
+}
+
 OSStatus			AUInstrumentBase::RealTimeStartNote(	SynthGroupElement 			*inGroup,
 															NoteInstanceID 				inNoteInstanceID, 
 															UInt32 						inOffsetSampleFrame, 
@@ -500,6 +1010,90 @@ OSStatus	AUInstrumentBase::SendPedalEvent(MusicDeviceGroupID inGroupID, UInt32 i
 	return noErr;
 }
 
+// the event a MIDI message puts in the queue, as StartNote(), StopNote() and SendPedalEvent() put it
+// there, or 0 for a message handled without the queue
+static UInt32	QueuedEventType(const AUMIDIEvent &inEvent)
+{
+	switch (inEvent.mStatus)
+	{
+		case kMidiMessage_NoteOn :
+			return inEvent.mData2 ? SynthEvent::kEventType_NoteOn : SynthEvent::kEventType_NoteOff;
+		case kMidiMessage_NoteOff :
+			return SynthEvent::kEventType_NoteOff;
+		case kMidiMessage_ControlChange :
+			switch (inEvent.mData1)
+			{
+				case kMidiController_Sustain :
+					return inEvent.mData2 >= 64 ? SynthEvent::kEventType_SustainOn : SynthEvent::kEventType_SustainOff;
+				case kMidiController_Sostenuto :
+					return inEvent.mData2 >= 64 ? SynthEvent::kEventType_SostenutoOn : SynthEvent::kEventType_SostenutoOff;
+				case kMidiController_AllNotesOff :
+					return SynthEvent::kEventType_AllNotesOff;
+				case kMidiController_ResetAllControllers :
+					return SynthEvent::kEventType_ResetAllControllers;
+				case kMidiController_AllSoundOff :
+				case kMidiController_OmniModeOff :
+				case kMidiController_OmniModeOn :
+				case kMidiController_MonoModeOn :
+				case kMidiController_MonoModeOff :
+					return SynthEvent::kEventType_AllSoundOff;
+			}
+			break;
+	}
+	return 0;
+}
+
+OSStatus	AUInstrumentBase::HandleMidiEvents(const AUMIDIEvent *inEvents, UInt32 inNumEvents)
+{
+	MapMidiEvents(inEvents, inNumEvents);
+	
+	// on the render thread the notes start at once, with no queue to batch
+	if (InRenderThread ()) {
+		for (UInt32 i = 0; i < inNumEvents; ++i)
+			DispatchMidiEvent(inEvents[i].mStatus, inEvents[i].mChannel, inEvents[i].mData1, inEvents[i].mData2, inEvents[i].mStartFrame);
+		return noErr;
+	}
+	
+	// the messages handled without the queue never write to it, so the queued events keep their order
+	// while they wait for the one publish at the end
+	UInt32 room = mEventQueue.WritableItems();
+	UInt32 numQueued = 0;
+	for (UInt32 i = 0; i < inNumEvents; ++i)
+	{
+		const AUMIDIEvent &midi = inEvents[i];
+		UInt32 eventType = QueuedEventType(midi);
+		if (eventType == 0) {
+			DispatchMidiEvent(midi.mStatus, midi.mChannel, midi.mData1, midi.mData2, midi.mStartFrame);
+			continue;
+		}
+		if (numQueued == room)
+			continue;	// queue full; dropped, as StartNote() drops it
+		
+		SynthEvent *event = mEventQueue.WriteItemAt(numQueued++);
+		switch (eventType)
+		{
+			case SynthEvent::kEventType_NoteOn :
+			{
+				MusicDeviceNoteParams params;
+				params.argCount = 2;
+				params.mPitch = midi.mData1;
+				params.mVelocity = midi.mData2;
+				event->Set(eventType, midi.mChannel, midi.mData1, midi.mStartFrame, &params);
+				break;
+			}
+			case SynthEvent::kEventType_NoteOff :
+				event->Set(eventType, midi.mChannel, midi.mData1, midi.mStartFrame, NULL);
+				break;
+			default :
+				event->Set(eventType, midi.mChannel, 0, 0, NULL);	// at the start of the buffer, as SendPedalEvent() queues it
+				break;
+		}
+	}
+	if (numQueued)
+		mEventQueue.AdvanceWritePtr(numQueued);
+	return noErr;
+}
+
 OSStatus	AUInstrumentBase::HandleControlChange(	UInt8 	inChannel,
 													UInt8 	inController,
 													UInt8 	inValue,
@@ -649,44 +1243,55 @@ SynthNote*  AUInstrumentBase::VoiceStealing(UInt32 inFrame, bool inKillIt)
 #if DEBUG_PRINT_NOTE
 		printf(" checking state %d...\n", i);
 #endif
-		UInt32 numGroups = Groups().GetNumberOfElements();
+		UInt32 numGroups = UInt32(mGroupElements.size());
 		for (UInt32 j = 0; j < numGroups; ++j)
 		{
-			SynthGroupElement *group = (SynthGroupElement*)Groups().GetElement(j);
+			SynthGroupElement *group = mGroupElements[j];
 #if DEBUG_PRINT_NOTE
 			printf("\tsteal group %d   size %d\n", j, group->mNoteList[i].Length());
 #endif
-			if (group->mNoteList[i].NotEmpty()) {
-#if DEBUG_PRINT_NOTE
-				printf("\t-- not empty\n");
-#endif
-				SynthNote *note = group->mNoteList[i].FindMostQuietNote();
-				if (inKillIt) {
+			if (group->mNoteList[i].NotEmpty())
+				return StealQuietestNote(group, i, inFrame, inKillIt);
+		}
+	}
 #if DEBUG_PRINT_NOTE
-					printf("\t--=== KILL ===---\n");
+	printf("no notes to steal????\n");
 #endif
-					note->Kill(inFrame);
-					group->mNoteList[i].RemoveNote(note);
-					if (i != kNoteState_FastReleased)
-						DecNumActiveNotes();
-					return note;
-				} else {
+	return NULL; // It should be impossible to get here. It means there were no notes to kill in any state. 
+}
+
+SynthNote*  AUInstrumentBase::VoiceStealingInGroup(SynthGroupElement *inGroup, UInt32 inFrame, bool inKillIt)
+{
+	UInt32 startState = inKillIt ? kNoteState_FastReleased : kNoteState_Released;
+	for (UInt32 i = startState; i <= startState; --i)
+		if (inGroup->mNoteList[i].NotEmpty())
+			return StealQuietestNote(inGroup, i, inFrame, inKillIt);
+	return NULL;
+}
+
+// kills the quietest note in inState of the group and returns it, or fast-releases it and returns NULL
+SynthNote*  AUInstrumentBase::StealQuietestNote(SynthGroupElement *inGroup, UInt32 inState, UInt32 inFrame, bool inKillIt)
+{
+	AU_SIGNPOST_EVENT("VoiceSteal");
+	SynthNote *note = inGroup->mNoteList[inState].PopMostQuietNote();
+	if (inKillIt) {
 #if DEBUG_PRINT_NOTE
-					printf("\t--=== FAST RELEASE ===---\n");
+		printf("\t--=== KILL ===---\n");
 #endif
-					group->mNoteList[i].RemoveNote(note);
-					note->FastRelease(inFrame);
-					group->mNoteList[kNoteState_FastReleased].AddNote(note);
-					DecNumActiveNotes(); // kNoteState_FastReleased counts as inactive for voice stealing purposes.
-					return NULL;
-				}
-			}
-		}
+		note->Kill(inFrame);
+		inGroup->mNoteList[inState].RemoveNote(note);
+		if (inState != kNoteState_FastReleased)
+			NoteInactive(note);
+		return note;
 	}
 #if DEBUG_PRINT_NOTE
-	printf("no notes to steal????\n");
+	printf("\t--=== FAST RELEASE ===---\n");
 #endif
-	return NULL; // It should be impossible to get here. It means there were no notes to kill in any state. 
+	inGroup->mNoteList[inState].RemoveNote(note);
+	note->FastRelease(inFrame);
+	inGroup->mNoteList[kNoteState_FastReleased].AddNote(note);
+	NoteInactive(note); // kNoteState_FastReleased counts as inactive for voice stealing purposes.
+	return NULL;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -708,7 +1313,7 @@ OSStatus			AUMonotimbralInstrumentBase::RealTimeStartNote(
 															const MusicDeviceNoteParams &inParams)
 {
 #if DEBUG_PRINT_RENDER
-	printf("AUMonotimbralInstrumentBase::RealTimeStartNote %d\n", inNoteInstanceID);
+	DebugPrintfRT("AUMonotimbralInstrumentBase::RealTimeStartNote %d", inNoteInstanceID);
 #endif
 
 	if (NumActiveNotes() + 1 > MaxActiveNotes()) 
@@ -728,6 +1333,86 @@ OSStatus			AUMonotimbralInstrumentBase::RealTimeStartNote(
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+AUMultitimbralInstrumentBase::AUMultitimbralInstrumentBase(
+							AudioComponentInstance			inInstance, 
+							UInt32							numInputs,
+							UInt32							numOutputs,
+							UInt32							numGroups,
+							UInt32							numParts)
+	: AUInstrumentBase(inInstance, numInputs, numOutputs, numGroups, numParts)
+{
+}
+
+void		AUMultitimbralInstrumentBase::SetPartNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, SynthNote* inNotes,
+													   UInt32 inNoteSize, const UInt32 *inPartNotes)
+{
+	SetNotes(inNumNotes, inMaxActiveNotes, inNotes, inNoteSize);
+	
+	// SetNotes put every note on the shared free list; hand each part its own run of them instead
+	mFreeNotes.Empty();
+	mNoteParts.assign(inNumNotes, NULL);
+	UInt32 first = 0;
+	for (UInt32 i = 0; i < Parts().GetNumberOfElements(); ++i)
+	{
+		SynthPartElement *part = reinterpret_cast<SynthPartElement*>(Parts().GetElement(i));
+		UInt32 count = std::min(inPartNotes[i], inNumNotes - first);
+		part->mFirstNote = first;
+		part->mNumNotes = count;
+		part->mNumActiveNotes = 0;
+		part->mFreeNotes.Empty();
+		for (UInt32 k = first; k < first + count; ++k)
+		{
+			mNoteParts[k] = part;
+			part->mFreeNotes.AddNote(GetNote(k));
+		}
+		first += count;
+	}
+}
+
+SynthPartElement *	AUMultitimbralInstrumentBase::PartForNote(SynthGroupElement *inGroup, const MusicDeviceNoteParams &inParams)
+{
+	AUScope &parts = Parts();
+	for (UInt32 i = 0; i < parts.GetNumberOfElements(); ++i)
+	{
+		SynthPartElement *part = reinterpret_cast<SynthPartElement*>(parts.GetElement(i));
+		if (part->GetGroupIndex() == inGroup->GroupID() && part->InRange(inParams.mPitch, inParams.mVelocity))
+			return part;
+	}
+	return NULL;
+}
+
+OSStatus			AUMultitimbralInstrumentBase::RealTimeStartNote(	
+															SynthGroupElement 			*inGroup, 
+															NoteInstanceID 				inNoteInstanceID, 
+															UInt32 						inOffsetSampleFrame, 
+															const MusicDeviceNoteParams &inParams)
+{
+#if DEBUG_PRINT_RENDER
+	DebugPrintfRT("AUMultitimbralInstrumentBase::RealTimeStartNote %d", inNoteInstanceID);
+#endif
+	SynthPartElement *part = PartForNote(inGroup, inParams);
+	if (!part || part->NumNotes() == 0) return noErr;
+	
+	// the part's limit first, then the instrument's
+	if (part->NumActiveNotes() + 1 > part->GetMaxPolyphony())
+		VoiceStealingInGroup(inGroup, inOffsetSampleFrame, false);
+	if (NumActiveNotes() + 1 > MaxActiveNotes())
+		VoiceStealing(inOffsetSampleFrame, false);
+	
+	// with the part's pool used up, even by fast-released notes, its quietest note makes way
+	SynthNote *note = part->mFreeNotes.mHead;
+	if (note)
+		part->mFreeNotes.RemoveNote(note);
+	else
+		note = VoiceStealingInGroup(inGroup, inOffsetSampleFrame, true);
+	if (!note) return -1;
+	
+	IncNumActiveNotes();
+	++NotePart(note)->mNumActiveNotes;
+	inGroup->NoteOn(note, part, inNoteInstanceID, inOffsetSampleFrame, inParams);
+	
+	return noErr;
+}
 
 OSStatus			AUMultitimbralInstrumentBase::GetPropertyInfo(AudioUnitPropertyID	inID,
 												AudioUnitScope				inScope,
@@ -763,10 +1448,13 @@ OSStatus			AUMultitimbralInstrumentBase::GetProperty(	AudioUnitPropertyID 	inID,
 	{
 #if !TARGET_OS_IPHONE
 		case kMusicDeviceProperty_PartGroup:
-			if (inScope != kAudioUnitScope_Group) return kAudioUnitErr_InvalidScope;
-			// ??
-			return -1; //unimpl
+		{
+			if (inScope != kAudioUnitScope_Part) return kAudioUnitErr_InvalidScope;
+			SynthPartElement *part = GetPartElement(inElement);
+			if (!part) return kAudioUnitErr_InvalidElement;
+			*(UInt32 *)outData = part->GetGroupIndex();
 			break;
+		}
 #endif
 		default:
 			result = AUInstrumentBase::GetProperty (inID, inScope, inElement, outData);
@@ -788,14 +1476,19 @@ OSStatus			AUMultitimbralInstrumentBase::SetProperty(  AudioUnitPropertyID 			in
 	switch (inID) 
 	{
 #if !TARGET_OS_IPHONE
+		// the MIDI channel whose notes the part plays; its notes already sounding play on
 		case kMusicDeviceProperty_PartGroup:
-			if (inScope != kAudioUnitScope_Group) return kAudioUnitErr_InvalidScope;
-			// ??
-			return -1; //unimpl
+		{
+			if (inScope != kAudioUnitScope_Part) return kAudioUnitErr_InvalidScope;
+			if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+			SynthPartElement *part = GetPartElement(inElement);
+			if (!part) return kAudioUnitErr_InvalidElement;
+			part->SetGroupIndex(*(const UInt32 *)inData);
 			break;
+		}
 #endif
 		default:
-			result = MusicDeviceBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
+			result = AUInstrumentBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
 	}
 	
 	return result;
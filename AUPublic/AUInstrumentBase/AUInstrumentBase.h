@@ -19,6 +19,10 @@ Part of Core Audio AUInstrument Base Classes
 #include "SynthEvent.h"
 #include "SynthNote.h"
 #include "SynthElement.h"
+#include "VoiceRenderWorkers.h"
+#include "AUSilentTimeout.h"
+#include "AUQualityController.h"
+#include "CADSPKernels.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -55,6 +59,8 @@ public:
 
 	virtual void				Cleanup();
 	
+	virtual void				ReallocateBuffers();
+	
 	virtual OSStatus			Reset(					AudioUnitScope 					inScope,
 														AudioUnitElement 				inElement);
 														
@@ -65,7 +71,25 @@ public:
 	virtual bool				StreamFormatWritable(	AudioUnitScope					scope,
 														AudioUnitElement				element);
 
-	virtual bool				CanScheduleParameters() const { return false; }
+	virtual OSStatus			GetPropertyInfo(		AudioUnitPropertyID				inID,
+														AudioUnitScope					inScope,
+														AudioUnitElement				inElement,
+														UInt32 &						outDataSize,
+														Boolean &						outWritable);
+
+	virtual OSStatus			GetProperty(			AudioUnitPropertyID 			inID,
+														AudioUnitScope 					inScope,
+														AudioUnitElement			 	inElement,
+														void *							outData);
+
+	virtual OSStatus			SetProperty(			AudioUnitPropertyID 			inID,
+														AudioUnitScope 					inScope,
+														AudioUnitElement 				inElement,
+														const void *					inData,
+														UInt32 							inDataSize);
+
+	// global parameter ramps reach the notes through GlobalParameterEnds(), see SnapshotGlobalParameters()
+	virtual bool				CanScheduleParameters() const { return true; }
 
 	virtual OSStatus			Render(					AudioUnitRenderActionFlags &	ioActionFlags,
 														const AudioTimeStamp &			inTimeStamp,
@@ -90,6 +114,14 @@ public:
 														NoteInstanceID 				inNoteInstanceID, 
 														UInt32 						inOffsetSampleFrame);
 	
+	// a packet list's events off the render thread: the parameter maps are matched over the whole
+	// batch, then the notes and pedal events are written into the event queue and published with one
+	// release at the end, the rest handled as HandleMidiEvent() handles them. The notes are queued as
+	// HandleNoteOn() and HandleNoteOff() would queue them, without calling them, StartNote() or
+	// StopNote(); a subclass that overrides those to see every note must override this as well.
+	virtual OSStatus	HandleMidiEvents(		const AUMIDIEvent *	inEvents,
+												UInt32				inNumEvents);
+	
 	virtual OSStatus	HandleControlChange(	UInt8	inChannel,
 												UInt8 	inController,
 												UInt8 	inValue,
@@ -125,10 +157,48 @@ public:
 							return (SynthNote*)((char*)mNotes + inIndex * mNoteSize); 
 						}
 	
+	enum { kMaxSnapshotParameters = 32 };
+	enum { kMaxScheduledEvents = 256 };		// per render call, through ScheduleEvent()
+	
+	// what load shedding gives up, in this order; at quality level L the first L are shed (see
+	// QualityLevelChanged). The base class sheds the polyphony itself, the subclass the rest.
+	enum {
+		kQualityStep_Interpolation	= 1,	// cheaper reads of the voices' tables
+		kQualityStep_Oversampling	= 2,	// voices rendered at the output rate
+		kQualityStep_Polyphony		= 3,	// MaxActiveNotes() cut, and the quietest notes over it released
+		kQualityStep_Transition		= 4,	// shorter crossfades
+		kNumQualitySteps			= 4
+	};
+	
+	// the global parameters with IDs below kMaxSnapshotParameters, as they stood at the top of the
+	// current render call (or at Initialize()); other IDs are read from Globals(). The ends are the
+	// values on the last frame of the call, which differ only while a scheduled ramp is running.
+	const Float32 *		GlobalParameters() const { return mGlobalParameters; }
+	const Float32 *		GlobalParameterEnds() const { return mGlobalParameterEnds; }
+	Float32				GetGlobalParameter(AudioUnitParameterID inParamID)
+						{
+							return inParamID < kMaxSnapshotParameters ? mGlobalParameters[inParamID] : Globals()->GetParameter(inParamID);
+						}
+	Float32				GetGlobalParameterEnd(AudioUnitParameterID inParamID)
+						{
+							return inParamID < kMaxSnapshotParameters ? mGlobalParameterEnds[inParamID] : Globals()->GetParameter(inParamID);
+						}
+	
+	// the frames a mono note renders for every output frame, for the notes to set their rates by (see
+	// SetMonoOversampling)
+	UInt32				MonoOversampling() const { return mMonoOversampling; }
+	
+	// the mixing loops for this CPU's vector unit, picked in Initialize()
+	const CADSPKernels &	DSPKernels() const { return *mDSPKernels; }
+	
 	SynthNote*			GetAFreeNote(UInt32 inFrame);
 	void				AddFreeNote(SynthNote* inNote);
+
+	// any thread: the events queued for the render thread, roughly (see LockFreeFIFO::ApproximateItems)
+	UInt32				QueuedEvents() const { return mEventQueue.ApproximateItems(); }
 	
 	friend class SynthGroupElement;
+	friend class AUMultitimbralInstrumentBase;
 protected:
 
 	UInt32				NextNoteID() { return OSAtomicIncrement32((int32_t *)&mNoteIDCounter); }
@@ -138,10 +208,111 @@ protected:
 	// number of active notes. inNoteData should be an array of size inMaxActiveNotes.
 	void				SetNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, SynthNote* inNotes, UInt32 inNoteSize);
 	
+	// optionally start inNumWorkers real-time threads that share the render thread's voices once a group
+	// has enough mono-rendering notes sounding (see SynthGroupElement::Render); 0 renders everything on
+	// the render thread. Call after SetNotes in Initialize(); Cleanup() stops them.
+	void				SetVoiceRenderWorkers(UInt32 inNumWorkers);
+	
+	// with inMinSliceFrames > 0, Render() splits the buffer at each queued event's offset and renders
+	// the slices in between, none but the last shorter than inMinSliceFrames; an event closer than
+	// that to the start of a slice is performed at the start. 0 (the default) performs every event at the start
+	// of the buffer and renders it whole. Events are taken in queue order.
+	void				SetEventSliceFrames(UInt32 inMinSliceFrames) { mEventSliceFrames = inMinSliceFrames; }
+	UInt32				EventSliceFrames() const { return mEventSliceFrames; }
+	
+	// with inFrames > 0, a power of two, Render() renders the groups in blocks of exactly inFrames
+	// whatever size the host asks for, so the voices' loops always run the same trip count and
+	// BeginRenderCycle() comes at a fixed control rate. A buffer that doesn't end on a block boundary
+	// renders one more block into a FIFO and the next call takes the rest of it first. Events are
+	// performed at the start of the block they fall in, at their offset within it; an event due in
+	// frames the FIFO already holds is performed at the start of the next block, up to inFrames - 1
+	// frames late. Event slices are not used. A block larger than the maximum frames per slice is
+	// halved until it fits. 0 (the default) renders the host's buffer as it comes. Call before
+	// Initialize().
+	void				SetRenderBlockFrames(UInt32 inFrames) { mRenderBlockFrames = inFrames; }
+	UInt32				RenderBlockFrames() const { return mRenderBlockFrames; }
+	
+	// with inNumBuses above 1 each group mixes its mono notes into one block per SynthNote::MonoBus()
+	// value, below inNumBuses, and hands them to MixMonoBuses() instead of adding a single block to
+	// every channel. Call before SetNotes in Initialize().
+	void				SetMonoBuses(UInt32 inNumBuses) { mNumMonoBuses = inNumBuses ? inNumBuses : 1; }
+	UInt32				NumMonoBuses() const { return mNumMonoBuses; }
+	
+	// with inFactor above 1 the mono notes render inFactor frames for every output frame, so the buses
+	// each sounding group hands to MixMonoBuses() hold inFactor times as many frames as are mixed. The
+	// subclass must decimate them; since any number of groups may sound in a slice, none included, it
+	// sums them in MixMonoBuses() and decimates once in EndRenderSlice(), which also lets the filters'
+	// tails run out. A note still reports NoteEnded() in output frames. Call before SetNotes in
+	// Initialize().
+	void				SetMonoOversampling(UInt32 inFactor) { mMonoOversampling = inFactor ? inFactor : 1; }
+	
+	// adds a group's mono buses to the channels of its output bus, interleaved or not; inBuses[b] is
+	// NULL when no note rendered into bus b. The default adds every bus to every channel.
+	virtual void		MixMonoBuses(AudioBufferList &ioBus, const Float32 *const *inBuses, UInt32 inNumBuses,
+									 UInt32 inNumberFrames);
+	
+	// called once per Render(), after the parameter snapshot and before any event is performed; with
+	// render blocks, once per block instead, with the block's frames
+	virtual void		BeginRenderCycle(UInt32 inNumberFrames) {}
+	
+	// called once per Render(), before anything else of the cycle but the quality update, for the
+	// subclass to add events of its own with ScheduleEvent(); with render blocks too, once for the
+	// host's whole buffer
+	virtual void		ScheduleRenderEvents(const AudioTimeStamp &inTimeStamp, UInt32 inNumberFrames) {}
+	
+	// from ScheduleRenderEvents() only: an event performed in this render call at inOffsetSampleFrame,
+	// merged by offset with the queued ones, and sliced or blocked as they are. Events go in offset
+	// order; one earlier than the event before it is performed at that one's offset. Note parameters
+	// with controls are not taken, since their copy would allocate. False once kMaxScheduledEvents
+	// are scheduled in the call.
+	bool				ScheduleEvent(UInt32 inEventType, MusicDeviceGroupID inGroupID, NoteInstanceID inNoteID,
+									  UInt32 inOffsetSampleFrame, const MusicDeviceNoteParams *inParams);
+	
+	// called before the groups render each slice, inOffsetFrames into the inNumberFrames Render() was
+	// given; the whole buffer is one slice unless the event slice frames are set
+	virtual void		BeginRenderSlice(UInt32 inOffsetFrames, UInt32 inNumFrames) {}
+	
+	// called after the groups have rendered each slice, groups with no note sounding being skipped
+	virtual void		EndRenderSlice(UInt32 inOffsetFrames, UInt32 inNumFrames) {}
+	
+	// true while the subclass adds sound of its own in EndRenderSlice() that no note accounts for;
+	// until it returns false, a render with no event and no note left is not skipped as silent
+	virtual bool		IsSoundingWithoutNotes() const { return false; }
+	
+	// every group and output element, cached by ReallocateBuffers() for the render loops, which walk
+	// them without the scopes' lookups; the element counts only change while uninitialized
+	const std::vector<SynthGroupElement*> &	GroupElements() const { return mGroupElements; }
+	const std::vector<AUOutputElement*> &	OutputElements() const { return mOutputElements; }
+	
+	// the buffer list of an output, moved to the slice being rendered; only valid from
+	// BeginRenderSlice() to EndRenderSlice()
+	AudioBufferList *	OutputBufferList(UInt32 inOutput) const
+						{
+							return mOutputBufferListsValid && inOutput < mOutputBufferLists.size() ? mOutputBufferLists[inOutput] : NULL;
+						}
+	
+	// with kAudioUnitCustomProperty_LoadShedding on, every Render() feeds the last cycle's load to an
+	// AUQualityController and, when its level moves, calls this first, on the render thread, before
+	// anything else of the cycle. The subclass turns its own steps at or below inLevel down and the
+	// others back up; it must not block or allocate. Initialize() starts out at level 0.
+	virtual void		QualityLevelChanged(UInt32 inLevel) {}
+	UInt32				QualityLevel() const { return mQuality.Level(); }
+	
+	// copies Globals() into GlobalParameters() and applies the ramps scheduled for the inNumberFrames
+	// from inOffsetFrames into the buffer; Render() does this before anything else, and before each
+	// render block
+	void				SnapshotGlobalParameters(UInt32 inNumberFrames = 0, UInt32 inOffsetFrames = 0);
+	
 	void				PerformEvents(   const AudioTimeStamp &			inTimeStamp);
+	void				PerformEvent(SynthEvent *inEvent, UInt32 inOffsetSampleFrame);
 	OSStatus			SendPedalEvent(MusicDeviceGroupID inGroupID, UInt32 inEventType, UInt32 inOffsetSampleFrame);
 	virtual SynthNote*  VoiceStealing(UInt32 inFrame, bool inKillIt);
-	UInt32				MaxActiveNotes() const { return mMaxActiveNotes; }
+	// the same, taking only from inGroup's notes
+	SynthNote*			VoiceStealingInGroup(SynthGroupElement *inGroup, UInt32 inFrame, bool inKillIt);
+	UInt32				MaxActiveNotes() const
+						{
+							return mQuality.Level() >= kQualityStep_Polyphony ? mShedMaxActiveNotes : mMaxActiveNotes;
+						}
 	UInt32				NumActiveNotes() const { return mNumActiveNotes; }
 	void				IncNumActiveNotes() { ++mNumActiveNotes; }
 	void				DecNumActiveNotes() { --mNumActiveNotes; }
@@ -161,13 +332,74 @@ private:
 	SInt32 mNoteIDCounter;
 	
 	SynthEventQueue mEventQueue;
+	// the render thread's own events for the current call, kMaxScheduledEvents of them, and every event
+	// of the call in offset order while there are any
+	std::vector<SynthEvent> mScheduledEvents;
+	UInt32 mNumScheduledEvents;
+	std::vector<SynthEvent*> mCycleEvents;
 	
 	UInt32 mNumNotes;
 	UInt32 mNumActiveNotes;
 	UInt32 mMaxActiveNotes;
+	UInt32 mShedMaxActiveNotes;		// while the polyphony is shed
 	SynthNote* mNotes;	
 	SynthNoteList mFreeNotes;
+	// the part each note belongs to, when the parts have voice pools of their own (see
+	// AUMultitimbralInstrumentBase::SetPartNotes); empty when all notes share mFreeNotes
+	std::vector<SynthPartElement*> mNoteParts;
 	UInt32 mNoteSize;
+	VoiceRenderWorkers mRenderWorkers;
+	AUSilentTimeout mSilentTimeout;
+	UInt32 mSilentFramesCleared;	// frames of our own output buffers known to be zero
+	UInt32 mEventSliceFrames;
+	UInt32 mNumMonoBuses;
+	UInt32 mMonoOversampling;
+	UInt32 mRenderBlockFrames;
+	UInt32 mBlockFrames;			// mRenderBlockFrames as it fits the maximum frames per slice
+	// the frames of the last block that its call had no room for, for every buffer of every output
+	// in turn, mBlockFrames each
+	std::vector<Float32> mBlockFifo;
+	std::vector<void *> mBlockOutputData;	// the outputs' own buffers while a block renders into the FIFO
+	UInt32 mBlockFifoStart;
+	UInt32 mBlockFifoFrames;
+	bool mBlockFifoSilent;
+	const CADSPKernels *mDSPKernels;
+	AUQualityController mQuality;
+	volatile UInt32 mLoadShedding;	// kAudioUnitCustomProperty_LoadShedding
+	// every output's buffer list, for the groups to render into; the lists move only when the buffers
+	// are reallocated, so the first render after that fills the array in
+	std::vector<AudioBufferList*> mOutputBufferLists;
+	bool mOutputBufferListsValid;
+	std::vector<SynthGroupElement*> mGroupElements;
+	std::vector<AUOutputElement*> mOutputElements;
+	std::vector<AudioUnitParameterID> mSnapshotParameterIDs;	// the global IDs below kMaxSnapshotParameters
+	alignas(64) Float32 mGlobalParameters[kMaxSnapshotParameters];
+	alignas(64) Float32 mGlobalParameterEnds[kMaxSnapshotParameters];
+	
+	void				UpdateQuality();
+	UInt32				MergeScheduledEvents(UInt32 inNumQueued);
+	SynthEvent *		CycleEvent(UInt32 inIndex)
+						{
+							return mNumScheduledEvents ? mCycleEvents[inIndex] : mEventQueue.ReadItemAt(inIndex);
+						}
+	SynthPartElement *	NotePart(SynthNote *inNote) const
+						{
+							return mNoteParts.empty() ? NULL : mNoteParts[UInt32(((char *)inNote - (char *)mNotes) / mNoteSize)];
+						}
+	SynthNoteList &		FreeNotesFor(SynthNote *inNote)
+						{
+							SynthPartElement *part = NotePart(inNote);
+							return part ? part->mFreeNotes : mFreeNotes;
+						}
+	void				NoteInactive(SynthNote *inNote);
+	SynthNote *			StealQuietestNote(SynthGroupElement *inGroup, UInt32 inState, UInt32 inFrame, bool inKillIt);
+	void				PrepareOutputBuffers(UInt32 inNumberFrames, bool inSilent);
+	OSStatus			RenderSlice(const AudioTimeStamp &inTimeStamp, UInt32 inOffsetFrames, UInt32 inNumFrames);
+	void				SliceOutputBuffers(SInt32 inMoveFrames, UInt32 inNumFrames);
+	OSStatus			RenderBlocks(AudioUnitRenderActionFlags &ioActionFlags, const AudioTimeStamp &inTimeStamp,
+									 UInt32 inNumberFrames);
+	void				SwapBlockFifo(bool inIntoFifo, UInt32 inNumberFrames);
+	void				CopyFromBlockFifo(UInt32 inFifoStart, UInt32 inOutputStart, UInt32 inNumFrames);
 	
 	AUScope			mPartScope;
 	const UInt32	mInitNumPartEls;
@@ -193,7 +425,14 @@ public:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-// this is a work in progress! The mono-timbral one is finished though!
+/*
+	A multitimbral instrument plays each note with the part bound to its MIDI channel, the first whose
+	key zone takes it (see SynthPartElement); a note no part takes is ignored. Every part has a voice
+	pool of its own, laid out by SetPartNotes(), and its own polyphony limit: a note over the part's
+	limit fast-releases the quietest note of the part's channel, and one over the instrument's
+	MaxActiveNotes() the quietest of any channel. A part is meant to have its channel to itself;
+	parts layered on one channel share its notes when stealing.
+*/
 class AUMultitimbralInstrumentBase : public AUInstrumentBase
 {
 public:
@@ -203,6 +442,11 @@ public:
 							UInt32							numOutputs,
 							UInt32							numGroups,
 							UInt32							numParts);
+	
+	virtual OSStatus			RealTimeStartNote(			SynthGroupElement 			*inGroup, 
+															NoteInstanceID 				inNoteInstanceID, 
+															UInt32 						inOffsetSampleFrame, 
+															const MusicDeviceNoteParams &inParams);
 							
 	virtual OSStatus			GetPropertyInfo(		AudioUnitPropertyID				inID,
 														AudioUnitScope					inScope,
@@ -221,8 +465,14 @@ public:
 														const void *					inData,
 														UInt32 							inDataSize);
 
-private:
-
+protected:
+	// call instead of SetNotes in Initialize(): inNotes are laid out as one contiguous voice pool per
+	// part, in part order, part i taking inPartNotes[i] of them; inNumNotes must be their sum.
+	void				SetPartNotes(UInt32 inNumNotes, UInt32 inMaxActiveNotes, SynthNote* inNotes, UInt32 inNoteSize,
+									 const UInt32 *inPartNotes);
+	
+	// the part that plays a note on inGroup's channel, or NULL
+	SynthPartElement *	PartForNote(SynthGroupElement *inGroup, const MusicDeviceNoteParams &inParams);
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,82 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Steps an instrument's quality down as its render load nears the budget, and back up with hysteresis
+*/
+
+#ifndef __AUQualityController__
+#define __AUQualityController__
+
+#include <CoreAudio/CoreAudioTypes.h>
+
+/*
+	AUQualityController turns the load of each render cycle, its duration over its budget (see
+	AURenderTiming), into a quality level from 0, everything on, up to the number of steps the unit
+	can shed. It follows an exponentially weighted estimate of the load. Past kShedLoad, or on any
+	cycle that overran its budget outright, it steps down a level, then holds for kHoldCycles so that
+	the step shows in the estimate before it takes another. It steps back up only once the estimate
+	has stayed under kRecoverLoad for kRecoverCycles in a row, and every step starts that count over,
+	so a level that only just fits is not flipped back and forth.
+
+	The render thread owns the controller; Update() is a few multiplies and compares.
+*/
+class AUQualityController
+{
+public:
+	static const UInt32		kHoldCycles = 8;
+	static const UInt32		kRecoverCycles = 256;
+
+	explicit AUQualityController(UInt32 inNumSteps) : mNumSteps(inNumSteps) { Reset(); }
+
+	// back to full quality
+	void				Reset()
+	{
+		mLevel = 0;
+		mEstimate = 0.f;
+		mHold = 0;
+		mCalmCycles = 0;
+	}
+
+	// true if the level changed
+	bool				Update(Float32 inLoad)
+	{
+		mEstimate += kSmoothing * (inLoad - mEstimate);
+		if (mHold > 0) {
+			--mHold;
+			return false;
+		}
+		if ((mEstimate > kShedLoad || inLoad >= 1.f) && mLevel < mNumSteps) {
+			++mLevel;
+			mHold = kHoldCycles;
+			mCalmCycles = 0;
+			return true;
+		}
+		if (mLevel == 0 || mEstimate >= kRecoverLoad) {
+			mCalmCycles = 0;
+			return false;
+		}
+		if (++mCalmCycles < kRecoverCycles)
+			return false;
+		--mLevel;
+		mHold = kHoldCycles;
+		mCalmCycles = 0;
+		return true;
+	}
+
+	UInt32				Level() const { return mLevel; }
+	Float32				EstimatedLoad() const { return mEstimate; }
+
+private:
+	static constexpr Float32 kSmoothing = 0.2f;		// of the newest cycle in the estimate
+	static constexpr Float32 kShedLoad = 0.7f;
+	static constexpr Float32 kRecoverLoad = 0.4f;
+
+	UInt32				mNumSteps;
+	UInt32				mLevel;
+	Float32				mEstimate;
+	UInt32				mHold;			// cycles left before the level may move again
+	UInt32				mCalmCycles;	// in a row with the estimate under kRecoverLoad
+};
+
+#endif
@@ -6,61 +6,122 @@ Abstract:
 Part of Core Audio AUInstrument Base Classes
 */
 
-#include <libkern/OSAtomic.h>
+#ifndef __LockFreeFIFO__
+#define __LockFreeFIFO__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+#include <atomic>
+#include <cstddef>
+
+/*
+	Single-producer, single-consumer rings. The writer owns the write index (and the free index), the
+	reader owns the read index; each side publishes its index with a release store and reads the other
+	side's with an acquire load. The two sides' indices live on separate cache lines, so a MIDI thread
+	writing events never invalidates the line the render thread reads its index from, and vice versa.
+
+	The size must be a power of two; the ring holds one item less than that. Reset() is not thread
+	safe: call it only when neither side is running.
+
+	The reader can drain everything written so far with one acquire: ReadableItems() counts it,
+	ReadItemAt() reaches each item, and AdvanceReadPtr(count) returns them all with one release.
+	LockFreeFIFOWithFree's writer can fill a batch the same way: WritableItems() frees what the reader
+	has returned and counts the room, WriteItemAt() reaches each slot, and AdvanceWritePtr(count)
+	publishes them all with one release.
+*/
+
+static const UInt32 kLockFreeFIFOCacheLine = 64;
 
 template <class ITEM>
 class LockFreeFIFOWithFree
 {
 	LockFreeFIFOWithFree(); // private, unimplemented.
+	LockFreeFIFOWithFree(const LockFreeFIFOWithFree &);
+	LockFreeFIFOWithFree & operator=(const LockFreeFIFOWithFree &);
 public:
 	LockFreeFIFOWithFree(UInt32 inMaxSize)
-		: mReadIndex(0), mWriteIndex(0), mFreeIndex(0)
+		: mMask(inMaxSize - 1), mWriteIndex(0), mFreeIndex(0), mReadIndex(0)
 	{
 		//assert(IsPowerOfTwo(inMaxSize));
 		mItems = new ITEM[inMaxSize];
-		mMask = inMaxSize - 1;
 	}
-	
+
 	~LockFreeFIFOWithFree()
 	{
 		delete [] mItems;
 	}
 
-	
-	void Reset() 
+
+	void Reset()
 	{
 		FreeItems();
-		mReadIndex = 0;
-		mWriteIndex = 0;
+		mReadIndex.store(0, std::memory_order_relaxed);
+		mWriteIndex.store(0, std::memory_order_relaxed);
 		mFreeIndex = 0;
 	}
-	
-	ITEM* WriteItem() 
+
+	// writer
+	ITEM* WriteItem()
 	{
-		//printf("WriteItem %d %d\n", mReadIndex, mWriteIndex);
 		FreeItems(); // free items on the write thread.
-		int32_t nextWriteIndex = (mWriteIndex + 1) & mMask;
-		if (nextWriteIndex == mFreeIndex) return NULL;
-		return &mItems[mWriteIndex];
+		UInt32 writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+		if (((writeIndex + 1) & mMask) == mFreeIndex) return NULL;
+		return &mItems[writeIndex];
+	}
+	UInt32 WritableItems()
+	{
+		FreeItems();
+		return (mFreeIndex - mWriteIndex.load(std::memory_order_relaxed) - 1) & mMask;
 	}
-	
-	ITEM* ReadItem() 
+	ITEM* WriteItemAt(UInt32 inOffset)
+	{
+		return &mItems[(mWriteIndex.load(std::memory_order_relaxed) + inOffset) & mMask];
+	}
+	void AdvanceWritePtr(UInt32 inCount = 1)
+	{
+		UInt32 writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+		mWriteIndex.store((writeIndex + inCount) & mMask, std::memory_order_release);
+	}
+
+	// reader
+	ITEM* ReadItem()
+	{
+		return ReadableItems() ? ReadItemAt(0) : NULL;
+	}
+	UInt32 ReadableItems() const
+	{
+		return (mWriteIndex.load(std::memory_order_acquire) - mReadIndex.load(std::memory_order_relaxed)) & mMask;
+	}
+	ITEM* ReadItemAt(UInt32 inOffset)
+	{
+		return &mItems[(mReadIndex.load(std::memory_order_relaxed) + inOffset) & mMask];
+	}
+	void AdvanceReadPtr(UInt32 inCount = 1)
+	{
+		UInt32 readIndex = mReadIndex.load(std::memory_order_relaxed);
+		mReadIndex.store((readIndex + inCount) & mMask, std::memory_order_release);
+	}
+
+	// any thread: about how many items are queued, for monitoring; relaxed loads, so it synchronizes
+	// with neither side and may be off by the items in flight
+	UInt32 ApproximateItems() const
 	{
-		//printf("ReadItem %d %d\n", mReadIndex, mWriteIndex);
-		if (mReadIndex == mWriteIndex) return NULL;
-		return &mItems[mReadIndex];
+		return (mWriteIndex.load(std::memory_order_relaxed) - mReadIndex.load(std::memory_order_relaxed)) & mMask;
 	}
-	void AdvanceWritePtr() { OSAtomicCompareAndSwap32(mWriteIndex, (mWriteIndex + 1) & mMask, &mWriteIndex); }
-	void AdvanceReadPtr()  { OSAtomicCompareAndSwap32(mReadIndex,  (mReadIndex  + 1) & mMask, &mReadIndex); }
+
 private:
-	ITEM* FreeItem() 
+	ITEM* FreeItem()
 	{
-		if (mFreeIndex == mReadIndex) return NULL;
+		if (mFreeIndex == mReadIndex.load(std::memory_order_acquire)) return NULL;
 		return &mItems[mFreeIndex];
 	}
-	void AdvanceFreePtr() { OSAtomicCompareAndSwap32(mFreeIndex, (mFreeIndex + 1) & mMask, &mFreeIndex); }
-	
-	void FreeItems() 
+	void AdvanceFreePtr() { mFreeIndex = (mFreeIndex + 1) & mMask; }
+
+	void FreeItems()
 	{
 		ITEM* item;
 		while ((item = FreeItem()) != NULL)
@@ -69,10 +130,20 @@ private:
 			AdvanceFreePtr();
 		}
 	}
-	
-	volatile int32_t mReadIndex, mWriteIndex, mFreeIndex;
-	int32_t mMask;
+
+	// shared, never written after construction
+	UInt32 mMask;
 	ITEM *mItems;
+	char mPad0[kLockFreeFIFOCacheLine];
+
+	// written by the writer only
+	std::atomic<UInt32> mWriteIndex;
+	UInt32 mFreeIndex;
+	char mPad1[kLockFreeFIFOCacheLine];
+
+	// written by the reader only
+	std::atomic<UInt32> mReadIndex;
+	char mPad2[kLockFreeFIFOCacheLine];
 };
 
 
@@ -83,48 +154,95 @@ template <class ITEM>
 class LockFreeFIFO
 {
 	LockFreeFIFO(); // private, unimplemented.
+	LockFreeFIFO(const LockFreeFIFO &);
+	LockFreeFIFO & operator=(const LockFreeFIFO &);
 public:
 	LockFreeFIFO(UInt32 inMaxSize)
-		: mReadIndex(0), mWriteIndex(0)
+		: mMask(inMaxSize - 1), mWriteIndex(0), mCachedReadIndex(0), mReadIndex(0)
 	{
 		//assert(IsPowerOfTwo(inMaxSize));
 		mItems = new ITEM[inMaxSize];
-		mMask = inMaxSize - 1;
 	}
-	
+
 	~LockFreeFIFO()
 	{
 		delete [] mItems;
 	}
-	
-	void Reset() 
+
+	void Reset()
+	{
+		mReadIndex.store(0, std::memory_order_relaxed);
+		mWriteIndex.store(0, std::memory_order_relaxed);
+		mCachedReadIndex = 0;
+	}
+
+	// writer
+	ITEM* WriteItem()
+	{
+		UInt32 writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+		UInt32 nextWriteIndex = (writeIndex + 1) & mMask;
+		// only look at the reader's line when the ring seems full
+		if (nextWriteIndex == mCachedReadIndex) {
+			mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+			if (nextWriteIndex == mCachedReadIndex) return NULL;
+		}
+		return &mItems[writeIndex];
+	}
+	UInt32 WritableItems()
+	{
+		mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+		return (mCachedReadIndex - mWriteIndex.load(std::memory_order_relaxed) - 1) & mMask;
+	}
+	ITEM* WriteItemAt(UInt32 inOffset)
+	{
+		return &mItems[(mWriteIndex.load(std::memory_order_relaxed) + inOffset) & mMask];
+	}
+	void AdvanceWritePtr(UInt32 inCount = 1)
+	{
+		UInt32 writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+		mWriteIndex.store((writeIndex + inCount) & mMask, std::memory_order_release);
+	}
+
+	// reader
+	ITEM* ReadItem()
+	{
+		return ReadableItems() ? ReadItemAt(0) : NULL;
+	}
+	UInt32 ReadableItems() const
+	{
+		return (mWriteIndex.load(std::memory_order_acquire) - mReadIndex.load(std::memory_order_relaxed)) & mMask;
+	}
+	ITEM* ReadItemAt(UInt32 inOffset)
 	{
-		mReadIndex = 0;
-		mWriteIndex = 0;
+		return &mItems[(mReadIndex.load(std::memory_order_relaxed) + inOffset) & mMask];
 	}
-	
-	ITEM* WriteItem() 
+	void AdvanceReadPtr(UInt32 inCount = 1)
 	{
-		int32_t nextWriteIndex = (mWriteIndex + 1) & mMask;
-		if (nextWriteIndex == mReadIndex) return NULL;
-		return &mItems[mWriteIndex];
+		UInt32 readIndex = mReadIndex.load(std::memory_order_relaxed);
+		mReadIndex.store((readIndex + inCount) & mMask, std::memory_order_release);
 	}
-	
-	ITEM* ReadItem() 
+
+	// any thread: about how many items are queued, for monitoring; relaxed loads, so it synchronizes
+	// with neither side and may be off by the items in flight
+	UInt32 ApproximateItems() const
 	{
-		if (mReadIndex == mWriteIndex) return NULL;
-		return &mItems[mReadIndex];
+		return (mWriteIndex.load(std::memory_order_relaxed) - mReadIndex.load(std::memory_order_relaxed)) & mMask;
 	}
-	
-		// the CompareAndSwap will always succeed. We use CompareAndSwap because it calls the PowerPC sync instruction,
-		// plus any processor bug workarounds for various CPUs.
-	void AdvanceWritePtr() { OSAtomicCompareAndSwap32(mWriteIndex, (mWriteIndex + 1) & mMask, &mWriteIndex); }
-	void AdvanceReadPtr()  { OSAtomicCompareAndSwap32(mReadIndex,  (mReadIndex  + 1) & mMask, &mReadIndex); }
-	
+
 private:
-	
-	volatile int32_t mReadIndex, mWriteIndex;
-	int32_t mMask;
+	// shared, never written after construction
+	UInt32 mMask;
 	ITEM *mItems;
+	char mPad0[kLockFreeFIFOCacheLine];
+
+	// written by the writer only
+	std::atomic<UInt32> mWriteIndex;
+	UInt32 mCachedReadIndex;	// the reader's index when the writer last looked
+	char mPad1[kLockFreeFIFOCacheLine];
+
+	// written by the reader only
+	std::atomic<UInt32> mReadIndex;
+	char mPad2[kLockFreeFIFOCacheLine];
 };
 
+#endif
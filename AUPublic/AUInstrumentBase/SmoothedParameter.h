@@ -0,0 +1,89 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-block linear de-zippering of AU parameters
+*/
+
+#ifndef __SmoothedParameter__
+#define __SmoothedParameter__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+/*
+	SmoothedParameter turns a parameter that is read once per render call into a linear ramp across
+	the block, from the value it had at the end of the previous block to the value it has now. The
+	state is three floats and a flag, so every voice can carry its own; there is no per-sample
+	smoothing filter.
+
+	Call BeginBlock() at the top of each render call with the current parameter value, then read the
+	ramp with ValueAt() or Apply(). The first block after Reset() jumps straight to its value. When a
+	render call is rendered in slices, Slice() gives each slice its part of the block's ramp.
+*/
+class SmoothedParameter
+{
+public:
+	SmoothedParameter() : mStart(0.f), mStep(0.f), mValue(0.f), mPrimed(false) {}
+
+	void			Reset()									{ mPrimed = false; }
+	void			Reset(Float32 inValue)					{ mStart = mValue = inValue; mStep = 0.f; mPrimed = true; }
+
+	void			BeginBlock(Float32 inTarget, UInt32 inNumFrames)
+	{
+		if (!mPrimed || inNumFrames == 0) {
+			Reset(inTarget);
+			return;
+		}
+		mStart = mValue;
+		mStep = (inTarget - mStart) / Float32(inNumFrames);
+		mValue = inTarget;
+	}
+
+	bool			IsRamping() const						{ return mStep != 0.f; }
+	Float32			Start() const							{ return mStart; }		// value before the first frame
+	Float32			Step() const							{ return mStep; }		// change per frame
+	Float32			Value() const							{ return mValue; }		// value on the last frame
+
+	Float32			ValueAt(UInt32 inFrame) const			{ return mStart + mStep * Float32(inFrame + 1); }
+
+	// the same ramp, with frame 0 inOffset frames into the block
+	SmoothedParameter	Slice(UInt32 inOffset) const
+	{
+		SmoothedParameter slice(*this);
+		slice.mStart += mStep * Float32(inOffset);
+		return slice;
+	}
+
+	// the same ramp over inFactor times as many frames, for a block rendered at inFactor times the rate
+	SmoothedParameter	Oversampled(UInt32 inFactor) const
+	{
+		SmoothedParameter oversampled(*this);
+		oversampled.mStep /= Float32(inFactor);
+		return oversampled;
+	}
+
+	// multiplies ioData[0..inNumFrames) by the ramp, starting inOffset frames into the block
+	void			Apply(Float32 *ioData, UInt32 inOffset, UInt32 inNumFrames) const
+	{
+		if (!IsRamping()) {
+			for (UInt32 i = 0; i < inNumFrames; ++i)
+				ioData[i] *= mValue;
+			return;
+		}
+		const Float32 start = ValueAt(inOffset);
+		for (UInt32 i = 0; i < inNumFrames; ++i)
+			ioData[i] *= start + mStep * Float32(i);
+	}
+
+private:
+	Float32			mStart;
+	Float32			mStep;
+	Float32			mValue;
+	bool			mPrimed;
+};
+
+#endif
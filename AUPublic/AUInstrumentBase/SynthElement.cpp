@@ -9,6 +9,9 @@ Part of Core Audio AUInstrument Base Classes
 #include "SynthElement.h"
 #include "AUInstrumentBase.h"
 #include "AUMIDIDefs.h"
+#include "AUSignpost.h"
+#include "CARealtimeDebugPrintf.h"
+#include <algorithm>
 
 #undef DEBUG_PRINT
 #define DEBUG_PRINT 0
@@ -53,7 +56,9 @@ SynthGroupElement::SynthGroupElement(AUInstrumentBase *audioUnit, UInt32 inEleme
 	: SynthElement(audioUnit, inElement),
 	mCurrentAbsoluteFrame(-1),
 	mMidiControlHandler(inHandler),
-	mSustainIsOn(false), mSostenutoIsOn(false), mOutputBus(0), mGroupID(kUnassignedGroup)
+	mSustainIsOn(false), mSostenutoIsOn(false), mOutputBus(0), mGroupID(kUnassignedGroup),
+	mMonoFrames(0), mNumRenderNotes(0), mRenderFirst(0), mRenderCount(0), mRenderMono(NULL), mRenderFrames(0),
+	mNumEndedNotes(0), mRenderError(noErr), mDeferNoteEnded(false)
 {
 	for (UInt32 i=0; i<kNumberOfSoundingNoteStates; ++i)
 		mNoteList[i].mState = (SynthNoteState) i;
@@ -81,9 +86,27 @@ void SynthGroupElement::Reset()
 		mNoteList[i].Empty();
 }
 
+bool SynthGroupElement::IsSounding() const
+{
+	for (UInt32 i=0; i<kNumberOfSoundingNoteStates; ++i)
+		if (mNoteList[i].NotEmpty()) return true;
+	return false;
+}
+
 SynthPartElement::SynthPartElement(AUInstrumentBase *audioUnit, UInt32 inElement) 
-	: SynthElement(audioUnit, inElement)
+	: SynthElement(audioUnit, inElement),
+	mGroupIndex(inElement), mPatchIndex(0), mMaxPolyphony(kUnlimitedPolyphony),
+	mFirstNote(0), mNumNotes(0), mNumActiveNotes(0)
+{
+	mKeyZone.mLoNote = mKeyZone.mLoVelocity = 0;
+	mKeyZone.mHiNote = mKeyZone.mHiVelocity = 127;
+	mFreeNotes.mState = kNoteState_Free;
+}
+
+bool SynthPartElement::InRange(Float32 inNote, Float32 inVelocity)
 {
+	return inNote >= mKeyZone.mLoNote && inNote <= mKeyZone.mHiNote
+		&& inVelocity >= mKeyZone.mLoVelocity && inVelocity <= mKeyZone.mHiVelocity;
 }
 
 // Return the SynthNote with the given inNoteID, if found.  If unreleasedOnly is true, only look for
@@ -92,7 +115,7 @@ SynthPartElement::SynthPartElement(AUInstrumentBase *audioUnit, UInt32 inElement
 SynthNote *SynthGroupElement::GetNote(NoteInstanceID inNoteID, bool unreleasedOnly, UInt32 *outNoteState)
 {
 #if DEBUG_PRINT_RENDER
-	printf("SynthGroupElement::GetNote %d, unreleased = %d\n", inNoteID, unreleasedOnly);
+	DebugPrintfRT("SynthGroupElement::GetNote %d, unreleased = %d", inNoteID, unreleasedOnly);
 #endif
 	const UInt32 lastNoteState = unreleasedOnly ? 
 									(mSostenutoIsOn ? kNoteState_Sostenutoed : kNoteState_Attacked)
@@ -106,14 +129,14 @@ SynthNote *SynthGroupElement::GetNote(NoteInstanceID inNoteID, bool unreleasedOn
 		while (note && note->mNoteID != inNoteID)
 		{
 #if DEBUG_PRINT_RENDER
-			printf("   checking %p id: %d\n", note, note->mNoteID);
+			DebugPrintfRT("   checking %p id: %d", note, note->mNoteID);
 #endif
 			note = note->mNext;
 		}
 		if (note)
 		{
 #if DEBUG_PRINT_RENDER
-			printf("  found %p\n", note);
+			DebugPrintfRT("  found %p", note);
 #endif
 			break;
 		}
@@ -175,6 +198,13 @@ void SynthGroupElement::NoteEnded(SynthNote *inNote, UInt32 inFrame)
 #if DEBUG_PRINT_NOTE
 	printf("SynthGroupElement::NoteEnded: id %d state %d\n", inNote->mNoteID, inNote->mState);
 #endif
+	// a note shared with a render worker reports here from that thread; settle it after the join
+	if (mDeferNoteEnded) {
+		EndedNote &ended = mEndedNotes[mNumEndedNotes.fetch_add(1, std::memory_order_relaxed)];
+		ended.mNote = inNote;
+		ended.mFrame = inFrame;
+		return;
+	}
 	if (inNote->IsSounding()) {
 		SynthNoteList *list = &mNoteList[inNote->GetState()];
 		list->RemoveNote(inNote);
@@ -351,12 +381,26 @@ OSStatus SynthGroupElement::Render(SInt64 inAbsoluteSampleFrame, UInt32 inNumber
 	if (inAbsoluteSampleFrame != mCurrentAbsoluteFrame)
 	{
 		mCurrentAbsoluteFrame = inAbsoluteSampleFrame;
-		AudioBufferList* buffArray[16];
-		UInt32 numOutputs = outputs.GetNumberOfElements();
-		for (UInt32 outBus = 0; outBus < numOutputs && outBus < 16; ++outBus)
-		{
-			buffArray[outBus] = &GetAudioUnit()->GetOutput(outBus)->GetBufferList();
-		}
+		// a group with no note in its lists costs nothing more; a multitimbral instrument has one per
+		// channel, most of them idle
+		if (!IsSounding())
+			return noErr;
+		AU_SIGNPOST_INTERVAL("GroupRender");
+		// rendering moves the notes' amplitudes on; voice stealing ranks them afresh next cycle
+		for (UInt32 i=0 ; i<kNumberOfSoundingNoteStates; ++i)
+			mNoteList[i].InvalidateRank();
+		// AUInstrumentBase::Render() keeps the output buffer lists at hand
+		std::vector<AudioBufferList*> &outputLists = GetAUInstrument()->mOutputBufferLists;
+		if (!GetAUInstrument()->mOutputBufferListsValid) return kAudioUnitErr_Uninitialized;
+		AudioBufferList **buffArray = &outputLists[0];
+		UInt32 numOutputs = UInt32(outputLists.size());
+		
+		// notes that can render mono share one scratch block per mono bus, mixed into the channels at the
+		// end; oversampled, the blocks run at that many times the output rate
+		UInt32 oversampling = GetAUInstrument()->MonoOversampling();
+		UInt32 monoFrames = inNumberFrames * oversampling;
+		bool canMono = monoFrames <= mMonoFrames && mOutputBus < numOutputs;
+		mNumRenderNotes = 0;
 		
 		for (UInt32 i=0 ; i<kNumberOfSoundingNoteStates; ++i)
 		{
@@ -364,18 +408,156 @@ OSStatus SynthGroupElement::Render(SInt64 inAbsoluteSampleFrame, UInt32 inNumber
 			while (note)
 			{
 #if DEBUG_PRINT_RENDER
-				printf("SynthGroupElement::Render: state %d, note %p\n", i, note);
+				DebugPrintfRT("SynthGroupElement::Render: state %d, note %p", i, note);
 #endif
 				SynthNote *nextNote = note->mNext;
 				
-				OSStatus err = note->Render(inAbsoluteSampleFrame, inNumberFrames, buffArray, numOutputs);
-				if (err) return err;
+				if (canMono && mNumRenderNotes < mRenderList.size() && note->CanRenderMono())
+					mRenderList[mNumRenderNotes++] = note;
+				else
+				{
+					OSStatus err = note->Render(inAbsoluteSampleFrame, inNumberFrames, buffArray, numOutputs);
+					if (err) return err;
+				}
 				
 				note = nextNote;
 			}
 		}
+		
+		if (mNumRenderNotes)
+		{
+			UInt32 numBuses = UInt32(mBusBlocks.size());
+			if (numBuses == 1 && oversampling == 1)
+			{
+				OSStatus err = RenderMonoBus(0, mNumRenderNotes, &mMonoBuffer[0], inNumberFrames);
+				if (err) return err;
+				MixMonoIntoBus(GetAUInstrument()->DSPKernels(), *buffArray[mOutputBus], &mMonoBuffer[0], inNumberFrames);
+			}
+			else
+			{
+				if (numBuses > 1)
+					SortRenderListByBus();
+				else
+				{
+					mBusFirst[0] = 0;
+					mBusFirst[1] = mNumRenderNotes;
+				}
+				for (UInt32 bus = 0; bus < numBuses; ++bus)
+				{
+					UInt32 first = mBusFirst[bus], count = mBusFirst[bus + 1] - first;
+					mBusBlocks[bus] = NULL;
+					if (count == 0) continue;
+					Float32 *mono = &mMonoBuffer[bus * size_t(mMonoFrames)];
+					OSStatus err = RenderMonoBus(first, count, mono, monoFrames);
+					if (err) return err;
+					mBusBlocks[bus] = mono;
+				}
+				GetAUInstrument()->MixMonoBuses(*buffArray[mOutputBus], &mBusBlocks[0], numBuses, inNumberFrames);
+			}
+		}
 	}
 	return noErr;
 }
 
+// renders inCount notes of the render list from inFirst into outMono, shared with the render workers
+// when there are enough of them
+OSStatus SynthGroupElement::RenderMonoBus(UInt32 inFirst, UInt32 inCount, Float32 *outMono, UInt32 inNumberFrames)
+{
+	mRenderFirst = inFirst;
+	mRenderCount = inCount;
+	mRenderMono = outMono;
+	VoiceRenderWorkers &workers = GetAUInstrument()->mRenderWorkers;
+	UInt32 numSlots = workers.NumSlots();
+	if (numSlots > 1 && inCount >= kMinSharedRenderNotes)
+	{
+		// every slot renders every numSlots'th note into its own block; NoteEnded() waits for the join
+		mRenderFrames = inNumberFrames;
+		mNumEndedNotes.store(0, std::memory_order_relaxed);
+		mRenderError.store(noErr, std::memory_order_relaxed);
+		mDeferNoteEnded = true;
+		workers.Run(RenderMonoShare, this);
+		mDeferNoteEnded = false;
+		
+		const CADSPKernels &kernels = GetAUInstrument()->DSPKernels();
+		for (UInt32 slot = 1; slot < numSlots; ++slot)
+			kernels.Add(workers.MixBuffer(slot), outMono, 1, inNumberFrames);
+		UInt32 numEnded = mNumEndedNotes.load(std::memory_order_relaxed);
+		for (UInt32 k = 0; k < numEnded; ++k)
+			NoteEnded(mEndedNotes[k].mNote, mEndedNotes[k].mFrame);
+		return mRenderError.load(std::memory_order_relaxed);
+	}
+	return RenderMonoNotes(0, 1, inNumberFrames, outMono);
+}
+
+// groups the render list by SynthNote::MonoBus(), keeping the notes' order within each bus, and
+// fills mBusFirst with where each bus's run starts
+void SynthGroupElement::SortRenderListByBus()
+{
+	UInt32 numBuses = UInt32(mBusBlocks.size());
+	std::fill(mBusFirst.begin(), mBusFirst.end(), 0);
+	for (UInt32 i = 0; i < mNumRenderNotes; ++i)
+		++mBusFirst[std::min(mRenderList[i]->MonoBus(), numBuses - 1) + 1];
+	for (UInt32 bus = 0; bus < numBuses; ++bus)
+	{
+		mBusFirst[bus + 1] += mBusFirst[bus];
+		mBusCursor[bus] = mBusFirst[bus];
+	}
+	for (UInt32 i = 0; i < mNumRenderNotes; ++i)
+		mSortedList[mBusCursor[std::min(mRenderList[i]->MonoBus(), numBuses - 1)]++] = mRenderList[i];
+	mRenderList.swap(mSortedList);
+}
+
+void SynthGroupElement::PrepareToRender(UInt32 inMaxFrames, UInt32 inMaxNotes, UInt32 inNumBuses)
+{
+	mMonoFrames = inMaxFrames;
+	mMonoBuffer.assign(inMaxFrames * size_t(inNumBuses), 0.f);
+	mBusBlocks.assign(inNumBuses, NULL);
+	mBusFirst.assign(inNumBuses + 1, 0);
+	mBusCursor.assign(inNumBuses, 0);
+	mRenderList.assign(inMaxNotes, NULL);
+	mSortedList.assign(inNumBuses > 1 ? inMaxNotes : 0, NULL);
+	mEndedNotes.resize(inMaxNotes);
+	// inMaxNotes is enough for a list's ranking to last a render cycle in all but the most extreme
+	// note shuffling, which rebuilds it
+	mRankStorage.resize(kNumberOfSoundingNoteStates * size_t(inMaxNotes));
+	for (UInt32 i = 0; i < kNumberOfSoundingNoteStates; ++i)
+		mNoteList[i].SetRankStorage(inMaxNotes ? &mRankStorage[i * size_t(inMaxNotes)] : NULL, inMaxNotes);
+	mNumRenderNotes = 0;
+}
+
+// zeroes outMono and renders every inStep'th note of the bus being rendered from inFirst into it, as one batch
+OSStatus SynthGroupElement::RenderMonoNotes(UInt32 inFirst, UInt32 inStep, UInt32 inNumberFrames, Float32 *outMono)
+{
+	memset(outMono, 0, inNumberFrames * sizeof(Float32));
+	if (inFirst >= mRenderCount) return noErr;
+	UInt32 numNotes = (mRenderCount - inFirst + inStep - 1) / inStep;
+	SynthNote **notes = &mRenderList[mRenderFirst + inFirst];
+	return notes[0]->RenderMonoNotes(notes, numNotes, inStep, mCurrentAbsoluteFrame, inNumberFrames, outMono);
+}
+
+void SynthGroupElement::RenderMonoShare(void *inGroup, UInt32 inSlot, UInt32 inNumSlots)
+{
+	SynthGroupElement *group = static_cast<SynthGroupElement *>(inGroup);
+	Float32 *out = inSlot == 0 ? group->mRenderMono : group->GetAUInstrument()->mRenderWorkers.MixBuffer(inSlot);
+	OSStatus err = group->RenderMonoNotes(inSlot, inNumSlots, group->mRenderFrames, out);
+	if (err) {
+		OSStatus none = noErr;
+		group->mRenderError.compare_exchange_strong(none, err, std::memory_order_relaxed);
+	}
+}
+
+// adds the mono block to every channel of the bus, interleaved or not
+void SynthGroupElement::MixMonoIntoBus(const CADSPKernels &inKernels, AudioBufferList &ioBus, const Float32 *inMono,
+									   UInt32 inNumberFrames)
+{
+	for (UInt32 k = 0; k < ioBus.mNumberBuffers; ++k)
+	{
+		AudioBuffer &buffer = ioBus.mBuffers[k];
+		Float32 *out = (Float32 *)buffer.mData;
+		UInt32 stride = buffer.mNumberChannels;
+		for (UInt32 channel = 0; channel < stride; ++channel)
+			inKernels.Add(inMono, out + channel, stride, inNumberFrames);
+	}
+}
+
 
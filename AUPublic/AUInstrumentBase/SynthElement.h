@@ -13,6 +13,9 @@ Part of Core Audio AUInstrument Base Classes
 #include "MusicDeviceBase.h"
 #include "SynthNoteList.h"
 #include "MIDIControlHandler.h"
+#include "CADSPKernels.h"
+#include <atomic>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 class AUInstrumentBase;
@@ -104,7 +107,8 @@ class SynthGroupElement : public SynthElement
 {
 public:
 	enum {
-		kUnassignedGroup = 0xFFFFFFFF
+		kUnassignedGroup = 0xFFFFFFFF,
+		kMinSharedRenderNotes = 32		// fewer mono notes than this render faster on the render thread alone
 	};
 	
 	SynthGroupElement(AUInstrumentBase *audioUnit, UInt32 inElement, MIDIControlHandler *inHandler);
@@ -129,8 +133,16 @@ public:
 	
 	void					Reset();
 	
+	// true while any note is in one of the group's lists, released notes' tails included
+	bool					IsSounding() const;
+	
 	virtual OSStatus		Render(SInt64 inAbsoluteSampleFrame, UInt32 inNumberFrames, AUScope &outputs);
 	
+	// sizes the scratch for notes that render mono (see SynthNote::CanRenderMono), one block for each of
+	// inNumBuses mono buses, for sharing up to inMaxNotes of them with the instrument's voice render
+	// workers and for ranking them for voice stealing; not real-time safe.
+	void					PrepareToRender(UInt32 inMaxFrames, UInt32 inMaxNotes, UInt32 inNumBuses = 1);
+	
 	float					GetPitchBend() const { return mMidiControlHandler->GetPitchBend(); }
 	SInt64					GetCurrentAbsoluteFrame() const { return mCurrentAbsoluteFrame; }
 	
@@ -145,6 +157,19 @@ protected:
 	MIDIControlHandler		*mMidiControlHandler;
 
 private:
+	static void				MixMonoIntoBus(const CADSPKernels &inKernels, AudioBufferList &ioBus, const Float32 *inMono,
+										   UInt32 inNumberFrames);
+	static void				RenderMonoShare(void *inGroup, UInt32 inSlot, UInt32 inNumSlots);
+	OSStatus				RenderMonoBus(UInt32 inFirst, UInt32 inCount, Float32 *outMono, UInt32 inNumberFrames);
+	OSStatus				RenderMonoNotes(UInt32 inFirst, UInt32 inStep, UInt32 inNumberFrames, Float32 *outMono);
+	void					SortRenderListByBus();
+
+	struct EndedNote
+	{
+		SynthNote *			mNote;
+		UInt32				mFrame;
+	};
+
 	friend class AUInstrumentBase;
 	friend class AUMonotimbralInstrumentBase;
 	friend class AUMultitimbralInstrumentBase;
@@ -153,6 +178,28 @@ private:
 	bool					mSostenutoIsOn;
 	UInt32					mOutputBus;
 	MusicDeviceGroupID		mGroupID;
+	std::vector<Float32>	mMonoBuffer;	// mMonoFrames for each mono bus
+	UInt32					mMonoFrames;
+	std::vector<SynthNoteRank> mRankStorage;	// voice stealing rankings of the note lists
+	
+	// the mono notes of the current cycle, and the NoteEnded() calls they made while shared with workers
+	std::vector<SynthNote*>	mRenderList;
+	UInt32					mNumRenderNotes;
+	UInt32					mRenderFirst;	// the render list run of the bus being rendered
+	UInt32					mRenderCount;
+	Float32 *				mRenderMono;	// and its block
+	UInt32					mRenderFrames;
+	std::vector<EndedNote>	mEndedNotes;
+	std::atomic<UInt32>		mNumEndedNotes;
+	std::atomic<OSStatus>	mRenderError;
+	bool					mDeferNoteEnded;
+	
+	// with more than one mono bus, the render list sorted by bus, where each bus's run starts in it,
+	// and the blocks handed to AUInstrumentBase::MixMonoBuses()
+	std::vector<SynthNote*>	mSortedList;
+	std::vector<UInt32>		mBusFirst;		// one more than the buses
+	std::vector<UInt32>		mBusCursor;
+	std::vector<const Float32 *> mBusBlocks;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -168,22 +215,45 @@ struct SynthKeyZone
 
 const UInt32 kUnlimitedPolyphony = 0xFFFFFFFF;
 
+/*
+	A part plays the notes of the group, the MIDI channel, it is bound to (part N starts out on
+	channel N) that fall in its key zone. In an AUMultitimbralInstrumentBase each part also owns a
+	contiguous run of the instrument's notes, its voice pool, with a free list and an active count of
+	its own (see AUMultitimbralInstrumentBase::SetPartNotes).
+*/
 class SynthPartElement : public SynthElement
 {
 public:
 	SynthPartElement(AUInstrumentBase *audioUnit, UInt32 inElement);
 
 	UInt32		GetGroupIndex() const { return mGroupIndex; }
+	void		SetGroupIndex(UInt32 inGroupIndex) { mGroupIndex = inGroupIndex; }
 	bool		InRange(Float32 inNote, Float32 inVelocity);
 	
 	UInt32		GetMaxPolyphony() const { return mMaxPolyphony; }
 	void		SetMaxPolyphony(UInt32 inMaxPolyphony) { mMaxPolyphony = inMaxPolyphony; }
 	
+	const SynthKeyZone &	GetKeyZone() const { return mKeyZone; }
+	void		SetKeyZone(const SynthKeyZone &inKeyZone) { mKeyZone = inKeyZone; }
+	
+	// the part's voice pool: its first note's index among the instrument's, and how many it has
+	UInt32		FirstNote() const { return mFirstNote; }
+	UInt32		NumNotes() const { return mNumNotes; }
+	// of the pool's notes, those sounding and not yet fast-released
+	UInt32		NumActiveNotes() const { return mNumActiveNotes; }
+	
 private:
+	friend class AUInstrumentBase;
+	friend class AUMultitimbralInstrumentBase;
+	
 	UInt32							mGroupIndex;
 	UInt32							mPatchIndex;
 	UInt32							mMaxPolyphony;
 	SynthKeyZone					mKeyZone;	
+	UInt32							mFirstNote;
+	UInt32							mNumNotes;
+	UInt32							mNumActiveNotes;
+	SynthNoteList					mFreeNotes;
 };
 
 #endif
@@ -48,6 +48,17 @@ void SynthNote::Reset()
 	mRelativeKillFrame = -1;
 }
 
+OSStatus SynthNote::RenderMonoNotes(SynthNote *const *inNotes, UInt32 inNumNotes, UInt32 inStep,
+									UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono)
+{
+	for (UInt32 i = 0; i < inNumNotes; ++i)
+	{
+		OSStatus err = inNotes[i * inStep]->RenderMono(inAbsoluteSampleFrame, inNumFrames, ioMono);
+		if (err) return err;
+	}
+	return noErr;
+}
+
 void SynthNote::Kill(UInt32 inFrame)
 {
 	mRelativeKillFrame = inFrame;
@@ -85,7 +96,12 @@ AUInstrumentBase* SynthNote::GetAudioUnit() const
 
 Float32 SynthNote::GetGlobalParameter(AudioUnitParameterID inParamID) const 
 {
-	return mGroup->GetAudioUnit()->Globals()->GetParameter(inParamID);
+	return GetAudioUnit()->GetGlobalParameter(inParamID);
+}
+
+Float32 SynthNote::GetGlobalParameterEnd(AudioUnitParameterID inParamID) const 
+{
+	return GetAudioUnit()->GetGlobalParameterEnd(inParamID);
 }
 
 void SynthNote::NoteEnded(UInt32 inFrame) 
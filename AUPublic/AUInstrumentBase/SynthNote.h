@@ -12,6 +12,7 @@ Part of Core Audio AUInstrument Base Classes
 #include <AudioUnit/AudioUnit.h>
 #include <CoreAudio/CoreAudio.h>
 #include "MusicDeviceBase.h"
+#include "SmoothedParameter.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -85,6 +86,21 @@ struct SynthNote
 							);
 								
 	virtual OSStatus		Render(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, AudioBufferList** inBufferList, UInt32 inOutBusCount) = 0;
+	
+	// A note that sounds the same on every channel can return true and implement RenderMono(), which
+	// accumulates into one block; its group then fans that block out to all channels of its output bus
+	// once, instead of every note writing every channel.
+	virtual bool			CanRenderMono() const { return false; }
+	virtual OSStatus		RenderMono(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono) { return kAudio_UnimplementedError; }
+	// With AUInstrumentBase::SetMonoBuses() above 1, the block a mono note renders into; the group
+	// renders each bus's notes together and the instrument mixes the buses into the channels.
+	virtual UInt32			MonoBus() const { return 0; }
+	// The group renders its mono notes with one call on the first of them: inNotes[0], inNotes[inStep] ...
+	// up to inNumNotes entries. All of an instrument's notes come from the array handed to SetNotes, so
+	// they share a class, and a simple instrument can override this to render them all in one batch out
+	// of its own voice storage. The default renders them one after the other with RenderMono().
+	virtual OSStatus		RenderMonoNotes(SynthNote *const *inNotes, UInt32 inNumNotes, UInt32 inStep,
+											UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono);
 	//! Returns true if active note resulted from this call, otherwise false
 	virtual bool			Attack(const MusicDeviceNoteParams &inParams) = 0;
 	virtual void			Kill(UInt32 inFrame); // voice is being stolen.
@@ -99,7 +115,13 @@ struct SynthNote
 	
 	AUInstrumentBase*		GetAudioUnit() const;
 
+	// from the instrument's snapshot for this render call (see AUInstrumentBase::GlobalParameters)
 	Float32					GetGlobalParameter(AudioUnitParameterID inParamID) const;
+	// the value on the last frame of this render call, where a scheduled ramp has taken it
+	Float32					GetGlobalParameterEnd(AudioUnitParameterID inParamID) const;
+	// reads a global parameter once per render call as a ramp from its value in the previous call
+	void					BeginSmoothedGlobalParameter(SmoothedParameter &ioParam, AudioUnitParameterID inParamID, UInt32 inNumFrames) const
+								{ ioParam.BeginBlock(GetGlobalParameterEnd(inParamID), inNumFrames); }
 
 	NoteInstanceID			GetNoteID() const { return mNoteID; }
 	SynthNoteState			GetState() const { return mState; }
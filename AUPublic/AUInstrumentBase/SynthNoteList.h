@@ -10,6 +10,7 @@ Part of Core Audio AUInstrument Base Classes
 #define __SynthNoteList__
 
 #include "SynthNote.h"
+#include <algorithm>
 
 #if DEBUG
 #ifndef DEBUG_PRINT
@@ -20,9 +21,27 @@ Part of Core Audio AUInstrument Base Classes
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// one entry of a note list's voice stealing ranking; the note ID at ranking time detects reused notes
+struct SynthNoteRank
+{
+	Float32			mAmplitude;
+	UInt64			mStartFrame;
+	SynthNote *		mNote;
+	NoteInstanceID	mNoteID;
+	
+	// heap order: the quietest note, then the oldest, comes out first
+	bool operator < (const SynthNoteRank &inOther) const
+	{
+		if (mAmplitude != inOther.mAmplitude) return mAmplitude > inOther.mAmplitude;
+		return mStartFrame > inOther.mStartFrame;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 struct SynthNoteList
 {
-	SynthNoteList() : mState(kNoteState_Unset), mHead(0), mTail(0) {}
+	SynthNoteList() : mState(kNoteState_Unset), mHead(0), mTail(0), mRank(0), mRankCapacity(0), mRankSize(0), mRankValid(false) {}
 	
 	bool NotEmpty() const { return mHead != NULL; }
 	bool IsEmpty() const { return mHead == NULL; }
@@ -31,6 +50,7 @@ struct SynthNoteList
 		SanityCheck();
 #endif
 		mHead = mTail = NULL; 
+		InvalidateRank();
 	}
 	
 	UInt32 Length() const {
@@ -57,6 +77,7 @@ struct SynthNoteList
 		
 		if (mHead) { mHead->mPrev = inNote; mHead = inNote; }
 		else mHead = mTail = inNote;
+		if (mRankValid) RankNote(inNote);
 #if USE_SANITY_CHECK
 		SanityCheck();
 #endif
@@ -122,6 +143,8 @@ struct SynthNoteList
 		
 		inNoteList->mHead = NULL;
 		inNoteList->mTail = NULL;
+		InvalidateRank();
+		inNoteList->InvalidateRank();
 #if USE_SANITY_CHECK
 		SanityCheck();
 		inNoteList->SanityCheck();
@@ -182,11 +205,69 @@ struct SynthNoteList
 		return mostQuietNote;
 	}
 	
+	/*
+		PopMostQuietNote() finds the same note as FindMostQuietNote() without walking the list every
+		time. The first call ranks every note by Amplitude() into a heap; later calls pop it in
+		O(log n), and notes added meanwhile are ranked as they arrive. Notes that left the list are
+		skipped when they come out. Amplitudes only change while notes render, so the owner calls
+		InvalidateRank() after every render cycle. The caller removes the returned note from the
+		list, exactly as it would after FindMostQuietNote().
+		
+		The ranking lives in storage handed over by SetRankStorage(), off the render thread; a list
+		without it (or whose ranking overflowed) falls back to FindMostQuietNote().
+	*/
+	void SetRankStorage(SynthNoteRank *inRank, UInt32 inCapacity)
+	{
+		mRank = inRank;
+		mRankCapacity = inCapacity;
+		InvalidateRank();
+	}
+	
+	void InvalidateRank() { mRankValid = false; mRankSize = 0; }
+	
+	SynthNote* PopMostQuietNote()
+	{
+		if (!mRankValid)
+		{
+			if (mRankCapacity == 0) return FindMostQuietNote();
+			mRankValid = true;
+			for (SynthNote* note = mHead; note && mRankValid; note = note->mNext)
+				RankNote(note, false);
+			if (!mRankValid) return FindMostQuietNote();
+			std::make_heap(mRank, mRank + mRankSize);
+		}
+		while (mRankSize)
+		{
+			std::pop_heap(mRank, mRank + mRankSize);
+			const SynthNoteRank &rank = mRank[--mRankSize];
+			if (rank.mNote->GetState() == mState && rank.mNote->mNoteID == rank.mNoteID)
+				return rank.mNote;
+		}
+		return FindMostQuietNote();
+	}
+	
 	void SanityCheck() const;
 	
 	SynthNoteState	mState;
 	SynthNote *		mHead;
 	SynthNote *		mTail;
+	
+private:
+	void RankNote(SynthNote *inNote, bool inKeepHeap = true)
+	{
+		if (mRankSize == mRankCapacity) { InvalidateRank(); return; }
+		SynthNoteRank &rank = mRank[mRankSize++];
+		rank.mAmplitude = inNote->Amplitude();
+		rank.mStartFrame = inNote->mAbsoluteStartFrame;
+		rank.mNote = inNote;
+		rank.mNoteID = inNote->mNoteID;
+		if (inKeepHeap) std::push_heap(mRank, mRank + mRankSize);
+	}
+	
+	SynthNoteRank *	mRank;
+	UInt32			mRankCapacity;
+	UInt32			mRankSize;
+	bool			mRankValid;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
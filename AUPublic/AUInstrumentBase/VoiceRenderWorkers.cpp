@@ -0,0 +1,131 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Real-time worker threads that share the voices of one render cycle
+*/
+
+#include "VoiceRenderWorkers.h"
+#include "CAHostTimeBase.h"
+#include "CADenormalGuard.h"
+
+#if __APPLE__
+	#include <mach/thread_policy.h>
+	#include <pthread.h>
+#endif
+
+VoiceRenderSemaphore::VoiceRenderSemaphore()
+{
+#if __APPLE__
+	semaphore_create(mach_task_self(), &mSemaphore, SYNC_POLICY_FIFO, 0);
+#else
+	sem_init(&mSemaphore, 0, 0);
+#endif
+}
+
+VoiceRenderSemaphore::~VoiceRenderSemaphore()
+{
+#if __APPLE__
+	semaphore_destroy(mach_task_self(), mSemaphore);
+#else
+	sem_destroy(&mSemaphore);
+#endif
+}
+
+void VoiceRenderSemaphore::Signal()
+{
+#if __APPLE__
+	semaphore_signal(mSemaphore);
+#else
+	sem_post(&mSemaphore);
+#endif
+}
+
+void VoiceRenderSemaphore::Wait()
+{
+#if __APPLE__
+	while (semaphore_wait(mSemaphore) == KERN_ABORTED) {}
+#else
+	while (sem_wait(&mSemaphore) != 0) {}
+#endif
+}
+
+VoiceRenderWorkers::VoiceRenderWorkers()
+	: mMaxFrames(0), mPeriod(0), mJob(NULL), mContext(NULL), mFlushDenormals(false), mPending(0), mQuit(false)
+{
+}
+
+VoiceRenderWorkers::~VoiceRenderWorkers()
+{
+	Stop();
+}
+
+void VoiceRenderWorkers::Start(UInt32 inNumWorkers, UInt32 inMaxFrames, Float64 inSampleRate)
+{
+	Stop();
+	if (inNumWorkers == 0) return;
+
+	mMaxFrames = inMaxFrames;
+	mMixBuffers.assign(size_t(inNumWorkers) * inMaxFrames, 0.f);
+	mPeriod = CAHostTimeBase::ConvertFromNanos(UInt64(1.0e9 * inMaxFrames / inSampleRate));
+	mQuit = false;
+	for (UInt32 i = 0; i < inNumWorkers; ++i)
+		mWorkers.push_back(new Worker);
+	for (UInt32 i = 0; i < inNumWorkers; ++i)
+		mWorkers[i]->mThread = std::thread(&VoiceRenderWorkers::WorkerThread, this, i + 1);
+}
+
+void VoiceRenderWorkers::Stop()
+{
+	if (mWorkers.empty()) return;
+	mQuit = true;
+	for (Worker *worker : mWorkers)
+		worker->mWake.Signal();
+	for (Worker *worker : mWorkers) {
+		worker->mThread.join();
+		delete worker;
+	}
+	mWorkers.clear();
+	mMixBuffers.clear();
+}
+
+void VoiceRenderWorkers::Run(Job inJob, void *inContext)
+{
+	UInt32 numSlots = NumSlots();
+	mJob = inJob;
+	mContext = inContext;
+	mFlushDenormals = CADenormalGuard::IsFlushing();
+	mPending.store(numSlots - 1, std::memory_order_relaxed);
+	for (Worker *worker : mWorkers)
+		worker->mWake.Signal();
+
+	inJob(inContext, 0, numSlots);
+
+	// the workers run at the same priority and have about the same share; spin rather than sleep
+	while (mPending.load(std::memory_order_acquire) != 0)
+		std::this_thread::yield();
+}
+
+void VoiceRenderWorkers::WorkerThread(UInt32 inSlot)
+{
+#if __APPLE__
+	// same class of deadline as the render thread: most of a cycle to finish a share of it
+	thread_time_constraint_policy_data_t policy;
+	policy.period = UInt32(mPeriod);
+	policy.computation = UInt32(mPeriod / 2);
+	policy.constraint = UInt32(mPeriod);
+	policy.preemptible = true;
+	thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY, (thread_policy_t)&policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+#endif
+	Worker *worker = mWorkers[inSlot - 1];
+	for (;;) {
+		worker->mWake.Wait();
+		if (mQuit) break;
+		{
+			// the share runs in the same floating point mode as the render thread's
+			CADenormalGuard denormalGuard(mFlushDenormals);
+			mJob(mContext, inSlot, NumSlots());
+		}
+		mPending.fetch_sub(1, std::memory_order_release);
+	}
+}
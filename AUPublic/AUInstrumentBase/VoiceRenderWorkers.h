@@ -0,0 +1,94 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Real-time worker threads that share the voices of one render cycle
+*/
+
+#ifndef __VoiceRenderWorkers__
+#define __VoiceRenderWorkers__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if __APPLE__
+	#include <mach/mach.h>
+	#include <mach/semaphore.h>
+#else
+	#include <semaphore.h>
+#endif
+
+// wakes a worker from the render thread without taking a lock
+class VoiceRenderSemaphore
+{
+public:
+						VoiceRenderSemaphore();
+						~VoiceRenderSemaphore();
+	void				Signal();
+	void				Wait();
+private:
+	VoiceRenderSemaphore(const VoiceRenderSemaphore &);
+	VoiceRenderSemaphore & operator=(const VoiceRenderSemaphore &);
+#if __APPLE__
+	semaphore_t			mSemaphore;
+#else
+	sem_t				mSemaphore;
+#endif
+};
+
+/*
+	VoiceRenderWorkers is a fork-join pool for the render thread. Run() hands a job to every worker,
+	runs slot 0 of it on the calling thread, and returns once all slots are done, so a render cycle
+	can split its voices into NumSlots() disjoint shares. Each worker slot has its own mix buffer.
+	The workers flush denormals to zero for a job whenever the thread calling Run() does.
+
+	Start() and Stop() allocate, create and join threads; call them off the render thread, while the
+	AU is uninitialized or initializing. Run() blocks only on the other slots finishing.
+*/
+class VoiceRenderWorkers
+{
+public:
+	typedef void		(*Job)(void *inContext, UInt32 inSlot, UInt32 inNumSlots);
+
+						VoiceRenderWorkers();
+						~VoiceRenderWorkers();
+
+	void				Start(UInt32 inNumWorkers, UInt32 inMaxFrames, Float64 inSampleRate);
+	void				Stop();
+
+	UInt32				NumSlots() const { return UInt32(mWorkers.size()) + 1; }
+
+	// scratch block of slot inSlot (1 ... NumSlots() - 1); slot 0 mixes into the caller's own buffer
+	Float32 *			MixBuffer(UInt32 inSlot) { return &mMixBuffers[(inSlot - 1) * mMaxFrames]; }
+
+	void				Run(Job inJob, void *inContext);
+
+private:
+	struct Worker
+	{
+		std::thread				mThread;
+		VoiceRenderSemaphore	mWake;
+	};
+
+	void				WorkerThread(UInt32 inSlot);
+
+	std::vector<Worker *>	mWorkers;
+	std::vector<Float32>	mMixBuffers;
+	UInt32					mMaxFrames;
+	UInt64					mPeriod;			// host time units per render cycle, for the thread policy
+
+	Job						mJob;
+	void *					mContext;
+	bool					mFlushDenormals;	// whether the render thread flushes denormals to zero
+	std::atomic<UInt32>		mPending;			// slots still running this cycle
+	std::atomic<bool>		mQuit;
+};
+
+#endif
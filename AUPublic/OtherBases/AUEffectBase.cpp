@@ -7,6 +7,21 @@ Part of Core Audio AUBase Classes
 */
 
 #include "AUEffectBase.h"
+#include <algorithm>
+
+static const Float64 kDefaultBypassCrossfadeTime = 0.01;	// seconds; short enough to feel instant
+
+// true if every buffer of the output is the input's own: the output was pointed at the input to
+// process in place, or the host handed the unit the buffers it pulled
+static bool	BuffersAlias(const AudioBufferList &inInput, const AudioBufferList &inOutput)
+{
+	if (inInput.mNumberBuffers != inOutput.mNumberBuffers)
+		return false;
+	for (UInt32 i = 0; i < inInput.mNumberBuffers; ++i)
+		if (inInput.mBuffers[i].mData != inOutput.mBuffers[i].mData)
+			return false;
+	return true;
+}
 
 /* 
 	This class does not deal as well as it should with N-M effects...
@@ -26,10 +41,15 @@ AUEffectBase::AUEffectBase(	AudioComponentInstance	audioUnit,
 	mBypassEffect(false),
 	mParamSRDep (false),
 	mProcessesInPlace(inProcessesInPlace),
-	mMainOutput(NULL), mMainInput(NULL)
+	mMultiChannelKernel(NULL),
+	mMainOutput(NULL), mMainInput(NULL),
 #if TARGET_OS_IPHONE
-	, mOnlyOneKernel(false)
+	mOnlyOneKernel(false),
 #endif
+	mBypassCrossfadeTime(kDefaultBypassCrossfadeTime),
+	mBypassCrossfadeFrames(0),
+	mBypassMix(1.f),
+	mDefersKernels(false)
 {
 }
 
@@ -44,10 +64,14 @@ AUEffectBase::~AUEffectBase()
 //
 void AUEffectBase::Cleanup()
 {
+		// a prepare under way on the helper thread finishes before the kernels go
+	mPreparedKernels.Cancel();
 	for (KernelList::iterator it = mKernelList.begin(); it != mKernelList.end(); ++it)
 		delete *it;
 		
 	mKernelList.clear();
+	delete mMultiChannelKernel;
+	mMultiChannelKernel = NULL;
 	mMainOutput = NULL;
 	mMainInput = NULL;
 }
@@ -113,8 +137,6 @@ OSStatus AUEffectBase::Initialize()
 		}
     }
 
-    MaintainKernels();
-	
 	mMainOutput = GetOutput(0);
 	mMainInput = GetInput(0);
 	
@@ -122,19 +144,41 @@ OSStatus AUEffectBase::Initialize()
 	format.IdentifyCommonPCMFormat(mCommonPCMFormat, NULL);
 	mBytesPerFrame = format.mBytesPerFrame;
 	
+	mBypassCrossfadeFrames = UInt32(mBypassCrossfadeTime * format.mSampleRate + 0.5);
+	mBypassMix = ShouldBypassEffect() ? 0.f : 1.f;
+
+		// deferred, the unit starts out bypassed, and comes in from there once prepared
+	if (mDefersKernels) {
+		mBypassMix = 0.f;
+		mPreparedKernels.Defer(PrepareDeferredKernels, this);
+	} else
+		mPreparedKernels.PrepareNow(PrepareDeferredKernels, this);
+	
     return noErr;
 }
 
 OSStatus			AUEffectBase::Reset(		AudioUnitScope 		inScope,
 								 				AudioUnitElement 	inElement)
 {
+	ResetKernels();
+	return AUBase::Reset(inScope, inElement);
+}
+
+void				AUEffectBase::ResetKernels()
+{
+		// nothing to reset before they are prepared, and the helper thread may be preparing them
+	if (!mPreparedKernels.IsReady())
+		return;
 	for (KernelList::iterator it = mKernelList.begin(); it != mKernelList.end(); ++it) {
 		AUKernelBase *kernel = *it;
 		if (kernel != NULL)
 			kernel->Reset();
 	}
-	
-	return AUBase::Reset(inScope, inElement);
+	if (mMultiChannelKernel != NULL)
+		mMultiChannelKernel->Reset();
+	for (size_t i = 0; i < mKernelTimeouts.size(); ++i)
+		mKernelTimeouts[i].Reset();
+	mMultiChannelTimeout.Reset();
 }
 
 OSStatus			AUEffectBase::GetPropertyInfo (AudioUnitPropertyID	inID,
@@ -192,13 +236,9 @@ OSStatus			AUEffectBase::SetProperty(		AudioUnitPropertyID inID,
 					return kAudioUnitErr_InvalidPropertyValue;
 					
 				bool tempNewSetting = *((UInt32*)inData) != 0;
-					// we're changing the state of bypass
+					// the render thread fades to the new state, and resets the kernels as it leaves bypass
 				if (tempNewSetting != IsBypassEffect()) 
-				{
-					if (!tempNewSetting && IsBypassEffect() && IsInitialized()) // turning bypass off and we're initialized
-						Reset(0, 0);
 					SetBypassEffect (tempNewSetting);
-				}
 				return noErr;
 			}
 			case kAudioUnitProperty_InPlaceProcessing:
@@ -210,6 +250,18 @@ OSStatus			AUEffectBase::SetProperty(		AudioUnitPropertyID inID,
 }
  
 
+void	AUEffectBase::PrepareKernels()
+{
+	MaintainKernels();
+
+		// a fade needs the dry input of a whole cycle kept aside, which only Float32 N-N effects get
+	UInt32 numInputs = GetInput(0)->GetStreamFormat().mChannelsPerFrame;
+	if (mCommonPCMFormat == CAStreamBasicDescription::kPCMFormatFloat32 && numInputs == GetNumberOfChannels())
+		mBypassDry.assign(size_t(GetMaxFramesPerSlice()) * numInputs, 0.f);
+	else
+		mBypassDry.clear();
+}
+
 void	AUEffectBase::MaintainKernels()
 {
 #if TARGET_OS_IPHONE
@@ -236,6 +288,17 @@ void	AUEffectBase::MaintainKernels()
 			mKernelList[i]->SetChannelNum (i);
 		}
 	}
+
+	UInt32 nChannels = GetNumberOfChannels();
+	if (mMultiChannelKernel == NULL || mMultiChannelKernel->GetNumberOfChannels() != nChannels) {
+		delete mMultiChannelKernel;
+		mMultiChannelKernel = NewMultiChannelKernel(nChannels);
+	}
+	mChannelSources.assign(mMultiChannelKernel ? nChannels : 0, NULL);
+	mChannelDests.assign(mMultiChannelKernel ? nChannels : 0, NULL);
+	mKernelTimeouts.assign(nKernels, AUSilentTimeout());
+	mKernelSilent.assign(nKernels, 0);
+	mMultiChannelTimeout.Reset();
 }
 
 bool		AUEffectBase::StreamFormatWritable(	AudioUnitScope					scope,
@@ -323,71 +386,133 @@ OSStatus 	AUEffectBase::Render(	AudioUnitRenderActionFlags &ioActionFlags,
 	
 	if (result == noErr)
 	{
+			// the first sound asks for deferred kernels, and the effect stays bypassed until they come
+		const bool prepared = mPreparedKernels.IsReady();
+		if (!prepared && !ShouldBypassEffect() && !(ioActionFlags & kAudioUnitRenderAction_OutputIsSilence))
+			mPreparedKernels.Request();
+		const Float32 bypassTarget = (!prepared || ShouldBypassEffect()) ? 0.f : 1.f;
+		if (mBypassMix != bypassTarget)
+		{
+				// leaving bypass, the kernels start afresh; without a fade the switch is immediate
+			if (mBypassMix == 0.f)
+				ResetKernels();
+			if (!SaveBypassDry(nFrames))
+				mBypassMix = bypassTarget;
+		}
+
+		if (mBypassMix == 0.f)
+		{
+			// steady bypass: no kernels, and the input itself is the output wherever the output
+			// may point at it, or already does; leave silence bit alone
+			if (mMainOutput->WillAllocateBuffer())
+				mMainOutput->SetBufferList(mMainInput->GetBufferList() );
+			else if (!BuffersAlias(mMainInput->GetBufferList(), mMainOutput->GetBufferList()))
+				mMainInput->CopyBufferContentsTo (mMainOutput->GetBufferList());
+			return noErr;
+		}
+
 		if(ProcessesInPlace() && mMainOutput->WillAllocateBuffer())
 		{
 			mMainOutput->SetBufferList(mMainInput->GetBufferList() );
 		}
 
-		if (ShouldBypassEffect())
+		if(mParamList.size() == 0 )
 		{
-			// leave silence bit alone
-			
-			if(!ProcessesInPlace() )
-			{
-				mMainInput->CopyBufferContentsTo (mMainOutput->GetBufferList());
-			}
+			// this will read/write silence bit
+			result = ProcessBufferLists(ioActionFlags, mMainInput->GetBufferList(), mMainOutput->GetBufferList(), nFrames);
 		}
 		else
 		{
-			if(mParamList.size() == 0 )
-			{
-				// this will read/write silence bit
-				result = ProcessBufferLists(ioActionFlags, mMainInput->GetBufferList(), mMainOutput->GetBufferList(), nFrames);
+			// deal with scheduled parameters...
+			
+			AudioBufferList &inputBufferList = mMainInput->GetBufferList();
+			AudioBufferList &outputBufferList = mMainOutput->GetBufferList();
+			
+			ScheduledProcessParams processParams;
+			processParams.actionFlags = &ioActionFlags;
+			processParams.inputBufferList = &inputBufferList;
+			processParams.outputBufferList = &outputBufferList;
+
+			// divide up the buffer into slices according to scheduled params then
+			// do the DSP for each slice (ProcessScheduledSlice() called for each slice)
+			result = ProcessForScheduledParams(	mParamList,
+												nFrames,
+												&processParams );
+
+			
+			// fixup the buffer pointers to how they were before we started
+			UInt32 channelSize = nFrames * mBytesPerFrame;
+			for(unsigned int i = 0; i < inputBufferList.mNumberBuffers; i++ ) {
+				UInt32 size = inputBufferList.mBuffers[i].mNumberChannels * channelSize;
+				inputBufferList.mBuffers[i].mData = (char *)inputBufferList.mBuffers[i].mData - size;
+				inputBufferList.mBuffers[i].mDataByteSize = size;
 			}
-			else
-			{
-				// deal with scheduled parameters...
-				
-				AudioBufferList &inputBufferList = mMainInput->GetBufferList();
-				AudioBufferList &outputBufferList = mMainOutput->GetBufferList();
-				
-				ScheduledProcessParams processParams;
-				processParams.actionFlags = &ioActionFlags;
-				processParams.inputBufferList = &inputBufferList;
-				processParams.outputBufferList = &outputBufferList;
-	
-				// divide up the buffer into slices according to scheduled params then
-				// do the DSP for each slice (ProcessScheduledSlice() called for each slice)
-				result = ProcessForScheduledParams(	mParamList,
-													nFrames,
-													&processParams );
-	
-				
-				// fixup the buffer pointers to how they were before we started
-				UInt32 channelSize = nFrames * mBytesPerFrame;
-				for(unsigned int i = 0; i < inputBufferList.mNumberBuffers; i++ ) {
-					UInt32 size = inputBufferList.mBuffers[i].mNumberChannels * channelSize;
-					inputBufferList.mBuffers[i].mData = (char *)inputBufferList.mBuffers[i].mData - size;
-					inputBufferList.mBuffers[i].mDataByteSize = size;
-				}
-				
-				for(unsigned int i = 0; i < outputBufferList.mNumberBuffers; i++ ) {
-					UInt32 size = outputBufferList.mBuffers[i].mNumberChannels * channelSize;
-					outputBufferList.mBuffers[i].mData = (char *)outputBufferList.mBuffers[i].mData - size;
-					outputBufferList.mBuffers[i].mDataByteSize = size;
-				}
+			
+			for(unsigned int i = 0; i < outputBufferList.mNumberBuffers; i++ ) {
+				UInt32 size = outputBufferList.mBuffers[i].mNumberChannels * channelSize;
+				outputBufferList.mBuffers[i].mData = (char *)outputBufferList.mBuffers[i].mData - size;
+				outputBufferList.mBuffers[i].mDataByteSize = size;
 			}
 		}
 	
-		if ( (ioActionFlags & kAudioUnitRenderAction_OutputIsSilence) && !ProcessesInPlace() )
+		// silence left in the input's own buffers is already zero; a buffer of the host's, even for a
+		// unit that processes in place, holds whatever it last did
+		if ( (ioActionFlags & kAudioUnitRenderAction_OutputIsSilence)
+			&& !BuffersAlias(mMainInput->GetBufferList(), mMainOutput->GetBufferList()) )
 		{
 			AUBufferList::ZeroBuffer(mMainOutput->GetBufferList() );
 		}
+
+		if (result == noErr && mBypassMix != bypassTarget)
+			MixBypassDry(bypassTarget, ioActionFlags, nFrames);
 	}
 	
 	return result;
 }
 
+// keeps the cycle's input for the crossfade, before processing in place overwrites it; false if
+// this effect or this cycle cannot fade
+bool		AUEffectBase::SaveBypassDry(UInt32 inFramesToProcess)
+{
+	const AudioBufferList &input = mMainInput->GetBufferList();
+	const AudioBufferList &output = mMainOutput->GetBufferList();
+	if (mBypassCrossfadeFrames == 0 || mBypassDry.empty() || input.mNumberBuffers != output.mNumberBuffers)
+		return false;
+	size_t offset = 0;
+	for (UInt32 i = 0; i < input.mNumberBuffers; ++i) {
+		const size_t n = size_t(inFramesToProcess) * input.mBuffers[i].mNumberChannels;
+		if (input.mBuffers[i].mNumberChannels != output.mBuffers[i].mNumberChannels || offset + n > mBypassDry.size())
+			return false;
+		memcpy(&mBypassDry[offset], input.mBuffers[i].mData, n * sizeof(Float32));
+		offset += n;
+	}
+	return true;
+}
+
+// moves the effect's share of the output toward inTarget, a step a frame, blending the processed
+// output with the dry input SaveBypassDry kept
+void		AUEffectBase::MixBypassDry(	Float32							inTarget,
+										AudioUnitRenderActionFlags &	ioActionFlags,
+										UInt32							inFramesToProcess )
+{
+	const AudioBufferList &output = mMainOutput->GetBufferList();
+	const Float32 step = 1.f / mBypassCrossfadeFrames;
+	const Float32 *dry = &mBypassDry[0];
+	Float32 mix = mBypassMix;
+	for (UInt32 i = 0; i < output.mNumberBuffers; ++i) {
+		const UInt32 numChannels = output.mBuffers[i].mNumberChannels;
+		Float32 *wet = (Float32 *)output.mBuffers[i].mData;
+		mix = mBypassMix;
+		for (UInt32 frame = 0; frame < inFramesToProcess; ++frame) {
+			mix = inTarget > mix ? std::min(mix + step, inTarget) : std::max(mix - step, inTarget);
+			for (UInt32 channel = 0; channel < numChannels; ++channel, ++wet, ++dry)
+				*wet = *dry + mix * (*wet - *dry);
+		}
+	}
+	mBypassMix = mix;
+	ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+}
+
 
 OSStatus	AUEffectBase::ProcessBufferLists(
 									AudioUnitRenderActionFlags &	ioActionFlags,
@@ -395,9 +520,14 @@ OSStatus	AUEffectBase::ProcessBufferLists(
 									AudioBufferList &				outBuffer,
 									UInt32							inFramesToProcess )
 {
-	if (ShouldBypassEffect())
+	if (ShouldBypassEffect() && mBypassMix == 0.f)
 		return noErr;
 		
+	if (mMultiChannelKernel != NULL && mCommonPCMFormat == CAStreamBasicDescription::kPCMFormatFloat32) {
+		ProcessMultiChannel(ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
+		return noErr;
+	}
+	
 	// interleaved (or mono)
 	switch (mCommonPCMFormat) {
 		case CAStreamBasicDescription::kPCMFormatFloat32 :
@@ -426,3 +556,47 @@ UInt32		AUEffectBase::GetNumberOfChannels()
 	return GetOutput(0)->GetStreamFormat().mChannelsPerFrame;
 }
 
+//_____________________________________________________________________________
+//
+void	AUEffectBase::ProcessMultiChannel(
+									AudioUnitRenderActionFlags &	ioActionFlags,
+									const AudioBufferList &			inBuffer,
+									AudioBufferList &				outBuffer,
+									UInt32							inFramesToProcess )
+{
+	// once the kernel's tail has died away in silence it is not called, and the output stays
+	// flagged silent for Render to zero
+	bool ioSilence = (ioActionFlags & kAudioUnitRenderAction_OutputIsSilence) != 0;
+	mMultiChannelTimeout.Process (inFramesToProcess, UInt32(GetSampleRate() * mMultiChannelKernel->GetTailTime()), ioSilence);
+	if (ioSilence)
+		return;
+
+	UInt32 nChannels = (UInt32)mChannelSources.size();
+	UInt32 stride;
+	if (inBuffer.mNumberBuffers == 1) {
+		if (inBuffer.mBuffers[0].mNumberChannels == 0)
+			throw CAException(kAudio_ParamError);
+
+		stride = inBuffer.mBuffers[0].mNumberChannels;
+		if (nChannels > stride) nChannels = stride;
+		for (UInt32 channel = 0; channel < nChannels; ++channel) {
+			mChannelSources[channel] = (const Float32 *)inBuffer.mBuffers[0].mData + channel;
+			mChannelDests[channel] = (Float32 *)outBuffer.mBuffers[0].mData + channel;
+		}
+	} else {
+		stride = 1;
+		if (nChannels > inBuffer.mNumberBuffers) nChannels = inBuffer.mNumberBuffers;
+		if (nChannels > outBuffer.mNumberBuffers) nChannels = outBuffer.mNumberBuffers;
+		for (UInt32 channel = 0; channel < nChannels; ++channel) {
+			mChannelSources[channel] = (const Float32 *)inBuffer.mBuffers[channel].mData;
+			mChannelDests[channel] = (Float32 *)outBuffer.mBuffers[channel].mData;
+		}
+	}
+
+	mMultiChannelKernel->Process(&mChannelSources[0], &mChannelDests[0], stride, nChannels, inFramesToProcess, ioSilence);
+
+	if (ioSilence)
+		ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+	else
+		ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+}
@@ -11,9 +11,12 @@ Part of Core Audio AUBase Classes
 
 #include "AUBase.h"
 #include "AUSilentTimeout.h"
+#include "AUDeferredResources.h"
 #include "CAException.h"
+#include <algorithm>
 
 class AUKernelBase;
+class AUMultiChannelKernelBase;
 
 //	Base class for an effect with one input stream, one output stream,
 //	any number of channels.
@@ -81,6 +84,13 @@ public:
 	/*! @method NewKernel */
 	virtual AUKernelBase *		NewKernel() { return NULL; }
 
+	// If your unit can process all of its channels in one object (across SIMD lanes, for example),
+	// it can also override NewMultiChannelKernel.  While it returns one, ProcessBufferLists hands
+	// Float32 streams to that object instead of the per-channel kernels, which still serve any
+	// other sample format.
+	/*! @method NewMultiChannelKernel */
+	virtual AUMultiChannelKernelBase *	NewMultiChannelKernel(UInt32 inNumChannels) { return NULL; }
+
 	/*! @method ProcessBufferLists */
 	virtual OSStatus			ProcessBufferLists(
 											AudioUnitRenderActionFlags &	ioActionFlags,
@@ -123,10 +133,41 @@ protected:
 	/*! @method MaintainKernels */
 	void						MaintainKernels();
 
+	/*! @method PrepareKernels */
+	// Allocates what the unit renders with: the kernels, by MaintainKernels, and the bypass
+	// crossfade's buffer. A subclass with large buffers of its own allocates them here too, calling
+	// the base version. Initialize calls it, unless the unit defers it (see SetDefersKernels), in
+	// which case it runs on the helper thread of AUDeferredResources, once the input first carries
+	// sound. It never runs on the render thread.
+	virtual void				PrepareKernels ();
+
+	/*! @method SetDefersKernels */
+	// Set in the constructor of a subclass whose kernels and buffers are worth not allocating in
+	// an instance that never hears a sound. Until they are prepared the unit passes its input
+	// through, silence as silence; the first cycle with sound asks for them, and once they are
+	// there the effect fades in over the bypass crossfade.
+	void						SetDefersKernels (bool inFlag) { mDefersKernels = inFlag; }
+
+	/*! @method KernelsPrepared */
+	// On the render thread, whether PrepareKernels has run for this initialization; a subclass
+	// that touches its prepared state outside the kernels checks this first.
+	bool						KernelsPrepared () const { return mPreparedKernels.IsReady(); }
+
 	/*! @method ShouldBypassEffect */
 	// This is used in the render call to see if an effect is bypassed
 	// It can return a different status than IsBypassEffect (though it MUST take that into account)
 	virtual	bool				ShouldBypassEffect () { return IsBypassEffect(); }
+
+	/*! @method SetBypassCrossfadeTime */
+	// How long, in seconds, the effect takes to fade out into bypass and back in again; 0 switches
+	// at once. Read by Initialize.
+	void						SetBypassCrossfadeTime (Float64 inSeconds) { mBypassCrossfadeTime = inSeconds; }
+
+	/*! @method ResetKernels */
+	// Clears the kernels' state. Reset calls it, and so does the render thread as the effect comes
+	// out of bypass, so that it does not resume from what it heard before; a subclass with state of
+	// its own outside the kernels should clear that here too.
+	virtual void				ResetKernels ();
 					
 public:
 	/*! @method SetBypassEffect */
@@ -167,6 +208,9 @@ protected:
 
 	AUKernelBase* GetKernel(UInt32 index) { return mKernelList[index]; }
 
+	/*! @var mMultiChannelKernel */
+	AUMultiChannelKernelBase *		mMultiChannelKernel;
+
 	/*! @method IsInputSilent */
 	bool 							IsInputSilent (AudioUnitRenderActionFlags 	inActionFlags, UInt32 inFramesToProcess)
 									{
@@ -204,6 +248,12 @@ private:
 	/*! @var mSilentTimeout */
 	AUSilentTimeout					mSilentTimeout;
 
+	// one per kernel, and one for the multichannel kernel: each counts down its kernel's tail once
+	// the input falls silent, after which the kernel is no longer called. Sized by MaintainKernels.
+	std::vector<AUSilentTimeout>	mKernelTimeouts;
+	std::vector<UInt8>				mKernelSilent;			// of the cycle under way
+	AUSilentTimeout					mMultiChannelTimeout;
+
 	/*! @var mMainOutput */
 	AUOutputElement *				mMainOutput;
 	
@@ -218,6 +268,36 @@ private:
 	/*! @var mCommonPCMFormat */
 	CAStreamBasicDescription::CommonPCMFormat		mCommonPCMFormat;
 	UInt32							mBytesPerFrame;
+
+	// the channel pointers handed to mMultiChannelKernel, sized by MaintainKernels
+	std::vector<const Float32 *>	mChannelSources;
+	std::vector<Float32 *>			mChannelDests;
+
+	// bypass, on the render thread. The effect's share of the output moves from 1 to 0 and back
+	// over the crossfade; while it is 0 the kernels are not called at all.
+	Float64							mBypassCrossfadeTime;	// seconds
+	UInt32							mBypassCrossfadeFrames;
+	Float32							mBypassMix;				// 1 processing, 0 bypassed, between while fading
+	std::vector<Float32>			mBypassDry;				// the input of a cycle that fades, which processing in place overwrites
+
+	// the kernels and buffers, prepared by Initialize or on the first sound
+	bool							mDefersKernels;
+	AUDeferredResources				mPreparedKernels;
+	static void						PrepareDeferredKernels(void *inContext)
+									{
+										static_cast<AUEffectBase *>(inContext)->PrepareKernels();
+									}
+
+	bool							SaveBypassDry(UInt32 inFramesToProcess);
+	void							MixBypassDry(	Float32							inTarget,
+													AudioUnitRenderActionFlags &	ioActionFlags,
+													UInt32							inFramesToProcess );
+
+	void							ProcessMultiChannel(
+										AudioUnitRenderActionFlags &	ioActionFlags,
+										const AudioBufferList &			inBuffer,
+										AudioBufferList &				outBuffer,
+										UInt32							inFramesToProcess );
 };
 
 
@@ -262,6 +342,15 @@ public:
 									return mAudioUnit->GetSampleRate();
 								}
 								
+	/*! @method GetTailTime */
+	// How long, in seconds, the output rings on after the input falls silent. Once that much silence
+	// has passed AUEffectBase stops calling Process until sound returns. The unit's latency plus
+	// its tail time, unless the kernel knows better.
+	virtual Float64				GetTailTime()
+								{
+									return mAudioUnit->GetLatency() + mAudioUnit->GetTailTime();
+								}
+								
 	/*! @method GetParameter */
 	AudioUnitParameterValue		GetParameter (AudioUnitParameterID	paramID) 
 								{
@@ -278,6 +367,58 @@ protected:
 
 };
 
+//	Base class for a kernel that performs DSP on every channel of a Float32 stream at once.
+	/*! @class AUMultiChannelKernelBase */
+class AUMultiChannelKernelBase {
+public:
+	/*! @ctor AUMultiChannelKernelBase */
+								AUMultiChannelKernelBase(AUEffectBase *inAudioUnit, UInt32 inNumChannels ) :
+									mAudioUnit(inAudioUnit), mNumChannels(inNumChannels) { }
+
+	/*! @dtor ~AUMultiChannelKernelBase */
+	virtual						~AUMultiChannelKernelBase() { }
+
+	/*! @method Reset */
+	virtual void				Reset() { }
+
+	/*! @method Process */
+	// inSources[i] and inDests[i] point at channel i's first sample, and each channel's samples
+	// are inStride apart (the number of channels if interleaved, else 1). inNumChannels may be
+	// less than GetNumberOfChannels() if the host supplied fewer buffers.
+	virtual void 				Process(	const Float32 * const *				inSources,
+											Float32 * const *					inDests,
+											UInt32								inStride,
+											UInt32								inNumChannels,
+											UInt32								inFramesToProcess,
+											bool &								ioSilence) = 0;
+
+	/*! @method GetSampleRate */
+	Float64						GetSampleRate()
+								{
+									return mAudioUnit->GetSampleRate();
+								}
+
+	/*! @method GetTailTime */
+	// as AUKernelBase::GetTailTime, for all the channels at once
+	virtual Float64				GetTailTime()
+								{
+									return mAudioUnit->GetLatency() + mAudioUnit->GetTailTime();
+								}
+
+	/*! @method GetParameter */
+	AudioUnitParameterValue		GetParameter (AudioUnitParameterID	paramID)
+								{
+									return mAudioUnit->GetParameter(paramID);
+								}
+
+	UInt32						GetNumberOfChannels () const { return mNumChannels; }
+
+protected:
+	/*! @var mAudioUnit */
+	AUEffectBase * 		mAudioUnit;
+	UInt32				mNumChannels;
+};
+
 template <typename T>
 void	AUEffectBase::ProcessBufferListsT(
 									AudioUnitRenderActionFlags &	ioActionFlags,
@@ -287,19 +428,41 @@ void	AUEffectBase::ProcessBufferListsT(
 {
 	bool ioSilence;
 
-	bool silentInput = IsInputSilent (ioActionFlags, inFramesToProcess);
+	// a kernel whose tail has died away since its input fell silent is not called; if none is
+	// left the output stays flagged silent, and Render zeroes it unless it is the input itself
+	const bool silentInput = (ioActionFlags & kAudioUnitRenderAction_OutputIsSilence) != 0;
+	const Float64 sampleRate = GetSampleRate();
+	bool allSilent = true;
+	for (UInt32 channel = 0; channel < mKernelList.size(); ++channel) {
+		AUKernelBase *kernel = mKernelList[channel];
+		ioSilence = silentInput;
+		if (kernel != NULL)
+			mKernelTimeouts[channel].Process (inFramesToProcess, UInt32(sampleRate * kernel->GetTailTime()), ioSilence);
+		mKernelSilent[channel] = kernel == NULL || ioSilence;
+		allSilent = allSilent && mKernelSilent[channel];
+	}
 	ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+	if (allSilent)
+		return;
 
 	// call the kernels to handle either interleaved or deinterleaved
 	if (inBuffer.mNumberBuffers == 1) {
 		if (inBuffer.mBuffers[0].mNumberChannels == 0)
 			throw CAException(kAudio_ParamError);
 			
+		const UInt32 stride = inBuffer.mBuffers[0].mNumberChannels;
 		for (UInt32 channel = 0; channel < mKernelList.size(); ++channel) {
 			AUKernelBase *kernel = mKernelList[channel];
 			
 			if (kernel == NULL) continue;
-			ioSilence = silentInput;
+			if (mKernelSilent[channel]) {
+				T *dest = (T *)outBuffer.mBuffers[0].mData + channel;
+				if (dest != (const T *)inBuffer.mBuffers[0].mData + channel)
+					for (UInt32 frame = 0; frame < inFramesToProcess; ++frame)
+						dest[frame * stride] = 0;
+				continue;
+			}
+			ioSilence = false;
 			
 			// process each interleaved channel individually
 			kernel->Process(
@@ -313,18 +476,27 @@ void	AUEffectBase::ProcessBufferListsT(
 				ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
 		}
 	} else {
-		for (UInt32 channel = 0; channel < mKernelList.size(); ++channel) {
+		// each channel is a contiguous block of its own; a kernel whose output buffer is its input
+		// buffer, as when the output was pointed at the input or the host passed the same memory,
+		// runs in place. Channels past the buffers the host supplied are left alone.
+		const UInt32 numChannels = std::min(UInt32(mKernelList.size()), std::min(inBuffer.mNumberBuffers, outBuffer.mNumberBuffers));
+		for (UInt32 channel = 0; channel < numChannels; ++channel) {
 			AUKernelBase *kernel = mKernelList[channel];
 			
 			if (kernel == NULL) continue;
 			
-			ioSilence = silentInput;
-			const AudioBuffer *srcBuffer = &inBuffer.mBuffers[channel];
-			AudioBuffer *destBuffer = &outBuffer.mBuffers[channel];
+			const T *source = (const T *)inBuffer.mBuffers[channel].mData;
+			T *dest = (T *)outBuffer.mBuffers[channel].mData;
+			if (mKernelSilent[channel]) {
+				if (dest != source)
+					memset(dest, 0, inFramesToProcess * sizeof(T));
+				continue;
+			}
+			ioSilence = false;
 			
 			kernel->Process(
-				(const T *)srcBuffer->mData, 
-				(T *)destBuffer->mData, 
+				source, 
+				dest, 
 				inFramesToProcess,
 				1,
 				ioSilence);
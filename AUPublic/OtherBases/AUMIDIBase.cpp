@@ -234,45 +234,10 @@ OSStatus			AUMIDIBase::DelegateSetProperty(	AudioUnitPropertyID 			inID,
 #pragma mark ____MidiDispatch
 
 
-inline const Byte *	NextMIDIEvent(const Byte *event, const Byte *end)
-{
-	Byte c = *event;
-	switch (c >> 4) {
-	default:	// data byte -- assume in sysex
-		while ((*++event & 0x80) == 0 && event < end)
-			;
-		break;
-	case 0x8:
-	case 0x9:
-	case 0xA:
-	case 0xB:
-	case 0xE:
-		event += 3;
-		break;
-	case 0xC:
-	case 0xD:
-		event += 2;
-		break;
-	case 0xF:
-		switch (c) {
-		case 0xF0:
-			while ((*++event & 0x80) == 0 && event < end)
-				;
-			break;
-		case 0xF1:
-		case 0xF3:
-			event += 2;
-			break;
-		case 0xF2:
-			event += 3;
-			break;
-		default:
-			++event;
-			break;
-		}
-	}
-	return (event >= end) ? end : event;
-}
+// the data bytes after a status byte: channel messages by their high nibble, from 0x80, and system
+// messages by their low nibble. A system exclusive message's length is found by its end.
+static const UInt8 kChannelDataBytes[7] = { 2, 2, 2, 2, 1, 1, 2 };
+static const UInt8 kSystemDataBytes[16] = { 0, 1, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	AUMIDIBase::HandleMIDIPacketList
@@ -282,26 +247,99 @@ OSStatus			AUMIDIBase::HandleMIDIPacketList(const MIDIPacketList *pktlist)
 {
 	if (!mAUBaseInstance.IsInitialized()) return kAudioUnitErr_Uninitialized;
 	
-	int nPackets = pktlist->numPackets;
+	AUMIDIEvent batch[kAUMIDIEventBatchSize];
+	UInt32 numEvents = 0;
+	Byte runningStatus = 0;		// the last channel status; 0 in system exclusive and after system common
+	
+	UInt32 nPackets = pktlist->numPackets;
 	const MIDIPacket *pkt = pktlist->packet;
 	
 	while (nPackets-- > 0) {
 		const Byte *event = pkt->data, *packetEnd = event + pkt->length;
-		long startFrame = (long)pkt->timeStamp;
+		UInt32 startFrame = static_cast<UInt32>(pkt->timeStamp);
 		while (event < packetEnd) {
-			Byte status = event[0];
-			if (status & 0x80) {
-				// really a status byte (not sysex continuation)
-				HandleMidiEvent(status & 0xF0, status & 0x0F, event[1], event[2], static_cast<UInt32>(startFrame));
-					// note that we're generating a bogus channel number for system messages (0xF0-FF)
+			Byte status = *event;
+			if (status & 0x80)
+				++event;
+			else if (runningStatus)
+				status = runningStatus;
+			else {
+				++event;	// system exclusive data, or a stray byte
+				continue;
+			}
+			
+			UInt32 dataBytes;
+			if (status < 0xF0) {
+				dataBytes = kChannelDataBytes[(status >> 4) - 8];
+				runningStatus = status;
+			} else {
+				dataBytes = kSystemDataBytes[status & 0x0F];
+				if (status < 0xF8)
+					runningStatus = 0;		// real-time messages may come anywhere and leave it be
+			}
+			if (dataBytes > UInt32(packetEnd - event))
+				break;
+			
+			AUMIDIEvent &midi = batch[numEvents];
+			midi.mStartFrame = startFrame;
+			midi.mStatus = status & 0xF0;
+			midi.mChannel = status & 0x0F;	// a bogus channel number for system messages, as MIDIEvent() gives
+			midi.mData1 = dataBytes > 0 ? event[0] : 0;
+			midi.mData2 = dataBytes > 1 ? event[1] : 0;
+			event += dataBytes;
+			
+			if (++numEvents == kAUMIDIEventBatchSize) {
+				HandleMidiEvents(batch, numEvents);
+				numEvents = 0;
 			}
-			event = NextMIDIEvent(event, packetEnd);
 		}
-		pkt = reinterpret_cast<const MIDIPacket *>(packetEnd);
+		pkt = MIDIPacketNext(pkt);
 	}
+	if (numEvents)
+		HandleMidiEvents(batch, numEvents);
 	return noErr;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AUMIDIBase::HandleMidiEvents
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			AUMIDIBase::HandleMidiEvents(const AUMIDIEvent *inEvents, UInt32 inNumEvents)
+{
+	for (UInt32 i = 0; i < inNumEvents; ++i) {
+		const AUMIDIEvent &event = inEvents[i];
+		HandleMidiEvent(event.mStatus, event.mChannel, event.mData1, event.mData2, event.mStartFrame);
+	}
+	return noErr;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AUMIDIBase::MapMidiEvents
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				AUMIDIBase::MapMidiEvents(const AUMIDIEvent *inEvents, UInt32 inNumEvents)
+{
+#if CA_AUTO_MIDI_MAP
+	UInt32 i = 0;
+	// the hot mapping is looked for only until an event takes it, which is then not matched itself
+	if (mMapManager->IsHotMapping()) {
+		for (; i < inNumEvents; ++i) {
+			const AUMIDIEvent &event = inEvents[i];
+			if (mMapManager->HandleHotMapping (event.mStatus, event.mChannel, event.mData1, mAUBaseInstance)) {
+				mAUBaseInstance.PropertyChanged (kAudioUnitProperty_HotMapParameterMIDIMapping, kAudioUnitScope_Global, 0);
+				++i;
+				break;
+			}
+			mMapManager->FindParameterMapEventMatch(event.mStatus, event.mChannel, event.mData1, event.mData2, event.mStartFrame, mAUBaseInstance);
+		}
+	}
+	for (; i < inNumEvents; ++i) {
+		const AUMIDIEvent &event = inEvents[i];
+		mMapManager->FindParameterMapEventMatch(event.mStatus, event.mChannel, event.mData1, event.mData2, event.mStartFrame, mAUBaseInstance);
+	}
+#endif
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	AUMIDIBase::HandleMidiEvent
 //
@@ -321,6 +359,11 @@ OSStatus 	AUMIDIBase::HandleMidiEvent(UInt8 status, UInt8 channel, UInt8 data1,
 	}	
 #endif	
 	
+	return DispatchMidiEvent(status, channel, data1, data2, inStartFrame);
+}
+
+OSStatus	AUMIDIBase::DispatchMidiEvent(UInt8 status, UInt8 channel, UInt8 data1, UInt8 data2, UInt32 inStartFrame)
+{
 	OSStatus result = noErr;
 	
 	switch(status)
@@ -17,6 +17,24 @@ Part of Core Audio AUBase Classes
 
 struct MIDIPacketList;
 
+/*
+	One channel or system message of a packet list, as HandleMIDIPacketList() decodes it: the status
+	split as MIDIEvent() splits it, the data bytes a message has no use for left 0. Eight bytes, so a
+	whole batch of them fits in a few cache lines.
+*/
+	/*! @struct AUMIDIEvent */
+struct AUMIDIEvent {
+	UInt32			mStartFrame;
+	UInt8			mStatus;		// the high nibble; 0xF0 for every system message
+	UInt8			mChannel;		// the low nibble, not a channel for system messages
+	UInt8			mData1;
+	UInt8			mData2;
+};
+
+enum {
+	kAUMIDIEventBatchSize		= 256		// events HandleMIDIPacketList() decodes before it hands them on
+};
+
 // ________________________________________________________________________
 //	MusicDeviceBase
 //
@@ -42,6 +60,11 @@ public:
 	}
 	
 	/*! @method HandleMIDIPacketList */
+	// decodes a packet list into AUMIDIEvents in one pass, kAUMIDIEventBatchSize at a time, and hands
+	// each batch to HandleMidiEvents(). A data byte where a status is due repeats the last channel
+	// status (running status), within the list; after a system exclusive or system common message
+	// data bytes are skipped until the next status. A message cut short by the end of its packet is
+	// dropped.
 	OSStatus			HandleMIDIPacketList(const MIDIPacketList *pktlist);
 	
 	/*! @method SysEx */
@@ -79,6 +102,29 @@ protected:
 												UInt8 	inData2,
 												UInt32 	inStartFrame);
 
+	/*! @method HandleMidiEvents */
+	// the events of a packet list, in order. The default takes them one at a time through
+	// HandleMidiEvent(); a subclass that does better with the whole batch, as AUInstrumentBase does,
+	// can use MapMidiEvents() and DispatchMidiEvent() for the parts it leaves alone. A subclass that
+	// overrides HandleMidiEvent() to see every event must override this too, or call this version.
+	virtual OSStatus	HandleMidiEvents(		const AUMIDIEvent *	inEvents,
+												UInt32				inNumEvents);
+
+	/*! @method MapMidiEvents */
+	// the parameter mapping HandleMidiEvent() does, over a batch: the hot mapping, if one is pending,
+	// takes the first event it can; every other event is matched against the maps
+	void				MapMidiEvents(			const AUMIDIEvent *	inEvents,
+												UInt32				inNumEvents);
+
+	/*! @method DispatchMidiEvent */
+	// HandleMidiEvent() without the parameter mapping: a note on or off to HandleNoteOn() or
+	// HandleNoteOff(), anything else to HandleNonNoteEvent()
+	OSStatus			DispatchMidiEvent(		UInt8 	inStatus,
+												UInt8 	inChannel,
+												UInt8 	inData1,
+												UInt8 	inData2,
+												UInt32 	inStartFrame);
+
 	/*! @method HandleNonNoteEvent */
 	virtual OSStatus	HandleNonNoteEvent (	UInt8	status, 
 												UInt8	channel, 
@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AUBinaryState.h"
+
+void	AUBinaryStateWriter::AddSection(UInt32 inTag, UInt32 inVersion, const void *inData, UInt32 inSize)
+{
+	// the header and the directory are whole multiples of the alignment, so aligning within the
+	// payload aligns within the blob
+	size_t offset = (mPayload.size() + kAUBinaryStateAlignment - 1) & ~size_t(kAUBinaryStateAlignment - 1);
+	mPayload.resize(offset + inSize, 0);
+	if (inSize)
+		memcpy(&mPayload[offset], inData, inSize);
+
+	AUBinaryStateSection section = { inTag, inVersion, static_cast<UInt32>(offset), inSize };
+	mDirectory.push_back(section);
+}
+
+CFDataRef	AUBinaryStateWriter::CopyData() const
+{
+	if (mDirectory.empty())
+		return NULL;
+
+	const size_t directoryEnd = sizeof(AUBinaryStateHeader) + mDirectory.size() * sizeof(AUBinaryStateSection);
+	const size_t totalSize = directoryEnd + mPayload.size();
+	CFMutableDataRef data = CFDataCreateMutable(NULL, static_cast<CFIndex>(totalSize));
+	CFDataSetLength(data, static_cast<CFIndex>(totalSize));
+	UInt8 *bytes = CFDataGetMutableBytePtr(data);
+
+	AUBinaryStateHeader header = { kAUBinaryStateMagic, kAUBinaryStateVersion, NumSections(), static_cast<UInt32>(totalSize) };
+	memcpy(bytes, &header, sizeof(header));
+	AUBinaryStateSection *directory = reinterpret_cast<AUBinaryStateSection *>(bytes + sizeof(header));
+	for (size_t i = 0; i < mDirectory.size(); ++i) {
+		AUBinaryStateSection section = mDirectory[i];
+		section.mOffset += static_cast<UInt32>(directoryEnd);
+		memcpy(&directory[i], &section, sizeof(section));
+	}
+	if (!mPayload.empty())
+		memcpy(bytes + directoryEnd, &mPayload[0], mPayload.size());
+	return data;
+}
+
+bool	AUBinaryStateReader::Open(CFDataRef inData)
+{
+	Close();
+	if (inData == NULL || CFGetTypeID(inData) != CFDataGetTypeID())
+		return false;
+
+	const UInt8 *bytes = CFDataGetBytePtr(inData);
+	const UInt64 length = static_cast<UInt64>(CFDataGetLength(inData));
+	AUBinaryStateHeader header;
+	if (length < sizeof(header))
+		return false;
+	memcpy(&header, bytes, sizeof(header));
+	// a blob from a machine of the other byte order fails the magic number
+	if (header.mMagic != kAUBinaryStateMagic || header.mVersion != kAUBinaryStateVersion || header.mTotalSize != length)
+		return false;
+	const UInt64 directoryEnd = sizeof(header) + UInt64(header.mNumSections) * sizeof(AUBinaryStateSection);
+	if (directoryEnd > length)
+		return false;
+	for (UInt32 i = 0; i < header.mNumSections; ++i) {
+		AUBinaryStateSection section;
+		memcpy(&section, bytes + sizeof(header) + i * sizeof(section), sizeof(section));
+		if (section.mOffset < directoryEnd || UInt64(section.mOffset) + section.mSize > length)
+			return false;
+	}
+
+	CFRetain(inData);
+	mData = inData;
+	mBytes = bytes;
+	mNumSections = header.mNumSections;
+	return true;
+}
+
+void	AUBinaryStateReader::Close()
+{
+	if (mData)
+		CFRelease(mData);
+	mData = NULL;
+	mBytes = NULL;
+	mNumSections = 0;
+}
+
+const void *	AUBinaryStateReader::Section(UInt32 inTag, UInt32 &outVersion, UInt32 &outSize) const
+{
+	for (UInt32 i = 0; i < mNumSections; ++i) {
+		AUBinaryStateSection section;
+		memcpy(&section, mBytes + sizeof(AUBinaryStateHeader) + i * sizeof(section), sizeof(section));
+		if (section.mTag == inTag) {
+			outVersion = section.mVersion;
+			outSize = section.mSize;
+			return mBytes + section.mOffset;
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AUBinaryState_h__
+#define __AUBinaryState_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreFoundation/CoreFoundation.h>
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreFoundation.h>
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <cstring>
+#include <vector>
+
+/*
+	A unit's own state, beyond its parameters, packed into one CFData that AUBase::SaveState() stores
+	in the class info dictionary under kAUBinaryStateKey. Nested dictionaries of CFNumbers get slow to
+	build and to parse once a unit saves tables and maps; this is a header, a directory and the
+	sections themselves, each written and read with one memcpy.
+
+	The blob is in the writer's byte order, which the magic number gives away; a reader on a machine
+	of the other order ignores it. Each section has a four-character tag and a version of its own, so
+	a unit can change the layout of one section without touching the others, and a reader simply
+	doesn't find a section an older writer didn't save. Every section starts on a
+	kAUBinaryStateAlignment boundary of the blob.
+
+	The reader points into the CFData it was opened on and keeps it retained, so a section can be
+	left alone at restore time and read when it is needed, without a copy being held until then.
+*/
+#define kAUBinaryStateKey	"binary-state"
+
+enum {
+	kAUBinaryStateMagic			= 'AUbs',
+	kAUBinaryStateVersion		= 1,
+	kAUBinaryStateAlignment		= 16
+};
+
+typedef struct AUBinaryStateHeader
+{
+	UInt32					mMagic;				// kAUBinaryStateMagic
+	UInt32					mVersion;			// kAUBinaryStateVersion
+	UInt32					mNumSections;		// directory entries, right after the header
+	UInt32					mTotalSize;			// bytes, the header included
+} AUBinaryStateHeader;
+
+typedef struct AUBinaryStateSection
+{
+	UInt32					mTag;				// the unit's four-character code
+	UInt32					mVersion;			// of the section's layout, the unit's to number
+	UInt32					mOffset;			// bytes from the start of the blob
+	UInt32					mSize;				// bytes
+} AUBinaryStateSection;
+
+	/*! @class AUBinaryStateWriter */
+class AUBinaryStateWriter {
+public:
+	AUBinaryStateWriter() {}
+
+	// appends a section; a tag already added is added again, and the reader finds the first
+	void					AddSection(UInt32 inTag, UInt32 inVersion, const void *inData, UInt32 inSize);
+	template <class T>
+	void					AddSection(UInt32 inTag, UInt32 inVersion, const T &inValue)
+							{
+								AddSection(inTag, inVersion, &inValue, sizeof(T));
+							}
+
+	UInt32					NumSections() const { return static_cast<UInt32>(mDirectory.size()); }
+
+	// the blob, with a reference the caller releases; NULL if there are no sections
+	CFDataRef				CopyData() const;
+
+private:
+	std::vector<AUBinaryStateSection>	mDirectory;		// offsets into mPayload until CopyData()
+	std::vector<UInt8>					mPayload;
+};
+
+	/*! @class AUBinaryStateReader */
+class AUBinaryStateReader {
+public:
+	AUBinaryStateReader() : mData(NULL), mBytes(NULL), mNumSections(0) {}
+	~AUBinaryStateReader() { Close(); }
+
+	// false, leaving the reader closed, if inData is not a whole blob of this version and byte order
+	bool					Open(CFDataRef inData);
+	void					Close();
+	bool					IsOpen() const { return mData != NULL; }
+
+	// the section's bytes in the blob, or NULL if there is no section of that tag
+	const void *			Section(UInt32 inTag, UInt32 &outVersion, UInt32 &outSize) const;
+
+	// copies the section into outValue if it is there, of that version and of T's size
+	template <class T>
+	bool					ReadSection(UInt32 inTag, UInt32 inVersion, T &outValue) const
+							{
+								UInt32 version, size;
+								const void *bytes = Section(inTag, version, size);
+								if (bytes == NULL || version != inVersion || size != sizeof(T))
+									return false;
+								memcpy(&outValue, bytes, sizeof(T));
+								return true;
+							}
+
+private:
+	AUBinaryStateReader(const AUBinaryStateReader &);
+	AUBinaryStateReader & operator=(const AUBinaryStateReader &);
+
+	CFDataRef						mData;			// retained while open
+	const UInt8 *					mBytes;
+	UInt32							mNumSections;
+};
+
+#endif // __AUBinaryState_h__
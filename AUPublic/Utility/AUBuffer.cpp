@@ -7,7 +7,82 @@ Part of Core Audio AUBase Classes
 */
 
 #include "AUBuffer.h"
+#include <pthread.h>
 #include <stdlib.h>
+#include <new>
+
+// the free slabs of each power-of-two size, from kMinSlabBytes up to 2 GB
+static const int				kNumSlabClasses = 20;
+static pthread_mutex_t			sPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static void *					sFreeSlabs[kNumSlabClasses];		// each free slab's first word links to the next
+static UInt32					sCachedBytes = 0;
+
+static int		SlabClass(UInt32 inBytes, UInt32 &outSlabBytes)
+{
+	int slabClass = 0;
+	UInt32 slabBytes = AUBufferPool::kMinSlabBytes;
+	while (slabBytes < inBytes) {
+		if (++slabClass == kNumSlabClasses)
+			throw std::bad_alloc();
+		slabBytes <<= 1;
+	}
+	outSlabBytes = slabBytes;
+	return slabClass;
+}
+
+Byte *		AUBufferPool::Acquire(UInt32 inMinBytes, UInt32 &outBytes)
+{
+	int slabClass = SlabClass(inMinBytes, outBytes);
+
+	pthread_mutex_lock(&sPoolMutex);
+	void *slab = sFreeSlabs[slabClass];
+	if (slab != NULL) {
+		sFreeSlabs[slabClass] = *(void **)slab;
+		sCachedBytes -= outBytes;
+	}
+	pthread_mutex_unlock(&sPoolMutex);
+
+	if (slab == NULL && posix_memalign(&slab, kAlignment, outBytes) != 0)
+		throw std::bad_alloc();
+	return (Byte *)slab;
+}
+
+void		AUBufferPool::Release(Byte *inSlab, UInt32 inBytes)
+{
+	if (inSlab == NULL) return;
+	UInt32 slabBytes;
+	int slabClass = SlabClass(inBytes, slabBytes);
+
+	pthread_mutex_lock(&sPoolMutex);
+	bool cache = sCachedBytes + slabBytes <= kMaxCachedBytes;
+	if (cache) {
+		*(void **)inSlab = sFreeSlabs[slabClass];
+		sFreeSlabs[slabClass] = inSlab;
+		sCachedBytes += slabBytes;
+	}
+	pthread_mutex_unlock(&sPoolMutex);
+
+	if (!cache)
+		free(inSlab);
+}
+
+void		AUBufferPool::Purge()
+{
+	void *slabs[kNumSlabClasses];
+	pthread_mutex_lock(&sPoolMutex);
+	memcpy(slabs, sFreeSlabs, sizeof(slabs));
+	memset(sFreeSlabs, 0, sizeof(sFreeSlabs));
+	sCachedBytes = 0;
+	pthread_mutex_unlock(&sPoolMutex);
+
+	for (int i = 0; i < kNumSlabClasses; ++i) {
+		while (slabs[i] != NULL) {
+			void *next = *(void **)slabs[i];
+			free(slabs[i]);
+			slabs[i] = next;
+		}
+	}
+}
 
 AUBufferList::~AUBufferList()
 {
@@ -43,15 +118,18 @@ void				AUBufferList::Allocate(const CAStreamBasicDescription &format, UInt32 nF
 									SafeMultiplyAddUInt32(nStreams, sizeof(AudioBuffer), theHeaderSize));
 		mAllocatedStreams = nStreams;
 	}
-	UInt32 bytesPerStream = SafeMultiplyAddUInt32(nFrames, format.mBytesPerFrame, 0xF) & ~0xF;
+	UInt32 bytesPerStream = SafeMultiplyAddUInt32(nFrames, format.mBytesPerFrame, kStreamAlignment - 1) & ~(kStreamAlignment - 1);
 	UInt32 nBytes = SafeMultiplyAddUInt32(nStreams, bytesPerStream, 0);
 	if (nBytes > mAllocatedBytes) {
-		if (mExternalMemory) {
+		// the old contents needn't survive, so take a fresh slab rather than reallocating
+		UInt32 slabBytes;
+		Byte *slab = AUBufferPool::Acquire(nBytes, slabBytes);
+		if (mExternalMemory)
 			mExternalMemory = false;
-			mMemory = NULL;
-		}
-		mMemory = (Byte *)CA_realloc(mMemory, nBytes);
-		mAllocatedBytes = nBytes;
+		else
+			AUBufferPool::Release(mMemory, mAllocatedBytes);
+		mMemory = slab;
+		mAllocatedBytes = slabBytes;
 	}
 	mAllocatedFrames = nFrames;
 	mPtrState = kPtrsInvalid;
@@ -61,7 +139,6 @@ void				AUBufferList::Deallocate()
 {
 	mAllocatedStreams = 0;
 	mAllocatedFrames = 0;
-	mAllocatedBytes = 0;
 // this causes a world of hurt if someone upstream disconnects during I/O (SysSoundGraph)
 /*	if (mPtrs) {
 		printf("deallocating bufferlist %08X\n", int(mPtrs));
@@ -72,9 +149,10 @@ void				AUBufferList::Deallocate()
 		if (mExternalMemory)
 			mExternalMemory = false;
 		else
-			free(mMemory);
+			AUBufferPool::Release(mMemory, mAllocatedBytes);
 		mMemory = NULL;
 	}
+	mAllocatedBytes = 0;
 	mPtrState = kPtrsInvalid;
 }
 
@@ -99,7 +177,7 @@ AudioBufferList &	AUBufferList::PrepareBuffer(const CAStreamBasicDescription &fo
 	abl->mNumberBuffers = nStreams;
 	AudioBuffer *buf = abl->mBuffers;
 	Byte *mem = mMemory;
-	UInt32 streamInterval = (mAllocatedFrames * format.mBytesPerFrame + 0xF) & ~0xF;
+	UInt32 streamInterval = (mAllocatedFrames * format.mBytesPerFrame + kStreamAlignment - 1) & ~(kStreamAlignment - 1);
 	UInt32 bytesPerBuffer = nFrames * format.mBytesPerFrame;
 	for ( ; nStreams--; ++buf) {
 		buf->mNumberChannels = channelsPerStream;
@@ -142,18 +220,23 @@ AudioBufferList &	AUBufferList::PrepareNullBuffer(const CAStreamBasicDescription
 // this should NOT be called while I/O is in process
 void		AUBufferList::UseExternalBuffer(const CAStreamBasicDescription &format, const AudioUnitExternalBuffer &buf)
 {
-	UInt32 alignedSize = buf.size & ~0xF;
-	if (mMemory != NULL && alignedSize >= mAllocatedBytes) {
+	UInt32 alignedSize = buf.size & ~(kStreamAlignment - 1);
+	// a buffer that doesn't start on a stream boundary would leave every stream misaligned
+	if (mMemory != NULL && alignedSize >= mAllocatedBytes && ((uintptr_t)buf.buffer & (kStreamAlignment - 1)) == 0) {
 		// don't accept the buffer if we already have one and it's big enough
 		// if we don't already have one, we don't need one
 		Byte *oldMemory = mMemory;
+		UInt32 oldBytes = mAllocatedBytes;
+		bool oldExternal = mExternalMemory;
 		mMemory = buf.buffer;
 		mAllocatedBytes = alignedSize;
-		// from Allocate(): nBytes = nStreams * nFrames * format.mBytesPerFrame;	
-		// thus: nFrames = nBytes / (nStreams * format.mBytesPerFrame)
-		mAllocatedFrames = mAllocatedBytes / (format.NumberChannelStreams() * format.mBytesPerFrame);
+		// from Allocate(): nBytes = nStreams * (nFrames * format.mBytesPerFrame, rounded up to kStreamAlignment);
+		// thus: nFrames = (nBytes / nStreams, rounded down to kStreamAlignment) / format.mBytesPerFrame
+		UInt32 bytesPerStream = (mAllocatedBytes / format.NumberChannelStreams()) & ~(kStreamAlignment - 1);
+		mAllocatedFrames = bytesPerStream / format.mBytesPerFrame;
 		mExternalMemory = true;
-		free(oldMemory);
+		if (!oldExternal)
+			AUBufferPool::Release(oldMemory, oldBytes);
 	}
 }
 
@@ -28,6 +28,29 @@ Part of Core Audio AUBase Classes
 #endif
 
 
+/*
+	AUBufferPool keeps the sample memory of AUBufferLists that has been given back, so that
+	reallocating every element when a host changes the maximum frames or the formats reuses slabs
+	rather than freeing and mallocing each one. Slabs come in power-of-two sizes, start on a
+	kAlignment boundary, and are shared by every unit in the process. Not for the render thread.
+*/
+	/*! @class AUBufferPool */
+class AUBufferPool {
+public:
+	enum {
+		kAlignment = 64,						// a cache line, and enough for any vector load
+		kMinSlabBytes = 4096,
+		kMaxCachedBytes = 16 * 1024 * 1024		// beyond this, released slabs are freed
+	};
+
+	// returns a slab of at least inMinBytes, whose actual size is put in outBytes; throws bad_alloc
+	static Byte *		Acquire(UInt32 inMinBytes, UInt32 &outBytes);
+	// inBytes is the size Acquire returned
+	static void			Release(Byte *inSlab, UInt32 inBytes);
+	// frees every cached slab
+	static void			Purge();
+};
+
 	/*! @class AUBufferList */
 class AUBufferList {
 	enum EPtrState {
@@ -36,6 +59,10 @@ class AUBufferList {
 		kPtrsToExternalMemory
 	};
 public:
+	enum {
+		kStreamAlignment = AUBufferPool::kAlignment		// every stream's first sample starts on this boundary
+	};
+
 	/*! @ctor AUBufferList */
 	AUBufferList() : mPtrState(kPtrsInvalid), mExternalMemory(false), mPtrs(NULL), mMemory(NULL), 
 		mAllocatedStreams(0), mAllocatedFrames(0), mAllocatedBytes(0) { }
@@ -0,0 +1,166 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AUDeferredResources.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if __APPLE__
+	#include <mach/mach.h>
+	#include <mach/semaphore.h>
+#else
+	#include <semaphore.h>
+#endif
+
+/*
+	The helper thread runs while any unit has resources deferred, and sleeps on a semaphore that
+	Request() signals, the one wake a render thread can make without taking a lock. It prepares
+	under the list's mutex, so a unit that cancels waits for its own prepare to finish.
+*/
+class AUDeferredResourcesHelper
+{
+public:
+	AUDeferredResourcesHelper() : mUsers(0), mExit(false)
+	{
+#if __APPLE__
+		semaphore_create(mach_task_self(), &mWake, SYNC_POLICY_FIFO, 0);
+#else
+		sem_init(&mWake, 0, 0);
+#endif
+	}
+
+	~AUDeferredResourcesHelper()
+	{
+#if __APPLE__
+		semaphore_destroy(mach_task_self(), mWake);
+#else
+		sem_destroy(&mWake);
+#endif
+	}
+
+	void				Add(AUDeferredResources *inResources);
+	void				Remove(AUDeferredResources *inResources);
+
+	void				Wake()
+	{
+#if __APPLE__
+		semaphore_signal(mWake);
+#else
+		sem_post(&mWake);
+#endif
+	}
+
+private:
+	void				Wait()
+	{
+#if __APPLE__
+		while (semaphore_wait(mWake) == KERN_ABORTED) {}
+#else
+		while (sem_wait(&mWake) != 0) {}
+#endif
+	}
+
+	void				Run();
+
+	std::mutex			mLifecycle;			// starts and stops the thread
+	std::mutex			mMutex;				// the list, held while preparing
+	std::vector<AUDeferredResources *>	mPending;
+	std::thread			mThread;
+	UInt32				mUsers;				// units with resources deferred and not yet cancelled
+	bool				mExit;
+#if __APPLE__
+	semaphore_t			mWake;
+#else
+	sem_t				mWake;
+#endif
+};
+
+// built at load time, so that Request() never waits on a static-init guard
+static AUDeferredResourcesHelper sHelper;
+
+void AUDeferredResourcesHelper::Add(AUDeferredResources *inResources)
+{
+	std::lock_guard<std::mutex> lifecycle(mLifecycle);
+	if (mUsers++ == 0) {
+		mExit = false;
+		mThread = std::thread(&AUDeferredResourcesHelper::Run, this);
+	}
+	std::lock_guard<std::mutex> lock(mMutex);
+	mPending.push_back(inResources);
+}
+
+void AUDeferredResourcesHelper::Remove(AUDeferredResources *inResources)
+{
+	std::lock_guard<std::mutex> lifecycle(mLifecycle);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending.erase(std::remove(mPending.begin(), mPending.end(), inResources), mPending.end());
+		if (--mUsers == 0)
+			mExit = true;
+	}
+	if (mUsers == 0) {
+		Wake();
+		mThread.join();
+	}
+}
+
+void AUDeferredResourcesHelper::Run()
+{
+	for (;;) {
+		Wait();
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mExit)
+			return;
+		// a wake may be left over from a unit already prepared or cancelled; then there is nothing to do
+		for (size_t i = 0; i < mPending.size(); ) {
+			AUDeferredResources *resources = mPending[i];
+			if (resources->mState.load(std::memory_order_acquire) != AUDeferredResources::kRequested) {
+				++i;
+				continue;
+			}
+			resources->mPrepare(resources->mContext);
+			resources->mState.store(AUDeferredResources::kReady, std::memory_order_release);
+			mPending.erase(mPending.begin() + i);
+		}
+	}
+}
+
+void AUDeferredResources::PrepareNow(PrepareProc inPrepare, void *inContext)
+{
+	Cancel();
+	inPrepare(inContext);
+	mState.store(kReady, std::memory_order_release);
+}
+
+void AUDeferredResources::Defer(PrepareProc inPrepare, void *inContext)
+{
+	Cancel();
+	mPrepare = inPrepare;
+	mContext = inContext;
+	mState.store(kDeferred, std::memory_order_relaxed);
+	mDeferred = true;
+	sHelper.Add(this);
+}
+
+void AUDeferredResources::Cancel()
+{
+	if (mDeferred) {
+		sHelper.Remove(this);
+		mDeferred = false;
+	}
+	mState.store(kIdle, std::memory_order_relaxed);
+}
+
+void AUDeferredResources::Request()
+{
+	UInt32 deferred = kDeferred;
+	if (mState.compare_exchange_strong(deferred, kRequested, std::memory_order_release, std::memory_order_relaxed))
+		sHelper.Wake();
+}
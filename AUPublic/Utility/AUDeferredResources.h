@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AUDeferredResources_h__
+#define __AUDeferredResources_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+#include <atomic>
+
+/*
+	AUDeferredResources puts off a unit's large allocations (its kernels, scratch buffers, delay
+	lines) until the render thread first needs them, so that a session full of initialized units
+	that never hear a sound holds only what they need to pass silence. Initialize hands the work to
+	Defer() instead of doing it; the render thread checks IsReady() each cycle and, the first time
+	it has a use for the resources, calls Request(), which wakes a helper thread shared by every
+	unit in the process. The helper runs the unit's prepare function and marks it ready, and the
+	render thread starts using the resources a cycle or two later. Until then the unit renders as if
+	it had none: an effect passes its input through, an instrument leaves out what needs them.
+
+	IsReady() and Request() are for the render thread; they never block or allocate. The rest is
+	called off it, while the unit is initializing or cleaning up. Cancel() waits for a prepare under
+	way to finish, so a unit calls it before it frees what its prepare function fills in.
+*/
+class AUDeferredResources
+{
+public:
+	typedef void		(*PrepareProc)(void *inContext);
+
+	AUDeferredResources() : mState(kIdle), mPrepare(NULL), mContext(NULL), mDeferred(false) {}
+	~AUDeferredResources() { Cancel(); }
+
+	// runs inPrepare on the calling thread, for units that do not defer
+	void				PrepareNow(PrepareProc inPrepare, void *inContext);
+	// runs inPrepare on the helper thread once Request() is called
+	void				Defer(PrepareProc inPrepare, void *inContext);
+	// forgets a deferred prepare, waiting for it if the helper is running it; not ready afterwards
+	void				Cancel();
+
+	bool				IsReady() const { return mState.load(std::memory_order_acquire) == kReady; }
+	// wakes the helper the first time after Defer(); does nothing after that
+	void				Request();
+
+private:
+	AUDeferredResources(const AUDeferredResources &);
+	AUDeferredResources & operator=(const AUDeferredResources &);
+
+	friend class AUDeferredResourcesHelper;
+
+	enum { kIdle, kDeferred, kRequested, kReady };
+
+	std::atomic<UInt32>	mState;
+	PrepareProc			mPrepare;
+	void *				mContext;
+	bool				mDeferred;			// keeps the helper thread running until Cancel()
+};
+
+#endif
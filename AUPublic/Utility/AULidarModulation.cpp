@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AULidarModulation.h"
+#include "AUBase.h"
+#include "CAAtomic.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+//_____________________________________________________________________________
+//
+OSStatus	AULidarModulator::SetMappings(AUBase &inUnit, const AULidarModulationMapping *inMappings, UInt32 inNumMappings)
+{
+	std::vector<Mapping> mappings(inNumMappings);
+	for (UInt32 i = 0; i < inNumMappings; ++i) {
+		const AULidarModulationMapping &mapping = inMappings[i];
+		if (mapping.mFeature >= kAULidarModulationFeatures)
+			return kAudioUnitErr_InvalidPropertyValue;
+
+		AudioUnitParameterInfo info;
+		memset(&info, 0, sizeof(info));
+		OSStatus result = inUnit.GetParameterInfo(mapping.mScope, mapping.mParameterID, info);
+		if (result != noErr)
+			return result;
+		if ((info.flags & kAudioUnitParameterFlag_CFNameRelease) && info.cfNameString != NULL)
+			CFRelease(info.cfNameString);
+
+		Float32 low = info.minValue, high = info.maxValue;
+		if (mapping.mFlags & kAULidarModulationMapping_SubRange) {
+			low = mapping.mSubRangeMin;
+			high = mapping.mSubRangeMax;
+		}
+		if ((mapping.mFlags & kAULidarModulationMapping_Logarithmic) && (low <= 0.f || high <= 0.f))
+			return kAudioUnitErr_InvalidPropertyValue;
+		if (mapping.mFlags & kAULidarModulationMapping_Invert)
+			std::swap(low, high);
+
+		mappings[i].mMapping = mapping;
+		mappings[i].mLow = low;
+		mappings[i].mHigh = high;
+	}
+
+	// the render thread only ever tries the lock, so it is never held for long
+	while (!CAAtomicCompareAndSwap32Barrier(0, 1, &mMappingsLock))
+		usleep(100);
+	mMappings.swap(mappings);
+	CAAtomicCompareAndSwap32Barrier(1, 0, &mMappingsLock);
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+OSStatus	AULidarModulator::GetPropertyInfo(UInt32 &outDataSize, Boolean &outWritable) const
+{
+	outDataSize = (UInt32)(mMappings.size() * sizeof(AULidarModulationMapping));
+	outWritable = true;
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+OSStatus	AULidarModulator::GetProperty(void *outData) const
+{
+	AULidarModulationMapping *mappings = (AULidarModulationMapping *)outData;
+	for (size_t i = 0; i < mMappings.size(); ++i)
+		mappings[i] = mMappings[i].mMapping;
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+OSStatus	AULidarModulator::SetProperty(AUBase &inUnit, const void *inData, UInt32 inDataSize)
+{
+	if (inDataSize % sizeof(AULidarModulationMapping) != 0)
+		return kAudioUnitErr_InvalidPropertyValue;
+	return SetMappings(inUnit, (const AULidarModulationMapping *)inData, inDataSize / sizeof(AULidarModulationMapping));
+}
+
+//_____________________________________________________________________________
+//
+void	AULidarModulator::Apply(AUBase &inUnit)
+{
+	if (!CAAtomicCompareAndSwap32Barrier(0, 1, &mMappingsLock))
+		return;		// the mappings are being replaced; the next cycle picks the scan up
+
+	if (!mMappings.empty() && mBus.ReadIfNew(mFeatures)) {
+		for (size_t i = 0; i < mMappings.size(); ++i) {
+			const Mapping &mapping = mMappings[i];
+			Float32 feature = mFeatures[mapping.mMapping.mFeature];
+			if (feature < 0.f) feature = 0.f;
+			if (feature > 1.f) feature = 1.f;
+
+			Float32 value;
+			if (mapping.mMapping.mFlags & kAULidarModulationMapping_Logarithmic)
+				value = mapping.mLow * powf(mapping.mHigh / mapping.mLow, feature);
+			else
+				value = mapping.mLow + (mapping.mHigh - mapping.mLow) * feature;
+
+			inUnit.SetParameter(mapping.mMapping.mParameterID, mapping.mMapping.mScope, mapping.mMapping.mElement, value, 0);
+		}
+	}
+
+	CAAtomicCompareAndSwap32Barrier(1, 0, &mMappingsLock);
+}
@@ -0,0 +1,90 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AULidarModulation_h__
+#define __AULidarModulation_h__
+
+#include <TargetConditionals.h>
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <AudioUnit/AudioUnit.h>
+#else
+	#include <AudioUnit.h>
+#endif
+
+#include "AULidarModulationBus.h"
+#include <vector>
+
+class AUBase;
+
+/*
+	A mapping from one feature to one parameter, laid out like AUParameterMIDIMapping. Without
+	kAULidarModulationMapping_SubRange the feature sweeps the parameter's whole range.
+*/
+enum {
+	kAULidarModulationMapping_SubRange		= (1L << 2),	// sweep mSubRangeMin -> mSubRangeMax instead
+	kAULidarModulationMapping_Invert		= (1L << 8),	// feature 1 gives the low end of the range
+	kAULidarModulationMapping_Logarithmic	= (1L << 9)		// sweep evenly in log(value); the range must be > 0
+};
+
+typedef struct AULidarModulationMapping
+{
+	AudioUnitScope			mScope;
+	AudioUnitElement		mElement;
+	AudioUnitParameterID	mParameterID;
+	UInt32					mFlags;
+	Float32					mSubRangeMin;
+	Float32					mSubRangeMax;
+	UInt32					mFeature;		// kAULidarModulation_...
+	UInt32					reserved;		// MUST be set to zero
+} AULidarModulationMapping;
+
+// read/write, global scope: array of AULidarModulationMapping, replacing the unit's current set
+enum {
+	kAudioUnitCustomProperty_LidarModulationMappings = 65610
+};
+
+/*
+	AULidarModulator applies a set of mappings from the bus to a unit's parameters. A subclass of
+	AUEffectBase or AUInstrumentBase owns one, opens it in Initialize(), forwards the property
+	above to it, and calls Apply() at the top of each Render(), before anything reads the
+	parameters. Apply() only writes the parameters when a new scan has been published, so they
+	stay free for the host to change while the scanner is idle.
+*/
+	/*! @class AULidarModulator */
+class AULidarModulator {
+public:
+	AULidarModulator() : mMappingsLock(0) { }
+
+	bool				Open() { return mBus.Open(); }
+	void				Close() { mBus.Close(); }
+
+	// the parameter ranges are looked up through inUnit's GetParameterInfo; main thread only
+	OSStatus			SetMappings(AUBase &inUnit, const AULidarModulationMapping *inMappings, UInt32 inNumMappings);
+	UInt32				NumMappings() const { return (UInt32)mMappings.size(); }
+
+	OSStatus			GetPropertyInfo(UInt32 &outDataSize, Boolean &outWritable) const;
+	OSStatus			GetProperty(void *outData) const;
+	OSStatus			SetProperty(AUBase &inUnit, const void *inData, UInt32 inDataSize);
+
+	// render thread
+	void				Apply(AUBase &inUnit);
+
+private:
+	struct Mapping {
+		AULidarModulationMapping	mMapping;
+		Float32						mLow;		// the parameter values at feature 0 and feature 1
+		Float32						mHigh;
+	};
+
+	AULidarModulationBus	mBus;
+	std::vector<Mapping>	mMappings;
+	volatile SInt32			mMappingsLock;	// held by SetMappings while it edits mMappings
+	Float32					mFeatures[kAULidarModulationFeatures];
+};
+
+#endif // __AULidarModulation_h__
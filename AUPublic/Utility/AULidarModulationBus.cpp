@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AULidarModulationBus.h"
+#include <atomic>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *	kModulationBusName = "/LidarSynth.modulation";
+static const UInt32	kModulationBusMagic = 'LdMb';
+static const UInt32	kModulationBusVersion = 2;
+
+struct AULidarModulationBus::Frame {
+	UInt32				mMagic;
+	UInt32				mVersion;
+	std::atomic<UInt32>	mSequence;		// odd while a publish is in progress, 0 before the first
+	UInt32				mNumFeatures;
+	UInt64				mCaptureTime;	// host time in nanoseconds of the scan
+	Float32				mFeatures[kAULidarModulationFeatures];
+};
+
+// the segment is shared with processes built before mSequence was atomic, and with other compilers
+static_assert(sizeof(std::atomic<UInt32>) == sizeof(UInt32) && std::atomic<UInt32>::is_always_lock_free,
+			  "the sequence count keeps the layout of a plain UInt32");
+
+//_____________________________________________________________________________
+//
+bool	AULidarModulationBus::Open()
+{
+	if (mFrame != NULL)
+		return true;
+
+	// whichever side comes first creates the segment; the other maps the same one
+	int fd = shm_open(kModulationBusName, O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (info.st_size < (off_t)sizeof(Frame) && ftruncate(fd, sizeof(Frame)) != 0)) {
+		close(fd);
+		return false;
+	}
+
+	void *memory = mmap(NULL, sizeof(Frame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED)
+		return false;
+
+	Frame *frame = (Frame *)memory;
+	if (frame->mMagic == 0) {
+		// a fresh segment is all zeros; two units racing here write the same values
+		frame->mVersion = kModulationBusVersion;
+		frame->mNumFeatures = kAULidarModulationFeatures;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		frame->mMagic = kModulationBusMagic;
+	}
+	if (frame->mMagic != kModulationBusMagic || frame->mVersion != kModulationBusVersion
+		|| frame->mNumFeatures != kAULidarModulationFeatures) {
+		munmap(memory, sizeof(Frame));
+		return false;
+	}
+
+	mFrame = frame;
+	mLastSequence = 0;
+	return true;
+}
+
+//_____________________________________________________________________________
+//
+void	AULidarModulationBus::Close()
+{
+	if (mFrame != NULL) {
+		munmap(mFrame, sizeof(Frame));
+		mFrame = NULL;
+	}
+}
+
+//_____________________________________________________________________________
+//
+void	AULidarModulationBus::Publish(UInt64 inCaptureTime, const Float32 *inFeatures)
+{
+	if (mFrame == NULL)
+		return;
+
+	UInt32 sequence = mFrame->mSequence.load(std::memory_order_relaxed);
+	if ((sequence & 1) || !mFrame->mSequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_seq_cst))
+		return;
+
+	mFrame->mCaptureTime = inCaptureTime;
+	memcpy(mFrame->mFeatures, inFeatures, sizeof(mFrame->mFeatures));
+
+	mFrame->mSequence.store(sequence + 2, std::memory_order_seq_cst);
+}
+
+//_____________________________________________________________________________
+//
+bool	AULidarModulationBus::ReadIfNew(Float32 *outFeatures)
+{
+	if (mFrame == NULL)
+		return false;
+
+	// one retry covers a publish that was in flight; beyond that, try again next render cycle
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		UInt32 before = mFrame->mSequence.load(std::memory_order_seq_cst);
+		if (before == mLastSequence)
+			return false;
+		if (before & 1)
+			continue;
+
+		Float32 features[kAULidarModulationFeatures];
+		memcpy(features, mFrame->mFeatures, sizeof(features));
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (mFrame->mSequence.load(std::memory_order_relaxed) == before) {
+			memcpy(outFeatures, features, sizeof(features));
+			mLastSequence = before;
+			return true;
+		}
+	}
+	return false;
+}
+
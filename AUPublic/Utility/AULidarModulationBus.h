@@ -0,0 +1,81 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AULidarModulationBus_h__
+#define __AULidarModulationBus_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+#include <cstddef>
+
+/*
+	The LiDAR modulation bus carries a small vector of scan features from the one audio unit that
+	owns the scanner (SinSynth's LidarDeviceHub) to any other unit in the process, or in another
+	process on the same machine, without the others opening the device. The features live in a
+	named POSIX shared memory segment guarded by a sequence count: the publisher makes the count
+	odd, writes, and makes it even again, and a reader keeps its copy only if it saw the same even
+	count before and after.
+
+	Every feature is normalized to 0 -> 1. Closeness is 1 - distance / the scanner's maximum distance,
+	so 1 is touching the sensor and 0 is nothing in range. Sector s covers angles
+	[s, s + 1) * 360 / kAULidarModulationSectors degrees.
+
+	The bus needs nothing from the Audio Unit framework, so a process with no unit in it, such as
+	LidarDaemon or a host of the headless SinSynthEngine, can publish or read it on any POSIX system.
+*/
+enum {
+	kAULidarModulationSectors				= 8,
+
+	kAULidarModulation_Nearest				= 0,	// closeness of the nearest return in the scan
+	kAULidarModulation_Mean					= 1,	// mean closeness of the valid returns
+	kAULidarModulation_Coverage				= 2,	// fraction of the scan's samples that returned
+	kAULidarModulation_SectorNearest		= 3,	// + sector: closeness of the nearest return in the sector
+	kAULidarModulation_SectorDensity		= kAULidarModulation_SectorNearest + kAULidarModulationSectors,
+													// + sector: the sector's share of the valid returns against
+													// an even split, clipped to 1
+	kAULidarModulation_Motion				= kAULidarModulation_SectorDensity + kAULidarModulationSectors,
+													// share of the scan that differs from the room's
+													// running background
+	kAULidarModulation_SectorMotion			= kAULidarModulation_Motion + 1,
+													// + sector: the same within the sector
+	kAULidarModulationFeatures				= kAULidarModulation_SectorMotion + kAULidarModulationSectors
+};
+
+	/*! @class AULidarModulationBus */
+class AULidarModulationBus {
+public:
+	AULidarModulationBus() : mFrame(NULL), mLastSequence(0) { }
+	~AULidarModulationBus() { Close(); }
+
+	// maps the segment, creating it if nobody has yet; not for the render thread
+	bool				Open();
+	void				Close();
+	bool				IsOpen() const { return mFrame != NULL; }
+
+	// publisher side; a publish that finds another one in progress is skipped
+	void				Publish(UInt64 inCaptureTime, const Float32 *inFeatures);
+
+	// reader side, wait-free: true if a scan newer than the last one this object read was copied
+	// into outFeatures (kAULidarModulationFeatures values)
+	bool				ReadIfNew(Float32 *outFeatures);
+
+	struct Frame;
+
+private:
+	AULidarModulationBus(const AULidarModulationBus &);
+	AULidarModulationBus & operator=(const AULidarModulationBus &);
+
+	Frame *				mFrame;
+	UInt32				mLastSequence;
+};
+
+#endif // __AULidarModulationBus_h__
@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AUParameterBlock_h__
+#define __AUParameterBlock_h__
+
+#include <CoreAudio/CoreAudioTypes.h>
+#include <atomic>
+
+/*
+	An AUParameterBlock carries a set of related settings from the non-realtime side of a unit (a
+	property setter, a view) to its render thread as one versioned block, so that the render thread
+	never sees some of the settings changed and not the rest. The writer edits Pending() and calls
+	Publish(), which stamps the block with the next version; AUBase takes the newest published
+	version of every block it was given with RegisterParameterBlock() at the top of each render
+	cycle (see AUBase::ParameterBlockChanged), and the cycle reads Current() throughout.
+
+	The block is triple-buffered: the writer fills its back buffer and swaps it with the middle one,
+	the render thread swaps the middle one with its front buffer when there is a fresh one there.
+	Neither side ever blocks or allocates, and a version the render thread had no cycle for is
+	simply replaced by the next one. Pending() keeps every setting the writer has made, so each
+	version is complete, and it is where a writer that changes only some of the settings starts.
+
+	There must be one writer at a time; a unit whose setters may be called on several threads
+	serializes them itself. Acquire() is for the render thread only.
+*/
+class AUParameterBlockBase
+{
+public:
+	AUParameterBlockBase() : mVersion(0) {}
+	virtual ~AUParameterBlockBase() {}
+
+	// takes the newest published version, if there is one the render thread does not have yet; true
+	// if it did
+	virtual bool		Acquire() = 0;
+
+	// of the block the render thread holds; 0 until the first version is taken
+	UInt64				Version() const { return mVersion; }
+
+protected:
+	UInt64				mVersion;
+};
+
+template <class T>
+class AUParameterBlock : public AUParameterBlockBase
+{
+public:
+	AUParameterBlock()
+		: mPending(), mNextVersion(1), mBack(0), mMiddle(1), mFront(2)
+	{
+		for (UInt32 i = 0; i < 3; ++i) {
+			mBuffers[i] = mPending;
+			mVersions[i] = 0;
+		}
+	}
+
+	// --- writer side ---
+
+	T &					Pending() { return mPending; }
+	// the version the next Publish() stamps
+	UInt64				NextVersion() const { return mNextVersion; }
+
+	// hands a copy of the pending settings to the render thread; returns its version
+	UInt64				Publish()
+	{
+		mBuffers[mBack] = mPending;
+		mVersions[mBack] = mNextVersion;
+		mBack = mMiddle.exchange(mBack | kFreshBit, std::memory_order_acq_rel) & kIndexMask;
+		return mNextVersion++;
+	}
+
+	// --- render thread ---
+
+	virtual bool		Acquire()
+	{
+		if (!(mMiddle.load(std::memory_order_relaxed) & kFreshBit))
+			return false;
+		mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & kIndexMask;
+		mVersion = mVersions[mFront];
+		return true;
+	}
+
+	const T &			Current() const { return mBuffers[mFront]; }
+
+private:
+	enum { kIndexMask = 0x3, kFreshBit = 0x4 };
+
+	AUParameterBlock(const AUParameterBlock &);
+	AUParameterBlock & operator=(const AUParameterBlock &);
+
+	T					mBuffers[3];
+	UInt64				mVersions[3];	// each written before its buffer is published
+	T					mPending;		// owned by the writer
+	UInt64				mNextVersion;	// owned by the writer
+	UInt32				mBack;			// owned by the writer
+	std::atomic<UInt32>	mMiddle;		// the buffer between the two, plus kFreshBit once published
+	UInt32				mFront;			// owned by the render thread
+};
+
+#endif
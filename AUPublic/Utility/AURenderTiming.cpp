@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AURenderTiming.h"
+#include "CAHostTimeBase.h"
+#include <string.h>
+#include <unistd.h>
+
+static const Float32 kDefaultOverrunThreshold = 0.8f;
+
+//_____________________________________________________________________________
+//
+AURenderTiming::AURenderTiming()
+	: mTotalLoad(0), mTotalSourceLatency(0), mSequence(0), mResetRequested(0), mOverrunThreshold(kDefaultOverrunThreshold)
+{
+	memset(&mStatistics, 0, sizeof(mStatistics));
+	memset(mLatencyHistogram, 0, sizeof(mLatencyHistogram));
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTiming::BeginUpdate()
+{
+	// only the render thread writes, so the count needs no compare and swap, just the barriers
+	mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (mResetRequested.load(std::memory_order_relaxed) && mResetRequested.exchange(0)) {
+		UInt32 qualityLevel = mStatistics.mQualityLevel;
+		memset(&mStatistics, 0, sizeof(mStatistics));
+		mStatistics.mQualityLevel = qualityLevel;
+		memset(mLatencyHistogram, 0, sizeof(mLatencyHistogram));
+		mTotalLoad = 0;
+		mTotalSourceLatency = 0;
+	}
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTiming::EndUpdate()
+{
+	mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//_____________________________________________________________________________
+//
+bool	AURenderTiming::EndCycle(UInt64 inStartTime, UInt64 inEndTime, UInt32 inFrames, Float64 inSampleRate, bool inDenormalGuardEngaged)
+{
+	Float64 duration = CAHostTimeBase::ConvertToNanos(inEndTime - inStartTime) * 1.0e-9;
+	Float64 budget = inSampleRate > 0 ? inFrames / inSampleRate : 0;
+	Float64 load = budget > 0 ? duration / budget : 0;
+	Float32 threshold = mOverrunThreshold;
+
+	BeginUpdate();
+
+	AURenderTimingStatistics &s = mStatistics;
+	s.mNumCycles++;
+	if (load > threshold)
+		s.mNumOverruns++;
+	if (inDenormalGuardEngaged)
+		s.mNumDenormalGuardCycles++;
+	s.mLastDuration = duration;
+	s.mLastBudget = budget;
+	s.mLastFrames = inFrames;
+	mTotalLoad += load;
+	s.mMeanLoad = mTotalLoad / s.mNumCycles;
+	if (load > s.mMaxLoad)
+		s.mMaxLoad = load;
+	UInt32 bin = load < Float64(kAURenderTimingHistogramBins) / kAURenderTimingBinsPerBudget
+					? UInt32(load * kAURenderTimingBinsPerBudget) : kAURenderTimingHistogramBins - 1;
+	s.mHistogram[bin]++;
+
+	EndUpdate();
+	return load > threshold;
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTiming::RecordSourceLatency(Float64 inLatency)
+{
+	if (inLatency < 0)
+		inLatency = 0;		// host and capture clocks disagree by a hair; call it no latency
+
+	BeginUpdate();
+
+	AURenderTimingStatistics &s = mStatistics;
+	if (s.mNumSourceLatencies == 0 || inLatency < s.mMinSourceLatency)
+		s.mMinSourceLatency = inLatency;
+	if (inLatency > s.mMaxSourceLatency)
+		s.mMaxSourceLatency = inLatency;
+	s.mNumSourceLatencies++;
+	mTotalSourceLatency += inLatency;
+	s.mMeanSourceLatency = mTotalSourceLatency / s.mNumSourceLatencies;
+	UInt32 bin = inLatency < kAURenderTimingLatencyBins * kAURenderTimingLatencyBinWidth
+					? UInt32(inLatency / kAURenderTimingLatencyBinWidth) : kAURenderTimingLatencyBins - 1;
+	mLatencyHistogram[bin]++;
+
+	EndUpdate();
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTiming::RecordQualityLevel(UInt32 inLevel)
+{
+	BeginUpdate();
+
+	AURenderTimingStatistics &s = mStatistics;
+	if (inLevel > s.mQualityLevel)
+		s.mNumQualityReductions++;
+	else if (inLevel < s.mQualityLevel)
+		s.mNumQualityRecoveries++;
+	s.mQualityLevel = inLevel;
+
+	EndUpdate();
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTiming::GetStatistics(AURenderTimingStatistics &outStatistics) const
+{
+	// an update takes well under a microsecond; only a preempted render thread keeps one open
+	UInt32 histogram[kAURenderTimingLatencyBins];
+	for (;;) {
+		UInt32 before = mSequence.load(std::memory_order_acquire);
+		if (!(before & 1)) {
+			memcpy(&outStatistics, &mStatistics, sizeof(outStatistics));
+			memcpy(histogram, mLatencyHistogram, sizeof(histogram));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (mSequence.load(std::memory_order_relaxed) == before)
+				break;
+		}
+		usleep(10);
+	}
+	outStatistics.mOverrunThreshold = mOverrunThreshold;
+
+	// the upper edge of the bin holding the 99th percentile, but never beyond the largest seen
+	if (outStatistics.mNumSourceLatencies > 0) {
+		UInt64 rank = (outStatistics.mNumSourceLatencies * 99 + 99) / 100, seen = 0;
+		UInt32 bin = 0;
+		while (bin < kAURenderTimingLatencyBins - 1 && seen + histogram[bin] < rank)
+			seen += histogram[bin++];
+		Float64 edge = (bin + 1) * kAURenderTimingLatencyBinWidth;
+		outStatistics.mP99SourceLatency = edge < outStatistics.mMaxSourceLatency ? edge : outStatistics.mMaxSourceLatency;
+	}
+}
@@ -0,0 +1,123 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AURenderTiming_h__
+#define __AURenderTiming_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+#include <atomic>
+
+/*
+	Every AUBase times its render cycles (AUBase::DoRender, from its entry to the
+	last post-render notification) against the cycle's budget, its frames / the output sample rate.
+	A cycle's load is its duration / its budget. The histogram bins the loads in steps of
+	1 / kAURenderTimingBinsPerBudget; the last bin also holds every heavier cycle.
+*/
+enum {
+	kAURenderTimingBinsPerBudget		= 16,
+	kAURenderTimingHistogramBins		= 2 * kAURenderTimingBinsPerBudget,
+	kAURenderTimingLatencyBins			= 256		// of kAURenderTimingLatencyBinWidth each
+};
+
+/*
+	A unit that renders from data produced elsewhere (SinSynth's LiDAR scans) also reports, once
+	per piece of data, its source latency: the time from its capture to the host time of the first
+	cycle that used it. The 99th percentile is read off a histogram, so it is exact to within one
+	bin, and latencies beyond the last bin count as that bin.
+*/
+static const Float64 kAURenderTimingLatencyBinWidth = 0.0005;	// seconds
+
+typedef struct AURenderTimingStatistics
+{
+	UInt64					mNumCycles;
+	UInt64					mNumOverruns;			// cycles whose load exceeded mOverrunThreshold
+	Float64					mLastDuration;			// seconds
+	Float64					mLastBudget;			// seconds
+	UInt32					mLastFrames;
+	Float32					mOverrunThreshold;		// as set through kAudioUnitCustomProperty_RenderTimingThreshold
+	Float64					mMeanLoad;
+	Float64					mMaxLoad;
+	UInt32					mHistogram[kAURenderTimingHistogramBins];
+
+	UInt64					mNumSourceLatencies;	// 0 for a unit that reports none
+	Float64					mMinSourceLatency;		// seconds
+	Float64					mMeanSourceLatency;
+	Float64					mP99SourceLatency;
+	Float64					mMaxSourceLatency;
+
+	UInt64					mNumDenormalGuardCycles;	// cycles that had to turn flush-to-zero on themselves
+
+	// an instrument shedding load (see kAudioUnitCustomProperty_LoadShedding); a reset keeps the level
+	UInt64					mNumQualityReductions;	// steps down
+	UInt64					mNumQualityRecoveries;	// steps back up
+	UInt32					mQualityLevel;			// steps currently shed, 0 for full quality
+} AURenderTimingStatistics;
+
+enum {
+	// read/write, global scope: AURenderTimingStatistics since the unit was opened or the
+	// statistics last reset; setting it, with any value, resets them
+	kAudioUnitCustomProperty_RenderTiming				= 65620,
+	// read/write, global scope: Float32, the load above which a cycle counts as an overrun; default 0.8
+	kAudioUnitCustomProperty_RenderTimingThreshold		= 65621,
+	// read/write, global scope: UInt32, nonzero if the render calls flush denormals to zero; default 1
+	kAudioUnitCustomProperty_DenormalProtection			= 65622,
+	// read/write, global scope, instruments only: UInt32, nonzero if the unit steps its quality down
+	// as its load nears the budget and back up once there is headroom again; default 0
+	kAudioUnitCustomProperty_LoadShedding				= 65623
+};
+
+/*
+	AURenderTiming is written by the render thread and read by any other through a sequence count,
+	as the LiDAR modulation bus is: the writer makes the count odd, updates and makes it even again,
+	and a reader keeps its copy only if it saw the same even count on both sides. Timing a cycle
+	costs two host time reads and a few additions; nothing on the render thread locks or allocates.
+	It needs nothing from the Audio Unit framework, so a host of the headless engine times its own
+	cycles with it too.
+*/
+	/*! @class AURenderTiming */
+class AURenderTiming {
+public:
+	AURenderTiming();
+
+	// render thread; inStartTime and inEndTime are the host times the cycle began and ended, and
+	// inDenormalGuardEngaged whether the cycle's CADenormalGuard had to turn flush-to-zero on.
+	// Returns whether the cycle counted as an overrun.
+	bool				EndCycle(UInt64 inStartTime, UInt64 inEndTime, UInt32 inFrames, Float64 inSampleRate, bool inDenormalGuardEngaged);
+	// render thread; seconds from the capture of the data to the cycle's host time
+	void				RecordSourceLatency(Float64 inLatency);
+	// render thread; the level an instrument's load shedding has just stepped to
+	void				RecordQualityLevel(UInt32 inLevel);
+	// render thread; the last cycle's duration / its budget, 0 before the first
+	Float64				LastLoad() const { return mStatistics.mLastBudget > 0 ? mStatistics.mLastDuration / mStatistics.mLastBudget : 0; }
+
+	// any thread
+	void				GetStatistics(AURenderTimingStatistics &outStatistics) const;
+	void				Reset() { mResetRequested = 1; }
+
+	Float32				OverrunThreshold() const { return mOverrunThreshold; }
+	void				SetOverrunThreshold(Float32 inThreshold) { mOverrunThreshold = inThreshold; }
+
+private:
+	void				BeginUpdate();
+	void				EndUpdate();
+
+	AURenderTimingStatistics	mStatistics;
+	Float64						mTotalLoad;
+	Float64						mTotalSourceLatency;
+	UInt32						mLatencyHistogram[kAURenderTimingLatencyBins];
+	std::atomic<UInt32>			mSequence;			// odd while the render thread is updating
+	std::atomic<SInt32>			mResetRequested;	// the render thread clears the statistics at its next cycle
+	volatile Float32			mOverrunThreshold;
+};
+
+#endif // __AURenderTiming_h__
@@ -0,0 +1,226 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#include "AURenderTrace.h"
+#include "CAHostTimeBase.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <string.h>
+#include <unistd.h>
+
+#if __APPLE__
+	#include <pthread.h>
+#endif
+
+static const UInt32 kWriterPollMilliseconds = 100;
+
+static volatile std::sig_atomic_t sSignalDumpRequested = 0;
+
+static void	RequestDumpOnSignal(int)
+{
+	sSignalDumpRequested = 1;
+}
+
+/*
+	The process's one writer thread, started by the first trace and joined when the process exits.
+	It holds mMutex while it dumps, so a trace that unregisters waits for its dump to finish.
+*/
+class AURenderTraceWriter {
+public:
+	static AURenderTraceWriter &	Get()
+	{
+		static AURenderTraceWriter sWriter;
+		return sWriter;
+	}
+
+	UInt32				Add(AURenderTrace *inTrace)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTraces.push_back(inTrace);
+		if (!mThread.joinable())
+			mThread = std::thread(&AURenderTraceWriter::WriterThread, this);
+		return mNextTraceID++;
+	}
+
+	void				Remove(AURenderTrace *inTrace)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTraces.erase(std::remove(mTraces.begin(), mTraces.end(), inTrace), mTraces.end());
+	}
+
+	void				SetDirectory(const char *inDirectory)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mDirectory = inDirectory;
+	}
+
+private:
+	AURenderTraceWriter() : mNextTraceID(0), mExit(false)
+	{
+		const char *tmp = getenv("TMPDIR");
+		mDirectory = tmp != NULL && tmp[0] != 0 ? tmp : "/tmp";
+	}
+
+	~AURenderTraceWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mExit = true;
+		}
+		mExitCondition.notify_all();
+		if (mThread.joinable())
+			mThread.join();
+	}
+
+	void				WriterThread()
+	{
+#if __APPLE__
+		// dumping must never compete with the render threads
+		pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#endif
+		std::vector<AURenderTraceRecord> copy(kAURenderTraceRecords);
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (!mExitCondition.wait_for(lock, std::chrono::milliseconds(kWriterPollMilliseconds), [this]{ return mExit; })) {
+			bool signalled = sSignalDumpRequested != 0;
+			sSignalDumpRequested = 0;
+			for (AURenderTrace *trace : mTraces) {
+				UInt32 reason = trace->mDumpRequest.exchange(0);
+				if (signalled)
+					reason = kAURenderTraceReason_Signal;
+				if (reason != 0)
+					trace->WriteDump(reason, mDirectory.c_str(), &copy[0]);
+			}
+		}
+	}
+
+	std::mutex					mMutex;				// guards everything below
+	std::vector<AURenderTrace *>	mTraces;
+	std::string					mDirectory;
+	UInt32						mNextTraceID;
+	bool						mExit;
+	std::condition_variable		mExitCondition;
+	std::thread					mThread;
+};
+
+//_____________________________________________________________________________
+//
+AURenderTrace::AURenderTrace()
+	: mRecords(new AURenderTraceRecord[kAURenderTraceRecords]), mNumCycles(0), mActiveVoices(0), mEvents(0),
+	  mSourceID(0), mDumpRequest(0), mDumpsOnOverrun(false), mOverrunThreshold(0), mNumDumps(0), mLastOverrunDump(0)
+{
+	memset(mRecords, 0, kAURenderTraceRecords * sizeof(AURenderTraceRecord));
+	mTraceID = AURenderTraceWriter::Get().Add(this);
+}
+
+//_____________________________________________________________________________
+//
+AURenderTrace::~AURenderTrace()
+{
+	AURenderTraceWriter::Get().Remove(this);
+	delete[] mRecords;
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTrace::EndCycle(UInt64 inStartTime, UInt64 inEndTime, UInt32 inFrames, bool inOverrun, Float32 inOverrunThreshold)
+{
+	UInt64 cycle = mNumCycles.load(std::memory_order_relaxed);
+	AURenderTraceRecord &record = mRecords[cycle & (kAURenderTraceRecords - 1)];
+	record.mStartTime = inStartTime;
+	record.mEndTime = inEndTime;
+	record.mSourceID = mSourceID;
+	record.mFrames = inFrames;
+	record.mActiveVoices = UInt16(std::min<UInt32>(mActiveVoices, 0xFFFF));
+	record.mEvents = UInt16(std::min<UInt32>(mEvents, 0xFFFF));
+	mNumCycles.store(cycle + 1, std::memory_order_release);
+
+	mEvents = 0;
+	mOverrunThreshold.store(inOverrunThreshold, std::memory_order_relaxed);
+	// the writer rate-limits these; a pending dump of any reason already covers this cycle
+	if (inOverrun && mDumpsOnOverrun.load(std::memory_order_relaxed) && mDumpRequest.load(std::memory_order_relaxed) == 0)
+		mDumpRequest.store(kAURenderTraceReason_Overrun, std::memory_order_relaxed);
+}
+
+//_____________________________________________________________________________
+//
+bool	AURenderTrace::WriteDump(UInt32 inReason, const char *inDirectory, AURenderTraceRecord *ioCopy)
+{
+	UInt64 now = CAHostTimeBase::GetTheCurrentTime();
+	if (inReason == kAURenderTraceReason_Overrun) {
+		if (mLastOverrunDump != 0 && now - mLastOverrunDump < UInt64(kAURenderTraceOverrunDumpInterval * CAHostTimeBase::GetFrequency()))
+			return false;
+		mLastOverrunDump = now;
+	}
+
+	// the render thread keeps writing during the copy: whatever it may have reached by the second
+	// look at the count, including the record it may be in the middle of, is left out
+	UInt64 end = mNumCycles.load(std::memory_order_acquire);
+	UInt64 first = end > kAURenderTraceRecords ? end - kAURenderTraceRecords : 0;
+	for (UInt64 cycle = first; cycle < end; ++cycle)
+		ioCopy[cycle - first] = mRecords[cycle & (kAURenderTraceRecords - 1)];
+	std::atomic_thread_fence(std::memory_order_acquire);
+	UInt64 reached = mNumCycles.load(std::memory_order_relaxed);
+	UInt64 skip = std::min(end - first, reached + 1 > first + kAURenderTraceRecords ? reached + 1 - first - kAURenderTraceRecords : 0);
+
+	AURenderTraceFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mMagic = kAURenderTraceFileMagic;
+	header.mVersion = kAURenderTraceFileVersion;
+	header.mHeaderSize = sizeof(AURenderTraceFileHeader);
+	header.mRecordSize = sizeof(AURenderTraceRecord);
+	header.mNumRecords = UInt32(end - first - skip);
+	header.mReason = inReason;
+	header.mProcessID = UInt32(getpid());
+	header.mTraceID = mTraceID;
+	header.mDumpTime = now;
+	header.mHostTicksPerSecond = CAHostTimeBase::GetFrequency();
+	header.mFirstCycle = first + skip;
+	header.mOverrunThreshold = mOverrunThreshold.load(std::memory_order_relaxed);
+
+	UInt32 dump = mNumDumps.load(std::memory_order_relaxed);
+	std::string path = std::string(inDirectory) + "/AURenderTrace-" + std::to_string(header.mProcessID) + "-"
+						+ std::to_string(mTraceID) + "-" + std::to_string(dump) + ".trace";
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+		return false;
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1
+				&& fwrite(ioCopy + skip, sizeof(AURenderTraceRecord), header.mNumRecords, file) == header.mNumRecords;
+	written = fclose(file) == 0 && written;
+	if (written)
+		mNumDumps.store(dump + 1, std::memory_order_relaxed);
+	else
+		remove(path.c_str());
+	return written;
+}
+
+//_____________________________________________________________________________
+//
+void	AURenderTrace::SetDumpDirectory(const char *inDirectory)
+{
+	AURenderTraceWriter::Get().SetDirectory(inDirectory);
+}
+
+//_____________________________________________________________________________
+//
+bool	AURenderTrace::DumpAllOnSignal(int inSignal)
+{
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = RequestDumpOnSignal;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	return sigaction(inSignal, &action, NULL) == 0;
+}
@@ -0,0 +1,146 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AURenderTrace_h__
+#define __AURenderTrace_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+#include <atomic>
+
+/*
+	A flight recorder of the last kAURenderTraceRecords render cycles, one record each, so that what
+	led up to a glitch can be read back after the fact rather than only its count in AURenderTiming.
+*/
+enum {
+	kAURenderTraceRecords				= 4096		// a power of two; 47 s of 512 frame cycles at 44.1 kHz
+};
+
+static const Float64 kAURenderTraceOverrunDumpInterval = 10.;	// seconds between dumps an overrun triggers
+
+// one render cycle, as written to a dump
+typedef struct AURenderTraceRecord
+{
+	UInt64					mStartTime;			// host time
+	UInt64					mEndTime;			// host time
+	UInt64					mSourceID;			// the data the cycle rendered from (SinSynth: its scan's capture time), 0 for none
+	UInt32					mFrames;
+	UInt16					mActiveVoices;		// sounding as the cycle began, saturating
+	UInt16					mEvents;			// performed during the cycle, saturating
+} AURenderTraceRecord;
+
+enum {
+	kAURenderTraceReason_Property		= 1,		// kAudioUnitCustomProperty_RenderTraceDump was set
+	kAURenderTraceReason_Overrun		= 2,		// a cycle's load exceeded the overrun threshold
+	kAURenderTraceReason_Signal			= 3			// the process got the signal given to DumpAllOnSignal()
+};
+
+/*
+	A dump is one file, AURenderTrace-<process ID>-<trace ID>-<dump number>.trace in the dump
+	directory, in the host's byte order: an AURenderTraceFileHeader, then mNumRecords
+	AURenderTraceRecords of mRecordSize bytes each, oldest first. Host times convert to seconds by
+	dividing by mHostTicksPerSecond; the first record is cycle mFirstCycle of the trace, counting from 0.
+	A reader should skip mHeaderSize bytes to the records and step mRecordSize between them, so that
+	later versions may append fields to either.
+*/
+enum {
+	kAURenderTraceFileMagic				= 'AUtr',
+	kAURenderTraceFileVersion			= 1
+};
+
+typedef struct AURenderTraceFileHeader
+{
+	UInt32					mMagic;				// kAURenderTraceFileMagic
+	UInt32					mVersion;			// kAURenderTraceFileVersion
+	UInt32					mHeaderSize;		// bytes
+	UInt32					mRecordSize;		// bytes
+	UInt32					mNumRecords;
+	UInt32					mReason;			// a kAURenderTraceReason_
+	UInt32					mProcessID;
+	UInt32					mTraceID;			// one per trace in the process, in order of creation
+	UInt64					mDumpTime;			// host time the dump was taken
+	Float64					mHostTicksPerSecond;
+	UInt64					mFirstCycle;
+	Float32					mOverrunThreshold;	// the load the unit counted as an overrun
+	UInt32					mReserved;
+} AURenderTraceFileHeader;
+
+enum {
+	// read/write, global scope: UInt32; setting it, with any value, dumps the trace in the background.
+	// Reading gives the number of dumps written so far, whatever triggered them.
+	kAudioUnitCustomProperty_RenderTraceDump			= 65625,
+	// read/write, global scope: UInt32, nonzero if a cycle over the overrun threshold dumps the trace,
+	// at most once every kAURenderTraceOverrunDumpInterval; default 0
+	kAudioUnitCustomProperty_RenderTraceOnOverrun		= 65626
+};
+
+/*
+	AURenderTrace is written by the render thread with plain stores into a ring allocated up front;
+	the count of cycles is published with a release store after each record. A dump is only
+	requested from the render thread, by setting a flag: one writer thread per process, at utility
+	priority, polls the flags of every trace a few times a second, copies the ring and checks the
+	count again so that records overwritten during the copy are left out, then writes the file. The
+	writer's mutex is taken by the constructor and the destructor, never by the render thread, so a
+	trace is not destroyed in the middle of a dump.
+
+	Every AUBase keeps one: AUBase::DoRender() ends the cycle with its host times, the subclass
+	tells it the voices, events and source of the cycle along the way. Like AURenderTiming it needs
+	nothing from the Audio Unit framework, so the headless engine's hosts trace with it too.
+*/
+	/*! @class AURenderTrace */
+class AURenderTrace {
+public:
+	AURenderTrace();
+	~AURenderTrace();
+
+	// render thread, any time during the cycle
+	void				SetActiveVoices(UInt32 inVoices) { mActiveVoices = inVoices; }
+	void				AddEvents(UInt32 inEvents) { mEvents += inEvents; }
+	void				SetSourceID(UInt64 inSourceID) { mSourceID = inSourceID; }
+	// render thread, last: appends the cycle's record; inOverrun is whether AURenderTiming counted it
+	// as an overrun
+	void				EndCycle(UInt64 inStartTime, UInt64 inEndTime, UInt32 inFrames, bool inOverrun, Float32 inOverrunThreshold);
+
+	// any thread
+	void				RequestDump() { mDumpRequest = kAURenderTraceReason_Property; }
+	UInt32				NumDumps() const { return mNumDumps.load(std::memory_order_relaxed); }
+	bool				DumpsOnOverrun() const { return mDumpsOnOverrun.load(std::memory_order_relaxed); }
+	void				SetDumpsOnOverrun(bool inDumps) { mDumpsOnOverrun = inDumps; }
+
+	// where every trace of the process writes its dumps; $TMPDIR, or /tmp, unless set
+	static void			SetDumpDirectory(const char *inDirectory);
+	// installs a handler that dumps every trace of the process when it gets inSignal (SIGUSR1, say);
+	// false if the handler could not be installed
+	static bool			DumpAllOnSignal(int inSignal);
+
+private:
+	AURenderTrace(const AURenderTrace &);
+	AURenderTrace & operator=(const AURenderTrace &);
+
+	friend class AURenderTraceWriter;
+	// the writer's thread, with its mutex held; false if the file could not be written
+	bool				WriteDump(UInt32 inReason, const char *inDirectory, AURenderTraceRecord *ioCopy);
+
+	AURenderTraceRecord *		mRecords;			// kAURenderTraceRecords
+	std::atomic<UInt64>			mNumCycles;			// the next record goes at mNumCycles % kAURenderTraceRecords
+	UInt32						mActiveVoices;		// of the cycle under way
+	UInt32						mEvents;
+	UInt64						mSourceID;
+	std::atomic<UInt32>			mDumpRequest;		// a kAURenderTraceReason_, 0 for none
+	std::atomic<bool>			mDumpsOnOverrun;
+	std::atomic<Float32>		mOverrunThreshold;	// as of the last cycle, for the dump's header
+	std::atomic<UInt32>			mNumDumps;
+	UInt64						mLastOverrunDump;	// writer thread; host time
+	UInt32						mTraceID;
+};
+
+#endif // __AURenderTrace_h__
@@ -0,0 +1,60 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio AUBase Classes
+*/
+
+#ifndef __AUSignpost_h__
+#define __AUSignpost_h__
+
+/*
+	Signposts label the phases of rendering and of the LiDAR ingest for Instruments' os_signpost and
+	Points of Interest tracks. They are a build setting: with AU_SIGNPOSTS=1 in the preprocessor
+	definitions (and os_signpost, macOS 10.14 or later) each macro below emits one, and otherwise every
+	one of them expands to nothing, so a release build carries no trace of them. Names must be string
+	literals, which os_signpost keeps in the binary rather than copying at run time.
+
+	AU_SIGNPOST_INTERVAL(name) spans the rest of the enclosing scope; it declares a variable, so it
+	goes where a statement may, one to a line, never as the body of an if. Each interval takes its
+	own signpost ID, so intervals of one name on several threads (the render workers, say) do not
+	end each other. AU_SIGNPOST_EVENT(name) marks a single point in time.
+*/
+#if !defined(AU_SIGNPOSTS)
+	#define AU_SIGNPOSTS 0
+#endif
+
+#if AU_SIGNPOSTS && __APPLE__
+
+#include <os/signpost.h>
+
+inline os_log_t	AUSignpostLog()
+{
+	static os_log_t sLog = os_log_create("com.apple.audiounit", "PointsOfInterest");
+	return sLog;
+}
+
+#define AU_SIGNPOST_JOIN2(a, b)		a##b
+#define AU_SIGNPOST_JOIN(a, b)		AU_SIGNPOST_JOIN2(a, b)
+
+#define AU_SIGNPOST_INTERVAL(name) \
+	struct AU_SIGNPOST_JOIN(AUSignpostInterval, __LINE__) { \
+		os_signpost_id_t mID; \
+		AU_SIGNPOST_JOIN(AUSignpostInterval, __LINE__)() : mID(os_signpost_id_generate(AUSignpostLog())) \
+			{ os_signpost_interval_begin(AUSignpostLog(), mID, name); } \
+		~AU_SIGNPOST_JOIN(AUSignpostInterval, __LINE__)() \
+			{ os_signpost_interval_end(AUSignpostLog(), mID, name); } \
+	} AU_SIGNPOST_JOIN(auSignpostInterval, __LINE__)
+
+#define AU_SIGNPOST_EVENT(name) \
+	os_signpost_event_emit(AUSignpostLog(), OS_SIGNPOST_ID_EXCLUSIVE, name)
+
+#else
+
+#define AU_SIGNPOST_INTERVAL(name)		do {} while (0)
+#define AU_SIGNPOST_EVENT(name)			do {} while (0)
+
+#endif
+
+#endif // __AUSignpost_h__
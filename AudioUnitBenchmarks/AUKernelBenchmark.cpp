@@ -0,0 +1,508 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Render benchmark for every example audio unit's processing kernel
+ */
+
+/*
+ AUKernelBenchmark times the render path of the example units that run in production chains:
+ FilterDemo's Filter, AUPinkNoise, TremoloUnit, ReverseOfflineUnit and AUMidiPassThru. It links
+ their sources directly and registers each factory with AudioComponentRegister under a private
+ manufacturer code, so no installed component is touched and no host is needed, and then drives
+ every unit through the ordinary AudioUnit API at each buffer size and channel count:
+
+	effects			input pulled through a render callback from a fixed block of test signal
+	generator		output only
+	offline effect	kAudioUnitOfflineProperty_InputSize set to the whole run, one preflight,
+					then render passes until the unit reports kAudioOfflineUnitRenderAction_Complete
+	MIDI processor	four MIDI events per buffer (well within its event FIFO) and a MIDI output callback
+					that counts them; it has no audio, so only one channel count is run
+
+ The test signal is a sine per channel plus noise from a fixed-seed generator, so runs are
+ repeatable. The first kWarmupCycles buffers of each run are not timed, and the run pauses for
+ kPrepareMilliseconds after the first, so that a unit which defers its kernels to the first sound
+ (see AUEffectBase::SetDefersKernels) is processing, not passing its input through, by the time
+ the timing starts.
+
+ For each configuration it prints frames per second and the time per sample (per frame per
+ channel) in nanoseconds and, if the clock rate is known, in CPU cycles. The clock rate comes from
+ --cpu-ghz, or from hw.cpufrequency where the kernel reports one.
+
+ --write-baseline FILE stores the results; --baseline FILE compares against a stored run and marks
+ every configuration whose time per sample grew by more than --tolerance percent (10 by default).
+ The tool exits with status 1 if there is any such regression, or if a unit failed to render.
+
+ Build it as a command line tool from this file, AUPublic, PublicUtility and the five units' sources
+ (Filter.cpp, AUPinkNoise.cpp with the generator's Utility folder, TremoloUnit.cpp,
+ ReverseOfflineUnit.cpp and AUMidiPassThru.cpp), linking AudioToolbox, AudioUnit, CoreAudio,
+ CoreFoundation and CoreMIDI. For example:
+
+	AUKernelBenchmark --frames 32,512,4096 --channels 1,2,8 --baseline kernels.baseline
+ */
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <CoreFoundation/CoreFoundation.h>
+#include <CoreMIDI/CoreMIDI.h>
+#include <sys/sysctl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CAHostTimeBase.h"
+
+extern "C" void * FilterFactory(const AudioComponentDescription *inDesc);
+extern "C" void * AUPinkNoiseFactory(const AudioComponentDescription *inDesc);
+extern "C" void * TremoloUnitFactory(const AudioComponentDescription *inDesc);
+extern "C" void * ReverseOfflineUnitFactory(const AudioComponentDescription *inDesc);
+extern "C" void * AUMidiPassThruFactory(const AudioComponentDescription *inDesc);
+
+enum UnitKind
+{
+    kUnitKind_Effect,
+    kUnitKind_Generator,
+    kUnitKind_Offline,
+    kUnitKind_MIDI
+};
+
+struct BenchmarkUnit
+{
+    const char *		mName;
+    UnitKind			mKind;
+    OSType				mType;
+    OSType				mSubType;
+    void *				(*mFactory)(const AudioComponentDescription *);
+};
+
+static const BenchmarkUnit kUnits[] = {
+    { "Filter",				kUnitKind_Effect,		kAudioUnitType_Effect,			'filt',	FilterFactory },
+    { "AUPinkNoise",		kUnitKind_Generator,	kAudioUnitType_Generator,		'pink',	AUPinkNoiseFactory },
+    { "TremoloUnit",		kUnitKind_Effect,		kAudioUnitType_Effect,			'trem',	TremoloUnitFactory },
+    { "ReverseOfflineUnit",	kUnitKind_Offline,		kAudioUnitType_OfflineEffect,	'rvrs',	ReverseOfflineUnitFactory },
+    { "AUMidiPassThru",		kUnitKind_MIDI,			kAudioUnitType_MIDIProcessor,	'mdpt',	AUMidiPassThruFactory }
+};
+static const UInt32 kNumUnits = sizeof(kUnits) / sizeof(kUnits[0]);
+
+static const OSType kBenchmarkManufacturer = 'Bnch';
+static const Float64 kSampleRate = 44100.;
+static const UInt32 kSignalFrames = 4096;		// the test signal repeats with this period
+static const UInt32 kWarmupCycles = 8;
+static const UInt32 kPrepareMilliseconds = 50;	// for deferred kernels to be prepared off the render thread
+static const UInt32 kMIDIEventsPerCycle = 4;
+
+struct BenchmarkOptions
+{
+    BenchmarkOptions() : mSeconds(2.), mTolerance(10.), mCPUGHz(0.) {}
+
+    Float64					mSeconds;			// of audio per configuration
+    Float64					mTolerance;			// percent
+    Float64					mCPUGHz;			// 0 if unknown
+    std::vector<UInt32>		mFrames;
+    std::vector<UInt32>		mChannels;
+    std::vector<std::string> mUnits;			// empty for all
+    std::string				mBaselinePath;
+    std::string				mWriteBaselinePath;
+};
+
+struct BenchmarkResult
+{
+    std::string				mUnit;
+    UInt32					mFrames;
+    UInt32					mChannels;
+    Float64					mFramesPerSecond;
+    Float64					mNanosPerSample;
+};
+
+// the input of an effect: every channel reads the same period of test signal at its own offset
+struct SignalSource
+{
+    std::vector<Float32>	mSignal;			// kSignalFrames per channel
+    UInt32					mNumChannels;
+
+    void					Make(UInt32 inNumChannels)
+    {
+        mNumChannels = inNumChannels;
+        mSignal.resize(kSignalFrames * inNumChannels);
+        UInt32 seed = 0x2545F491;
+        for (UInt32 ch = 0; ch < inNumChannels; ++ch) {
+            // whole cycles per period, so the signal loops without a click
+            Float64 cycles = 8 + 5 * ch;
+            for (UInt32 i = 0; i < kSignalFrames; ++i) {
+                seed = seed * 1664525 + 1013904223;
+                Float32 noise = Float32(SInt32(seed)) * (1.f / 2147483648.f);
+                mSignal[ch * kSignalFrames + i] = 0.5f * Float32(std::sin(2. * M_PI * cycles * i / kSignalFrames)) + 0.1f * noise;
+            }
+        }
+    }
+};
+
+static OSStatus SignalRenderCallback(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp,
+                                     UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+    const SignalSource &source = *(const SignalSource *)inRefCon;
+    UInt64 start = UInt64(std::max(inTimeStamp->mSampleTime, 0.));
+    for (UInt32 b = 0; b < ioData->mNumberBuffers && b < source.mNumChannels; ++b) {
+        Float32 *out = (Float32 *)ioData->mBuffers[b].mData;
+        const Float32 *signal = &source.mSignal[b * kSignalFrames];
+        UInt32 offset = UInt32(start % kSignalFrames);
+        for (UInt32 i = 0; i < inNumberFrames; ) {
+            UInt32 n = std::min(inNumberFrames - i, kSignalFrames - offset);
+            memcpy(out + i, signal + offset, n * sizeof(Float32));
+            i += n;
+            offset = 0;
+        }
+    }
+    return noErr;
+}
+
+static OSStatus CountMIDIOutput(void *inUserData, const AudioTimeStamp *inTimeStamp, UInt32 inMidiOutNum,
+                                const MIDIPacketList *inPacketList)
+{
+    *(UInt64 *)inUserData += inPacketList->numPackets;
+    return noErr;
+}
+
+static void Usage(const char *inName)
+{
+    fprintf(stderr,
+            "usage: %s [--seconds S] [--frames N[,N...]] [--channels N[,N...]] [--units NAME[,NAME...]]\n"
+            "          [--cpu-ghz GHZ] [--baseline FILE] [--write-baseline FILE] [--tolerance PERCENT]\n", inName);
+    exit(1);
+}
+
+static std::vector<UInt32> ParseNumbers(const char *inList)
+{
+    std::vector<UInt32> values;
+    for (const char *p = inList; *p; ) {
+        char *end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p || value == 0)
+            return std::vector<UInt32>();
+        values.push_back(UInt32(value));
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+static std::vector<std::string> ParseNames(const char *inList)
+{
+    std::vector<std::string> names;
+    for (const char *p = inList; *p; ) {
+        const char *comma = strchr(p, ',');
+        size_t length = comma ? size_t(comma - p) : strlen(p);
+        if (length)
+            names.push_back(std::string(p, length));
+        p += length + (comma ? 1 : 0);
+    }
+    return names;
+}
+
+static BenchmarkOptions ParseOptions(int argc, const char *argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            Usage(argv[0]);
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--seconds"))
+            options.mSeconds = atof(value);
+        else if (!strcmp(arg, "--frames"))
+            options.mFrames = ParseNumbers(value);
+        else if (!strcmp(arg, "--channels"))
+            options.mChannels = ParseNumbers(value);
+        else if (!strcmp(arg, "--units"))
+            options.mUnits = ParseNames(value);
+        else if (!strcmp(arg, "--cpu-ghz"))
+            options.mCPUGHz = atof(value);
+        else if (!strcmp(arg, "--baseline"))
+            options.mBaselinePath = value;
+        else if (!strcmp(arg, "--write-baseline"))
+            options.mWriteBaselinePath = value;
+        else if (!strcmp(arg, "--tolerance"))
+            options.mTolerance = atof(value);
+        else
+            Usage(argv[0]);
+    }
+    if (options.mFrames.empty()) {
+        for (UInt32 frames = 32; frames <= 4096; frames *= 2)
+            options.mFrames.push_back(frames);
+    }
+    if (options.mChannels.empty()) {
+        static const UInt32 kDefaultChannels[] = { 1, 2, 4, 8, 16 };
+        options.mChannels.assign(kDefaultChannels, kDefaultChannels + 5);
+    }
+    if (!(options.mSeconds > 0) || options.mTolerance < 0)
+        Usage(argv[0]);
+
+    if (options.mCPUGHz == 0) {
+        UInt64 frequency = 0;
+        size_t size = sizeof(frequency);
+        if (sysctlbyname("hw.cpufrequency", &frequency, &size, NULL, 0) == 0 && frequency > 0)
+            options.mCPUGHz = frequency * 1.0e-9;
+    }
+    return options;
+}
+
+static AudioStreamBasicDescription MakeFormat(UInt32 inNumChannels)
+{
+    AudioStreamBasicDescription format;
+    memset(&format, 0, sizeof(format));
+    format.mSampleRate = kSampleRate;
+    format.mFormatID = kAudioFormatLinearPCM;
+    format.mFormatFlags = kAudioFormatFlagsNativeFloatPacked | kAudioFormatFlagIsNonInterleaved;
+    format.mBytesPerPacket = sizeof(Float32);
+    format.mFramesPerPacket = 1;
+    format.mBytesPerFrame = sizeof(Float32);
+    format.mChannelsPerFrame = inNumChannels;
+    format.mBitsPerChannel = 8 * sizeof(Float32);
+    return format;
+}
+
+static AudioComponent RegisterUnit(const BenchmarkUnit &inUnit)
+{
+    AudioComponentDescription desc = { inUnit.mType, inUnit.mSubType, kBenchmarkManufacturer, 0, 0 };
+    CFStringRef name = CFStringCreateWithCString(kCFAllocatorDefault, inUnit.mName, kCFStringEncodingUTF8);
+    AudioComponent component = AudioComponentRegister(&desc, name, 1, (AudioComponentFactoryFunction)inUnit.mFactory);
+    CFRelease(name);
+    return component;
+}
+
+// renders inSeconds of audio through a fresh instance; returns an error if the unit does not support the configuration
+static OSStatus RunConfiguration(AudioComponent inComponent, const BenchmarkUnit &inUnit, UInt32 inFrames,
+                                 UInt32 inNumChannels, Float64 inSeconds, BenchmarkResult &outResult)
+{
+    AudioUnit unit = NULL;
+    OSStatus err = AudioComponentInstanceNew(inComponent, &unit);
+    if (err) return err;
+
+    SignalSource source;
+    source.Make(inNumChannels);
+    UInt64 numCycles = kWarmupCycles + UInt64(std::ceil(inSeconds * kSampleRate / inFrames));
+    UInt64 numFrames = numCycles * inFrames;
+    UInt64 midiPackets = 0;
+
+    AudioStreamBasicDescription format = MakeFormat(inNumChannels);
+    if (inUnit.mKind != kUnitKind_MIDI) {
+        if (inUnit.mKind != kUnitKind_Generator)
+            err = AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0, &format, sizeof(format));
+        if (!err)
+            err = AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format, sizeof(format));
+    }
+    if (!err)
+        err = AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &inFrames, sizeof(inFrames));
+    if (!err && (inUnit.mKind == kUnitKind_Effect || inUnit.mKind == kUnitKind_Offline)) {
+        AURenderCallbackStruct callback = { SignalRenderCallback, &source };
+        err = AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0, &callback, sizeof(callback));
+    }
+    if (!err && inUnit.mKind == kUnitKind_Offline) {
+        UInt64 inputSize = numFrames;
+        err = AudioUnitSetProperty(unit, kAudioUnitOfflineProperty_InputSize, kAudioUnitScope_Global, 0, &inputSize, sizeof(inputSize));
+    }
+    if (!err && inUnit.mKind == kUnitKind_MIDI) {
+        AUMIDIOutputCallbackStruct callback = { CountMIDIOutput, &midiPackets };
+        err = AudioUnitSetProperty(unit, kAudioUnitProperty_MIDIOutputCallback, kAudioUnitScope_Global, 0, &callback, sizeof(callback));
+    }
+    if (!err)
+        err = AudioUnitInitialize(unit);
+
+    // the unit's own buffers are used for the MIDI processor, as a host with no audio would
+    std::vector<Float32> samples(inFrames * inNumChannels);
+    std::vector<UInt8> bufferListMemory(offsetof(AudioBufferList, mBuffers) + inNumChannels * sizeof(AudioBuffer));
+    AudioBufferList &bufferList = *(AudioBufferList *)bufferListMemory.data();
+
+    AudioTimeStamp timeStamp;
+    memset(&timeStamp, 0, sizeof(timeStamp));
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+
+    if (!err && inUnit.mKind == kUnitKind_Offline) {
+        AudioUnitRenderActionFlags flags = kAudioOfflineUnitRenderAction_Preflight;
+        bufferList.mNumberBuffers = inNumChannels;
+        for (UInt32 ch = 0; ch < inNumChannels; ++ch) {
+            bufferList.mBuffers[ch].mNumberChannels = 1;
+            bufferList.mBuffers[ch].mDataByteSize = inFrames * sizeof(Float32);
+            bufferList.mBuffers[ch].mData = &samples[ch * inFrames];
+        }
+        err = AudioUnitRender(unit, &flags, &timeStamp, 0, inFrames, &bufferList);
+    }
+
+    UInt64 timedFrames = 0, timedTime = 0;
+    for (UInt64 cycle = 0; cycle < numCycles && !err; ++cycle) {
+        timeStamp.mSampleTime = Float64(cycle * inFrames);
+        AudioUnitRenderActionFlags flags = (inUnit.mKind == kUnitKind_Offline) ? kAudioOfflineUnitRenderAction_Render : 0;
+
+        bufferList.mNumberBuffers = inNumChannels;
+        for (UInt32 ch = 0; ch < inNumChannels; ++ch) {
+            bufferList.mBuffers[ch].mNumberChannels = 1;
+            bufferList.mBuffers[ch].mDataByteSize = (inUnit.mKind == kUnitKind_MIDI) ? 0 : inFrames * sizeof(Float32);
+            bufferList.mBuffers[ch].mData = (inUnit.mKind == kUnitKind_MIDI) ? NULL : &samples[ch * inFrames];
+        }
+
+        UInt64 start = CAHostTimeBase::GetTheCurrentTime();
+        if (inUnit.mKind == kUnitKind_MIDI) {
+            for (UInt32 e = 0; e < kMIDIEventsPerCycle && !err; ++e) {
+                UInt32 note = 48 + UInt32((cycle * kMIDIEventsPerCycle + e) % 24);
+                err = MusicDeviceMIDIEvent(unit, (e & 1) ? 0x80 : 0x90, note, (e & 1) ? 0 : 100, e * inFrames / kMIDIEventsPerCycle);
+            }
+        }
+        if (!err)
+            err = AudioUnitRender(unit, &flags, &timeStamp, 0, inFrames, &bufferList);
+        UInt64 elapsed = CAHostTimeBase::GetTheCurrentTime() - start;
+
+        if (cycle == 0)
+            usleep(kPrepareMilliseconds * 1000);
+        if (cycle >= kWarmupCycles) {
+            timedTime += elapsed;
+            timedFrames += inFrames;
+        }
+        if (flags & kAudioOfflineUnitRenderAction_Complete)
+            break;
+    }
+
+    if (!err && inUnit.mKind == kUnitKind_MIDI && midiPackets == 0)
+        err = kAudioUnitErr_NoConnection;		// the events never came back out
+    if (!err && timedFrames == 0)
+        err = kAudioUnitErr_InvalidOfflineRender;
+
+    if (!err) {
+        Float64 nanos = Float64(CAHostTimeBase::ConvertToNanos(timedTime));
+        outResult.mUnit = inUnit.mName;
+        outResult.mFrames = inFrames;
+        outResult.mChannels = inNumChannels;
+        outResult.mFramesPerSecond = nanos > 0 ? timedFrames * 1.0e9 / nanos : 0;
+        outResult.mNanosPerSample = nanos / (Float64(timedFrames) * inNumChannels);
+    }
+
+    AudioUnitUninitialize(unit);
+    AudioComponentInstanceDispose(unit);
+    return err;
+}
+
+//	baseline lines are "unit frames channels nanoseconds-per-sample"; '#' starts a comment
+typedef std::map<std::string, Float64> Baseline;
+
+static std::string BaselineKey(const std::string &inUnit, UInt32 inFrames, UInt32 inChannels)
+{
+    char key[128];
+    snprintf(key, sizeof(key), "%s %u %u", inUnit.c_str(), (unsigned)inFrames, (unsigned)inChannels);
+    return key;
+}
+
+static bool ReadBaseline(const char *inPath, Baseline &outBaseline)
+{
+    FILE *file = fopen(inPath, "r");
+    if (!file)
+        return false;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char unit[64];
+        unsigned frames, channels;
+        double nanos;
+        if (line[0] != '#' && sscanf(line, "%63s %u %u %lf", unit, &frames, &channels, &nanos) == 4)
+            outBaseline[BaselineKey(unit, frames, channels)] = nanos;
+    }
+    fclose(file);
+    return true;
+}
+
+static bool WriteBaseline(const char *inPath, const std::vector<BenchmarkResult> &inResults)
+{
+    FILE *file = fopen(inPath, "w");
+    if (!file)
+        return false;
+    fprintf(file, "# AUKernelBenchmark baseline: unit, frames per buffer, channels, nanoseconds per sample\n");
+    for (size_t i = 0; i < inResults.size(); ++i) {
+        const BenchmarkResult &r = inResults[i];
+        fprintf(file, "%s %u %u %.4f\n", r.mUnit.c_str(), (unsigned)r.mFrames, (unsigned)r.mChannels, r.mNanosPerSample);
+    }
+    return fclose(file) == 0;
+}
+
+static bool WantsUnit(const BenchmarkOptions &inOptions, const char *inName)
+{
+    if (inOptions.mUnits.empty())
+        return true;
+    for (size_t i = 0; i < inOptions.mUnits.size(); ++i)
+        if (inOptions.mUnits[i] == inName)
+            return true;
+    return false;
+}
+
+int main(int argc, const char * argv[])
+{
+    BenchmarkOptions options = ParseOptions(argc, argv);
+
+    Baseline baseline;
+    if (!options.mBaselinePath.empty() && !ReadBaseline(options.mBaselinePath.c_str(), baseline)) {
+        fprintf(stderr, "AUKernelBenchmark: cannot read the baseline %s\n", options.mBaselinePath.c_str());
+        return 1;
+    }
+
+    printf("%.1f s of audio per configuration at %.0f Hz", options.mSeconds, kSampleRate);
+    if (options.mCPUGHz > 0)
+        printf(", cycles at %.2f GHz", options.mCPUGHz);
+    printf("\n\n%-20s %6s %4s %14s %10s %10s %10s\n", "unit", "frames", "ch", "frames/s", "ns/sample", "cyc/sample", "baseline");
+
+    std::vector<BenchmarkResult> results;
+    bool failed = false, regressed = false;
+    for (UInt32 u = 0; u < kNumUnits; ++u) {
+        const BenchmarkUnit &unit = kUnits[u];
+        if (!WantsUnit(options, unit.mName))
+            continue;
+        AudioComponent component = RegisterUnit(unit);
+        if (component == NULL) {
+            fprintf(stderr, "AUKernelBenchmark: cannot register %s\n", unit.mName);
+            failed = true;
+            continue;
+        }
+
+        for (size_t f = 0; f < options.mFrames.size(); ++f) {
+            // MIDI has no channels; one pass per buffer size
+            size_t numChannelCounts = (unit.mKind == kUnitKind_MIDI) ? 1 : options.mChannels.size();
+            for (size_t c = 0; c < numChannelCounts; ++c) {
+                UInt32 frames = options.mFrames[f];
+                UInt32 channels = (unit.mKind == kUnitKind_MIDI) ? 1 : options.mChannels[c];
+                BenchmarkResult result;
+                OSStatus err = RunConfiguration(component, unit, frames, channels, options.mSeconds, result);
+                if (err == kAudioUnitErr_FormatNotSupported || err == kAudioUnitErr_InvalidPropertyValue) {
+                    printf("%-20s %6u %4u %14s\n", unit.mName, (unsigned)frames, (unsigned)channels, "unsupported");
+                    continue;
+                }
+                if (err) {
+                    printf("%-20s %6u %4u %14s %d\n", unit.mName, (unsigned)frames, (unsigned)channels, "error", (int)err);
+                    failed = true;
+                    continue;
+                }
+                results.push_back(result);
+
+                char cycles[32] = "-", comparison[48] = "";
+                if (options.mCPUGHz > 0)
+                    snprintf(cycles, sizeof(cycles), "%.2f", result.mNanosPerSample * options.mCPUGHz);
+                Baseline::const_iterator it = baseline.find(BaselineKey(result.mUnit, frames, channels));
+                if (it != baseline.end() && it->second > 0) {
+                    Float64 change = 100. * (result.mNanosPerSample / it->second - 1.);
+                    bool regression = change > options.mTolerance;
+                    regressed = regressed || regression;
+                    snprintf(comparison, sizeof(comparison), "%+9.1f%%%s", change, regression ? "  REGRESSION" : "");
+                }
+                printf("%-20s %6u %4u %14.0f %10.3f %10s %s\n", unit.mName, (unsigned)frames, (unsigned)channels,
+                       result.mFramesPerSecond, result.mNanosPerSample, cycles, comparison);
+            }
+        }
+    }
+
+    if (!options.mWriteBaselinePath.empty() && !WriteBaseline(options.mWriteBaselinePath.c_str(), results)) {
+        fprintf(stderr, "AUKernelBenchmark: cannot write the baseline %s\n", options.mWriteBaselinePath.c_str());
+        failed = true;
+    }
+    if (regressed)
+        printf("\nslower than the baseline by more than %.0f%% where marked\n", options.mTolerance);
+    return (failed || regressed) ? 1 : 0;
+}
@@ -0,0 +1,403 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Cross-thread throughput and contention benchmark for the instrument event queue
+ */
+
+/*
+ EventQueueBenchmark measures the queue AUInstrumentBase posts its MIDI and note events through,
+ LockFreeFIFOWithFree<SynthEvent>, the way an instrument uses it: a producer thread, standing in
+ for the MIDI thread, writes note-on events at a configurable rate, in bursts of --burst events,
+ while a consumer thread, standing in for the render thread, wakes once per buffer of --frames
+ frames at --sample-rate and drains everything readable with one ReadableItems(), a ReadItemAt()
+ per event and one AdvanceReadPtr(), as AUInstrumentBase::Render() does. A rate of 0 writes as
+ fast as the producer can, which keeps the queue full and shows the cost of the writer and the
+ reader fighting over its indices.
+
+ Every queue in kQueues runs every configuration. A replacement only needs the writer and reader
+ calls the instrument makes (WriteItem, AdvanceWritePtr, ReadableItems, ReadItemAt, AdvanceReadPtr)
+ and a constructor taking the size; add it to kQueues and it runs side by side with the current
+ one. MutexFIFO, the same ring behind a std::mutex, is there as the reference a lock would give.
+
+ For each configuration it prints:
+
+	events/s		events written and read per second
+	rejected		WriteItem() calls that returned NULL because the queue was full, and their
+					share of all attempts; AUInstrumentBase returns an error to the host for these
+	write ns		mean and worst time of a successful write, sampled every kTimedWriteStride writes
+	index ns		mean time of the consumer's ReadableItems(), which has to fetch the cache line
+					the producer last wrote its index to
+	event ns		mean time per drained event, mostly the event's own cache line coming across
+	drain us		the longest drain of one render cycle
+	late			render cycles that woke more than a whole period late (scheduler noise)
+
+ The write, index and event times are where cache misses show: a queue whose indices share a line,
+ or that takes a lock, pays a transfer between the cores on every call. With --cpu-ghz, or where
+ the kernel reports hw.cpufrequency, they are also given in CPU cycles. The consumer checks that the
+ events arrive in the order written and exits with status 1 if any queue loses or reorders one.
+
+ Build it as a command line tool from this file, AUPublic and PublicUtility, linking AudioToolbox,
+ AudioUnit, CoreAudio and CoreFoundation. For example:
+
+	EventQueueBenchmark --rates 1000,100000,0 --frames 64,512 --queues LockFreeFIFOWithFree
+ */
+
+#include <AudioToolbox/AudioToolbox.h>
+#include <sys/sysctl.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CAHostTimeBase.h"
+#include "LockFreeFIFO.h"
+#include "SynthEvent.h"
+
+static const UInt32 kDefaultQueueSize = 1024;		// AUInstrumentBase's kEventQueueSize
+static const UInt32 kTimedWriteStride = 16;
+static const UInt32 kDefaultBurst = 16;
+
+/*
+ the same ring as LockFreeFIFO with every call under one mutex, and no free pass: the benchmark's
+ events carry no extra note parameters, so there is nothing to free
+ */
+template <class ITEM>
+class MutexFIFO
+{
+public:
+    MutexFIFO(UInt32 inMaxSize) : mMask(inMaxSize - 1), mItems(inMaxSize), mWriteIndex(0), mReadIndex(0) {}
+
+    ITEM* WriteItem()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (((mWriteIndex + 1) & mMask) == mReadIndex) return NULL;
+        return &mItems[mWriteIndex];
+    }
+    void AdvanceWritePtr()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWriteIndex = (mWriteIndex + 1) & mMask;
+    }
+
+    UInt32 ReadableItems()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return (mWriteIndex - mReadIndex) & mMask;
+    }
+    ITEM* ReadItemAt(UInt32 inOffset)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return &mItems[(mReadIndex + inOffset) & mMask];
+    }
+    void AdvanceReadPtr(UInt32 inCount = 1)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mReadIndex = (mReadIndex + inCount) & mMask;
+    }
+
+private:
+    UInt32				mMask;
+    std::vector<ITEM>	mItems;
+    UInt32				mWriteIndex;
+    UInt32				mReadIndex;
+    std::mutex			mMutex;
+};
+
+struct BenchmarkOptions
+{
+    BenchmarkOptions() : mSeconds(2.), mSampleRate(44100.), mQueueSize(kDefaultQueueSize), mBurst(kDefaultBurst),
+                         mCPUGHz(0.) {}
+
+    Float64					mSeconds;			// of producing per configuration
+    Float64					mSampleRate;		// of the simulated render cycles
+    UInt32					mQueueSize;			// a power of two
+    UInt32					mBurst;				// events written back to back per producer wake-up
+    Float64					mCPUGHz;			// 0 if unknown
+    std::vector<UInt32>		mRates;				// events per second, 0 for as fast as possible
+    std::vector<UInt32>		mFrames;			// per render cycle
+    std::vector<std::string> mQueues;			// empty for all
+};
+
+struct QueueResult
+{
+    Float64					mEventsPerSecond;
+    UInt64					mRejected;
+    Float64					mRejectedShare;		// of all write attempts
+    Float64					mWriteNanos;		// mean of the sampled writes
+    Float64					mMaxWriteNanos;
+    Float64					mIndexNanos;		// per ReadableItems()
+    Float64					mEventNanos;		// per drained event
+    Float64					mMaxDrainNanos;		// of one render cycle
+    UInt64					mLateCycles;
+    UInt64					mOrderErrors;		// events that did not follow the one before
+};
+
+static inline UInt64 Now() { return CAHostTimeBase::ConvertToNanos(CAHostTimeBase::GetTheCurrentTime()); }
+
+static void SleepUntil(UInt64 inNanos)
+{
+    UInt64 now = Now();
+    if (inNanos > now)
+        std::this_thread::sleep_for(std::chrono::nanoseconds(inNanos - now));
+}
+
+template <class Queue>
+static void Produce(Queue &ioQueue, const BenchmarkOptions &inOptions, UInt32 inRate, UInt64 inStart, UInt64 inEnd,
+                    UInt64 &outAttempts, UInt64 &outWritten, UInt64 &outTimedNanos, UInt64 &outMaxNanos)
+{
+    MusicDeviceNoteParams params;
+    memset(&params, 0, sizeof(params));
+    params.argCount = 2;
+    params.mPitch = 60.f;
+    params.mVelocity = 100.f;
+
+    UInt64 attempts = 0, written = 0, timedNanos = 0, maxNanos = 0;
+    const Float64 burstNanos = inRate ? 1.0e9 * inOptions.mBurst / inRate : 0.;
+    for (UInt64 burst = 0; ; ++burst) {
+        if (inRate)
+            SleepUntil(inStart + UInt64(burst * burstNanos));
+        if (Now() >= inEnd)
+            break;
+        for (UInt32 i = 0; i < inOptions.mBurst; ++i, ++attempts) {
+            bool timed = written % kTimedWriteStride == 0;
+            UInt64 before = timed ? Now() : 0;
+            SynthEvent *event = ioQueue.WriteItem();
+            if (event == NULL)
+                continue;
+            event->Set(SynthEvent::kEventType_NoteOn, 0, NoteInstanceID(written), UInt32(written % 512), &params);
+            ioQueue.AdvanceWritePtr();
+            if (timed) {
+                UInt64 nanos = Now() - before;
+                timedNanos += nanos;
+                maxNanos = std::max(maxNanos, nanos);
+            }
+            ++written;
+        }
+    }
+    outAttempts = attempts;
+    outWritten = written;
+    outTimedNanos = timedNanos;
+    outMaxNanos = maxNanos;
+}
+
+// runs one producer and one render-cadence consumer over a fresh queue
+template <class Queue>
+static void RunQueue(const BenchmarkOptions &inOptions, UInt32 inRate, UInt32 inFrames, QueueResult &outResult)
+{
+    Queue queue(inOptions.mQueueSize);
+    const UInt64 period = UInt64(1.0e9 * inFrames / inOptions.mSampleRate);
+    const UInt64 start = Now() + period;
+    const UInt64 end = start + UInt64(inOptions.mSeconds * 1.0e9);
+
+    std::atomic<bool> producerDone(false);
+    UInt64 attempts = 0, written = 0, timedNanos = 0, maxWriteNanos = 0;
+    std::thread producer([&]() {
+        Produce(queue, inOptions, inRate, start, end, attempts, written, timedNanos, maxWriteNanos);
+        producerDone.store(true, std::memory_order_release);
+    });
+
+    // the consumer: one drain per render period, on the thread that started the run
+    UInt64 read = 0, cycles = 0, lateCycles = 0, orderErrors = 0;
+    UInt64 indexNanos = 0, drainNanos = 0, maxDrainNanos = 0;
+    NoteInstanceID expected = 0;
+    for (UInt64 cycle = 0; ; ++cycle) {
+        UInt64 due = start + cycle * period;
+        SleepUntil(due);
+        bool last = producerDone.load(std::memory_order_acquire);
+
+        UInt64 before = Now();
+        if (before > due + period)
+            ++lateCycles;
+        UInt32 numEvents = queue.ReadableItems();
+        UInt64 indexed = Now();
+        for (UInt32 i = 0; i < numEvents; ++i) {
+            SynthEvent *event = queue.ReadItemAt(i);
+            if (event->GetNoteID() != expected)
+                ++orderErrors;
+            expected = event->GetNoteID() + 1;
+        }
+        queue.AdvanceReadPtr(numEvents);
+        UInt64 after = Now();
+
+        indexNanos += indexed - before;
+        drainNanos += after - indexed;
+        maxDrainNanos = std::max(maxDrainNanos, after - before);
+        read += numEvents;
+        ++cycles;
+        if (last && numEvents == 0)
+            break;
+    }
+    producer.join();
+
+    outResult.mEventsPerSecond = read / inOptions.mSeconds;
+    outResult.mRejected = attempts - written;
+    outResult.mRejectedShare = attempts ? Float64(attempts - written) / attempts : 0.;
+    UInt64 numTimed = (written + kTimedWriteStride - 1) / kTimedWriteStride;
+    outResult.mWriteNanos = numTimed ? Float64(timedNanos) / numTimed : 0.;
+    outResult.mMaxWriteNanos = Float64(maxWriteNanos);
+    outResult.mIndexNanos = cycles ? Float64(indexNanos) / cycles : 0.;
+    outResult.mEventNanos = read ? Float64(drainNanos) / read : 0.;
+    outResult.mMaxDrainNanos = Float64(maxDrainNanos);
+    outResult.mLateCycles = lateCycles;
+    outResult.mOrderErrors = orderErrors + (read != written ? 1 : 0);
+}
+
+struct BenchmarkQueue
+{
+    const char *		mName;
+    void				(*mRun)(const BenchmarkOptions &, UInt32, UInt32, QueueResult &);
+};
+
+static const BenchmarkQueue kQueues[] = {
+    { "LockFreeFIFOWithFree",	RunQueue<LockFreeFIFOWithFree<SynthEvent> > },
+    { "LockFreeFIFO",			RunQueue<LockFreeFIFO<SynthEvent> > },
+    { "MutexFIFO",				RunQueue<MutexFIFO<SynthEvent> > }
+};
+static const UInt32 kNumQueues = sizeof(kQueues) / sizeof(kQueues[0]);
+
+static void Usage(const char *inName)
+{
+    fprintf(stderr,
+            "usage: %s [--seconds S] [--rates N[,N...]] [--frames N[,N...]] [--sample-rate HZ]\n"
+            "          [--queue-size N] [--burst N] [--queues NAME[,NAME...]] [--cpu-ghz GHZ]\n", inName);
+    exit(1);
+}
+
+// a comma-separated list; zeros are kept only if inAllowZero
+static std::vector<UInt32> ParseNumbers(const char *inList, bool inAllowZero)
+{
+    std::vector<UInt32> values;
+    for (const char *p = inList; *p; ) {
+        char *end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p || (value == 0 && !inAllowZero))
+            return std::vector<UInt32>();
+        values.push_back(UInt32(value));
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+static std::vector<std::string> ParseNames(const char *inList)
+{
+    std::vector<std::string> names;
+    for (const char *p = inList; *p; ) {
+        const char *comma = strchr(p, ',');
+        size_t length = comma ? size_t(comma - p) : strlen(p);
+        if (length)
+            names.push_back(std::string(p, length));
+        p += length + (comma ? 1 : 0);
+    }
+    return names;
+}
+
+static BenchmarkOptions ParseOptions(int argc, const char *argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            Usage(argv[0]);
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--seconds"))
+            options.mSeconds = atof(value);
+        else if (!strcmp(arg, "--rates"))
+            options.mRates = ParseNumbers(value, true);
+        else if (!strcmp(arg, "--frames"))
+            options.mFrames = ParseNumbers(value, false);
+        else if (!strcmp(arg, "--sample-rate"))
+            options.mSampleRate = atof(value);
+        else if (!strcmp(arg, "--queue-size"))
+            options.mQueueSize = UInt32(atoi(value));
+        else if (!strcmp(arg, "--burst"))
+            options.mBurst = UInt32(atoi(value));
+        else if (!strcmp(arg, "--queues"))
+            options.mQueues = ParseNames(value);
+        else if (!strcmp(arg, "--cpu-ghz"))
+            options.mCPUGHz = atof(value);
+        else
+            Usage(argv[0]);
+    }
+    if (options.mRates.empty()) {
+        static const UInt32 kDefaultRates[] = { 1000, 100000, 0 };
+        options.mRates.assign(kDefaultRates, kDefaultRates + 3);
+    }
+    if (options.mFrames.empty()) {
+        static const UInt32 kDefaultFrames[] = { 64, 512 };
+        options.mFrames.assign(kDefaultFrames, kDefaultFrames + 2);
+    }
+    if (!(options.mSeconds > 0) || !(options.mSampleRate > 0) || options.mBurst == 0
+        || options.mQueueSize < 2 || (options.mQueueSize & (options.mQueueSize - 1)) != 0)
+        Usage(argv[0]);
+
+    if (options.mCPUGHz == 0) {
+        UInt64 frequency = 0;
+        size_t size = sizeof(frequency);
+        if (sysctlbyname("hw.cpufrequency", &frequency, &size, NULL, 0) == 0 && frequency > 0)
+            options.mCPUGHz = frequency * 1.0e-9;
+    }
+    return options;
+}
+
+static bool WantsQueue(const BenchmarkOptions &inOptions, const char *inName)
+{
+    if (inOptions.mQueues.empty())
+        return true;
+    for (size_t i = 0; i < inOptions.mQueues.size(); ++i)
+        if (inOptions.mQueues[i] == inName)
+            return true;
+    return false;
+}
+
+int main(int argc, const char * argv[])
+{
+    BenchmarkOptions options = ParseOptions(argc, argv);
+
+    printf("%.1f s per configuration, %u-event queue, bursts of %u, render cycles at %.0f Hz",
+           options.mSeconds, (unsigned)options.mQueueSize, (unsigned)options.mBurst, options.mSampleRate);
+    if (options.mCPUGHz > 0)
+        printf(", cycles at %.2f GHz", options.mCPUGHz);
+    printf("\n\n%-22s %8s %6s %12s %10s %7s %9s %9s %9s %9s %9s %5s\n", "queue", "rate", "frames", "events/s",
+           "rejected", "%", "write ns", "max ns", "index ns", "event ns", "drain us", "late");
+
+    bool failed = false;
+    for (UInt32 q = 0; q < kNumQueues; ++q) {
+        const BenchmarkQueue &queue = kQueues[q];
+        if (!WantsQueue(options, queue.mName))
+            continue;
+        for (size_t r = 0; r < options.mRates.size(); ++r) {
+            for (size_t f = 0; f < options.mFrames.size(); ++f) {
+                UInt32 rate = options.mRates[r], frames = options.mFrames[f];
+                QueueResult result;
+                queue.mRun(options, rate, frames, result);
+
+                char rateText[16];
+                if (rate)
+                    snprintf(rateText, sizeof(rateText), "%u", (unsigned)rate);
+                else
+                    snprintf(rateText, sizeof(rateText), "max");
+                printf("%-22s %8s %6u %12.0f %10llu %6.2f%% %9.1f %9.0f %9.1f %9.2f %9.1f %5llu",
+                       queue.mName, rateText, (unsigned)frames, result.mEventsPerSecond,
+                       (unsigned long long)result.mRejected, 100. * result.mRejectedShare, result.mWriteNanos,
+                       result.mMaxWriteNanos, result.mIndexNanos, result.mEventNanos, result.mMaxDrainNanos * 1.0e-3,
+                       (unsigned long long)result.mLateCycles);
+                if (options.mCPUGHz > 0)
+                    printf("  (cycles: write %.0f, index %.0f, event %.1f)", result.mWriteNanos * options.mCPUGHz,
+                           result.mIndexNanos * options.mCPUGHz, result.mEventNanos * options.mCPUGHz);
+                if (result.mOrderErrors) {
+                    printf("  LOST OR REORDERED %llu", (unsigned long long)result.mOrderErrors);
+                    failed = true;
+                }
+                printf("\n");
+            }
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+A feedback delay network reverb whose delays and damping follow the room the LiDAR scan sees
+*/
+
+#include "FeedbackDelayNetwork.h"
+#include <algorithm>
+#include <math.h>
+
+static const Float64 kMinDelaySeconds = 0.004;
+static const Float32 kMaxGlide = 1.f / 128;		// frames of delay change per frame: under 14 cents of pitch
+static const Float32 kSmoothing = 0.1f;			// of the way to the decay and damping targets per update
+static const Float32 kMinDamping = 0.05f;		// for a room that returned everywhere
+static const Float32 kMaxDamping = 0.6f;		// and one that returned nowhere
+static const Float32 kWetLevel = 0.5f;			// RMS gain of the tail on a steady signal
+static const Float32 kHadamardScale = 0.25f;	// 1 / sqrt(kFDNLines)
+
+// each line's delay as a multiple of its sector's round trip; lines i and i + 8 share a sector
+static const Float32 kLineSpread[kFDNLines] = {
+	1.00f, 1.37f, 0.83f, 1.61f, 1.13f, 0.91f, 1.79f, 1.23f,
+	0.77f, 1.49f, 1.07f, 1.71f, 0.97f, 1.29f, 0.87f, 1.89f
+};
+
+// the input's sign into each line, and the output taps' signs: two orthogonal Hadamard rows
+static const Float32 kInputSign[kFDNLines] = { 1, -1, -1, 1, 1, 1, -1, -1, 1, -1, 1, 1, -1, 1, -1, 1 };
+static const Float32 kLeftSign[kFDNLines] = { 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1, 1, -1 };
+static const Float32 kRightSign[kFDNLines] = { 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1, 1, 1, -1, -1 };
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Hadamard
+//
+//	in-place fast Walsh-Hadamard transform of kFDNLines values, without the scale
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline void	Hadamard(Float32 *ioValues)
+{
+	for (UInt32 half = 1; half < kFDNLines; half <<= 1) {
+		for (UInt32 start = 0; start < kFDNLines; start += 2 * half) {
+			for (UInt32 k = start; k < start + half; ++k) {
+				Float32 a = ioValues[k], b = ioValues[k + half];
+				ioValues[k] = a + b;
+				ioValues[k + half] = a - b;
+			}
+		}
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedbackDelayNetwork::FeedbackDelayNetwork
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+FeedbackDelayNetwork::FeedbackDelayNetwork()
+	: mSampleRate(0.), mMask(0), mWrite(0), mDecayFrames(1.f), mTargetDecayFrames(1.f),
+	  mDamping(kMinDamping), mTargetDamping(kMinDamping), mInputGain(0.f), mDry(1.f), mWet(0.f)
+{
+	for (UInt32 i = 0; i < kFDNLines; ++i) {
+		mDelay[i] = mTargetDelay[i] = 1.f;
+		mDelayStep[i] = mGainStep[i] = 0.f;
+		mGain[i] = 0.f;
+		mLowpass[i] = 0.f;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedbackDelayNetwork::Prepare
+//
+//	The taps start at the default room's delays, not gliding up from nothing.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FeedbackDelayNetwork::Prepare(Float64 inSampleRate)
+{
+	mSampleRate = inSampleRate;
+	UInt32 size = 1;
+	while (size < UInt32(kFDNMaxDelaySeconds * inSampleRate) + 2)
+		size <<= 1;
+	mMask = size - 1;
+	mArena.assign(size_t(size) * kFDNLines, 0.f);
+
+	RoomGeometry room;
+	room.SetDefault();
+	SetRoom(room, 1.f);
+	for (UInt32 i = 0; i < kFDNLines; ++i)
+		mDelay[i] = mTargetDelay[i];
+	mDecayFrames = mTargetDecayFrames;
+	mDamping = mTargetDamping;
+	Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedbackDelayNetwork::Reset
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FeedbackDelayNetwork::Reset()
+{
+	std::fill(mArena.begin(), mArena.end(), 0.f);
+	for (UInt32 i = 0; i < kFDNLines; ++i)
+		mLowpass[i] = 0.f;
+	mWrite = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedbackDelayNetwork::SetRoom
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FeedbackDelayNetwork::SetRoom(const RoomGeometry &inRoom, Float32 inDecayScale)
+{
+	if (mSampleRate <= 0.)
+		return;
+	const Float64 maxDelay = kFDNMaxDelaySeconds * mSampleRate;
+	for (UInt32 i = 0; i < kFDNLines; ++i) {
+		Float64 seconds = 2. * inRoom.mDistance[i % kAULidarModulationSectors] / kSpeedOfSound * kLineSpread[i];
+		mTargetDelay[i] = Float32(std::min(std::max(seconds, kMinDelaySeconds) * mSampleRate, maxDelay));
+	}
+	mTargetDecayFrames = Float32(std::min(Float64(inRoom.DecaySeconds(inDecayScale)), kFDNMaxDecaySeconds) * mSampleRate);
+	mTargetDamping = kMaxDamping - (kMaxDamping - kMinDamping) * inRoom.Reflectivity();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedbackDelayNetwork::Update
+//
+//	Sets up the next inFrames: each tap moves towards its target by at most kMaxGlide a frame,
+//	and each gain ramps to the one that makes its line's delay at the end of the update fall
+//	60 dB over the RT60. The input is scaled so that the tail's energy is the same whatever the
+//	gains, as the energy of a network losing g^2 per pass builds up to 1 / (1 - g^2).
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FeedbackDelayNetwork::Update(UInt32 inFrames)
+{
+	mDecayFrames += kSmoothing * (mTargetDecayFrames - mDecayFrames);
+	mDamping += kSmoothing * (mTargetDamping - mDamping);
+
+	const Float32 maxMove = kMaxGlide * inFrames;
+	Float32 meanSquare = 0.f;
+	for (UInt32 i = 0; i < kFDNLines; ++i) {
+		Float32 move = std::min(std::max(mTargetDelay[i] - mDelay[i], -maxMove), maxMove);
+		mDelayStep[i] = move / inFrames;
+		Float32 gain = expf(-6.9078f * (mDelay[i] + move) / mDecayFrames);
+		mGainStep[i] = (gain - mGain[i]) / inFrames;
+		meanSquare += gain * gain;
+	}
+	meanSquare /= kFDNLines;
+	mInputGain = kWetLevel * sqrtf(std::max(1.f - meanSquare, 0.f));
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedbackDelayNetwork::Process
+//
+//	Per frame: read every tap, damp and scale it, mix them all with the Hadamard matrix, and write
+//	the mix plus the input back into the lines. The wet outputs are taken from the taps.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FeedbackDelayNetwork::Process(const Float32 * const *inSources, Float32 * const *inDests, UInt32 inStride,
+										  UInt32 inNumChannels, UInt32 inFrames, Float32 inDryGain, Float32 inWetGain)
+{
+	if (mArena.empty() || inNumChannels == 0)
+		return;
+	const UInt32 lineSize = mMask + 1;
+	Float32 *arena = &mArena[0];
+	const Float32 inputScale = 1.f / inNumChannels;
+
+	UInt32 done = 0;
+	while (done < inFrames) {
+		const UInt32 frames = std::min(inFrames - done, UInt32(kFDNUpdateFrames));
+		Update(frames);
+		const Float32 dryStep = (inDryGain - mDry) / frames, wetStep = (inWetGain - mWet) / frames;
+		const Float32 damping = mDamping, inputGain = mInputGain;
+
+		for (UInt32 n = 0; n < frames; ++n) {
+			const size_t frame = size_t(done + n) * inStride;
+			Float32 input = 0.f;
+			for (UInt32 c = 0; c < inNumChannels; ++c)
+				input += inSources[c][frame];
+			input *= inputScale * inputGain;
+
+			Float32 taps[kFDNLines], mix[kFDNLines];
+			for (UInt32 i = 0; i < kFDNLines; ++i) {
+				Float32 delay = mDelay[i] += mDelayStep[i];
+				UInt32 whole = UInt32(delay);
+				Float32 fraction = delay - whole;
+				const Float32 *line = arena + size_t(i) * lineSize;
+				Float32 a = line[(mWrite - whole) & mMask], b = line[(mWrite - whole - 1) & mMask];
+				Float32 tap = taps[i] = a + fraction * (b - a);
+
+				Float32 gain = mGain[i] += mGainStep[i];
+				mLowpass[i] = tap + damping * (mLowpass[i] - tap);
+				mix[i] = mLowpass[i] * gain;
+			}
+			Hadamard(mix);
+
+			Float32 left = 0.f, right = 0.f;
+			for (UInt32 i = 0; i < kFDNLines; ++i) {
+				arena[size_t(i) * lineSize + mWrite] = mix[i] * kHadamardScale + input * kInputSign[i];
+				left += taps[i] * kLeftSign[i];
+				right += taps[i] * kRightSign[i];
+			}
+			mWrite = (mWrite + 1) & mMask;
+
+			mDry += dryStep;
+			mWet += wetStep;
+			for (UInt32 c = 0; c < inNumChannels; ++c) {
+				Float32 wet = (c & 1) ? right : left;
+				inDests[c][frame] = mDry * inSources[c][frame] + mWet * wet * kHadamardScale;
+			}
+		}
+		done += frames;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+A feedback delay network reverb whose delays and damping follow the room the LiDAR scan sees
+*/
+
+#ifndef __FeedbackDelayNetwork_h__
+#define __FeedbackDelayNetwork_h__
+
+#include "RoomImpulse.h"
+#include <vector>
+
+static const UInt32 kFDNLines = 16;
+static const Float64 kFDNMaxDelaySeconds = 0.12;		// of any line
+static const Float64 kFDNMaxDecaySeconds = 8.0;		// RT60, however large and live the room
+
+/*
+	FeedbackDelayNetwork feeds kFDNLines delay lines back into each other through a 16-point
+	Hadamard matrix, scaled to be orthogonal, so the network neither gains nor loses energy but for
+	each line's feedback gain and one-pole damping. The matrix is applied as a fast Walsh-Hadamard
+	transform, 4 butterfly passes of additions, instead of 256 multiplies.
+
+	SetRoom() sets where the network is heading: each line's delay is the round trip to the nearest
+	surface of one of the scan's sectors, stretched by a fixed, mutually detuned factor so no two
+	lines share a length; the damping darkens as less of the scan returns; and each line's gain
+	makes it fall 60 dB over the room's RT60. Nothing is reallocated or cleared. Each line's read
+	tap glides to its new delay at a slow, bounded rate, with linear interpolation between frames,
+	and the gains and damping follow every kFDNUpdateFrames, so a new scan bends the tail rather
+	than restarting or clicking it.
+
+	All the lines are one preallocated arena of kFDNLines blocks of the same power-of-two size,
+	sharing a write index. Prepare() allocates; everything else is real-time safe.
+*/
+class FeedbackDelayNetwork {
+public:
+	FeedbackDelayNetwork();
+
+	// sizes the arena for kFDNMaxDelaySeconds at inSampleRate and clears it; not real-time safe
+	void				Prepare(Float64 inSampleRate);
+	// clears the lines, keeping the room
+	void				Reset();
+
+	// inDecayScale multiplies the room's RT60
+	void				SetRoom(const RoomGeometry &inRoom, Float32 inDecayScale);
+
+	// inSources[c] and inDests[c] are channel c's first samples, inStride apart; they may be the
+	// same. The input channels are summed into the network and the wet outputs are decorrelated
+	// taps of it. The dry and wet gains ramp from the last call's.
+	void				Process(const Float32 * const *inSources, Float32 * const *inDests, UInt32 inStride,
+								UInt32 inNumChannels, UInt32 inFrames, Float32 inDryGain, Float32 inWetGain);
+
+private:
+	enum { kFDNUpdateFrames = 32 };
+
+	void				Update(UInt32 inFrames);
+
+	Float64				mSampleRate;
+	std::vector<Float32>	mArena;			// line i at i * (mMask + 1)
+	UInt32				mMask;
+	UInt32				mWrite;
+
+	Float32				mDelay[kFDNLines];			// frames, where the tap is now
+	Float32				mTargetDelay[kFDNLines];
+	Float32				mDelayStep[kFDNLines];		// per frame in this update
+	Float32				mGain[kFDNLines];
+	Float32				mGainStep[kFDNLines];
+	Float32				mLowpass[kFDNLines];		// the damping filters' state
+
+	Float32				mDecayFrames, mTargetDecayFrames;	// RT60
+	Float32				mDamping, mTargetDamping;			// one-pole coefficient
+	Float32				mInputGain;
+	Float32				mDry, mWet;
+};
+
+#endif // __FeedbackDelayNetwork_h__
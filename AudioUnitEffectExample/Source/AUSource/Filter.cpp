@@ -10,7 +10,70 @@ Filter Effect AU
 #include <AudioToolbox/AudioUnitUtilities.h>
 #include "FilterVersion.h"
 #include "Filter.h"
+#include "AULidarModulation.h"
+#include "CADSPKernels.h"
+#include "StateVariableFilter.h"
 #include <math.h>
+#include <string.h>
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____LopassCoefficientEngine
+
+typedef CABiquadCoefficients LopassCoefficients;
+
+// inFreq is normalized frequency 0 -> 1, inResonance is in decibels
+static void		CalculateLopassCoefficients( double inFreq, double inResonance, LopassCoefficients &outCoefficients );
+
+// fills in the magnitude response at each entry's mFrequency (in Hertz)
+static void		GetLopassFrequencyResponses( const LopassCoefficients &inCoefficients, FrequencyResponse *ioResponses,
+											 UInt32 inNumResponses, double inSampleRate );
+
+// Turns the filter parameters into coefficients once per block. When they change, the kernels
+// ramp the coefficients linearly from the last block's to the new ones across the block instead
+// of jumping, which clicks. Every coefficient pair (b1, b2) of a stable two-pole filter lies in the
+// stability triangle, which is convex, so each step of the ramp is stable too.
+// The last kCacheSize (cutoff, resonance) pairs are remembered, so sweeping back and forth over the
+// same range doesn't redo the pow/sin/cos.
+class LopassCoefficientEngine
+{
+public:
+	LopassCoefficientEngine() { Reset(); }
+
+	// the next block starts on its own coefficients, without a ramp
+	void				Reset();
+
+	// outStart is where the block starts; outStep is added before each of the inFramesToProcess
+	// frames so that the last one lands on the coefficients for inCutoff and inResonance.
+	// Returns false, with outStep zero, when the coefficients aren't moving.
+	bool				BeginBlock(	double					inCutoff,
+									double					inResonance,
+									UInt32					inFramesToProcess,
+									LopassCoefficients &	outStart,
+									LopassCoefficients &	outStep );
+
+private:
+	enum { kCacheSize = 8 };
+
+	struct CacheEntry
+	{
+		double				mCutoff;
+		double				mResonance;
+		LopassCoefficients	mCoefficients;
+		UInt32				mLastUse;
+	};
+
+	const LopassCoefficients &	Lookup( double inCutoff, double inResonance );
+
+	CacheEntry			mCache[kCacheSize];
+	UInt32				mNumCached;
+	UInt32				mUseCount;
+
+	LopassCoefficients	mCurrent;		// where the last block ended
+	bool				mHasCurrent;
+	double				mLastCutoff;
+	double				mLastResonance;
+};
+
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____FilterKernel
@@ -30,29 +93,73 @@ public:
 
 	// resets the filter state
 	virtual void		Reset();
-
-	void				CalculateLopassParams(	double inFreq, double inResonance );
-
-	// used by the custom property handled in the Filter class below
-	double				GetFrequencyResponse( double inFreq );
-	
 			
 private:
 	// filter coefficients
-	double	mA0;
-	double	mA1;
-	double	mA2;
-	double	mB1;
-	double	mB2;
+	LopassCoefficientEngine	mCoefficients;
 
 	// filter state
-	double	mX1;
-	double	mX2;
-	double	mY1;
-	double	mY2;
-	
-	double	mLastCutoff;
-	double	mLastResonance;
+	CABiquadState			mState;
+
+	// the state-variable filter's, while the filter type picks it
+	SVFCoefficientEngine	mSVFCoefficients;
+	SVFState				mSVFState;
+
+	UInt32					mType;		// of the last block
+
+	// picked when the unit is initialized, which is when its kernels are made
+	const CADSPKernels &	mKernels;
+};
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____FilterMultiChannelKernel
+
+// The same filter for every channel at once: the coefficients are shared, and the state of
+// kFilterLanes channels at a time is kept side by side so the compiler can run those channels
+// in one set of vector registers (two SSE2 or NEON registers, or one AVX register, of doubles).
+class FilterMultiChannelKernel : public AUMultiChannelKernelBase
+{
+public:
+	FilterMultiChannelKernel(AUEffectBase *inAudioUnit, UInt32 inNumChannels );
+
+	virtual void 		Process(	const Float32 * const *	inSources,
+									Float32 * const *		inDests,
+									UInt32					inStride,
+									UInt32					inNumChannels,
+									UInt32					inFramesToProcess,
+									bool &					ioSilence);
+
+	virtual void		Reset();
+
+private:
+	enum { kFilterLanes = 4 };
+
+	struct LaneState
+	{
+		double	mX1[kFilterLanes];
+		double	mX2[kFilterLanes];
+		double	mY1[kFilterLanes];
+		double	mY2[kFilterLanes];
+	};
+
+	void				ProcessLanes(	LaneState &					ioState,
+										const LopassCoefficients &	inStart,
+										const LopassCoefficients &	inStep,
+										const Float32 * const *		inSources,
+										Float32 * const *			inDests,
+										UInt32						inStride,
+										UInt32						inNumLanes,
+										UInt32						inFramesToProcess);
+
+	std::vector<LaneState>	mState;		// one per kFilterLanes channels
+
+	LopassCoefficientEngine	mCoefficients;
+
+	std::vector<SVFLaneState>	mSVFState;	// one per kSVFLanes channels
+	SVFCoefficientEngine		mSVFCoefficients;
+
+	UInt32					mType;		// of the last block
 };
 
 
@@ -67,9 +174,18 @@ public:
 	virtual OSStatus			Version() { return kFilterVersion; }
 
 	virtual OSStatus			Initialize();
+	virtual void				Cleanup();
+
+	// picks up the LiDAR modulation before the kernels read the parameters
+	virtual OSStatus			Render(	AudioUnitRenderActionFlags &	ioActionFlags,
+										const AudioTimeStamp &			inTimeStamp,
+										UInt32							inFramesToProcess );
 
 	virtual AUKernelBase *		NewKernel() { return new FilterKernel(this); }
 
+	// buses of kMinMultiChannelFilter channels or more are filtered by one object, across SIMD lanes
+	virtual AUMultiChannelKernelBase *	NewMultiChannelKernel(UInt32 inNumChannels);
+
 	// for custom property
 	virtual OSStatus			GetPropertyInfo(	AudioUnitPropertyID		inID,
 													AudioUnitScope			inScope,
@@ -82,10 +198,20 @@ public:
 													AudioUnitElement 		inElement,
 													void 					* outData );
 
+	virtual OSStatus			SetProperty(		AudioUnitPropertyID 	inID,
+													AudioUnitScope 			inScope,
+													AudioUnitElement 		inElement,
+													const void *			inData,
+													UInt32 					inDataSize );
 
 	virtual OSStatus			GetParameterInfo(	AudioUnitScope			inScope,
 													AudioUnitParameterID	inParameterID,
 													AudioUnitParameterInfo	&outParameterInfo );
+
+	// names the filter types
+	virtual OSStatus			GetParameterValueStrings(	AudioUnitScope			inScope,
+															AudioUnitParameterID	inParameterID,
+															CFArrayRef *			outStrings );
 	
     // handle presets:
     virtual OSStatus			GetPresets(	CFArrayRef	*outData	)	const;    
@@ -104,6 +230,12 @@ public:
 
 
 protected:
+	// the last curve the view asked for; it polls far more often than the curve changes
+	std::vector<FrequencyResponse>	mResponseCache;
+	LopassCoefficients				mResponseCoefficients;
+	Float64							mResponseSampleRate;
+
+	AULidarModulator				mModulator;
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -115,12 +247,30 @@ AUDIOCOMPONENT_ENTRY(AUBaseProcessFactory, Filter)
 enum
 {
 	kFilterParam_CutoffFrequency = 0,
-	kFilterParam_Resonance = 1
+	kFilterParam_Resonance = 1,
+	kFilterParam_Type = 2
+};
+
+// the biquad lowpass, or the state-variable filter with SVFResponse (type - kFilterType_StateVariable)
+enum
+{
+	kFilterType_Biquad = 0,
+	kFilterType_StateVariable = 1,
+	kNumFilterTypes = kFilterType_StateVariable + kNumSVFResponses
 };
 
 
 static CFStringRef kCutoffFreq_Name = CFSTR("cutoff frequency");
 static CFStringRef kResonance_Name = CFSTR("resonance");
+static CFStringRef kType_Name = CFSTR("filter type");
+
+static CFStringRef kTypeNames[kNumFilterTypes] = {
+	CFSTR("Biquad Lowpass"),
+	CFSTR("SVF Lowpass"),
+	CFSTR("SVF Bandpass"),
+	CFSTR("SVF Highpass"),
+	CFSTR("SVF Notch")
+};
 
 
 const float kMinCutoffHz = 12.0;
@@ -129,6 +279,11 @@ const float kMinResonance = -20.0;
 const float kMaxResonance = 20.0;
 const float kDefaultResonance = 0;
 
+const UInt32 kMinMultiChannelFilter = 4;
+
+const float kMinModulatedCutoff = 200.0;
+const float kMaxModulatedCutoff = 8000.0;
+
 
 
 // Factory presets
@@ -154,7 +309,7 @@ static AUPreset kPresets[kNumberPresets] =
 //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 Filter::Filter(AudioUnit component)
-	: AUEffectBase(component)
+	: AUEffectBase(component), mResponseSampleRate(0.0)
 {
 	// all the parameters must be set to their initial values here
 	//
@@ -163,9 +318,16 @@ Filter::Filter(AudioUnit component)
 	//
 	SetParameter(kFilterParam_CutoffFrequency, kDefaultCutoff);
 	SetParameter(kFilterParam_Resonance, kDefaultResonance);
+	SetParameter(kFilterParam_Type, kFilterType_Biquad);
 
 	// kFilterParam_CutoffFrequency max value depends on sample-rate
 	SetParamHasSampleRateDependency(true);
+
+	// by default the nearest object sweeps the cutoff: the closer it is, the brighter the sound
+	AULidarModulationMapping mapping = { kAudioUnitScope_Global, 0, kFilterParam_CutoffFrequency,
+		kAULidarModulationMapping_SubRange | kAULidarModulationMapping_Logarithmic,
+		kMinModulatedCutoff, kMaxModulatedCutoff, kAULidarModulation_Nearest, 0 };
+	mModulator.SetMappings(*this, &mapping, 1);
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -181,11 +343,48 @@ OSStatus			Filter::Initialize()
 		// in case the AU was un-initialized and parameters were changed, the view can now
 		// be made aware it needs to update the frequency response curve
 		PropertyChanged(kAudioUnitCustomProperty_FilterFrequencyResponse, kAudioUnitScope_Global, 0 );
+
+		// without a scanner running nothing is ever published, and the parameters behave as usual
+		mModulator.Open();
 	}
 	
 	return result;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::Cleanup
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				Filter::Cleanup()
+{
+	mModulator.Close();
+	AUEffectBase::Cleanup();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::Render
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			Filter::Render(	AudioUnitRenderActionFlags &	ioActionFlags,
+									const AudioTimeStamp &			inTimeStamp,
+									UInt32							inFramesToProcess )
+{
+	mModulator.Apply(*this);
+	return AUEffectBase::Render(ioActionFlags, inTimeStamp, inFramesToProcess);
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::NewMultiChannelKernel
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+AUMultiChannelKernelBase *	Filter::NewMultiChannelKernel(UInt32 inNumChannels)
+{
+	if (inNumChannels < kMinMultiChannelFilter)
+		return NULL;
+	return new FilterMultiChannelKernel(this, inNumChannels);
+}
+
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____Parameters
@@ -225,6 +424,14 @@ OSStatus			Filter::GetParameterInfo(	AudioUnitScope			inScope,
 				outParameterInfo.defaultValue = kDefaultResonance;
 				outParameterInfo.flags += kAudioUnitParameterFlag_IsHighResolution;
 				break;
+
+			case kFilterParam_Type:
+				AUBase::FillInParameterName (outParameterInfo, kType_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = kFilterType_Biquad;
+				outParameterInfo.maxValue = kNumFilterTypes - 1;
+				outParameterInfo.defaultValue = kFilterType_Biquad;
+				break;
 				
 			default:
 				result = kAudioUnitErr_InvalidParameter;
@@ -237,6 +444,24 @@ OSStatus			Filter::GetParameterInfo(	AudioUnitScope			inScope,
 	return result;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::GetParameterValueStrings
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			Filter::GetParameterValueStrings(	AudioUnitScope			inScope,
+														AudioUnitParameterID	inParameterID,
+														CFArrayRef *			outStrings )
+{
+	if (inScope != kAudioUnitScope_Global || inParameterID != kFilterParam_Type)
+		return kAudioUnitErr_InvalidParameter;
+
+	// asked with no array when only the property's info is wanted
+	if (outStrings == NULL) return noErr;
+
+	*outStrings = CFArrayCreate(NULL, (const void **)kTypeNames, kNumFilterTypes, NULL);
+	return noErr;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____Properties
 
@@ -264,6 +489,9 @@ OSStatus			Filter::GetPropertyInfo (	AudioUnitPropertyID				inID,
 				outDataSize = kNumberOfResponseFrequencies * sizeof(FrequencyResponse);
 				outWritable = false;
 				return noErr;
+
+			case kAudioUnitCustomProperty_LidarModulationMappings:
+				return mModulator.GetPropertyInfo(outDataSize, outWritable);
 		}
 	}
 	
@@ -313,39 +541,58 @@ OSStatus			Filter::GetProperty (	AudioUnitPropertyID 		inID,
 			{
 				if(inScope != kAudioUnitScope_Global) 	return kAudioUnitErr_InvalidScope;
 
-				// the kernels are only created if we are initialized
-				// since we're using the kernels to get the curve info, let
+				// the sample rate is only settled once we are initialized, so let
 				// the caller know we can't do it if we're un-initialized
 				// the UI should check for the error and not draw the curve in this case
 				if(!IsInitialized() ) return kAudioUnitErr_Uninitialized;
 
 				FrequencyResponse *freqResponseTable = ((FrequencyResponse*)outData);
 
-				// each of our filter kernel objects (one per channel) will have an identical frequency response
-				// so we arbitrarilly use the first one...
+				// every channel has the same frequency response, so it is computed from the
+				// parameters rather than from a kernel, whose coefficients may be mid-ramp
 				//
-				FilterKernel *filterKernel = dynamic_cast<FilterKernel*>(mKernelList[0]);
-
-
 				double cutoff = GetParameter(kFilterParam_CutoffFrequency);
 				double resonance = GetParameter(kFilterParam_Resonance );
+				UInt32 type = UInt32(GetParameter(kFilterParam_Type));
 
 				float srate = GetSampleRate();
 				
 				cutoff = 2.0 * cutoff / srate;
 				if(cutoff > 0.99) cutoff = 0.99;		// clip cutoff to highest allowed by sample rate...
 
-				filterKernel->CalculateLopassParams(cutoff, resonance);
+				// the state-variable filter is drawn from the biquad with its response
+				LopassCoefficients coefficients;
+				if (type > kFilterType_Biquad && type < kNumFilterTypes)
+					SVFGetBiquadCoefficients(cutoff, resonance, SVFResponse(type - kFilterType_StateVariable), coefficients);
+				else
+					CalculateLopassCoefficients(cutoff, resonance, coefficients);
+				
+				// answer from the cache while the coefficients, sample rate and frequencies asked for are the same
+				bool cached = mResponseCache.size() == kNumberOfResponseFrequencies
+								&& mResponseSampleRate == srate
+								&& memcmp(&mResponseCoefficients, &coefficients, sizeof(coefficients)) == 0;
+				for(int i = 0; cached && i < kNumberOfResponseFrequencies; i++ )
+					cached = mResponseCache[i].mFrequency == freqResponseTable[i].mFrequency;
 				
-				for(int i = 0; i < kNumberOfResponseFrequencies; i++ )
+				if (!cached)
 				{
-					double frequency = freqResponseTable[i].mFrequency;
+					GetLopassFrequencyResponses(coefficients, freqResponseTable, kNumberOfResponseFrequencies, srate);
 					
-					freqResponseTable[i].mMagnitude = filterKernel->GetFrequencyResponse(frequency);
+					mResponseCache.assign(freqResponseTable, freqResponseTable + kNumberOfResponseFrequencies);
+					mResponseCoefficients = coefficients;
+					mResponseSampleRate = srate;
+				}
+				else
+				{
+					for(int i = 0; i < kNumberOfResponseFrequencies; i++ )
+						freqResponseTable[i].mMagnitude = mResponseCache[i].mMagnitude;
 				}
 
 				return noErr;
 			}
+
+			case kAudioUnitCustomProperty_LidarModulationMappings:
+				return mModulator.GetProperty(outData);
 		}
 	}
 	
@@ -353,6 +600,22 @@ OSStatus			Filter::GetProperty (	AudioUnitPropertyID 		inID,
 	return AUEffectBase::GetProperty (inID, inScope, inElement, outData);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::SetProperty
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			Filter::SetProperty (	AudioUnitPropertyID 		inID,
+											AudioUnitScope 				inScope,
+											AudioUnitElement			inElement,
+											const void *				inData,
+											UInt32 						inDataSize)
+{
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LidarModulationMappings)
+		return mModulator.SetProperty(*this, inData, inDataSize);
+
+	return AUEffectBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
+}
+
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____Presets
@@ -415,41 +678,141 @@ OSStatus	Filter::NewFactoryPresetSet (const AUPreset & inNewFactoryPreset)
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-#pragma mark ____FilterKernel
+#pragma mark ____LopassCoefficientEngine
 
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::FilterKernel()
+//	CalculateLopassCoefficients()
 //
+//		inFreq is normalized frequency 0 -> 1
+//		inResonance is in decibels
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-FilterKernel::FilterKernel(AUEffectBase *inAudioUnit )
-	: AUKernelBase(inAudioUnit)
+static void CalculateLopassCoefficients(	double inFreq,
+											double inResonance,
+											LopassCoefficients &outCoefficients )
 {
-	Reset();
+    double r = pow(10.0, 0.05 * -inResonance);		// convert from decibels to linear
+    
+    double k = 0.5 * r * sin(M_PI * inFreq);
+    double c1 = 0.5 * (1.0 - k) / (1.0 + k);
+    double c2 = (0.5 + c1) * cos(M_PI * inFreq);
+    double c3 = (0.5 + c1 - c2) * 0.25;
+    
+    outCoefficients.mA0 = 2.0 *   c3;
+    outCoefficients.mA1 = 2.0 *   2.0 * c3;
+    outCoefficients.mA2 = 2.0 *   c3;
+    outCoefficients.mB1 = 2.0 *   -c2;
+    outCoefficients.mB2 = 2.0 *   c1;
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::~FilterKernel()
+//	ApproximateCos()
 //
+//		cos(pi * x) for x in 0 -> 1, through the Taylor series of sin(pi/2 - pi * x) to the
+//		13th power; within 1e-9 over the range, and written so the loops calling it vectorize
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-FilterKernel::~FilterKernel( )
+static inline double ApproximateCos( double inX )
 {
+	double t = M_PI * (0.5 - inX);
+	double t2 = t * t;
+	return t * (1.0 + t2 * (-1.0 / 6.0 + t2 * (1.0 / 120.0 + t2 * (-1.0 / 5040.0 + t2 * (1.0 / 362880.0
+			+ t2 * (-1.0 / 39916800.0 + t2 * (1.0 / 6227020800.0)))))));
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	GetLopassFrequencyResponses()
+//
+//		The magnitude of a0 + a1 z^-1 + a2 z^-2 on the unit circle only needs cos(w), since
+//		|H|^2 = (a0^2 + a1^2 + a2^2 + 2 (a0 a1 + a1 a2) cos(w) + 2 a0 a2 cos(2w)),
+//		and likewise for the poles with (1, b1, b2); cos(2w) is 2 cos(w)^2 - 1.
+//		So each point costs one polynomial, one divide and one square root.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static void GetLopassFrequencyResponses(	const LopassCoefficients &inCoefficients,
+											FrequencyResponse *ioResponses,
+											UInt32 inNumResponses,
+											double inSampleRate )
+{
+	const double a0 = inCoefficients.mA0, a1 = inCoefficients.mA1, a2 = inCoefficients.mA2;
+	const double b1 = inCoefficients.mB1, b2 = inCoefficients.mB2;
+	
+	// zeros and poles, as polynomials in cos(w)
+	const double num0 = a0*a0 + a1*a1 + a2*a2 - 2.0*a0*a2, num1 = 2.0*(a0*a1 + a1*a2), num2 = 4.0*a0*a2;
+	const double den0 = 1.0 + b1*b1 + b2*b2 - 2.0*b2, den1 = 2.0*(b1 + b1*b2), den2 = 4.0*b2;
+	
+	enum { kChunk = 64 };
+	double x[kChunk];
+	
+	for (UInt32 first = 0; first < inNumResponses; first += kChunk)
+	{
+		UInt32 n = inNumResponses - first;
+		if (n > kChunk) n = kChunk;
+		FrequencyResponse *responses = ioResponses + first;
+		
+		// frequency on unit circle in z-plane, folded into 0 -> Nyquist
+		for (UInt32 i = 0; i < n; ++i)
+		{
+			double scaledFrequency = fabs(2.0 * responses[i].mFrequency / inSampleRate);
+			if (scaledFrequency > 1.0) {
+				scaledFrequency = fmod(scaledFrequency, 2.0);
+				if (scaledFrequency > 1.0) scaledFrequency = 2.0 - scaledFrequency;
+			}
+			x[i] = scaledFrequency;
+		}
+		
+		for (UInt32 i = 0; i < n; ++i)
+		{
+			double c = ApproximateCos(x[i]);
+			double num = num0 + c * (num1 + c * num2);
+			double den = den0 + c * (den1 + c * den2);
+			
+			// total response; rounding can leave the zeros a hair below 0 at Nyquist
+			x[i] = sqrt(fmax(num, 0.0) / den);
+		}
+		
+		for (UInt32 i = 0; i < n; ++i)
+			responses[i].mMagnitude = x[i];
+	}
+}
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::Reset()
+//	GetFilterParams()
 //
-//		It's very important to fully reset all filter state variables to their
-//		initial settings here.  For delay/reverb effects, the delay buffers must
-//		also be cleared here.
+//		the current parameters, bounds checked, with the cutoff as 0->1 normalized frequency
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-void		FilterKernel::Reset()
+static void GetFilterParams(AUEffectBase *inAudioUnit, double &outCutoff, double &outResonance, UInt32 &outType)
 {
-	mX1 = 0.0;
-	mX2 = 0.0;
-	mY1 = 0.0;
-	mY2 = 0.0;
+	double cutoff = inAudioUnit->GetParameter(kFilterParam_CutoffFrequency);
+    double resonance = inAudioUnit->GetParameter(kFilterParam_Resonance );
+	UInt32 type = UInt32(inAudioUnit->GetParameter(kFilterParam_Type));
+    
+	// do bounds checking on parameters
+	//
+    if(cutoff < kMinCutoffHz) cutoff = kMinCutoffHz;
+
+	if(resonance < kMinResonance ) resonance = kMinResonance;
+	if(resonance > kMaxResonance ) resonance = kMaxResonance;
+
+	
+	// convert to 0->1 normalized frequency
+	float srate = inAudioUnit->GetSampleRate();
+	
+	cutoff = 2.0 * cutoff / srate;
+	if(cutoff > 0.99) cutoff = 0.99;		// clip cutoff to highest allowed by sample rate...
+	
+	outCutoff = cutoff;
+	outResonance = resonance;
+	outType = type < kNumFilterTypes ? type : kFilterType_Biquad;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassCoefficientEngine::Reset()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		LopassCoefficientEngine::Reset()
+{
+	mNumCached = 0;
+	mUseCount = 0;
+	mHasCurrent = false;
 	
 	// forces filter coefficient calculation
 	mLastCutoff = -1.0;
@@ -457,62 +820,120 @@ void		FilterKernel::Reset()
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::CalculateLopassParams()
+//	LopassCoefficientEngine::Lookup()
 //
-//		inFreq is normalized frequency 0 -> 1
-//		inResonance is in decibels
+//		a cache miss replaces the least recently used pair
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-void FilterKernel::CalculateLopassParams(	double inFreq,
-											double inResonance )
+const LopassCoefficients &	LopassCoefficientEngine::Lookup( double inCutoff, double inResonance )
 {
-    double r = pow(10.0, 0.05 * -inResonance);		// convert from decibels to linear
-    
-    double k = 0.5 * r * sin(M_PI * inFreq);
-    double c1 = 0.5 * (1.0 - k) / (1.0 + k);
-    double c2 = (0.5 + c1) * cos(M_PI * inFreq);
-    double c3 = (0.5 + c1 - c2) * 0.25;
-    
-    mA0 = 2.0 *   c3;
-    mA1 = 2.0 *   2.0 * c3;
-    mA2 = 2.0 *   c3;
-    mB1 = 2.0 *   -c2;
-    mB2 = 2.0 *   c1;
+	++mUseCount;
+	
+	UInt32 oldest = 0;
+	for (UInt32 i = 0; i < mNumCached; ++i)
+	{
+		CacheEntry &entry = mCache[i];
+		if (entry.mCutoff == inCutoff && entry.mResonance == inResonance)
+		{
+			entry.mLastUse = mUseCount;
+			return entry.mCoefficients;
+		}
+		if (entry.mLastUse < mCache[oldest].mLastUse)
+			oldest = i;
+	}
+	
+	CacheEntry &entry = mCache[mNumCached < kCacheSize ? mNumCached++ : oldest];
+	entry.mCutoff = inCutoff;
+	entry.mResonance = inResonance;
+	entry.mLastUse = mUseCount;
+	CalculateLopassCoefficients(inCutoff, inResonance, entry.mCoefficients);
+	return entry.mCoefficients;
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::GetFrequencyResponse()
+//	LopassCoefficientEngine::BeginBlock()
 //
-//		returns scalar magnitude response
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-double FilterKernel::GetFrequencyResponse( double inFreq /* in Hertz */ )
+bool		LopassCoefficientEngine::BeginBlock(	double					inCutoff,
+													double					inResonance,
+													UInt32					inFramesToProcess,
+													LopassCoefficients &	outStart,
+													LopassCoefficients &	outStep )
 {
-	float srate = GetSampleRate();
-	
-	double scaledFrequency = 2.0 * inFreq / srate;
-	
-	// frequency on unit circle in z-plane
-	double zr = cos(M_PI * scaledFrequency);
-	double zi = sin(M_PI * scaledFrequency);
+	memset(&outStep, 0, sizeof(outStep));
 	
-	// zeros response
-	double num_r = mA0*(zr*zr - zi*zi) + mA1*zr + mA2;
-	double num_i = 2.0*mA0*zr*zi + mA1*zi;
+	// only look up the filter coefficients if the parameters have changed from last time
+	if (mHasCurrent && inCutoff == mLastCutoff && inResonance == mLastResonance)
+	{
+		outStart = mCurrent;
+		return false;
+	}
 	
-	double num_mag = sqrt(num_r*num_r + num_i*num_i);
+	const LopassCoefficients &target = Lookup(inCutoff, inResonance);
+	mLastCutoff = inCutoff;
+	mLastResonance = inResonance;
 	
-	// poles response
-	double den_r = zr*zr - zi*zi + mB1*zr + mB2;
-	double den_i = 2.0*zr*zi + mB1*zi;
+	if (!mHasCurrent || inFramesToProcess == 0)
+	{
+		mCurrent = target;
+		mHasCurrent = true;
+		outStart = mCurrent;
+		return false;
+	}
 	
-	double den_mag = sqrt(den_r*den_r + den_i*den_i);
+	double scale = 1.0 / inFramesToProcess;
+	outStart = mCurrent;
+	outStep.mA0 = (target.mA0 - mCurrent.mA0) * scale;
+	outStep.mA1 = (target.mA1 - mCurrent.mA1) * scale;
+	outStep.mA2 = (target.mA2 - mCurrent.mA2) * scale;
+	outStep.mB1 = (target.mB1 - mCurrent.mB1) * scale;
+	outStep.mB2 = (target.mB2 - mCurrent.mB2) * scale;
 	
-	// total response
-	double response = num_mag  / den_mag;
+	// the next block starts exactly on the target, whatever rounding the ramp picked up
+	mCurrent = target;
+	return true;
+}
 
-	
-	return response;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____FilterKernel
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterKernel::FilterKernel()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+FilterKernel::FilterKernel(AUEffectBase *inAudioUnit )
+	: AUKernelBase(inAudioUnit), mType(kFilterType_Biquad),
+	  mKernels(CADSPKernels::ForVectorUnit(AUBase::GetVectorUnitType()))
+{
+	Reset();
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterKernel::~FilterKernel()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+FilterKernel::~FilterKernel( )
+{
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterKernel::Reset()
+//
+//		It's very important to fully reset all filter state variables to their
+//		initial settings here.  For delay/reverb effects, the delay buffers must
+//		also be cleared here.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FilterKernel::Reset()
+{
+	memset(&mState, 0, sizeof(mState));
+	memset(&mSVFState, 0, sizeof(mSVFState));
+	
+	// forces filter coefficient calculation
+	mCoefficients.Reset();
+	mSVFCoefficients.Reset();
+}
 
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -526,33 +947,33 @@ void FilterKernel::Process(	const Float32 	*inSourceP,
 							UInt32			inNumChannels,	// for version 2 AudioUnits inNumChannels is always 1
 							bool &			ioSilence)
 {
-	double cutoff = GetParameter(kFilterParam_CutoffFrequency);
-    double resonance = GetParameter(kFilterParam_Resonance );
-    
-	// do bounds checking on parameters
-	//
-    if(cutoff < kMinCutoffHz) cutoff = kMinCutoffHz;
+	double cutoff, resonance;
+	UInt32 type;
+	GetFilterParams(mAudioUnit, cutoff, resonance, type);
 
-	if(resonance < kMinResonance ) resonance = kMinResonance;
-	if(resonance > kMaxResonance ) resonance = kMaxResonance;
+	// the biquad's state means nothing to the state-variable filter, and the other way round, but
+	// the state-variable filter's responses all come out of the same integrators
+	if ((type == kFilterType_Biquad) != (mType == kFilterType_Biquad))
+		Reset();
+	mType = type;
 
-	
-	// convert to 0->1 normalized frequency
-	float srate = GetSampleRate();
-	
-	cutoff = 2.0 * cutoff / srate;
-	if(cutoff > 0.99) cutoff = 0.99;		// clip cutoff to highest allowed by sample rate...
-	
+	if (type != kFilterType_Biquad)
+	{
+		SVFRamp ramp;
+		mSVFCoefficients.BeginBlock(cutoff, resonance, SVFResponse(type - kFilterType_StateVariable), inFramesToProcess, ramp);
+		SVFProcess(mSVFState, ramp, inSourceP, inDestP, inFramesToProcess);
+		return;
+	}
+
+	LopassCoefficients c, step;
+	bool ramping = mCoefficients.BeginBlock(cutoff, resonance, inFramesToProcess, c, step);
 
-	// only calculate the filter coefficients if the parameters have changed from last time
-	if(cutoff != mLastCutoff || resonance != mLastResonance )
+	// while the coefficients hold still this is a cascade of one section
+	if (!ramping)
 	{
-		CalculateLopassParams(cutoff, resonance);
-		
-		mLastCutoff = cutoff;
-		mLastResonance = resonance;		
+		mKernels.BiquadCascade(&c, &mState, 1, inSourceP, 1, inDestP, 1, inFramesToProcess);
+		return;
 	}
-	
 
 	const Float32 *sourceP = inSourceP;
 	Float32 *destP = inDestP;
@@ -563,15 +984,166 @@ void FilterKernel::Process(	const Float32 	*inSourceP,
 	//
 	while(n--)
 	{
+		c.mA0 += step.mA0;
+		c.mA1 += step.mA1;
+		c.mA2 += step.mA2;
+		c.mB1 += step.mB1;
+		c.mB2 += step.mB2;
+		
 		float input = *sourceP++;
 		
-		float output = mA0*input + mA1*mX1 + mA2*mX2 - mB1*mY1 - mB2*mY2;
+		float output = c.mA0*input + c.mA1*mState.mX1 + c.mA2*mState.mX2 - c.mB1*mState.mY1 - c.mB2*mState.mY2;
 
-		mX2 = mX1;
-		mX1 = input;
-		mY2 = mY1;
-		mY1 = output;
+		mState.mX2 = mState.mX1;
+		mState.mX1 = input;
+		mState.mY2 = mState.mY1;
+		mState.mY1 = output;
 		
 		*destP++ = output;
 	}
 }
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____FilterMultiChannelKernel
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterMultiChannelKernel::FilterMultiChannelKernel()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+FilterMultiChannelKernel::FilterMultiChannelKernel(AUEffectBase *inAudioUnit, UInt32 inNumChannels )
+	: AUMultiChannelKernelBase(inAudioUnit, inNumChannels),
+	  mState((inNumChannels + kFilterLanes - 1) / kFilterLanes),
+	  mSVFState((inNumChannels + kSVFLanes - 1) / kSVFLanes),
+	  mType(kFilterType_Biquad)
+{
+	Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterMultiChannelKernel::Reset()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FilterMultiChannelKernel::Reset()
+{
+	for (size_t i = 0; i < mState.size(); ++i)
+		memset(&mState[i], 0, sizeof(LaneState));
+	for (size_t i = 0; i < mSVFState.size(); ++i)
+		memset(&mSVFState[i], 0, sizeof(SVFLaneState));
+	
+	// forces filter coefficient calculation
+	mCoefficients.Reset();
+	mSVFCoefficients.Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterMultiChannelKernel::Process()
+//
+//		We process kFilterLanes channels at a time
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void FilterMultiChannelKernel::Process(	const Float32 * const *	inSources,
+										Float32 * const *		inDests,
+										UInt32					inStride,
+										UInt32					inNumChannels,
+										UInt32					inFramesToProcess,
+										bool &					ioSilence)
+{
+	double cutoff, resonance;
+	UInt32 type;
+	GetFilterParams(mAudioUnit, cutoff, resonance, type);
+
+	// as in FilterKernel::Process()
+	if ((type == kFilterType_Biquad) != (mType == kFilterType_Biquad))
+		Reset();
+	mType = type;
+
+	if (type != kFilterType_Biquad)
+	{
+		SVFRamp ramp;
+		mSVFCoefficients.BeginBlock(cutoff, resonance, SVFResponse(type - kFilterType_StateVariable), inFramesToProcess, ramp);
+
+		for (UInt32 channel = 0; channel < inNumChannels; channel += kSVFLanes)
+		{
+			UInt32 numLanes = inNumChannels - channel;
+			if (numLanes > kSVFLanes) numLanes = kSVFLanes;
+
+			SVFProcessLanes(mSVFState[channel / kSVFLanes], ramp, inSources + channel, inDests + channel, inStride, numLanes, inFramesToProcess);
+		}
+		return;
+	}
+
+	// every group of lanes ramps the same way
+	LopassCoefficients start, step;
+	mCoefficients.BeginBlock(cutoff, resonance, inFramesToProcess, start, step);
+
+	for (UInt32 channel = 0; channel < inNumChannels; channel += kFilterLanes)
+	{
+		UInt32 numLanes = inNumChannels - channel;
+		if (numLanes > kFilterLanes) numLanes = kFilterLanes;
+		
+		ProcessLanes(mState[channel / kFilterLanes], start, step, inSources + channel, inDests + channel, inStride, numLanes, inFramesToProcess);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterMultiChannelKernel::ProcessLanes()
+//
+//		Lanes past inNumLanes filter silence and are never written out. Like FilterKernel,
+//		the output is rounded to Float32 before it is fed back.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void FilterMultiChannelKernel::ProcessLanes(	LaneState &					ioState,
+												const LopassCoefficients &	inStart,
+												const LopassCoefficients &	inStep,
+												const Float32 * const *		inSources,
+												Float32 * const *			inDests,
+												UInt32						inStride,
+												UInt32						inNumLanes,
+												UInt32						inFramesToProcess)
+{
+	double a0 = inStart.mA0, a1 = inStart.mA1, a2 = inStart.mA2, b1 = inStart.mB1, b2 = inStart.mB2;
+
+	// keep the state in locals so the compiler can hold it in registers across the loop
+	double x1[kFilterLanes], x2[kFilterLanes], y1[kFilterLanes], y2[kFilterLanes];
+	for (int lane = 0; lane < kFilterLanes; ++lane) {
+		x1[lane] = ioState.mX1[lane];
+		x2[lane] = ioState.mX2[lane];
+		y1[lane] = ioState.mY1[lane];
+		y2[lane] = ioState.mY2[lane];
+	}
+
+	double input[kFilterLanes] = { 0.0, 0.0, 0.0, 0.0 };
+	double output[kFilterLanes];
+
+	for (UInt32 frame = 0, offset = 0; frame < inFramesToProcess; ++frame, offset += inStride)
+	{
+		// zero while the coefficients hold still
+		a0 += inStep.mA0;
+		a1 += inStep.mA1;
+		a2 += inStep.mA2;
+		b1 += inStep.mB1;
+		b2 += inStep.mB2;
+
+		for (UInt32 lane = 0; lane < inNumLanes; ++lane)
+			input[lane] = inSources[lane][offset];
+
+		for (int lane = 0; lane < kFilterLanes; ++lane) {
+			output[lane] = (float)(a0*input[lane] + a1*x1[lane] + a2*x2[lane] - b1*y1[lane] - b2*y2[lane]);
+
+			x2[lane] = x1[lane];
+			x1[lane] = input[lane];
+			y2[lane] = y1[lane];
+			y1[lane] = output[lane];
+		}
+
+		for (UInt32 lane = 0; lane < inNumLanes; ++lane)
+			inDests[lane][offset] = output[lane];
+	}
+
+	for (int lane = 0; lane < kFilterLanes; ++lane) {
+		ioState.mX1[lane] = x1[lane];
+		ioState.mX2[lane] = x2[lane];
+		ioState.mY1[lane] = y1[lane];
+		ioState.mY2[lane] = y2[lane];
+	}
+}
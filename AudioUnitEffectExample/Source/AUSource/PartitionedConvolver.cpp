@@ -0,0 +1,325 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Non-uniform partitioned FFT convolution with impulse responses swapped in from another thread
+*/
+
+#include "PartitionedConvolver.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____PartitionedConvolver
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::Prepare
+//
+//	Level k has partitions of N = kConvolverBlock * 4^k frames starting N - kConvolverBlock
+//	frames into the impulse: kConvolverLevelPartitions of them bring the next level's start to
+//	4N - kConvolverBlock. The last level, of kConvolverMaxPartition frames or wherever the
+//	impulse ends, takes as many as it needs.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::Prepare(UInt32 inNumChannels, UInt32 inMaxImpulseFrames, const CADSPKernels &inKernels)
+{
+	mNumChannels = inNumChannels;
+	mKernels = &inKernels;
+	mMaxFrames = std::max(inMaxImpulseFrames, kConvolverBlock);
+
+	mLevels.clear();
+	UInt32 block = kConvolverBlock, offset = 0;
+	size_t spectrumFloats = 0;
+	while (offset < mMaxFrames) {
+		UInt32 remaining = (mMaxFrames - offset + block - 1) / block;
+		UInt32 partitions = block < kConvolverMaxPartition ? std::min(remaining, kConvolverLevelPartitions) : remaining;
+		mLevels.push_back(Level());
+		Level &level = mLevels.back();
+		level.mBlock = block;
+		level.mOffset = offset;
+		level.mNumPartitions = partitions;
+		level.mSpectrumStart = spectrumFloats;
+		level.mSet = 0;
+		level.mHead.assign(inNumChannels, 0);
+		spectrumFloats += size_t(partitions) * 2 * (block + 1);
+		offset += partitions * block;
+		if (block < kConvolverMaxPartition)
+			block *= 4;
+	}
+	mChannelSpectrumFloats = spectrumFloats;
+
+	// the rings span twice the longest partitions in use
+	UInt32 longest = mLevels.back().mBlock;
+	mRingMask = 2 * longest - 1;
+
+	// vector resizes don't run Level's constructors again, so prepare the transforms in place
+	for (size_t i = 0; i < mLevels.size(); ++i) {
+		mLevels[i].mFFT.Prepare(2 * mLevels[i].mBlock, inKernels);
+		mLevels[i].mLoadFFT.Prepare(2 * mLevels[i].mBlock, inKernels);
+	}
+
+	mChannels.resize(inNumChannels);
+	for (UInt32 c = 0; c < inNumChannels; ++c) {
+		mChannels[c].mInput.assign(2 * longest, 0.f);
+		mChannels[c].mOutput.assign(2 * longest, 0.f);
+		mChannels[c].mDelayLine.assign(spectrumFloats, 0.f);
+	}
+
+	mTimeBuffer.assign(2 * longest, 0.f);
+	mFadeTime.assign(2 * longest, 0.f);
+	mReal.assign(longest + 1, 0.f);
+	mImag.assign(longest + 1, 0.f);
+	mFadeReal.assign(longest + 1, 0.f);
+	mFadeImag.assign(longest + 1, 0.f);
+	mLoadTime.assign(2 * longest, 0.f);
+
+	for (UInt32 s = 0; s < kNumSets; ++s) {
+		mSets[s].mSpectra.assign(spectrumFloats * inNumChannels, 0.f);
+		mSets[s].mUsed.assign(mLevels.size() * inNumChannels, 0);
+	}
+	mFront = 0;
+	mPrevious = 1;
+	mMiddle.store(2);
+	mBack = 3;
+
+	mDry = 1.f;
+	mWet = 0.f;
+	Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::Reset
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::Reset()
+{
+	for (size_t c = 0; c < mChannels.size(); ++c) {
+		Channel &channel = mChannels[c];
+		std::fill(channel.mInput.begin(), channel.mInput.end(), 0.f);
+		std::fill(channel.mOutput.begin(), channel.mOutput.end(), 0.f);
+		std::fill(channel.mDelayLine.begin(), channel.mDelayLine.end(), 0.f);
+		memset(channel.mIn, 0, sizeof(channel.mIn));
+		memset(channel.mOut, 0, sizeof(channel.mOut));
+	}
+	for (size_t i = 0; i < mLevels.size(); ++i)
+		std::fill(mLevels[i].mHead.begin(), mLevels[i].mHead.end(), 0);
+	mTime = 0;
+	mFill = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::LoadImpulse
+//
+//	Each partition is zero-padded to twice its length and transformed, with the inverse
+//	transform's scale folded in.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::LoadImpulse(UInt32 inChannel, const Float32 *inImpulse, UInt32 inFrames)
+{
+	if (inChannel >= mNumChannels)
+		return;
+	ImpulseSet &set = mSets[mBack];
+	inFrames = std::min(inFrames, mMaxFrames);
+	Float32 *spectra = &set.mSpectra[inChannel * mChannelSpectrumFloats];
+
+	for (size_t i = 0; i < mLevels.size(); ++i) {
+		Level &level = mLevels[i];
+		const UInt32 block = level.mBlock;
+		const Float32 scale = 1.f / (2 * block);
+		UInt32 used = 0;
+		for (UInt32 p = 0; p < level.mNumPartitions; ++p) {
+			UInt32 start = level.mOffset + p * block;
+			if (start >= inFrames)
+				break;
+			UInt32 frames = std::min(block, inFrames - start);
+			Float32 *time = &mLoadTime[0];
+			for (UInt32 n = 0; n < frames; ++n)
+				time[n] = inImpulse[start + n] * scale;
+			std::fill(time + frames, time + 2 * block, 0.f);
+
+			Float32 *re = spectra + level.mSpectrumStart + size_t(p) * 2 * (block + 1);
+			level.mLoadFFT.Forward(time, re, re + block + 1);
+			used = p + 1;
+		}
+		set.mUsed[inChannel * mLevels.size() + i] = used;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::PublishImpulse
+//
+//	Swaps the filled set into the middle slot, taking back whatever was there: a set the render
+//	thread has let go of, or the last one published if it never took it.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::PublishImpulse()
+{
+	mBack = mMiddle.exchange(mBack | kFreshBit, std::memory_order_acq_rel) & kIndexMask;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::TakeNewestImpulse
+//
+//	Only once every level has finished fading to the front set, so the previous one is free to
+//	give back: the published set becomes the front and the old front the one being faded from.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::TakeNewestImpulse()
+{
+	if (!(mMiddle.load(std::memory_order_relaxed) & kFreshBit))
+		return;
+	for (size_t i = 0; i < mLevels.size(); ++i)
+		if (mLevels[i].mSet != mFront)
+			return;
+	UInt32 fresh = mMiddle.exchange(mPrevious, std::memory_order_acq_rel) & kIndexMask;
+	mPrevious = mFront;
+	mFront = fresh;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::Accumulate
+//
+//	Sums the products of each of the level's non-silent partitions with the delay line entry of
+//	the input that many partitions ago.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::Accumulate(const ImpulseSet &inSet, const Level &inLevel, UInt32 inLevelIndex, UInt32 inChannel,
+											 const Float32 *inDelayLine, UInt32 inHead, Float32 *outReal, Float32 *outImag) const
+{
+	const UInt32 bins = inLevel.mBlock + 1;
+	const UInt32 used = inSet.mUsed[inChannel * mLevels.size() + inLevelIndex];
+	const Float32 *impulse = &inSet.mSpectra[inChannel * mChannelSpectrumFloats + inLevel.mSpectrumStart];
+	std::fill(outReal, outReal + bins, 0.f);
+	std::fill(outImag, outImag + bins, 0.f);
+
+	for (UInt32 p = 0; p < used; ++p) {
+		UInt32 slot = (inHead + inLevel.mNumPartitions - p) % inLevel.mNumPartitions;
+		const Float32 *xr = inDelayLine + size_t(slot) * 2 * bins, *xi = xr + bins;
+		const Float32 *hr = impulse + size_t(p) * 2 * bins, *hi = hr + bins;
+		mKernels->ComplexMultiplyAdd(xr, xi, hr, hi, outReal, outImag, bins);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::Step
+//
+//	Runs once per kConvolverBlock frames gathered. A level of N frames that is due transforms the
+//	last 2N input frames, and the second half of the inverse of its sum is the convolution of
+//	its partitions with the last N frames, which lands from mOffset - N frames after the end of
+//	the input on: no earlier than the step being played.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::Step()
+{
+	TakeNewestImpulse();
+
+	for (UInt32 c = 0; c < mNumChannels; ++c) {
+		Float32 *input = &mChannels[c].mInput[0];
+		for (UInt32 n = 0; n < kConvolverBlock; ++n)
+			input[(mTime + n) & mRingMask] = mChannels[c].mIn[n];
+	}
+	mTime += kConvolverBlock;
+
+	for (size_t i = 0; i < mLevels.size(); ++i) {
+		Level &level = mLevels[i];
+		const UInt32 block = level.mBlock;
+		if (mTime % block)
+			continue;
+		const bool fade = level.mSet != mFront;
+		const ImpulseSet &current = mSets[level.mSet], &next = mSets[mFront];
+
+		for (UInt32 c = 0; c < mNumChannels; ++c) {
+			Channel &channel = mChannels[c];
+			Float32 *time = &mTimeBuffer[0];
+			const UInt64 start = mTime - 2 * block;
+			for (UInt32 n = 0; n < 2 * block; ++n)
+				time[n] = channel.mInput[(start + n) & mRingMask];
+
+			UInt32 head = level.mHead[c] = (level.mHead[c] + 1) % level.mNumPartitions;
+			Float32 *delayLine = &channel.mDelayLine[level.mSpectrumStart];
+			Float32 *entry = delayLine + size_t(head) * 2 * (block + 1);
+			level.mFFT.Forward(time, entry, entry + block + 1);
+
+			const UInt32 usedIndex = c * UInt32(mLevels.size()) + UInt32(i);
+			const bool sounding = current.mUsed[usedIndex] != 0;
+			const bool fadeSounding = fade && next.mUsed[usedIndex] != 0;
+			if (!sounding && !fadeSounding)
+				continue;
+
+			Float32 *out = &channel.mOutput[0];
+			const UInt64 outStart = mTime - block + level.mOffset;
+			if (sounding) {
+				Accumulate(current, level, UInt32(i), c, delayLine, head, &mReal[0], &mImag[0]);
+				level.mFFT.Inverse(&mReal[0], &mImag[0], time);
+			} else
+				std::fill(time, time + 2 * block, 0.f);
+
+			if (!fade) {
+				for (UInt32 n = 0; n < block; ++n)
+					out[(outStart + n) & mRingMask] += time[block + n];
+				continue;
+			}
+
+			Float32 *fadeTime = &mFadeTime[0];
+			if (fadeSounding) {
+				Accumulate(next, level, UInt32(i), c, delayLine, head, &mFadeReal[0], &mFadeImag[0]);
+				level.mFFT.Inverse(&mFadeReal[0], &mFadeImag[0], fadeTime);
+			} else
+				std::fill(fadeTime, fadeTime + 2 * block, 0.f);
+
+			const Float32 step = 1.f / block;
+			for (UInt32 n = 0; n < block; ++n) {
+				Float32 x = (n + 0.5f) * step;
+				out[(outStart + n) & mRingMask] += time[block + n] + x * (fadeTime[block + n] - time[block + n]);
+			}
+		}
+		level.mSet = mFront;
+	}
+
+	const Float32 dryStep = (mTargetDry - mDry) / kConvolverBlock, wetStep = (mTargetWet - mWet) / kConvolverBlock;
+	const UInt64 playStart = mTime - kConvolverBlock;
+	for (UInt32 c = 0; c < mNumChannels; ++c) {
+		Channel &channel = mChannels[c];
+		Float32 *out = &channel.mOutput[0];
+		Float32 dry = mDry, wet = mWet;
+		for (UInt32 n = 0; n < kConvolverBlock; ++n) {
+			dry += dryStep;
+			wet += wetStep;
+			Float32 &sample = out[(playStart + n) & mRingMask];
+			channel.mOut[n] = dry * channel.mIn[n] + wet * sample;
+			sample = 0.f;
+		}
+	}
+	mDry = mTargetDry;
+	mWet = mTargetWet;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	PartitionedConvolver::Process
+//
+//	Each frame in swaps for the frame kConvolverBlock behind it, so host buffers of any size,
+//	not just multiples of the step, come out on time.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		PartitionedConvolver::Process(const Float32 * const *inSources, Float32 * const *inDests, UInt32 inStride,
+										  UInt32 inNumChannels, UInt32 inFrames, Float32 inDryGain, Float32 inWetGain)
+{
+	const UInt32 channels = std::min(inNumChannels, mNumChannels);
+	mTargetDry = inDryGain;
+	mTargetWet = inWetGain;
+
+	UInt32 done = 0;
+	while (done < inFrames) {
+		UInt32 frames = std::min(inFrames - done, kConvolverBlock - mFill);
+		for (UInt32 c = 0; c < channels; ++c) {
+			Channel &channel = mChannels[c];
+			const Float32 *source = inSources[c] + size_t(done) * inStride;
+			Float32 *dest = inDests[c] + size_t(done) * inStride;
+			for (UInt32 n = 0; n < frames; ++n) {
+				Float32 x = source[n * inStride];
+				dest[n * inStride] = channel.mOut[mFill + n];
+				channel.mIn[mFill + n] = x;
+			}
+		}
+		mFill += frames;
+		done += frames;
+		if (mFill == kConvolverBlock) {
+			Step();
+			mFill = 0;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Non-uniform partitioned FFT convolution with impulse responses swapped in from another thread
+*/
+
+#ifndef __PartitionedConvolver_h__
+#define __PartitionedConvolver_h__
+
+#include "CARealFFT.h"
+#include <atomic>
+#include <vector>
+
+static const UInt32 kConvolverBlock = 64;			// frames per step, which is also the latency
+static const UInt32 kConvolverMaxPartition = 4096;	// frames in the longest partitions
+static const UInt32 kConvolverLevelPartitions = 3;	// of every size but the longest
+
+/*
+	PartitionedConvolver convolves each channel of a stream with an impulse response of its own, up
+	to a few seconds long, at a fixed cost per kConvolverBlock frames however long the host's buffers
+	are. The impulse is cut into partitions that grow four times at a time: kConvolverLevelPartitions
+	of kConvolverBlock frames, then of four times that, and so on up to kConvolverMaxPartition frames,
+	which cover the rest. Each size is a uniformly partitioned overlap-save convolution with its own
+	frequency-domain delay line; a level of N frames transforms its input once every N frames and
+	starts N - kConvolverBlock frames into the impulse, so its output is ready in time however large
+	N is. The short partitions keep the latency to kConvolverBlock frames, and the long ones keep the
+	transforms of a multi-second impulse few.
+
+	Impulses are loaded on another thread, into one of four preallocated sets of partition spectra
+	that are handed to the render thread without locks: the producer fills a set and publishes it,
+	and the render thread takes the newest one when it is not still fading from the last. Each level
+	changes over at its next transform, rendering that block with both sets and crossfading, so a new
+	impulse never clicks. The producer's set is never one the render thread is reading.
+
+	Process() delays the dry signal by the same kConvolverBlock frames and mixes it with the wet
+	signal, ramping both gains across each step.
+*/
+class PartitionedConvolver {
+public:
+	PartitionedConvolver() : mNumChannels(0), mMaxFrames(0), mRingMask(0), mKernels(&CADSPKernels::Default()), mChannelSpectrumFloats(0), mTime(0), mFill(0),
+							 mDry(1.f), mWet(0.f), mTargetDry(1.f), mTargetWet(0.f), mMiddle(2), mBack(3), mFront(0), mPrevious(1) { }
+
+	// sizes everything for inNumChannels impulses of up to inMaxImpulseFrames, to run on inKernels;
+	// not real-time safe. The impulses start out silent.
+	void				Prepare(UInt32 inNumChannels, UInt32 inMaxImpulseFrames, const CADSPKernels &inKernels);
+	UInt32				NumChannels() const { return mNumChannels; }
+	UInt32				MaxImpulseFrames() const { return mMaxFrames; }
+
+	// clears the stream's history, keeping the impulses; not real-time safe
+	void				Reset();
+
+	// --- producer side, one thread at a time ---
+
+	// transforms inFrames of channel inChannel's impulse (any beyond MaxImpulseFrames() are dropped)
+	// into the set being filled
+	void				LoadImpulse(UInt32 inChannel, const Float32 *inImpulse, UInt32 inFrames);
+	// hands the set to the render thread and starts filling another
+	void				PublishImpulse();
+
+	// --- render thread ---
+
+	// inSources[c] and inDests[c] are channel c's first samples, inStride apart; they may be the same
+	void				Process(const Float32 * const *inSources, Float32 * const *inDests, UInt32 inStride,
+								UInt32 inNumChannels, UInt32 inFrames, Float32 inDryGain, Float32 inWetGain);
+
+private:
+	enum { kNumSets = 4, kIndexMask = 0xFF, kFreshBit = 0x100 };
+
+	struct Level {
+		UInt32				mBlock;			// frames per partition
+		UInt32				mOffset;		// into the impulse of its first partition
+		UInt32				mNumPartitions;
+		size_t				mSpectrumStart;	// of its partitions in a channel's spectra
+		CARealFFT			mFFT;			// the render thread's
+		CARealFFT			mLoadFFT;		// the producer's
+		UInt32				mSet;			// the impulse set it renders with
+		std::vector<UInt32>	mHead;			// per channel, the newest delay line slot
+	};
+
+	struct Channel {
+		std::vector<Float32>	mInput;		// ring of the last input frames, twice the longest partition
+		std::vector<Float32>	mOutput;	// ring of wet output, ahead of the frames being played
+		std::vector<Float32>	mDelayLine;	// spectra of each level's recent inputs, laid out like the impulse's
+		Float32					mIn[kConvolverBlock];	// the step being gathered
+		Float32					mOut[kConvolverBlock];	// the step being played
+	};
+
+	// the partition spectra of every channel's impulse, and how many partitions of each level are not silent
+	struct ImpulseSet {
+		std::vector<Float32>	mSpectra;	// per channel, per level, per partition: mBlock + 1 real then imaginary
+		std::vector<UInt32>		mUsed;		// per channel, per level
+	};
+
+	PartitionedConvolver(const PartitionedConvolver &);
+	PartitionedConvolver & operator=(const PartitionedConvolver &);
+
+	void				Step();
+	void				TakeNewestImpulse();
+	void				Accumulate(const ImpulseSet &inSet, const Level &inLevel, UInt32 inLevelIndex, UInt32 inChannel,
+								   const Float32 *inDelayLine, UInt32 inHead, Float32 *outReal, Float32 *outImag) const;
+
+	UInt32				mNumChannels;
+	UInt32				mMaxFrames;
+	UInt32				mRingMask;
+	const CADSPKernels *	mKernels;
+	std::vector<Level>	mLevels;
+	size_t				mChannelSpectrumFloats;
+	std::vector<Channel>	mChannels;
+	UInt64				mTime;				// input frames transformed so far
+	UInt32				mFill;				// frames of the current step gathered
+	Float32				mDry, mWet;			// the gains the last step ended at
+	Float32				mTargetDry, mTargetWet;	// and the ones the next ramps to
+
+	// scratch for one level's transforms
+	std::vector<Float32>	mTimeBuffer, mReal, mImag, mFadeReal, mFadeImag, mFadeTime;
+	std::vector<Float32>	mLoadTime;		// the producer's
+
+	ImpulseSet			mSets[kNumSets];
+	std::atomic<UInt32>	mMiddle;			// a published set plus kFreshBit, or one the render thread let go of
+	UInt32				mBack;				// owned by the producer
+	UInt32				mFront;				// owned by the render thread: the newest set it took
+	UInt32				mPrevious;			// and the one before, which levels may still be fading from
+};
+
+#endif // __PartitionedConvolver_h__
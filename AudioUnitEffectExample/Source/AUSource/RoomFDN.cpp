@@ -0,0 +1,264 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Feedback delay network reverb Effect AU that follows the room the LiDAR scan sees
+*/
+
+#include "AUEffectBase.h"
+#include "RoomFDNVersion.h"
+#include "FeedbackDelayNetwork.h"
+#include "AULidarModulation.h"
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____RoomFDNKernel
+
+// Every channel feeds the unit's one FeedbackDelayNetwork.
+class RoomFDNKernel : public AUMultiChannelKernelBase
+{
+public:
+	RoomFDNKernel(AUEffectBase *inAudioUnit, UInt32 inNumChannels, FeedbackDelayNetwork &inNetwork )
+		: AUMultiChannelKernelBase(inAudioUnit, inNumChannels), mNetwork(inNetwork) { }
+
+	virtual void 		Process(	const Float32 * const *	inSources,
+									Float32 * const *		inDests,
+									UInt32					inStride,
+									UInt32					inNumChannels,
+									UInt32					inFramesToProcess,
+									bool &					ioSilence);
+
+	virtual void		Reset() { mNetwork.Reset(); }
+
+private:
+	FeedbackDelayNetwork &	mNetwork;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____RoomFDN
+
+/*
+	A cheaper reverb than RoomReverb's convolution: the room's geometry is read from the modulation
+	bus at the start of each render call and only retunes the network, which glides to it, so a
+	scan costs a few dozen multiplies instead of a new impulse response. With no scanner running
+	the network stays tuned to a default room.
+*/
+class RoomFDN : public AUEffectBase
+{
+public:
+	RoomFDN(AudioUnit component);
+
+	virtual OSStatus			Version() { return kRoomFDNVersion; }
+	virtual OSStatus			Initialize();
+	virtual void				Cleanup();
+	// picks up the room, and the decay scale, before the kernel renders
+	virtual OSStatus			Render(	AudioUnitRenderActionFlags &	ioActionFlags,
+										const AudioTimeStamp &			inTimeStamp,
+										UInt32							inFramesToProcess );
+
+	// mono or stereo, the same on both sides
+	virtual UInt32				SupportedNumChannels(	const AUChannelInfo**			outInfo);
+	virtual AUMultiChannelKernelBase *	NewMultiChannelKernel(UInt32 inNumChannels)
+	{
+		return new RoomFDNKernel(this, inNumChannels, mNetwork);
+	}
+
+	virtual OSStatus			GetParameterInfo(	AudioUnitScope			inScope,
+													AudioUnitParameterID	inParameterID,
+													AudioUnitParameterInfo	&outParameterInfo );
+
+	// the longest RT60 the network is tuned to
+	virtual	bool				SupportsTail () { return true; }
+	virtual Float64				GetTailTime() { return kFDNMaxDecaySeconds; }
+	virtual Float64				GetLatency() { return 0.0; }
+
+protected:
+	virtual void				PrepareKernels();
+
+private:
+	FeedbackDelayNetwork		mNetwork;
+	AULidarModulationBus		mBus;
+	RoomGeometry				mRoom;
+	Float32						mFeatures[kAULidarModulationFeatures];
+	Float32						mDecayScale;		// the network was last set up with; 0 until it is prepared
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Standard DSP AudioUnit implementation
+
+AUDIOCOMPONENT_ENTRY(AUBaseProcessFactory, RoomFDN)
+
+enum
+{
+	kRoomFDNParam_Mix = 0,
+	kRoomFDNParam_DecayScale = 1
+};
+
+static CFStringRef kMix_Name = CFSTR("mix");
+static CFStringRef kDecayScale_Name = CFSTR("decay scale");
+
+const float kDefaultMix = 25.0;
+const float kMinDecayScale = 0.25;
+const float kMaxDecayScale = 4.0;
+const float kDefaultDecayScale = 1.0;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Construction_Initialization
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::RoomFDN
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+RoomFDN::RoomFDN(AudioUnit component)
+	: AUEffectBase(component), mDecayScale(0.f)
+{
+	SetParameter(kRoomFDNParam_Mix, kDefaultMix);
+	SetParameter(kRoomFDNParam_DecayScale, kDefaultDecayScale);
+	mRoom.SetDefault();
+	// the delay lines wait for the first sound
+	SetDefersKernels(true);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::Initialize
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			RoomFDN::Initialize()
+{
+	OSStatus result = AUEffectBase::Initialize();
+
+	if (result == noErr)
+	{
+		// without a scanner running nothing is ever published, and the room stays as it was
+		mBus.Open();
+	}
+
+	return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::PrepareKernels
+//
+//	On the helper thread, once the first sound arrives; the next render call tunes the network
+//	to the room as it is by then.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomFDN::PrepareKernels()
+{
+	mNetwork.Prepare(GetSampleRate());
+	mDecayScale = 0.f;
+	AUEffectBase::PrepareKernels();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::Cleanup
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomFDN::Cleanup()
+{
+	mBus.Close();
+	AUEffectBase::Cleanup();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::Render
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			RoomFDN::Render(	AudioUnitRenderActionFlags &	ioActionFlags,
+										const AudioTimeStamp &			inTimeStamp,
+										UInt32							inFramesToProcess )
+{
+	bool changed = false;
+	if (mBus.IsOpen() && mBus.ReadIfNew(mFeatures)) {
+		mRoom.SetFeatures(mFeatures);
+		changed = true;
+	}
+	// the helper thread may still be preparing the network, and then it is not touched
+	if (KernelsPrepared()) {
+		Float32 decayScale = GetParameter(kRoomFDNParam_DecayScale);
+		if (decayScale != mDecayScale) {
+			mDecayScale = decayScale;
+			changed = true;
+		}
+		if (changed)
+			mNetwork.SetRoom(mRoom, mDecayScale);
+	}
+
+	return AUEffectBase::Render(ioActionFlags, inTimeStamp, inFramesToProcess);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::SupportedNumChannels
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+UInt32				RoomFDN::SupportedNumChannels(	const AUChannelInfo**			outInfo)
+{
+	static const AUChannelInfo sChannels[2] = { {1, 1}, {2, 2} };
+	if (outInfo) *outInfo = sChannels;
+	return sizeof (sChannels) / sizeof (AUChannelInfo);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Parameters
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDN::GetParameterInfo
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			RoomFDN::GetParameterInfo(	AudioUnitScope			inScope,
+												AudioUnitParameterID	inParameterID,
+												AudioUnitParameterInfo	&outParameterInfo )
+{
+	OSStatus result = noErr;
+
+	outParameterInfo.flags = 	kAudioUnitParameterFlag_IsWritable
+						+		kAudioUnitParameterFlag_IsReadable;
+
+	if (inScope == kAudioUnitScope_Global) {
+
+		switch(inParameterID)
+		{
+			case kRoomFDNParam_Mix:
+				AUBase::FillInParameterName (outParameterInfo, kMix_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Percent;
+				outParameterInfo.minValue = 0.0;
+				outParameterInfo.maxValue = 100.0;
+				outParameterInfo.defaultValue = kDefaultMix;
+				break;
+
+			case kRoomFDNParam_DecayScale:
+				AUBase::FillInParameterName (outParameterInfo, kDecayScale_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Rate;
+				outParameterInfo.minValue = kMinDecayScale;
+				outParameterInfo.maxValue = kMaxDecayScale;
+				outParameterInfo.defaultValue = kDefaultDecayScale;
+				outParameterInfo.flags += kAudioUnitParameterFlag_DisplayLogarithmic;
+				break;
+
+			default:
+				result = kAudioUnitErr_InvalidParameter;
+				break;
+		}
+	} else {
+		result = kAudioUnitErr_InvalidParameter;
+	}
+
+	return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____RoomFDNKernel
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomFDNKernel::Process
+//
+//	a linear crossfade from the dry signal to the wet one
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		RoomFDNKernel::Process(	const Float32 * const *	inSources,
+									Float32 * const *		inDests,
+									UInt32					inStride,
+									UInt32					inNumChannels,
+									UInt32					inFramesToProcess,
+									bool &					ioSilence )
+{
+	Float32 wet = GetParameter(kRoomFDNParam_Mix) * 0.01f;
+	mNetwork.Process(inSources, inDests, inStride, inNumChannels, inFramesToProcess, 1.f - wet, wet);
+}
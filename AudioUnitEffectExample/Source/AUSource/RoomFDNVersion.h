@@ -0,0 +1,20 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+*/
+
+#ifndef __RoomFDNVersion_h__
+#define __RoomFDNVersion_h__
+
+#ifdef DEBUG
+	#define kRoomFDNVersion 0xFFFFFFFF
+#else
+	#define kRoomFDNVersion 0x00010000
+#endif
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#define RoomFDN_COMP_SUBTYPE		'RFDN'
+#define RoomFDN_COMP_MANF		'appl'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#endif
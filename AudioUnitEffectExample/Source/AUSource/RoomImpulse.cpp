@@ -0,0 +1,154 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Impulse responses synthesized from the room the LiDAR scan sees
+*/
+
+#include "RoomImpulse.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+static const Float32 kMinDistance = 0.3f;		// meters; anything nearer is the sensor's own mount
+static const Float32 kMinDecaySeconds = 0.1f;
+static const Float32 kMaxAbsorption = 0.95f;
+static const Float32 kMinAbsorption = 0.08f;
+static const Float32 kTailLevel = 0.5f;			// the tail's gain in RMS on a steady signal
+static const Float32 kTailLowpass = 0.55f;		// one-pole coefficient, darkening the tail
+static const Float32 kEndFade = 0.1f;			// of the impulse, faded out so it doesn't stop dead
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomGeometry::SetDefault
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		RoomGeometry::SetDefault()
+{
+	for (UInt32 s = 0; s < kAULidarModulationSectors; ++s) {
+		mDistance[s] = 4.f;
+		mReflectivity[s] = 0.7f;
+	}
+	mMeanDistance = 4.f;
+	mCoverage = 0.9f;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomGeometry::SetFeatures
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		RoomGeometry::SetFeatures(const Float32 *inFeatures)
+{
+	for (UInt32 s = 0; s < kAULidarModulationSectors; ++s) {
+		Float32 closeness = std::min(std::max(inFeatures[kAULidarModulation_SectorNearest + s], 0.f), 1.f);
+		mDistance[s] = std::max((1.f - closeness) * kRoomScanRange, kMinDistance);
+		mReflectivity[s] = std::min(std::max(inFeatures[kAULidarModulation_SectorDensity + s], 0.f), 1.f);
+	}
+	Float32 mean = std::min(std::max(inFeatures[kAULidarModulation_Mean], 0.f), 1.f);
+	mMeanDistance = std::max((1.f - mean) * kRoomScanRange, kMinDistance);
+	mCoverage = std::min(std::max(inFeatures[kAULidarModulation_Coverage], 0.f), 1.f);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomGeometry::Reflectivity
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Float32		RoomGeometry::Reflectivity() const
+{
+	Float32 reflectivity = 0.f;
+	for (UInt32 s = 0; s < kAULidarModulationSectors; ++s)
+		reflectivity += mReflectivity[s];
+	return reflectivity * mCoverage / kAULidarModulationSectors;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomGeometry::DecaySeconds
+//
+//	A sphere of radius r has V / S = r / 3. The absorption runs from kMaxAbsorption for a scan
+//	where nothing returned, an open space, to kMinAbsorption for one that returned everywhere.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Float32		RoomGeometry::DecaySeconds(Float32 inDecayScale) const
+{
+	Float32 absorption = kMaxAbsorption - (kMaxAbsorption - kMinAbsorption) * Reflectivity();
+	return std::max(inDecayScale * 0.161f * (mMeanDistance / 3.f) / absorption, kMinDecaySeconds);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SynthesizeRoomImpulse
+//
+//	Sector s is centred on (s + 0.5) * 360 / kAULidarModulationSectors degrees counter-clockwise
+//	from the sensor's front, so channel 0 of a stereo pair gets the sectors on the left.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+UInt32		SynthesizeRoomImpulse(	const RoomGeometry &	inRoom,
+									Float32					inDecayScale,
+									Float32					inEarlyGain,
+									Float64					inSampleRate,
+									UInt32					inChannel,
+									UInt32					inNumChannels,
+									Float32 *				outImpulse,
+									UInt32					inMaxFrames )
+{
+	const Float32 decaySeconds = inRoom.DecaySeconds(inDecayScale);
+	Float32 firstDelay = 2.f * inRoom.mDistance[0] / kSpeedOfSound, lastDelay = firstDelay;
+	for (UInt32 s = 1; s < kAULidarModulationSectors; ++s) {
+		Float32 delay = 2.f * inRoom.mDistance[s] / kSpeedOfSound;
+		firstDelay = std::min(firstDelay, delay);
+		lastDelay = std::max(lastDelay, delay);
+	}
+
+	UInt32 frames = UInt32(std::min(Float64(firstDelay + decaySeconds) * inSampleRate, Float64(inMaxFrames)));
+	frames = std::max(frames, std::min(inMaxFrames, 2U));
+	memset(outImpulse, 0, frames * sizeof(Float32));
+
+	// the tail: noise through a one-pole lowpass, rising from the first reflection to the last
+	// and falling by 60 dB over the decay time
+	const UInt32 tailStart = std::min(UInt32(firstDelay * inSampleRate), frames - 1);
+	const Float32 buildUp = std::max(lastDelay - firstDelay, 0.005f) * Float32(inSampleRate);
+	const Float32 decayPerFrame = Float32(exp(-6.9078 / (decaySeconds * inSampleRate)));
+	UInt32 seed = 0x9E3779B9U * (inChannel + 1);
+	Float32 filtered = 0.f, envelope = 1.f;
+	double energy = 0.;
+	for (UInt32 n = tailStart; n < frames; ++n) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		Float32 noise = Float32(seed) * (2.f / 4294967296.f) - 1.f;
+		filtered += kTailLowpass * (noise - filtered);
+		Float32 rise = std::min((n - tailStart) / buildUp, 1.f);
+		Float32 x = filtered * envelope * rise;
+		outImpulse[n] = x;
+		energy += double(x) * x;
+		envelope *= decayPerFrame;
+	}
+	if (energy > 0.) {
+		// a steady signal comes out of the tail kTailLevel times as loud, however long it is
+		Float32 gain = Float32(kTailLevel / sqrt(energy));
+		for (UInt32 n = tailStart; n < frames; ++n)
+			outImpulse[n] *= gain;
+	}
+
+	// the early reflections, one per sector at the fractional frame of its round trip
+	for (UInt32 s = 0; s < kAULidarModulationSectors; ++s) {
+		Float32 pan = 1.f;
+		if (inNumChannels == 2) {
+			Float32 angle = Float32((s + 0.5) * 2. * M_PI / kAULidarModulationSectors);
+			Float32 left = 0.5f * (1.f + sinf(angle));
+			pan = sqrtf(inChannel == 0 ? left : 1.f - left);
+		}
+		Float32 distance = inRoom.mDistance[s];
+		Float32 level = inEarlyGain * pan * inRoom.mReflectivity[s] * std::min(1.f, 1.f / (2.f * distance));
+		Float32 position = 2.f * distance / kSpeedOfSound * Float32(inSampleRate);
+		UInt32 frame = UInt32(position);
+		Float32 fraction = position - frame;
+		if (frame + 1 < frames) {
+			outImpulse[frame] += level * (1.f - fraction);
+			outImpulse[frame + 1] += level * fraction;
+		}
+	}
+
+	// fade the last of it out, in case the decay was cut short by inMaxFrames
+	const UInt32 fadeFrames = std::max(UInt32(frames * kEndFade), 1U);
+	for (UInt32 n = 0; n < fadeFrames; ++n)
+		outImpulse[frames - 1 - n] *= Float32(n) / fadeFrames;
+
+	return frames;
+}
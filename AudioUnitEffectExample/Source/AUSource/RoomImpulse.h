@@ -0,0 +1,61 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Impulse responses synthesized from the room the LiDAR scan sees
+*/
+
+#ifndef __RoomImpulse_h__
+#define __RoomImpulse_h__
+
+#include "AULidarModulation.h"
+
+static const Float32 kRoomScanRange = 10.f;		// meters at closeness 0: the scanner's maximum distance
+static const Float32 kSpeedOfSound = 343.f;		// meters per second
+
+/*
+	RoomGeometry is what the modulation bus tells of the room around the sensor: how far the nearest
+	surface is in each sector, how much of the sector returned (a wall full of returns reflects, an
+	open doorway does not), and the mean distance and coverage of the whole scan.
+*/
+struct RoomGeometry {
+	Float32				mDistance[kAULidarModulationSectors];		// meters
+	Float32				mReflectivity[kAULidarModulationSectors];	// 0 -> 1
+	Float32				mMeanDistance;								// meters
+	Float32				mCoverage;									// 0 -> 1
+
+	// a medium-sized, fairly live room, for before the first scan or without a scanner
+	void				SetDefault();
+	// from kAULidarModulationFeatures values of the bus
+	void				SetFeatures(const Float32 *inFeatures);
+
+	// how much of the whole scan returns from reflective surfaces, 0 -> 1
+	Float32				Reflectivity() const;
+
+	/*
+		The reverberation time (RT60) from Sabine's formula, 0.161 V / (S a), for a room whose
+		volume-to-surface ratio is that of a sphere out to the mean distance and whose absorption a
+		falls as more of the scan returns from reflective surfaces. inDecayScale multiplies it.
+	*/
+	Float32				DecaySeconds(Float32 inDecayScale) const;
+};
+
+/*
+	Writes the impulse response of one output channel into outImpulse, up to inMaxFrames, and returns
+	its length. Each sector's nearest surface gives an early reflection after the round trip to it,
+	with a level that falls with the distance and rises with the sector's reflectivity, panned by
+	its angle for stereo. The late tail is decorrelated noise per channel that builds up through the
+	reflections and decays exponentially over DecaySeconds(), normalized to the same energy however
+	long it is. The noise is seeded by the channel alone, so the same room always gives the same
+	impulse and swapping one in for another of nearly the same room is inaudible.
+*/
+UInt32		SynthesizeRoomImpulse(	const RoomGeometry &	inRoom,
+									Float32					inDecayScale,
+									Float32					inEarlyGain,
+									Float64					inSampleRate,
+									UInt32					inChannel,
+									UInt32					inNumChannels,
+									Float32 *				outImpulse,
+									UInt32					inMaxFrames );
+
+#endif // __RoomImpulse_h__
@@ -0,0 +1,357 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Convolution reverb Effect AU whose impulse response is synthesized from the room the LiDAR scan sees
+*/
+
+#include "AUEffectBase.h"
+#include "RoomReverbVersion.h"
+#include "PartitionedConvolver.h"
+#include "RoomImpulse.h"
+#include "AULidarModulation.h"
+#include <chrono>
+#include <condition_variable>
+#include <math.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____RoomReverbKernel
+
+// Every channel goes through the unit's one PartitionedConvolver, which keeps the impulses and
+// the history of all of them.
+class RoomReverbKernel : public AUMultiChannelKernelBase
+{
+public:
+	RoomReverbKernel(AUEffectBase *inAudioUnit, UInt32 inNumChannels, PartitionedConvolver &inConvolver )
+		: AUMultiChannelKernelBase(inAudioUnit, inNumChannels), mConvolver(inConvolver) { }
+
+	virtual void 		Process(	const Float32 * const *	inSources,
+									Float32 * const *		inDests,
+									UInt32					inStride,
+									UInt32					inNumChannels,
+									UInt32					inFramesToProcess,
+									bool &					ioSilence);
+
+	virtual void		Reset() { mConvolver.Reset(); }
+
+private:
+	PartitionedConvolver &	mConvolver;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____RoomReverb
+
+/*
+	The impulse response is rebuilt on a worker thread whenever the modulation bus has a new scan
+	or the parameters that shape it change, and handed to the render thread by the convolver's
+	lock-free swap. Until the first scan, or with no scanner running, the unit plays a default room.
+*/
+class RoomReverb : public AUEffectBase
+{
+public:
+	RoomReverb(AudioUnit component);
+	virtual ~RoomReverb();
+
+	virtual OSStatus			Version() { return kRoomReverbVersion; }
+	virtual void				Cleanup();
+
+	// mono or stereo, the same on both sides
+	virtual UInt32				SupportedNumChannels(	const AUChannelInfo**			outInfo);
+	virtual AUMultiChannelKernelBase *	NewMultiChannelKernel(UInt32 inNumChannels)
+	{
+		return new RoomReverbKernel(this, inNumChannels, mConvolver);
+	}
+
+	virtual OSStatus			GetParameterInfo(	AudioUnitScope			inScope,
+													AudioUnitParameterID	inParameterID,
+													AudioUnitParameterInfo	&outParameterInfo );
+
+	// the longest impulse the unit synthesizes
+	virtual	bool				SupportsTail () { return true; }
+	virtual Float64				GetTailTime();
+	// the convolver's step
+	virtual Float64				GetLatency() { return kConvolverBlock / GetSampleRate(); }
+
+protected:
+	virtual void				PrepareKernels();
+
+private:
+	void						StartWorker();
+	void						StopWorker();
+	void						ImpulseWorker();
+	void						SynthesizeImpulses(const RoomGeometry &inRoom, Float32 inDecayScale, Float32 inEarlyGain);
+
+	PartitionedConvolver		mConvolver;
+	std::vector<Float32>		mImpulse;			// the worker's
+	std::thread					mWorker;
+	std::mutex					mWorkerMutex;
+	std::condition_variable		mWorkerCondition;
+	bool						mStopWorker;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Standard DSP AudioUnit implementation
+
+AUDIOCOMPONENT_ENTRY(AUBaseProcessFactory, RoomReverb)
+
+enum
+{
+	kRoomReverbParam_Mix = 0,
+	kRoomReverbParam_DecayScale = 1,
+	kRoomReverbParam_EarlyLevel = 2
+};
+
+static CFStringRef kMix_Name = CFSTR("mix");
+static CFStringRef kDecayScale_Name = CFSTR("decay scale");
+static CFStringRef kEarlyLevel_Name = CFSTR("early reflections");
+
+const float kDefaultMix = 25.0;
+const float kMinDecayScale = 0.25;
+const float kMaxDecayScale = 4.0;
+const float kDefaultDecayScale = 1.0;
+const float kMinEarlyLevel = -40.0;
+const float kMaxEarlyLevel = 6.0;
+const float kDefaultEarlyLevel = 0.0;
+
+const Float64 kMaxImpulseSeconds = 4.0;
+const int kWorkerIntervalMilliseconds = 100;	// about the scanner's rate
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Construction_Initialization
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::RoomReverb
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+RoomReverb::RoomReverb(AudioUnit component)
+	: AUEffectBase(component), mStopWorker(false)
+{
+	SetParameter(kRoomReverbParam_Mix, kDefaultMix);
+	SetParameter(kRoomReverbParam_DecayScale, kDefaultDecayScale);
+	SetParameter(kRoomReverbParam_EarlyLevel, kDefaultEarlyLevel);
+	// a few megabytes of convolver, and a worker, that an instance which never hears a sound goes without
+	SetDefersKernels(true);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::~RoomReverb
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+RoomReverb::~RoomReverb()
+{
+	StopWorker();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::PrepareKernels
+//
+//	All the convolver's memory, for kMaxImpulseSeconds at this sample rate, is allocated here,
+//	on the helper thread once the first sound arrives; the worker only ever refills it. The
+//	transforms and spectrum products run on the kernels for this CPU's vector unit.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomReverb::PrepareKernels()
+{
+	StopWorker();
+	UInt32 maxFrames = UInt32(kMaxImpulseSeconds * GetSampleRate());
+	mConvolver.Prepare(GetNumberOfChannels(), maxFrames, CADSPKernels::ForVectorUnit(GetVectorUnitType()));
+	mImpulse.assign(maxFrames, 0.f);
+	AUEffectBase::PrepareKernels();
+	StartWorker();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::Cleanup
+//
+//	The base class first waits for a prepare under way, which would start the worker again.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomReverb::Cleanup()
+{
+	AUEffectBase::Cleanup();
+	StopWorker();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::SupportedNumChannels
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+UInt32				RoomReverb::SupportedNumChannels(	const AUChannelInfo**			outInfo)
+{
+	static const AUChannelInfo sChannels[2] = { {1, 1}, {2, 2} };
+	if (outInfo) *outInfo = sChannels;
+	return sizeof (sChannels) / sizeof (AUChannelInfo);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::GetTailTime
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+Float64				RoomReverb::GetTailTime()
+{
+	return kMaxImpulseSeconds;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Parameters
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::GetParameterInfo
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			RoomReverb::GetParameterInfo(	AudioUnitScope			inScope,
+													AudioUnitParameterID	inParameterID,
+													AudioUnitParameterInfo	&outParameterInfo )
+{
+	OSStatus result = noErr;
+
+	outParameterInfo.flags = 	kAudioUnitParameterFlag_IsWritable
+						+		kAudioUnitParameterFlag_IsReadable;
+
+	if (inScope == kAudioUnitScope_Global) {
+
+		switch(inParameterID)
+		{
+			case kRoomReverbParam_Mix:
+				AUBase::FillInParameterName (outParameterInfo, kMix_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Percent;
+				outParameterInfo.minValue = 0.0;
+				outParameterInfo.maxValue = 100.0;
+				outParameterInfo.defaultValue = kDefaultMix;
+				break;
+
+			case kRoomReverbParam_DecayScale:
+				AUBase::FillInParameterName (outParameterInfo, kDecayScale_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Rate;
+				outParameterInfo.minValue = kMinDecayScale;
+				outParameterInfo.maxValue = kMaxDecayScale;
+				outParameterInfo.defaultValue = kDefaultDecayScale;
+				outParameterInfo.flags += kAudioUnitParameterFlag_DisplayLogarithmic;
+				break;
+
+			case kRoomReverbParam_EarlyLevel:
+				AUBase::FillInParameterName (outParameterInfo, kEarlyLevel_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Decibels;
+				outParameterInfo.minValue = kMinEarlyLevel;
+				outParameterInfo.maxValue = kMaxEarlyLevel;
+				outParameterInfo.defaultValue = kDefaultEarlyLevel;
+				break;
+
+			default:
+				result = kAudioUnitErr_InvalidParameter;
+				break;
+		}
+	} else {
+		result = kAudioUnitErr_InvalidParameter;
+	}
+
+	return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____ImpulseWorker
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::StartWorker
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomReverb::StartWorker()
+{
+	mStopWorker = false;
+	mWorker = std::thread(&RoomReverb::ImpulseWorker, this);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::StopWorker
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomReverb::StopWorker()
+{
+	if (!mWorker.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mWorkerMutex);
+		mStopWorker = true;
+	}
+	mWorkerCondition.notify_all();
+	mWorker.join();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::ImpulseWorker
+//
+//	Polls the bus at about the scan rate. The noise in the impulse is seeded by channel, so a
+//	rebuild for a room that hardly moved gives an impulse the crossfade makes inaudible.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomReverb::ImpulseWorker()
+{
+	// without a scanner running nothing is ever published, and the default room stays
+	AULidarModulationBus bus;
+	bus.Open();
+
+	RoomGeometry room;
+	room.SetDefault();
+	Float32 features[kAULidarModulationFeatures];
+	Float32 decayScale = -1.f, earlyLevel = 0.f;
+	bool dirty = true;
+
+	std::unique_lock<std::mutex> lock(mWorkerMutex);
+	while (!mStopWorker) {
+		if (bus.IsOpen() && bus.ReadIfNew(features)) {
+			room.SetFeatures(features);
+			dirty = true;
+		}
+		Float32 newDecayScale = GetParameter(kRoomReverbParam_DecayScale);
+		Float32 newEarlyLevel = GetParameter(kRoomReverbParam_EarlyLevel);
+		if (newDecayScale != decayScale || newEarlyLevel != earlyLevel) {
+			decayScale = newDecayScale;
+			earlyLevel = newEarlyLevel;
+			dirty = true;
+		}
+
+		if (dirty) {
+			lock.unlock();
+			SynthesizeImpulses(room, decayScale, Float32(pow(10., earlyLevel / 20.)));
+			lock.lock();
+			dirty = false;
+		}
+
+		mWorkerCondition.wait_for(lock, std::chrono::milliseconds(kWorkerIntervalMilliseconds),
+								  [this] { return mStopWorker; });
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverb::SynthesizeImpulses
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void				RoomReverb::SynthesizeImpulses(const RoomGeometry &inRoom, Float32 inDecayScale, Float32 inEarlyGain)
+{
+	const UInt32 numChannels = mConvolver.NumChannels();
+	for (UInt32 c = 0; c < numChannels; ++c) {
+		UInt32 frames = SynthesizeRoomImpulse(inRoom, inDecayScale, inEarlyGain, GetSampleRate(), c, numChannels,
+											  &mImpulse[0], UInt32(mImpulse.size()));
+		mConvolver.LoadImpulse(c, &mImpulse[0], frames);
+	}
+	mConvolver.PublishImpulse();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____RoomReverbKernel
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	RoomReverbKernel::Process
+//
+//	a linear crossfade from the dry signal to the wet one
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		RoomReverbKernel::Process(	const Float32 * const *	inSources,
+										Float32 * const *		inDests,
+										UInt32					inStride,
+										UInt32					inNumChannels,
+										UInt32					inFramesToProcess,
+										bool &					ioSilence )
+{
+	Float32 wet = GetParameter(kRoomReverbParam_Mix) * 0.01f;
+	mConvolver.Process(inSources, inDests, inStride, inNumChannels, inFramesToProcess, 1.f - wet, wet);
+}
@@ -0,0 +1,20 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+*/
+
+#ifndef __RoomReverbVersion_h__
+#define __RoomReverbVersion_h__
+
+#ifdef DEBUG
+	#define kRoomReverbVersion 0xFFFFFFFF
+#else
+	#define kRoomReverbVersion 0x00010000
+#endif
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+#define RoomReverb_COMP_SUBTYPE		'RVRB'
+#define RoomReverb_COMP_MANF		'appl'
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~//
+
+#endif
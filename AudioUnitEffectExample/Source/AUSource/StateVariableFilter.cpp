@@ -0,0 +1,257 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+A topology-preserving state-variable filter whose cutoff can move on every frame
+*/
+
+#include "StateVariableFilter.h"
+#include <math.h>
+
+static const UInt32 kWarpEntries = kSVFOctaves * kSVFStepsPerOctave + 1;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	WarpTable
+//
+//	g = tan(pi f / fs) at kSVFStepsPerOctave points an octave, from kSVFOctaves octaves below
+//	Nyquist up to it; built once, at load time. The cutoff never reaches Nyquist, so the last
+//	entry only guards the interpolation, as does the one past it.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static struct WarpTable {
+	Float32				mG[kWarpEntries + 1];
+
+	WarpTable()
+	{
+		for (UInt32 i = 0; i < kWarpEntries; ++i) {
+			double cutoff = pow(2.0, double(i) / kSVFStepsPerOctave - kSVFOctaves);
+			mG[i] = (Float32)tan(0.5 * M_PI * (cutoff < 0.999 ? cutoff : 0.999));
+		}
+		mG[kWarpEntries] = mG[kWarpEntries - 1];
+	}
+} sWarp;
+
+static inline Float32	Warp(Float32 inPosition)
+{
+	UInt32 index = UInt32(inPosition);
+	Float32 fraction = inPosition - Float32(index);
+	return sWarp.mG[index] + fraction * (sWarp.mG[index + 1] - sWarp.mG[index]);
+}
+
+// the cutoff, normalized 0 -> 1, as a position in the warp table
+static Float32			WarpPosition(double inCutoff)
+{
+	double position = kSVFStepsPerOctave * (log2(inCutoff) + kSVFOctaves);
+	if (position < 0.0) position = 0.0;
+	if (position > kWarpEntries - 1) position = kWarpEntries - 1;
+	return (Float32)position;
+}
+
+// the lowpass's gain at the cutoff is 1 / k
+static inline double	Damping(double inResonance)
+{
+	return pow(10.0, -0.05 * inResonance);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SVFCoefficientEngine::BeginBlock
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		SVFCoefficientEngine::BeginBlock(	double			inCutoff,
+												double			inResonance,
+												SVFResponse		inResponse,
+												UInt32			inFramesToProcess,
+												SVFRamp &		outRamp )
+{
+	if (!mHasCurrent || inCutoff != mLastCutoff || inResonance != mLastResonance)
+	{
+		mTargetPosition = WarpPosition(inCutoff);
+		mTargetDamping = (Float32)Damping(inResonance);
+		mTargetWarp = (Float32)tan(0.5 * M_PI * inCutoff);
+		mLastCutoff = inCutoff;
+		mLastResonance = inResonance;
+	}
+
+	if (!mHasCurrent || inFramesToProcess == 0)
+	{
+		mPosition = mTargetPosition;
+		mDamping = mTargetDamping;
+		mHasCurrent = true;
+	}
+
+	Float32 scale = inFramesToProcess ? 1.f / inFramesToProcess : 0.f;
+	outRamp.mPosition = mPosition;
+	outRamp.mPositionStep = (mTargetPosition - mPosition) * scale;
+	outRamp.mDamping = mDamping;
+	outRamp.mDampingStep = (mTargetDamping - mDamping) * scale;
+	outRamp.mWarp = mTargetWarp;
+
+	// the next block starts exactly on the target, whatever rounding the ramp picked up
+	mPosition = mTargetPosition;
+	mDamping = mTargetDamping;
+
+	// high is the input less the band (times the damping) and the low; the notch is high plus low
+	outRamp.mInputGain = inResponse == kSVFResponse_Highpass || inResponse == kSVFResponse_Notch ? 1.f : 0.f;
+	outRamp.mBandGain = inResponse == kSVFResponse_Bandpass ? 1.f : inResponse == kSVFResponse_Lowpass ? 0.f : -1.f;
+	outRamp.mLowGain = inResponse == kSVFResponse_Lowpass ? 1.f : inResponse == kSVFResponse_Highpass ? -1.f : 0.f;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SVFGetBiquadCoefficients
+//
+//	the bilinear transform of the analog responses, s = (1 / g)(1 - z^-1) / (1 + z^-1), over
+//	the shared denominator (1 + g k + g^2) + 2 (g^2 - 1) z^-1 + (1 - g k + g^2) z^-2
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		SVFGetBiquadCoefficients(	double					inCutoff,
+										double					inResonance,
+										SVFResponse				inResponse,
+										CABiquadCoefficients &	outCoefficients )
+{
+	const double g = tan(0.5 * M_PI * inCutoff), g2 = g * g;
+	const double k = Damping(inResonance);
+	const double scale = 1.0 / (1.0 + g * k + g2);
+
+	double a0, a1, a2;
+	switch (inResponse)
+	{
+		case kSVFResponse_Lowpass:	a0 = g2; a1 = 2.0 * g2; a2 = g2; break;
+		case kSVFResponse_Bandpass:	a0 = g * k; a1 = 0.0; a2 = -g * k; break;
+		case kSVFResponse_Highpass:	a0 = 1.0; a1 = -2.0; a2 = 1.0; break;
+		default:					a0 = 1.0 + g2; a1 = 2.0 * (g2 - 1.0); a2 = 1.0 + g2; break;
+	}
+	outCoefficients.mA0 = a0 * scale;
+	outCoefficients.mA1 = a1 * scale;
+	outCoefficients.mA2 = a2 * scale;
+	outCoefficients.mB1 = 2.0 * (g2 - 1.0) * scale;
+	outCoefficients.mB2 = (1.0 - g * k + g2) * scale;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SVFProcess
+//
+//	While the parameters hold still the coefficients are worked out once for the block; while
+//	they move, every frame pays for one table lookup and one divide.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <bool kMoving>
+static void		ProcessChannel(	SVFState &			ioState,
+								const SVFRamp &		inRamp,
+								const Float32 *		inSource,
+								Float32 *			inDest,
+								UInt32				inFramesToProcess )
+{
+	Float32 position = inRamp.mPosition, damping = inRamp.mDamping;
+	Float32 g = inRamp.mWarp;
+	Float32 a1 = 1.f / (1.f + g * (g + damping)), a2 = g * a1, a3 = g * a2;
+	Float32 ic1 = ioState.mIC1, ic2 = ioState.mIC2;
+
+	for (UInt32 i = 0; i < inFramesToProcess; ++i)
+	{
+		if (kMoving) {
+			position += inRamp.mPositionStep;
+			damping += inRamp.mDampingStep;
+			g = Warp(position);
+			a1 = 1.f / (1.f + g * (g + damping));
+			a2 = g * a1;
+			a3 = g * a2;
+		}
+
+		const Float32 input = inSource[i];
+		const Float32 v3 = input - ic2;
+		const Float32 band = a1 * ic1 + a2 * v3;
+		const Float32 low = ic2 + a2 * ic1 + a3 * v3;
+		ic1 = 2.f * band - ic1;
+		ic2 = 2.f * low - ic2;
+
+		inDest[i] = inRamp.mInputGain * input + inRamp.mBandGain * damping * band + inRamp.mLowGain * low;
+	}
+
+	ioState.mIC1 = ic1;
+	ioState.mIC2 = ic2;
+}
+
+void		SVFProcess(	SVFState &			ioState,
+						const SVFRamp &		inRamp,
+						const Float32 *		inSource,
+						Float32 *			inDest,
+						UInt32				inFramesToProcess )
+{
+	if (inRamp.mPositionStep != 0.f || inRamp.mDampingStep != 0.f)
+		ProcessChannel<true>(ioState, inRamp, inSource, inDest, inFramesToProcess);
+	else
+		ProcessChannel<false>(ioState, inRamp, inSource, inDest, inFramesToProcess);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SVFProcessLanes
+//
+//	the state lives in locals across the loop, and the per-lane loops have a fixed trip count,
+//	so the compiler runs them in one SSE2 or NEON register of floats
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <bool kMoving>
+static void		ProcessLanes(	SVFLaneState &			ioState,
+								const SVFRamp &			inRamp,
+								const Float32 * const *	inSources,
+								Float32 * const *		inDests,
+								UInt32					inStride,
+								UInt32					inNumLanes,
+								UInt32					inFramesToProcess )
+{
+	Float32 position = inRamp.mPosition, damping = inRamp.mDamping;
+	Float32 g = inRamp.mWarp;
+	Float32 a1 = 1.f / (1.f + g * (g + damping)), a2 = g * a1, a3 = g * a2;
+
+	Float32 ic1[kSVFLanes], ic2[kSVFLanes];
+	for (UInt32 lane = 0; lane < kSVFLanes; ++lane) {
+		ic1[lane] = ioState.mIC1[lane];
+		ic2[lane] = ioState.mIC2[lane];
+	}
+
+	Float32 input[kSVFLanes] = { 0.f, 0.f, 0.f, 0.f };
+	Float32 output[kSVFLanes];
+
+	for (UInt32 frame = 0, offset = 0; frame < inFramesToProcess; ++frame, offset += inStride)
+	{
+		if (kMoving) {
+			position += inRamp.mPositionStep;
+			damping += inRamp.mDampingStep;
+			g = Warp(position);
+			a1 = 1.f / (1.f + g * (g + damping));
+			a2 = g * a1;
+			a3 = g * a2;
+		}
+		const Float32 bandGain = inRamp.mBandGain * damping;
+
+		for (UInt32 lane = 0; lane < inNumLanes; ++lane)
+			input[lane] = inSources[lane][offset];
+
+		for (UInt32 lane = 0; lane < kSVFLanes; ++lane) {
+			const Float32 v3 = input[lane] - ic2[lane];
+			const Float32 band = a1 * ic1[lane] + a2 * v3;
+			const Float32 low = ic2[lane] + a2 * ic1[lane] + a3 * v3;
+			ic1[lane] = 2.f * band - ic1[lane];
+			ic2[lane] = 2.f * low - ic2[lane];
+			output[lane] = inRamp.mInputGain * input[lane] + bandGain * band + inRamp.mLowGain * low;
+		}
+
+		for (UInt32 lane = 0; lane < inNumLanes; ++lane)
+			inDests[lane][offset] = output[lane];
+	}
+
+	for (UInt32 lane = 0; lane < kSVFLanes; ++lane) {
+		ioState.mIC1[lane] = ic1[lane];
+		ioState.mIC2[lane] = ic2[lane];
+	}
+}
+
+void		SVFProcessLanes(	SVFLaneState &			ioState,
+								const SVFRamp &			inRamp,
+								const Float32 * const *	inSources,
+								Float32 * const *		inDests,
+								UInt32					inStride,
+								UInt32					inNumLanes,
+								UInt32					inFramesToProcess )
+{
+	if (inRamp.mPositionStep != 0.f || inRamp.mDampingStep != 0.f)
+		ProcessLanes<true>(ioState, inRamp, inSources, inDests, inStride, inNumLanes, inFramesToProcess);
+	else
+		ProcessLanes<false>(ioState, inRamp, inSources, inDests, inStride, inNumLanes, inFramesToProcess);
+}
@@ -0,0 +1,107 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+A topology-preserving state-variable filter whose cutoff can move on every frame
+*/
+
+#ifndef __StateVariableFilter_h__
+#define __StateVariableFilter_h__
+
+#include "CADSPKernels.h"
+
+static const UInt32 kSVFLanes = 4;				// channels side by side in SVFProcessLanes()
+static const UInt32 kSVFOctaves = 14;			// the warp table's reach below Nyquist
+static const UInt32 kSVFStepsPerOctave = 128;	// of the warp table
+
+// which of the filter's outputs is heard; all four come out of the same two integrators
+enum SVFResponse {
+	kSVFResponse_Lowpass = 0,
+	kSVFResponse_Bandpass = 1,		// unity gain at the cutoff, narrowing with the resonance
+	kSVFResponse_Highpass = 2,
+	kSVFResponse_Notch = 3,
+	kNumSVFResponses
+};
+
+/*
+	What the filter needs for one block: the cutoff as a position in the warp table and the damping
+	(k, 1 / Q) where the block starts, what is added to each before every frame so that the last one
+	lands on the block's parameters, and the gains that mix the integrators into the response.
+*/
+struct SVFRamp {
+	Float32				mPosition, mPositionStep;
+	Float32				mDamping, mDampingStep;
+	Float32				mWarp;			// tan(pi f / fs) at the block's cutoff, exactly, for when it holds still
+	Float32				mInputGain;		// of the input
+	Float32				mBandGain;		// of the band output, times the damping
+	Float32				mLowGain;		// of the low output
+};
+
+// two integrators; kSVFLanes channels' worth in SVFLaneState
+struct SVFState {
+	Float32				mIC1, mIC2;
+};
+
+struct SVFLaneState {
+	Float32				mIC1[kSVFLanes];
+	Float32				mIC2[kSVFLanes];
+};
+
+/*
+	SVFCoefficientEngine is the state-variable counterpart of the biquad's coefficient engine. The
+	filter is the trapezoidal (topology-preserving) discretization of the analog state-variable
+	filter, which stays stable however fast its cutoff and damping move, so instead of ramping a
+	biquad's coefficients the kernels move the cutoff itself on every frame. The cutoff moves in
+	octaves, a straight line through the warp table, and each frame looks up tan(pi f / fs) there
+	with linear interpolation, which is within 0.1% of it up to 0.9 of Nyquist. A block that holds
+	still uses the exact warp. The tan, pow and log2 are only redone when the parameters change.
+*/
+class SVFCoefficientEngine {
+public:
+	SVFCoefficientEngine() { Reset(); }
+
+	// the next block starts on its own parameters, without a ramp
+	void				Reset() { mHasCurrent = false; }
+
+	// inCutoff is normalized frequency 0 -> 1, as for the biquad, and inResonance the gain in
+	// decibels at the cutoff of the lowpass. outRamp starts where the last block ended.
+	void				BeginBlock(	double			inCutoff,
+									double			inResonance,
+									SVFResponse		inResponse,
+									UInt32			inFramesToProcess,
+									SVFRamp &		outRamp );
+
+private:
+	bool				mHasCurrent;
+	double				mLastCutoff, mLastResonance;
+	Float32				mPosition, mDamping;		// where the last block ended
+	Float32				mTargetPosition, mTargetDamping, mTargetWarp;
+};
+
+// the biquad with the same frequency response, for drawing it; inCutoff and inResonance are as for
+// SVFCoefficientEngine::BeginBlock()
+void					SVFGetBiquadCoefficients(	double					inCutoff,
+													double					inResonance,
+													SVFResponse				inResponse,
+													CABiquadCoefficients &	outCoefficients );
+
+// filters inFramesToProcess samples of one channel; inSource and inDest may be the same
+void					SVFProcess(	SVFState &			ioState,
+									const SVFRamp &		inRamp,
+									const Float32 *		inSource,
+									Float32 *			inDest,
+									UInt32				inFramesToProcess );
+
+// the same for up to kSVFLanes channels at once, channel c's samples inStride apart from inSources[c]
+// and inDests[c], as AUMultiChannelKernelBase hands them over. The warp and the coefficients are
+// worked out once a frame for every lane, and the lanes' integrators run as one vector; lanes past
+// inNumLanes filter silence and are never written.
+void					SVFProcessLanes(	SVFLaneState &			ioState,
+											const SVFRamp &			inRamp,
+											const Float32 * const *	inSources,
+											Float32 * const *		inDests,
+											UInt32					inStride,
+											UInt32					inNumLanes,
+											UInt32					inFramesToProcess );
+
+#endif // __StateVariableFilter_h__
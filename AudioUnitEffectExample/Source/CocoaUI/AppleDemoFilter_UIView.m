@@ -9,7 +9,8 @@ See LICENSE.txt for this sample’s licensing information
 enum
 {
 	kFilterParam_CutoffFrequency = 0,
-	kFilterParam_Resonance = 1
+	kFilterParam_Resonance = 1,
+	kFilterParam_Type = 2
 };
 
 extern NSString *kGraphViewDataChangedNotification;	// notification broadcast by the view when the user has changed the resonance 
@@ -183,6 +184,10 @@ void addParamListener (AUEventListenerRef listener, void* refCon, AudioUnitEvent
 		
 		auEvent.mArgument.mParameter.mParameterID = kFilterParam_Resonance;
 		addParamListener (mAUEventListener, self, &auEvent);
+
+		// the filter type has no control here, but it changes the curve
+		auEvent.mArgument.mParameter.mParameterID = kFilterParam_Type;
+		addParamListener (mAUEventListener, self, &auEvent);
 		
 		/* Add a listener for the changes in our custom property */
 		/* The Audio unit will send a property change when the unit is intialized */		
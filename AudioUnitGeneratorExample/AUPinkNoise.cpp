@@ -23,6 +23,7 @@ AUPinkNoise::AUPinkNoise(AudioUnit component)
 	Globals()->UseIndexedParameters(kNumberOfParameters);
 	SetParameter(kParam_Volume, kAudioUnitScope_Global, 0, kDefaultValue_Volume, 0);
 	SetParameter(kParam_On, kAudioUnitScope_Global, 0, 1, 0);
+	SetParameter(kParam_Correlated, kAudioUnitScope_Global, 0, 0, 0);
 }
 
 void				AUPinkNoise::Cleanup()
@@ -37,7 +38,8 @@ OSStatus			AUPinkNoise::Initialize()
 {
 	const CAStreamBasicDescription & theDesc = GetStreamFormat(kAudioUnitScope_Output, 0);
 	
-	mPink = new PinkNoiseGenerator::PinkNoiseGenerator(theDesc.mSampleRate);
+	mPink = new MultiChannelPinkNoiseGenerator(theDesc.mSampleRate, theDesc.NumberChannels());
+	mChannelBuffers.resize(theDesc.NumberChannels());
 	
 	return noErr;
 }
@@ -127,6 +129,13 @@ OSStatus			AUPinkNoise::GetParameterInfo(AudioUnitScope		inScope,
                 outParameterInfo.maxValue = 1;
                 outParameterInfo.defaultValue = 1;
                 break;				
+            case kParam_Correlated:
+                AUBase::FillInParameterName (outParameterInfo, kParameterCorrelatedName, false);
+                outParameterInfo.unit = kAudioUnitParameterUnit_Boolean;
+                outParameterInfo.minValue = 0.0;
+                outParameterInfo.maxValue = 1;
+                outParameterInfo.defaultValue = 0;
+                break;
             default:
                 result = kAudioUnitErr_InvalidParameter;
                 break;
@@ -249,10 +258,14 @@ OSStatus 	AUPinkNoise::Render(		AudioUnitRenderActionFlags &ioActionFlags,
 	AUBufferList::ZeroBuffer(outputBufList);	
 	
 	// only render if the on parameter is true. Otherwise send the zeroed buffer
-	if (Globals()->GetParameter(kParam_On))
+	if (Globals()->GetParameter(kParam_On) && outputBufList.mNumberBuffers == mChannelBuffers.size())
 	{
 		for (UInt32 i=0; i < outputBufList.mNumberBuffers; i++)
-			mPink->Render((Float32*)outputBufList.mBuffers[i].mData, nFrames, Globals()->GetParameter(kParam_Volume));
+			mChannelBuffers[i] = (Float32*)outputBufList.mBuffers[i].mData;
+		
+		// all the channels are rendered together, each one with its own generator
+		mPink->Render(&mChannelBuffers[0], nFrames, Globals()->GetParameter(kParam_Volume),
+						Globals()->GetParameter(kParam_Correlated) != 0);
 	}	
 	return noErr;
 }
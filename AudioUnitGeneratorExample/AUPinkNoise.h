@@ -23,11 +23,13 @@ static const float kDefaultValue_Volume = 0.7071;
 
 static CFStringRef kParameterVolumeName = CFSTR("Volume");
 static CFStringRef kParameterOnName = CFSTR("On/Off");
+static CFStringRef kParameterCorrelatedName = CFSTR("Correlated Channels");
 
 enum {
 	kParam_Volume =0,
 	kParam_On=1,
-	kNumberOfParameters=2
+	kParam_Correlated=2,	// every channel plays the same noise, computed once
+	kNumberOfParameters=3
 };
 
 #pragma mark ____AUPinkNoise
@@ -87,7 +89,8 @@ public:
 	virtual bool				CanScheduleParameters() const { return false; }
 	
 private:
-	PinkNoiseGenerator *mPink;
+	MultiChannelPinkNoiseGenerator *mPink;
+	std::vector<Float32 *> mChannelBuffers;		// sized in Initialize, filled each render
 	
 	CAAudioChannelLayout mOutputChannelLayout;
 };
@@ -19,6 +19,7 @@ See LICENSE.txt for this sample’s licensing information
 #include "Biquad.h"
 #include "ComplexNumber.h"
 #include <math.h>
+#include <string.h>
 
 #define _PI 3.14159
 const float kSquareRootOf2 = sqrt(2.);
@@ -780,3 +781,151 @@ void Biquad::Process(	const float	*inSourceP,
         mX2 = x2;
         mY2 = y2;
 }
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____BiquadCascade
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::BiquadCascade()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+BiquadCascade::BiquadCascade()
+	: mBankState(0), mNumSections(0)
+{
+	mBanks[0].mNumSections = mBanks[1].mNumSections = 0;
+	Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::SetSections()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool BiquadCascade::SetSections(	const BiquadCoefficients	*inSections,
+									int							inNumSections )
+{
+	if (inNumSections < 0 || inNumSections > kMaxSections)
+		return false;
+	
+	// claim the bank Process() isn't reading; it won't switch to it while kWriting is set
+	SInt32 state;
+	do {
+		state = mBankState;
+	} while (!CAAtomicCompareAndSwap32Barrier(state, state | kWriting, &mBankState));
+	
+	Bank &bank = mBanks[(state & kActiveBank) ^ 1];
+	bank.mNumSections = inNumSections;
+	for (int k = 0; k < kMaxSections; k++)
+	{
+		if (k < inNumSections)
+		{
+			bank.mA0[k] = inSections[k].a0;
+			bank.mA1[k] = inSections[k].a1;
+			bank.mA2[k] = inSections[k].a2;
+			bank.mB1[k] = inSections[k].b1;
+			bank.mB2[k] = inSections[k].b2;
+		}
+		else
+		{
+			bank.mA0[k] = 1.0;
+			bank.mA1[k] = bank.mA2[k] = bank.mB1[k] = bank.mB2[k] = 0.0;
+		}
+	}
+	
+	// Process() only ever clears kPending and flips kActiveBank, and can't while kWriting is set
+	do {
+		state = mBankState;
+	} while (!CAAtomicCompareAndSwap32Barrier(state, (state & ~kWriting) | kPending, &mBankState));
+	
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::Reset()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BiquadCascade::Reset()
+{
+	for (int k = 0; k < kMaxSections; k++)
+		mX1[k] = mX2[k] = mY1[k] = mY2[k] = 0.0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::Process()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void BiquadCascade::Process(	const float	*inSourceP,
+								float	*inDestP,
+								int		inFramesToProcess )
+{
+	SInt32 state = mBankState;
+	if ((state & kPending) && !(state & kWriting)
+		&& CAAtomicCompareAndSwap32Barrier(state, (state ^ kActiveBank) & ~kPending, &mBankState))
+	{
+		state ^= kActiveBank;
+		
+		// sections that were passing their input through start from silence
+		int numSections = mBanks[state & kActiveBank].mNumSections;
+		for (int k = mNumSections; k < numSections; k++)
+			mX1[k] = mX2[k] = mY1[k] = mY2[k] = 0.0;
+		mNumSections = numSections;
+	}
+	
+	const Bank &bank = mBanks[state & kActiveBank];
+	const int numSections = bank.mNumSections;
+	const int n = inFramesToProcess;
+	
+	if (n <= 0) return;
+	if (numSections == 0)
+	{
+		if (inDestP != inSourceP)
+			memmove(inDestP, inSourceP, n * sizeof(float));
+		return;
+	}
+	
+	//load class data into locals the compiler can keep in vector registers
+	float a0[kMaxSections], a1[kMaxSections], a2[kMaxSections], b1[kMaxSections], b2[kMaxSections];
+	float x1[kMaxSections], x2[kMaxSections], y1[kMaxSections], y2[kMaxSections];
+	float stage[kMaxSections];		// each section's output from the previous step
+	for (int k = 0; k < kMaxSections; k++)
+	{
+		a0[k] = bank.mA0[k]; a1[k] = bank.mA1[k]; a2[k] = bank.mA2[k];
+		b1[k] = bank.mB1[k]; b2[k] = bank.mB2[k];
+		x1[k] = mX1[k]; x2[k] = mX2[k]; y1[k] = mY1[k]; y2[k] = mY2[k];
+		stage[k] = 0.0;
+	}
+	
+	// numSections - 1 extra steps drain the pipeline, so the last section catches up to
+	// the end of the buffer. Section k only keeps its state on steps where it has a real
+	// sample (0 <= t - k < n); on the others it computes a value that is never used.
+	const int numSteps = n + numSections - 1;
+	for (int t = 0; t < numSteps; t++)
+	{
+		float x[kMaxSections];
+		x[0] = t < n ? inSourceP[t] : 0.0f;
+		for (int k = 1; k < kMaxSections; k++)
+			x[k] = stage[k - 1];
+		
+		for (int k = 0; k < kMaxSections; k++)
+		{
+			float y = a0[k]*x[k] + a1[k]*x1[k] + a2[k]*x2[k] - b1[k]*y1[k] - b2[k]*y2[k];
+			bool live = t - k >= 0 && t - k < n;
+			
+			x2[k] = live ? x1[k] : x2[k];
+			x1[k] = live ? x[k] : x1[k];
+			y2[k] = live ? y1[k] : y2[k];
+			y1[k] = live ? y : y1[k];
+			stage[k] = y;
+		}
+		
+		// in place is safe: the sample written is never later than the one just read
+		if (t >= numSections - 1)
+			inDestP[t - (numSections - 1)] = stage[numSections - 1];
+	}
+	
+	//save our register values for x1, y1, x2, and y2 for posterity
+	for (int k = 0; k < kMaxSections; k++)
+	{
+		mX1[k] = x1[k]; mX2[k] = x2[k]; mY1[k] = y1[k]; mY2[k] = y2[k];
+	}
+}
@@ -21,6 +21,7 @@ See LICENSE.txt for this sample’s licensing information
 
 #include <math.h>
 #include <stdio.h>
+#include "CAAtomic.h"
 
 class Complex;
 
@@ -171,6 +172,78 @@ private:
 	float	mY2;
 };
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade
+//
+//		up to kMaxSections biquads in series, e.g. the bands of an EQ. Fill a
+//		BiquadCoefficients per section with the static Biquad::Get...Params() methods.
+//
+//		Process() runs the sections as a wavefront: at step t section k filters sample t - k,
+//		which section k - 1 produced on the step before, so all the sections advance together
+//		in one vector operation per step instead of one dependent chain per sample. The
+//		pipeline fills and drains inside every call, so there is no added latency.
+//
+//		SetSections() may be called from any one thread (typically the UI) while another
+//		renders: it writes the bank the render thread is not using, and Process() switches
+//		banks at the start of its next call.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+struct BiquadCoefficients
+{
+	float	a0;
+	float	a1;
+	float	a2;
+	float	b1;
+	float	b2;
+};
+
+class BiquadCascade
+{
+public:
+	enum { kMaxSections = 8 };
+	
+	BiquadCascade();
+	
+	// returns false if inNumSections is more than kMaxSections
+	bool			SetSections(	const BiquadCoefficients	*inSections,
+									int							inNumSections );
+	
+	// not while Process() may be running
+	void			Reset();
+	
+	// mono; inSourceP and inDestP may be the same buffer
+	void 			Process(	const float	*inSourceP,
+								float	*inDestP,
+								int		inFramesToProcess );
+
+private:
+	struct Bank
+	{
+		int		mNumSections;
+		float	mA0[kMaxSections];		// sections past mNumSections pass their input through
+		float	mA1[kMaxSections];
+		float	mA2[kMaxSections];
+		float	mB1[kMaxSections];
+		float	mB2[kMaxSections];
+	};
+	
+	enum
+	{
+		kActiveBank	= 1,		// which of mBanks Process() reads
+		kPending	= 2,		// the other bank has newer coefficients
+		kWriting	= 4			// SetSections() is filling the other bank; don't switch
+	};
+	
+	Bank			mBanks[2];
+	volatile SInt32	mBankState;
+	int				mNumSections;		// sections in the bank in use, for clearing new ones
+	
+	float	mX1[kMaxSections];
+	float	mX2[kMaxSections];
+	float	mY1[kMaxSections];
+	float	mY2[kMaxSections];
+};
+
+
 const double kInv1200 = 1.0 / 1200.0;
 const double kInv440 = 1.0 / 440.0;
 const double kInvLog2 = 1.0 / log(2.0);
@@ -47,6 +47,21 @@ public:
 		}
 	};
 
+	inline float	Process1(	float	white )
+	{
+		buf0= 0.99886 * buf0 + 0.0555179 * white;
+		buf1= 0.99332 * buf1 + 0.0750759 * white;
+		buf2= 0.96900 * buf2 + 0.1538520 * white;
+		buf3= 0.86650 * buf3 + 0.3104856 * white;
+		buf4= 0.55000 * buf4 + 0.5329522 * white;
+		buf5= -0.7616 * buf5 + 0.0168980 * white;
+		float pink=buf0 + buf1 + buf2 + buf3 + buf4  
+			+ buf5 + buf6 + white * .5362;
+		buf6= 0.115926 * white;
+		
+		return pink;
+	}
+
 
 
 private:
@@ -76,6 +91,8 @@ Pink filter:
 
 #include "TRandom.h"
 #include "Biquad.h"
+#include <string.h>
+#include <vector>
 
 class PinkNoiseGenerator
 {
@@ -88,41 +105,159 @@ public:
 	
 	void Render(Float32 *inBuffer, UInt32 inNumFrames, Float32 inVolume )
 	{
-		const Float32 kInv32768 = (1.0 / 32768.0) * 0.5;
+		// the white noise is made a chunk at a time in a stack buffer that stays in cache,
+		// and the pink and rumble filters run in one pass from there, so the output buffer
+		// is only swept once however large it is
+		Float32 white[kNoiseChunk];
+		
+		// working on copies that never escape lets the compiler keep both filters' state
+		// in registers, rather than reloading it past every store to the output
+		PinkFilter pink = filter;
+		Biquad rumble = rumbleFilter;
 		
 		Float32 *destP = inBuffer;
-		int n = inNumFrames;
+		UInt32 remaining = inNumFrames;
 		
-		while(n--)
+		while (remaining > 0)
 		{
-			SInt32 r = SInt32(GetRandomLong(65536) ) - 32768;
-			Float32 sample = r * kInv32768 * inVolume;
+			UInt32 n = remaining < UInt32(kNoiseChunk) ? remaining : UInt32(kNoiseChunk);
 			
-			*destP++ = sample;
+			noise.Generate(white, n, 0.5 * inVolume);
+			
+			// Hipass rumble filter to remove potential skanky DC offset
+			for (UInt32 i = 0; i < n; i++)
+				destP[i] = rumble.Process1(pink.Process1(white[i]));
+			
+			destP += n;
+			remaining -= n;
 		}
-	
 		
-		// filter "backwards" since kernel is in reverse order
-		filter.Process(	inBuffer,
-						inBuffer,
-						inNumFrames,
-						1,
-						1
-						);
-	
-	
-		// Hipass rumble filter to remove potential skanky DC offset
-		rumbleFilter.Process(	inBuffer,
-								inBuffer,
-								inNumFrames,
-								1,
-								1
-								);
+		filter = pink;
+		rumbleFilter = rumble;
 	}
 
 
 private:
+	enum { kNoiseChunk = 256 };
+	
 	float			nyquist;
+	TBlockRandom	noise;
 	Biquad 			rumbleFilter;
 	PinkFilter 		filter;
 };
+
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	MultiChannelPinkNoiseGenerator
+//
+//		the same white noise, pink filter and rumble filter as PinkNoiseGenerator, for any
+//		number of independent channels. Channels are taken kLanes at a time and every piece of
+//		their state is stored lane by lane, so each step of the loop advances a whole group
+//		of channels with vector instructions instead of running the channels one after another.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class MultiChannelPinkNoiseGenerator
+{
+public:
+	enum { kLanes = TBlockRandom::kLanes };
+	
+	MultiChannelPinkNoiseGenerator(Float32 inSampleRate, UInt32 inNumChannels )
+		: mNumChannels(inNumChannels), mGroups((inNumChannels + kLanes - 1) / kLanes)
+	{
+		Biquad::GetHipassParams(10.0/*Hertz*/ / (0.5 * inSampleRate), 0.0, mA0, mA1, mA2, mB1, mB2 );
+		
+		for (size_t g = 0; g < mGroups.size(); g++)
+		{
+			memset(&mGroups[g], 0, sizeof(Lanes));
+			TBlockRandom::SeedLanes(kRandomSeed + UInt32(g), mGroups[g].random, kLanes);
+		}
+	}
+	
+	// inBuffers holds one non-interleaved buffer per channel. With inCorrelated, channel 0 is
+	// rendered and copied to the others, for a noise bed that is identical in every speaker
+	void Render(Float32 * const *inBuffers, UInt32 inNumFrames, Float32 inVolume, bool inCorrelated )
+	{
+		if (mNumChannels == 0) return;
+		
+		const float scale = 0.5f * inVolume * (1.0f / 2147483648.0f);
+		UInt32 numGroups = inCorrelated ? 1 : UInt32(mGroups.size());
+		
+		for (UInt32 g = 0; g < numGroups; g++)
+		{
+			UInt32 firstChannel = g * kLanes;
+			UInt32 numLanes = inCorrelated ? 1 : (mNumChannels - firstChannel < UInt32(kLanes) ? mNumChannels - firstChannel : UInt32(kLanes));
+			
+			// the local copy never escapes, so the compiler can hold it in vector registers
+			Lanes s = mGroups[g];
+			
+			for (UInt32 first = 0; first < inNumFrames; first += kChunk)
+			{
+				UInt32 n = inNumFrames - first < UInt32(kChunk) ? inNumFrames - first : UInt32(kChunk);
+				float out[kChunk][kLanes];
+				
+				for (UInt32 i = 0; i < n; i++)
+				{
+					for (int lane = 0; lane < kLanes; lane++)
+					{
+						UInt32 x = s.random[lane];
+						x ^= x << 13;
+						x ^= x >> 17;
+						x ^= x << 5;
+						s.random[lane] = x;
+						float white = float(SInt32(x)) * scale;
+						
+						s.buf0[lane] = 0.99886f * s.buf0[lane] + 0.0555179f * white;
+						s.buf1[lane] = 0.99332f * s.buf1[lane] + 0.0750759f * white;
+						s.buf2[lane] = 0.96900f * s.buf2[lane] + 0.1538520f * white;
+						s.buf3[lane] = 0.86650f * s.buf3[lane] + 0.3104856f * white;
+						s.buf4[lane] = 0.55000f * s.buf4[lane] + 0.5329522f * white;
+						s.buf5[lane] = -0.7616f * s.buf5[lane] + 0.0168980f * white;
+						float pink = s.buf0[lane] + s.buf1[lane] + s.buf2[lane] + s.buf3[lane] + s.buf4[lane]
+							+ s.buf5[lane] + s.buf6[lane] + white * 0.5362f;
+						s.buf6[lane] = 0.115926f * white;
+						
+						// Hipass rumble filter to remove potential skanky DC offset
+						float y = mA0 * pink + mA1 * s.x1[lane] + mA2 * s.x2[lane] - mB1 * s.y1[lane] - mB2 * s.y2[lane];
+						s.x2[lane] = s.x1[lane];
+						s.x1[lane] = pink;
+						s.y2[lane] = s.y1[lane];
+						s.y1[lane] = y;
+						
+						out[i][lane] = y;
+					}
+				}
+				
+				for (UInt32 lane = 0; lane < numLanes; lane++)
+				{
+					Float32 *destP = inBuffers[firstChannel + lane] + first;
+					for (UInt32 i = 0; i < n; i++)
+						destP[i] = out[i][lane];
+				}
+			}
+			
+			mGroups[g] = s;
+		}
+		
+		if (inCorrelated)
+		{
+			for (UInt32 ch = 1; ch < mNumChannels; ch++)
+				memcpy(inBuffers[ch], inBuffers[0], inNumFrames * sizeof(Float32));
+		}
+	}
+
+
+private:
+	enum { kChunk = 64 };
+	
+	struct Lanes
+	{
+		float	buf0[kLanes], buf1[kLanes], buf2[kLanes], buf3[kLanes];
+		float	buf4[kLanes], buf5[kLanes], buf6[kLanes];
+		float	x1[kLanes], x2[kLanes], y1[kLanes], y2[kLanes];
+		UInt32	random[kLanes];
+	};
+	
+	UInt32				mNumChannels;
+	std::vector<Lanes>	mGroups;
+	float				mA0, mA1, mA2, mB1, mB2;
+};
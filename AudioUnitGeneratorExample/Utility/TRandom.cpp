@@ -47,6 +47,72 @@ void TRandom::Seed(UInt32 j)
     mIndex2 = 31;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____TBlockRandom
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TBlockRandom::SeedLanes
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TBlockRandom::SeedLanes(UInt32 n, UInt32 *outStates, int inNumLanes)
+{
+	// the lanes start from unrelated points; xorshift never leaves a zero state, so skip it
+	TRandom seeder(n);
+	for (int lane = 0; lane < inNumLanes; lane++)
+	{
+		UInt32 state;
+		do {
+			state = (seeder(0x10000) << 16) | seeder(0x10000);
+		} while (state == 0);
+		outStates[lane] = state;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TBlockRandom::Generate
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TBlockRandom::Generate(float *outSamples, UInt32 inNumSamples, float inScale)
+{
+	const float scale = inScale * (1.0f / 2147483648.0f);	// a signed 32 bit value to +/- inScale
+
+	UInt32 state[kLanes];
+	for (int lane = 0; lane < kLanes; lane++)
+		state[lane] = mState[lane];
+
+	float *destP = outSamples;
+	UInt32 n = inNumSamples;
+	
+	// the inner loops have no dependence between lanes, so each one is a handful of vector ops
+	while (n >= UInt32(kLanes))
+	{
+		for (int lane = 0; lane < kLanes; lane++)
+		{
+			UInt32 x = state[lane];
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			state[lane] = x;
+			destP[lane] = float(SInt32(x)) * scale;
+		}
+		destP += kLanes;
+		n -= kLanes;
+	}
+
+	for (UInt32 lane = 0; lane < n; lane++)
+	{
+		UInt32 x = state[lane];
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		state[lane] = x;
+		destP[lane] = float(SInt32(x)) * scale;
+	}
+
+	for (int lane = 0; lane < kLanes; lane++)
+		mState[lane] = state[lane];
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____EasyFunctions
 
@@ -43,4 +43,32 @@ protected:
     long mIndex2;
 };
 
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TBlockRandom
+//
+//		fills whole buffers with uniform random floats. kLanes independent xorshift32
+//		generators run side by side, one per element of a vector register, so the fill
+//		loop vectorizes; sample i comes from lane i % kLanes.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class TBlockRandom
+{
+public:
+	enum { kLanes = 8 };
+
+	TBlockRandom() {Seed(kRandomSeed);};
+	TBlockRandom(UInt32 n) {Seed(n);};
+
+	void Seed(UInt32 n) {SeedLanes(n, mState, kLanes);};
+
+	// nonzero, unrelated xorshift32 states for inNumLanes generators, derived from n
+	static void SeedLanes(UInt32 n, UInt32 *outStates, int inNumLanes);
+
+	// outSamples[0 .. inNumSamples) = uniform values in [-inScale, inScale)
+	void Generate(float *outSamples, UInt32 inNumSamples, float inScale);
+
+protected:
+	UInt32 mState[kLanes];
+};
+
 #endif		// __TRandom
@@ -0,0 +1,73 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ A MIDI channel's pitch bend and level, smoothed and evaluated at control rate
+ */
+
+#include "ControlRateModulation.h"
+#include <cmath>
+
+// closer than this to its target a value snaps to it, and the cycle goes static
+static const Float32 kSettledBend = 1.e-4f;		// semitones
+static const Float32 kSettledGain = 1.e-5f;
+
+ControlRateModulation::ControlRateModulation()
+    : mNumPoints(1), mNumFrames(0), mBend(0.f), mLevel(1.f), mPrimed(false)
+{
+    Resize(0);
+}
+
+void ControlRateModulation::Resize(UInt32 inMaxFrames)
+{
+    const UInt32 maxPoints = 2 + (inMaxFrames + kControlRateFrames - 1) / kControlRateFrames;
+    mRatio.assign(maxPoints, 1.f);
+    mGain.assign(maxPoints, 1.f);
+    mNumPoints = 1;
+    mPrimed = false;
+}
+
+Float32 ControlRateModulation::Coefficient(Float64 inSampleRate)
+{
+    return Float32(1. - exp(-double(kControlRateFrames) / (double(kControlSmoothingSeconds) * inSampleRate)));
+}
+
+void ControlRateModulation::Evaluate(Float32 inBendSemitones, Float32 inGain, UInt32 inNumFrames, Float32 inCoefficient)
+{
+    mNumFrames = inNumFrames;
+    if (!mPrimed) {
+        mBend = inBendSemitones;
+        mLevel = inGain;
+        mRatio[0] = exp2f(mBend / 12.f);
+        mGain[0] = mLevel;
+        mPrimed = true;
+    } else {
+        mRatio[0] = mRatio[mNumPoints - 1];
+        mGain[0] = mGain[mNumPoints - 1];
+    }
+    mNumPoints = 1;
+    if (mBend == inBendSemitones && mLevel == inGain)
+        return;
+    const UInt32 numPoints = 1 + (inNumFrames + kControlRateFrames - 1) / kControlRateFrames;
+    if (numPoints > mRatio.size()) {
+        // a cycle longer than Resize() was told of steps straight to the targets
+        mBend = inBendSemitones;
+        mLevel = inGain;
+        mRatio[0] = exp2f(mBend / 12.f);
+        mGain[0] = mLevel;
+        return;
+    }
+    for (UInt32 point = 1; point < numPoints; ++point) {
+        // a short last period takes a shorter step
+        const Float32 coefficient = inCoefficient * Float32(PeriodFrames(point - 1)) / Float32(kControlRateFrames);
+        mBend += coefficient * (inBendSemitones - mBend);
+        mLevel += coefficient * (inGain - mLevel);
+        if (std::fabs(inBendSemitones - mBend) < kSettledBend)
+            mBend = inBendSemitones;
+        if (std::fabs(inGain - mLevel) < kSettledGain)
+            mLevel = inGain;
+        mRatio[point] = exp2f(mBend / 12.f);
+        mGain[point] = mLevel;
+    }
+    mNumPoints = numPoints;
+}
@@ -0,0 +1,73 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ A MIDI channel's pitch bend and level, smoothed and evaluated at control rate
+ */
+
+#ifndef __ControlRateModulation_h__
+#define __ControlRateModulation_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <algorithm>
+#include <vector>
+
+static const UInt32 kControlRateFrames = 32;			// output frames from one control point to the next
+static const Float32 kControlSmoothingSeconds = 0.01f;	// time constant of the glide to a new target
+
+/*
+ ControlRateModulation turns what a channel's controllers ask for, read once per render cycle, into
+ control points kControlRateFrames frames apart: the pitch bend as a frequency ratio, and a gain.
+ Each value follows its target through a one-pole smoother stepped once per point, so a bend that
+ arrives as a burst of coarse MIDI steps glides instead. The voices read the points as linear ramps
+ of their phase increment and level (see WavetableVoiceBank::Render), so the only exp2 is the one
+ per point for the whole channel, never one per voice or per frame.
+
+ Point 0 is where the previous cycle ended, point k is frame k * kControlRateFrames of the cycle and
+ the last point is its end. Once both values have settled on their targets the cycle is static: it
+ holds point 0 alone, which the voices apply as constants.
+
+ Resize() allocates and must only be called off the render thread; the rest is for the render thread.
+ */
+class ControlRateModulation
+{
+public:
+    ControlRateModulation();
+
+    void			Resize(UInt32 inMaxFrames);
+    // the next Evaluate() jumps to its targets, for a channel that has fallen silent
+    void			Reset() { mPrimed = false; }
+
+    // per render cycle, with the targets as they stand; inCoefficient comes from Coefficient()
+    void			Evaluate(Float32 inBendSemitones, Float32 inGain, UInt32 inNumFrames, Float32 inCoefficient);
+    // the smoother's step per control point at an output rate
+    static Float32	Coefficient(Float64 inSampleRate);
+
+    bool			IsStatic() const { return mNumPoints == 1; }
+    UInt32			NumPoints() const { return mNumPoints; }
+    Float32			Ratio(UInt32 inPoint) const { return mRatio[inPoint]; }
+    Float32			Gain(UInt32 inPoint) const { return mGain[inPoint]; }
+    // the gain glides one way through a cycle, so it is loudest at one end of it
+    Float32			MaxGain() const { return std::max(mGain[0], mGain[mNumPoints - 1]); }
+    // output frames from point inPoint to the next; the cycle's last period may be short
+    UInt32			PeriodFrames(UInt32 inPoint) const
+    {
+        return std::min(kControlRateFrames, mNumFrames - inPoint * kControlRateFrames);
+    }
+
+private:
+    std::vector<Float32>	mRatio;
+    std::vector<Float32>	mGain;
+    UInt32					mNumPoints;
+    UInt32					mNumFrames;		// of the cycle
+    Float32					mBend;			// smoothed, in semitones
+    Float32					mLevel;			// smoothed gain
+    bool					mPrimed;
+};
+
+#endif
@@ -0,0 +1,422 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Pooled granular voices over the scan tables, scheduled on a timing wheel
+ */
+
+#include "GrainScheduler.h"
+#include "ScanMipMap.h"
+#include "WavetableVoice.h"
+#include "CAVectorUnit.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+	#include <immintrin.h>
+	#define GRAIN_SCHEDULER_X86 1
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define GRAIN_SCHEDULER_NEON 1
+#endif
+
+static const UInt32 kGrainWindowSize = 1 << kGrainWindowBits;
+static const UInt32 kGrainWindowShift = 32 - kGrainWindowBits;
+static const UInt32 kNoGrainRequest = 0xFFFFFFFF;
+
+// one period of a Hann window, so a grain's window phase runs from silence through the peak and back
+struct GrainWindowTable
+{
+    GrainWindowTable()
+    {
+        for (UInt32 i = 0; i < kGrainWindowSize; ++i)
+            mTable[i] = Float32(0.5 - 0.5 * std::cos(2. * M_PI * i / kGrainWindowSize));
+    }
+
+    Float32			mTable[kGrainWindowSize];
+};
+
+// built at load time, like the kernel below, so no grain ever waits on a static-init guard
+static const GrainWindowTable sGrainWindow;
+
+// how a grain's phase indexes a table of 1 << inBits entries: its top bits pick the entry, the rest
+// are the interpolation fraction
+struct GrainTableShape
+{
+    explicit GrainTableShape(UInt32 inBits)
+    : mShift(32 - inBits), mTableMask((1U << inBits) - 1), mFractionMask((1U << mShift) - 1),
+      mFractionScale(1.f / Float32(1U << mShift)) {}
+
+    UInt32			mShift;
+    UInt32			mTableMask;
+    UInt32			mFractionMask;
+    Float32			mFractionScale;
+};
+
+void RenderGrainsScalar(const GrainBatch &inBatch, Float32 *ioMono, UInt32 inNumFrames)
+{
+    const Float32 *window = sGrainWindow.mTable;
+    for (UInt32 g = 0; g < inBatch.mNumGrains; ++g) {
+        const Float32 *table = inBatch.mTable[g];
+        const GrainTableShape shape(inBatch.mTableBits[g]);
+        const UInt32 inc = inBatch.mIncrement[g], windowInc = inBatch.mWindowIncrement[g];
+        const Float32 offset = inBatch.mOffset[g], scale = inBatch.mScale[g];
+        const UInt32 start = UInt32(std::max(inBatch.mDelay[g], SInt32(0)));
+        const UInt32 end = UInt32(std::max(std::min(inBatch.mRemaining[g], SInt32(inNumFrames)), SInt32(0)));
+        // the phases count from the block's start whether or not the grain has, as the SIMD kernels' do
+        UInt32 phase = inBatch.mPhase[g] + start * inc, windowPhase = inBatch.mWindowPhase[g] + start * windowInc;
+        for (UInt32 frame = start; frame < end; ++frame) {
+            const UInt32 index = phase >> shape.mShift;
+            const Float32 fraction = Float32(phase & shape.mFractionMask) * shape.mFractionScale;
+            const Float32 a = table[index], b = table[(index + 1) & shape.mTableMask];
+            ioMono[frame] += (a + (b - a) * fraction - offset) * scale * window[windowPhase >> kGrainWindowShift];
+            phase += inc;
+            windowPhase += windowInc;
+        }
+        inBatch.mPhase[g] += inNumFrames * inc;
+        inBatch.mWindowPhase[g] += inNumFrames * windowInc;
+    }
+}
+
+// the frames of grain inGrain from inFrame to inEnd, for the SIMD kernels' last few of each grain;
+// the phases are the grain's at inFrame and are left alone
+static inline void RenderGrainTail(const GrainBatch &inBatch, UInt32 inGrain, UInt32 inPhase, UInt32 inWindowPhase,
+                                   Float32 *ioMono, UInt32 inFrame, UInt32 inEnd)
+{
+    const Float32 *table = inBatch.mTable[inGrain], *window = sGrainWindow.mTable;
+    const GrainTableShape shape(inBatch.mTableBits[inGrain]);
+    const UInt32 inc = inBatch.mIncrement[inGrain], windowInc = inBatch.mWindowIncrement[inGrain];
+    for (UInt32 frame = inFrame; frame < inEnd; ++frame) {
+        const UInt32 index = inPhase >> shape.mShift;
+        const Float32 fraction = Float32(inPhase & shape.mFractionMask) * shape.mFractionScale;
+        const Float32 a = table[index], b = table[(index + 1) & shape.mTableMask];
+        ioMono[frame] += (a + (b - a) * fraction - inBatch.mOffset[inGrain]) * inBatch.mScale[inGrain]
+                       * window[inWindowPhase >> kGrainWindowShift];
+        inPhase += inc;
+        inWindowPhase += windowInc;
+    }
+}
+
+#if GRAIN_SCHEDULER_X86
+
+static void RenderGrainsSSE(const GrainBatch &inBatch, Float32 *ioMono, UInt32 inNumFrames)
+{
+    const Float32 *window = sGrainWindow.mTable;
+    const __m128i one = _mm_set1_epi32(1);
+
+    for (UInt32 g = 0; g < inBatch.mNumGrains; ++g) {
+        const Float32 *table = inBatch.mTable[g];
+        const GrainTableShape tableShape(inBatch.mTableBits[g]);
+        const __m128i shift = _mm_cvtsi32_si128(SInt32(tableShape.mShift));
+        const __m128i fractionMask = _mm_set1_epi32(SInt32(tableShape.mFractionMask));
+        const __m128i tableMask = _mm_set1_epi32(SInt32(tableShape.mTableMask));
+        const __m128 fractionScale = _mm_set1_ps(tableShape.mFractionScale);
+        const UInt32 inc = inBatch.mIncrement[g], windowInc = inBatch.mWindowIncrement[g];
+        const UInt32 start = UInt32(std::max(inBatch.mDelay[g], SInt32(0)));
+        const UInt32 end = UInt32(std::max(std::min(inBatch.mRemaining[g], SInt32(inNumFrames)), SInt32(0)));
+        const UInt32 phase = inBatch.mPhase[g] + start * inc, windowPhase = inBatch.mWindowPhase[g] + start * windowInc;
+        // a lane per frame: the grain's one table and the window are read four entries at a time
+        __m128i p = _mm_add_epi32(_mm_set1_epi32(SInt32(phase)), _mm_setr_epi32(0, SInt32(inc), SInt32(2 * inc), SInt32(3 * inc)));
+        __m128i w = _mm_add_epi32(_mm_set1_epi32(SInt32(windowPhase)),
+                                  _mm_setr_epi32(0, SInt32(windowInc), SInt32(2 * windowInc), SInt32(3 * windowInc)));
+        const __m128i pStep = _mm_set1_epi32(SInt32(4 * inc)), wStep = _mm_set1_epi32(SInt32(4 * windowInc));
+        const __m128 offset = _mm_set1_ps(inBatch.mOffset[g]), scale = _mm_set1_ps(inBatch.mScale[g]);
+
+        UInt32 frame = start;
+        for (; frame + 4 <= end; frame += 4) {
+            alignas(16) SInt32 i0[4], i1[4], wi[4];
+            const __m128i index = _mm_srl_epi32(p, shift);
+            _mm_store_si128(reinterpret_cast<__m128i *>(i0), index);
+            _mm_store_si128(reinterpret_cast<__m128i *>(i1), _mm_and_si128(_mm_add_epi32(index, one), tableMask));
+            _mm_store_si128(reinterpret_cast<__m128i *>(wi), _mm_srli_epi32(w, kGrainWindowShift));
+            const __m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, fractionMask)), fractionScale);
+            const __m128 a = _mm_setr_ps(table[i0[0]], table[i0[1]], table[i0[2]], table[i0[3]]);
+            const __m128 b = _mm_setr_ps(table[i1[0]], table[i1[1]], table[i1[2]], table[i1[3]]);
+            const __m128 shape = _mm_setr_ps(window[wi[0]], window[wi[1]], window[wi[2]], window[wi[3]]);
+            const __m128 value = _mm_sub_ps(_mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction)), offset);
+            const __m128 out = _mm_mul_ps(_mm_mul_ps(value, scale), shape);
+            _mm_storeu_ps(ioMono + frame, _mm_add_ps(_mm_loadu_ps(ioMono + frame), out));
+            p = _mm_add_epi32(p, pStep);
+            w = _mm_add_epi32(w, wStep);
+        }
+        const UInt32 done = frame - start;
+        RenderGrainTail(inBatch, g, phase + done * inc, windowPhase + done * windowInc, ioMono, frame, end);
+        inBatch.mPhase[g] += inNumFrames * inc;
+        inBatch.mWindowPhase[g] += inNumFrames * windowInc;
+    }
+}
+
+#endif // GRAIN_SCHEDULER_X86
+
+#if GRAIN_SCHEDULER_NEON
+
+static void RenderGrainsNEON(const GrainBatch &inBatch, Float32 *ioMono, UInt32 inNumFrames)
+{
+    const Float32 *window = sGrainWindow.mTable;
+    const uint32x4_t one = vdupq_n_u32(1);
+
+    for (UInt32 g = 0; g < inBatch.mNumGrains; ++g) {
+        const Float32 *table = inBatch.mTable[g];
+        const GrainTableShape tableShape(inBatch.mTableBits[g]);
+        // a right shift by a count known only at run time is a left shift by its negation
+        const int32x4_t shift = vdupq_n_s32(-SInt32(tableShape.mShift));
+        const uint32x4_t fractionMask = vdupq_n_u32(tableShape.mFractionMask), tableMask = vdupq_n_u32(tableShape.mTableMask);
+        const UInt32 inc = inBatch.mIncrement[g], windowInc = inBatch.mWindowIncrement[g];
+        const UInt32 start = UInt32(std::max(inBatch.mDelay[g], SInt32(0)));
+        const UInt32 end = UInt32(std::max(std::min(inBatch.mRemaining[g], SInt32(inNumFrames)), SInt32(0)));
+        const UInt32 phase = inBatch.mPhase[g] + start * inc, windowPhase = inBatch.mWindowPhase[g] + start * windowInc;
+        const uint32_t phases[4] = { phase, phase + inc, phase + 2 * inc, phase + 3 * inc };
+        const uint32_t windowPhases[4] = { windowPhase, windowPhase + windowInc, windowPhase + 2 * windowInc, windowPhase + 3 * windowInc };
+        uint32x4_t p = vld1q_u32(phases), w = vld1q_u32(windowPhases);
+        const uint32x4_t pStep = vdupq_n_u32(4 * inc), wStep = vdupq_n_u32(4 * windowInc);
+        const float32x4_t offset = vdupq_n_f32(inBatch.mOffset[g]);
+        const Float32 scale = inBatch.mScale[g];
+
+        UInt32 frame = start;
+        for (; frame + 4 <= end; frame += 4) {
+            uint32_t i0[4], i1[4], wi[4];
+            const uint32x4_t index = vshlq_u32(p, shift);
+            vst1q_u32(i0, index);
+            vst1q_u32(i1, vandq_u32(vaddq_u32(index, one), tableMask));
+            vst1q_u32(wi, vshrq_n_u32(w, kGrainWindowShift));
+            const float32x4_t fraction = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(p, fractionMask)), tableShape.mFractionScale);
+            const Float32 a[4] = { table[i0[0]], table[i0[1]], table[i0[2]], table[i0[3]] };
+            const Float32 b[4] = { table[i1[0]], table[i1[1]], table[i1[2]], table[i1[3]] };
+            const Float32 shape[4] = { window[wi[0]], window[wi[1]], window[wi[2]], window[wi[3]] };
+            const float32x4_t va = vld1q_f32(a);
+            const float32x4_t value = vsubq_f32(vmlaq_f32(va, vsubq_f32(vld1q_f32(b), va), fraction), offset);
+            const float32x4_t out = vmulq_f32(vmulq_n_f32(value, scale), vld1q_f32(shape));
+            vst1q_f32(ioMono + frame, vaddq_f32(vld1q_f32(ioMono + frame), out));
+            p = vaddq_u32(p, pStep);
+            w = vaddq_u32(w, wStep);
+        }
+        const UInt32 done = frame - start;
+        RenderGrainTail(inBatch, g, phase + done * inc, windowPhase + done * windowInc, ioMono, frame, end);
+        inBatch.mPhase[g] += inNumFrames * inc;
+        inBatch.mWindowPhase[g] += inNumFrames * windowInc;
+    }
+}
+
+#endif // GRAIN_SCHEDULER_NEON
+
+static GrainKernel PickGrainKernel()
+{
+#if GRAIN_SCHEDULER_X86
+    if (CAVectorUnit::HasSSE2()) return RenderGrainsSSE;
+#elif GRAIN_SCHEDULER_NEON
+    // as for the wavetable voices, NEON is assumed wherever it was compiled in
+    return RenderGrainsNEON;
+#endif
+    return RenderGrainsScalar;
+}
+
+static const GrainKernel sGrainKernel = PickGrainKernel();
+
+void RenderGrains(const GrainBatch &inBatch, Float32 *ioMono, UInt32 inNumFrames)
+{
+    sGrainKernel(inBatch, ioMono, inNumFrames);
+}
+
+// the cloud's scatter starts here at every Reset()
+static const UInt64 kGrainCloudSeed = 0x9E3779B97F4A7C15ULL;
+
+GrainCloudSettings::GrainCloudSettings()
+: mDensity(0.f), mDuration(0.05f), mFrequency(220.f), mPosition(0.f), mSpread(1.f), mJitter(1.f), mLevel(0.1f),
+  mTable(kFullScanTable)
+{
+}
+
+GrainScheduler::GrainScheduler()
+: mSampleRate(44100.), mClock(0), mNumDropped(0), mNumActive(0), mFreeRequest(kNoGrainRequest), mNumPending(0),
+  mNextCloudOnset(0.), mRandom(kGrainCloudSeed)
+{
+    std::fill(mWheel, mWheel + kGrainWheelSlots, kNoGrainRequest);
+    SetCloud(mCloud);
+}
+
+void GrainScheduler::Resize(UInt32 inMaxGrains, Float64 inSampleRate)
+{
+    mSampleRate = inSampleRate;
+    mPhase.assign(inMaxGrains, 0);
+    mIncrement.assign(inMaxGrains, 0);
+    mWindowPhase.assign(inMaxGrains, 0);
+    mWindowIncrement.assign(inMaxGrains, 0);
+    mDelay.assign(inMaxGrains, 0);
+    mRemaining.assign(inMaxGrains, 0);
+    mTable.assign(inMaxGrains, 0);
+    mTableLevel.assign(inMaxGrains, 0);
+    mGain.assign(inMaxGrains, 0.f);
+    mTableData.assign(inMaxGrains, NULL);
+    mTableBits.assign(inMaxGrains, kScanTableDefaultBits);
+    mOffset.assign(inMaxGrains, 0.f);
+    mScale.assign(inMaxGrains, 0.f);
+    mRequests.resize(inMaxGrains);
+    Reset();
+    // the cloud's grains in frames and increments at the new rate
+    SetCloud(mCloud);
+}
+
+void GrainScheduler::Reset()
+{
+    mClock = 0;
+    mNumDropped = 0;
+    mNumActive = 0;
+    std::fill(mWheel, mWheel + kGrainWheelSlots, kNoGrainRequest);
+    const UInt32 numRequests = UInt32(mRequests.size());
+    for (UInt32 i = 0; i < numRequests; ++i)
+        mRequests[i].mNext = i + 1 < numRequests ? i + 1 : kNoGrainRequest;
+    mFreeRequest = numRequests ? 0 : kNoGrainRequest;
+    mNumPending = 0;
+    mNextCloudOnset = 0.;
+    mRandom = kGrainCloudSeed;
+}
+
+void GrainScheduler::SetCloud(const GrainCloudSettings &inCloud)
+{
+    // a cloud that starts starts now, not wherever it stopped
+    if (mCloud.mDensity <= 0.f)
+        mNextCloudOnset = Float64(mClock);
+    mCloud = inCloud;
+    mCloudGrain.mTable = inCloud.mTable;
+    mCloudGrain.mTableLevel = ScanTableLevelForFrequency(inCloud.mFrequency, mSampleRate);
+    mCloudGrain.mStartPhase = 0;
+    mCloudGrain.mIncrement = WavetablePhaseIncrement(inCloud.mFrequency / mSampleRate);
+    mCloudGrain.mDuration = std::max(UInt32(inCloud.mDuration * mSampleRate + 0.5), 1U);
+    mCloudGrain.mGain = inCloud.mLevel;
+}
+
+bool GrainScheduler::Schedule(UInt64 inOnset, const GrainParams &inGrain)
+{
+    const UInt64 onset = std::max(inOnset, mClock);
+    if (onset >= mClock + kGrainWheelSlots * kGrainWheelSlotFrames || mFreeRequest == kNoGrainRequest) {
+        mNumDropped++;
+        return false;
+    }
+    const UInt32 index = mFreeRequest;
+    Request &request = mRequests[index];
+    mFreeRequest = request.mNext;
+    request.mOnset = onset;
+    request.mGrain = inGrain;
+    UInt32 &slot = mWheel[(onset / kGrainWheelSlotFrames) % kGrainWheelSlots];
+    request.mNext = slot;
+    slot = index;
+    mNumPending++;
+    return true;
+}
+
+// xorshift64*, as SyntheticScene uses, so a cloud is the same on every platform
+Float64 GrainScheduler::Random()
+{
+    mRandom ^= mRandom >> 12;
+    mRandom ^= mRandom << 25;
+    mRandom ^= mRandom >> 27;
+    return Float64((mRandom * 0x2545F4914F6CDD1DULL) >> 11) * (1. / 9007199254740992.);
+}
+
+void GrainScheduler::ScheduleCloud(UInt64 inEnd)
+{
+    if (mCloud.mDensity <= 0.f)
+        return;
+    const Float64 interval = mSampleRate / mCloud.mDensity;
+    while (mNextCloudOnset < Float64(inEnd)) {
+        GrainParams grain = mCloudGrain;
+        Float64 start = mCloud.mPosition + (Random() - 0.5) * mCloud.mSpread;
+        start -= std::floor(start);
+        grain.mStartPhase = UInt32(UInt64(start * 4294967296.0));
+        Schedule(UInt64(mNextCloudOnset), grain);
+        // the jittered share of each gap is exponential, so the mean stays the density's
+        mNextCloudOnset += interval * ((1. - mCloud.mJitter) - mCloud.mJitter * std::log(1. - Random()));
+    }
+}
+
+void GrainScheduler::StartDue(UInt64 inEnd)
+{
+    if (mNumPending == 0)
+        return;
+    // a request further ahead than the block shares a slot with it only a whole turn later, and stays
+    const UInt64 firstSlot = mClock / kGrainWheelSlotFrames;
+    const UInt64 lastSlot = std::min((inEnd - 1) / kGrainWheelSlotFrames, firstSlot + kGrainWheelSlots - 1);
+    for (UInt64 slot = firstSlot; slot <= lastSlot; ++slot) {
+        UInt32 *link = &mWheel[slot % kGrainWheelSlots];
+        while (*link != kNoGrainRequest) {
+            const UInt32 index = *link;
+            Request &request = mRequests[index];
+            if (request.mOnset >= inEnd) {
+                link = &request.mNext;
+                continue;
+            }
+            *link = request.mNext;
+            Start(request.mGrain, SInt32(request.mOnset - mClock));
+            request.mNext = mFreeRequest;
+            mFreeRequest = index;
+            mNumPending--;
+        }
+    }
+}
+
+void GrainScheduler::Start(const GrainParams &inGrain, SInt32 inDelay)
+{
+    if (mNumActive == mPhase.size()) {
+        mNumDropped++;
+        return;
+    }
+    const UInt32 g = mNumActive++;
+    const UInt32 duration = std::min(std::max(inGrain.mDuration, 1U), UInt32(kMaxGrainDuration * mSampleRate) + 1);
+    const UInt32 windowInc = UInt32(std::min(4294967296.0 / duration, 4294967295.0));
+    // the phases as if the grain had started with the block, so the kernels needn't know the delay
+    mPhase[g] = inGrain.mStartPhase - UInt32(inDelay) * inGrain.mIncrement;
+    mIncrement[g] = inGrain.mIncrement;
+    mWindowPhase[g] = 0U - UInt32(inDelay) * windowInc;
+    mWindowIncrement[g] = windowInc;
+    mDelay[g] = inDelay;
+    mRemaining[g] = inDelay + SInt32(duration);
+    mTable[g] = inGrain.mTable;
+    mTableLevel[g] = std::min(inGrain.mTableLevel, kScanTableMaxLevels - 1);
+    mGain[g] = inGrain.mGain;
+}
+
+void GrainScheduler::Move(UInt32 inFrom, UInt32 inTo)
+{
+    mPhase[inTo] = mPhase[inFrom];
+    mIncrement[inTo] = mIncrement[inFrom];
+    mWindowPhase[inTo] = mWindowPhase[inFrom];
+    mWindowIncrement[inTo] = mWindowIncrement[inFrom];
+    mDelay[inTo] = mDelay[inFrom];
+    mRemaining[inTo] = mRemaining[inFrom];
+    mTable[inTo] = mTable[inFrom];
+    mTableLevel[inTo] = mTableLevel[inFrom];
+    mGain[inTo] = mGain[inFrom];
+}
+
+void GrainScheduler::Render(const LidarScanZones &inZones, Float32 inGain, Float32 *ioMono, UInt32 inNumFrames)
+{
+    if (inNumFrames == 0)
+        return;
+    const UInt64 end = mClock + inNumFrames;
+    ScheduleCloud(end);
+    StartDue(end);
+
+    if (mNumActive > 0) {
+        for (UInt32 g = 0; g < mNumActive; ++g) {
+            const LidarScanTable &table = inZones.Table(mTable[g]);
+            mTableData[g] = table.mLevel[table.Level(mTableLevel[g])];
+            mTableBits[g] = table.Bits();
+            mOffset[g] = table.mStats.mMean;
+            mScale[g] = table.mStats.mInverseMean * mGain[g] * inGain;
+        }
+        const GrainBatch batch = { &mPhase[0], &mIncrement[0], &mWindowPhase[0], &mWindowIncrement[0], &mDelay[0],
+                                   &mRemaining[0], &mTableData[0], &mTableBits[0], &mOffset[0], &mScale[0], mNumActive };
+        RenderGrains(batch, ioMono, inNumFrames);
+
+        // a grain that ended in this block makes way for the last, which is looked at next
+        for (UInt32 g = 0; g < mNumActive; ) {
+            mRemaining[g] -= SInt32(inNumFrames);
+            mDelay[g] = std::max(mDelay[g] - SInt32(inNumFrames), SInt32(0));
+            if (mRemaining[g] > 0)
+                ++g;
+            else
+                Move(--mNumActive, g);
+        }
+    }
+    mClock = end;
+}
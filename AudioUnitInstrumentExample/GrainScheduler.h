@@ -0,0 +1,178 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Pooled granular voices over the scan tables, scheduled on a timing wheel
+ */
+
+#ifndef __GrainScheduler_h__
+#define __GrainScheduler_h__
+
+#include "ScanZones.h"
+#include <vector>
+
+static const UInt32 kMaxGrains = 16384;				// the pool SinSynth allocates
+static const Float32 kMaxGrainDensity = 100000.f;	// onsets per second
+static const Float32 kMinGrainDuration = 0.001f;	// seconds
+static const Float32 kMaxGrainDuration = 1.f;
+static const UInt32 kGrainWindowBits = 12;			// entries of the window table, as a power of 2
+static const UInt32 kGrainWheelSlots = 256;
+static const UInt32 kGrainWheelSlotFrames = 32;		// so the wheel reaches 8192 frames ahead
+
+// a stream of grains, as kAudioUnitCustomProperty_GrainCloud sets it
+struct GrainCloudSettings
+{
+    Float32			mDensity;		// onsets per second, 0 for none
+    Float32			mDuration;		// seconds of each grain
+    Float32			mFrequency;		// Hz: a grain reads the table as a voice at this pitch would
+    Float32			mPosition;		// 0 to 1, where around the table the grains start reading
+    Float32			mSpread;		// 0 to 1 of the table the starts are scattered over, about mPosition
+    Float32			mJitter;		// 0 spaces the onsets evenly, 1 makes them a Poisson stream
+    Float32			mLevel;			// each grain's peak, 0 to 1
+    UInt32			mTable;			// of the LidarScanZones bundle; kFullScanTable for the whole scan
+
+    GrainCloudSettings();		// no grains: a density of 0
+
+    bool			IsValid() const
+    {
+        return mDensity >= 0.f && mDensity <= kMaxGrainDensity
+            && mDuration >= kMinGrainDuration && mDuration <= kMaxGrainDuration
+            && mFrequency > 0.f && mFrequency <= 20000.f
+            && mPosition >= 0.f && mPosition <= 1.f && mSpread >= 0.f && mSpread <= 1.f
+            && mJitter >= 0.f && mJitter <= 1.f && mLevel >= 0.f && mLevel <= 1.f
+            && mTable <= kMaxScanZones;
+    }
+};
+
+// one grain, as Schedule() takes it
+struct GrainParams
+{
+    UInt32			mTable;			// of the LidarScanZones bundle
+    UInt32			mTableLevel;	// mip-map level of the largest table, for the pitch (see ScanTableLevelForFrequency)
+    UInt32			mStartPhase;	// where in the table it starts, as a fraction of 2^32
+    UInt32			mIncrement;		// phase advance a frame (see WavetablePhaseIncrement)
+    UInt32			mDuration;		// frames, at least 1
+    Float32			mGain;
+};
+
+// what the kernels read of the sounding grains for one block: one array per field, grain i in
+// entry i of each; the kernel advances both phases of every grain by the block
+struct GrainBatch
+{
+    UInt32 *				mPhase;
+    const UInt32 *			mIncrement;
+    UInt32 *				mWindowPhase;
+    const UInt32 *			mWindowIncrement;
+    const SInt32 *			mDelay;			// frames into the block before the grain starts
+    const SInt32 *			mRemaining;		// frames from the block's start to the grain's end
+    const Float32 *const *	mTable;			// the grain's level of its table
+    const UInt32 *			mTableBits;		// of each grain's table, 1 << bits entries
+    const Float32 *			mOffset;		// subtracted from each table value (the scan mean)
+    const Float32 *			mScale;			// applied after the offset (inverse mean times gain)
+    UInt32					mNumGrains;
+};
+
+/*
+ Accumulates inNumFrames of every grain of inBatch into ioMono. Each grain reads its table with
+ linear interpolation at its phase, wrapping around the circle, and is shaped by the window table
+ (a Hann window of 1 << kGrainWindowBits entries) at its window phase, which runs once from 0 to
+ 2^32 over the grain's duration; outside [mDelay, mRemaining) it adds nothing. RenderGrains() runs
+ a grain's frames four to a vector with SSE2 or NEON, so each grain's table and window are walked
+ in order; it is picked once, at load time. RenderGrainsScalar() is the reference.
+ */
+typedef void (*GrainKernel)(const GrainBatch &, Float32 *, UInt32);
+
+void RenderGrains(const GrainBatch &inBatch, Float32 *ioMono, UInt32 inNumFrames);
+void RenderGrainsScalar(const GrainBatch &inBatch, Float32 *ioMono, UInt32 inNumFrames);
+
+/*
+ GrainScheduler plays thousands of short grains a second without a SynthNote apiece: starting one
+ is a handful of stores into a preallocated pool, and the sounding grains render together in one
+ batch per block.
+
+ The pool holds one array per field, and grains 0 to NumActive() - 1 are the sounding ones; a grain
+ that ends is replaced by the last, so the batch never has holes. Onsets wait on a timing wheel of
+ kGrainWheelSlots slots of kGrainWheelSlotFrames frames each: Schedule() links a request into the
+ slot of its onset, and Render() visits only the slots its block covers, so an onset costs the same
+ however many are pending. The requests come from a pool of their own. A request past the wheel's
+ reach, or one that finds either pool full, is dropped and counted.
+
+ SetCloud() makes the scheduler its own source: onsets at the cloud's density, evenly spaced or
+ scattered, each grain reading from a random start within the spread. The scatter comes from a
+ seeded generator, so a cloud plays the same grains every time from Reset().
+
+ Resize() allocates and must only be called off the render thread, while the AU is uninitialized.
+ Everything else belongs to the render thread.
+ */
+class GrainScheduler
+{
+public:
+    GrainScheduler();
+
+    void					Resize(UInt32 inMaxGrains, Float64 inSampleRate);
+    // silences every grain, drops every pending onset and restarts the clock and the cloud
+    void					Reset();
+
+    void					SetCloud(const GrainCloudSettings &inCloud);
+
+    // the grain starts at frame inOnset of the clock, or with the next block if that has passed
+    bool					Schedule(UInt64 inOnset, const GrainParams &inGrain);
+
+    UInt64					Clock() const { return mClock; }		// frames rendered since Reset()
+    UInt32					NumActive() const { return mNumActive; }
+    UInt64					NumDropped() const { return mNumDropped; }
+    // false once nothing is sounding, waiting or about to be started by the cloud
+    bool					IsSounding() const { return mNumActive > 0 || mNumPending > 0 || mCloud.mDensity > 0.f; }
+
+    // starts the grains due in the next inNumFrames, then accumulates every sounding grain into
+    // ioMono, each from its table of inZones, scaled by inGain
+    void					Render(const LidarScanZones &inZones, Float32 inGain, Float32 *ioMono, UInt32 inNumFrames);
+
+private:
+    GrainScheduler(const GrainScheduler &);
+    GrainScheduler & operator=(const GrainScheduler &);
+
+    struct Request
+    {
+        UInt64				mOnset;
+        GrainParams			mGrain;
+        UInt32				mNext;			// in its slot's list, or in the free list
+    };
+
+    void					ScheduleCloud(UInt64 inEnd);
+    void					StartDue(UInt64 inEnd);
+    void					Start(const GrainParams &inGrain, SInt32 inDelay);
+    void					Move(UInt32 inFrom, UInt32 inTo);
+    Float64					Random();		// uniform in [0, 1)
+
+    Float64					mSampleRate;
+    UInt64					mClock;
+    UInt64					mNumDropped;
+
+    UInt32					mNumActive;
+    std::vector<UInt32>		mPhase;
+    std::vector<UInt32>		mIncrement;
+    std::vector<UInt32>		mWindowPhase;
+    std::vector<UInt32>		mWindowIncrement;
+    std::vector<SInt32>		mDelay;
+    std::vector<SInt32>		mRemaining;
+    std::vector<UInt32>		mTable;
+    std::vector<UInt32>		mTableLevel;
+    std::vector<Float32>	mGain;
+    std::vector<const Float32 *> mTableData;	// looked up for each block, as the scan may have changed
+    std::vector<UInt32>		mTableBits;
+    std::vector<Float32>	mOffset;
+    std::vector<Float32>	mScale;
+
+    std::vector<Request>	mRequests;
+    UInt32					mWheel[kGrainWheelSlots];	// the first request of each slot
+    UInt32					mFreeRequest;
+    UInt32					mNumPending;
+
+    GrainCloudSettings		mCloud;
+    GrainParams				mCloudGrain;	// the cloud's settings at the sample rate; the start varies
+    Float64					mNextCloudOnset;	// frames, on the clock
+    UInt64					mRandom;
+};
+
+#endif
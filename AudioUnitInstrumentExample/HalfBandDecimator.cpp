@@ -0,0 +1,185 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Polyphase half-band FIR decimators that bring oversampled voices back to the output rate
+ */
+
+#include "HalfBandDecimator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define HALF_BAND_X86 1
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define HALF_BAND_NEON 1
+#endif
+
+// tap pairs and Kaiser beta of each stage: at a 48 kHz output, within 0.02 dB to 20 kHz, and 90 dB
+// down on everything that would fold back under 20 kHz
+static const UInt32 kLastStagePairs = 20;
+static const double kLastStageBeta = 9.;
+static const UInt32 kFirstStagePairs = 6;
+static const double kFirstStageBeta = 9.;
+
+// the zeroth-order modified Bessel function of the first kind, for the Kaiser window
+static double BesselI0(double inX)
+{
+    double sum = 1., term = 1., half = inX * 0.5;
+    for (int k = 1; k < 50 && term > sum * 1e-12; ++k) {
+        term *= (half / k) * (half / k);
+        sum += term;
+    }
+    return sum;
+}
+
+void HalfBandDecimator::Prepare(UInt32 inPairs, double inBeta, UInt32 inMaxOutputFrames)
+{
+    mPairs = inPairs;
+    mMaxFrames = inMaxOutputFrames;
+    mEven.assign(2 * mPairs - 1 + mMaxFrames, 0.f);
+    mOdd.assign(mPairs + mMaxFrames, 0.f);
+    mSilentFrames = 4 * mPairs;
+
+    // pair k is the taps 2k + 1 either side of the centre; together they make up the other half of
+    // the DC gain the centre tap's 1/2 leaves
+    const double edge = 2. * mPairs - 1., norm = BesselI0(inBeta);
+    std::vector<double> taps(mPairs);
+    double sum = 0.;
+    for (UInt32 k = 0; k < mPairs; ++k) {
+        double m = 2. * k + 1., ratio = m / edge;
+        double window = BesselI0(inBeta * std::sqrt(std::max(1. - ratio * ratio, 0.))) / norm;
+        taps[k] = std::sin(M_PI * m / 2.) / (M_PI * m) * window;
+        sum += taps[k];
+    }
+    mCoefficients.resize(mPairs);
+    for (UInt32 k = 0; k < mPairs; ++k)
+        mCoefficients[k] = Float32(taps[k] * 0.25 / sum);
+}
+
+// only the history is ever read before it is written
+void HalfBandDecimator::Reset()
+{
+    if (mSilentFrames >= 4 * mPairs) return;
+    std::fill(mEven.begin(), mEven.begin() + (2 * mPairs - 1), 0.f);
+    std::fill(mOdd.begin(), mOdd.begin() + mPairs, 0.f);
+    mSilentFrames = 4 * mPairs;
+}
+
+bool HalfBandDecimator::Process(const Float32 *inInput, Float32 *outOutput, UInt32 inNumFrames)
+{
+    // the history spans 4 * mPairs - 2 input frames
+    if (inInput == NULL) {
+        if (mSilentFrames >= 4 * mPairs)
+            return false;
+        mSilentFrames += 2 * inNumFrames;
+    } else
+        mSilentFrames = 0;
+    for (UInt32 frame = 0; frame < inNumFrames; frame += mMaxFrames) {
+        UInt32 numFrames = std::min(inNumFrames - frame, mMaxFrames);
+        ProcessBlock(inInput ? inInput + 2 * frame : NULL, outOutput + frame, numFrames);
+    }
+    return true;
+}
+
+// out[n] = odd[n - P] / 2 + sum over k of c[k] * (even[n - P + 1 + k] + even[n - P - k]), where
+// even and odd are the input's even and odd samples, each block preceded by its history
+void HalfBandDecimator::ProcessBlock(const Float32 *inInput, Float32 *outOutput, UInt32 inNumFrames)
+{
+    const UInt32 pairs = mPairs, evenHistory = 2 * pairs - 1;
+    Float32 *even = &mEven[evenHistory], *odd = &mOdd[pairs];
+    if (inInput) {
+        for (UInt32 n = 0; n < inNumFrames; ++n) {
+            even[n] = inInput[2 * n];
+            odd[n] = inInput[2 * n + 1];
+        }
+    } else {
+        memset(even, 0, inNumFrames * sizeof(Float32));
+        memset(odd, 0, inNumFrames * sizeof(Float32));
+    }
+
+    const Float32 *c = &mCoefficients[0];
+    const Float32 *centre = odd - pairs;
+    const Float32 *inner = even - pairs + 1, *outer = even - pairs;	// pair k reads inner + k and outer - k
+    UInt32 n = 0;
+#if HALF_BAND_X86
+    for (; n + 4 <= inNumFrames; n += 4) {
+        __m128 sum = _mm_mul_ps(_mm_loadu_ps(centre + n), _mm_set1_ps(0.5f));
+        for (UInt32 k = 0; k < pairs; ++k) {
+            __m128 pair = _mm_add_ps(_mm_loadu_ps(inner + n + k), _mm_loadu_ps(outer + n - k));
+            sum = _mm_add_ps(sum, _mm_mul_ps(pair, _mm_set1_ps(c[k])));
+        }
+        _mm_storeu_ps(outOutput + n, sum);
+    }
+#elif HALF_BAND_NEON
+    for (; n + 4 <= inNumFrames; n += 4) {
+        float32x4_t sum = vmulq_n_f32(vld1q_f32(centre + n), 0.5f);
+        for (UInt32 k = 0; k < pairs; ++k)
+            sum = vmlaq_n_f32(sum, vaddq_f32(vld1q_f32(inner + n + k), vld1q_f32(outer + n - k)), c[k]);
+        vst1q_f32(outOutput + n, sum);
+    }
+#endif
+    for (; n < inNumFrames; ++n) {
+        Float32 sum = centre[n] * 0.5f;
+        for (UInt32 k = 0; k < pairs; ++k)
+            sum += (inner[n + k] + *(outer + n - k)) * c[k];
+        outOutput[n] = sum;
+    }
+
+    // the block's last frames are the next one's history
+    memmove(&mEven[0], &mEven[inNumFrames], evenHistory * sizeof(Float32));
+    memmove(&mOdd[0], &mOdd[inNumFrames], pairs * sizeof(Float32));
+}
+
+void VoiceDecimator::Prepare(UInt32 inFactor, UInt32 inMaxOutputFrames)
+{
+    mFactor = inFactor;
+    mMaxFrames = inMaxOutputFrames;
+    if (mFactor >= 2)
+        mLast.Prepare(kLastStagePairs, kLastStageBeta, mMaxFrames);
+    if (mFactor == 4) {
+        mFirst.Prepare(kFirstStagePairs, kFirstStageBeta, 2 * mMaxFrames);
+        mHalfway.assign(2 * mMaxFrames, 0.f);
+    } else
+        mHalfway.clear();
+}
+
+void VoiceDecimator::Reset()
+{
+    if (mFactor == 4) mFirst.Reset();
+    if (mFactor >= 2) mLast.Reset();
+}
+
+double VoiceDecimator::Latency() const
+{
+    if (mFactor == 4) return mFirst.Latency() / 2. + mLast.Latency();
+    if (mFactor == 2) return mLast.Latency();
+    return 0.;
+}
+
+bool VoiceDecimator::Process(const Float32 *inInput, Float32 *outOutput, UInt32 inNumFrames)
+{
+    if (mFactor == 2)
+        return mLast.Process(inInput, outOutput, inNumFrames);
+    if (mFactor != 4) {
+        if (inInput == NULL) return false;
+        memcpy(outOutput, inInput, inNumFrames * sizeof(Float32));
+        return true;
+    }
+    // in pieces that fit mHalfway
+    bool wrote = false;
+    for (UInt32 frame = 0; frame < inNumFrames; frame += mMaxFrames) {
+        UInt32 numFrames = std::min(inNumFrames - frame, mMaxFrames);
+        const Float32 *halfway = mFirst.Process(inInput ? inInput + 4 * frame : NULL, &mHalfway[0], 2 * numFrames)
+            ? &mHalfway[0] : NULL;
+        if (mLast.Process(halfway, outOutput + frame, numFrames)) {
+            if (!wrote) memset(outOutput, 0, frame * sizeof(Float32));
+            wrote = true;
+        } else if (wrote)
+            memset(outOutput + frame, 0, numFrames * sizeof(Float32));
+    }
+    return wrote;
+}
@@ -0,0 +1,87 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Polyphase half-band FIR decimators that bring oversampled voices back to the output rate
+ */
+
+#ifndef __HalfBandDecimator_h__
+#define __HalfBandDecimator_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <vector>
+
+static const UInt32 kMaxOversampling = 4;
+
+/*
+ HalfBandDecimator halves the sample rate through a linear-phase half-band FIR of 4 * inPairs - 1
+ taps. Every other tap of a half-band filter is zero and the centre one is 1/2, so the polyphase form
+ splits the input into its even and odd samples: the even ones go through a symmetric filter of
+ inPairs tap pairs, each pair one multiply, and the odd ones are only delayed and halved. The
+ filter is a Kaiser-windowed sinc, its band edges symmetric about a quarter of the input rate.
+
+ Process() works out four outputs per step with SSE or NEON, adding each tap pair's two inputs
+ before the multiply. Prepare() allocates; everything else is real-time safe.
+ */
+class HalfBandDecimator
+{
+public:
+    HalfBandDecimator() : mPairs(0), mMaxFrames(0), mSilentFrames(0) {}
+
+    // inBeta sets the Kaiser window: larger trades a wider transition band for a deeper stop band
+    void			Prepare(UInt32 inPairs, double inBeta, UInt32 inMaxOutputFrames);
+    void			Reset();
+
+    // the filter's delay, in output frames
+    double			Latency() const { return (2. * mPairs - 1.) / 2.; }
+
+    // reads 2 * inNumFrames samples of inInput, NULL for silence, and writes inNumFrames to outOutput.
+    // Returns false, without writing, once the input has been silent long enough to empty the filter.
+    bool			Process(const Float32 *inInput, Float32 *outOutput, UInt32 inNumFrames);
+
+private:
+    void			ProcessBlock(const Float32 *inInput, Float32 *outOutput, UInt32 inNumFrames);
+
+    UInt32					mPairs;
+    UInt32					mMaxFrames;
+    UInt32					mSilentFrames;		// input frames of silence since the last signal
+    std::vector<Float32>	mCoefficients;		// of the tap pairs, nearest the centre first
+    std::vector<Float32>	mEven;				// 2 * mPairs - 1 frames of history, then the block
+    std::vector<Float32>	mOdd;				// mPairs frames of history, then the block
+};
+
+/*
+ VoiceDecimator brings a voice mix rendered at 2 or 4 times the output rate back down. Each halving
+ is one HalfBandDecimator: the last, from twice the output rate, keeps the whole audible band and
+ needs a steep filter, while the first of 4x only has to reject what would fold onto the audible band
+ itself, which leaves it a transition band seven times as wide and a filter under a third as long.
+ */
+class VoiceDecimator
+{
+public:
+    VoiceDecimator() : mFactor(1) {}
+
+    // inFactor is 1, 2 or 4; not real-time safe
+    void			Prepare(UInt32 inFactor, UInt32 inMaxOutputFrames);
+    void			Reset();
+
+    UInt32			Factor() const { return mFactor; }
+    double			Latency() const;		// in output frames
+
+    // the same as HalfBandDecimator::Process, from inInput at Factor() times the rate
+    bool			Process(const Float32 *inInput, Float32 *outOutput, UInt32 inNumFrames);
+
+private:
+    UInt32					mFactor;
+    UInt32					mMaxFrames;
+    HalfBandDecimator		mFirst;			// 4x to 2x
+    HalfBandDecimator		mLast;			// 2x to the output rate
+    std::vector<Float32>	mHalfway;		// mFirst's output, at twice the output rate
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Out-of-process owner of the Sweep LiDAR, sharing its scans with every SinSynth on the machine
+ */
+
+/*
+ LidarDaemon runs the LiDAR ingest outside the audio host. It acquires a LidarDeviceHub of its own,
+ which opens the device (or LIDARSYNTH_ENDPOINT, or LIDARSYNTH_REPLAY, as in the AU), bins and
+ mip-maps every scan, and publishes the continuous features on the AULidarModulationBus; each finished
+ table goes into the LidarScanRing with the raw samples it came from. A SinSynth in any process then
+ reads the ring instead of opening the device, so a crash or a slow serial read in the daemon never
+ reaches a render thread, and several hosts can play from one sensor.
+
+ Only one daemon runs at a time: a second one finds the ring owned by a live process and exits. On
+ SIGINT or SIGTERM it stops the device and marks the ring abandoned, and the synths fall back to the
+ device themselves, unless they were told to wait for a daemon with LIDARSYNTH_DAEMON=1.
+
+ Build it as a command line tool from this file, linking libSinSynthEngine.a (the SinSynthEngine
+ target) and SinSynth's LiDAR libraries. It needs nothing from Core Audio beyond its types, so it
+ builds on Linux as well (see the ReadMe). For example:
+
+	LIDARSYNTH_RECORD=/tmp/session.scanlog LidarDaemon
+ */
+
+#include "LidarDeviceHub.h"
+#include "LidarScanRing.h"
+#include "CAHostTimeBase.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+static const int kHeartbeatMilliseconds = 100;
+
+static volatile std::sig_atomic_t sExitRequested = 0;
+
+static void RequestExit(int)
+{
+    sExitRequested = 1;
+}
+
+int main(int argc, const char * argv[])
+{
+    // the daemon's own hub must open the device, not wait for itself, and stop it as soon as it exits
+    setenv("LIDARSYNTH_DAEMON", "0", 1);
+    setenv("LIDARSYNTH_LINGER", "0", 1);
+
+    LidarScanRingWriter ring;
+    if (!ring.Create()) {
+        fprintf(stderr, "LidarDaemon: another daemon is running, or the scan ring cannot be created\n");
+        return 1;
+    }
+
+    signal(SIGINT, RequestExit);
+    signal(SIGTERM, RequestExit);
+
+    LidarDeviceHub *hub = LidarDeviceHub::Acquire();
+    hub->SetScanRing(&ring);
+
+    LidarDeviceState reported = LidarDeviceState(-1);
+    while (!sExitRequested) {
+        LidarDeviceState state = hub->State();
+        ring.SetState(state, CAHostTimeBase::GetCurrentTimeInNanos());
+        if (state != reported) {
+            static const char * const kStateNames[] = { "connecting", "spinning up", "streaming", "failed", "reconnecting" };
+            printf("LidarDaemon: %s\n", kStateNames[state]);
+            fflush(stdout);
+            reported = state;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(kHeartbeatMilliseconds));
+    }
+
+    hub->SetScanRing(NULL);
+    hub->Release();
+    ring.Close();
+    return 0;
+}
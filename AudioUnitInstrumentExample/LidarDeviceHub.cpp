@@ -0,0 +1,1304 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Process-wide owner of the Sweep LiDAR connection
+ */
+
+#include "LidarDeviceHub.h"
+#include "LidarNetworkSource.h"
+#include "LidarTableNetwork.h"
+#include "SynthStatsPublisher.h"
+#include "SyntheticScene.h"
+#include "AURenderTrace.h"
+#include "AUSignpost.h"
+#include "CAHostTimeBase.h"
+#include <sweep/sweep.hpp>
+#include <algorithm>
+#include <glob.h>
+#include <string>
+#include <unistd.h>
+
+#if __APPLE__
+	#include <mach/thread_policy.h>
+	#include <pthread.h>
+#endif
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char * const kLidarDevicePath = "/dev/cu.usbserial-DM00KVQW";
+static const char * const kLidarDevicePattern = "/dev/cu.usbserial-*";
+static const char * const kSyntheticDevicePath = "synthetic";	// a LIDARSYNTH_DEVICES entry scanning the synthetic scene
+static const int kMotorPollMilliseconds = 100;
+static const int kReconnectMinMilliseconds = 250;
+static const int kReconnectMaxMilliseconds = 8000;
+static const int kNetworkPollMilliseconds = 100;
+static const int kDaemonPollMilliseconds = 5;
+static const UInt64 kDaemonReopenNanos = 1000000000ULL;
+static const UInt64 kReplaySliceNanos = 100000000ULL;
+static const int kShutdownTimeoutMilliseconds = 500;
+static const UInt64 kDefaultLingerNanos = 0;
+static const UInt64 kDefaultScanPeriodNanos = 100000000ULL;	// sweep's fastest rotation, until scans are measured
+static const UInt64 kIngestComputationNanos = 2000000ULL;	// to bin, band-limit and publish one scan
+static const UInt64 kPolicyRetuneScans = 16;			// measured before the period follows the scan rate
+static const Float64 kPolicyRetuneTolerance = 0.25;		// of the period the scan rate may drift before a retune
+static const int kConfigPollMilliseconds = 500;		// between checks of the LIDARSYNTH_CONFIG file
+
+static const char *GetEnvironment(const char *inName)
+{
+    const char *value = getenv(inName);
+    return (value && *value) ? value : NULL;
+}
+
+std::mutex LidarDeviceHub::sHubMutex;
+LidarDeviceHub *LidarDeviceHub::sHub = NULL;
+std::atomic<int> LidarDeviceHub::sOrphanCount(0);
+
+LidarDeviceHub *LidarDeviceHub::Acquire()
+{
+    std::lock_guard<std::mutex> lock(sHubMutex);
+    if (sHub == NULL) {
+        sHub = new LidarDeviceHub;
+        sHub->Start();
+    }
+    // an instance back within the grace period picks up the running stream
+    sHub->mLingerDeadline = 0;
+    sHub->mRefCount++;
+    return sHub;
+}
+
+void LidarDeviceHub::Release()
+{
+    // an offline hub is its instance's alone, with no thread to stop
+    if (mOffline) {
+        delete this;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(sHubMutex);
+    if (--mRefCount == 0) {
+        // keep the device scanning for a while in case an instance comes back; Running() ends it.
+        // A thread that has already given up has nothing to keep going.
+        bool threadDone;
+        {
+            std::lock_guard<std::mutex> exitLock(mExitMutex);
+            threadDone = mThreadDone;
+        }
+        if (mLingerNanos > 0 && !threadDone) {
+            mLingerDeadline = CAHostTimeBase::GetCurrentTimeInNanos() + mLingerNanos;
+            return;
+        }
+        sHub = NULL;
+        // if the ingest thread is stuck in a device read, it deletes the hub itself once it returns
+        if (Stop())
+            delete this;
+    }
+}
+
+LidarDeviceHub::LidarDeviceHub()
+: mRefCount(0), mHasTable(false), mScanRing(NULL), mStatsPublisher(NULL), mExitFlag(false), mLingerNanos(kDefaultLingerNanos), mLingerDeadline(0),
+  mThreadDone(false), mOrphaned(false), mState(kLidarState_Connecting), mSettingsGeneration(0), mTableBits(kScanTableDefaultBits),
+  mConfigExit(false), mConfigSize(0), mConfigInode(0), mConfigGeneration(0), mIntervalSquares(0.), mLastArrival(0),
+  mNumFusedDevices(0), mConfigApplied(0), mTableBitsApplied(kScanTableDefaultBits), mPublishedLevel(1U << kScanTableDefaultBits), mHasPublishedLevel(false), mZonesBuilt(false), mRealTime(false), mPolicyPeriod(0), mTablePublisher(NULL), mScanPublisher(NULL),
+  mOffline(false), mOfflineFirstCapture(0), mOfflinePassStart(0), mOfflinePassNanos(0)
+{
+    // the device, the filter and the change threshold start out from the environment; a
+    // LIDARSYNTH_CONFIG file read by the ingest thread may change them later
+    mConfig.ReadEnvironment();
+    mSettings = mConfig.mDevice;
+    mFileConfig = mPendingConfig = mConfig;
+    mConfig.ConfigureFilter(mFilter);
+    memset(&mConfigModified, 0, sizeof(mConfigModified));
+
+    // sweep scans top out at roughly a thousand samples; keep the SoA scratch from growing per scan
+    mAngles.reserve(kScanTelemetryMaxSamples);
+    mDistances.reserve(kScanTelemetryMaxSamples);
+    mSignalStrengths.reserve(kScanTelemetryMaxSamples);
+    mZoneDistances.reserve(kScanTelemetryMaxSamples);
+    mFilter.Reserve(kScanTelemetryMaxSamples);
+}
+
+LidarDeviceHub::~LidarDeviceHub()
+{
+    delete mStatsPublisher;
+}
+
+LidarDeviceHub *LidarDeviceHub::CreateOffline()
+{
+    const char *replayPath = GetEnvironment("LIDARSYNTH_REPLAY");
+    if (replayPath == NULL)
+        return NULL;
+    LidarDeviceHub *hub = new LidarDeviceHub;
+    hub->mOffline = true;
+    hub->mRefCount = 1;
+    ScanLogReader &log = hub->mOfflineLog;
+    if (!log.Open(replayPath) || !log.Next(hub->mOfflineNext)) {
+        fprintf(stderr, "LidarDeviceHub: %s holds no scans\n", replayPath);
+        delete hub;
+        return NULL;
+    }
+
+    // a pass runs from the log's first scan to one mean interval past its last, so that the loop
+    // keeps the scan rate
+    UInt64 firstCapture, lastCapture, numScans;
+    log.GetSpan(firstCapture, lastCapture, numScans);
+    firstCapture = hub->mOfflineNext.mCaptureTime;
+    lastCapture = std::max(lastCapture, firstCapture);
+    const UInt64 span = lastCapture - firstCapture;
+    const UInt64 interval = numScans > 1 ? span / (numScans - 1) : 0;
+    hub->mOfflinePassNanos = span + (interval > 0 ? interval : kDefaultScanPeriodNanos);
+    hub->mOfflineFirstCapture = firstCapture;
+    hub->mOfflinePassStart = kOfflineClockStart;
+    hub->mState = kLidarState_Streaming;
+    return hub;
+}
+
+void LidarDeviceHub::RenderOffline(UInt64 inRenderNanos)
+{
+    for (;;) {
+        const UInt64 capture = mOfflineNext.mCaptureTime;
+        const UInt64 due = mOfflinePassStart + (capture > mOfflineFirstCapture ? capture - mOfflineFirstCapture : 0);
+        if (due > inRenderNanos)
+            return;
+        ProcessScan(due, mOfflineNext.mAngle, mOfflineNext.mDistance, mOfflineNext.mSignalStrength, mOfflineNext.mNumSamples);
+        if (!mOfflineLog.Next(mOfflineNext)) {
+            mOfflineLog.Rewind();
+            mOfflineLog.Next(mOfflineNext);
+            mOfflinePassStart += mOfflinePassNanos;
+        }
+    }
+}
+
+void LidarDeviceHub::AddSubscriber(LidarScanSnapshot *inSnapshot, const ScanZoneMap &inZones)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    Subscriber subscriber = { inSnapshot, inZones };
+    mSubscribers.push_back(subscriber);
+    // a late subscriber starts from the current scan instead of waiting for the next one
+    if (mHasTable) {
+        LidarScanZones &zones = inSnapshot->WriteBuffer();
+        zones.mNumTables = 1;
+        zones.mTables[kFullScanTable] = mLastTable;
+        zones.mObjects = mLastObjects;
+        zones.mZoneMap = SubscriberZones(subscriber);
+        inSnapshot->Publish();
+    }
+}
+
+bool LidarDeviceHub::HasTable()
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    return mHasTable;
+}
+
+bool LidarDeviceHub::CopyLastTable(LidarScanTable &outTable)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    if (!mHasTable)
+        return false;
+    outTable = mLastTable;
+    return true;
+}
+
+bool LidarDeviceHub::SeedTable(const LidarScanTable &inTable)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    if (mHasTable)
+        return false;
+    mLastTable = inTable;
+    mLastTable.mCaptureTime = kCachedScanCaptureTime;
+    mHasTable = true;
+    for (const Subscriber &subscriber : mSubscribers) {
+        LidarScanZones &zones = subscriber.mSnapshot->WriteBuffer();
+        zones.mNumTables = 1;
+        zones.mTables[kFullScanTable] = mLastTable;
+        zones.mObjects = mLastObjects;
+        zones.mZoneMap = SubscriberZones(subscriber);
+        subscriber.mSnapshot->Publish();
+    }
+    return true;
+}
+
+void LidarDeviceHub::GetConfigZones(ScanZoneMap &outZones)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    outZones = mConfigZones;
+}
+
+void LidarDeviceHub::SetSubscriberZones(LidarScanSnapshot *inSnapshot, const ScanZoneMap &inZones)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    for (Subscriber &subscriber : mSubscribers)
+        if (subscriber.mSnapshot == inSnapshot)
+            subscriber.mZones = inZones;
+}
+
+void LidarDeviceHub::RemoveSubscriber(LidarScanSnapshot *inSnapshot)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    mSubscribers.erase(std::remove_if(mSubscribers.begin(), mSubscribers.end(),
+                                      [inSnapshot](const Subscriber &s) { return s.mSnapshot == inSnapshot; }),
+                       mSubscribers.end());
+}
+
+// a scan's events go in together or not at all, so a subscriber never sees half of a change
+static bool WriteFeatureEvents(ScanFeatureQueue &inQueue, const ScanFeatureEvent *inEvents, UInt32 inNumEvents)
+{
+    if (inNumEvents == 0) return true;
+    if (inQueue.WritableItems() < inNumEvents) return false;
+    for (UInt32 i = 0; i < inNumEvents; ++i)
+        *inQueue.WriteItemAt(i) = inEvents[i];
+    inQueue.AdvanceWritePtr(inNumEvents);
+    return true;
+}
+
+void LidarDeviceHub::AddFeatureSubscriber(ScanFeatureQueue *inQueue)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    // without this a held zone note would never be started for the new subscriber
+    ScanFeatureEvent events[kMaxScanFeatureEvents];
+    UInt32 numEvents = mFeatures.CurrentState(CAHostTimeBase::GetCurrentTimeInNanos(), events);
+    FeatureSubscriber subscriber = { inQueue, !WriteFeatureEvents(*inQueue, events, numEvents) };
+    mFeatureSubscribers.push_back(subscriber);
+}
+
+void LidarDeviceHub::RemoveFeatureSubscriber(ScanFeatureQueue *inQueue)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    mFeatureSubscribers.erase(std::remove_if(mFeatureSubscribers.begin(), mFeatureSubscribers.end(),
+                                             [inQueue](const FeatureSubscriber &s) { return s.mQueue == inQueue; }),
+                              mFeatureSubscribers.end());
+}
+
+void LidarDeviceHub::AddSequencer(ScanSequencer *inSequencer)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    mSequencers.push_back(inSequencer);
+}
+
+void LidarDeviceHub::RemoveSequencer(ScanSequencer *inSequencer)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    mSequencers.erase(std::remove(mSequencers.begin(), mSequencers.end(), inSequencer), mSequencers.end());
+}
+
+void LidarDeviceHub::SetScanRing(LidarScanRingWriter *inRing)
+{
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    mScanRing = inRing;
+}
+
+void LidarDeviceHub::AddStatsSource(SynthStatsSource *inSource)
+{
+    if (mStatsPublisher)
+        mStatsPublisher->AddSource(inSource);
+}
+
+void LidarDeviceHub::RemoveStatsSource(SynthStatsSource *inSource)
+{
+    if (mStatsPublisher)
+        mStatsPublisher->RemoveSource(inSource);
+}
+
+void LidarDeviceHub::SetDeviceSettings(const LidarDeviceSettings &inSettings)
+{
+    std::lock_guard<std::mutex> lock(mSettingsMutex);
+    mSettings = inSettings;
+    mSettingsGeneration++;
+}
+
+void LidarDeviceHub::GetDeviceSettings(LidarDeviceSettings &outSettings)
+{
+    std::lock_guard<std::mutex> lock(mSettingsMutex);
+    outSettings = mSettings;
+}
+
+void LidarDeviceHub::SetTableBits(UInt32 inBits)
+{
+    mTableBits.store(std::min(std::max(inBits, kScanTableMinBits), kScanTableMaxBits), std::memory_order_relaxed);
+}
+
+// the generation the copy belongs to
+UInt32 LidarDeviceHub::CopyDeviceSettings(LidarDeviceSettings &outSettings)
+{
+    std::lock_guard<std::mutex> lock(mSettingsMutex);
+    outSettings = mSettings;
+    return mSettingsGeneration.load();
+}
+
+void LidarDeviceHub::GetIngestStatistics(LidarIngestStatistics &outStatistics)
+{
+    std::lock_guard<std::mutex> lock(mStatisticsMutex);
+    outStatistics = mStatistics;
+}
+
+void LidarDeviceHub::ResetIngestStatistics()
+{
+    std::lock_guard<std::mutex> lock(mStatisticsMutex);
+    UInt32 timeConstraint = mStatistics.mTimeConstraint, affinityTag = mStatistics.mAffinityTag;
+    memset(&mStatistics, 0, sizeof(mStatistics));
+    mStatistics.mTimeConstraint = timeConstraint;
+    mStatistics.mAffinityTag = affinityTag;
+    mIntervalSquares = 0.;
+    mLastArrival = 0;
+}
+
+void LidarDeviceHub::Start()
+{
+    // without the bus the other units just don't get modulated
+    if (!mModulationBus.Open())
+        fprintf(stderr, "LidarDeviceHub: could not open the modulation bus\n");
+
+    // the first subscriber plays the last session's scan until this one's device is streaming
+    if (mCache.Load(mLastTable))
+        mHasTable = true;
+
+    // LIDARSYNTH_LINGER: seconds the device keeps scanning after the last Release()
+    if (const char *linger = getenv("LIDARSYNTH_LINGER"))
+        mLingerNanos = UInt64(std::max(atof(linger), 0.) * 1e9);
+
+    // like the table publisher, only one process on the machine can bind the port
+    if (const char *statsEndpoint = GetEnvironment("LIDARSYNTH_PUBLISH_STATS")) {
+        const char *interval = GetEnvironment("LIDARSYNTH_STATS_INTERVAL");
+        try {
+            mStatsPublisher = new SynthStatsPublisher(statsEndpoint, interval ? atof(interval) : kDefaultSynthStatsInterval, *this);
+        } catch (const zmq::error_t &e) {
+            fprintf(stderr, "LidarDeviceHub: %s: %s\n", statsEndpoint, e.what());
+        }
+    }
+
+    // every instance's render trace dumps there, and all of them at once on the signal
+    if (const char *traceDirectory = GetEnvironment("LIDARSYNTH_TRACE_DIR"))
+        AURenderTrace::SetDumpDirectory(traceDirectory);
+    if (const char *traceSignal = GetEnvironment("LIDARSYNTH_TRACE_SIGNAL")) {
+        int signal = strcmp(traceSignal, "USR2") == 0 ? SIGUSR2 : SIGUSR1;
+        if (!AURenderTrace::DumpAllOnSignal(signal))
+            fprintf(stderr, "LidarDeviceHub: could not install the trace signal handler\n");
+    }
+
+    mExitFlag = false;
+    mState = kLidarState_Connecting;
+    mThread = std::thread(&LidarDeviceHub::IngestThread, this);
+}
+
+bool LidarDeviceHub::Stop()
+{
+    mExitFlag = true;
+
+    // nobody may be published to once Stop() has returned
+    {
+        std::lock_guard<std::mutex> lock(mSubscriberMutex);
+        mSubscribers.clear();
+        mFeatureSubscribers.clear();
+        mSequencers.clear();
+    }
+    if (mStatsPublisher)
+        mStatsPublisher->RemoveAllSources();
+
+    // every source loop checks mExitFlag at least every kMotorPollMilliseconds, except while a
+    // blocking sweep::get_scan() is in flight, which returns after at most one rotation.
+    std::unique_lock<std::mutex> lock(mExitMutex);
+    if (mExitCondition.wait_for(lock, std::chrono::milliseconds(kShutdownTimeoutMilliseconds), [this]{ return mThreadDone; })) {
+        lock.unlock();
+        mThread.join();
+        return true;
+    }
+
+    // don't hold up the host; let the thread finish the read, stop the motor and clean up after itself
+    fprintf(stderr, "LidarDeviceHub: ingest thread still busy after %d ms, detaching it\n", kShutdownTimeoutMilliseconds);
+    mOrphaned = true;
+    sOrphanCount++;
+    mThread.detach();
+    return false;
+}
+
+void LidarDeviceHub::ThreadDone()
+{
+    bool orphaned;
+    {
+        std::lock_guard<std::mutex> lock(mExitMutex);
+        mThreadDone = true;
+        orphaned = mOrphaned;
+        mExitCondition.notify_all();
+    }
+    if (orphaned) {
+        delete this;
+        sOrphanCount--;
+    }
+}
+
+// false once the ingest thread is to finish: Stop() was called, or the hub has gone unused for its
+// grace period, in which case it is retired here
+bool LidarDeviceHub::Running()
+{
+    UInt64 deadline = mLingerDeadline.load(std::memory_order_relaxed);
+    if (deadline != 0 && !mExitFlag && CAHostTimeBase::GetCurrentTimeInNanos() >= deadline)
+        Expire();
+    return !mExitFlag;
+}
+
+void LidarDeviceHub::Expire()
+{
+    // Acquire() holds the lock while it clears the deadline; if it is busy, the next poll tries again.
+    // The fusion workers poll too, so another thread may have retired the hub meanwhile.
+    std::unique_lock<std::mutex> lock(sHubMutex, std::try_to_lock);
+    if (!lock.owns_lock() || mRefCount != 0 || mLingerDeadline == 0 || mExitFlag)
+        return;
+    sHub = NULL;
+    mExitFlag = true;
+    // nobody is left to join the thread; like an orphaned one, it deletes the hub once it has stopped the motor
+    {
+        std::lock_guard<std::mutex> exitLock(mExitMutex);
+        mOrphaned = true;
+    }
+    sOrphanCount++;
+    mThread.detach();
+}
+
+// a hub that was stopped while its thread was stuck in a read may still hold the serial port
+void LidarDeviceHub::WaitForOrphans()
+{
+    while (sOrphanCount > 0 && !mExitFlag)
+        std::this_thread::sleep_for(std::chrono::milliseconds(kMotorPollMilliseconds));
+}
+
+void LidarDeviceHub::PublishTable(const LidarScanTable &inTable, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                  const std::int32_t *inSignalStrengths, UInt32 inNumSamples)
+{
+    AU_SIGNPOST_INTERVAL("PublishTable");
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    if (mScanRing)
+        mScanRing->Publish(inTable, inAngles, inDistances, inSignalStrengths, inNumSamples);
+    mLastTable = inTable;
+    mLastObjects = mObjectTracker.Objects();
+    mHasTable = true;
+    mZonesBuilt = false;
+    for (const Subscriber &subscriber : mSubscribers) {
+        const ScanZoneMap &map = SubscriberZones(subscriber);
+        LidarScanZones &zones = subscriber.mSnapshot->WriteBuffer();
+        if (map.mNumZones == 0) {
+            zones.mNumTables = 1;
+            zones.mTables[kFullScanTable] = inTable;
+        } else {
+            // instances usually share a map, so its zones are built at most once per scan
+            if (!mZonesBuilt || map != mZonesMap) {
+                BuildZones(map, inTable, inAngles, inDistances, inNumSamples);
+                mZonesMap = map;
+                mZonesBuilt = true;
+            }
+            zones.CopyFrom(mZones);
+        }
+        zones.mObjects = mLastObjects;
+        zones.mZoneMap = map;
+        subscriber.mSnapshot->Publish();
+    }
+}
+
+// fills mZones with the whole-scan table and one table per zone of inZones, each band-limited and
+// with the statistics of its own sector
+void LidarDeviceHub::BuildZones(const ScanZoneMap &inZones, const LidarScanTable &inTable, const std::int32_t *inAngles,
+                                const std::int32_t *inDistances, UInt32 inNumSamples)
+{
+    mZones.mNumTables = 1 + inZones.mNumZones;
+    mZones.mTables[kFullScanTable] = inTable;
+    for (UInt32 z = 0; z < inZones.mNumZones; ++z) {
+        const ScanZone &zone = inZones.mZones[z];
+        LidarScanTable &table = mZones.mTables[1 + z];
+        mBuilder.Begin(zone.mStartAngle, zone.mSpan);
+        mZoneDistances.clear();
+        for (UInt32 i = 0; i < inNumSamples; ++i)
+            if (mBuilder.AddSample(inAngles[i], inDistances[i]))
+                mZoneDistances.push_back(inDistances[i]);
+        // a sector with no returns plays the whole scan rather than falling silent
+        if (!mBuilder.Finish(table)) {
+            table = inTable;
+            continue;
+        }
+        table.mCaptureTime = inTable.mCaptureTime;
+        mMipMap.Build(table);
+        ComputeScanStatistics(mZoneDistances.data(), UInt32(mZoneDistances.size()), kScanMaxDistance, table.mStats);
+    }
+}
+
+// called with mSubscriberMutex held
+void LidarDeviceHub::PublishFeatures(const ScanFeatureEvent *inEvents, UInt32 inNumEvents, UInt64 inCaptureTime)
+{
+    ScanFeatureEvent state[kMaxScanFeatureEvents];
+    UInt32 numState = 0;
+    for (FeatureSubscriber &subscriber : mFeatureSubscribers) {
+        if (!subscriber.mResync) {
+            // the subscriber isn't rendering: it is sent the whole state once it drains its queue
+            subscriber.mResync = !WriteFeatureEvents(*subscriber.mQueue, inEvents, inNumEvents);
+            continue;
+        }
+        // the state after this scan includes its events, and a leave for every zone it may have missed
+        if (numState == 0)
+            numState = mFeatures.CurrentState(inCaptureTime, state, true);
+        subscriber.mResync = !WriteFeatureEvents(*subscriber.mQueue, state, numState);
+    }
+}
+
+// the motor takes a few seconds to settle after power-up or a speed change; scanning before then fails.
+bool LidarDeviceHub::WaitForMotorReady(sweep::sweep &inDevice)
+{
+    while (Running()) {
+        if (inDevice.get_motor_ready())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(kMotorPollMilliseconds));
+    }
+    return false;
+}
+
+// the motor must be ready before either setting is changed, and settles again after a speed change.
+// False if the hub stopped meanwhile.
+bool LidarDeviceHub::ConfigureDevice(sweep::sweep &inDevice, const LidarDeviceSettings &inSettings)
+{
+    mState = kLidarState_SpinningUp;
+    if (!WaitForMotorReady(inDevice))
+        return false;
+    if (inSettings.mMotorSpeed != 0 && inDevice.get_motor_speed() != std::int32_t(inSettings.mMotorSpeed)) {
+        inDevice.set_motor_speed(std::int32_t(inSettings.mMotorSpeed));
+        if (!WaitForMotorReady(inDevice))
+            return false;
+    }
+    if (inSettings.mSampleRate != 0 && inDevice.get_sample_rate() != std::int32_t(inSettings.mSampleRate))
+        inDevice.set_sample_rate(std::int32_t(inSettings.mSampleRate));
+    return true;
+}
+
+// a replugged adapter may come back under another name; empty if there is no port at all
+static std::string FindDevicePath(const LidarDeviceSettings &inSettings)
+{
+    if (inSettings.mDevicePath[0] != 0)
+        return inSettings.mDevicePath;
+    if (const char *path = GetEnvironment("LIDARSYNTH_DEVICE"))
+        return path;
+    if (access(kLidarDevicePath, F_OK) == 0)
+        return kLidarDevicePath;
+    std::string path;
+    glob_t matches;
+    if (glob(kLidarDevicePattern, 0, NULL, &matches) == 0 && matches.gl_pathc > 0)
+        path = matches.gl_pathv[0];
+    globfree(&matches);
+    return path;
+}
+
+// true if the LIDARSYNTH_CONFIG file has changed since it was last read and now parses; its settings
+// are handed over then
+bool LidarDeviceHub::ReloadConfig()
+{
+    // an editor that saves by replacing the file may leave no file for a moment; nothing changes then
+    struct stat info;
+    if (stat(mConfigPath.c_str(), &info) != 0)
+        return false;
+#if __APPLE__
+    const struct timespec &modified = info.st_mtimespec;
+#else
+    const struct timespec &modified = info.st_mtim;
+#endif
+    if (modified.tv_sec == mConfigModified.tv_sec && modified.tv_nsec == mConfigModified.tv_nsec
+        && info.st_size == mConfigSize && info.st_ino == mConfigInode)
+        return false;
+    mConfigModified = modified;
+    mConfigSize = info.st_size;
+    mConfigInode = info.st_ino;
+
+    // a key the file leaves out keeps the environment's value
+    LidarHubConfig config;
+    config.ReadEnvironment();
+    if (!config.ReadFile(mConfigPath.c_str())) {
+        fprintf(stderr, "LidarDeviceHub: %s: keeping the last settings that parsed\n", mConfigPath.c_str());
+        return false;
+    }
+
+    // only what the file changed overrides the device settings, which the property may have set since
+    LidarDeviceSettings settings;
+    GetDeviceSettings(settings);
+    LidarDeviceSettings previous = settings;
+    if (config.mDevice.mMotorSpeed != mFileConfig.mDevice.mMotorSpeed)
+        settings.mMotorSpeed = config.mDevice.mMotorSpeed;
+    if (config.mDevice.mSampleRate != mFileConfig.mDevice.mSampleRate)
+        settings.mSampleRate = config.mDevice.mSampleRate;
+    if (strcmp(config.mDevice.mDevicePath, mFileConfig.mDevice.mDevicePath) != 0)
+        strcpy(settings.mDevicePath, config.mDevice.mDevicePath);
+    if (settings != previous)
+        SetDeviceSettings(settings);
+    mFileConfig = config;
+
+    std::lock_guard<std::mutex> lock(mConfigMutex);
+    mPendingConfig = config;
+    mConfigGeneration++;
+    return true;
+}
+
+// watcher thread, until the ingest thread finishes; a stat() every kConfigPollMilliseconds is all it costs
+void LidarDeviceHub::WatchConfig()
+{
+    while (!mConfigExit) {
+        for (int slept = 0; slept < kConfigPollMilliseconds && !mConfigExit; slept += kMotorPollMilliseconds)
+            std::this_thread::sleep_for(std::chrono::milliseconds(kMotorPollMilliseconds));
+        if (!mConfigExit)
+            ReloadConfig();
+    }
+}
+
+// ingest thread, before a scan: takes the settings the watcher handed over and rebuilds what they change.
+// The device settings have gone to SetDeviceSettings() already.
+void LidarDeviceHub::ApplyConfig()
+{
+    LidarHubConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mConfigMutex);
+        config = mPendingConfig;
+        mConfigApplied = mConfigGeneration.load();
+    }
+    if (!config.SameFilter(mConfig))
+        config.ConfigureFilter(mFilter);
+    if (config.mZones != mConfig.mZones) {
+        {
+            std::lock_guard<std::mutex> lock(mSubscriberMutex);
+            mConfigZones = config.mZones;
+        }
+        // the new zones go out with the next scan, even one too like the last to be published otherwise
+        mHasPublishedLevel = false;
+    }
+    mConfig = config;
+}
+
+// ingest thread, before a scan: sizes the builders for the resolution last set. The tables follow as
+// they are built; the subscribers keep the last one until the first table of the new size replaces it.
+void LidarDeviceHub::ApplyTableBits()
+{
+    mTableBitsApplied = mTableBits.load(std::memory_order_relaxed);
+    mBuilder.SetBits(mTableBitsApplied);
+    mMipMap.SetBits(mTableBitsApplied);
+    mPublishedLevel.assign(size_t(1) << mTableBitsApplied, 0.f);
+    mHasPublishedLevel = false;
+}
+
+// the thread mostly waits for the device; it needs a little of each scan period, but promptly
+void LidarDeviceHub::ApplyThreadPolicy(UInt64 inPeriodNanos)
+{
+    mPolicyPeriod = inPeriodNanos;
+#if __APPLE__
+    thread_time_constraint_policy_data_t policy;
+    policy.period = UInt32(CAHostTimeBase::ConvertFromNanos(inPeriodNanos));
+    policy.computation = UInt32(CAHostTimeBase::ConvertFromNanos(std::min(kIngestComputationNanos, inPeriodNanos / 4)));
+    policy.constraint = UInt32(CAHostTimeBase::ConvertFromNanos(inPeriodNanos / 2));
+    policy.preemptible = true;
+    bool applied = thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                                     (thread_policy_t)&policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+    std::lock_guard<std::mutex> lock(mStatisticsMutex);
+    mStatistics.mTimeConstraint = applied;
+#endif
+}
+
+// ingest thread, once per scan as it arrives
+void LidarDeviceHub::RecordArrival(UInt64 inNowNanos)
+{
+    Float64 meanInterval = 0.;
+    UInt64 numIntervals = 0;
+    {
+        std::lock_guard<std::mutex> lock(mStatisticsMutex);
+        if (mLastArrival != 0 && inNowNanos > mLastArrival) {
+            Float64 interval = Float64(inNowNanos - mLastArrival) * 1.0e-9;
+            numIntervals = mStatistics.mNumScans;	// the first scan since a reset has no interval
+            Float64 delta = interval - mStatistics.mMeanInterval;
+            mStatistics.mMeanInterval += delta / Float64(numIntervals);
+            mIntervalSquares += delta * (interval - mStatistics.mMeanInterval);
+            mStatistics.mIntervalJitter = numIntervals > 1 ? std::sqrt(mIntervalSquares / Float64(numIntervals - 1)) : 0.;
+            mStatistics.mMinInterval = numIntervals > 1 ? std::min(mStatistics.mMinInterval, interval) : interval;
+            mStatistics.mMaxInterval = std::max(mStatistics.mMaxInterval, interval);
+            meanInterval = mStatistics.mMeanInterval;
+        }
+        mLastArrival = inNowNanos;
+        mStatistics.mNumScans++;
+    }
+
+    // the period follows the measured scan rate once there is enough of it to go on
+    if (mRealTime && numIntervals >= kPolicyRetuneScans) {
+        UInt64 period = UInt64(meanInterval * 1.0e9);
+        if (std::fabs(Float64(period) - Float64(mPolicyPeriod)) > kPolicyRetuneTolerance * Float64(mPolicyPeriod))
+            ApplyThreadPolicy(period);
+    }
+}
+
+// false if the hub is to stop before inMilliseconds are up
+bool LidarDeviceHub::SleepWhileRunning(int inMilliseconds)
+{
+    for (int slept = 0; slept < inMilliseconds && Running(); slept += kMotorPollMilliseconds)
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(kMotorPollMilliseconds, inMilliseconds - slept)));
+    return Running();
+}
+
+void LidarDeviceHub::IngestThread()
+{
+    mTelemetry.Open();
+    const char *view = GetEnvironment("LIDARSYNTH_VIEW");
+    if (view == NULL || strcmp(view, "0") != 0)
+        mView.Create();
+
+    const char *realTime = GetEnvironment("LIDARSYNTH_INGEST_REALTIME");
+    mRealTime = realTime != NULL && strcmp(realTime, "0") != 0;
+    if (mRealTime)
+        ApplyThreadPolicy(kDefaultScanPeriodNanos);
+#if __APPLE__
+    if (const char *affinity = GetEnvironment("LIDARSYNTH_INGEST_AFFINITY")) {
+        thread_affinity_policy_data_t policy = { atoi(affinity) };
+        if (thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                              (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS) {
+            std::lock_guard<std::mutex> lock(mStatisticsMutex);
+            mStatistics.mAffinityTag = UInt32(policy.affinity_tag);
+        }
+    }
+#endif
+
+    // the file's settings are in force before the source is opened; from then on a watcher rereads it
+    if (const char *configPath = GetEnvironment("LIDARSYNTH_CONFIG")) {
+        mConfigPath = configPath;
+        ReloadConfig();
+        ApplyConfig();
+        mConfigExit = false;
+        mConfigThread = std::thread(&LidarDeviceHub::WatchConfig, this);
+    }
+
+    // LIDARSYNTH_RECORD_COMPRESS=0 records the uncompressed version 1 layout
+    if (const char *recordPath = GetEnvironment("LIDARSYNTH_RECORD")) {
+        const char *compress = GetEnvironment("LIDARSYNTH_RECORD_COMPRESS");
+        mRecorder.Open(recordPath, compress == NULL || strcmp(compress, "0") != 0);
+    }
+
+    const char *conflate = GetEnvironment("LIDARSYNTH_CONFLATE");
+    bool conflating = conflate != NULL && strcmp(conflate, "0") != 0;
+    if (const char *publishEndpoint = GetEnvironment("LIDARSYNTH_PUBLISH")) {
+        // only one process on the machine can bind the port; the others just don't publish
+        try {
+            mTablePublisher = new LidarTablePublisher(publishEndpoint, conflating);
+        } catch (const zmq::error_t &e) {
+            fprintf(stderr, "LidarDeviceHub: %s: %s\n", publishEndpoint, e.what());
+        }
+    }
+    if (const char *scansEndpoint = GetEnvironment("LIDARSYNTH_PUBLISH_SCANS")) {
+        try {
+            mScanPublisher = new LidarScanPublisher(scansEndpoint);
+        } catch (const zmq::error_t &e) {
+            fprintf(stderr, "LidarDeviceHub: %s: %s\n", scansEndpoint, e.what());
+        }
+    }
+
+    if (const char *replayPath = GetEnvironment("LIDARSYNTH_REPLAY")) {
+        // LIDARSYNTH_REPLAY_SPEED=0 replays as fast as possible; anything else replays in real time
+        const char *speed = GetEnvironment("LIDARSYNTH_REPLAY_SPEED");
+        RunReplay(replayPath, speed == NULL || atof(speed) != 0.);
+    } else if (const char *endpoint = GetEnvironment("LIDARSYNTH_ENDPOINT")) {
+        RunNetwork(endpoint);
+    } else if (const char *tablesEndpoint = GetEnvironment("LIDARSYNTH_TABLES")) {
+        RunTables(tablesEndpoint, conflating);
+    } else if (const char *devices = GetEnvironment("LIDARSYNTH_DEVICES")) {
+        RunFusion(devices);
+    } else if (GetEnvironment("LIDARSYNTH_SYNTHETIC")) {
+        RunSynthetic();
+    } else {
+        // unset: the daemon if one is running, else the device; "0": never the daemon; else only the daemon
+        const char *daemon = GetEnvironment("LIDARSYNTH_DAEMON");
+        LidarScanRingReader ring;
+        if ((daemon && strcmp(daemon, "0") == 0) || !RunDaemon(ring, daemon != NULL))
+            RunDevice();
+    }
+
+    if (mConfigThread.joinable()) {
+        mConfigExit = true;
+        mConfigThread.join();
+    }
+    mCache.Save(mTable, CAHostTimeBase::GetCurrentTimeInNanos(), true);
+    delete mTablePublisher;
+    mTablePublisher = NULL;
+    delete mScanPublisher;
+    mScanPublisher = NULL;
+    mRecorder.Close();
+    mTelemetry.Close();
+    mView.Close();
+    ThreadDone();
+}
+
+// the hub's own device, or with inFused one device of a LIDARSYNTH_DEVICES rig, on its worker thread
+void LidarDeviceHub::RunDevice(FusedDevice *inFused)
+{
+    if (inFused && strcmp(inFused->mPath, kSyntheticDevicePath) == 0) {
+        RunSynthetic(inFused);
+        return;
+    }
+    WaitForOrphans();
+    std::vector<std::int32_t> &angles = inFused ? inFused->mAngles : mAngles;
+    std::vector<std::int32_t> &distances = inFused ? inFused->mDistances : mDistances;
+    std::vector<std::int32_t> &signalStrengths = inFused ? inFused->mSignalStrengths : mSignalStrengths;
+    int backoff = kReconnectMinMilliseconds;
+    bool streamed = false, connected = false;
+    while (Running()) {
+        LidarDeviceSettings settings;
+        UInt32 generation = CopyDeviceSettings(settings);
+        std::string path = inFused ? std::string(inFused->mPath) : FindDevicePath(settings);
+        try {
+            if (path.empty())
+                throw sweep::device_error("no serial port found");
+            sweep::sweep device{path.c_str()};
+            if (!ConfigureDevice(device, settings))
+                return;
+            device.start_scanning();
+            bool reopen = false;
+            while (Running()) {
+                // new settings take effect between two scans; a new port means another device
+                if (mSettingsGeneration.load() != generation) {
+                    LidarDeviceSettings previous = settings;
+                    generation = CopyDeviceSettings(settings);
+                    if (!inFused && strcmp(settings.mDevicePath, previous.mDevicePath) != 0) {
+                        reopen = true;
+                        break;
+                    }
+                    device.stop_scanning();
+                    if (!ConfigureDevice(device, settings))
+                        return;
+                    device.start_scanning();
+                }
+                const sweep::scan scan = device.get_scan();
+                angles.clear();
+                distances.clear();
+                signalStrengths.clear();
+                for (const sweep::sample& sample : scan.samples) {
+                    angles.push_back(sample.angle);
+                    distances.push_back(sample.distance);
+                    signalStrengths.push_back(sample.signal_strength);
+                }
+                if (inFused)
+                    HandOverFusedScan(*inFused, CAHostTimeBase::GetCurrentTimeInNanos());
+                else
+                    ProcessScan(CAHostTimeBase::GetCurrentTimeInNanos(),
+                                angles.data(), distances.data(), signalStrengths.data(), (UInt32)angles.size());
+                // a connection that delivers is healthy again; the next failure starts the backoff over
+                streamed = connected = true;
+                backoff = kReconnectMinMilliseconds;
+            }
+            device.stop_scanning();
+            if (reopen) {
+                mState = kLidarState_Connecting;
+                continue;
+            }
+            return;
+        } catch (const sweep::device_error &e) {
+            fprintf(stderr, "LidarDeviceHub: %s: %s; retrying in %d ms\n", path.empty() ? kLidarDevicePattern : path.c_str(),
+                    e.what(), backoff);
+            if (connected) {
+                std::lock_guard<std::mutex> lock(mStatisticsMutex);
+                mStatistics.mNumReconnects++;
+                connected = false;
+            }
+        }
+        // the subscribers keep playing the last table they were sent
+        mState = streamed ? kLidarState_Reconnecting : kLidarState_Connecting;
+        if (!SleepWhileRunning(backoff))
+            return;
+        backoff = std::min(backoff * 2, kReconnectMaxMilliseconds);
+    }
+}
+
+// LIDARSYNTH_DEVICES: path[@x,y,rotation] entries separated by semicolons; returns how many were taken
+UInt32 LidarDeviceHub::ParseFusedDevices(const char *inDevices)
+{
+    UInt32 numDevices = 0;
+    const char *entry = inDevices;
+    while (*entry != 0 && numDevices < kMaxFusedDevices) {
+        const char *end = strchr(entry, ';');
+        size_t length = end ? size_t(end - entry) : strlen(entry);
+        std::string text(entry, length);
+        entry += end ? length + 1 : length;
+
+        FusedDevice &device = mFusedDevices[numDevices];
+        memset(&device.mPose, 0, sizeof(device.mPose));
+        size_t at = text.find('@');
+        if (at != std::string::npos) {
+            if (sscanf(text.c_str() + at + 1, "%f,%f,%f", &device.mPose.mX, &device.mPose.mY, &device.mPose.mRotation) < 2)
+                fprintf(stderr, "LidarDeviceHub: %s: the pose is x,y[,rotation]\n", text.c_str());
+            text.resize(at);
+        }
+        if (text.empty() || text.size() >= sizeof(device.mPath))
+            continue;
+        strcpy(device.mPath, text.c_str());
+        device.mFilter = mFilter;
+        device.mConfigGeneration = mConfigApplied;
+        device.mAngles.reserve(kScanTelemetryMaxSamples);
+        device.mDistances.reserve(kScanTelemetryMaxSamples);
+        device.mSignalStrengths.reserve(kScanTelemetryMaxSamples);
+        device.mFusedAngles.reserve(kScanTelemetryMaxSamples);
+        device.mFusedDistances.reserve(kScanTelemetryMaxSamples);
+        device.mPendingAngles.reserve(kScanTelemetryMaxSamples);
+        device.mPendingDistances.reserve(kScanTelemetryMaxSamples);
+        device.mPendingCaptureTime = 0;
+        device.mPending = false;
+        numDevices++;
+    }
+    if (*entry != 0)
+        fprintf(stderr, "LidarDeviceHub: only the first %u devices are fused\n", (unsigned)kMaxFusedDevices);
+    return numDevices;
+}
+
+// worker thread: filters the scan just read, brings it into the room's frame and hands it to the fusion thread
+void LidarDeviceHub::HandOverFusedScan(FusedDevice &inFused, UInt64 inCaptureTime)
+{
+    ScanQualityFilter &filter = inFused.mFilter;
+    if (mConfigGeneration.load(std::memory_order_relaxed) != inFused.mConfigGeneration) {
+        std::lock_guard<std::mutex> lock(mConfigMutex);
+        mPendingConfig.ConfigureFilter(filter);
+        inFused.mConfigGeneration = mConfigGeneration.load();
+    }
+    filter.Process(inFused.mAngles.data(), inFused.mDistances.data(), inFused.mSignalStrengths.data(),
+                   UInt32(inFused.mAngles.size()));
+    if (filter.NumRejected() > 0) {
+        std::lock_guard<std::mutex> lock(mStatisticsMutex);
+        mStatistics.mNumRejectedSamples += filter.NumRejected();
+    }
+    inFused.mFusedAngles.resize(filter.NumSamples());
+    inFused.mFusedDistances.resize(filter.NumSamples());
+    inFused.mPose.Transform(filter.Angles(), filter.Distances(), filter.NumSamples(),
+                            inFused.mFusedAngles.data(), inFused.mFusedDistances.data());
+
+    // a scan the fusion thread has not merged yet is replaced by this newer one
+    {
+        std::lock_guard<std::mutex> lock(mFusionMutex);
+        inFused.mPendingAngles.swap(inFused.mFusedAngles);
+        inFused.mPendingDistances.swap(inFused.mFusedDistances);
+        inFused.mPendingCaptureTime = inCaptureTime;
+        inFused.mPending = true;
+    }
+    mFusionCondition.notify_one();
+}
+
+// ingest thread: starts a worker per device, then merges every scan they hand over
+void LidarDeviceHub::RunFusion(const char *inDevices)
+{
+    mNumFusedDevices = ParseFusedDevices(inDevices);
+    if (mNumFusedDevices == 0) {
+        fprintf(stderr, "LidarDeviceHub: LIDARSYNTH_DEVICES names no device\n");
+        mState = kLidarState_Failed;
+        return;
+    }
+    mMergeAngles.reserve(kScanTelemetryMaxSamples);
+    mMergeDistances.reserve(kScanTelemetryMaxSamples);
+    for (UInt32 d = 0; d < mNumFusedDevices; ++d)
+        mFusedDevices[d].mThread = std::thread(&LidarDeviceHub::RunDevice, this, &mFusedDevices[d]);
+
+    auto anyPending = [this] {
+        for (UInt32 d = 0; d < mNumFusedDevices; ++d)
+            if (mFusedDevices[d].mPending)
+                return true;
+        return false;
+    };
+    while (Running()) {
+        {
+            std::unique_lock<std::mutex> lock(mFusionMutex);
+            if (!mFusionCondition.wait_for(lock, std::chrono::milliseconds(kMotorPollMilliseconds), anyPending))
+                continue;
+        }
+        // every scan handed over meanwhile is merged, then the map is processed once
+        UInt64 captureTime = 0;
+        for (UInt32 d = 0; d < mNumFusedDevices; ++d) {
+            FusedDevice &device = mFusedDevices[d];
+            {
+                std::lock_guard<std::mutex> lock(mFusionMutex);
+                if (!device.mPending)
+                    continue;
+                mMergeAngles.swap(device.mPendingAngles);
+                mMergeDistances.swap(device.mPendingDistances);
+                captureTime = std::max(captureTime, device.mPendingCaptureTime);
+                device.mPending = false;
+            }
+            mFusion.Merge(d, mMergeAngles.data(), mMergeDistances.data(), UInt32(mMergeAngles.size()));
+        }
+        if (mFusion.NumSamples() > 0)
+            ProcessScan(captureTime, mFusion.Angles(), mFusion.Distances(), NULL, mFusion.NumSamples(), kScanInput_Fused);
+    }
+
+    // each worker stops its motor after at most one more rotation
+    for (UInt32 d = 0; d < mNumFusedDevices; ++d)
+        mFusedDevices[d].mThread.join();
+}
+
+void LidarDeviceHub::RunNetwork(const char *inEndpoint)
+{
+    try {
+        LidarNetworkSource source(inEndpoint);
+        while (Running()) {
+            if (source.Receive(kNetworkPollMilliseconds))
+                ProcessScan(CAHostTimeBase::GetCurrentTimeInNanos(),
+                            source.Angles(), source.Distances(), source.SignalStrengths(), source.NumSamples());
+        }
+    } catch (const zmq::error_t &e) {
+        fprintf(stderr, "LidarDeviceHub: %s: %s\n", inEndpoint, e.what());
+        mState = kLidarState_Failed;
+    }
+}
+
+void LidarDeviceHub::RunTables(const char *inEndpoint, bool inConflate)
+{
+    try {
+        LidarTableSource source(inEndpoint, inConflate);
+        while (Running()) {
+            if (source.Receive(kNetworkPollMilliseconds, mTable))
+                ProcessScan(CAHostTimeBase::GetCurrentTimeInNanos(),
+                            source.Angles(), source.Distances(), NULL, source.NumSamples(), kScanInput_Table);
+        }
+    } catch (const zmq::error_t &e) {
+        fprintf(stderr, "LidarDeviceHub: %s: %s\n", inEndpoint, e.what());
+        mState = kLidarState_Failed;
+    }
+}
+
+void LidarDeviceHub::RunReplay(const char *inPath, bool inRealTime)
+{
+    ScanLogReader reader;
+    if (!reader.Open(inPath)) {
+        mState = kLidarState_Failed;
+        return;
+    }
+
+    // loop the log so that a recording can stand in for the sensor indefinitely
+    while (Running()) {
+        ScanLogBlock block;
+        UInt64 firstCapture = 0, replayStart = CAHostTimeBase::GetCurrentTimeInNanos();
+        bool first = true, any = false;
+        while (Running() && reader.Next(block)) {
+            if (first) {
+                firstCapture = block.mCaptureTime;
+                first = false;
+            }
+            UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+            if (inRealTime) {
+                UInt64 due = replayStart + (block.mCaptureTime - firstCapture);
+                // sleep in short slices so that Stop() is not held up by a long gap in the log
+                while (Running() && now < due) {
+                    UInt64 wait = std::min<UInt64>(due - now, kReplaySliceNanos);
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+                    now = CAHostTimeBase::GetCurrentTimeInNanos();
+                }
+            }
+            ProcessScan(now, block.mAngle, block.mDistance, block.mSignalStrength, block.mNumSamples);
+            any = true;
+        }
+        if (!any) {
+            fprintf(stderr, "LidarDeviceHub: %s holds no scans\n", inPath);
+            mState = kLidarState_Failed;
+            return;
+        }
+        reader.Rewind();
+    }
+}
+
+// the LIDARSYNTH_SYNTHETIC scene in place of the device, or with inFused in place of one device of a
+// rig, seen from its pose
+void LidarDeviceHub::RunSynthetic(FusedDevice *inFused)
+{
+    SyntheticSceneSettings settings;
+    if (const char *text = GetEnvironment("LIDARSYNTH_SYNTHETIC")) {
+        if (!settings.Parse(text)) {
+            mState = kLidarState_Failed;
+            return;
+        }
+    }
+    std::vector<std::int32_t> &angles = inFused ? inFused->mAngles : mAngles;
+    std::vector<std::int32_t> &distances = inFused ? inFused->mDistances : mDistances;
+    std::vector<std::int32_t> &signalStrengths = inFused ? inFused->mSignalStrengths : mSignalStrengths;
+    SyntheticScene scene(settings, inFused ? inFused->mPose : ScanPose(), inFused ? UInt32(inFused - mFusedDevices) : 0);
+
+    // a scan is due every rotation; a host that falls a whole rotation behind starts counting from
+    // now rather than sending the missed scans in a burst
+    const UInt64 period = UInt64(1e9 / settings.mRotationRate);
+    UInt64 due = CAHostTimeBase::GetCurrentTimeInNanos();
+    while (Running()) {
+        scene.NextScan(angles, distances, signalStrengths);
+        UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+        if (settings.mRealTime) {
+            due += period;
+            if (now > due + period)
+                due = now;
+            while (Running() && now < due) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<UInt64>(due - now, kReplaySliceNanos)));
+                now = CAHostTimeBase::GetCurrentTimeInNanos();
+            }
+        }
+        if (inFused)
+            HandOverFusedScan(*inFused, now);
+        else
+            ProcessScan(now, angles.data(), distances.data(), signalStrengths.data(), UInt32(angles.size()));
+    }
+}
+
+// false if there was no daemon to read from, or it went away, and inWait is false
+bool LidarDeviceHub::RunDaemon(LidarScanRingReader &inRing, bool inWait)
+{
+    UInt64 now = CAHostTimeBase::GetCurrentTimeInNanos();
+    if (!inWait && (!inRing.Open() || !inRing.IsLive(now)))
+        return false;
+
+    // the daemon's scans are copied into the same scratch a device scan would fill
+    mAngles.resize(kLidarScanRingMaxSamples);
+    mDistances.resize(kLidarScanRingMaxSamples);
+    mSignalStrengths.resize(kLidarScanRingMaxSamples);
+    UInt64 lastOpenAttempt = now;
+    while (Running()) {
+        now = CAHostTimeBase::GetCurrentTimeInNanos();
+        if (inRing.IsLive(now)) {
+            mState = LidarDeviceState(inRing.State());
+            UInt32 numSamples;
+            bool hasSignalStrengths;
+            if (inRing.Read(mTable, mAngles.data(), mDistances.data(), mSignalStrengths.data(), numSamples, hasSignalStrengths)) {
+                ProcessScan(mTable.mCaptureTime, mAngles.data(), mDistances.data(),
+                            hasSignalStrengths ? mSignalStrengths.data() : NULL, numSamples, kScanInput_Daemon);
+                continue;
+            }
+        } else if (!inWait) {
+            fprintf(stderr, "LidarDeviceHub: the daemon has stopped, opening the device\n");
+            inRing.Close();
+            return false;
+        } else {
+            // a daemon started later, or restarted, may have rewritten the segment
+            mState = kLidarState_Connecting;
+            if (now - lastOpenAttempt >= kDaemonReopenNanos) {
+                inRing.Close();
+                inRing.Open();
+                lastOpenAttempt = now;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(kDaemonPollMilliseconds));
+    }
+    return true;
+}
+
+void LidarDeviceHub::ProcessScan(UInt64 inCaptureTime, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                 const std::int32_t *inSignalStrengths, UInt32 inNumSamples, ScanInput inInput)
+{
+    AU_SIGNPOST_EVENT("ScanArrival");
+    AU_SIGNPOST_INTERVAL("ProcessScan");
+    RecordArrival(CAHostTimeBase::GetCurrentTimeInNanos());
+    if (mConfigGeneration.load(std::memory_order_relaxed) != mConfigApplied)
+        ApplyConfig();
+    if (mTableBits.load(std::memory_order_relaxed) != mTableBitsApplied)
+        ApplyTableBits();
+    if (mRecorder.IsOpen())
+        mRecorder.Write(inCaptureTime, inAngles, inDistances, inSignalStrengths, inNumSamples);
+    // a remote table's samples stand in for a scan this host never saw; they are not relayed
+    if (mScanPublisher && inInput != kScanInput_Table)
+        mScanPublisher->Send(inAngles, inDistances, inSignalStrengths, inNumSamples);
+
+    // a table of another resolution than this hub's is binned again from the samples that came with it
+    bool rebin = (inInput == kScanInput_Table || inInput == kScanInput_Daemon) && mTable.Bits() != mBuilder.Bits();
+    bool hasTable = true, unchanged = false;
+    if (inInput == kScanInput_Samples || inInput == kScanInput_Fused || rebin) {
+        if (!rebin && mTelemetry.WantsScan(inCaptureTime)) {
+            ScanTelemetrySlot *slot = mTelemetry.BeginScan(inCaptureTime);
+            UInt32 n = std::min(inNumSamples, kScanTelemetryMaxSamples);
+            std::copy(inAngles, inAngles + n, slot->mAngle);
+            std::copy(inDistances, inDistances + n, slot->mDistance);
+            if (inSignalStrengths)
+                std::copy(inSignalStrengths, inSignalStrengths + n, slot->mSignalStrength);
+            else
+                std::fill(slot->mSignalStrength, slot->mSignalStrength + n, 0);
+            mTelemetry.EndScan(slot, n);
+        }
+
+        // the telemetry shows what the sensor sent; from here on every consumer reads the samples
+        // that passed the quality filter, clamped and despiked. The fusion workers have filtered theirs.
+        if (inInput == kScanInput_Samples) {
+            mFilter.Process(inAngles, inDistances, inSignalStrengths, inNumSamples);
+            inAngles = mFilter.Angles();
+            inDistances = mFilter.Distances();
+            inSignalStrengths = mFilter.SignalStrengths();
+            inNumSamples = mFilter.NumSamples();
+            if (mFilter.NumRejected() > 0) {
+                std::lock_guard<std::mutex> lock(mStatisticsMutex);
+                mStatistics.mNumRejectedSamples += mFilter.NumRejected();
+            }
+        }
+
+        // bin the scan by angle and band-limit it per octave; bins the filter emptied are interpolated
+        AU_SIGNPOST_INTERVAL("BuildTable");
+        mBuilder.Begin();
+        mBuilder.AddSamples(inAngles, inDistances, inNumSamples);
+        hasTable = mBuilder.Finish(mTable);
+        // a quiet room sends nearly the same scan over and over; the subscribers keep the table they have
+        // the threshold is given for a table of the default size
+        unchanged = hasTable && mHasPublishedLevel
+            && (UInt64(ScanTableChange(mTable.mLevel[0], mPublishedLevel.data(), mTable.Size())) << kScanTableDefaultBits)
+                < (UInt64(mConfig.mChangeThreshold) << mTable.Bits());
+        if (unchanged) {
+            hasTable = false;
+            std::lock_guard<std::mutex> lock(mStatisticsMutex);
+            mStatistics.mNumUnchangedScans++;
+        } else if (hasTable) {
+            mMipMap.Build(mTable);
+            ComputeScanStatistics(inDistances, inNumSamples, kScanMaxDistance, mTable.mStats);
+            std::copy(mTable.mLevel[0], mTable.mLevel[0] + mTable.Size(), mPublishedLevel.begin());
+            mHasPublishedLevel = true;
+        }
+    } else if (inInput == kScanInput_Table) {
+        // a remote host sends level 0 and the statistics; the other levels are cheaper to rebuild than to send
+        mMipMap.Build(mTable);
+    }
+
+    // the objects go out with the table, so they are tracked first, through the unchanged scans too
+    if (hasTable || unchanged) {
+        mTable.mCaptureTime = inCaptureTime;
+        mObjectTracker.Process(mTable);
+    }
+
+    // publish the whole table at once
+    if (hasTable) {
+        mTable.mCaptureTime = inCaptureTime;
+        PublishTable(mTable, inAngles, inDistances, inSignalStrengths, inNumSamples);
+        if (mTablePublisher)
+            mTablePublisher->Send(mTable);
+        // an offline render's scans are not the room's, and its clock is not the host's
+        if (!mOffline)
+            mCache.Save(mTable, inCaptureTime);
+    }
+
+    // the daemon has run the motion detector and published the modulation bus already
+    if (inInput != kScanInput_Daemon) {
+        if (hasTable || unchanged) {
+            // the background follows the room through the quiet stretches too
+            mTable.mCaptureTime = inCaptureTime;
+            mMotion.Process(mTable);
+            mState = kLidarState_Streaming;
+        }
+        ComputeScanModulation(inAngles, inDistances, inNumSamples, mModulation);
+        mMotion.GetModulation(mModulation);
+        mModulationBus.Publish(inCaptureTime, mModulation);
+    }
+
+    // mTable goes back to the table that was published, which its other levels were built from,
+    // whichever input it came from: a daemon's table binned again can be unchanged too. Binning it
+    // again resized mTable, so nothing of the published table is left in it but the size.
+    if (unchanged && rebin) {
+        std::lock_guard<std::mutex> lock(mSubscriberMutex);
+        mTable = mLastTable;
+        mTable.mCaptureTime = inCaptureTime;
+    } else if (unchanged) {
+        std::copy(mPublishedLevel.begin(), mPublishedLevel.end(), mTable.mLevel[0]);
+    }
+
+    // viewers see the table being played, with the objects of this very scan
+    if (hasTable || unchanged)
+        mView.Publish(mTable, mObjectTracker.Objects(), mState);
+
+    // the sequencers time the rotation by the speed asked of the motor, which takes its own lock
+    LidarDeviceSettings settings;
+    GetDeviceSettings(settings);
+
+    // under the lock, so that a feature subscriber added meanwhile sees each change exactly once
+    std::lock_guard<std::mutex> lock(mSubscriberMutex);
+    UInt32 numEvents = mFeatures.Process(inCaptureTime, inAngles, inDistances, inNumSamples, mFeatureEvents);
+    PublishFeatures(mFeatureEvents, numEvents, inCaptureTime);
+    for (ScanSequencer *sequencer : mSequencers)
+        sequencer->Schedule(inCaptureTime, settings.mMotorSpeed, inAngles, inDistances, inNumSamples);
+}
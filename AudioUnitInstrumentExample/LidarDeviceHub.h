@@ -0,0 +1,443 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Process-wide owner of the Sweep LiDAR connection
+ */
+
+#ifndef __LidarDeviceHub_h__
+#define __LidarDeviceHub_h__
+
+#include "ScanSnapshot.h"
+#include "LidarScanTable.h"
+#include "ScanZones.h"
+#include "LidarHubConfig.h"
+#include "ScanMipMap.h"
+#include "ScanQualityFilter.h"
+#include "ScanFusion.h"
+#include "ScanTelemetry.h"
+#include "ScanLog.h"
+#include "ScanFeatures.h"
+#include "ScanSequencer.h"
+#include "ScanMotion.h"
+#include "ScanObjects.h"
+#include "LidarScanRing.h"
+#include "LidarScanView.h"
+#include "ScanCache.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+namespace sweep { class sweep; }
+class LidarTablePublisher;
+class LidarScanPublisher;
+class SynthStatsPublisher;
+class SynthStatsSource;
+
+// snapshots a subscriber can keep pinned (see SinSynth's freeze parameter) while new scans arrive
+static const UInt32 kScanSnapshotPins = 12;
+
+typedef ScanSnapshotBuffer<LidarScanZones, 4 + kScanSnapshotPins> LidarScanSnapshot;
+
+// connection state of the shared device, advanced by the ingest thread
+enum LidarDeviceState
+{
+    kLidarState_Connecting = 0,		// opening the serial port, or waiting for the first network scan
+    kLidarState_SpinningUp = 1,		// device open, waiting for the motor to stabilize
+    kLidarState_Streaming = 2,		// at least one scan has been published
+    kLidarState_Failed = 3,			// the source could not be opened, or ended, and is not retried
+    kLidarState_Reconnecting = 4	// the device was lost after streaming; the last table plays on while it is reopened
+};
+
+// how regularly scans reach the ingest thread, since the hub started or the statistics were last reset
+struct LidarIngestStatistics
+{
+    UInt64					mNumScans;
+    Float64					mMeanInterval;		// seconds from one scan's arrival to the next
+    Float64					mIntervalJitter;	// standard deviation of those intervals, seconds
+    Float64					mMinInterval;
+    Float64					mMaxInterval;
+    UInt32					mTimeConstraint;	// nonzero while the thread runs under a time-constraint policy
+    UInt32					mAffinityTag;		// the thread's affinity tag, 0 for none
+    UInt64					mNumRejectedSamples;	// dropped by the ScanQualityFilter as too weak or invalid
+    UInt64					mNumUnchangedScans;		// of mNumScans, too close to the last table to be published
+    UInt64					mNumReconnects;			// times a streaming device was lost and had to be reopened
+};
+
+/*
+ All SinSynth instances in a process share one LidarDeviceHub. The first Acquire() creates it, opens
+ the device and starts the ingest thread; Acquire() itself never touches the device, so instantiating
+ a SinSynth stays cheap. Every scan is built into a table once and published to
+ each subscribed snapshot buffer, together with a table of each zone in the subscriber's
+ ScanZoneMap; subscribers with the same map share one build of its zones. A subscriber added or
+ given a new map meanwhile gets the whole-scan table of the last scan straight away and its zones
+ from the next scan on. Until the first scan arrives, that is the last session's table from the
+ ScanCache, if there is one. The last Release() stops the ingest thread, which stops the motor,
+ and destroys the hub, unless LIDARSYNTH_LINGER gives a grace period in seconds: the device then keeps
+ scanning that long after the last Release(), so an instance created again meanwhile (say on a scene
+ change) attaches to the running stream instead of waiting for the motor to spin up, and only then
+ does the ingest thread stop it and delete the hub. Release() waits a bounded time for a stop: if the thread is still inside a
+ blocking device read by then, it is detached and deletes the hub itself once the read returns, and
+ the next hub waits for it before opening the device again.
+
+ The local device is supervised: if it cannot be opened, or a read fails because the cable glitched,
+ the ingest thread closes it, looks for the serial port again (LIDARSYNTH_DEVICE, else the usual
+ path, else any /dev/cu.usbserial-* port) and reopens it, waiting twice as long after each failure
+ up to a few seconds. Meanwhile the state reads kLidarState_Reconnecting once the device had been
+ streaming, and the subscribers keep the last table they were sent; nothing of this reaches the
+ render thread.
+
+ SetDeviceSettings() trades the data rate against how fresh each scan is: a faster motor sends
+ more, sparser scans. The settings start out from LIDARSYNTH_MOTOR_SPEED and LIDARSYNTH_SAMPLE_RATE
+ and are applied by the ingest thread between two scans, which stops scanning, waits for the motor
+ to settle at the new speed and starts again; a new device path reopens the device. They only reach
+ a device this hub opens itself, not one a daemon or another host owns.
+
+ Every scan the hub bins itself first goes through a ScanQualityFilter, set up from
+ LIDARSYNTH_MIN_SIGNAL_STRENGTH and LIDARSYNTH_DESPIKE; the recorder and the scan publisher are
+ handed the raw samples before it.
+
+ A scan whose binned table differs from the last one published by less than
+ LIDARSYNTH_CHANGE_THRESHOLD centimetres, summed over the bins (ScanTableChange), is not published:
+ its mip-map, spectra and statistics are not built, the subscribers keep the snapshot they have, so
+ their history and the render thread's cache lines are left alone, and the ingest statistics count
+ it. The motion detector and the features still see every scan. 0 publishes every scan. The
+ threshold is given for a table of the default size and scaled to the one in use.
+
+ SetTableBits() sets the resolution of the tables the hub builds, which SinSynth takes from its
+ kAudioUnitCustomProperty_ScanTableSize: the ingest thread reallocates the builder, the mip-map
+ builder and the tables before its next scan, and the motion detector and object tracker follow the
+ first table of the new size. The hub is shared, so the last resolution set in the process wins.
+ Tables from a daemon or a remote host are played at the resolution they were built at, unless it
+ differs from this one: then the hub bins their samples again.
+
+ LIDARSYNTH_CONFIG names a file of these settings and the zones (see LidarHubConfig) that the hub
+ rereads whenever it changes, so they can be changed while instances play instead of by re-creating
+ one, which would interrupt the audio and spin the motor up again. A watcher thread checks the file
+ twice a second. New device settings go through SetDeviceSettings(), only those the edit changed, so
+ changing the filter does not undo a device set through the property. The rest the ingest thread
+ takes before its next scan, and only what changed is rebuilt. A file that doesn't parse is reported
+ and changes nothing. The file's zones are played by every subscriber without a map of its own; they
+ go out in the snapshot with the tables built for them, published even if the room has not changed,
+ so the render thread never pairs a table with another map's notes. An offline hub does not read
+ the file.
+
+ A room too large for one sensor can be covered by several: LIDARSYNTH_DEVICES lists up to
+ kMaxFusedDevices serial ports, separated by semicolons, each with an optional pose in the room as
+ @x,y,rotation in centimetres and degrees, for example
+ "/dev/cu.usbserial-A;/dev/cu.usbserial-B@450,300,180". Each device then gets a worker thread of its
+ own that opens and supervises it as above, filters each scan and brings it into the room's frame,
+ whose origin is where a single device would stand. The ingest thread becomes the fusion thread: it
+ merges each scan into a ScanFusion map as soon as a worker hands it over, touching only the bins that
+ device covers, and processes the fused map as one scan, so the table, the zones and everything else
+ downstream see the whole room. The device path of SetDeviceSettings() is ignored then, and the state
+ follows whichever device last changed it until the next fused scan.
+
+ The ingest thread runs at the default priority unless LIDARSYNTH_INGEST_REALTIME=1, which puts it
+ under a Mach time-constraint policy whose period follows the scan rate: an estimate to start with,
+ then the measured interval once a few scans have arrived, so that a busy host no longer lets scans
+ pile up in the serial buffer and arrive in bursts. LIDARSYNTH_INGEST_AFFINITY gives it an affinity
+ tag; macOS only takes that as a hint to schedule it apart from threads with other tags, and Apple
+ silicon ignores it. GetIngestStatistics() reports the jitter of the scans' arrival either way.
+
+ When the environment variable LIDARSYNTH_ENDPOINT is set (for example tcp://sensor-host:5555) the
+ hub subscribes to that ZMQ publisher instead of opening the local device; see LidarNetworkSource.
+ LIDARSYNTH_REPLAY names a ScanLog to play back in a loop instead (in real time, or as fast as
+ possible with LIDARSYNTH_REPLAY_SPEED=0), and LIDARSYNTH_RECORD names a ScanLog to record every
+ scan into, whatever the source. Otherwise a running LidarDaemon is preferred to the device: the hub
+ reads the tables it has already built out of its LidarScanRing, so every process on the machine
+ shares one device and one build of each scan. LIDARSYNTH_DAEMON=0 never uses the daemon, and any
+ other value waits for one instead of opening the device. A daemon hands the ring to its own hub
+ with SetScanRing().
+
+ For load tests LIDARSYNTH_SYNTHETIC replaces the device with a SyntheticScene: a room with blobs
+ moving through it, scanned with noise and dropout holes at any rotation rate and scan size, as
+ comma-separated settings such as "rate=100,samples=20000,blobs=8,seed=3" (or 1 for the defaults).
+ Its scans are the same on every run. In a LIDARSYNTH_DEVICES rig an entry named "synthetic" scans
+ the same scene from its pose, so fusion can be loaded as well.
+
+ LIDARSYNTH_PUBLISH_STATS (for example tcp://<host>:5557) has the hub send the process's statistics, its
+ own and those of every instance registered with AddStatsSource(), to a ZMQ publisher every
+ LIDARSYNTH_STATS_INTERVAL seconds; see SynthStatsPublisher.
+
+ Every instance keeps a flight recorder of its last render cycles (see AURenderTrace). The hub points
+ their dumps at LIDARSYNTH_TRACE_DIR, and with LIDARSYNTH_TRACE_SIGNAL=USR1 (or USR2) a kill -USR1 of
+ the host process dumps them all.
+
+ For rigs of several machines, LIDARSYNTH_PUBLISH (for example tcp://<host>:5556) makes the hub send every
+ table it builds to a ZMQ publisher, and LIDARSYNTH_TABLES (tcp://sensor-host:5556) makes a hub on
+ another machine play those tables instead of opening a device; see LidarTableNetwork. With
+ LIDARSYNTH_CONFLATE=1 either side keeps only the newest table queued. Where the other machines need
+ the raw samples, LIDARSYNTH_PUBLISH_SCANS relays every scan to them as compact frames (see
+ ScanFrameCodec.h), which they receive through LIDARSYNTH_ENDPOINT.
+
+ Each subscriber owns its LidarScanSnapshot and is its only consumer, so the single-consumer rule of
+ ScanSnapshotBuffer holds no matter how many instances are open. Feature subscribers get the changes
+ ScanFeatureExtractor finds in each scan the same way, through a ScanFeatureQueue of their own. A
+ scan's events go into a queue all together or not at all; a subscriber whose queue was too full is
+ sent the state of every sector instead, once there is room, so that it never misses a zone leaving. A ScanSequencer added with AddSequencer() is handed
+ every scan too, and predicts from it the notes of the beam's next rotation into a queue of its own.
+ The continuous features of every scan also go out on the process-independent AULidarModulationBus,
+ for units that only need a modulation source, with the motion ScanMotionDetector finds against the
+ room's background.
+
+ Every scan, published or not, also goes through a ScanObjectTracker, and the objects it tracks go
+ out in each subscriber's snapshot with the tables; a scan that is not published leaves the
+ subscribers with the objects of the last one that was.
+
+ Unless LIDARSYNTH_VIEW=0, the hub also offers every processed scan to viewers in other processes
+ through a LidarScanView: level 0 of the table the subscribers play, its statistics and the objects
+ of the same scan, for drawing at display rate without polling any instance. Only one hub on the
+ machine writes it, the first to start; with a daemon running, that is the daemon's.
+ */
+class LidarDeviceHub
+{
+public:
+    static LidarDeviceHub *	Acquire();
+    void					Release();
+
+    // a hub of one instance's own for an offline render: no thread and no device, just the
+    // LIDARSYNTH_REPLAY log, processed by RenderOffline() on the render clock. NULL if the variable is
+    // unset or the log holds no scans.
+    static LidarDeviceHub *	CreateOffline();
+    bool					IsOffline() const { return mOffline; }
+    // processes every scan of the log due by inRenderNanos on the render clock, which starts at
+    // kOfflineClockStart with the log's first scan, and takes it as the scan's capture time; the log
+    // loops, as a replay does
+    void					RenderOffline(UInt64 inRenderNanos);
+
+    // the snapshot must stay alive until RemoveSubscriber() returns.
+    void					AddSubscriber(LidarScanSnapshot *inSnapshot, const ScanZoneMap &inZones = ScanZoneMap());
+    void					SetSubscriberZones(LidarScanSnapshot *inSnapshot, const ScanZoneMap &inZones);
+    void					RemoveSubscriber(LidarScanSnapshot *inSnapshot);
+
+    // the table last sent to the subscribers, for a saved state to carry; false before the first one
+    bool					HasTable();
+    bool					CopyLastTable(LidarScanTable &outTable);
+    // the zones of the LIDARSYNTH_CONFIG file, which subscribers without a map of their own play
+    void					GetConfigZones(ScanZoneMap &outZones);
+    // a table to play until the device's first scan, as the cache's is: sent to every subscriber with
+    // kCachedScanCaptureTime, unless there is a table already, in which case this returns false
+    bool					SeedTable(const LidarScanTable &inTable);
+
+    // likewise the queue; it is sent the current state of every sector straight away.
+    void					AddFeatureSubscriber(ScanFeatureQueue *inQueue);
+    void					RemoveFeatureSubscriber(ScanFeatureQueue *inQueue);
+    // the sequencer must stay alive until RemoveSequencer() returns
+    void					AddSequencer(ScanSequencer *inSequencer);
+    void					RemoveSequencer(ScanSequencer *inSequencer);
+
+    LidarDeviceState		State() const { return mState.load(std::memory_order_relaxed); }
+
+    // every scan is also written to inRing, until this is called again with NULL
+    void					SetScanRing(LidarScanRingWriter *inRing);
+
+    // applied asynchronously; GetDeviceSettings() returns what was last asked for
+    void					SetDeviceSettings(const LidarDeviceSettings &inSettings);
+    void					GetDeviceSettings(LidarDeviceSettings &outSettings);
+
+    // the resolution of the tables built from here on, kScanTableMinBits to kScanTableMaxBits; applied
+    // asynchronously between scans, like the device settings. TableBits() returns what was last asked for.
+    void					SetTableBits(UInt32 inBits);
+    UInt32					TableBits() const { return mTableBits.load(std::memory_order_relaxed); }
+
+    void					GetIngestStatistics(LidarIngestStatistics &outStatistics);
+    void					ResetIngestStatistics();
+
+    // an instance whose statistics go out with LIDARSYNTH_PUBLISH_STATS, if it is set; the source must
+    // stay alive until RemoveStatsSource() returns
+    void					AddStatsSource(SynthStatsSource *inSource);
+    void					RemoveStatsSource(SynthStatsSource *inSource);
+
+private:
+    LidarDeviceHub();
+    ~LidarDeviceHub();
+
+    LidarDeviceHub(const LidarDeviceHub &);
+    LidarDeviceHub & operator=(const LidarDeviceHub &);
+
+    void					Start();
+    bool					Stop();		// true if the ingest thread has exited and been joined
+    bool					Running();
+    void					Expire();
+    void					ThreadDone();
+    void					WaitForOrphans();
+    void					IngestThread();
+    struct FusedDevice;
+    void					RunDevice(FusedDevice *inFused = NULL);
+    void					RunFusion(const char *inDevices);
+    UInt32					ParseFusedDevices(const char *inDevices);
+    void					HandOverFusedScan(FusedDevice &inFused, UInt64 inCaptureTime);
+    void					RunNetwork(const char *inEndpoint);
+    void					RunReplay(const char *inPath, bool inRealTime);
+    void					RunSynthetic(FusedDevice *inFused = NULL);
+    bool					RunDaemon(LidarScanRingReader &inRing, bool inWait);
+    void					RunTables(const char *inEndpoint, bool inConflate);
+
+    // what ProcessScan() is given besides the samples
+    enum ScanInput
+    {
+        kScanInput_Samples = 0,		// only the samples; the table is built from them
+        kScanInput_Table = 1,		// mTable holds the level 0 and statistics of a remote host's table
+        kScanInput_Daemon = 2,		// mTable is complete, and the daemon publishes the modulation bus
+        kScanInput_Fused = 3		// the samples of mFusion, each device's already filtered
+    };
+    void					ProcessScan(UInt64 inCaptureTime, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                        const std::int32_t *inSignalStrengths, UInt32 inNumSamples,
+                                        ScanInput inInput = kScanInput_Samples);
+    void					PublishTable(const LidarScanTable &inTable, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                         const std::int32_t *inSignalStrengths, UInt32 inNumSamples);
+    void					BuildZones(const ScanZoneMap &inZones, const LidarScanTable &inTable, const std::int32_t *inAngles,
+                                       const std::int32_t *inDistances, UInt32 inNumSamples);
+    void					PublishFeatures(const ScanFeatureEvent *inEvents, UInt32 inNumEvents, UInt64 inCaptureTime);
+    bool					WaitForMotorReady(sweep::sweep &inDevice);
+    UInt32					CopyDeviceSettings(LidarDeviceSettings &outSettings);
+    bool					ConfigureDevice(sweep::sweep &inDevice, const LidarDeviceSettings &inSettings);
+    bool					SleepWhileRunning(int inMilliseconds);
+    void					ApplyThreadPolicy(UInt64 inPeriodNanos);
+    bool					ReloadConfig();
+    void					WatchConfig();
+    void					ApplyConfig();
+    void					ApplyTableBits();
+    void					RecordArrival(UInt64 inNowNanos);
+
+    static std::mutex		sHubMutex;		// guards sHub and mRefCount
+    static LidarDeviceHub *	sHub;
+    static std::atomic<int>	sOrphanCount;	// stopped hubs whose threads are still finishing
+    UInt32					mRefCount;
+
+    struct Subscriber
+    {
+        LidarScanSnapshot *	mSnapshot;
+        ScanZoneMap			mZones;
+    };
+    struct FeatureSubscriber
+    {
+        ScanFeatureQueue *	mQueue;
+        bool				mResync;	// events were dropped: send the whole state next
+    };
+    // the map a subscriber plays; called with mSubscriberMutex held
+    const ScanZoneMap &		SubscriberZones(const Subscriber &inSubscriber) const
+    {
+        return inSubscriber.mZones.mNumZones != 0 ? inSubscriber.mZones : mConfigZones;
+    }
+
+    std::mutex				mSubscriberMutex;	// guards the subscriber lists, the last table and objects, mFeatures, mScanRing and mConfigZones
+    std::vector<Subscriber>	mSubscribers;
+    std::vector<FeatureSubscriber> mFeatureSubscribers;
+    std::vector<ScanSequencer *> mSequencers;
+    LidarScanTable			mLastTable;
+    ScanObjectList			mLastObjects;
+    bool					mHasTable;
+    LidarScanRingWriter *	mScanRing;
+    SynthStatsPublisher *	mStatsPublisher;	// NULL unless LIDARSYNTH_PUBLISH_STATS is set
+    ScanZoneMap				mConfigZones;		// played by the subscribers whose mZones is empty
+
+    std::thread				mThread;
+    std::atomic<bool>		mExitFlag;
+    UInt64					mLingerNanos;
+    std::atomic<UInt64>		mLingerDeadline;	// host time at which an unused hub stops, or 0 while in use
+    std::mutex				mExitMutex;		// guards mThreadDone and mOrphaned
+    std::condition_variable	mExitCondition;
+    bool					mThreadDone;
+    bool					mOrphaned;
+    std::atomic<LidarDeviceState> mState;
+
+    std::mutex				mSettingsMutex;		// guards mSettings
+    LidarDeviceSettings		mSettings;
+    std::atomic<UInt32>		mSettingsGeneration;	// counts SetDeviceSettings() calls
+    std::atomic<UInt32>		mTableBits;			// asked for by SetTableBits()
+
+    // the LIDARSYNTH_CONFIG file, watched by mConfigThread once the ingest thread has read it first
+    std::string				mConfigPath;
+    std::thread				mConfigThread;
+    std::atomic<bool>		mConfigExit;
+    struct timespec			mConfigModified;	// of the file last read, with its size and inode
+    off_t					mConfigSize;
+    ino_t					mConfigInode;
+    LidarHubConfig			mFileConfig;		// the file's last valid settings
+    std::mutex				mConfigMutex;		// guards mPendingConfig
+    LidarHubConfig			mPendingConfig;		// for the ingest thread and the fusion workers to take
+    std::atomic<UInt32>		mConfigGeneration;	// counts the settings handed over in mPendingConfig
+
+    std::mutex				mStatisticsMutex;	// guards mStatistics, mIntervalSquares and mLastArrival
+    LidarIngestStatistics	mStatistics;
+    Float64					mIntervalSquares;	// sum of squared deviations from the mean interval (Welford)
+    UInt64					mLastArrival;		// nanoseconds, 0 before the first scan since a reset
+
+    // one device of a LIDARSYNTH_DEVICES rig; all but the pending scan are owned by its worker thread
+    struct FusedDevice
+    {
+        char				mPath[kLidarDevicePathLength];
+        ScanPose			mPose;
+        std::thread			mThread;
+        ScanQualityFilter	mFilter;
+        std::vector<std::int32_t> mAngles;		// as read from the device
+        std::vector<std::int32_t> mDistances;
+        std::vector<std::int32_t> mSignalStrengths;
+        std::vector<std::int32_t> mFusedAngles;	// filtered and in the room's frame
+        std::vector<std::int32_t> mFusedDistances;
+        // guarded by mFusionMutex: the latest scan not yet merged, swapped in from mFusedAngles and mFusedDistances
+        std::vector<std::int32_t> mPendingAngles;
+        std::vector<std::int32_t> mPendingDistances;
+        UInt64				mPendingCaptureTime;
+        bool				mPending;
+        UInt32				mConfigGeneration;	// of the settings mFilter has, owned by the worker
+    };
+
+    std::mutex				mFusionMutex;
+    std::condition_variable	mFusionCondition;	// a worker has handed over a scan
+    FusedDevice				mFusedDevices[kMaxFusedDevices];
+    UInt32					mNumFusedDevices;
+
+    // owned by the ingest thread
+    ScanFusion				mFusion;
+    std::vector<std::int32_t> mMergeAngles;		// a pending scan, swapped out to be merged
+    std::vector<std::int32_t> mMergeDistances;
+    LidarHubConfig			mConfig;			// in force
+    UInt32					mConfigApplied;		// the mConfigGeneration of mConfig
+    ScanQualityFilter		mFilter;
+    UInt32					mTableBitsApplied;	// the mTableBits mBuilder and mMipMap are sized for
+    ScanTableBuilder		mBuilder;
+    std::vector<Float32>	mPublishedLevel;	// level 0 of the last table built from samples and published
+    bool					mHasPublishedLevel;
+    ScanMipMapBuilder		mMipMap;
+    LidarScanTable			mTable;
+    LidarScanZones			mZones;			// built for mZonesMap from the current scan, if mZonesBuilt
+    ScanZoneMap				mZonesMap;
+    bool					mZonesBuilt;
+    std::vector<std::int32_t> mZoneDistances;
+    ScanTelemetryTap		mTelemetry;
+    LidarScanViewWriter		mView;				// not open with LIDARSYNTH_VIEW=0, or while another process has it
+    ScanLogWriter			mRecorder;
+    ScanCache				mCache;
+    bool					mRealTime;			// LIDARSYNTH_INGEST_REALTIME
+    UInt64					mPolicyPeriod;		// nanoseconds, of the time-constraint policy in force
+    LidarTablePublisher *	mTablePublisher;	// NULL unless LIDARSYNTH_PUBLISH is set
+    LidarScanPublisher *	mScanPublisher;		// NULL unless LIDARSYNTH_PUBLISH_SCANS is set
+    ScanFeatureExtractor	mFeatures;
+    ScanFeatureEvent		mFeatureEvents[kMaxScanFeatureEvents];
+    ScanMotionDetector		mMotion;
+    ScanObjectTracker		mObjectTracker;
+    AULidarModulationBus	mModulationBus;
+    Float32					mModulation[kAULidarModulationFeatures];
+    std::vector<std::int32_t> mAngles;
+    std::vector<std::int32_t> mDistances;
+    std::vector<std::int32_t> mSignalStrengths;
+
+    // an offline hub's log, and the next scan of it, due at mOfflinePassStart on the render clock plus
+    // its distance from the first scan of the log
+    bool					mOffline;
+    ScanLogReader			mOfflineLog;
+    ScanLogBlock			mOfflineNext;
+    UInt64					mOfflineFirstCapture;
+    UInt64					mOfflinePassStart;
+    UInt64					mOfflinePassNanos;	// from one pass's first scan to the next's
+};
+
+#endif
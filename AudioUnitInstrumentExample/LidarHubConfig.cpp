@@ -0,0 +1,140 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ The settings of the shared LiDAR device hub, from the environment and a reloadable file
+ */
+
+#include "LidarHubConfig.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+static const UInt32 kDefaultChangeThreshold = 1U << kScanTableDefaultBits;	// 1 cm a bin, about the sensor's noise
+
+static std::string Trim(const std::string &inText)
+{
+    const char *space = " \t\r";
+    size_t first = inText.find_first_not_of(space);
+    if (first == std::string::npos)
+        return std::string();
+    return inText.substr(first, inText.find_last_not_of(space) - first + 1);
+}
+
+// a whole number and nothing else
+static bool ParseInteger(const std::string &inText, long &outValue)
+{
+    char *end;
+    outValue = strtol(inText.c_str(), &end, 10);
+    return !inText.empty() && *end == 0;
+}
+
+LidarHubConfig::LidarHubConfig()
+: mMinSignalStrength(kDefaultMinSignalStrength), mDespike(true), mChangeThreshold(kDefaultChangeThreshold)
+{
+    memset(&mDevice, 0, sizeof(mDevice));
+}
+
+void LidarHubConfig::ReadEnvironment()
+{
+    if (const char *speed = getenv("LIDARSYNTH_MOTOR_SPEED"))
+        mDevice.mMotorSpeed = UInt32(std::min(std::max(atoi(speed), 0), int(kLidarMaxMotorSpeed)));
+    if (const char *rate = getenv("LIDARSYNTH_SAMPLE_RATE"))
+        mDevice.mSampleRate = UInt32(std::max(atoi(rate), 0));
+    if (!mDevice.IsValid())
+        mDevice.mSampleRate = 0;
+    if (const char *strength = getenv("LIDARSYNTH_MIN_SIGNAL_STRENGTH"))
+        mMinSignalStrength = std::max(atoi(strength), 0);
+    if (const char *despike = getenv("LIDARSYNTH_DESPIKE"))
+        mDespike = atoi(despike) != 0;
+    if (const char *threshold = getenv("LIDARSYNTH_CHANGE_THRESHOLD"))
+        mChangeThreshold = UInt32(std::max(atoi(threshold), 0));
+}
+
+bool LidarHubConfig::Parse(const char *inText)
+{
+    std::string text(inText);
+    ScanZoneMap zones;
+    size_t start = 0;
+    for (UInt32 lineNumber = 1; start < text.size(); ++lineNumber) {
+        size_t end = text.find('\n', start);
+        std::string line = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        start = end == std::string::npos ? text.size() : end + 1;
+        line = Trim(line.substr(0, line.find('#')));
+        if (line.empty())
+            continue;
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            fprintf(stderr, "LidarHubConfig: line %u is not key = value\n", (unsigned)lineNumber);
+            return false;
+        }
+        const std::string key = Trim(line.substr(0, equals));
+        const std::string value = Trim(line.substr(equals + 1));
+        long number = 0;
+        bool valid = true;
+        if (key == "device") {
+            valid = value.size() < sizeof(mDevice.mDevicePath);
+            if (valid)
+                strcpy(mDevice.mDevicePath, value.c_str());
+        } else if (key == "motor_speed") {
+            valid = ParseInteger(value, number) && number >= 0 && number <= long(kLidarMaxMotorSpeed);
+            mDevice.mMotorSpeed = UInt32(number);
+        } else if (key == "sample_rate") {
+            valid = ParseInteger(value, number) && number >= 0 && number <= 1000;
+            mDevice.mSampleRate = UInt32(number);
+        } else if (key == "min_signal_strength") {
+            valid = ParseInteger(value, number) && number >= 0 && number <= 255;
+            mMinSignalStrength = std::int32_t(number);
+        } else if (key == "despike") {
+            valid = ParseInteger(value, number);
+            mDespike = number != 0;
+        } else if (key == "change_threshold") {
+            valid = ParseInteger(value, number) && number >= 0;
+            mChangeThreshold = UInt32(number);
+        } else if (key == "zone") {
+            Float64 startDegrees, spanDegrees;
+            unsigned lowNote, highNote;
+            char extra;
+            valid = zones.mNumZones < kMaxScanZones
+                && sscanf(value.c_str(), "%lf , %lf , %u , %u %c", &startDegrees, &spanDegrees, &lowNote, &highNote, &extra) == 4;
+            if (valid) {
+                ScanZone &zone = zones.mZones[zones.mNumZones++];
+                zone.mStartAngle = std::int32_t(lround(startDegrees * 1000.));
+                zone.mSpan = std::int32_t(lround(spanDegrees * 1000.));
+                zone.mLowNote = lowNote;
+                zone.mHighNote = highNote;
+            }
+        } else {
+            fprintf(stderr, "LidarHubConfig: line %u: unknown key %s\n", (unsigned)lineNumber, key.c_str());
+            return false;
+        }
+        if (!valid) {
+            fprintf(stderr, "LidarHubConfig: line %u: %s is malformed or out of range\n", (unsigned)lineNumber, line.c_str());
+            return false;
+        }
+    }
+    if (!mDevice.IsValid() || !zones.IsValid()) {
+        fprintf(stderr, "LidarHubConfig: the sample rate or a zone is out of range\n");
+        return false;
+    }
+    mZones = zones;
+    return true;
+}
+
+bool LidarHubConfig::ReadFile(const char *inPath)
+{
+    FILE *file = fopen(inPath, "r");
+    if (file == NULL) {
+        fprintf(stderr, "LidarHubConfig: could not open %s\n", inPath);
+        return false;
+    }
+    std::string text;
+    char buffer[1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, length);
+    fclose(file);
+    return Parse(text.c_str());
+}
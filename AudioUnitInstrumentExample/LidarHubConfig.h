@@ -0,0 +1,88 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ The settings of the shared LiDAR device hub, from the environment and a reloadable file
+ */
+
+#ifndef __LidarHubConfig_h__
+#define __LidarHubConfig_h__
+
+#include "ScanZones.h"
+#include "ScanQualityFilter.h"
+#include <cstring>
+
+static const UInt32 kLidarMaxMotorSpeed = 10;		// Hz
+static const UInt32 kLidarDevicePathLength = 256;
+
+// what the shared device is asked for; a field left 0, or empty, keeps the device's own setting
+struct LidarDeviceSettings
+{
+    UInt32					mMotorSpeed;		// rotations per second, 1 to kLidarMaxMotorSpeed
+    UInt32					mSampleRate;		// samples per second: 500, 750 or 1000
+    char					mDevicePath[kLidarDevicePathLength];	// serial port, NUL-terminated
+
+    bool					IsValid() const
+    {
+        return mMotorSpeed <= kLidarMaxMotorSpeed
+            && (mSampleRate == 0 || mSampleRate == 500 || mSampleRate == 750 || mSampleRate == 1000)
+            && memchr(mDevicePath, 0, sizeof(mDevicePath)) != NULL;
+    }
+
+    bool					operator==(const LidarDeviceSettings &inOther) const
+    {
+        return mMotorSpeed == inOther.mMotorSpeed && mSampleRate == inOther.mSampleRate
+            && strcmp(mDevicePath, inOther.mDevicePath) == 0;
+    }
+    bool					operator!=(const LidarDeviceSettings &inOther) const { return !(*this == inOther); }
+};
+
+/*
+ Everything about the hub that can change while it runs. The hub starts from the environment
+ (LIDARSYNTH_MOTOR_SPEED, LIDARSYNTH_SAMPLE_RATE, LIDARSYNTH_MIN_SIGNAL_STRENGTH, LIDARSYNTH_DESPIKE
+ and LIDARSYNTH_CHANGE_THRESHOLD); a file named by LIDARSYNTH_CONFIG overrides it, one key = value
+ per line, with # starting a comment:
+
+     device = /dev/cu.usbserial-DM00KVQW
+     motor_speed = 5
+     sample_rate = 1000
+     min_signal_strength = 10
+     despike = 1
+     change_threshold = 128
+     zone = 0, 90, 36, 59		# start and span in degrees, lowest and highest note
+
+ A key left out keeps the value the environment gave it. Each zone line adds a sector to the zone
+ map, up to kMaxScanZones; without any, the file sets no zones. The table resolution is not among the
+ keys: it is set through SinSynth's kAudioUnitCustomProperty_ScanTableSize (LidarDeviceHub::SetTableBits).
+ */
+struct LidarHubConfig
+{
+    LidarHubConfig();
+
+    // from the environment variables above, over the defaults
+    void					ReadEnvironment();
+    // false, with a message on stderr, if inText has a key it doesn't know or a value out of range;
+    // this is then left partly changed, so parse into a copy
+    bool					Parse(const char *inText);
+    // false, with a message, if the file can't be read or doesn't parse
+    bool					ReadFile(const char *inPath);
+
+    bool					SameFilter(const LidarHubConfig &inOther) const
+    {
+        return mMinSignalStrength == inOther.mMinSignalStrength && mDespike == inOther.mDespike;
+    }
+    // applies the filter settings
+    void					ConfigureFilter(ScanQualityFilter &ioFilter) const
+    {
+        ioFilter.SetMinSignalStrength(mMinSignalStrength);
+        ioFilter.SetDespike(mDespike);
+    }
+
+    LidarDeviceSettings		mDevice;
+    std::int32_t			mMinSignalStrength;	// the weakest return the table takes, 0 for all of them
+    bool					mDespike;			// false keeps single-sample spikes
+    UInt32					mChangeThreshold;	// cm summed over the bins of a default-size table below which a scan is not republished
+    ScanZoneMap				mZones;				// for the subscribers without a map of their own
+};
+
+#endif
@@ -0,0 +1,528 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Realtime JACK host that plays the LiDAR wavetable engine without an audio unit around it
+ */
+
+/*
+ LidarJackHost runs the voice engine of libSinSynthEngine.a straight from a JACK process callback,
+ for a Linux box with the sensor attached and no Audio Unit host. It acquires a LidarDeviceHub of its
+ own, which opens the device (or LIDARSYNTH_ENDPOINT, LIDARSYNTH_REPLAY or a running LidarDaemon, as
+ in the AU), subscribes one LidarScanSnapshot to it, and plays what arrives on its JACK MIDI input:
+ note on and off, pitch bend, the mod wheel and all notes off, on any of the 16 channels.
+
+ Everything the AU does per cycle around the voices happens here in the callback, on JACK's thread,
+ with nothing locked or allocated: the newest scan is taken, NoteTables gives each note its increment,
+ mip-map level and envelope steps, each channel's bend and mod wheel become a ControlRateModulation
+ (the wheel gates the level by how close the nearest return is, as in SinSynth), and the notes render
+ through one WavetableVoiceBank, in slices that end at each MIDI event's frame. The voices are mono;
+ both outputs carry the same signal. The bank has twice --polyphony slots: once that many notes are
+ held the oldest is stolen, fading in its slot with the fast release while the new note takes another.
+
+ Each cycle is timed with an AURenderTiming against its budget (frames / sample rate), the way AUBase
+ times DoRender(), and JACK's xrun callback is counted beside it. Every --report seconds the main
+ thread prints the cycle count, the mean and worst load, the overruns past the 0.8 threshold, the
+ xruns the server saw, its worst scheduling delay, and the 99th percentile of the scans' latency from
+ capture to the cycle that first played them. An AURenderTrace records every cycle beside it:
+ kill -USR1 dumps the last few thousand cycles to $TMPDIR (or LIDARSYNTH_TRACE_DIR), and with
+ --trace-overruns so does every overrun, at most once every ten seconds. The engine runs at whatever period and rate the server
+ was started with; 32 frames at 48 kHz gives a 0.67 ms budget.
+
+ Build it as a command line tool from this file, linking libSinSynthEngine.a (the SinSynthEngine
+ target), SinSynth's LiDAR libraries and libjack, with the engine's Linux settings (see the ReadMe).
+ For example:
+
+	jackd -R -P 80 -d alsa -r 48000 -p 32 -n 2 &
+	LidarJackHost --connect --polyphony 32 --report 5
+ */
+
+#include "LidarDeviceHub.h"
+#include "NoteTables.h"
+#include "WavetableVoiceBank.h"
+#include "ControlRateModulation.h"
+#include "SmoothedParameter.h"
+#include "AURenderTiming.h"
+#include "AURenderTrace.h"
+#include "CADenormalGuard.h"
+#include "CAHostTimeBase.h"
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum
+{
+    kMidiMessage_NoteOff 			= 0x80,
+    kMidiMessage_NoteOn 			= 0x90,
+    kMidiMessage_ControlChange 		= 0xB0,
+    kMidiMessage_PitchWheel 		= 0xE0
+};
+
+static const UInt32 kMidiChannels = 16;
+static const UInt8 kModWheelController = 1;
+static const UInt8 kAllNotesOffController = 123;
+static const UInt32 kNoVoice = 0xFFFFFFFF;
+
+struct HostOptions
+{
+    HostOptions() : mClientName("LidarJackHost"), mPolyphony(32), mVolume(0.5f), mAttackSeconds(0.005f),
+                    mReleaseSeconds(0.3f), mBendRange(2.f), mReportSeconds(2.), mConnect(false),
+                    mTraceOverruns(false) {}
+
+    std::string				mClientName;
+    UInt32					mPolyphony;			// notes held before the oldest is stolen
+    Float32					mVolume;
+    Float32					mAttackSeconds;
+    Float32					mReleaseSeconds;
+    Float32					mBendRange;			// semitones at full pitch wheel
+    Float64					mReportSeconds;
+    bool					mConnect;			// to the first two physical playback ports
+    bool					mTraceOverruns;		// dump the render trace on an overrun
+};
+
+static void Usage(const char *inName)
+{
+    fprintf(stderr,
+            "usage: %s [--client NAME] [--polyphony N] [--volume V] [--attack S] [--release S]\n"
+            "          [--bend-range SEMITONES] [--report S] [--connect] [--trace-overruns]\n", inName);
+    exit(1);
+}
+
+static HostOptions ParseOptions(int argc, const char *argv[])
+{
+    HostOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--connect")) {
+            options.mConnect = true;
+            continue;
+        }
+        if (!strcmp(arg, "--trace-overruns")) {
+            options.mTraceOverruns = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            Usage(argv[0]);
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--client"))
+            options.mClientName = value;
+        else if (!strcmp(arg, "--polyphony"))
+            options.mPolyphony = UInt32(strtoul(value, NULL, 10));
+        else if (!strcmp(arg, "--volume"))
+            options.mVolume = Float32(atof(value));
+        else if (!strcmp(arg, "--attack"))
+            options.mAttackSeconds = Float32(atof(value));
+        else if (!strcmp(arg, "--release"))
+            options.mReleaseSeconds = Float32(atof(value));
+        else if (!strcmp(arg, "--bend-range"))
+            options.mBendRange = Float32(atof(value));
+        else if (!strcmp(arg, "--report"))
+            options.mReportSeconds = atof(value);
+        else
+            Usage(argv[0]);
+    }
+    if (options.mPolyphony == 0 || options.mReportSeconds <= 0. || options.mAttackSeconds <= 0.f
+        || options.mReleaseSeconds <= 0.f)
+        Usage(argv[0]);
+    return options;
+}
+
+// what the host keeps of the note in one slot of the voice bank
+struct HostVoice
+{
+    HostVoice() : mActive(false), mReleased(false), mStolen(false), mKey(0), mChannel(0), mAge(0) {}
+
+    bool					mActive;
+    bool					mReleased;
+    bool					mStolen;			// released with the fast release
+    UInt8					mKey;
+    UInt8					mChannel;
+    UInt64					mAge;				// order of the note-ons, for stealing the oldest
+};
+
+class JackInstrument
+{
+public:
+    explicit JackInstrument(const HostOptions &inOptions);
+    ~JackInstrument();
+
+    bool					Open();
+    void					Close();
+    void					Report();
+
+private:
+    static int				Process(jack_nframes_t inNumFrames, void *inRefCon);
+    static int				BufferSizeChanged(jack_nframes_t inNumFrames, void *inRefCon);
+    static int				XRun(void *inRefCon);
+
+    void					Render(UInt32 inNumFrames);
+    void					RenderSlice(const LidarScanZones &inZones, Float32 *ioOutput, UInt32 inOffset, UInt32 inNumFrames);
+    void					HandleMidi(const jack_midi_event_t &inEvent);
+    void					NoteOn(UInt8 inChannel, UInt8 inKey, UInt8 inVelocity);
+    void					NoteOff(UInt8 inChannel, UInt8 inKey);
+    UInt32					AllocateVoice();
+    void					ConnectOutputs();
+
+    JackInstrument(const JackInstrument &);
+    JackInstrument & operator=(const JackInstrument &);
+
+    HostOptions				mOptions;
+    jack_client_t *			mClient;
+    jack_port_t *			mMidiIn;
+    jack_port_t *			mOutputs[2];
+    LidarDeviceHub *		mHub;
+    LidarScanSnapshot		mSnapshot;
+    Float64					mSampleRate;
+
+    // render thread only, once the client is active
+    NoteTables				mTables;
+    WavetableVoiceBank		mBank;
+    std::vector<HostVoice>	mVoices;
+    UInt64					mNextAge;
+    ControlRateModulation	mModulation[kMidiChannels];
+    Float32					mModulationCoefficient;
+    Float32					mBend[kMidiChannels];			// semitones
+    Float32					mWheel[kMidiChannels];			// 0 to 1
+    SmoothedParameter		mVolume;
+    UInt64					mLastCaptureTime;
+
+    AURenderTiming			mTiming;
+    AURenderTrace			mTrace;
+    std::atomic<UInt64>		mNumXRuns;
+};
+
+JackInstrument::JackInstrument(const HostOptions &inOptions)
+    : mOptions(inOptions), mClient(NULL), mMidiIn(NULL), mHub(NULL), mSampleRate(0.), mNextAge(0),
+      mModulationCoefficient(0.f), mLastCaptureTime(0), mNumXRuns(0)
+{
+    mOutputs[0] = mOutputs[1] = NULL;
+    for (UInt32 i = 0; i < kMidiChannels; ++i)
+        mBend[i] = mWheel[i] = 0.f;
+}
+
+JackInstrument::~JackInstrument()
+{
+    Close();
+}
+
+bool JackInstrument::Open()
+{
+    jack_status_t status;
+    mClient = jack_client_open(mOptions.mClientName.c_str(), JackNoStartServer, &status);
+    if (mClient == NULL) {
+        fprintf(stderr, "LidarJackHost: cannot connect to the JACK server (status 0x%x)\n", unsigned(status));
+        return false;
+    }
+    mMidiIn = jack_port_register(mClient, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+    mOutputs[0] = jack_port_register(mClient, "out_left", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    mOutputs[1] = jack_port_register(mClient, "out_right", JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    if (mMidiIn == NULL || mOutputs[0] == NULL || mOutputs[1] == NULL) {
+        fprintf(stderr, "LidarJackHost: cannot register the ports\n");
+        return false;
+    }
+
+    // everything the callback touches is sized before the client is activated
+    mSampleRate = jack_get_sample_rate(mClient);
+    mTables.SetSampleRate(mSampleRate);
+    mTables.SetVelocityCurve(kVelocityCurve_Cubed);
+    mBank.Resize(mOptions.mPolyphony * 2);
+    mVoices.assign(mOptions.mPolyphony * 2, HostVoice());
+    mModulationCoefficient = ControlRateModulation::Coefficient(mSampleRate);
+    mTrace.SetDumpsOnOverrun(mOptions.mTraceOverruns);
+    BufferSizeChanged(jack_get_buffer_size(mClient), this);
+
+    mHub = LidarDeviceHub::Acquire();
+    mHub->AddSubscriber(&mSnapshot);
+
+    jack_set_process_callback(mClient, Process, this);
+    jack_set_buffer_size_callback(mClient, BufferSizeChanged, this);
+    jack_set_xrun_callback(mClient, XRun, this);
+    if (jack_activate(mClient) != 0) {
+        fprintf(stderr, "LidarJackHost: cannot activate the client\n");
+        return false;
+    }
+    if (mOptions.mConnect)
+        ConnectOutputs();
+
+    printf("LidarJackHost: %s at %g Hz, %u frames per cycle, %u voices\n", jack_get_client_name(mClient),
+           mSampleRate, unsigned(jack_get_buffer_size(mClient)), unsigned(mOptions.mPolyphony));
+    fflush(stdout);
+    return true;
+}
+
+void JackInstrument::Close()
+{
+    if (mClient != NULL) {
+        jack_deactivate(mClient);
+        jack_client_close(mClient);
+        mClient = NULL;
+    }
+    if (mHub != NULL) {
+        mHub->RemoveSubscriber(&mSnapshot);
+        mHub->Release();
+        mHub = NULL;
+    }
+}
+
+void JackInstrument::ConnectOutputs()
+{
+    const char **ports = jack_get_ports(mClient, NULL, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsInput);
+    if (ports == NULL) {
+        fprintf(stderr, "LidarJackHost: no physical playback ports to connect to\n");
+        return;
+    }
+    for (UInt32 i = 0; i < 2 && ports[i] != NULL; ++i)
+        if (jack_connect(mClient, jack_port_name(mOutputs[i]), ports[i]) != 0)
+            fprintf(stderr, "LidarJackHost: cannot connect to %s\n", ports[i]);
+    jack_free(ports);
+}
+
+int JackInstrument::Process(jack_nframes_t inNumFrames, void *inRefCon)
+{
+    static_cast<JackInstrument*>(inRefCon)->Render(inNumFrames);
+    return 0;
+}
+
+// JACK calls this between two cycles, never during one
+int JackInstrument::BufferSizeChanged(jack_nframes_t inNumFrames, void *inRefCon)
+{
+    JackInstrument *instrument = static_cast<JackInstrument*>(inRefCon);
+    for (UInt32 i = 0; i < kMidiChannels; ++i)
+        instrument->mModulation[i].Resize(inNumFrames);
+    return 0;
+}
+
+int JackInstrument::XRun(void *inRefCon)
+{
+    static_cast<JackInstrument*>(inRefCon)->mNumXRuns.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+void JackInstrument::Render(UInt32 inNumFrames)
+{
+    const UInt64 renderStart = CAHostTimeBase::GetTheCurrentTime();
+    CADenormalGuard denormalGuard;
+
+    // a scan's latency runs from its capture to the first cycle that plays it, as in SinSynth
+    const LidarScanZones &zones = mSnapshot.ReadBuffer();
+    const UInt64 captureTime = zones.CaptureTime();
+    if (captureTime != mLastCaptureTime) {
+        if (mLastCaptureTime != 0)
+            mTiming.RecordSourceLatency((SInt64(CAHostTimeBase::GetCurrentTimeInNanos()) - SInt64(captureTime)) * 1.0e-9);
+        mLastCaptureTime = captureTime;
+    }
+    mTrace.SetSourceID(captureTime);
+
+    // each channel's bend, and its mod wheel gating the level by how close the nearest return is
+    mTables.SetEnvelopeTimes(mOptions.mAttackSeconds, mOptions.mReleaseSeconds);
+    const LidarScanTable &scan = zones.Table(kFullScanTable);
+    const Float32 closeness = scan.mCaptureTime != 0 ? 1.f - scan.mStats.mMin / Float32(kScanMaxDistance) : 1.f;
+    bool sounding[kMidiChannels] = {};
+    UInt32 numActive = 0;
+    for (UInt32 i = 0; i < mVoices.size(); ++i)
+        if (mVoices[i].mActive) {
+            sounding[mVoices[i].mChannel] = true;
+            ++numActive;
+        }
+    mTrace.SetActiveVoices(numActive);
+    for (UInt32 channel = 0; channel < kMidiChannels; ++channel) {
+        if (!sounding[channel])
+            mModulation[channel].Reset();
+        mModulation[channel].Evaluate(mBend[channel], 1.f - mWheel[channel] * (1.f - closeness), inNumFrames, mModulationCoefficient);
+    }
+    mVolume.BeginBlock(mOptions.mVolume, inNumFrames);
+
+    Float32 *left = static_cast<Float32*>(jack_port_get_buffer(mOutputs[0], inNumFrames));
+    Float32 *right = static_cast<Float32*>(jack_port_get_buffer(mOutputs[1], inNumFrames));
+    memset(left, 0, inNumFrames * sizeof(Float32));
+
+    // the events arrive sorted by frame; each one lands between the slices around it
+    void *midi = jack_port_get_buffer(mMidiIn, inNumFrames);
+    const UInt32 numEvents = jack_midi_get_event_count(midi);
+    mTrace.AddEvents(numEvents);
+    UInt32 offset = 0;
+    for (UInt32 i = 0; i < numEvents; ++i) {
+        jack_midi_event_t event;
+        if (jack_midi_event_get(&event, midi, i) != 0)
+            continue;
+        const UInt32 frame = std::min<UInt32>(event.time, inNumFrames);
+        if (frame > offset) {
+            RenderSlice(zones, left, offset, frame - offset);
+            offset = frame;
+        }
+        HandleMidi(event);
+    }
+    if (offset < inNumFrames)
+        RenderSlice(zones, left, offset, inNumFrames - offset);
+    memcpy(right, left, inNumFrames * sizeof(Float32));
+
+    const UInt64 renderEnd = CAHostTimeBase::GetTheCurrentTime();
+    const bool overrun = mTiming.EndCycle(renderStart, renderEnd, inNumFrames, mSampleRate, denormalGuard.Engaged());
+    mTrace.EndCycle(renderStart, renderEnd, inNumFrames, overrun, mTiming.OverrunThreshold());
+}
+
+// one Render() call per channel and batch, since the channels each have their own modulation
+void JackInstrument::RenderSlice(const LidarScanZones &inZones, Float32 *ioOutput, UInt32 inOffset, UInt32 inNumFrames)
+{
+    const SmoothedParameter volume = mVolume.Slice(inOffset);
+    const UInt32 numVoices = UInt32(mVoices.size());
+    UInt32 slots[kWavetableVoiceBatch], endFrames[kWavetableVoiceBatch];
+    for (UInt32 channel = 0; channel < kMidiChannels; ++channel) {
+        UInt32 count = 0;
+        for (UInt32 slot = 0; slot <= numVoices; ++slot) {
+            if (slot < numVoices && mVoices[slot].mActive && mVoices[slot].mChannel == channel) {
+                const HostVoice &voice = mVoices[slot];
+                const Float32 peak = mBank.Peak(slot);
+                if (!voice.mReleased)
+                    mBank.SetBlock(slot, mTables.Increment(voice.mKey), kVoiceEnvelope_Rising, peak * mTables.AttackStep());
+                else
+                    mBank.SetBlock(slot, mTables.Increment(voice.mKey), kVoiceEnvelope_Falling,
+                                   peak * (voice.mStolen ? mTables.FastReleaseStep() : mTables.ReleaseStep()));
+                slots[count++] = slot;
+            }
+            if (count == kWavetableVoiceBatch || (slot == numVoices && count > 0)) {
+                mBank.Render<false>(inZones, volume, mModulation[channel], inOffset, slots, count, endFrames,
+                                    ioOutput + inOffset, NULL, inNumFrames);
+                for (UInt32 k = 0; k < count; ++k)
+                    if (endFrames[k] < inNumFrames)
+                        mVoices[slots[k]].mActive = false;
+                count = 0;
+            }
+        }
+    }
+}
+
+void JackInstrument::HandleMidi(const jack_midi_event_t &inEvent)
+{
+    if (inEvent.size < 2)
+        return;
+    const UInt8 status = inEvent.buffer[0] & 0xF0;
+    const UInt8 channel = inEvent.buffer[0] & 0x0F;
+    const UInt8 data1 = inEvent.buffer[1];
+    const UInt8 data2 = inEvent.size > 2 ? inEvent.buffer[2] : 0;
+    switch (status) {
+        case kMidiMessage_NoteOn:
+            if (data2 != 0) {
+                NoteOn(channel, data1, data2);
+                break;
+            }
+            // a note-on at velocity 0 is a note-off
+        case kMidiMessage_NoteOff:
+            NoteOff(channel, data1);
+            break;
+        case kMidiMessage_ControlChange:
+            if (data1 == kModWheelController)
+                mWheel[channel] = data2 / 128.f;
+            else if (data1 == kAllNotesOffController)
+                for (UInt32 i = 0; i < mVoices.size(); ++i)
+                    if (mVoices[i].mChannel == channel)
+                        mVoices[i].mReleased = true;
+            break;
+        case kMidiMessage_PitchWheel:
+            mBend[channel] = ((SInt32(data2) << 7 | data1) - 8192) / 8192.f * mOptions.mBendRange;
+            break;
+        default:
+            break;
+    }
+}
+
+// steals the oldest held note once the polyphony is reached, then takes a free slot; with every slot
+// still sounding, the oldest released note is cut off, there being nothing quieter to give up
+UInt32 JackInstrument::AllocateVoice()
+{
+    const UInt32 numVoices = UInt32(mVoices.size());
+    UInt32 numHeld = 0, oldestHeld = kNoVoice, oldestReleased = kNoVoice, free = kNoVoice;
+    for (UInt32 i = 0; i < numVoices; ++i) {
+        const HostVoice &voice = mVoices[i];
+        if (!voice.mActive) {
+            if (free == kNoVoice)
+                free = i;
+        } else if (!voice.mReleased) {
+            ++numHeld;
+            if (oldestHeld == kNoVoice || voice.mAge < mVoices[oldestHeld].mAge)
+                oldestHeld = i;
+        } else if (oldestReleased == kNoVoice || voice.mAge < mVoices[oldestReleased].mAge)
+            oldestReleased = i;
+    }
+    if (numHeld >= mOptions.mPolyphony)
+        mVoices[oldestHeld].mReleased = mVoices[oldestHeld].mStolen = true;
+    if (free != kNoVoice)
+        return free;
+    return oldestReleased != kNoVoice ? oldestReleased : oldestHeld;
+}
+
+void JackInstrument::NoteOn(UInt8 inChannel, UInt8 inKey, UInt8 inVelocity)
+{
+    const UInt32 slot = AllocateVoice();
+    HostVoice &voice = mVoices[slot];
+    voice.mActive = true;
+    voice.mReleased = voice.mStolen = false;
+    voice.mKey = inKey;
+    voice.mChannel = inChannel;
+    voice.mAge = mNextAge++;
+    mBank.Start(slot, kFullScanTable, mTables.TableLevel(inKey), mTables.Peak(inVelocity));
+}
+
+void JackInstrument::NoteOff(UInt8 inChannel, UInt8 inKey)
+{
+    for (UInt32 i = 0; i < mVoices.size(); ++i) {
+        HostVoice &voice = mVoices[i];
+        if (voice.mActive && !voice.mReleased && voice.mChannel == inChannel && voice.mKey == inKey) {
+            voice.mReleased = true;
+            return;
+        }
+    }
+}
+
+void JackInstrument::Report()
+{
+    AURenderTimingStatistics statistics;
+    mTiming.GetStatistics(statistics);
+    printf("LidarJackHost: %llu cycles, load mean %.2f max %.2f, %llu overruns, %llu xruns, max delay %.0f us, "
+           "scan latency p99 %.1f ms, %s\n",
+           (unsigned long long)statistics.mNumCycles, statistics.mMeanLoad, statistics.mMaxLoad,
+           (unsigned long long)statistics.mNumOverruns, (unsigned long long)mNumXRuns.load(std::memory_order_relaxed),
+           double(jack_get_max_delayed_usecs(mClient)), statistics.mP99SourceLatency * 1.0e3,
+           mHub->State() == kLidarState_Streaming ? "streaming" : "no scans");
+    fflush(stdout);
+}
+
+static volatile std::sig_atomic_t sExitRequested = 0;
+
+static void RequestExit(int)
+{
+    sExitRequested = 1;
+}
+
+int main(int argc, const char * argv[])
+{
+    HostOptions options = ParseOptions(argc, argv);
+    JackInstrument instrument(options);
+    if (!instrument.Open())
+        return 1;
+
+    signal(SIGINT, RequestExit);
+    signal(SIGTERM, RequestExit);
+    AURenderTrace::DumpAllOnSignal(SIGUSR1);
+
+    const auto period = std::chrono::duration<double>(options.mReportSeconds);
+    auto nextReport = std::chrono::steady_clock::now() + period;
+    while (!sExitRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (std::chrono::steady_clock::now() >= nextReport) {
+            instrument.Report();
+            nextReport += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        }
+    }
+    instrument.Close();
+    return 0;
+}
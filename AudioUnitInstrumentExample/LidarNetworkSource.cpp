@@ -0,0 +1,126 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ ZeroMQ transport of raw scans, in the libsweep example-net format or as compact frames
+ */
+
+#include "LidarNetworkSource.h"
+#include <algorithm>
+
+// reads a protobuf varint of up to 64 bits. NULL if it runs past inEnd or is too long.
+static const UInt8 *ReadWireVarint(const UInt8 *inBytes, const UInt8 *inEnd, UInt64 &outValue)
+{
+    outValue = 0;
+    for (unsigned shift = 0; shift < 64 && inBytes < inEnd; shift += 7) {
+        UInt8 byte = *inBytes++;
+        outValue |= (UInt64)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return inBytes;
+    }
+    return NULL;
+}
+
+// walks the wire format of a sweep.proto.scan without parsing it and checks that no repeated field
+// (angle = 1, distance = 2, signal_strength = 3, packed or not) holds more than inMaxSamples values,
+// so ParseFromArray never grows them past the storage reserved up front.
+static bool ScanFitsReserve(const UInt8 *inBytes, size_t inSize, UInt32 inMaxSamples)
+{
+    const UInt8 *end = inBytes + inSize;
+    UInt64 counts[4] = { 0, 0, 0, 0 };
+    while (inBytes < end) {
+        UInt64 key, length;
+        if (!(inBytes = ReadWireVarint(inBytes, end, key))) return false;
+        UInt64 field = key >> 3;
+        UInt64 &count = counts[field < 4 ? field : 0];
+        switch (key & 7) {
+            case 0:		// a single varint
+                if (!(inBytes = ReadWireVarint(inBytes, end, length))) return false;
+                ++count;
+                break;
+            case 1:		// fixed64
+                if (end - inBytes < 8) return false;
+                inBytes += 8;
+                ++count;
+                break;
+            case 5:		// fixed32
+                if (end - inBytes < 4) return false;
+                inBytes += 4;
+                ++count;
+                break;
+            case 2:		// a packed array: one value per byte that ends a varint
+                if (!(inBytes = ReadWireVarint(inBytes, end, length)) || length > (UInt64)(end - inBytes)) return false;
+                for (const UInt8 *value = inBytes; value < inBytes + length; ++value)
+                    count += !(*value & 0x80);
+                inBytes += length;
+                break;
+            default:
+                return false;
+        }
+        if (field && field < 4 && count > inMaxSamples) return false;
+    }
+    return true;
+}
+
+LidarNetworkSource::LidarNetworkSource(const char *inEndpoint)
+: mContext(1), mSocket(mContext, ZMQ_SUB), mBuffer(kMaxNetworkScanBytes), mAngles(kMaxNetworkScanSamples),
+  mDistances(kMaxNetworkScanSamples), mSignalStrengths(kMaxNetworkScanSamples), mNumSamples(0), mCompact(false),
+  mHasSignalStrengths(false), mTimeout(-1)
+{
+    mScan.mutable_angle()->Reserve(kMaxNetworkScanSamples);
+    mScan.mutable_distance()->Reserve(kMaxNetworkScanSamples);
+    mScan.mutable_signal_strength()->Reserve(kMaxNetworkScanSamples);
+
+    // only the latest scan matters; don't let a slow host queue up stale ones
+    int highWaterMark = 2;
+    mSocket.setsockopt(ZMQ_RCVHWM, &highWaterMark, sizeof(highWaterMark));
+    int linger = 0;
+    mSocket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+    mSocket.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+    mSocket.connect(inEndpoint);
+}
+
+bool LidarNetworkSource::Receive(int inTimeoutMs)
+{
+    if (inTimeoutMs != mTimeout) {
+        mSocket.setsockopt(ZMQ_RCVTIMEO, &inTimeoutMs, sizeof(inTimeoutMs));
+        mTimeout = inTimeoutMs;
+    }
+    mNumSamples = 0;
+    // recv() reports the full message size even when it had to truncate the copy
+    size_t size = mSocket.recv(mBuffer.data(), mBuffer.size());
+    if (size == 0 || size > mBuffer.size())
+        return false;
+
+    mCompact = ScanFrameIsCompact(mBuffer.data(), size);
+    if (mCompact)
+        return ScanFrameDecode(mBuffer.data(), size, kMaxNetworkScanSamples, mAngles.data(), mDistances.data(),
+                               mSignalStrengths.data(), mNumSamples, mHasSignalStrengths);
+
+    // check the sample counts before parsing, so an oversized scan is never grown into
+    if (!ScanFitsReserve(mBuffer.data(), size, kMaxNetworkScanSamples))
+        return false;
+    // ParseFromArray clears the message first, which keeps the capacity of its repeated fields
+    if (!mScan.ParseFromArray(mBuffer.data(), (int)size))
+        return false;
+
+    mNumSamples = (UInt32)std::min(mScan.angle_size(), mScan.distance_size());
+    return true;
+}
+
+LidarScanPublisher::LidarScanPublisher(const char *inEndpoint)
+: mContext(1), mSocket(mContext, ZMQ_PUB), mBuffer(kScanFrameHeaderBytes + kMaxNetworkScanSamples * kScanFrameMaxBytesPerSample)
+{
+    int highWaterMark = 2;
+    mSocket.setsockopt(ZMQ_SNDHWM, &highWaterMark, sizeof(highWaterMark));
+    int linger = 0;
+    mSocket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+    mSocket.bind(inEndpoint);
+}
+
+void LidarScanPublisher::Send(const std::int32_t *inAngles, const std::int32_t *inDistances,
+                              const std::int32_t *inSignalStrengths, UInt32 inNumSamples)
+{
+    size_t size = ScanFrameEncode(inAngles, inDistances, inSignalStrengths,
+                                  std::min(inNumSamples, kMaxNetworkScanSamples), mBuffer.data());
+    mSocket.send(mBuffer.data(), size, ZMQ_DONTWAIT);
+}
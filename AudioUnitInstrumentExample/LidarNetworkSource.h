@@ -0,0 +1,103 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ ZeroMQ transport of raw scans, in the libsweep example-net format or as compact frames
+ */
+
+#ifndef __LidarNetworkSource_h__
+#define __LidarNetworkSource_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <zmq.hpp>
+#include <cstdint>
+#include <vector>
+#include "libsweep/examples/build/net.pb.h"
+#include "ScanFrameCodec.h"
+
+static const UInt32 kMaxNetworkScanSamples = 2048;
+// three packed int32 fields of at most five varint bytes each, plus tags and lengths; more than any compact frame
+static const size_t kMaxNetworkScanBytes = 3 * (kMaxNetworkScanSamples * 5 + 16);
+static_assert(kMaxNetworkScanBytes >= kScanFrameHeaderBytes + kMaxNetworkScanSamples * kScanFrameMaxBytesPerSample,
+              "a compact frame must fit the receive buffer");
+
+/*
+ LidarNetworkSource connects a ZMQ SUB socket to a publisher such as libsweep's example-net, which
+ sends one serialized sweep.proto.scan (packed angle, distance and signal_strength arrays) per
+ message. This lets one machine with the sensor feed any number of synth hosts on the network.
+ It also takes the compact frames of ScanFrameCodec.h, which a LidarScanPublisher sends, on the
+ same socket; the first byte of each message says which format it is in.
+
+ Decoding does not allocate. Each message is received straight into a fixed buffer, and is parsed into
+ one preallocated scan whose repeated fields are reserved up front for kMaxNetworkScanSamples; parsing
+ clears the fields but keeps their storage. The packed arrays are then handed to the table builder
+ as they are, without building intermediate sweep::sample vectors. Messages larger than the buffer,
+ or scans with more samples than were reserved, are dropped rather than grown into; the sample counts
+ are read off the wire format before the message is parsed.
+ */
+class LidarNetworkSource
+{
+public:
+    // connecting is asynchronous in ZMQ; the constructor does not wait for the publisher.
+    explicit LidarNetworkSource(const char *inEndpoint);
+
+    // waits at most inTimeoutMs for the next scan. Returns false on timeout or a malformed message.
+    bool					Receive(int inTimeoutMs);
+
+    UInt32					NumSamples() const { return mNumSamples; }
+    const std::int32_t *	Angles() const { return mCompact ? mAngles.data() : mScan.angle().data(); }
+    const std::int32_t *	Distances() const { return mCompact ? mDistances.data() : mScan.distance().data(); }
+    // NULL if the publisher did not send signal strengths
+    const std::int32_t *	SignalStrengths() const
+    {
+        if (mCompact)
+            return mHasSignalStrengths ? mSignalStrengths.data() : NULL;
+        return (UInt32)mScan.signal_strength_size() >= mNumSamples ? mScan.signal_strength().data() : NULL;
+    }
+
+private:
+    LidarNetworkSource(const LidarNetworkSource &);
+    LidarNetworkSource & operator=(const LidarNetworkSource &);
+
+    zmq::context_t			mContext;
+    zmq::socket_t			mSocket;
+    std::vector<UInt8>		mBuffer;
+    sweep::proto::scan		mScan;
+    std::vector<std::int32_t> mAngles;		// of the last compact frame
+    std::vector<std::int32_t> mDistances;
+    std::vector<std::int32_t> mSignalStrengths;
+    UInt32					mNumSamples;
+    bool					mCompact;		// whether the last message was a compact frame
+    bool					mHasSignalStrengths;
+    int						mTimeout;
+};
+
+/*
+ LidarScanPublisher binds a ZMQ PUB socket and sends each scan it is given as a compact frame, for
+ hosts that relay the sensor over a slow network. Send() never blocks; ZMQ drops a scan for a
+ subscriber whose queue is full. Binding throws zmq::error_t.
+ */
+class LidarScanPublisher
+{
+public:
+    explicit LidarScanPublisher(const char *inEndpoint);
+
+    // scans of more than kMaxNetworkScanSamples samples are cut short
+    void					Send(const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                 const std::int32_t *inSignalStrengths, UInt32 inNumSamples);
+
+private:
+    LidarScanPublisher(const LidarScanPublisher &);
+    LidarScanPublisher & operator=(const LidarScanPublisher &);
+
+    zmq::context_t			mContext;
+    zmq::socket_t			mSocket;
+    std::vector<UInt8>		mBuffer;
+};
+
+#endif
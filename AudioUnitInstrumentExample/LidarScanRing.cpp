@@ -0,0 +1,199 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Shared-memory ring of binned scans, from the LiDAR daemon to every synth process on the machine
+ */
+
+#include "LidarScanRing.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char * const kLidarScanRingName = "/LidarSynth.scans";
+static const UInt32 kLidarScanRingMagic = 'LdSr';
+static const UInt32 kLidarScanRingVersion = 2;
+
+static bool HasLayout(const LidarScanRingHeader &inHeader)
+{
+    return inHeader.mMagic == kLidarScanRingMagic && inHeader.mVersion == kLidarScanRingVersion
+        && inHeader.mSlotBytes == sizeof(LidarScanRingSlot) && inHeader.mNumSlots == kLidarScanRingSlots;
+}
+
+bool LidarScanRingWriter::Create()
+{
+    if (mSegment != NULL)
+        return true;
+
+    int fd = shm_open(kLidarScanRingName, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (info.st_size < (off_t)sizeof(LidarScanRingSegment) && ftruncate(fd, sizeof(LidarScanRingSegment)) != 0)) {
+        close(fd);
+        return false;
+    }
+    void *memory = mmap(NULL, sizeof(LidarScanRingSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+
+    // a daemon that died without closing leaves its pid behind; only a running one keeps the ring
+    LidarScanRingSegment *segment = (LidarScanRingSegment *)memory;
+    LidarScanRingHeader &header = segment->mHeader;
+    if (HasLayout(header)) {
+        pid_t owner = pid_t(header.mDaemonPID.load(std::memory_order_relaxed));
+        if (owner != 0 && owner != getpid() && kill(owner, 0) == 0) {
+            munmap(memory, sizeof(LidarScanRingSegment));
+            return false;
+        }
+    }
+
+    // readers that still map the segment see the magic go away while the layout is rewritten
+    header.mMagic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    header.mVersion = kLidarScanRingVersion;
+    header.mSlotBytes = sizeof(LidarScanRingSlot);
+    header.mNumSlots = kLidarScanRingSlots;
+    header.mState.store(0, std::memory_order_relaxed);
+    header.mHeartbeat.store(0, std::memory_order_relaxed);
+    header.mPublished.store(0, std::memory_order_relaxed);
+    for (UInt32 i = 0; i < kLidarScanRingSlots; ++i)
+        segment->mSlots[i].mSequence.store(0, std::memory_order_relaxed);
+    header.mDaemonPID.store(UInt32(getpid()), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header.mMagic = kLidarScanRingMagic;
+
+    mSegment = segment;
+    return true;
+}
+
+void LidarScanRingWriter::Close()
+{
+    if (mSegment == NULL)
+        return;
+    mSegment->mHeader.mHeartbeat.store(0, std::memory_order_relaxed);
+    mSegment->mHeader.mDaemonPID.store(0, std::memory_order_release);
+    munmap(mSegment, sizeof(LidarScanRingSegment));
+    mSegment = NULL;
+}
+
+void LidarScanRingWriter::Publish(const LidarScanTable &inTable, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                  const std::int32_t *inSignalStrengths, UInt32 inNumSamples)
+{
+    if (mSegment == NULL)
+        return;
+    LidarScanRingHeader &header = mSegment->mHeader;
+    UInt64 published = header.mPublished.load(std::memory_order_relaxed);
+    LidarScanRingSlot &slot = mSegment->mSlots[published % kLidarScanRingSlots];
+
+    UInt32 sequence = slot.mSequence.load(std::memory_order_relaxed);
+    slot.mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    UInt32 numSamples = std::min(inNumSamples, kLidarScanRingMaxSamples);
+    slot.mNumSamples = numSamples;
+    slot.mHasSignalStrengths = inSignalStrengths != NULL;
+    slot.mTableBytes = UInt32(inTable.FlatBytes());
+    inTable.Flatten(slot.mTable);
+    memcpy(slot.mAngles, inAngles, numSamples * sizeof(std::int32_t));
+    memcpy(slot.mDistances, inDistances, numSamples * sizeof(std::int32_t));
+    if (inSignalStrengths)
+        memcpy(slot.mSignalStrengths, inSignalStrengths, numSamples * sizeof(std::int32_t));
+
+    slot.mSequence.store(sequence + 2, std::memory_order_release);
+    header.mPublished.store(published + 1, std::memory_order_release);
+}
+
+void LidarScanRingWriter::SetState(UInt32 inState, UInt64 inNowNanos)
+{
+    if (mSegment == NULL)
+        return;
+    mSegment->mHeader.mState.store(inState, std::memory_order_relaxed);
+    mSegment->mHeader.mHeartbeat.store(inNowNanos, std::memory_order_release);
+}
+
+bool LidarScanRingReader::Open()
+{
+    if (mSegment != NULL)
+        return true;
+
+    int fd = shm_open(kLidarScanRingName, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(LidarScanRingSegment)) {
+        close(fd);
+        return false;
+    }
+    void *memory = mmap(NULL, sizeof(LidarScanRingSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+
+    const LidarScanRingSegment *segment = (const LidarScanRingSegment *)memory;
+    if (!HasLayout(segment->mHeader)) {
+        munmap(memory, sizeof(LidarScanRingSegment));
+        return false;
+    }
+    mSegment = segment;
+    // start from whatever comes next, and from the newest scan if there already is one
+    UInt64 published = segment->mHeader.mPublished.load(std::memory_order_acquire);
+    mLastPublished = published ? published - 1 : 0;
+    return true;
+}
+
+void LidarScanRingReader::Close()
+{
+    if (mSegment == NULL)
+        return;
+    munmap((void *)mSegment, sizeof(LidarScanRingSegment));
+    mSegment = NULL;
+}
+
+bool LidarScanRingReader::IsLive(UInt64 inNowNanos) const
+{
+    if (mSegment == NULL || !HasLayout(mSegment->mHeader) || mSegment->mHeader.mDaemonPID.load(std::memory_order_acquire) == 0)
+        return false;
+    UInt64 heartbeat = mSegment->mHeader.mHeartbeat.load(std::memory_order_acquire);
+    return heartbeat != 0 && (inNowNanos < heartbeat || inNowNanos - heartbeat < kLidarScanRingStaleNanos);
+}
+
+bool LidarScanRingReader::Read(LidarScanTable &outTable, std::int32_t *outAngles, std::int32_t *outDistances,
+                               std::int32_t *outSignalStrengths, UInt32 &outNumSamples, bool &outHasSignalStrengths)
+{
+    if (mSegment == NULL)
+        return false;
+    const LidarScanRingHeader &header = mSegment->mHeader;
+    UInt64 published = header.mPublished.load(std::memory_order_acquire);
+    // a restarted daemon counts from 0 again, so any change is news
+    if (published == 0 || published == mLastPublished)
+        return false;
+
+    const LidarScanRingSlot &slot = mSegment->mSlots[(published - 1) % kLidarScanRingSlots];
+    UInt32 before = slot.mSequence.load(std::memory_order_acquire);
+    if (before & 1)
+        return false;
+
+    UInt32 numSamples = std::min(slot.mNumSamples, kLidarScanRingMaxSamples);
+    bool hasSignalStrengths = slot.mHasSignalStrengths != 0;
+    if (!outTable.Unflatten(slot.mTable, std::min(size_t(slot.mTableBytes), kScanTableMaxFlatBytes)))
+        return false;
+    memcpy(outAngles, slot.mAngles, numSamples * sizeof(std::int32_t));
+    memcpy(outDistances, slot.mDistances, numSamples * sizeof(std::int32_t));
+    if (hasSignalStrengths)
+        memcpy(outSignalStrengths, slot.mSignalStrengths, numSamples * sizeof(std::int32_t));
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.mSequence.load(std::memory_order_relaxed) != before)
+        return false;
+
+    outNumSamples = numSamples;
+    outHasSignalStrengths = hasSignalStrengths;
+    mLastPublished = published;
+    return true;
+}
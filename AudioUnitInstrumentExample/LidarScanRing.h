@@ -0,0 +1,126 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Shared-memory ring of binned scans, from the LiDAR daemon to every synth process on the machine
+ */
+
+#ifndef __LidarScanRing_h__
+#define __LidarScanRing_h__
+
+#include "LidarScanTable.h"
+#include <atomic>
+#include <cstdint>
+
+static const UInt32 kLidarScanRingSlots = 8;				// scans a reader may fall behind before one is overwritten
+static const UInt32 kLidarScanRingMaxSamples = 2048;		// raw samples carried with each table
+static const UInt64 kLidarScanRingStaleNanos = 2000000000ULL;	// a daemon silent this long is gone
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "the ring's counters are shared between processes, so they must not hide a lock");
+
+/*
+ The ring lives in the named POSIX shared memory segment "/LidarSynth.scans". The daemon (see
+ LidarDaemon/LidarDaemon.cpp) owns the device and writes each scan it bins into the next of
+ kLidarScanRingSlots slots: the finished LidarScanTable, mip-mapped and with its statistics and
+ flattened at whatever resolution the daemon builds, and the raw samples it came from, which the synth still needs for its zones and features. Every slot has
+ its own sequence count, a seqlock: the writer makes it odd, fills the slot and makes it even again,
+ then bumps the header's count of published scans. The header also carries the daemon's device
+ state and a heartbeat, so a reader can tell a daemon that has stopped from a scanner that is idle.
+
+ A reader maps the segment read-only and never writes to it, so any number of processes can read
+ at once and none of them can disturb the daemon. Read() copies the newest slot straight out of the
+ mapping, without any decoding beyond unflattening the table, and keeps the copy only if the slot's count was the same even
+ value before and after; at the daemon's scan rate a slot is rewritten kLidarScanRingSlots scans
+ later, so a reader polling every few milliseconds never loses the race in practice.
+
+ Neither side allocates after Open() or Create(), unless the daemon's resolution changes. Nothing here is for the render thread.
+ */
+struct LidarScanRingSlot
+{
+    std::atomic<UInt32>	mSequence;			// odd while the daemon writes the slot
+    UInt32				mNumSamples;
+    UInt32				mHasSignalStrengths;
+    UInt32				mTableBytes;		// of mTable, a LidarScanTable flattened at the daemon's resolution
+    alignas(8) char		mTable[kScanTableMaxFlatBytes];
+    std::int32_t		mAngles[kLidarScanRingMaxSamples];
+    std::int32_t		mDistances[kLidarScanRingMaxSamples];
+    std::int32_t		mSignalStrengths[kLidarScanRingMaxSamples];
+};
+
+struct LidarScanRingHeader
+{
+    UInt32				mMagic;
+    UInt32				mVersion;
+    UInt32				mSlotBytes;			// sizeof(LidarScanRingSlot) of the writer, to catch mismatched builds
+    UInt32				mNumSlots;
+    std::atomic<UInt32>	mState;				// LidarDeviceState of the daemon's source
+    std::atomic<UInt32>	mDaemonPID;			// 0 once the daemon has shut down
+    std::atomic<UInt64>	mHeartbeat;			// host time in nanoseconds, refreshed by the daemon
+    std::atomic<UInt64>	mPublished;			// scans written so far; the newest is in slot (mPublished - 1) % mNumSlots
+};
+
+struct LidarScanRingSegment
+{
+    LidarScanRingHeader	mHeader;
+    LidarScanRingSlot	mSlots[kLidarScanRingSlots];
+};
+
+// the daemon's side; there must be only one writer on the machine
+class LidarScanRingWriter
+{
+public:
+    LidarScanRingWriter() : mSegment(NULL) {}
+    ~LidarScanRingWriter() { Close(); }
+
+    // creates the segment, or takes over one a previous daemon left; false if another live daemon owns it
+    bool				Create();
+    // marks the ring abandoned, so that readers fall back; the segment stays for the next daemon
+    void				Close();
+    bool				IsOpen() const { return mSegment != NULL; }
+
+    void				Publish(const LidarScanTable &inTable, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                const std::int32_t *inSignalStrengths, UInt32 inNumSamples);
+    void				SetState(UInt32 inState, UInt64 inNowNanos);
+
+private:
+    LidarScanRingWriter(const LidarScanRingWriter &);
+    LidarScanRingWriter & operator=(const LidarScanRingWriter &);
+
+    LidarScanRingSegment *	mSegment;
+};
+
+// a synth process's side, read-only
+class LidarScanRingReader
+{
+public:
+    LidarScanRingReader() : mSegment(NULL), mLastPublished(0) {}
+    ~LidarScanRingReader() { Close(); }
+
+    // maps the segment if a daemon has created one of this build's layout
+    bool				Open();
+    void				Close();
+    bool				IsOpen() const { return mSegment != NULL; }
+
+    // whether a daemon has refreshed its heartbeat within kLidarScanRingStaleNanos of inNowNanos
+    bool				IsLive(UInt64 inNowNanos) const;
+    UInt32				State() const { return mSegment ? mSegment->mHeader.mState.load(std::memory_order_relaxed) : 0; }
+
+    /*
+     Copies the newest scan, if one has been published since the last Read() that returned true:
+     the table into outTable and up to kLidarScanRingMaxSamples samples into each array.
+     outHasSignalStrengths is false if the daemon's source sent none. Returns false if there is
+     nothing new or the slot was being rewritten, in which case the next call tries again.
+     */
+    bool				Read(LidarScanTable &outTable, std::int32_t *outAngles, std::int32_t *outDistances,
+                             std::int32_t *outSignalStrengths, UInt32 &outNumSamples, bool &outHasSignalStrengths);
+
+private:
+    LidarScanRingReader(const LidarScanRingReader &);
+    LidarScanRingReader & operator=(const LidarScanRingReader &);
+
+    const LidarScanRingSegment *	mSegment;
+    UInt64				mLastPublished;
+};
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Angle-ordered wavetable built from one LiDAR scan
+ */
+
+#ifndef __LidarScanTable_h__
+#define __LidarScanTable_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "ScanStatistics.h"
+
+// the table resolution is set at run time, as a power of two from 64 to 8192 bins (see
+// LidarDeviceHub::SetTableBits). A LidarScanTable of 8192 bins is over 800 KB, so every table,
+// snapshot, history and ring slot grows in proportion; the build setting only picks the default.
+static const UInt32 kScanTableMinBits = 6;
+static const UInt32 kScanTableMaxBits = 13;
+static const UInt32 kScanTableMaxSize = 1 << kScanTableMaxBits;
+static const UInt32 kScanTableMaxLevels = kScanTableMaxBits;	// a table of b bits has b levels
+#if !defined(LIDARSYNTH_SCAN_TABLE_BITS)
+    #define LIDARSYNTH_SCAN_TABLE_BITS 7
+#endif
+static_assert(LIDARSYNTH_SCAN_TABLE_BITS >= kScanTableMinBits && LIDARSYNTH_SCAN_TABLE_BITS <= kScanTableMaxBits,
+              "the scan table holds from 64 to 8192 bins");
+static const UInt32 kScanTableDefaultBits = LIDARSYNTH_SCAN_TABLE_BITS;
+static const std::int32_t kScanMaxDistance = 1000;	// cm; farther returns are clamped
+static const std::int32_t kScanFullCircle = 360000;	// sweep reports angles in milli-degrees
+static const UInt64 kCachedScanCaptureTime = 1;		// of a table restored from the last session (see ScanCache)
+static const UInt64 kOfflineClockStart = 1000000000;	// ns, an offline render's clock at its first frame (see LidarDeviceHub::CreateOffline)
+
+
+// which tables of a LidarScanTable the voices play
+enum OscillatorEngine
+{
+    kOscillatorEngine_Waveform = 0,		// mLevel: the distances themselves, with the scan's mean removed
+    kOscillatorEngine_Spectral = 1		// mSpectrum: the distances read as harmonic magnitudes
+};
+
+// the bits of a table of inSize bins, or 0 if inSize is not a power of two from 64 to 8192
+inline UInt32 ScanTableBitsForSize(UInt32 inSize)
+{
+    for (UInt32 bits = kScanTableMinBits; bits <= kScanTableMaxBits; ++bits)
+        if (inSize == 1U << bits)
+            return bits;
+    return 0;
+}
+
+// the level of a table of inBits with the same harmonics as level inLevel of a table of
+// kScanTableMaxSize bins (see ScanTableLevelForFrequency): a table of fewer bins keeps fewer
+// harmonics at each level, so it starts that many octaves further down
+inline UInt32 ScanTableLevel(UInt32 inLevel, UInt32 inBits)
+{
+    const UInt32 octaves = kScanTableMaxBits - inBits;
+    return inLevel > octaves ? std::min(inLevel - octaves, inBits - 1) : 0;
+}
+
+// how a LidarScanTable is laid out flat, for shared memory and files: this header, then every
+// level of mLevel and then every level of mSpectrum, each 1 << mBits values
+struct LidarScanTableHeader
+{
+    UInt64			mCaptureTime;
+    UInt32			mNumSamples;
+    UInt32			mBits;
+    ScanStatistics	mStats;
+};
+
+static const size_t kScanTableMaxFlatBytes = sizeof(LidarScanTableHeader)
+                                            + 2 * size_t(kScanTableMaxLevels) * kScanTableMaxSize * sizeof(Float32);
+
+/*
+ One scan resampled onto Size() equal angular bins, published as one snapshot by the LiDAR thread.
+ The levels live in one block sized by the table's bits: SetBits() and copying a table of another
+ size allocate, so both belong on the ingest thread, never the render thread. A copy between tables
+ of the same size only copies.
+ */
+struct LidarScanTable
+{
+    // a default table is the fallback played until the first scan arrives: a plain sine at half scale.
+    explicit LidarScanTable(UInt32 inBits = kScanTableDefaultBits) : mBits(0) { SetBits(inBits); }
+
+    LidarScanTable(const LidarScanTable &inOther) : mBits(0) { *this = inOther; }
+
+    LidarScanTable &	operator=(const LidarScanTable &inOther)
+    {
+        if (this == &inOther) return *this;
+        if (mBits != inOther.mBits)
+            Allocate(inOther.mBits);
+        std::copy(inOther.mStorage.begin(), inOther.mStorage.end(), mStorage.begin());
+        mCaptureTime = inOther.mCaptureTime;
+        mNumSamples = inOther.mNumSamples;
+        mStats = inOther.mStats;
+        return *this;
+    }
+
+    // resizes the table to 1 << inBits bins, clamped to the supported range, and resets it to the default sine
+    void			SetBits(UInt32 inBits)
+    {
+        Allocate(std::min(std::max(inBits, kScanTableMinBits), kScanTableMaxBits));
+        mCaptureTime = 0;
+        mNumSamples = 0;
+        const Float32 mid = kScanMaxDistance / 2;
+        const UInt32 size = Size();
+        // a single harmonic is band-limited at every level
+        for (UInt32 level = 0; level < Levels(); ++level)
+            for (UInt32 i = 0; i < size; ++i) {
+                Float32 sine = std::sin(Float32(i) * Float32(2.0 * M_PI / size));
+                mLevel[level][i] = mid * (1.f + 0.5f * sine);
+                mSpectrum[level][i] = sine;
+            }
+        mStats.mMean = mStats.mMedian = mid;
+        mStats.mRMS = mid * std::sqrt(1.125f);
+        mStats.mMin = 0.5f * mid;
+        mStats.mMax = 1.5f * mid;
+        mStats.mInverseMean = 1.f / mid;
+    }
+
+    UInt32			Bits() const { return mBits; }
+    UInt32			Size() const { return 1U << mBits; }
+    UInt32			Mask() const { return Size() - 1; }
+    UInt32			Levels() const { return mBits; }				// level L keeps harmonics up to Size() / 2 >> L
+    UInt32			Harmonics() const { return Size() / 2 - 1; }	// partials of a spectral table, below the Nyquist bin
+
+    // the level of this table with the same harmonics as level inLevel of the largest (see ScanTableLevel)
+    UInt32			Level(UInt32 inLevel) const { return ScanTableLevel(inLevel, mBits); }
+
+    size_t			FlatBytes() const { return sizeof(LidarScanTableHeader) + mStorage.size() * sizeof(Float32); }
+
+    // writes FlatBytes() bytes to outBytes
+    void			Flatten(void *outBytes) const
+    {
+        LidarScanTableHeader header;
+        header.mCaptureTime = mCaptureTime;
+        header.mNumSamples = mNumSamples;
+        header.mBits = mBits;
+        header.mStats = mStats;
+        memcpy(outBytes, &header, sizeof(header));
+        memcpy((char *)outBytes + sizeof(header), mStorage.data(), mStorage.size() * sizeof(Float32));
+    }
+
+    // false, leaving the table untouched, unless inBytes holds a whole flattened table of a supported size
+    bool			Unflatten(const void *inBytes, size_t inSize)
+    {
+        LidarScanTableHeader header;
+        if (inSize < sizeof(header)) return false;
+        memcpy(&header, inBytes, sizeof(header));
+        if (header.mBits < kScanTableMinBits || header.mBits > kScanTableMaxBits
+            || inSize < sizeof(header) + StorageSize(header.mBits) * sizeof(Float32))
+            return false;
+        if (mBits != header.mBits)
+            Allocate(header.mBits);
+        memcpy(mStorage.data(), (const char *)inBytes + sizeof(header), mStorage.size() * sizeof(Float32));
+        mCaptureTime = header.mCaptureTime;
+        mNumSamples = header.mNumSamples;
+        mStats = header.mStats;
+        return true;
+    }
+
+    UInt64          mCaptureTime;			// host time in nanoseconds of the scan; 0 until the first scan
+    UInt32          mNumSamples;			// samples in the scan this table was built from; 0 until the first scan
+    ScanStatistics  mStats;					// of the scan's clamped distances; mean and mInverseMean normalize the table
+    // level 0 is the clamped distance per bin, bin 0 starting at angle 0; higher levels are band-limited
+    // copies of it, one octave apart (see ScanMipMapBuilder). Levels() of them are in use.
+    Float32 *       mLevel[kScanTableMaxLevels];
+    // one cycle of the scan played as a spectral envelope instead of a waveform: zero mean, peak at
+    // most 1, with the same per-octave band limits as mLevel (see ScanMipMapBuilder::BuildSpectrum)
+    Float32 *       mSpectrum[kScanTableMaxLevels];
+
+private:
+    static size_t	StorageSize(UInt32 inBits) { return 2 * size_t(inBits) << inBits; }
+
+    void			Allocate(UInt32 inBits)
+    {
+        mBits = inBits;
+        mStorage.assign(StorageSize(inBits), 0.f);
+        const UInt32 size = Size();
+        for (UInt32 level = 0; level < kScanTableMaxLevels; ++level) {
+            mLevel[level] = level < inBits ? &mStorage[size_t(level) * size] : NULL;
+            mSpectrum[level] = level < inBits ? &mStorage[size_t(inBits + level) * size] : NULL;
+        }
+    }
+
+    UInt32			mBits;
+    std::vector<Float32> mStorage;
+};
+
+/*
+ ScanTableBuilder runs on the ingest thread. Feed it every sample of a scan with AddSample(), then
+ call Finish() to average each bin and fill empty bins by linear interpolation between their nearest
+ occupied neighbours (wrapping around the full circle). The samples arrive already clamped to
+ [0, kScanMaxDistance] by the ScanQualityFilter, so all the validation that used to happen per output
+ sample on the render thread happens once per scan, before the table is built.
+
+ The builder bins into 1 << Bits() bins, set by SetBits() between scans, and Finish() resizes a
+ table of another size to match.
+
+ Begin() can also restrict the table to a sector of inSpan milli-degrees starting at inStartAngle,
+ which is then spread over all the bins; samples outside it are ignored, and the table wraps from
+ the end of the sector back to its start.
+ */
+class ScanTableBuilder
+{
+public:
+    explicit ScanTableBuilder(UInt32 inBits = kScanTableDefaultBits) : mBits(0) { SetBits(inBits); }
+
+    void			SetBits(UInt32 inBits)
+    {
+        inBits = std::min(std::max(inBits, kScanTableMinBits), kScanTableMaxBits);
+        if (inBits == mBits) return;
+        mBits = inBits;
+        mSum.resize(1U << inBits);
+        mCount.resize(1U << inBits);
+        Begin();
+    }
+    UInt32			Bits() const { return mBits; }
+
+    void			Begin(std::int32_t inStartAngle = 0, std::int32_t inSpan = kScanFullCircle)
+    {
+        mStartAngle = inStartAngle % kScanFullCircle;
+        mSpan = inSpan;
+        mNumSamples = 0;
+        std::fill(mSum.begin(), mSum.end(), 0.f);
+        std::fill(mCount.begin(), mCount.end(), 0U);
+    }
+
+    // false if the sample lies outside the sector
+    bool			AddSample(std::int32_t inAngle, std::int32_t inDistance)
+    {
+        std::int32_t angle = (inAngle - mStartAngle) % kScanFullCircle;
+        if (angle < 0) angle += kScanFullCircle;
+        if (angle >= mSpan) return false;
+        UInt32 bin = UInt32(((std::int64_t)angle << mBits) / mSpan) & Mask();
+
+        mSum[bin] += Float32(inDistance);
+        mCount[bin]++;
+        mNumSamples++;
+        return true;
+    }
+
+    void			AddSamples(const std::int32_t *inAngles, const std::int32_t *inDistances, UInt32 inCount)
+    {
+        for (UInt32 i = 0; i < inCount; ++i)
+            AddSample(inAngles[i], inDistances[i]);
+    }
+
+    // writes level 0 of the finished table; returns false (and leaves outTable untouched) if the scan had no samples.
+    bool			Finish(LidarScanTable &outTable) const
+    {
+        if (mNumSamples == 0) return false;
+        if (outTable.Bits() != mBits)
+            outTable.SetBits(mBits);
+
+        // first occupied bin; there is at least one.
+        UInt32 first = 0;
+        while (mCount[first] == 0) ++first;
+
+        const UInt32 size = 1U << mBits, mask = Mask();
+        UInt32 prev = first;
+        Float32 prevValue = mSum[first] / mCount[first];
+        Float32 *table = outTable.mLevel[0];
+        table[first] = prevValue;
+
+        for (UInt32 step = 1; step <= size; ++step) {
+            UInt32 bin = (first + step) & mask;
+            if (mCount[bin] == 0 && step < size) continue;
+
+            Float32 value = mSum[bin] / mCount[bin];
+            UInt32 gap = step - ((prev - first) & mask);
+            for (UInt32 k = 1; k < gap; ++k)
+                table[(prev + k) & mask] = prevValue + (value - prevValue) * Float32(k) / Float32(gap);
+
+            table[bin] = value;
+            prev = bin;
+            prevValue = value;
+        }
+        outTable.mNumSamples = mNumSamples;
+        return true;
+    }
+
+private:
+    UInt32			Mask() const { return (1U << mBits) - 1; }
+
+    UInt32			mBits;
+    std::int32_t	mStartAngle;
+    std::int32_t	mSpan;
+    UInt32			mNumSamples;
+    std::vector<Float32> mSum;
+    std::vector<UInt32> mCount;
+};
+
+/*
+ How far a freshly binned level 0 of inSize bins has moved from another, as the sum of the absolute
+ differences of its bins in whole centimetres. Like ComputeScanStatistics it accumulates in integers,
+ so the compiler vectorizes the loop without reassociating floating point adds.
+ */
+inline UInt32 ScanTableChange(const Float32 *inLevel, const Float32 *inPrevious, UInt32 inSize)
+{
+    UInt32 change = 0;
+    for (UInt32 i = 0; i < inSize; ++i)
+        change += UInt32(std::abs(std::int32_t(inLevel[i]) - std::int32_t(inPrevious[i])));
+    return change;
+}
+
+#endif
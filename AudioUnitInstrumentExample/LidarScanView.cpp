@@ -0,0 +1,165 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Read-only shared-memory view of the hub's latest table and objects, for viewers to draw from
+ */
+
+#include "LidarScanView.h"
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char * const kLidarScanViewName = "/LidarSynth.view";
+static const UInt32 kLidarScanViewMagic = 'LdSv';
+static const UInt32 kLidarScanViewVersion = 2;
+
+static bool HasLayout(const LidarScanViewHeader &inHeader)
+{
+    return inHeader.mMagic == kLidarScanViewMagic && inHeader.mVersion == kLidarScanViewVersion
+        && inHeader.mFrameBytes == sizeof(LidarScanViewFrame) && inHeader.mTableSize == kScanTableMaxSize;
+}
+
+bool LidarScanViewWriter::Create()
+{
+    if (mSegment != NULL)
+        return true;
+
+    // readable by everyone, so that a viewer needs no rights to the host
+    int fd = shm_open(kLidarScanViewName, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (info.st_size < (off_t)sizeof(LidarScanViewSegment) && ftruncate(fd, sizeof(LidarScanViewSegment)) != 0)) {
+        close(fd);
+        return false;
+    }
+    void *memory = mmap(NULL, sizeof(LidarScanViewSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+
+    // every host with a hub tries to claim the view; the first one still running keeps it
+    LidarScanViewSegment *segment = (LidarScanViewSegment *)memory;
+    LidarScanViewHeader &header = segment->mHeader;
+    if (HasLayout(header)) {
+        pid_t owner = pid_t(header.mWriterPID.load(std::memory_order_relaxed));
+        if (owner != 0 && owner != getpid() && kill(owner, 0) == 0) {
+            munmap(memory, sizeof(LidarScanViewSegment));
+            return false;
+        }
+    }
+
+    // viewers that still map the segment see the magic go away while the layout is rewritten
+    header.mMagic = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    header.mVersion = kLidarScanViewVersion;
+    header.mFrameBytes = sizeof(LidarScanViewFrame);
+    header.mTableSize = kScanTableMaxSize;
+    header.mPublished.store(0, std::memory_order_relaxed);
+    for (UInt32 i = 0; i < kLidarScanViewFrames; ++i)
+        segment->mFrames[i].mSequence.store(0, std::memory_order_relaxed);
+    header.mWriterPID.store(UInt32(getpid()), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header.mMagic = kLidarScanViewMagic;
+
+    mSegment = segment;
+    return true;
+}
+
+void LidarScanViewWriter::Close()
+{
+    if (mSegment == NULL)
+        return;
+    mSegment->mHeader.mWriterPID.store(0, std::memory_order_release);
+    munmap(mSegment, sizeof(LidarScanViewSegment));
+    mSegment = NULL;
+}
+
+void LidarScanViewWriter::Publish(const LidarScanTable &inTable, const ScanObjectList &inObjects, UInt32 inState)
+{
+    if (mSegment == NULL)
+        return;
+    LidarScanViewHeader &header = mSegment->mHeader;
+    UInt64 published = header.mPublished.load(std::memory_order_relaxed);
+    LidarScanViewFrame &frame = mSegment->mFrames[published % kLidarScanViewFrames];
+
+    UInt32 sequence = frame.mSequence.load(std::memory_order_relaxed);
+    frame.mSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    frame.mState = inState;
+    frame.mCaptureTime = inTable.mCaptureTime;
+    frame.mNumSamples = inTable.mNumSamples;
+    frame.mStats = inTable.mStats;
+    // only the objects there are, not the whole list
+    frame.mObjects.mCaptureTime = inObjects.mCaptureTime;
+    frame.mObjects.mNumObjects = inObjects.mNumObjects;
+    memcpy(frame.mObjects.mObjects, inObjects.mObjects, inObjects.mNumObjects * sizeof(ScanObject));
+    frame.mNumBins = inTable.Size();
+    memcpy(frame.mLevel, inTable.mLevel[0], inTable.Size() * sizeof(Float32));
+
+    frame.mSequence.store(sequence + 2, std::memory_order_release);
+    header.mPublished.store(published + 1, std::memory_order_release);
+}
+
+bool LidarScanViewReader::Open()
+{
+    if (mSegment != NULL)
+        return true;
+
+    int fd = shm_open(kLidarScanViewName, O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(LidarScanViewSegment)) {
+        close(fd);
+        return false;
+    }
+    void *memory = mmap(NULL, sizeof(LidarScanViewSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED)
+        return false;
+
+    const LidarScanViewSegment *segment = (const LidarScanViewSegment *)memory;
+    if (!HasLayout(segment->mHeader)) {
+        munmap(memory, sizeof(LidarScanViewSegment));
+        return false;
+    }
+    mSegment = segment;
+    return true;
+}
+
+void LidarScanViewReader::Close()
+{
+    if (mSegment == NULL)
+        return;
+    munmap((void *)mSegment, sizeof(LidarScanViewSegment));
+    mSegment = NULL;
+}
+
+bool LidarScanViewReader::IsLive() const
+{
+    return mSegment != NULL && HasLayout(mSegment->mHeader) && mSegment->mHeader.mWriterPID.load(std::memory_order_acquire) != 0;
+}
+
+const LidarScanViewFrame *LidarScanViewReader::BeginRead(UInt32 &outSequence) const
+{
+    if (mSegment == NULL)
+        return NULL;
+    UInt64 published = mSegment->mHeader.mPublished.load(std::memory_order_acquire);
+    if (published == 0)
+        return NULL;
+    const LidarScanViewFrame &frame = mSegment->mFrames[(published - 1) % kLidarScanViewFrames];
+    outSequence = frame.mSequence.load(std::memory_order_acquire);
+    return (outSequence & 1) ? NULL : &frame;
+}
+
+bool LidarScanViewReader::EndRead(const LidarScanViewFrame *inFrame, UInt32 inSequence) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return inFrame->mSequence.load(std::memory_order_relaxed) == inSequence;
+}
@@ -0,0 +1,123 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Read-only shared-memory view of the hub's latest table and objects, for viewers to draw from
+ */
+
+#ifndef __LidarScanView_h__
+#define __LidarScanView_h__
+
+#include "LidarScanTable.h"
+#include "ScanObjects.h"
+#include <atomic>
+
+static const UInt32 kLidarScanViewFrames = 2;		// the writer alternates between them
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "the view's counters are shared between processes, so they must not hide a lock");
+
+/*
+ The view lives in the named POSIX shared memory segment "/LidarSynth.view". The ingest thread of
+ one LidarDeviceHub on the machine, the first to claim it, writes every scan it processes there:
+ level 0 of the table as binned, mNumBins of it at whatever resolution the hub builds, the
+ statistics of the last table it built, and the objects its ScanObjectTracker follows, along with
+ its device state. A viewer, the libsweep example-viewer or a
+ custom Cocoa view of the synth, maps the segment read-only and draws from it at display rate,
+ without polling the AU's properties and without any call into it; nothing it does can reach the
+ host or disturb the hub.
+
+ The segment holds kLidarScanViewFrames frames, each with its own sequence count, a seqlock: the
+ writer makes it odd, fills the frame and makes it even again, then bumps the header's count of
+ published frames. A viewer reads the newest frame in place rather than copying it. BeginRead()
+ hands it over along with its count, the viewer draws straight from the mapping, and EndRead() tells
+ it whether the frame was rewritten meanwhile, in which case it draws again next time. The writer
+ only comes back to a frame a whole scan later, so a viewer that draws within a scan period never
+ loses the race in practice.
+
+ Neither side allocates after Create() or Open(). Nothing here is for the render thread.
+ */
+struct LidarScanViewFrame
+{
+    std::atomic<UInt32>	mSequence;			// odd while the hub writes the frame
+    UInt32				mState;				// LidarDeviceState of the hub
+    UInt64				mCaptureTime;		// host time in nanoseconds of the scan
+    UInt32				mNumSamples;		// in the last table built
+    UInt32				mNumBins;			// of mLevel in use, the size of the table played
+    ScanStatistics		mStats;				// of the last table built
+    ScanObjectList		mObjects;			// tracked through this scan
+    Float32				mLevel[kScanTableMaxSize];	// the scan's clamped distance per bin, bin 0 starting at angle 0
+};
+
+struct LidarScanViewHeader
+{
+    UInt32				mMagic;
+    UInt32				mVersion;
+    UInt32				mFrameBytes;		// sizeof(LidarScanViewFrame) of the writer, to catch mismatched builds
+    UInt32				mTableSize;			// kScanTableMaxSize of the writer
+    std::atomic<UInt32>	mWriterPID;			// 0 once the hub has let the view go
+    std::atomic<UInt64>	mPublished;			// frames written so far; the newest is mFrames[(mPublished - 1) % kLidarScanViewFrames]
+};
+
+struct LidarScanViewSegment
+{
+    LidarScanViewHeader	mHeader;
+    LidarScanViewFrame	mFrames[kLidarScanViewFrames];
+};
+
+// the hub's side; only one process on the machine writes the view at a time
+class LidarScanViewWriter
+{
+public:
+    LidarScanViewWriter() : mSegment(NULL) {}
+    ~LidarScanViewWriter() { Close(); }
+
+    // creates the segment, or takes over one a previous writer left; false if another live process owns it
+    bool				Create();
+    // marks the view abandoned; the segment stays for the next writer
+    void				Close();
+    bool				IsOpen() const { return mSegment != NULL; }
+
+    // inTable's level 0 and statistics, with the objects tracked through the same scan
+    void				Publish(const LidarScanTable &inTable, const ScanObjectList &inObjects, UInt32 inState);
+
+private:
+    LidarScanViewWriter(const LidarScanViewWriter &);
+    LidarScanViewWriter & operator=(const LidarScanViewWriter &);
+
+    LidarScanViewSegment *	mSegment;
+};
+
+// a viewer's side, read-only
+class LidarScanViewReader
+{
+public:
+    LidarScanViewReader() : mSegment(NULL) {}
+    ~LidarScanViewReader() { Close(); }
+
+    // maps the segment if a hub has created one of this build's layout
+    bool				Open();
+    void				Close();
+    bool				IsOpen() const { return mSegment != NULL; }
+
+    // whether a hub is still writing the view
+    bool				IsLive() const;
+    // frames published so far; a viewer with nothing new to draw can skip the frame
+    UInt64				Published() const { return mSegment ? mSegment->mHeader.mPublished.load(std::memory_order_acquire) : 0; }
+
+    /*
+     The newest frame, to be read in place, or NULL if nothing has been published yet or the frame
+     is being written. outSequence receives its count for EndRead(), which returns false if the frame
+     changed while it was read, in which case whatever was drawn from it is to be thrown away.
+     */
+    const LidarScanViewFrame *	BeginRead(UInt32 &outSequence) const;
+    bool				EndRead(const LidarScanViewFrame *inFrame, UInt32 inSequence) const;
+
+private:
+    LidarScanViewReader(const LidarScanViewReader &);
+    LidarScanViewReader & operator=(const LidarScanViewReader &);
+
+    const LidarScanViewSegment *	mSegment;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ ZeroMQ fan-out of processed scan tables, for rigs where one host owns the sensor
+ */
+
+#include "LidarTableNetwork.h"
+#include <algorithm>
+#include <cstddef>
+
+static const UInt32 kLidarTableMagic = 'LStb';
+static const UInt32 kLidarTableVersion = 2;
+static const Float32 kLidarTableQuantum = Float32(kScanMaxDistance) / 65535.f;
+
+// ZMQ_CONFLATE keeps one message per pipe in place of the high-water mark
+static void SetQueueing(zmq::socket_t &inSocket, bool inConflate, int inHighWaterOption)
+{
+    int linger = 0;
+    inSocket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+    if (inConflate) {
+        int conflate = 1;
+        inSocket.setsockopt(ZMQ_CONFLATE, &conflate, sizeof(conflate));
+    } else {
+        int highWaterMark = 2;
+        inSocket.setsockopt(inHighWaterOption, &highWaterMark, sizeof(highWaterMark));
+    }
+}
+
+LidarTablePublisher::LidarTablePublisher(const char *inEndpoint, bool inConflate)
+: mContext(1), mSocket(mContext, ZMQ_PUB)
+{
+    mMessage.mMagic = kLidarTableMagic;
+    mMessage.mVersion = kLidarTableVersion;
+    mMessage.mSequence = 0;
+    SetQueueing(mSocket, inConflate, ZMQ_SNDHWM);
+    mSocket.bind(inEndpoint);
+}
+
+// the bytes of a message of 1 << inBits bins
+static size_t MessageSize(UInt32 inBits)
+{
+    return offsetof(LidarTableMessage, mBins) + (size_t(sizeof(UInt16)) << inBits);
+}
+
+void LidarTablePublisher::Send(const LidarScanTable &inTable)
+{
+    const Float32 scale = 1.f / kLidarTableQuantum;
+    for (UInt32 i = 0; i < inTable.Size(); ++i) {
+        Float32 value = std::min(std::max(inTable.mLevel[0][i], 0.f), Float32(kScanMaxDistance));
+        mMessage.mBins[i] = UInt16(value * scale + 0.5f);
+    }
+    mMessage.mStats = inTable.mStats;
+    mMessage.mNumSamples = inTable.mNumSamples;
+    mMessage.mBits = inTable.Bits();
+    mMessage.mSequence++;
+    mSocket.send(&mMessage, MessageSize(mMessage.mBits), ZMQ_DONTWAIT);
+}
+
+LidarTableSource::LidarTableSource(const char *inEndpoint, bool inConflate)
+: mContext(1), mSocket(mContext, ZMQ_SUB), mTimeout(-1), mBits(0)
+{
+    mMessage.mSequence = 0;
+    std::fill(mDistances, mDistances + kScanTableMaxSize, 0);
+    SetQueueing(mSocket, inConflate, ZMQ_RCVHWM);
+    mSocket.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+    mSocket.connect(inEndpoint);
+}
+
+bool LidarTableSource::Receive(int inTimeoutMs, LidarScanTable &outTable)
+{
+    if (inTimeoutMs != mTimeout) {
+        mSocket.setsockopt(ZMQ_RCVTIMEO, &inTimeoutMs, sizeof(inTimeoutMs));
+        mTimeout = inTimeoutMs;
+    }
+    // recv() reports the full message size even when it had to truncate the copy
+    size_t size = mSocket.recv(&mMessage, sizeof(mMessage));
+    if (size < offsetof(LidarTableMessage, mBins) || size > sizeof(mMessage)
+        || mMessage.mMagic != kLidarTableMagic || mMessage.mVersion != kLidarTableVersion
+        || mMessage.mBits < kScanTableMinBits || mMessage.mBits > kScanTableMaxBits || size != MessageSize(mMessage.mBits))
+        return false;
+
+    if (mMessage.mBits != mBits) {
+        mBits = mMessage.mBits;
+        const UInt32 numBins = 1U << mBits;
+        for (UInt32 i = 0; i < numBins; ++i)
+            mAngles[i] = std::int32_t((2 * i + 1) * std::int64_t(kScanFullCircle) / (2 * numBins));
+    }
+    if (outTable.Bits() != mBits)
+        outTable.SetBits(mBits);
+    for (UInt32 i = 0; i < outTable.Size(); ++i) {
+        Float32 value = Float32(mMessage.mBins[i]) * kLidarTableQuantum;
+        outTable.mLevel[0][i] = value;
+        mDistances[i] = std::int32_t(value + 0.5f);
+    }
+    outTable.mStats = mMessage.mStats;
+    outTable.mNumSamples = mMessage.mNumSamples;
+    return true;
+}
@@ -0,0 +1,93 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ ZeroMQ fan-out of processed scan tables, for rigs where one host owns the sensor
+ */
+
+#ifndef __LidarTableNetwork_h__
+#define __LidarTableNetwork_h__
+
+#include "LidarScanTable.h"
+#include <zmq.hpp>
+#include <cstdint>
+
+/*
+ A LidarTableMessage is one binned scan as the publishing host built it: level 0 of its table with
+ each bin quantized to 16 bits over [0, kScanMaxDistance], and the statistics of the raw scan it came
+ from. That is a few hundred bytes a scan against several kilobytes for the raw sweep samples, and
+ the subscriber only has to rebuild the mip-map levels and the spectrum (ScanMipMapBuilder), which it
+ would do for a table of its own anyway. Only the publisher's mBits bins of mBins are sent. Fields
+ are sent in host byte order; every Mac in the rig is little-endian.
+
+ Capture times are not sent, since the hosts' clocks are unrelated: the subscriber stamps each table
+ on arrival, as LidarNetworkSource does. mSequence lets it notice dropped or conflated tables.
+ */
+struct LidarTableMessage
+{
+    UInt32			mMagic;
+    UInt32			mVersion;
+    UInt32			mSequence;			// counts the publisher's tables
+    UInt32			mNumSamples;		// of the scan the table was built from
+    UInt32			mBits;				// of the publisher's table, which has 1 << mBits bins
+    ScanStatistics	mStats;
+    UInt16			mBins[kScanTableMaxSize];
+};
+
+/*
+ LidarTablePublisher binds a ZMQ PUB socket and sends one LidarTableMessage per table. Send() never
+ blocks: ZMQ drops a message for a subscriber whose queue is full. With inConflate each subscriber's
+ queue holds only the newest table, so a slow host always gets the latest scan rather than a
+ backlog. Binding throws zmq::error_t, for example when another process already has the port.
+ */
+class LidarTablePublisher
+{
+public:
+    LidarTablePublisher(const char *inEndpoint, bool inConflate);
+
+    void					Send(const LidarScanTable &inTable);
+
+private:
+    LidarTablePublisher(const LidarTablePublisher &);
+    LidarTablePublisher & operator=(const LidarTablePublisher &);
+
+    zmq::context_t			mContext;
+    zmq::socket_t			mSocket;
+    LidarTableMessage		mMessage;
+};
+
+/*
+ LidarTableSource subscribes to a LidarTablePublisher. Receive() decodes level 0, the statistics and
+ the sample count into a table of the caller's, resized to the publisher's resolution; the caller
+ builds the other levels, or bins the table again at a resolution of its own. Since zones and scan
+ features work from samples, Angles() and Distances() also give one sample per bin, at the centre of
+ its angle, standing in for the scan the publisher saw. Nothing allocates after construction unless
+ the publisher's resolution changes, and a message of the wrong size or version is dropped.
+ */
+class LidarTableSource
+{
+public:
+    LidarTableSource(const char *inEndpoint, bool inConflate);
+
+    // waits at most inTimeoutMs for the next table. Returns false on timeout or a malformed message.
+    bool					Receive(int inTimeoutMs, LidarScanTable &outTable);
+
+    UInt32					NumSamples() const { return mBits ? 1U << mBits : 0; }
+    const std::int32_t *	Angles() const { return mAngles; }
+    const std::int32_t *	Distances() const { return mDistances; }
+    UInt32					Sequence() const { return mMessage.mSequence; }
+
+private:
+    LidarTableSource(const LidarTableSource &);
+    LidarTableSource & operator=(const LidarTableSource &);
+
+    zmq::context_t			mContext;
+    zmq::socket_t			mSocket;
+    LidarTableMessage		mMessage;
+    int						mTimeout;
+    UInt32					mBits;				// of the last table received
+    std::int32_t			mAngles[kScanTableMaxSize];
+    std::int32_t			mDistances[kScanTableMaxSize];
+};
+
+#endif
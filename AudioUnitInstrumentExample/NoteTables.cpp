@@ -0,0 +1,53 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-instrument lookup tables that turn a note-on and a render block into table loads
+ */
+
+#include "NoteTables.h"
+#include <cmath>
+
+NoteTables::NoteTables()
+    : mCurve(kVelocityCurve_Cubed), mSampleRate(0.), mAttackSeconds(0.f), mReleaseSeconds(0.f),
+      mAttackStep(0.f), mReleaseStep(0.f), mFastReleaseStep(0.f)
+{
+    SetVelocityCurve(kVelocityCurve_Cubed);
+    SetSampleRate(44100.);
+}
+
+void NoteTables::SetVelocityCurve(VelocityCurve inCurve)
+{
+    mCurve = inCurve;
+    for (UInt32 velocity = 0; velocity < kNoteTableKeys; ++velocity) {
+        Float32 v = Float32(velocity) / Float32(kNoteTableKeys - 1);
+        switch (inCurve) {
+            case kVelocityCurve_Linear :	mPeak[velocity] = kNoteVelocityPeak * v; break;
+            case kVelocityCurve_Squared :	mPeak[velocity] = kNoteVelocityPeak * v * v; break;
+            case kVelocityCurve_Fixed :		mPeak[velocity] = kNoteVelocityPeak; break;
+            default :						mPeak[velocity] = kNoteVelocityPeak * v * v * v; break;
+        }
+    }
+}
+
+void NoteTables::SetSampleRate(Float64 inSampleRate)
+{
+    mSampleRate = inSampleRate;
+    for (UInt32 key = 0; key < kNoteTableKeys; ++key) {
+        double frequency = 440. * pow(2., (double(key) - 69.) / 12.);
+        mIncrement[key] = WavetablePhaseIncrement(frequency / inSampleRate);
+        mTableLevel[key] = ScanTableLevelForFrequency(frequency, inSampleRate);
+    }
+    UpdateSteps(mAttackSeconds, mReleaseSeconds);
+}
+
+// a time of 0 makes the step infinite, which VoiceEnvelope takes as reaching the target at once
+void NoteTables::UpdateSteps(Float32 inAttackSeconds, Float32 inReleaseSeconds)
+{
+    const Float32 sampleRate = Float32(mSampleRate);
+    mAttackSeconds = inAttackSeconds;
+    mReleaseSeconds = inReleaseSeconds;
+    mAttackStep = 1.f / (inAttackSeconds * sampleRate);
+    mReleaseStep = 1.f / (inReleaseSeconds * sampleRate);
+    mFastReleaseStep = 1.f / (kFastReleaseSeconds * sampleRate);
+}
@@ -0,0 +1,104 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-instrument lookup tables that turn a note-on and a render block into table loads
+ */
+
+#ifndef __NoteTables_h__
+#define __NoteTables_h__
+
+#include "WavetableVoice.h"
+#include "ScanMipMap.h"
+
+static const UInt32 kNoteTableKeys = 128;			// MIDI keys and velocities
+static const Float32 kNoteVelocityPeak = 0.4f;		// envelope peak at full velocity
+static const Float32 kFastReleaseSeconds = 0.005f;	// used when a voice is stolen
+
+// how a note's velocity sets its envelope's peak
+enum VelocityCurve
+{
+    kVelocityCurve_Linear = 0,
+    kVelocityCurve_Squared = 1,
+    kVelocityCurve_Cubed = 2,		// the default; soft playing stays soft
+    kVelocityCurve_Fixed = 3,		// every note at full level
+    kNumVelocityCurves
+};
+
+// a part's envelope change per frame for a peak of 1 (see NoteTables::Envelope())
+struct PartEnvelope
+{
+    Float32			mAttackStep;
+    Float32			mReleaseStep;
+};
+
+/*
+ NoteTables holds what a note-on and a voice's render block used to work out with pow() and
+ divisions: the envelope peak for each velocity under the chosen curve, and the phase increment and
+ mip-map level for each MIDI key at the voices' rate (A = 440 Hz, no bend). The envelope's change
+ per frame is kept per unit of peak for the attack, release and fast-release times, so a block's
+ step is one multiply by the note's peak.
+
+ SetVelocityCurve() and SetSampleRate() fill a table of 128 entries each; call them off the render
+ thread, or on it only when the rate really changes. SetEnvelopeTimes() is meant for every render
+ cycle and does nothing unless the times have moved. Keys with a fractional pitch or a pitch bend are
+ not covered (see Covers()) and the caller works them out itself.
+ */
+class NoteTables
+{
+public:
+    NoteTables();
+
+    void			SetVelocityCurve(VelocityCurve inCurve);
+    VelocityCurve	Curve() const { return mCurve; }
+
+    // the rate the voices are rendered at, oversampling included
+    void			SetSampleRate(Float64 inSampleRate);
+    Float64			SampleRate() const { return mSampleRate; }
+
+    void			SetEnvelopeTimes(Float32 inAttackSeconds, Float32 inReleaseSeconds)
+    {
+        if (inAttackSeconds != mAttackSeconds || inReleaseSeconds != mReleaseSeconds)
+            UpdateSteps(inAttackSeconds, inReleaseSeconds);
+    }
+
+    Float32			Peak(UInt32 inVelocity) const { return mPeak[std::min(inVelocity, kNoteTableKeys - 1)]; }
+
+    // whether a note at inPitch, under inPitchBend semitones of bend, plays a key of the tables
+    static bool		Covers(Float32 inPitch, Float32 inPitchBend)
+    {
+        return inPitchBend == 0.f && inPitch >= 0.f && inPitch < Float32(kNoteTableKeys) && inPitch == Float32(UInt32(inPitch));
+    }
+    UInt32			Increment(UInt32 inKey) const { return mIncrement[inKey]; }
+    UInt32			TableLevel(UInt32 inKey) const { return mTableLevel[inKey]; }
+
+    // envelope change per frame for a peak of 1
+    Float32			AttackStep() const { return mAttackStep; }
+    Float32			ReleaseStep() const { return mReleaseStep; }
+    Float32			FastReleaseStep() const { return mFastReleaseStep; }
+
+    // the steps for a part's own times; a time of 0 keeps the one SetEnvelopeTimes() set
+    PartEnvelope	Envelope(Float32 inAttackSeconds, Float32 inReleaseSeconds) const
+    {
+        const Float32 sampleRate = Float32(mSampleRate);
+        PartEnvelope envelope = { inAttackSeconds > 0.f ? 1.f / (inAttackSeconds * sampleRate) : mAttackStep,
+                                  inReleaseSeconds > 0.f ? 1.f / (inReleaseSeconds * sampleRate) : mReleaseStep };
+        return envelope;
+    }
+
+private:
+    void			UpdateSteps(Float32 inAttackSeconds, Float32 inReleaseSeconds);
+
+    VelocityCurve	mCurve;
+    Float64			mSampleRate;
+    Float32			mAttackSeconds;
+    Float32			mReleaseSeconds;
+    Float32			mAttackStep;
+    Float32			mReleaseStep;
+    Float32			mFastReleaseStep;
+    Float32			mPeak[kNoteTableKeys];
+    UInt32			mIncrement[kNoteTableKeys];
+    UInt32			mTableLevel[kNoteTableKeys];
+};
+
+#endif
@@ -0,0 +1,247 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Plucked-string voices whose delay lines are seeded from the scan, in one preallocated arena
+ */
+
+#include "PluckVoiceBank.h"
+#include <algorithm>
+#include <cmath>
+
+void PluckVoiceBank::Resize(UInt32 inCount, Float64 inSampleRate)
+{
+    mSampleRate = inSampleRate;
+    mBlockPole = Float32(1. - 2. * M_PI * kPluckBlockFrequency / inSampleRate);
+    mLineFrames = UInt32(std::ceil(inSampleRate / kPluckMinFrequency)) + 1;
+    mArena.assign(size_t(inCount) * mLineFrames, 0.f);
+    mLength.assign(inCount, 1);
+    mPosition.assign(inCount, 0);
+    mLoss.assign(inCount, 0.f);
+    mTuning.assign(inCount, 0.f);
+    mLast.assign(inCount, 0.f);
+    mTuningIn.assign(inCount, 0.f);
+    mTuningOut.assign(inCount, 0.f);
+    mBlockIn.assign(inCount, 0.f);
+    mBlockOut.assign(inCount, 0.f);
+    mDecay.assign(inCount, 0.f);
+    mDecayPerFrame.assign(inCount, 0.f);
+    mTable.assign(inCount, kFullScanTable);
+    mEnvelope.assign(inCount, VoiceEnvelope());
+    mStep.assign(inCount, 0.f);
+    mMode.assign(inCount, UInt8(kVoiceEnvelope_Rising));
+}
+
+void PluckVoiceBank::Start(UInt32 inSlot, const LidarScanZones &inZones, UInt32 inTable, UInt32 inTableLevel,
+                           Float64 inFrequency, Float32 inPeak)
+{
+    // the average delays the loop by half a sample and the allpass by 0.1 to 1.1 of one, the range
+    // over which its delay stays flat across the harmonics
+    const Float64 period = mSampleRate / std::max(inFrequency, kPluckMinFrequency);
+    const Float64 lineDelay = period - 0.5;
+    const UInt32 length = std::min(UInt32(std::max(std::floor(lineDelay - 0.1), 1.)), mLineFrames);
+    const Float64 fraction = std::max(lineDelay - length, 0.1);
+    mLength[inSlot] = length;
+    mTuning[inSlot] = Float32((1. - fraction) / (1. + fraction));
+    mLoss[inSlot] = Float32(std::pow(10., -3. * period / (kPluckSustainSeconds * mSampleRate)));
+    // the fundamental loses the loss and the average's gain at its frequency on every pass
+    const Float64 passGain = mLoss[inSlot] * std::fabs(std::cos(M_PI / period));
+    mDecayPerFrame[inSlot] = Float32(std::pow(passGain, 1. / period));
+    mDecay[inSlot] = 1.f;
+
+    // one cycle of the table, slice-resampled onto the line's length, normalized as the wavetable
+    // voices normalize it
+    const LidarScanTable &table = inZones.Table(inTable);
+    const Float32 *source = table.mLevel[table.Level(inTableLevel)];
+    const Float32 offset = table.mStats.mMean, gain = table.mStats.mInverseMean;
+    const UInt32 shift = 32 - table.Bits(), mask = table.Mask();
+    const Float32 fractionScale = 1.f / Float32(1U << shift);
+    const UInt32 increment = UInt32(std::min(4294967296.0 / length, 4294967295.0));
+    Float32 *line = &mArena[size_t(inSlot) * mLineFrames];
+    UInt32 phase = 0;
+    Float32 sum = 0.f;
+    for (UInt32 i = 0; i < length; ++i, phase += increment) {
+        const UInt32 index = phase >> shift;
+        const Float32 a = source[index], b = source[(index + 1) & mask];
+        line[i] = (a + (b - a) * Float32(phase & ((1U << shift) - 1)) * fractionScale - offset) * gain;
+        sum += line[i];
+    }
+    // the loop passes DC all but untouched, so a short line's rounding off the table's mean would
+    // outlast the note
+    const Float32 mean = sum / Float32(length);
+    for (UInt32 i = 0; i < length; ++i)
+        line[i] -= mean;
+    mPosition[inSlot] = 0;
+    mLast[inSlot] = line[length - 1];
+    mTuningIn[inSlot] = mTuningOut[inSlot] = 0.f;
+    mBlockIn[inSlot] = mBlockOut[inSlot] = 0.f;
+    mTable[inSlot] = inTable;
+    mEnvelope[inSlot].Start(inPeak);
+}
+
+// scales a block's ramp by the channel's gain, ramping between its control points as it does for the
+// wavetable voices; the block starts inCyclePosition frames into the cycle, at the voices' rate
+static void ApplyModulationGain(const ControlRateModulation &inModulation, UInt32 inCyclePosition, UInt32 inOversampling,
+                                Float32 *ioRamp, UInt32 inNumFrames)
+{
+    if (inModulation.IsStatic()) {
+        const Float32 gain = inModulation.Gain(0);
+        if (gain != 1.f)
+            for (UInt32 i = 0; i < inNumFrames; ++i)
+                ioRamp[i] *= gain;
+        return;
+    }
+    const UInt32 periodFrames = kControlRateFrames * inOversampling;
+    for (UInt32 start = 0, length = 0; start < inNumFrames; start += length) {
+        const UInt32 position = inCyclePosition + start;
+        const UInt32 point = std::min(position / periodFrames, inModulation.NumPoints() - 2);
+        const UInt32 pointFrames = inModulation.PeriodFrames(point) * inOversampling;
+        const UInt32 periodEnd = point * periodFrames + pointFrames;
+        length = inNumFrames - start;
+        if (periodEnd > position)
+            length = std::min(length, periodEnd - position);
+        const Float32 into = Float32(position - point * periodFrames);
+        const Float32 gain = inModulation.Gain(point);
+        const Float32 gainStep = (inModulation.Gain(point + 1) - gain) / Float32(pointFrames);
+        for (UInt32 i = 0; i < length; ++i)
+            ioRamp[start + i] *= gain + gainStep * (into + Float32(i));
+    }
+}
+
+// one string's loop state, in registers for the length of a block
+struct PluckString
+{
+    Float32 *		line;
+    UInt32			length, position;
+    Float32			loss, tuning, last, tuningIn, tuningOut;
+    Float32			blockIn, blockOut;		// the DC blocker's previous input and output
+};
+
+/*
+ Runs kStrings strings together for inNumFrames frames, each scaled by its own ramp, and adds them
+ into the output. A string's allpass feeds back on itself every frame, so one string at a time waits
+ out the latency of that chain; interleaving the strings of a batch lets their chains overlap.
+ */
+template <UInt32 kStrings, bool kStereo>
+static void RunPluckStrings(PluckString *ioStrings, const Float32 (*inRamps)[kVoiceEnvelopeMaxFrames], Float32 inBlockPole,
+                            Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    // each field in an array of its own, so the compiler keeps them in registers
+    Float32 *line[kStrings];
+    UInt32 length[kStrings], position[kStrings];
+    Float32 loss[kStrings], tuning[kStrings], last[kStrings], tuningIn[kStrings], tuningOut[kStrings];
+    Float32 blockIn[kStrings], blockOut[kStrings];
+    for (UInt32 k = 0; k < kStrings; ++k) {
+        line[k] = ioStrings[k].line;
+        length[k] = ioStrings[k].length;
+        position[k] = ioStrings[k].position;
+        loss[k] = ioStrings[k].loss;
+        tuning[k] = ioStrings[k].tuning;
+        last[k] = ioStrings[k].last;
+        tuningIn[k] = ioStrings[k].tuningIn;
+        tuningOut[k] = ioStrings[k].tuningOut;
+        blockIn[k] = ioStrings[k].blockIn;
+        blockOut[k] = ioStrings[k].blockOut;
+    }
+    for (UInt32 i = 0; i < inNumFrames; ++i) {
+        Float32 mix = 0.f;
+        for (UInt32 k = 0; k < kStrings; ++k) {
+            const Float32 x = line[k][position[k]];
+            const Float32 averaged = loss[k] * (x + last[k]);
+            last[k] = x;
+            const Float32 tuned = tuning[k] * (averaged - tuningOut[k]) + tuningIn[k];
+            tuningIn[k] = averaged;
+            tuningOut[k] = tuned;
+            line[k][position[k]] = tuned;
+            // a high note wraps every few frames, too often to leave to the branch predictor
+            const UInt32 next = position[k] + 1;
+            position[k] = next == length[k] ? 0 : next;
+            const Float32 blocked = x - blockIn[k] + inBlockPole * blockOut[k];
+            blockIn[k] = x;
+            blockOut[k] = blocked;
+            mix += blocked * inRamps[k][i];
+        }
+        ioLeft[i] += mix;
+        if (kStereo) ioRight[i] += mix;
+    }
+    for (UInt32 k = 0; k < kStrings; ++k) {
+        ioStrings[k].position = position[k];
+        ioStrings[k].last = last[k];
+        ioStrings[k].tuningIn = tuningIn[k];
+        ioStrings[k].tuningOut = tuningOut[k];
+        ioStrings[k].blockIn = blockIn[k];
+        ioStrings[k].blockOut = blockOut[k];
+    }
+}
+
+template <bool kStereo>
+static void RunPluckStrings(UInt32 inNumStrings, PluckString *ioStrings, const Float32 (*inRamps)[kVoiceEnvelopeMaxFrames],
+                            Float32 inBlockPole, Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    switch (inNumStrings) {
+        case 1: RunPluckStrings<1, kStereo>(ioStrings, inRamps, inBlockPole, ioLeft, ioRight, inNumFrames); break;
+        case 2: RunPluckStrings<2, kStereo>(ioStrings, inRamps, inBlockPole, ioLeft, ioRight, inNumFrames); break;
+        case 3: RunPluckStrings<3, kStereo>(ioStrings, inRamps, inBlockPole, ioLeft, ioRight, inNumFrames); break;
+        case 4: RunPluckStrings<4, kStereo>(ioStrings, inRamps, inBlockPole, ioLeft, ioRight, inNumFrames); break;
+    }
+}
+
+template <bool kStereo>
+void PluckVoiceBank::Render(const SmoothedParameter &inVolume, const ControlRateModulation &inModulation,
+                            UInt32 inCycleFrame, const UInt32 *inSlots, UInt32 inNumSlots, UInt32 *outEndFrames,
+                            Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames, UInt32 inOversampling)
+{
+    Float32 ramps[kPluckBatch][kVoiceEnvelopeMaxFrames];
+    PluckString strings[kPluckBatch];
+    const Float32 gain = std::max(inVolume.Start(), inVolume.Value()) * inModulation.MaxGain();
+    for (UInt32 first = 0; first < inNumSlots; first += kPluckBatch) {
+        const UInt32 count = std::min(inNumSlots - first, kPluckBatch);
+        for (UInt32 k = 0; k < count; ++k) {
+            const UInt32 slot = inSlots[first + k];
+            // the average's halving is folded into the loss
+            PluckString string = { &mArena[size_t(slot) * mLineFrames], mLength[slot], mPosition[slot], 0.5f * mLoss[slot],
+                                   mTuning[slot], mLast[slot], mTuningIn[slot], mTuningOut[slot], mBlockIn[slot], mBlockOut[slot] };
+            strings[k] = string;
+            outEndFrames[first + k] = inNumFrames;
+        }
+        for (UInt32 frame = 0; frame < inNumFrames; frame += kVoiceEnvelopeMaxFrames) {
+            const UInt32 numFrames = std::min(inNumFrames - frame, kVoiceEnvelopeMaxFrames);
+            for (UInt32 k = 0; k < count; ++k) {
+                const UInt32 slot = inSlots[first + k];
+                if (mMode[slot] == kVoiceEnvelope_Rising) {
+                    mEnvelope[slot].Ramp<kVoiceEnvelope_Rising>(mStep[slot], ramps[k], numFrames);
+                } else {
+                    // the decay as the block started, which is at least what it is now
+                    const Float32 envelopeFloor = mFloor > 0.f ? VoiceEnvelope::Floor(mFloor, gain * mDecay[slot]) : 0.f;
+                    const UInt32 sounding = mEnvelope[slot].Ramp<kVoiceEnvelope_Falling>(mStep[slot], ramps[k], numFrames, envelopeFloor);
+                    if (sounding < numFrames)
+                        outEndFrames[first + k] = std::min(outEndFrames[first + k], frame + sounding);
+                }
+                inVolume.Apply(ramps[k], frame, numFrames);
+                ApplyModulationGain(inModulation, inCycleFrame * inOversampling + frame, inOversampling, ramps[k], numFrames);
+            }
+            RunPluckStrings<kStereo>(count, strings, ramps, mBlockPole, ioLeft + frame, kStereo ? ioRight + frame : NULL, numFrames);
+        }
+        for (UInt32 k = 0; k < count; ++k) {
+            const UInt32 slot = inSlots[first + k];
+            mPosition[slot] = strings[k].position;
+            mLast[slot] = strings[k].last;
+            mTuningIn[slot] = strings[k].tuningIn;
+            mTuningOut[slot] = strings[k].tuningOut;
+            mBlockIn[slot] = strings[k].blockIn;
+            mBlockOut[slot] = strings[k].blockOut;
+            // the fundamental decays slowest, so once it is gone the string is silent. A held string is
+            // judged by its peak alone, since the volume or the gain may come back up; a released one
+            // by what is left of it in the mix.
+            mDecay[slot] *= std::pow(mDecayPerFrame[slot], Float32(inNumFrames));
+            const Float32 level = mMode[slot] == kVoiceEnvelope_Rising ? mEnvelope[slot].Peak() : mEnvelope[slot].Level() * gain;
+            if ((mDecay[slot] < kPluckSilence || mDecay[slot] * level < mFloor) && inNumFrames > 0)
+                outEndFrames[first + k] = std::min(outEndFrames[first + k], inNumFrames - 1);
+        }
+    }
+}
+
+template void PluckVoiceBank::Render<false>(const SmoothedParameter &, const ControlRateModulation &, UInt32,
+                                           const UInt32 *, UInt32, UInt32 *, Float32 *, Float32 *, UInt32, UInt32);
+template void PluckVoiceBank::Render<true>(const SmoothedParameter &, const ControlRateModulation &, UInt32,
+                                          const UInt32 *, UInt32, UInt32 *, Float32 *, Float32 *, UInt32, UInt32);
@@ -0,0 +1,115 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Plucked-string voices whose delay lines are seeded from the scan, in one preallocated arena
+ */
+
+#ifndef __PluckVoiceBank_h__
+#define __PluckVoiceBank_h__
+
+#include "ScanZones.h"
+#include "VoiceEnvelope.h"
+#include "SmoothedParameter.h"
+#include "ControlRateModulation.h"
+#include <vector>
+
+static const Float64 kPluckMinFrequency = 20.;		// Hz; lower notes play at it, so the lines stay bounded
+static const Float64 kPluckSustainSeconds = 4.;		// for the loop loss to take a held string down 60 dB
+static const Float32 kPluckSilence = 1.e-4f;		// -80 dB: a string decayed below it ends its note, however loud
+static const Float64 kPluckBlockFrequency = 10.;	// Hz, the corner of each string's DC blocker
+static const UInt32 kPluckBatch = 4;				// strings rendered together, interleaved frame by frame
+
+/*
+ PluckVoiceBank is the Karplus-Strong alternative to WavetableVoiceBank, with the same slots and
+ the same envelope calls, so a note renders with either. A slot's delay line holds one period of
+ the note: Start() seeds it from the note's table of the current scan, resampled from the table's
+ bins to the line's length, at the mip-map level that keeps it under Nyquist, and
+ normalized like the wavetable voices. From then on the scan plays no part; the string rings out
+ through a loop that averages each sample with the one before it and scales it by a loss that sets
+ the held decay, so higher harmonics die away first. A first-order allpass in the loop makes up the
+ fraction of a sample the line's length cannot, which keeps high notes in tune. The loop passes DC,
+ and a string starts with a little of it, so each string's output goes through a blocker. Per
+ frame, a voice is one load, the average, the allpass and one store, whatever the note;
+ kPluckBatch strings run interleaved, so that the allpasses' feedback chains overlap rather than
+ queue.
+
+ The lines are carved out of one arena that Resize() allocates, each slot the length of the lowest
+ note's period at the voices' rate. The envelope shapes the attack and release, as it does for the
+ wavetable voices, and the channel's modulation sets the level; the pitch bend does not reach a
+ string, whose period is fixed at attack. A held string whose fundamental has decayed past
+ kPluckSilence ends its note, as does one whose fundamental at its peak has decayed below the
+ audibility floor, or a released one whose fundamental, through its envelope, the volume and the
+ channel's gain, has.
+
+ Resize() allocates and must only be called off the render thread, while the AU is uninitialized.
+ Everything else is real-time safe. Different slots may be set up and rendered concurrently.
+ */
+class PluckVoiceBank
+{
+public:
+    PluckVoiceBank() : mSampleRate(44100.), mBlockPole(1.f), mFloor(0.f), mLineFrames(0) {}
+
+    // inSampleRate is the voices' rate, oversampling included
+    void			Resize(UInt32 inCount, Float64 inSampleRate);
+    UInt32			Count() const { return UInt32(mLength.size()); }
+
+    // seeds a slot's line with level inTableLevel (see ScanTableLevelForFrequency) of LidarScanZones
+    // table inTable of inZones, for a note of inFrequency Hz, its envelope rising towards inPeak
+    void			Start(UInt32 inSlot, const LidarScanZones &inZones, UInt32 inTable, UInt32 inTableLevel,
+                          Float64 inFrequency, Float32 inPeak);
+
+    UInt32			Table(UInt32 inSlot) const { return mTable[inSlot]; }
+    Float32			Level(UInt32 inSlot) const { return mEnvelope[inSlot].Level() * mDecay[inSlot]; }
+    Float32			Peak(UInt32 inSlot) const { return mEnvelope[inSlot].Peak(); }
+
+    // per render call, as WavetableVoiceBank::SetAudibilityFloor(); a decayed string ends whether it is
+    // held or not, since its decay cannot come back
+    void			SetAudibilityFloor(Float32 inFloor) { mFloor = inFloor; }
+
+    // per render call, as WavetableVoiceBank::SetBlock(); a string's pitch is fixed at attack, so the
+    // increment is ignored
+    void			SetBlock(UInt32 inSlot, UInt32 /*inIncrement*/, VoiceEnvelopeMode inMode, Float32 inStep)
+    {
+        mMode[inSlot] = UInt8(inMode);
+        mStep[inSlot] = inStep;
+    }
+
+    /*
+     Renders the inNumSlots slots listed in inSlots, scaled by inVolume's ramp for this block and by
+     inModulation's gain, and accumulates them into ioLeft, and into ioRight as well when kStereo is
+     true; the arguments are as for WavetableVoiceBank::Render(). outEndFrames[i] receives the frame at
+     which slot inSlots[i] ended, by its release or by decaying away, or inNumFrames.
+     */
+    template <bool kStereo>
+    void			Render(const SmoothedParameter &inVolume, const ControlRateModulation &inModulation,
+                           UInt32 inCycleFrame, const UInt32 *inSlots, UInt32 inNumSlots, UInt32 *outEndFrames,
+                           Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames, UInt32 inOversampling = 1);
+
+private:
+    PluckVoiceBank(const PluckVoiceBank &);
+    PluckVoiceBank & operator=(const PluckVoiceBank &);
+
+    Float64						mSampleRate;
+    Float32						mBlockPole;
+    Float32						mFloor;			// SetAudibilityFloor()
+    UInt32						mLineFrames;	// of every slot's share of the arena
+    std::vector<Float32>		mArena;
+    std::vector<UInt32>			mLength;		// of the slot's line, the note's period less the loop's delays
+    std::vector<UInt32>			mPosition;		// the next sample of the line to read and replace
+    std::vector<Float32>		mLoss;			// loop gain per pass
+    std::vector<Float32>		mTuning;		// allpass coefficient, for the fraction of a sample
+    std::vector<Float32>		mLast;			// the sample read before, for the average
+    std::vector<Float32>		mTuningIn;		// the allpass's previous input and output
+    std::vector<Float32>		mTuningOut;
+    std::vector<Float32>		mBlockIn;		// the DC blocker's previous input and output
+    std::vector<Float32>		mBlockOut;
+    std::vector<Float32>		mDecay;			// how far the fundamental has decayed, from 1
+    std::vector<Float32>		mDecayPerFrame;
+    std::vector<UInt32>			mTable;
+    std::vector<VoiceEnvelope>	mEnvelope;
+    std::vector<Float32>		mStep;
+    std::vector<UInt8>			mMode;			// VoiceEnvelopeMode
+};
+
+#endif
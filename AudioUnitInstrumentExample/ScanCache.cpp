@@ -0,0 +1,101 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ The last processed scan table, kept on disk so that a new session sounds before the sensor is up
+ */
+
+#include "ScanCache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const UInt32 kScanCacheMagic = 'LSch';
+static const UInt32 kScanCacheVersion = 2;
+
+struct ScanCacheFile
+{
+    UInt32			mMagic;
+    UInt32			mVersion;
+    UInt32			mTableBytes;		// of the flattened LidarScanTable that follows, at the writer's resolution
+    UInt32			mReserved;
+};
+
+ScanCache::ScanCache()
+: mLastSaveTime(0)
+{
+    const char *path = getenv("LIDARSYNTH_CACHE");
+    if (path && strcmp(path, "0") == 0)
+        return;
+    if (path && *path) {
+        mPath = path;
+    } else if (const char *home = getenv("HOME")) {
+        mPath = home;
+        mPath += "/Library/Caches/LidarSynth.lastscan";
+    }
+}
+
+bool ScanCache::Load(LidarScanTable &outTable) const
+{
+    if (mPath.empty())
+        return false;
+    int fd = open(mPath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= (off_t)sizeof(ScanCacheFile)
+        || info.st_size > (off_t)(sizeof(ScanCacheFile) + kScanTableMaxFlatBytes)) {
+        close(fd);
+        return false;
+    }
+    size_t size = size_t(info.st_size);
+    void *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    // the table is only replaced by a whole one of a supported resolution with samples in it
+    const ScanCacheFile *file = (const ScanCacheFile *)base;
+    bool valid = file->mMagic == kScanCacheMagic && file->mVersion == kScanCacheVersion
+        && file->mTableBytes == size - sizeof(ScanCacheFile);
+    if (valid) {
+        LidarScanTable table;
+        valid = table.Unflatten(file + 1, file->mTableBytes) && table.mNumSamples != 0;
+        if (valid) {
+            outTable = table;
+            outTable.mCaptureTime = kCachedScanCaptureTime;
+        }
+    }
+    munmap(base, size);
+    return valid;
+}
+
+void ScanCache::Save(const LidarScanTable &inTable, UInt64 inNowNanos, bool inForce)
+{
+    if (mPath.empty() || inTable.mNumSamples == 0)
+        return;
+    if (!inForce && mLastSaveTime != 0 && inNowNanos - mLastSaveTime < kScanCacheIntervalNanos)
+        return;
+    mLastSaveTime = inNowNanos;
+
+    // each process writes its own temporary file; the rename makes the newest one the cache at once
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%d.tmp", (int)getpid());
+    std::string temporaryPath = mPath + suffix;
+    FILE *file = fopen(temporaryPath.c_str(), "wb");
+    if (file == NULL)
+        return;
+
+    mFlatTable.resize(inTable.FlatBytes());
+    inTable.Flatten(mFlatTable.data());
+    const ScanCacheFile header = { kScanCacheMagic, kScanCacheVersion, UInt32(mFlatTable.size()), 0 };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(mFlatTable.data(), mFlatTable.size(), 1, file) == 1;
+    if (fclose(file) != 0)
+        written = false;
+    if (!written || rename(temporaryPath.c_str(), mPath.c_str()) != 0)
+        unlink(temporaryPath.c_str());
+}
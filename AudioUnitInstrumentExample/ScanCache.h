@@ -0,0 +1,47 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ The last processed scan table, kept on disk so that a new session sounds before the sensor is up
+ */
+
+#ifndef __ScanCache_h__
+#define __ScanCache_h__
+
+#include "LidarScanTable.h"
+#include <string>
+#include <vector>
+
+static const UInt64 kScanCacheIntervalNanos = 5000000000ULL;	// between writes while scans stream in
+
+/*
+ ScanCache keeps one finished LidarScanTable, every level of it and its statistics, flattened at the
+ resolution it was built at, in a small file: by default Library/Caches/LidarSynth.lastscan under
+ the home directory, which for a sandboxed host is its container, or wherever LIDARSYNTH_CACHE names
+ (LIDARSYNTH_CACHE=0 turns the cache off).
+
+ The device hub loads it when it starts, so the first SinSynth plays the last session's scan while
+ the motor spins up, instead of the default sine; the table comes back with its capture time set to
+ kCachedScanCaptureTime, which the synth takes as the cue to crossfade into the first live scan.
+ Load() maps the file and validates it before copying; a missing, truncated or foreign file just
+ leaves the table alone. Save() writes a temporary file and renames it over the cache, so a crash
+ mid-write never leaves a torn table for the next session, and it does so at most once every
+ kScanCacheIntervalNanos unless forced. Both run on the ingest thread or before it starts.
+ */
+class ScanCache
+{
+public:
+    ScanCache();
+
+    bool				IsEnabled() const { return !mPath.empty(); }
+
+    bool				Load(LidarScanTable &outTable) const;
+    void				Save(const LidarScanTable &inTable, UInt64 inNowNanos, bool inForce = false);
+
+private:
+    std::string			mPath;
+    UInt64				mLastSaveTime;
+    std::vector<char>	mFlatTable;			// Save()'s scratch, kept to spare the ingest thread an allocation a save
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-sector features of a LiDAR scan, for driving MIDI output
+ */
+
+#include "ScanFeatures.h"
+#include <algorithm>
+#include <cstdlib>
+
+ScanFeatureExtractor::ScanFeatureExtractor()
+{
+    for (UInt32 i = 0; i < kScanFeatureSectors; ++i) {
+        mValue[i] = 0;
+        mKnown[i] = false;
+        mInZone[i] = false;
+    }
+}
+
+static ScanFeatureEvent MakeScanFeatureEvent(UInt64 inCaptureTime, ScanFeatureKind inKind, UInt32 inSector, UInt8 inValue)
+{
+    ScanFeatureEvent event;
+    event.mCaptureTime = inCaptureTime;
+    event.mKind = UInt8(inKind);
+    event.mSector = UInt8(inSector);
+    event.mValue = inValue;
+    return event;
+}
+
+UInt32 ScanFeatureExtractor::Process(UInt64 inCaptureTime, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                     UInt32 inNumSamples, ScanFeatureEvent *outEvents)
+{
+    // nearest valid return per sector; sweep reports dropped samples as distance 0 or less
+    std::int32_t nearest[kScanFeatureSectors];
+    std::fill(nearest, nearest + kScanFeatureSectors, std::int32_t(-1));
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        std::int32_t distance = inDistances[i];
+        if (distance <= 0) continue;
+        std::int32_t angle = inAngles[i] % kScanFullCircle;
+        if (angle < 0) angle += kScanFullCircle;
+        UInt32 sector = UInt32((std::int64_t)angle * kScanFeatureSectors / kScanFullCircle);
+        distance = std::min(distance, kScanMaxDistance);
+        if (nearest[sector] < 0 || distance < nearest[sector])
+            nearest[sector] = distance;
+    }
+
+    UInt32 numEvents = 0;
+    for (UInt32 sector = 0; sector < kScanFeatureSectors; ++sector) {
+        std::int32_t distance = nearest[sector];
+        if (distance < 0) continue;
+        UInt8 value = UInt8(127 - distance * 127 / kScanMaxDistance);
+
+        if (!mKnown[sector] || std::abs(int(value) - int(mValue[sector])) >= kScanFeatureValueHysteresis) {
+            outEvents[numEvents++] = MakeScanFeatureEvent(inCaptureTime, kScanFeature_Nearest, sector, value);
+            mValue[sector] = value;
+            mKnown[sector] = true;
+        }
+        if (!mInZone[sector] && distance < kScanZoneDistance) {
+            outEvents[numEvents++] = MakeScanFeatureEvent(inCaptureTime, kScanFeature_ZoneEnter, sector, value);
+            mInZone[sector] = true;
+        } else if (mInZone[sector] && distance >= kScanZoneDistance + kScanZoneHysteresis) {
+            outEvents[numEvents++] = MakeScanFeatureEvent(inCaptureTime, kScanFeature_ZoneLeave, sector, 0);
+            mInZone[sector] = false;
+        }
+    }
+    return numEvents;
+}
+
+UInt32 ScanFeatureExtractor::CurrentState(UInt64 inCaptureTime, ScanFeatureEvent *outEvents, bool inWithLeaves) const
+{
+    UInt32 numEvents = 0;
+    for (UInt32 sector = 0; sector < kScanFeatureSectors; ++sector) {
+        if (mKnown[sector])
+            outEvents[numEvents++] = MakeScanFeatureEvent(inCaptureTime, kScanFeature_Nearest, sector, mValue[sector]);
+        if (mInZone[sector])
+            outEvents[numEvents++] = MakeScanFeatureEvent(inCaptureTime, kScanFeature_ZoneEnter, sector, mValue[sector]);
+        else if (inWithLeaves)
+            outEvents[numEvents++] = MakeScanFeatureEvent(inCaptureTime, kScanFeature_ZoneLeave, sector, 0);
+    }
+    return numEvents;
+}
+
+static_assert(kScanFeatureSectors == kAULidarModulationSectors, "the modulation bus shares the feature sectors");
+
+void ComputeScanModulation(const std::int32_t *inAngles, const std::int32_t *inDistances, UInt32 inNumSamples,
+                           Float32 *outFeatures)
+{
+    std::int32_t nearest[kScanFeatureSectors];
+    UInt32 counts[kScanFeatureSectors] = { 0 };
+    std::fill(nearest, nearest + kScanFeatureSectors, kScanMaxDistance);
+    std::int64_t sum = 0;
+    UInt32 numValid = 0;
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        std::int32_t distance = inDistances[i];
+        if (distance <= 0) continue;
+        std::int32_t angle = inAngles[i] % kScanFullCircle;
+        if (angle < 0) angle += kScanFullCircle;
+        UInt32 sector = UInt32((std::int64_t)angle * kScanFeatureSectors / kScanFullCircle);
+        distance = std::min(distance, kScanMaxDistance);
+        nearest[sector] = std::min(nearest[sector], distance);
+        counts[sector]++;
+        sum += distance;
+        numValid++;
+    }
+
+    const Float32 scale = 1.f / kScanMaxDistance;
+    std::int32_t overall = *std::min_element(nearest, nearest + kScanFeatureSectors);
+    outFeatures[kAULidarModulation_Nearest] = 1.f - overall * scale;
+    outFeatures[kAULidarModulation_Mean] = numValid ? 1.f - Float32(double(sum) / numValid) * scale : 0.f;
+    outFeatures[kAULidarModulation_Coverage] = inNumSamples ? Float32(numValid) / inNumSamples : 0.f;
+    for (UInt32 sector = 0; sector < kScanFeatureSectors; ++sector) {
+        outFeatures[kAULidarModulation_SectorNearest + sector] = 1.f - nearest[sector] * scale;
+        Float32 share = numValid ? Float32(counts[sector]) * kScanFeatureSectors / numValid : 0.f;
+        outFeatures[kAULidarModulation_SectorDensity + sector] = std::min(share, 1.f);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-sector features of a LiDAR scan, for driving MIDI output
+ */
+
+#ifndef __ScanFeatures_h__
+#define __ScanFeatures_h__
+
+#include "LidarScanTable.h"
+#include "LockFreeFIFO.h"
+#include "AULidarModulationBus.h"
+
+static const UInt32 kScanFeatureSectors = 8;			// equal angular sectors, sector 0 starting at angle 0
+static const std::int32_t kScanZoneDistance = 100;		// cm; an object nearer than this is inside its sector's zone
+static const std::int32_t kScanZoneHysteresis = 10;		// cm it must move back past the zone edge to leave it
+static const UInt8 kScanFeatureValueHysteresis = 2;		// smallest change of a sector's value that is sent
+static const UInt32 kScanFeatureQueueSize = 256;
+static const UInt32 kMaxScanFeatureEvents = 2 * kScanFeatureSectors;	// per scan: a value and a zone change per sector
+
+enum ScanFeatureKind
+{
+    kScanFeature_Nearest = 0,		// mValue: 0 (nothing within kScanMaxDistance) to 127 (touching the sensor)
+    kScanFeature_ZoneEnter = 1,		// mValue: the nearest value as the object entered
+    kScanFeature_ZoneLeave = 2
+};
+
+struct ScanFeatureEvent
+{
+    UInt64			mCaptureTime;	// host time in nanoseconds of the scan the event came from
+    UInt8			mKind;			// ScanFeatureKind
+    UInt8			mSector;
+    UInt8			mValue;
+};
+
+// one per subscriber: the ingest thread produces, the subscriber's render thread consumes
+typedef LockFreeFIFO<ScanFeatureEvent> ScanFeatureQueue;
+
+/*
+ ScanFeatureExtractor runs on the ingest thread, once per scan. It finds the nearest return in each
+ sector and reports only what changed since the previous scan: a sector's nearest value when it has
+ moved by kScanFeatureValueHysteresis or more, and an object entering or leaving the sector's zone.
+ A sector with no returns in a scan keeps its previous state.
+ */
+class ScanFeatureExtractor
+{
+public:
+    ScanFeatureExtractor();
+
+    // returns the number of events written to outEvents, which holds kMaxScanFeatureEvents.
+    UInt32			Process(UInt64 inCaptureTime, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                            UInt32 inNumSamples, ScanFeatureEvent *outEvents);
+
+    // the current state of every sector as events, so that a new subscriber starts in step; with
+    // inWithLeaves, a sector out of its zone gets a ZoneLeave, for a subscriber that may have missed one.
+    // Returns the number written to outEvents, which holds kMaxScanFeatureEvents.
+    UInt32			CurrentState(UInt64 inCaptureTime, ScanFeatureEvent *outEvents, bool inWithLeaves = false) const;
+
+private:
+    UInt8			mValue[kScanFeatureSectors];		// last value sent per sector
+    bool			mKnown[kScanFeatureSectors];		// a value has been sent for the sector
+    bool			mInZone[kScanFeatureSectors];
+};
+
+// the continuous features published on the modulation bus, all but the motion features, which come
+// from ScanMotionDetector; see AULidarModulationBus.h for what each one means
+void ComputeScanModulation(const std::int32_t *inAngles, const std::int32_t *inDistances, UInt32 inNumSamples,
+                           Float32 *outFeatures);
+
+#endif
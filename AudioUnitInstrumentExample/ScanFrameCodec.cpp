@@ -0,0 +1,153 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Compact wire format for raw scans, as an alternative to sweep.proto.scan
+ */
+
+#include "ScanFrameCodec.h"
+#include <algorithm>
+
+static const UInt8 kScanFrameHasSignalStrengths = 1;
+
+static inline void PutUInt16(UInt8 *outBytes, UInt32 inValue)
+{
+    outBytes[0] = UInt8(inValue);
+    outBytes[1] = UInt8(inValue >> 8);
+}
+
+static inline UInt32 GetUInt16(const UInt8 *inBytes)
+{
+    return UInt32(inBytes[0]) | UInt32(inBytes[1]) << 8;
+}
+
+static inline UInt8 *PutVarint(UInt8 *outBytes, std::int32_t inValue)
+{
+    UInt32 zigzag = (UInt32(inValue) << 1) ^ UInt32(inValue >> 31);
+    while (zigzag >= 0x80) {
+        *outBytes++ = UInt8(zigzag | 0x80);
+        zigzag >>= 7;
+    }
+    *outBytes++ = UInt8(zigzag);
+    return outBytes;
+}
+
+// NULL if the varint runs past inEnd
+static inline const UInt8 *GetVarint(const UInt8 *inBytes, const UInt8 *inEnd, std::int32_t &outValue)
+{
+    UInt32 zigzag = 0;
+    for (UInt32 shift = 0; shift < 35; shift += 7) {
+        if (inBytes == inEnd)
+            return NULL;
+        UInt8 byte = *inBytes++;
+        zigzag |= UInt32(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            outValue = std::int32_t(zigzag >> 1) ^ -std::int32_t(zigzag & 1);
+            return inBytes;
+        }
+    }
+    return NULL;
+}
+
+static inline UInt32 ClampDistance(std::int32_t inDistance)
+{
+    return UInt32(std::min(std::max(inDistance, 0), 0xFFFF));
+}
+
+size_t ScanFrameEncode(const std::int32_t *inAngles, const std::int32_t *inDistances, const std::int32_t *inSignalStrengths,
+                       UInt32 inNumSamples, UInt8 *outFrame)
+{
+    UInt32 numSamples = std::min<UInt32>(inNumSamples, 0xFFFF);
+    bool fixed = true;
+    for (UInt32 i = 1; i < numSamples && fixed; ++i) {
+        std::int32_t step = inAngles[i] - inAngles[i - 1];
+        fixed = step >= 0 && step <= 0xFFFF;
+    }
+
+    std::int32_t firstAngle = numSamples ? inAngles[0] : 0;
+    outFrame[0] = 0;
+    outFrame[1] = fixed ? kScanFrameCodec_Fixed : kScanFrameCodec_Varint;
+    outFrame[2] = inSignalStrengths ? kScanFrameHasSignalStrengths : 0;
+    outFrame[3] = 0;
+    PutUInt16(outFrame + 4, numSamples);
+    PutUInt16(outFrame + 6, 0);
+    PutUInt16(outFrame + 8, UInt32(firstAngle));
+    PutUInt16(outFrame + 10, UInt32(firstAngle) >> 16);
+
+    UInt8 *bytes = outFrame + kScanFrameHeaderBytes;
+    if (fixed) {
+        for (UInt32 i = 0; i < numSamples; ++i, bytes += 2)
+            PutUInt16(bytes, i ? UInt32(inAngles[i] - inAngles[i - 1]) : 0);
+        for (UInt32 i = 0; i < numSamples; ++i, bytes += 2)
+            PutUInt16(bytes, ClampDistance(inDistances[i]));
+    } else {
+        std::int32_t previousDistance = 0;
+        for (UInt32 i = 0; i < numSamples; ++i) {
+            bytes = PutVarint(bytes, i ? inAngles[i] - inAngles[i - 1] : 0);
+            std::int32_t distance = std::int32_t(ClampDistance(inDistances[i]));
+            bytes = PutVarint(bytes, distance - previousDistance);
+            previousDistance = distance;
+        }
+    }
+    if (inSignalStrengths)
+        for (UInt32 i = 0; i < numSamples; ++i)
+            *bytes++ = UInt8(std::min(std::max(inSignalStrengths[i], 0), 0xFF));
+    return size_t(bytes - outFrame);
+}
+
+bool ScanFrameDecode(const UInt8 *inFrame, size_t inSize, UInt32 inMaxSamples, std::int32_t *outAngles,
+                     std::int32_t *outDistances, std::int32_t *outSignalStrengths, UInt32 &outNumSamples,
+                     bool &outHasSignalStrengths)
+{
+    outNumSamples = 0;
+    if (!ScanFrameIsCompact(inFrame, inSize))
+        return false;
+    const UInt8 codec = inFrame[1];
+    const bool hasSignalStrengths = (inFrame[2] & kScanFrameHasSignalStrengths) != 0;
+    const UInt32 numSamples = GetUInt16(inFrame + 4);
+    const std::int32_t firstAngle = std::int32_t(GetUInt16(inFrame + 8) | GetUInt16(inFrame + 10) << 16);
+    if (numSamples > inMaxSamples)
+        return false;
+
+    const UInt8 *bytes = inFrame + kScanFrameHeaderBytes;
+    const UInt8 *end = inFrame + inSize;
+    const size_t strengthBytes = hasSignalStrengths ? numSamples : 0;
+    if (codec == kScanFrameCodec_Fixed) {
+        if (size_t(end - bytes) != 4 * size_t(numSamples) + strengthBytes)
+            return false;
+        // widen every field first, over flat arrays, then run the sum of the angle steps
+        const UInt8 *steps = bytes, *distances = bytes + 2 * numSamples;
+        for (UInt32 i = 0; i < numSamples; ++i) {
+            outAngles[i] = std::int32_t(GetUInt16(steps + 2 * i));
+            outDistances[i] = std::int32_t(GetUInt16(distances + 2 * i));
+        }
+        std::int32_t angle = firstAngle;
+        for (UInt32 i = 0; i < numSamples; ++i) {
+            angle += outAngles[i];
+            outAngles[i] = angle;
+        }
+        bytes += 4 * numSamples;
+    } else if (codec == kScanFrameCodec_Varint) {
+        std::int32_t angle = firstAngle, distance = 0;
+        for (UInt32 i = 0; i < numSamples; ++i) {
+            std::int32_t step, change;
+            if (!(bytes = GetVarint(bytes, end, step)) || !(bytes = GetVarint(bytes, end, change)))
+                return false;
+            angle += step;
+            distance += change;
+            outAngles[i] = angle;
+            outDistances[i] = distance;
+        }
+        if (size_t(end - bytes) != strengthBytes)
+            return false;
+    } else {
+        return false;
+    }
+
+    if (hasSignalStrengths)
+        for (UInt32 i = 0; i < numSamples; ++i)
+            outSignalStrengths[i] = bytes[i];
+    outNumSamples = numSamples;
+    outHasSignalStrengths = hasSignalStrengths;
+    return true;
+}
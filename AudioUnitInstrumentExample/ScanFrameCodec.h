@@ -0,0 +1,67 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Compact wire format for raw scans, as an alternative to sweep.proto.scan
+ */
+
+#ifndef __ScanFrameCodec_h__
+#define __ScanFrameCodec_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+// how the samples of a frame are laid out after its header
+enum ScanFrameCodec
+{
+    kScanFrameCodec_Fixed = 1,		// 16-bit angle steps, 16-bit distances, 8-bit strengths
+    kScanFrameCodec_Varint = 2		// zigzag varints of the angle steps and of the distance changes, 8-bit strengths
+};
+
+static const size_t kScanFrameHeaderBytes = 12;
+// the larger of the two codecs: five varint bytes for each of the two deltas, and a strength byte
+static const size_t kScanFrameMaxBytesPerSample = 11;
+
+/*
+ A frame is a 12-byte header and the samples of one scan. The header's first byte is always 0, which
+ no serialized sweep.proto.scan starts with (0 is not a valid protobuf tag), so a subscriber can
+ take either format on the same socket and tell them apart by that byte alone. Then come the codec,
+ a flag byte (bit 0: signal strengths follow), a reserved byte, the sample count as a 16-bit value,
+ two reserved bytes and the first sample's angle as a 32-bit value, all little-endian.
+
+ Angles are sent as the step from the previous sample, which within one rotation is small and never
+ negative, and distances are clamped to 16 bits (sweep reports centimetres, so nothing the sensor
+ can measure is lost); signal strengths are clamped to 8 bits. ScanFrameEncode() picks the fixed
+ layout whenever every angle step fits in 16 bits: 5 bytes a sample, decoded with a widening copy
+ and a running sum over flat arrays. A scan with a wide gap in it goes out in the varint layout,
+ which is about as small since neighbouring distances are close, but decodes a byte at a time.
+ Either way that is a fraction of the protobuf's packed int32s.
+ */
+
+// writes the frame into outFrame, which must hold kScanFrameHeaderBytes + inNumSamples *
+// kScanFrameMaxBytesPerSample bytes, and returns its size. inSignalStrengths may be NULL.
+size_t ScanFrameEncode(const std::int32_t *inAngles, const std::int32_t *inDistances, const std::int32_t *inSignalStrengths,
+                       UInt32 inNumSamples, UInt8 *outFrame);
+
+// whether inFrame starts like a frame rather than a protobuf message
+inline bool ScanFrameIsCompact(const UInt8 *inFrame, size_t inSize)
+{
+    return inSize >= kScanFrameHeaderBytes && inFrame[0] == 0;
+}
+
+/*
+ Decodes a frame of at most inMaxSamples samples into the three arrays. Returns false, leaving
+ outNumSamples 0, if the frame is truncated, too long or of an unknown codec. outHasSignalStrengths
+ is false if the frame carries none, in which case outSignalStrengths is not written.
+ */
+bool ScanFrameDecode(const UInt8 *inFrame, size_t inSize, UInt32 inMaxSamples, std::int32_t *outAngles,
+                     std::int32_t *outDistances, std::int32_t *outSignalStrengths, UInt32 &outNumSamples,
+                     bool &outHasSignalStrengths);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Incremental fusion of several LiDAR devices' scans into one polar map of the room
+ */
+
+#include "ScanFusion.h"
+#include <algorithm>
+#include <cstring>
+
+static const Float64 kMilliDegreesToRadians = M_PI / 180000.;
+
+void ScanPose::Transform(const std::int32_t *inAngles, const std::int32_t *inDistances, UInt32 inNumSamples,
+                         std::int32_t *outAngles, std::int32_t *outDistances) const
+{
+    const std::int32_t rotation = std::int32_t(std::lround(Float64(mRotation) * 1000.));
+    // a device at the origin only turns its angles
+    if (mX == 0.f && mY == 0.f) {
+        for (UInt32 i = 0; i < inNumSamples; ++i) {
+            std::int32_t angle = (inAngles[i] + rotation) % kScanFullCircle;
+            outAngles[i] = angle < 0 ? angle + kScanFullCircle : angle;
+            outDistances[i] = std::min(std::max(inDistances[i], 1), kScanMaxDistance);
+        }
+        return;
+    }
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        Float64 theta = Float64(inAngles[i] + rotation) * kMilliDegreesToRadians;
+        Float64 x = mX + inDistances[i] * std::cos(theta);
+        Float64 y = mY + inDistances[i] * std::sin(theta);
+        std::int32_t angle = std::int32_t(std::lround(std::atan2(y, x) / kMilliDegreesToRadians));
+        outAngles[i] = angle < 0 ? angle + kScanFullCircle : angle % kScanFullCircle;
+        outDistances[i] = std::min(std::max(std::int32_t(std::lround(std::sqrt(x * x + y * y))), 1), kScanMaxDistance);
+    }
+}
+
+ScanFusion::ScanFusion() : mNumSamples(0)
+{
+    memset(mDeviceDistance, 0, sizeof(mDeviceDistance));
+    memset(mNumCovered, 0, sizeof(mNumCovered));
+    memset(mFused, 0, sizeof(mFused));
+}
+
+void ScanFusion::Merge(UInt32 inDevice, const std::int32_t *inAngles, const std::int32_t *inDistances, UInt32 inNumSamples)
+{
+    std::int32_t *device = mDeviceDistance[inDevice];
+    UInt16 *covered = mCovered[inDevice];
+
+    // the bins the device's previous scan covered, which this one may no longer reach
+    const UInt32 numPrevious = mNumCovered[inDevice];
+    for (UInt32 i = 0; i < numPrevious; ++i)
+        device[covered[i]] = 0;
+    for (UInt32 i = 0; i < numPrevious; ++i)
+        FuseBin(covered[i]);
+
+    // the new scan, keeping the nearest return per bin
+    UInt32 numCovered = 0;
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        UInt32 bin = UInt32(std::int64_t(inAngles[i]) * kScanFusionBins / kScanFullCircle);
+        std::int32_t distance = inDistances[i];
+        if (device[bin] == 0) {
+            covered[numCovered++] = UInt16(bin);
+            device[bin] = distance;
+        } else if (distance < device[bin]) {
+            device[bin] = distance;
+        }
+    }
+    mNumCovered[inDevice] = numCovered;
+    for (UInt32 i = 0; i < numCovered; ++i)
+        FuseBin(covered[i]);
+
+    // read out in angle order, always writing and only advancing on an occupied bin
+    const std::int32_t binCentre = kScanFullCircle / std::int32_t(kScanFusionBins * 2);
+    UInt32 n = 0;
+    for (UInt32 bin = 0; bin < kScanFusionBins; ++bin) {
+        mAngles[n] = std::int32_t(std::int64_t(bin) * kScanFullCircle / kScanFusionBins) + binCentre;
+        mDistances[n] = mFused[bin];
+        n += mFused[bin] != 0;
+    }
+    mNumSamples = n;
+}
+
+// the nearest return any device saw in the bin
+void ScanFusion::FuseBin(UInt32 inBin)
+{
+    std::int32_t nearest = 0;
+    for (UInt32 d = 0; d < kMaxFusedDevices; ++d) {
+        std::int32_t distance = mDeviceDistance[d][inBin];
+        if (distance != 0 && (nearest == 0 || distance < nearest))
+            nearest = distance;
+    }
+    mFused[inBin] = nearest;
+}
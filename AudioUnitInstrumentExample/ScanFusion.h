@@ -0,0 +1,69 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Incremental fusion of several LiDAR devices' scans into one polar map of the room
+ */
+
+#ifndef __ScanFusion_h__
+#define __ScanFusion_h__
+
+#include "LidarScanTable.h"
+
+static const UInt32 kMaxFusedDevices = 4;
+static const UInt32 kScanFusionBins = 720;		// half a degree each, bin 0 starting at angle 0
+
+// where a device stands in the fused frame, whose origin is the centre the fused map is seen from
+struct ScanPose
+{
+    Float32			mX;				// cm
+    Float32			mY;				// cm
+    Float32			mRotation;		// degrees added to the device's angles, in the direction it counts them
+
+    // writes the samples as seen from the origin of the fused frame: angles in milli-degrees in
+    // [0, kScanFullCircle), distances clamped to [1, kScanMaxDistance]
+    void			Transform(const std::int32_t *inAngles, const std::int32_t *inDistances, UInt32 inNumSamples,
+                              std::int32_t *outAngles, std::int32_t *outDistances) const;
+};
+
+/*
+ ScanFusion keeps one polar map of the room, kScanFusionBins bins around the fused frame's origin,
+ built from the latest scan of each of up to kMaxFusedDevices devices. Each device's scan is first
+ brought into the fused frame with its ScanPose, on the thread that read it. The device's part of
+ the map is then the nearest return it saw in each bin, and a bin of the fused map is the nearest
+ return any device saw there: a surface one device sees behind another device's obstacle stays
+ hidden, as it would for a single device at the origin.
+
+ Merge() runs on the fusion thread whenever a device completes a scan. It only touches the bins that
+ device covers: the ones its previous scan covered are cleared, the new scan's are written, and the
+ fused value of just those bins is taken again across the devices. A device that stops scanning
+ keeps its last part of the map. Angles() and Distances() then read the map out as one scan, a
+ sample at the centre of each occupied bin in angle order, for the table builder.
+ */
+class ScanFusion
+{
+public:
+    ScanFusion();
+
+    // replaces inDevice's part of the map with a scan already in the fused frame
+    void					Merge(UInt32 inDevice, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                  UInt32 inNumSamples);
+
+    // the fused map as of the last Merge()
+    UInt32					NumSamples() const { return mNumSamples; }
+    const std::int32_t *	Angles() const { return mAngles; }
+    const std::int32_t *	Distances() const { return mDistances; }
+
+private:
+    void					FuseBin(UInt32 inBin);
+
+    std::int32_t			mDeviceDistance[kMaxFusedDevices][kScanFusionBins];	// cm, 0 where the device saw nothing
+    UInt16					mCovered[kMaxFusedDevices][kScanFusionBins];		// bins a device's last scan covered
+    UInt32					mNumCovered[kMaxFusedDevices];
+    std::int32_t			mFused[kScanFusionBins];		// cm, 0 where no device saw anything
+    UInt32					mNumSamples;
+    std::int32_t			mAngles[kScanFusionBins];
+    std::int32_t			mDistances[kScanFusionBins];
+};
+
+#endif
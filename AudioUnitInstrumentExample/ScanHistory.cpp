@@ -0,0 +1,110 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Fixed-size history of recent scan tables, for morphing through time
+ */
+
+#include "ScanHistory.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+    #include <emmintrin.h>
+    #define SCAN_HISTORY_X86 1
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define SCAN_HISTORY_NEON 1
+#endif
+
+static const Float32 kRowFullScale = 32767.f;
+
+void ScanHistory::Resize(UInt32 inDepth, UInt32 inNumTables, UInt32 inBits)
+{
+    mDepth = std::max(inDepth, 1U);
+    mNumTables = std::max(inNumTables, 1U);
+    mBits = inBits;
+    mRows.assign((size_t(mNumTables) * mBits * mDepth) << mBits, 0);
+    mScales.assign(size_t(mNumTables) * mBits * mDepth, 0.f);
+    mNormalized.assign(size_t(1) << mBits, 0.f);
+    Clear();
+}
+
+void ScanHistory::Push(const LidarScanZones &inZones, OscillatorEngine inEngine)
+{
+    if (mRows.empty()) return;
+    for (UInt32 t = 0; t < mNumTables; ++t)
+        if (inZones.Table(t).Bits() != mBits) {
+            Clear();
+            return;
+        }
+
+    const UInt32 size = 1U << mBits;
+    mNewest = mCount ? (mNewest + 1) % mDepth : 0;
+    mCount = std::min(mCount + 1, mDepth);
+    for (UInt32 t = 0; t < mNumTables; ++t) {
+        const LidarScanTable &table = inZones.Table(t);
+        const bool spectral = inEngine == kOscillatorEngine_Spectral;
+        const Float32 offset = spectral ? 0.f : table.mStats.mMean;
+        const Float32 gain = spectral ? 1.f : table.mStats.mInverseMean;
+        for (UInt32 level = 0; level < mBits; ++level) {
+            const Float32 *source = spectral ? table.mSpectrum[level] : table.mLevel[level];
+            Float32 *normalized = mNormalized.data(), peak = 0.f;
+            for (UInt32 i = 0; i < size; ++i) {
+                normalized[i] = (source[i] - offset) * gain;
+                peak = std::max(peak, std::fabs(normalized[i]));
+            }
+            const size_t index = RowIndex(t, level, mNewest);
+            const Float32 quantize = peak > 0.f ? kRowFullScale / peak : 0.f;
+            SInt16 *row = &mRows[index * size];
+            for (UInt32 i = 0; i < size; ++i)
+                row[i] = SInt16(std::lrint(normalized[i] * quantize));
+            mScales[index] = peak / kRowFullScale;
+        }
+    }
+}
+
+void ScanHistory::Blend(UInt32 inTable, UInt32 inLevel, Float32 inTime, Float32 *outRow) const
+{
+    if (inTable >= mNumTables) inTable = kFullScanTable;
+    const UInt32 size = 1U << mBits;
+    // ages count back from the newest scan, 0, to the oldest held, mCount - 1
+    Float32 age = std::min(std::max(inTime, 0.f), 1.f) * Float32(mCount - 1);
+    UInt32 younger = std::min(UInt32(age), mCount - 1);
+    UInt32 older = std::min(younger + 1, mCount - 1);
+    Float32 fraction = age - Float32(younger);
+    const size_t rowA = RowIndex(inTable, inLevel, (mNewest + mDepth - younger) % mDepth);
+    const size_t rowB = RowIndex(inTable, inLevel, (mNewest + mDepth - older) % mDepth);
+    const SInt16 *a = &mRows[rowA * size];
+    const SInt16 *b = &mRows[rowB * size];
+    // each row's scale folds into its weight in the crossfade
+    const Float32 weightA = mScales[rowA] * (1.f - fraction);
+    const Float32 weightB = mScales[rowB] * fraction;
+    UInt32 i = 0;
+#if SCAN_HISTORY_X86
+    const __m128 wa = _mm_set1_ps(weightA), wb = _mm_set1_ps(weightB);
+    for (; i + 8 <= size; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        // widen by unpacking each value into the high half of a 32-bit lane, then shifting it back down
+        __m128 aLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(va, va), 16));
+        __m128 aHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(va, va), 16));
+        __m128 bLo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vb, vb), 16));
+        __m128 bHi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vb, vb), 16));
+        _mm_storeu_ps(outRow + i, _mm_add_ps(_mm_mul_ps(aLo, wa), _mm_mul_ps(bLo, wb)));
+        _mm_storeu_ps(outRow + i + 4, _mm_add_ps(_mm_mul_ps(aHi, wa), _mm_mul_ps(bHi, wb)));
+    }
+#elif SCAN_HISTORY_NEON
+    for (; i + 8 <= size; i += 8) {
+        int16x8_t va = vld1q_s16(a + i), vb = vld1q_s16(b + i);
+        float32x4_t aLo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(va)));
+        float32x4_t aHi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(va)));
+        float32x4_t bLo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vb)));
+        float32x4_t bHi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vb)));
+        vst1q_f32(outRow + i, vmlaq_n_f32(vmulq_n_f32(aLo, weightA), bLo, weightB));
+        vst1q_f32(outRow + i + 4, vmlaq_n_f32(vmulq_n_f32(aHi, weightA), bHi, weightB));
+    }
+#endif
+    for (; i < size; ++i)
+        outRow[i] = Float32(a[i]) * weightA + Float32(b[i]) * weightB;
+}
@@ -0,0 +1,79 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Fixed-size history of recent scan tables, for morphing through time
+ */
+
+#ifndef __ScanHistory_h__
+#define __ScanHistory_h__
+
+#include "ScanZones.h"
+#include <vector>
+
+static const UInt32 kDefaultScanHistoryDepth = 8;
+static const UInt32 kMaxScanHistoryDepth = 64;
+
+/*
+ ScanHistory keeps the last Depth() scans the render thread has played, so that a voice can scrub
+ back through them. Every table of a LidarScanZones bundle and every mip-map level of it has its own
+ run of Depth() rows in one preallocated array, laid out [table][level][scan][bin], with a shared
+ wrap index: a lookup for one voice reads two adjacent rows of one contiguous block.
+
+ Push() stores the rows of the chosen engine already normalized (the scan's mean removed and scaled
+ by its inverse, as the waveform engine plays them; spectral tables are stored as they are), so
+ Blend() is a plain crossfade and the result is played with no offset and unit gain. Each row is
+ kept as 16-bit integers scaled to its own peak, with that scale beside it: half the footprint of
+ floats, so a deep history of every zone's tables stays in L2, with rounding 96 dB below each row's peak.
+ Blend() widens the two rows it reads back to float as it crossfades them, four bins at a time.
+
+ The rows are sized for tables of one size, given to Resize(). A bundle of another size, from a hub
+ whose resolution another instance changed, clears the history rather than being pushed, and the
+ voices play the live tables until the history is resized.
+
+ Resize() allocates and must only be called off the render thread, while the AU is uninitialized.
+ Push() and Clear() belong to the render thread; Blend() may be called from any thread rendering
+ that cycle, since nothing is pushed while the voices render.
+ */
+class ScanHistory
+{
+public:
+    ScanHistory() : mDepth(0), mNumTables(0), mBits(kScanTableDefaultBits), mCount(0), mNewest(0) {}
+
+    void			Resize(UInt32 inDepth, UInt32 inNumTables, UInt32 inBits);
+    void			Clear() { mCount = 0; mNewest = 0; }
+
+    UInt32			Depth() const { return mDepth; }
+    UInt32			Count() const { return mCount; }	// scans held, up to Depth()
+    UInt32			Bits() const { return mBits; }		// of the tables held
+
+    // becomes the newest scan, dropping the oldest once the history is full
+    void			Push(const LidarScanZones &inZones, OscillatorEngine inEngine);
+
+    /*
+     Writes 1 << Bits() values of level inLevel of table inTable, inTime of the way from the newest
+     scan held (0) to the oldest (1), interpolating between the two scans either side. Tables beyond
+     those the history was sized for read the whole-scan table. Count() must be at least 1.
+     */
+    void			Blend(UInt32 inTable, UInt32 inLevel, Float32 inTime, Float32 *outRow) const;
+
+private:
+    ScanHistory(const ScanHistory &);
+    ScanHistory & operator=(const ScanHistory &);
+
+    size_t			RowIndex(UInt32 inTable, UInt32 inLevel, UInt32 inScan) const
+    {
+        return (size_t(inTable) * mBits + inLevel) * mDepth + inScan;
+    }
+
+    std::vector<SInt16>		mRows;
+    std::vector<Float32>	mScales;		// of each row, its peak / 32767
+    std::vector<Float32>	mNormalized;	// one row, as Push() builds it
+    UInt32			mDepth;
+    UInt32			mNumTables;
+    UInt32			mBits;
+    UInt32			mCount;
+    UInt32			mNewest;		// row of the newest scan
+};
+
+#endif
@@ -0,0 +1,640 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ On-disk LiDAR scan log: recording on the ingest thread, memory-mapped replay
+ */
+
+#include "ScanLog.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const UInt32 kLZ4HashBits = 12;
+static const size_t kLZ4MinMatch = 4;
+static const size_t kLZ4LastLiterals = 5;		// the format ends every block on this many literals
+static const size_t kLZ4MatchLimit = 12;		// and starts no match closer than this to its end
+static const size_t kLZ4MaxOffset = 65535;
+
+#pragma mark LZ4 blocks
+
+// the LZ4 block format, as the reference implementation writes and reads it, so that a chunk can be
+// inspected with the standard tools; only what the log needs of it
+
+static size_t LZ4Bound(size_t inSize)
+{
+    return inSize + inSize / 255 + 16;
+}
+
+static inline UInt32 Read32(const UInt8 *inBytes)
+{
+    UInt32 value;
+    memcpy(&value, inBytes, sizeof(value));
+    return value;
+}
+
+static inline UInt32 LZ4Hash(UInt32 inSequence)
+{
+    return (inSequence * 2654435761U) >> (32 - kLZ4HashBits);
+}
+
+static UInt8 *LZ4PutLength(UInt8 *outBytes, size_t inLength)
+{
+    for (; inLength >= 255; inLength -= 255)
+        *outBytes++ = 255;
+    *outBytes++ = UInt8(inLength);
+    return outBytes;
+}
+
+static UInt8 *LZ4PutSequence(UInt8 *outBytes, const UInt8 *inLiterals, size_t inNumLiterals, size_t inOffset, size_t inMatchLength)
+{
+    UInt8 *token = outBytes++;
+    *token = UInt8(std::min<size_t>(inNumLiterals, 15) << 4);
+    if (inNumLiterals >= 15)
+        outBytes = LZ4PutLength(outBytes, inNumLiterals - 15);
+    memcpy(outBytes, inLiterals, inNumLiterals);
+    outBytes += inNumLiterals;
+    if (inMatchLength == 0)
+        return outBytes;
+
+    *outBytes++ = UInt8(inOffset);
+    *outBytes++ = UInt8(inOffset >> 8);
+    const size_t length = inMatchLength - kLZ4MinMatch;
+    *token |= UInt8(std::min<size_t>(length, 15));
+    if (length >= 15)
+        outBytes = LZ4PutLength(outBytes, length - 15);
+    return outBytes;
+}
+
+// greedy, with one candidate per hash; outBytes must hold LZ4Bound(inSize) bytes. Returns the size.
+static size_t LZ4Compress(const UInt8 *inBytes, size_t inSize, UInt8 *outBytes)
+{
+    UInt32 table[1U << kLZ4HashBits];
+    std::fill(table, table + (1U << kLZ4HashBits), 0U);
+    UInt8 *out = outBytes;
+    size_t position = 0, anchor = 0;
+    if (inSize > kLZ4MatchLimit) {
+        const size_t limit = inSize - kLZ4MatchLimit, matchEnd = inSize - kLZ4LastLiterals;
+        while (position < limit) {
+            const UInt32 sequence = Read32(inBytes + position);
+            const UInt32 hash = LZ4Hash(sequence);
+            size_t candidate = table[hash];
+            table[hash] = UInt32(position);
+            if (candidate >= position || position - candidate > kLZ4MaxOffset || Read32(inBytes + candidate) != sequence) {
+                // the longer nothing has matched, the faster the search skips ahead
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+            while (position > anchor && candidate > 0 && inBytes[position - 1] == inBytes[candidate - 1]) {
+                --position;
+                --candidate;
+            }
+            size_t length = kLZ4MinMatch;
+            while (position + length < matchEnd && inBytes[position + length] == inBytes[candidate + length])
+                ++length;
+            out = LZ4PutSequence(out, inBytes + anchor, position - anchor, position - candidate, length);
+            position += length;
+            anchor = position;
+            if (position < limit)
+                table[LZ4Hash(Read32(inBytes + position - 2))] = UInt32(position - 2);
+        }
+    }
+    out = LZ4PutSequence(out, inBytes + anchor, inSize - anchor, 0, 0);
+    return size_t(out - outBytes);
+}
+
+static bool LZ4GetLength(const UInt8 *inBytes, size_t inSize, size_t &ioPosition, size_t &ioLength)
+{
+    UInt8 byte;
+    do {
+        if (ioPosition >= inSize)
+            return false;
+        byte = inBytes[ioPosition++];
+        ioLength += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// false unless inBytes decodes to exactly inOutSize bytes; nothing outside either buffer is touched
+static bool LZ4Decompress(const UInt8 *inBytes, size_t inSize, UInt8 *outBytes, size_t inOutSize)
+{
+    size_t in = 0, out = 0;
+    for (;;) {
+        if (in >= inSize)
+            return false;
+        const UInt8 token = inBytes[in++];
+        size_t literals = token >> 4;
+        if (literals == 15 && !LZ4GetLength(inBytes, inSize, in, literals))
+            return false;
+        if (literals > inSize - in || literals > inOutSize - out)
+            return false;
+        memcpy(outBytes + out, inBytes + in, literals);
+        in += literals;
+        out += literals;
+        if (in == inSize)
+            return out == inOutSize;
+
+        if (inSize - in < 2)
+            return false;
+        const size_t offset = inBytes[in] | (size_t(inBytes[in + 1]) << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15 && !LZ4GetLength(inBytes, inSize, in, length))
+            return false;
+        length += kLZ4MinMatch;
+        if (offset == 0 || offset > out || length > inOutSize - out)
+            return false;
+        UInt8 *target = outBytes + out;
+        const UInt8 *source = target - offset;
+        if (offset == 1)
+            memset(target, *source, length);
+        else if (offset >= length)
+            memcpy(target, source, length);
+        else
+            for (size_t i = 0; i < length; ++i)
+                target[i] = source[i];
+        out += length;
+    }
+}
+
+#pragma mark Chunk columns
+
+static size_t ChunkRawSize(UInt32 inNumScans, UInt32 inNumSamples)
+{
+    return inNumScans * (sizeof(UInt64) + sizeof(UInt32)) + 3 * size_t(inNumSamples) * sizeof(UInt32);
+}
+
+// each value's change from the one before, zigzag-coded, byte k of each in plane k
+static void PutColumn(const std::int32_t *inValues, UInt32 inCount, UInt8 *outPlanes)
+{
+    std::int32_t previous = 0;
+    for (UInt32 i = 0; i < inCount; ++i) {
+        const UInt32 delta = UInt32(inValues[i]) - UInt32(previous);
+        const UInt32 zigzag = (delta << 1) ^ UInt32(std::int32_t(delta) >> 31);
+        previous = inValues[i];
+        outPlanes[i] = UInt8(zigzag);
+        outPlanes[inCount + i] = UInt8(zigzag >> 8);
+        outPlanes[2 * inCount + i] = UInt8(zigzag >> 16);
+        outPlanes[3 * inCount + i] = UInt8(zigzag >> 24);
+    }
+}
+
+static void GetColumn(const UInt8 *inPlanes, UInt32 inCount, std::int32_t *outValues)
+{
+    UInt32 value = 0;
+    for (UInt32 i = 0; i < inCount; ++i) {
+        const UInt32 zigzag = UInt32(inPlanes[i]) | (UInt32(inPlanes[inCount + i]) << 8)
+                            | (UInt32(inPlanes[2 * inCount + i]) << 16) | (UInt32(inPlanes[3 * inCount + i]) << 24);
+        value += (zigzag >> 1) ^ (0U - (zigzag & 1));
+        outValues[i] = std::int32_t(value);
+    }
+}
+
+#pragma mark ScanLogWriter
+
+bool ScanLogWriter::Open(const char *inPath, bool inCompressed)
+{
+    Close();
+    mFile = fopen(inPath, "wb");
+    if (mFile == NULL) {
+        perror("ScanLogWriter: fopen");
+        return false;
+    }
+    // scans arrive a few times a second; a large stdio buffer keeps writes off the ingest critical path
+    setvbuf(mFile, NULL, _IOFBF, 1 << 16);
+
+    mCompressed = inCompressed;
+    ScanLogFileHeader header = { kScanLogMagic, inCompressed ? kScanLogChunkedVersion : kScanLogVersion, kScanLogByteOrderMark, 0 };
+    fwrite(&header, sizeof(header), 1, mFile);
+    mOffset = sizeof(header);
+    mNumScans = mNumSamples = 0;
+    mIndex.clear();
+    if (inCompressed) {
+        for (std::vector<std::int32_t> &column : mColumns)
+            column.reserve(kScanLogChunkSamples);
+        mRaw.reserve(ChunkRawSize(kScanLogChunkScans, kScanLogChunkSamples));
+        mCompressedChunk.reserve(LZ4Bound(ChunkRawSize(kScanLogChunkScans, kScanLogChunkSamples)));
+    }
+    return true;
+}
+
+void ScanLogWriter::Close()
+{
+    if (mFile == NULL)
+        return;
+    if (mCompressed) {
+        FlushChunk();
+        ScanLogIndexTrailer trailer = { kScanLogIndexMagic, UInt32(mIndex.size()), mOffset };
+        if (!mIndex.empty())
+            fwrite(mIndex.data(), sizeof(ScanLogIndexEntry), mIndex.size(), mFile);
+        fwrite(&trailer, sizeof(trailer), 1, mFile);
+    }
+    fclose(mFile);
+    mFile = NULL;
+}
+
+void ScanLogWriter::Write(UInt64 inCaptureTime, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                          const std::int32_t *inSignalStrengths, UInt32 inNumSamples)
+{
+    if (mFile == NULL) return;
+
+    if (mCompressed) {
+        if (mNumScans == kScanLogChunkScans || (mNumScans > 0 && mNumSamples + inNumSamples > kScanLogChunkSamples))
+            FlushChunk();
+        mCaptureTimes[mNumScans] = inCaptureTime;
+        mScanSamples[mNumScans] = inNumSamples;
+        mColumns[0].insert(mColumns[0].end(), inAngles, inAngles + inNumSamples);
+        mColumns[1].insert(mColumns[1].end(), inDistances, inDistances + inNumSamples);
+        if (inSignalStrengths)
+            mColumns[2].insert(mColumns[2].end(), inSignalStrengths, inSignalStrengths + inNumSamples);
+        else
+            mColumns[2].resize(mColumns[2].size() + inNumSamples, 0);
+        mNumScans++;
+        mNumSamples += inNumSamples;
+        return;
+    }
+
+    ScanLogBlockHeader header;
+    header.mBlockSize = UInt32(sizeof(header) + 3 * inNumSamples * sizeof(std::int32_t));
+    header.mNumSamples = inNumSamples;
+    header.mCaptureTime = inCaptureTime;
+    fwrite(&header, sizeof(header), 1, mFile);
+    fwrite(inAngles, sizeof(std::int32_t), inNumSamples, mFile);
+    fwrite(inDistances, sizeof(std::int32_t), inNumSamples, mFile);
+    if (inSignalStrengths) {
+        fwrite(inSignalStrengths, sizeof(std::int32_t), inNumSamples, mFile);
+    } else {
+        static const std::int32_t zeros[256] = { 0 };
+        for (UInt32 i = 0; i < inNumSamples; i += 256)
+            fwrite(zeros, sizeof(std::int32_t), std::min(inNumSamples - i, UInt32(256)), mFile);
+    }
+}
+
+void ScanLogWriter::FlushChunk()
+{
+    if (mNumScans == 0)
+        return;
+
+    mRaw.resize(ChunkRawSize(mNumScans, mNumSamples));
+    UInt8 *raw = mRaw.data();
+    for (UInt32 i = 0; i < mNumScans; ++i) {
+        const UInt64 offset = mCaptureTimes[i] - mCaptureTimes[0];
+        memcpy(raw, &offset, sizeof(offset));
+        raw += sizeof(offset);
+    }
+    memcpy(raw, mScanSamples, mNumScans * sizeof(UInt32));
+    raw += mNumScans * sizeof(UInt32);
+    for (std::vector<std::int32_t> &column : mColumns) {
+        PutColumn(column.data(), mNumSamples, raw);
+        raw += size_t(mNumSamples) * sizeof(UInt32);
+        column.clear();
+    }
+
+    mCompressedChunk.resize(LZ4Bound(mRaw.size()));
+    ScanLogChunkHeader header;
+    header.mMagic = kScanLogChunkMagic;
+    header.mCompressedSize = UInt32(LZ4Compress(mRaw.data(), mRaw.size(), mCompressedChunk.data()));
+    header.mNumScans = mNumScans;
+    header.mNumSamples = mNumSamples;
+    header.mFirstCapture = mCaptureTimes[0];
+    header.mLastCapture = mCaptureTimes[mNumScans - 1];
+    fwrite(&header, sizeof(header), 1, mFile);
+    fwrite(mCompressedChunk.data(), 1, header.mCompressedSize, mFile);
+
+    ScanLogIndexEntry entry = { mOffset, header.mFirstCapture, header.mLastCapture, mNumScans, mNumSamples };
+    mIndex.push_back(entry);
+    mOffset += sizeof(header) + header.mCompressedSize;
+    mNumScans = mNumSamples = 0;
+}
+
+#pragma mark ScanLogReader
+
+ScanLogReader::ScanLogReader()
+: mBase(NULL), mSize(0), mOffset(0), mVersion(0), mCurrent(0), mScan(0),
+  mPrefetchChunk(kNoChunk), mPrefetching(false), mExit(false)
+{
+}
+
+bool ScanLogReader::Open(const char *inPath)
+{
+    Close();
+    int fd = open(inPath, O_RDONLY);
+    if (fd < 0) {
+        perror("ScanLogReader: open");
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ScanLogFileHeader)) {
+        close(fd);
+        return false;
+    }
+    void *base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("ScanLogReader: mmap");
+        return false;
+    }
+    mBase = (const UInt8 *)base;
+    mSize = (size_t)info.st_size;
+
+    const ScanLogFileHeader *header = (const ScanLogFileHeader *)mBase;
+    mVersion = header->mVersion;
+    if (header->mMagic != kScanLogMagic || (mVersion != kScanLogVersion && mVersion != kScanLogChunkedVersion)
+        || header->mByteOrder != kScanLogByteOrderMark) {
+        fprintf(stderr, "ScanLogReader: %s is not a version %u or %u scan log for this host\n", inPath,
+                (unsigned)kScanLogVersion, (unsigned)kScanLogChunkedVersion);
+        Close();
+        return false;
+    }
+    // replay reads front to back exactly once per pass
+    madvise(base, mSize, MADV_SEQUENTIAL);
+
+    if (mVersion == kScanLogChunkedVersion) {
+        if (!BuildIndex()) {
+            fprintf(stderr, "ScanLogReader: %s has a damaged chunk index\n", inPath);
+            Close();
+            return false;
+        }
+        UInt32 maxScans = 0, maxSamples = 0;
+        for (const ScanLogIndexEntry &entry : mIndex) {
+            maxScans = std::max(maxScans, entry.mNumScans);
+            maxSamples = std::max(maxSamples, entry.mNumSamples);
+        }
+        for (Chunk &chunk : mChunks) {
+            chunk.mIndex = kNoChunk;
+            chunk.mNumScans = 0;
+            chunk.mRaw.resize(ChunkRawSize(maxScans, maxSamples));
+            chunk.mCaptureTimes.resize(maxScans);
+            chunk.mFirstSample.resize(maxScans);
+            chunk.mNumSamples.resize(maxScans);
+            for (std::vector<std::int32_t> &column : chunk.mColumns)
+                column.resize(maxSamples);
+        }
+        mExit = false;
+        mPrefetching = false;
+        mThread = std::thread(&ScanLogReader::PrefetchThread, this);
+    }
+    Rewind();
+    return true;
+}
+
+void ScanLogReader::Close()
+{
+    if (mThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mExit = true;
+        }
+        mCondition.notify_all();
+        mThread.join();
+    }
+    mIndex.clear();
+    if (mBase) {
+        munmap((void *)mBase, mSize);
+        mBase = NULL;
+        mSize = 0;
+        mOffset = 0;
+    }
+}
+
+// reads the index at the end of the file, or walks the chunk headers of a log that has none
+bool ScanLogReader::BuildIndex()
+{
+    mIndex.clear();
+    if (mSize >= sizeof(ScanLogFileHeader) + sizeof(ScanLogIndexTrailer)) {
+        const ScanLogIndexTrailer *trailer = (const ScanLogIndexTrailer *)(mBase + mSize - sizeof(ScanLogIndexTrailer));
+        const size_t indexBytes = size_t(trailer->mNumChunks) * sizeof(ScanLogIndexEntry);
+        if (trailer->mMagic == kScanLogIndexMagic && trailer->mIndexOffset >= sizeof(ScanLogFileHeader)
+            && trailer->mIndexOffset + indexBytes + sizeof(ScanLogIndexTrailer) == mSize) {
+            const ScanLogIndexEntry *entries = (const ScanLogIndexEntry *)(mBase + trailer->mIndexOffset);
+            mIndex.assign(entries, entries + trailer->mNumChunks);
+            for (const ScanLogIndexEntry &entry : mIndex)
+                if (entry.mOffset + sizeof(ScanLogChunkHeader) > trailer->mIndexOffset)
+                    return false;
+            return true;
+        }
+    }
+
+    // a recording that was cut short: everything up to the last complete chunk
+    for (size_t offset = sizeof(ScanLogFileHeader); offset + sizeof(ScanLogChunkHeader) <= mSize; ) {
+        const ScanLogChunkHeader *header = (const ScanLogChunkHeader *)(mBase + offset);
+        const size_t end = offset + sizeof(ScanLogChunkHeader) + header->mCompressedSize;
+        if (header->mMagic != kScanLogChunkMagic || end > mSize)
+            break;
+        ScanLogIndexEntry entry = { offset, header->mFirstCapture, header->mLastCapture, header->mNumScans, header->mNumSamples };
+        mIndex.push_back(entry);
+        offset = end;
+    }
+    return true;
+}
+
+bool ScanLogReader::Decode(UInt32 inChunk, Chunk &outChunk)
+{
+    outChunk.mIndex = kNoChunk;
+    outChunk.mNumScans = 0;
+    const ScanLogIndexEntry &entry = mIndex[inChunk];
+    const ScanLogChunkHeader *header = (const ScanLogChunkHeader *)(mBase + entry.mOffset);
+    const size_t rawSize = ChunkRawSize(header->mNumScans, header->mNumSamples);
+    if (header->mMagic != kScanLogChunkMagic || header->mNumScans != entry.mNumScans || header->mNumSamples != entry.mNumSamples
+        || entry.mOffset + sizeof(ScanLogChunkHeader) + header->mCompressedSize > mSize || rawSize > outChunk.mRaw.size())
+        return false;
+    if (!LZ4Decompress((const UInt8 *)(header + 1), header->mCompressedSize, outChunk.mRaw.data(), rawSize))
+        return false;
+
+    const UInt8 *raw = outChunk.mRaw.data();
+    UInt32 firstSample = 0;
+    for (UInt32 i = 0; i < header->mNumScans; ++i) {
+        UInt64 offset;
+        UInt32 numSamples;
+        memcpy(&offset, raw + i * sizeof(UInt64), sizeof(offset));
+        memcpy(&numSamples, raw + header->mNumScans * sizeof(UInt64) + i * sizeof(UInt32), sizeof(numSamples));
+        if (numSamples > header->mNumSamples - firstSample)
+            return false;
+        outChunk.mCaptureTimes[i] = header->mFirstCapture + offset;
+        outChunk.mFirstSample[i] = firstSample;
+        outChunk.mNumSamples[i] = numSamples;
+        firstSample += numSamples;
+    }
+    raw += header->mNumScans * (sizeof(UInt64) + sizeof(UInt32));
+    for (std::vector<std::int32_t> &column : outChunk.mColumns) {
+        GetColumn(raw, header->mNumSamples, column.data());
+        raw += size_t(header->mNumSamples) * sizeof(UInt32);
+    }
+    outChunk.mNumScans = header->mNumScans;
+    outChunk.mIndex = inChunk;
+    return true;
+}
+
+// called with the helper idle
+void ScanLogReader::Prefetch(UInt32 inChunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mPrefetchChunk = inChunk;
+        mPrefetching = true;
+    }
+    mCondition.notify_all();
+}
+
+void ScanLogReader::WaitForPrefetch()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this] { return !mPrefetching; });
+}
+
+void ScanLogReader::PrefetchThread()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mCondition.wait(lock, [this] { return mExit || mPrefetching; });
+        if (mExit)
+            return;
+        // mCurrent only changes while the helper is idle
+        Chunk &chunk = mChunks[1 - mCurrent];
+        const UInt32 index = mPrefetchChunk;
+        lock.unlock();
+        // reading the chunk here is what brings it in from the disk, off the caller's thread
+        if (chunk.mIndex != index)
+            Decode(index, chunk);
+        lock.lock();
+        mPrefetching = false;
+        mCondition.notify_all();
+    }
+}
+
+// makes inChunk the current chunk, from the helper's buffer if it has decoded it, and sets the helper
+// on the chunk after it, or on the first once it is the last
+void ScanLogReader::GoToChunk(UInt32 inChunk, UInt32 inScan)
+{
+    WaitForPrefetch();
+    if (mChunks[1 - mCurrent].mIndex == inChunk)
+        mCurrent = 1 - mCurrent;
+    else if (mChunks[mCurrent].mIndex != inChunk)
+        Decode(inChunk, mChunks[mCurrent]);
+    mScan = inScan;
+    const UInt32 next = inChunk + 1 < mIndex.size() ? inChunk + 1 : 0;
+    if (next != inChunk)
+        Prefetch(next);
+}
+
+bool ScanLogReader::Next(ScanLogBlock &outBlock)
+{
+    if (mBase == NULL) return false;
+
+    if (mVersion == kScanLogChunkedVersion) {
+        Chunk *chunk = &mChunks[mCurrent];
+        if (chunk->mIndex == kNoChunk)
+            return false;
+        if (mScan == chunk->mNumScans) {
+            if (chunk->mIndex + 1 >= mIndex.size())
+                return false;
+            GoToChunk(chunk->mIndex + 1, 0);
+            chunk = &mChunks[mCurrent];
+            // a chunk that does not decode ends the log, as a truncated block does
+            if (chunk->mIndex == kNoChunk || chunk->mNumScans == 0)
+                return false;
+        }
+        const UInt32 first = chunk->mFirstSample[mScan];
+        outBlock.mCaptureTime = chunk->mCaptureTimes[mScan];
+        outBlock.mNumSamples = chunk->mNumSamples[mScan];
+        outBlock.mAngle = chunk->mColumns[0].data() + first;
+        outBlock.mDistance = chunk->mColumns[1].data() + first;
+        outBlock.mSignalStrength = chunk->mColumns[2].data() + first;
+        mScan++;
+        return true;
+    }
+
+    if (mOffset + sizeof(ScanLogBlockHeader) > mSize) return false;
+
+    const ScanLogBlockHeader *header = (const ScanLogBlockHeader *)(mBase + mOffset);
+    size_t arrays = 3 * (size_t)header->mNumSamples * sizeof(std::int32_t);
+    if (header->mBlockSize < sizeof(ScanLogBlockHeader) + arrays || mOffset + header->mBlockSize > mSize)
+        return false;
+
+    const std::int32_t *samples = (const std::int32_t *)(header + 1);
+    outBlock.mCaptureTime = header->mCaptureTime;
+    outBlock.mNumSamples = header->mNumSamples;
+    outBlock.mAngle = samples;
+    outBlock.mDistance = samples + header->mNumSamples;
+    outBlock.mSignalStrength = samples + 2 * header->mNumSamples;
+
+    mOffset += header->mBlockSize;
+    return true;
+}
+
+void ScanLogReader::Rewind()
+{
+    mOffset = sizeof(ScanLogFileHeader);
+    if (mVersion == kScanLogChunkedVersion) {
+        if (mIndex.empty()) {
+            mChunks[mCurrent].mIndex = kNoChunk;
+            return;
+        }
+        GoToChunk(0, 0);
+    }
+}
+
+void ScanLogReader::Seek(UInt64 inCaptureTime)
+{
+    if (mBase == NULL)
+        return;
+    if (mVersion != kScanLogChunkedVersion) {
+        // a version 1 log has no index; its blocks are walked from the start
+        Rewind();
+        for (size_t offset = mOffset; ; ) {
+            ScanLogBlock block;
+            if (!Next(block) || block.mCaptureTime >= inCaptureTime) {
+                mOffset = offset;
+                return;
+            }
+            offset = mOffset;
+        }
+    }
+
+    // the first chunk that ends at or after the time, then the scan in it
+    const std::vector<ScanLogIndexEntry>::const_iterator entry = std::lower_bound(mIndex.begin(), mIndex.end(), inCaptureTime,
+        [](const ScanLogIndexEntry &inEntry, UInt64 inTime) { return inEntry.mLastCapture < inTime; });
+    if (entry == mIndex.end()) {
+        if (!mIndex.empty()) {
+            GoToChunk(UInt32(mIndex.size() - 1), 0);
+            mScan = mChunks[mCurrent].mNumScans;
+        }
+        return;
+    }
+    GoToChunk(UInt32(entry - mIndex.begin()), 0);
+    const Chunk &chunk = mChunks[mCurrent];
+    mScan = UInt32(std::lower_bound(chunk.mCaptureTimes.begin(), chunk.mCaptureTimes.begin() + chunk.mNumScans, inCaptureTime)
+                   - chunk.mCaptureTimes.begin());
+}
+
+bool ScanLogReader::GetSpan(UInt64 &outFirstCapture, UInt64 &outLastCapture, UInt64 &outNumScans)
+{
+    outFirstCapture = outLastCapture = outNumScans = 0;
+    if (mBase == NULL)
+        return false;
+    if (mVersion == kScanLogChunkedVersion) {
+        if (mIndex.empty())
+            return false;
+        outFirstCapture = mIndex.front().mFirstCapture;
+        for (const ScanLogIndexEntry &entry : mIndex) {
+            outLastCapture = std::max(outLastCapture, entry.mLastCapture);
+            outNumScans += entry.mNumScans;
+        }
+        return true;
+    }
+
+    // leaves the reader where it was
+    const size_t offset = mOffset;
+    mOffset = sizeof(ScanLogFileHeader);
+    ScanLogBlock block;
+    while (Next(block)) {
+        if (outNumScans++ == 0)
+            outFirstCapture = block.mCaptureTime;
+        outLastCapture = std::max(outLastCapture, block.mCaptureTime);
+    }
+    mOffset = offset;
+    return outNumScans > 0;
+}
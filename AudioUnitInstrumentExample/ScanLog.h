@@ -0,0 +1,227 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ On-disk LiDAR scan log: recording on the ingest thread, memory-mapped replay
+ */
+
+#ifndef __ScanLog_h__
+#define __ScanLog_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ A version 1 scan log is a ScanLogFileHeader followed by one block per scan, in capture order:
+
+	ScanLogBlockHeader
+	std::int32_t angle[mNumSamples]				milli-degrees
+	std::int32_t distance[mNumSamples]			cm
+	std::int32_t signal_strength[mNumSamples]
+
+ mBlockSize is the size of the whole block including its header, so a reader can skip blocks it
+ does not understand. All fields are in host byte order; the file header records which one.
+
+ A version 2 log, for recordings that run for days, keeps the same scans in compressed chunks of up
+ to kScanLogChunkScans scans and kScanLogChunkSamples samples, followed by an index of the chunks:
+
+	ScanLogFileHeader
+	ScanLogChunkHeader, then mCompressedSize bytes		per chunk
+	ScanLogIndexEntry[mNumChunks]
+	ScanLogIndexTrailer									the last bytes of the file
+
+ Uncompressed, a chunk is each scan's capture time, as a UInt64 offset from the chunk's first, then
+ each scan's UInt32 sample count, then one column per field: the angles, distances and signal
+ strengths of all its scans in turn. Each column holds the change from one sample to the next,
+ zigzag-coded so that small changes either way are small numbers, and split into four planes, the
+ low bytes of every value first and the high bytes last. A room scanned over and over changes
+ little from one sample to the next, so the upper planes are nearly all zeros, and the LZ4 block
+ format the chunk is compressed with takes them down to almost nothing. The index lets a reader find
+ any chunk without walking the file; a log whose recording was cut short has none, and the reader
+ walks the chunk headers once instead, up to the last complete chunk.
+ */
+
+static const UInt32 kScanLogMagic = 'LSlg';
+static const UInt32 kScanLogVersion = 1;
+static const UInt32 kScanLogChunkedVersion = 2;
+static const UInt32 kScanLogByteOrderMark = 0x01020304;
+static const UInt32 kScanLogChunkMagic = 'LSck';
+static const UInt32 kScanLogIndexMagic = 'LSix';
+static const UInt32 kScanLogChunkScans = 256;			// scans in a chunk, at most
+static const UInt32 kScanLogChunkSamples = 1U << 16;	// samples in a chunk, unless one scan alone has more
+
+struct ScanLogFileHeader
+{
+    UInt32			mMagic;
+    UInt32			mVersion;
+    UInt32			mByteOrder;			// kScanLogByteOrderMark as written by the recording host
+    UInt32			mReserved;
+};
+
+struct ScanLogBlockHeader
+{
+    UInt32			mBlockSize;
+    UInt32			mNumSamples;
+    UInt64			mCaptureTime;		// nanoseconds, host clock of the recording machine
+};
+
+struct ScanLogChunkHeader
+{
+    UInt32			mMagic;				// kScanLogChunkMagic
+    UInt32			mCompressedSize;	// of the LZ4 block that follows
+    UInt32			mNumScans;
+    UInt32			mNumSamples;		// in all its scans
+    UInt64			mFirstCapture;		// nanoseconds, of its first scan
+    UInt64			mLastCapture;
+};
+
+struct ScanLogIndexEntry
+{
+    UInt64			mOffset;			// of the chunk's header, from the start of the file
+    UInt64			mFirstCapture;
+    UInt64			mLastCapture;
+    UInt32			mNumScans;
+    UInt32			mNumSamples;
+};
+
+struct ScanLogIndexTrailer
+{
+    UInt32			mMagic;				// kScanLogIndexMagic
+    UInt32			mNumChunks;
+    UInt64			mIndexOffset;		// of the first ScanLogIndexEntry
+};
+
+// one scan inside a log; the pointers stay valid until the next call to the reader.
+struct ScanLogBlock
+{
+    UInt64					mCaptureTime;
+    UInt32					mNumSamples;
+    const std::int32_t *	mAngle;
+    const std::int32_t *	mDistance;
+    const std::int32_t *	mSignalStrength;
+};
+
+/*
+ ScanLogWriter records version 2 logs unless told otherwise. It gathers each chunk's columns as the
+ scans come in, and compresses and writes the chunk once it is full, so the ingest thread pays for a
+ chunk's compression every few seconds rather than a little on every scan. Close() writes the last
+ chunk and the index. The columns are allocated by Open().
+ */
+class ScanLogWriter
+{
+public:
+    ScanLogWriter() : mFile(NULL), mCompressed(false), mNumScans(0), mNumSamples(0) {}
+    ~ScanLogWriter() { Close(); }
+
+    // with inCompressed false, the log is written in the version 1 layout
+    bool			Open(const char *inPath, bool inCompressed = true);
+    void			Close();
+    bool			IsOpen() const { return mFile != NULL; }
+
+    // appends one scan; inSignalStrengths may be NULL, in which case zeros are written.
+    void			Write(UInt64 inCaptureTime, const std::int32_t *inAngles, const std::int32_t *inDistances,
+                          const std::int32_t *inSignalStrengths, UInt32 inNumSamples);
+
+private:
+    ScanLogWriter(const ScanLogWriter &);
+    ScanLogWriter & operator=(const ScanLogWriter &);
+
+    void			FlushChunk();
+
+    FILE *			mFile;
+    bool			mCompressed;
+    UInt64			mOffset;							// of the next chunk
+    // the chunk being gathered
+    UInt32			mNumScans;
+    UInt32			mNumSamples;
+    UInt64			mCaptureTimes[kScanLogChunkScans];
+    UInt32			mScanSamples[kScanLogChunkScans];
+    std::vector<std::int32_t>	mColumns[3];			// angles, distances and signal strengths, as they came
+    std::vector<UInt8>			mRaw;					// the chunk laid out for compression
+    std::vector<UInt8>			mCompressedChunk;
+    std::vector<ScanLogIndexEntry>	mIndex;
+};
+
+/*
+ ScanLogReader maps the whole log. A version 1 log's blocks are read in place. A version 2 log is
+ decoded a chunk at a time into one of two buffers, while a helper thread started by Open() decodes
+ the chunk after it into the other, so that replay rarely waits on decompression; on the last
+ chunk, it decodes the first again, ready for the Rewind() of a looping replay. Seek() goes
+ straight to the chunk a capture time falls in through the index. The buffers are allocated by
+ Open(), to the size of the largest chunk.
+ */
+class ScanLogReader
+{
+public:
+    ScanLogReader();
+    ~ScanLogReader() { Close(); }
+
+    // maps the whole file; returns false if it is missing or not a scan log from a host of this byte order.
+    bool			Open(const char *inPath);
+    void			Close();
+
+    // returns the next scan, or false at the end of the log (or at a truncated trailing block).
+    bool			Next(ScanLogBlock &outBlock);
+    void			Rewind();
+    // the next scan is the first captured at or after inCaptureTime, or the end of the log
+    void			Seek(UInt64 inCaptureTime);
+
+    // the capture times of the log's first and last scans and how many there are; reads the index
+    // of a version 2 log, and walks a version 1 log's blocks
+    bool			GetSpan(UInt64 &outFirstCapture, UInt64 &outLastCapture, UInt64 &outNumScans);
+
+private:
+    ScanLogReader(const ScanLogReader &);
+    ScanLogReader & operator=(const ScanLogReader &);
+
+    enum { kNoChunk = 0xFFFFFFFFU };
+
+    struct Chunk
+    {
+        UInt32					mIndex;					// of the chunk decoded into it, or kNoChunk
+        UInt32					mNumScans;
+        std::vector<UInt8>		mRaw;
+        std::vector<UInt64>		mCaptureTimes;
+        std::vector<UInt32>		mFirstSample;			// of each scan in the columns
+        std::vector<UInt32>		mNumSamples;
+        std::vector<std::int32_t>	mColumns[3];
+    };
+
+    bool			BuildIndex();
+    bool			Decode(UInt32 inChunk, Chunk &outChunk);
+    void			Prefetch(UInt32 inChunk);
+    void			WaitForPrefetch();
+    void			GoToChunk(UInt32 inChunk, UInt32 inScan);
+    void			PrefetchThread();
+
+    const UInt8 *	mBase;
+    size_t			mSize;
+    size_t			mOffset;
+    UInt32			mVersion;
+
+    std::vector<ScanLogIndexEntry>	mIndex;
+    Chunk			mChunks[2];
+    UInt32			mCurrent;							// of mChunks, the one Next() reads
+    UInt32			mScan;								// the next scan of it
+
+    // the helper thread decodes mPrefetchChunk into mChunks[1 - mCurrent] while mPrefetching
+    std::thread		mThread;
+    std::mutex		mMutex;
+    std::condition_variable	mCondition;
+    UInt32			mPrefetchChunk;
+    bool			mPrefetching;
+    bool			mExit;
+};
+
+#endif
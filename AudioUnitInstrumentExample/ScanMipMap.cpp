@@ -0,0 +1,167 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Band-limited, per-octave copies of a LiDAR scan table
+ */
+
+#include "ScanMipMap.h"
+#include <algorithm>
+
+ScanMipMapBuilder::ScanMipMapBuilder(UInt32 inBits) : mBits(0), mSize(0), mHarmonics(0)
+{
+    SetBits(inBits);
+}
+
+void ScanMipMapBuilder::SetBits(UInt32 inBits)
+{
+    if (inBits == mBits)
+        return;
+    mBits = inBits;
+    mSize = 1U << inBits;
+    mHarmonics = mSize / 2 - 1;
+    mBitReverse.resize(mSize);
+    for (UInt32 i = 0; i < mSize; ++i) {
+        UInt32 reversed = 0;
+        for (UInt32 bit = 0; bit < mBits; ++bit)
+            reversed |= ((i >> bit) & 1) << (mBits - 1 - bit);
+        mBitReverse[i] = reversed;
+    }
+    mCos.resize(mSize / 2);
+    mSin.resize(mSize / 2);
+    for (UInt32 i = 0; i < mSize / 2; ++i) {
+        double angle = 2.0 * M_PI * i / mSize;
+        mCos[i] = Float32(std::cos(angle));
+        mSin[i] = Float32(std::sin(angle));
+    }
+    // Schroeder's phases keep the crest factor of a many-partial sum low, whatever the magnitudes
+    mPhaseCos.resize(mHarmonics + 1);
+    mPhaseSin.resize(mHarmonics + 1);
+    for (UInt32 k = 1; k <= mHarmonics; ++k) {
+        double phase = -M_PI * k * (k - 1) / mHarmonics;
+        mPhaseCos[k] = Float32(std::cos(phase));
+        mPhaseSin[k] = Float32(std::sin(phase));
+    }
+    mSpectrumReal.resize(mSize);
+    mSpectrumImag.resize(mSize);
+    mReal.resize(mSize);
+    mImag.resize(mSize);
+    mMagnitude.resize(mHarmonics + 1);
+}
+
+// in-place radix-2 FFT over mSize points; the inverse is unscaled.
+void ScanMipMapBuilder::Transform(Float32 *ioReal, Float32 *ioImag, bool inInverse) const
+{
+    for (UInt32 i = 0; i < mSize; ++i) {
+        UInt32 j = mBitReverse[i];
+        if (i < j) {
+            std::swap(ioReal[i], ioReal[j]);
+            std::swap(ioImag[i], ioImag[j]);
+        }
+    }
+    const Float32 sign = inInverse ? 1.f : -1.f;
+    for (UInt32 half = 1; half < mSize; half <<= 1) {
+        UInt32 stride = mSize / (2 * half);
+        for (UInt32 start = 0; start < mSize; start += 2 * half) {
+            for (UInt32 k = 0; k < half; ++k) {
+                Float32 wr = mCos[k * stride], wi = sign * mSin[k * stride];
+                UInt32 a = start + k, b = a + half;
+                Float32 tr = ioReal[b] * wr - ioImag[b] * wi;
+                Float32 ti = ioReal[b] * wi + ioImag[b] * wr;
+                ioReal[b] = ioReal[a] - tr;
+                ioImag[b] = ioImag[a] - ti;
+                ioReal[a] += tr;
+                ioImag[a] += ti;
+            }
+        }
+    }
+}
+
+void ScanMipMapBuilder::Build(LidarScanTable &ioTable)
+{
+    SetBits(ioTable.Bits());
+    for (UInt32 i = 0; i < mSize; ++i) {
+        mSpectrumReal[i] = ioTable.mLevel[0][i];
+        mSpectrumImag[i] = 0.f;
+    }
+    Transform(mSpectrumReal.data(), mSpectrumImag.data(), false);
+
+    // a scan of N samples resolves at most N / 2 harmonics, and a sparse one (a fast motor, a slow
+    // sample rate, a narrow zone) has fewer than level 0 can hold; above that is only the
+    // interpolation between samples. Every level that would keep more is the same table, band-limited
+    // to what the scan resolved, so it is transformed back once and copied.
+    const UInt32 resolved = std::max<UInt32>(ioTable.mNumSamples / 2, 1);
+    UInt32 sharedLevel = 0;
+    const Float32 scale = 1.f / mSize;
+    for (UInt32 level = 1; level < mBits; ++level) {
+        // keep DC and harmonics 1..highest, with their mirrored negative frequencies
+        UInt32 highest = mSize / 2 >> level;
+        if (highest > resolved) {
+            if (sharedLevel != 0) {
+                std::copy(ioTable.mLevel[sharedLevel], ioTable.mLevel[sharedLevel] + mSize, ioTable.mLevel[level]);
+                continue;
+            }
+            highest = resolved;
+            sharedLevel = level;
+        }
+        for (UInt32 i = 0; i < mSize; ++i) {
+            UInt32 harmonic = i <= mSize / 2 ? i : mSize - i;
+            bool keep = harmonic <= highest;
+            mReal[i] = keep ? mSpectrumReal[i] : 0.f;
+            mImag[i] = keep ? mSpectrumImag[i] : 0.f;
+        }
+        Transform(mReal.data(), mImag.data(), true);
+        for (UInt32 i = 0; i < mSize; ++i)
+            ioTable.mLevel[level][i] = mReal[i] * scale;
+    }
+
+    BuildSpectrum(ioTable);
+}
+
+/*
+ Reads the profile in level 0 as the magnitudes of harmonics 1 to Size() / 2 - 1 instead of as a
+ waveform: harmonic k takes the closeness (1 at the sensor, 0 at kScanMaxDistance) of bins 2k - 2 and
+ 2k - 1, tilted by 1 / k, so nearby objects light up their partials and the sum keeps the spectral
+ slope of a natural tone. Each level is then synthesized with one inverse transform, keeping the
+ same harmonics as mLevel, its magnitudes scaled to add up to 1, which bounds the peak and keeps
+ high notes, with fewer partials, about as loud as low ones. The render thread plays any number of
+ partials at the cost of one table lookup.
+ */
+void ScanMipMapBuilder::BuildSpectrum(LidarScanTable &ioTable)
+{
+    const Float32 *profile = ioTable.mLevel[0];
+    Float32 *magnitude = mMagnitude.data();
+    for (UInt32 k = 1; k <= mHarmonics; ++k) {
+        Float32 distance = 0.5f * (profile[2 * k - 2] + profile[2 * k - 1]);
+        Float32 closeness = std::min(std::max(1.f - distance / kScanMaxDistance, 0.f), 1.f);
+        magnitude[k] = closeness / k;
+    }
+
+    // harmonic k at bin k and its mirror; with the 1 / N scale a bin pair of N / 2 gives unit amplitude
+    const Float32 scale = 1.f / mSize;
+    for (UInt32 level = 0; level < mBits; ++level) {
+        UInt32 highest = std::min(mSize / 2 >> level, mHarmonics);
+        Float32 sum = 0.f;
+        for (UInt32 k = 1; k <= highest; ++k)
+            sum += magnitude[k];
+        // a band with nothing in range plays its fundamental alone
+        if (sum <= 0.f) {
+            for (UInt32 i = 0; i < mSize; ++i)
+                ioTable.mSpectrum[level][i] = Float32(std::cos(2.0 * M_PI * i / mSize));
+            continue;
+        }
+        const Float32 binGain = (mSize / 2) / sum;
+        std::fill(mReal.begin(), mReal.end(), 0.f);
+        std::fill(mImag.begin(), mImag.end(), 0.f);
+        for (UInt32 k = 1; k <= highest; ++k) {
+            Float32 m = magnitude[k] * binGain;
+            mReal[k] = m * mPhaseCos[k];
+            mImag[k] = m * mPhaseSin[k];
+            mReal[mSize - k] = mReal[k];
+            mImag[mSize - k] = -mImag[k];
+        }
+        Transform(mReal.data(), mImag.data(), true);
+        for (UInt32 i = 0; i < mSize; ++i)
+            ioTable.mSpectrum[level][i] = mReal[i] * scale;
+    }
+}
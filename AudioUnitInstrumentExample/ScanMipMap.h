@@ -0,0 +1,67 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Band-limited, per-octave copies of a LiDAR scan table
+ */
+
+#ifndef __ScanMipMap_h__
+#define __ScanMipMap_h__
+
+#include "LidarScanTable.h"
+#include <vector>
+
+/*
+ ScanMipMapBuilder runs on the ingest thread, once per scan. Build() takes level 0 of a finished
+ table to the frequency domain, and for every higher level drops the harmonics above
+ Size() / 2 >> level and transforms back. A voice then reads the level whose highest
+ harmonic still fits under Nyquist at its pitch (ScanTableLevelForFrequency), so sharp edges in the
+ scan no longer alias at high notes and nothing is filtered on the render thread. When the device
+ runs fast enough to send fewer samples per rotation than there are bins, or a zone holds only a
+ few, the levels that would keep more harmonics than the samples resolve share one transform.
+
+ Build() also fills the table's mSpectrum levels (see BuildSpectrum), so either oscillator engine
+ can play any published table.
+
+ The builder's transform tables are sized for one table size; Build() resizes them for a table of
+ another, which allocates, so the hub calls SetBits() with the new size before its first scan.
+ */
+class ScanMipMapBuilder
+{
+public:
+    explicit ScanMipMapBuilder(UInt32 inBits = kScanTableDefaultBits);
+
+    void			SetBits(UInt32 inBits);
+    void			Build(LidarScanTable &ioTable);
+
+private:
+    void			BuildSpectrum(LidarScanTable &ioTable);
+    void			Transform(Float32 *ioReal, Float32 *ioImag, bool inInverse) const;
+
+    UInt32			mBits;
+    UInt32			mSize;
+    UInt32			mHarmonics;
+    std::vector<UInt32>	mBitReverse;
+    std::vector<Float32> mCos;				// mSize / 2 of each
+    std::vector<Float32> mSin;
+    std::vector<Float32> mPhaseCos;			// Schroeder phase of each harmonic, 1 to mHarmonics
+    std::vector<Float32> mPhaseSin;
+
+    std::vector<Float32> mSpectrumReal;		// mSize of each
+    std::vector<Float32> mSpectrumImag;
+    std::vector<Float32> mReal;
+    std::vector<Float32> mImag;
+    std::vector<Float32> mMagnitude;		// 1 to mHarmonics
+};
+
+// the lowest (brightest) level of a table of kScanTableMaxSize bins whose harmonics all stay below
+// half of inSampleRate at inFrequency; LidarScanTable::Level() maps it onto a table of any size.
+inline UInt32 ScanTableLevelForFrequency(double inFrequency, double inSampleRate)
+{
+    UInt32 level = 0;
+    while (level + 1 < kScanTableMaxLevels && double(kScanTableMaxSize / 2 >> level) * inFrequency > 0.5 * inSampleRate)
+        ++level;
+    return level;
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Background-subtraction motion detector over the angle-binned LiDAR scan
+ */
+
+#include "ScanMotion.h"
+#include <algorithm>
+
+static_assert((1U << kScanTableMinBits) % kAULidarModulationSectors == 0, "every modulation sector covers whole bins");
+
+void ScanMotionDetector::Reset()
+{
+    std::fill(mBackground.begin(), mBackground.end(), 0.f);
+    std::fill(mMotion.begin(), mMotion.end(), 0.f);
+    std::fill(mSector, mSector + kAULidarModulationSectors, 0.f);
+    mOverall = 0.f;
+    mLastCaptureTime = 0;
+}
+
+void ScanMotionDetector::Process(const LidarScanTable &inTable)
+{
+    const Float32 *scan = inTable.mLevel[0];
+    const UInt64 captureTime = inTable.mCaptureTime;
+    const UInt32 numBins = inTable.Size();
+    if (numBins != mNumBins) {
+        mNumBins = numBins;
+        mBackground.resize(numBins);
+        mMotion.resize(numBins);
+        mLastCaptureTime = 0;
+    }
+    if (mLastCaptureTime == 0 || captureTime <= mLastCaptureTime || captureTime - mLastCaptureTime > kScanMotionMaxGap) {
+        Reset();
+        std::copy(scan, scan + numBins, mBackground.begin());
+        mLastCaptureTime = captureTime;
+        return;
+    }
+
+    // the same decay per second however often the scans come
+    const Float32 seconds = Float32(captureTime - mLastCaptureTime) * 1.0e-9f;
+    const Float32 rate = 1.f - std::exp(-seconds / kScanMotionBackgroundSeconds);
+    const Float32 scale = 1.f / kScanMotionRange;
+    mLastCaptureTime = captureTime;
+
+    Float32 *background = mBackground.data(), *motions = mMotion.data();
+    for (UInt32 i = 0; i < numBins; ++i) {
+        Float32 difference = scan[i] - background[i];
+        Float32 motion = std::min(std::max((std::fabs(difference) - kScanMotionNoise) * scale, 0.f), 1.f);
+        motions[i] = motion;
+        background[i] += difference * rate * (1.f - motion * (1.f - kScanMotionHoldFactor));
+    }
+
+    const UInt32 binsPerSector = numBins / kAULidarModulationSectors;
+    Float32 total = 0.f;
+    for (UInt32 sector = 0; sector < kAULidarModulationSectors; ++sector) {
+        const Float32 *motion = motions + sector * binsPerSector;
+        Float32 sum = 0.f;
+        for (UInt32 i = 0; i < binsPerSector; ++i)
+            sum += motion[i];
+        mSector[sector] = sum / Float32(binsPerSector);
+        total += sum;
+    }
+    mOverall = total / Float32(numBins);
+}
+
+void ScanMotionDetector::GetModulation(Float32 *ioFeatures) const
+{
+    ioFeatures[kAULidarModulation_Motion] = mOverall;
+    std::copy(mSector, mSector + kAULidarModulationSectors, ioFeatures + kAULidarModulation_SectorMotion);
+}
@@ -0,0 +1,57 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Background-subtraction motion detector over the angle-binned LiDAR scan
+ */
+
+#ifndef __ScanMotion_h__
+#define __ScanMotion_h__
+
+#include "LidarScanTable.h"
+#include "AULidarModulationBus.h"
+#include <vector>
+
+static const Float32 kScanMotionBackgroundSeconds = 8.f;	// time constant of the background model
+static const Float32 kScanMotionHoldFactor = 0.125f;		// of the adaptation rate, in bins that are moving
+static const Float32 kScanMotionNoise = 4.f;				// cm of difference from the background ignored as jitter
+static const Float32 kScanMotionRange = 100.f;				// cm beyond kScanMotionNoise that reads as full motion
+static const UInt64 kScanMotionMaxGap = 2000000000ULL;		// ns between scans after which the background restarts
+
+/*
+ ScanMotionDetector runs on the ingest thread, once per finished table. It keeps a running background
+ of level 0 of the table, the clamped distance per bin, as an exponential moving average with a
+ time constant of kScanMotionBackgroundSeconds taken from the scans' capture times, so the cost per
+ scan is one pass over the table's bins whatever the history it stands for. A bin's motion is
+ how far the scan is from the background, past a noise floor, scaled to 0 -> 1; bins that are moving
+ adapt at a fraction of the rate, so someone standing still takes a while to become part of the room.
+
+ Every pass is a plain loop over the bin arrays with no branches, which the compiler
+ vectorizes. The first scan, and the first after a gap longer than kScanMotionMaxGap, becomes the
+ background as it is, with no motion, and so does the first table of another size, for which the
+ bin arrays are resized.
+ */
+class ScanMotionDetector
+{
+public:
+    ScanMotionDetector() : mNumBins(0) { Reset(); }
+
+    void			Reset();
+    void			Process(const LidarScanTable &inTable);
+
+    // 0 -> 1 per bin, bin 0 starting at angle 0, from the last scan processed
+    const Float32 *	Motion() const { return mMotion.data(); }
+
+    // writes kAULidarModulation_Motion and the kAULidarModulation_SectorMotion features
+    void			GetModulation(Float32 *ioFeatures) const;
+
+private:
+    UInt32			mNumBins;						// of the last table processed
+    std::vector<Float32> mBackground;				// cm
+    std::vector<Float32> mMotion;
+    Float32			mOverall;						// mean of mMotion
+    Float32			mSector[kAULidarModulationSectors];
+    UInt64			mLastCaptureTime;				// 0 before the first scan
+};
+
+#endif
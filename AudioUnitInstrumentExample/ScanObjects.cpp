@@ -0,0 +1,297 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Polar occupancy grid over the angle-binned LiDAR scan, and the objects tracked through it
+ */
+
+#include "ScanObjects.h"
+#include <algorithm>
+
+static const UInt32 kBackgroundMilliseconds = UInt32(kScanObjectBackgroundSeconds * 1000.f);
+static const UInt32 kForgetMilliseconds = UInt32(kScanObjectForgetSeconds * 1000.f);
+static_assert(kScanOccupancyRings < 0xFF, "a bin's ring is a byte");
+
+// the ring a distance falls in; everything clamped to kScanMaxDistance lands in the last
+static inline UInt32 RingOf(Float32 inDistance)
+{
+    return std::min(UInt32(std::max(inDistance, 0.f) * (1.f / kScanOccupancyRingDepth)), kScanOccupancyRings - 1);
+}
+
+ScanObjectTracker::ScanObjectTracker() : mNumBins(0)
+{
+    mNextID = 1;
+    Resize(1U << kScanTableDefaultBits);
+}
+
+void ScanObjectTracker::Resize(UInt32 inNumBins)
+{
+    mNumBins = inNumBins;
+    mCos.resize(inNumBins);
+    mSin.resize(inNumBins);
+    for (UInt32 bin = 0; bin < inNumBins; ++bin) {
+        Float64 angle = (bin + 0.5) * (2.0 * M_PI / inNumBins);
+        mCos[bin] = Float32(std::cos(angle));
+        mSin[bin] = Float32(std::sin(angle));
+    }
+    mRing.resize(inNumBins);
+    mFlags.resize(inNumBins * kScanOccupancyRings);
+    mSince.resize(inNumBins * kScanOccupancyRings);
+    mOccupied.resize(inNumBins * kScanOccupancyRings);
+    mLastSeen.resize(inNumBins * kScanOccupancyRings);
+    mForeground.resize(inNumBins);
+    mForegroundIndex.resize(inNumBins);
+    mClustered.resize(inNumBins);
+    Reset();
+}
+
+void ScanObjectTracker::Reset()
+{
+    std::fill(mRing.begin(), mRing.end(), UInt8(kNoRing));
+    std::fill(mFlags.begin(), mFlags.end(), UInt8(0));
+    std::fill(mClustered.begin(), mClustered.end(), 0U);
+    mNumForeground = 0;
+    mScan = 0;
+    for (Track &track : mTracks)
+        track.mID = 0;
+    mObjects = ScanObjectList();
+    mStartTime = 0;
+    mLastCaptureTime = 0;
+}
+
+void ScanObjectTracker::Process(const LidarScanTable &inTable)
+{
+    const Float32 *level = inTable.mLevel[0];
+    const UInt64 captureTime = inTable.mCaptureTime;
+    if (inTable.Size() != mNumBins)
+        Resize(inTable.Size());
+    if (mLastCaptureTime == 0 || captureTime <= mLastCaptureTime || captureTime - mLastCaptureTime > kScanObjectMaxGap) {
+        Reset();
+        mStartTime = mLastCaptureTime = captureTime;
+        Start(level, 0);
+        Publish(captureTime);
+        return;
+    }
+
+    const Float32 seconds = Float32(captureTime - mLastCaptureTime) * 1.0e-9f;
+    const UInt32 now = UInt32((captureTime - mStartTime) / 1000000);
+    mLastCaptureTime = captureTime;
+
+    // only the bins that left their ring touch the grid
+    for (UInt32 bin = 0; bin < mNumBins; ++bin) {
+        const Float32 lower = mRing[bin] * kScanOccupancyRingDepth - kScanOccupancyHysteresis;
+        const Float32 upper = (mRing[bin] + 1) * kScanOccupancyRingDepth + kScanOccupancyHysteresis;
+        if (level[bin] < lower || level[bin] > upper) {
+            Vacate(bin, now);
+            Occupy(bin, RingOf(level[bin]), now);
+        }
+    }
+
+    // backwards, so that a removal only moves a bin already looked at
+    for (UInt32 i = mNumForeground; i-- > 0; ) {
+        const UInt32 bin = mForeground[i];
+        const UInt32 cell = Cell(bin, mRing[bin]);
+        if (mOccupied[cell] + (now - mSince[cell]) >= kBackgroundMilliseconds) {
+            mFlags[cell] |= kBackground;
+            RemoveForeground(bin);
+        }
+    }
+
+    Associate(FindClusters(level), seconds);
+    Publish(captureTime);
+}
+
+// the room as it is: every bin's cell is background
+void ScanObjectTracker::Start(const Float32 *inLevel, UInt32)
+{
+    for (UInt32 bin = 0; bin < mNumBins; ++bin) {
+        const UInt32 ring = RingOf(inLevel[bin]);
+        const UInt32 cell = Cell(bin, ring);
+        mRing[bin] = UInt8(ring);
+        mFlags[cell] = kOccupied | kBackground | kSeen;
+    }
+}
+
+void ScanObjectTracker::Vacate(UInt32 inBin, UInt32 inNow)
+{
+    const UInt32 cell = Cell(inBin, mRing[inBin]);
+    mLastSeen[cell] = inNow;
+    if (!(mFlags[cell] & kBackground)) {
+        mOccupied[cell] += inNow - mSince[cell];
+        RemoveForeground(inBin);
+    }
+    mFlags[cell] &= ~kOccupied;
+}
+
+void ScanObjectTracker::Occupy(UInt32 inBin, UInt32 inRing, UInt32 inNow)
+{
+    const UInt32 cell = Cell(inBin, inRing);
+    mRing[inBin] = UInt8(inRing);
+
+    // the room, back from behind whatever hid it, or something that was here not long ago
+    const bool recent = (mFlags[cell] & kSeen) && inNow - mLastSeen[cell] < kForgetMilliseconds;
+    if (recent && (mFlags[cell] & kBackground)) {
+        mFlags[cell] = kOccupied | kBackground | kSeen;
+        return;
+    }
+
+    if (!recent)
+        mOccupied[cell] = 0;
+    mFlags[cell] = kOccupied | kSeen;
+    mSince[cell] = inNow;
+    mForegroundIndex[inBin] = mNumForeground;
+    mForeground[mNumForeground++] = inBin;
+}
+
+void ScanObjectTracker::RemoveForeground(UInt32 inBin)
+{
+    const UInt32 index = mForegroundIndex[inBin];
+    const UInt32 last = mForeground[--mNumForeground];
+    mForeground[index] = last;
+    mForegroundIndex[last] = index;
+}
+
+// a cluster is a run of neighbouring foreground bins, so it is found by walking out both ways from
+// each foreground bin not yet taken; returns how many of at least kScanObjectMinSize were found
+UInt32 ScanObjectTracker::FindClusters(const Float32 *inLevel)
+{
+    ++mScan;
+    UInt32 numClusters = 0;
+
+    for (UInt32 i = 0; i < mNumForeground && numClusters < kMaxScanClusters; ++i) {
+        const UInt32 seed = mForeground[i];
+        if (mClustered[seed] == mScan)
+            continue;
+        mClustered[seed] = mScan;
+
+        UInt32 first = seed, last = seed;
+        for (int direction = -1; direction <= 1; direction += 2) {
+            UInt32 bin = seed;
+            for (;;) {
+                const UInt32 next = (bin + direction) & (mNumBins - 1);
+                const UInt32 ring = mRing[next];
+                if (mClustered[next] == mScan || (mFlags[Cell(next, ring)] & (kOccupied | kBackground)) != kOccupied
+                    || UInt32(std::abs(int(ring) - int(mRing[bin]))) > kScanObjectRingStep)
+                    break;
+                mClustered[next] = mScan;
+                bin = next;
+            }
+            (direction < 0 ? first : last) = bin;
+        }
+
+        const UInt32 count = ((last - first) & (mNumBins - 1)) + 1;
+        Float32 sumX = 0.f, sumY = 0.f;
+        Float32 minX = kScanMaxDistance, maxX = -kScanMaxDistance, minY = kScanMaxDistance, maxY = -kScanMaxDistance;
+        for (UInt32 k = 0; k < count; ++k) {
+            const UInt32 bin = (first + k) & (mNumBins - 1);
+            const Float32 x = inLevel[bin] * mCos[bin], y = inLevel[bin] * mSin[bin];
+            sumX += x;
+            sumY += y;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+
+        const Float32 size = std::hypot(maxX - minX, maxY - minY);
+        if (size < kScanObjectMinSize)
+            continue;
+
+        Cluster &cluster = mClusters[numClusters++];
+        cluster.mX = sumX / count;
+        cluster.mY = sumY / count;
+        cluster.mSize = size;
+    }
+    return numClusters;
+}
+
+void ScanObjectTracker::Associate(UInt32 inNumClusters, Float32 inSeconds)
+{
+    bool taken[kMaxScanClusters] = {};
+    bool matched[kMaxScanObjects] = {};
+
+    for (Track &track : mTracks)
+        if (track.mID) {
+            track.mX += track.mVelocityX * inSeconds;
+            track.mY += track.mVelocityY * inSeconds;
+        }
+
+    // the closest pair left takes each other, until none is within the gate
+    for (;;) {
+        Float32 best = kScanObjectGate * kScanObjectGate;
+        UInt32 bestTrack = kMaxScanObjects, bestCluster = 0;
+        for (UInt32 t = 0; t < kMaxScanObjects; ++t) {
+            if (!mTracks[t].mID || matched[t])
+                continue;
+            for (UInt32 c = 0; c < inNumClusters; ++c) {
+                if (taken[c])
+                    continue;
+                const Float32 dx = mClusters[c].mX - mTracks[t].mX, dy = mClusters[c].mY - mTracks[t].mY;
+                const Float32 distance = dx * dx + dy * dy;
+                if (distance < best) {
+                    best = distance;
+                    bestTrack = t;
+                    bestCluster = c;
+                }
+            }
+        }
+        if (bestTrack == kMaxScanObjects)
+            break;
+
+        Track &track = mTracks[bestTrack];
+        const Cluster &cluster = mClusters[bestCluster];
+        const Float32 dx = cluster.mX - track.mX, dy = cluster.mY - track.mY;
+        track.mX += kScanObjectPositionGain * dx;
+        track.mY += kScanObjectPositionGain * dy;
+        track.mVelocityX += kScanObjectVelocityGain * dx / inSeconds;
+        track.mVelocityY += kScanObjectVelocityGain * dy / inSeconds;
+        track.mSize += kScanObjectPositionGain * (cluster.mSize - track.mSize);
+        track.mHits = std::min(track.mHits + 1, kScanObjectConfirmScans);
+        track.mMisses = 0;
+        matched[bestTrack] = true;
+        taken[bestCluster] = true;
+    }
+
+    for (UInt32 t = 0; t < kMaxScanObjects; ++t)
+        if (mTracks[t].mID && !matched[t] && ++mTracks[t].mMisses > kScanObjectMaxMisses)
+            mTracks[t].mID = 0;
+
+    // what is left starts a track in a free slot, if there is one
+    UInt32 slot = 0;
+    for (UInt32 c = 0; c < inNumClusters; ++c) {
+        if (taken[c])
+            continue;
+        while (slot < kMaxScanObjects && mTracks[slot].mID)
+            ++slot;
+        if (slot == kMaxScanObjects)
+            break;
+
+        Track &track = mTracks[slot];
+        track.mID = mNextID;
+        mNextID = mNextID == 0xFFFFFFFFU ? 1 : mNextID + 1;
+        track.mX = mClusters[c].mX;
+        track.mY = mClusters[c].mY;
+        track.mVelocityX = track.mVelocityY = 0.f;
+        track.mSize = mClusters[c].mSize;
+        track.mHits = 1;
+        track.mMisses = 0;
+    }
+}
+
+void ScanObjectTracker::Publish(UInt64 inCaptureTime)
+{
+    mObjects.mCaptureTime = inCaptureTime;
+    mObjects.mNumObjects = 0;
+    for (const Track &track : mTracks) {
+        if (!track.mID || track.mHits < kScanObjectConfirmScans)
+            continue;
+        ScanObject &object = mObjects.mObjects[mObjects.mNumObjects++];
+        object.mID = track.mID;
+        object.mX = track.mX;
+        object.mY = track.mY;
+        object.mVelocityX = track.mVelocityX;
+        object.mVelocityY = track.mVelocityY;
+        object.mSize = track.mSize;
+        object.mMisses = track.mMisses;
+    }
+}
@@ -0,0 +1,148 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Polar occupancy grid over the angle-binned LiDAR scan, and the objects tracked through it
+ */
+
+#ifndef __ScanObjects_h__
+#define __ScanObjects_h__
+
+#include "LidarScanTable.h"
+#include <vector>
+
+static const UInt32 kScanOccupancyRings = 64;			// range rings of the grid, out to kScanMaxDistance
+static const Float32 kScanOccupancyRingDepth = Float32(kScanMaxDistance) / kScanOccupancyRings;	// cm
+static const Float32 kScanOccupancyHysteresis = 4.f;	// cm past a ring's edges before a bin moves off it
+static const Float32 kScanObjectBackgroundSeconds = 8.f;	// a cell occupied this long in all becomes part of the room
+static const Float32 kScanObjectForgetSeconds = 60.f;	// a cell vacant longer than this starts over when it reappears
+static const UInt32 kScanObjectRingStep = 2;			// rings between neighbouring bins of one object
+static const Float32 kScanObjectMinSize = 10.f;			// cm across; a smaller cluster is taken for noise
+static const UInt32 kMaxScanObjects = 16;				// tracked at once, and published
+static const UInt32 kMaxScanClusters = 32;				// per scan; any more are not tracked
+static const Float32 kScanObjectGate = 60.f;			// cm from a track's predicted position to a cluster it may take
+static const UInt32 kScanObjectConfirmScans = 3;		// a track is published once it has been seen this often
+static const UInt32 kScanObjectMaxMisses = 5;			// scans a track coasts without a cluster before it is dropped
+static const Float32 kScanObjectPositionGain = 0.5f;	// of the alpha-beta filter
+static const Float32 kScanObjectVelocityGain = 0.2f;
+static const UInt64 kScanObjectMaxGap = 2000000000ULL;	// ns between scans after which the grid and the tracks restart
+
+// one tracked object, in the scan's frame: x along angle 0, y along 90 degrees, as ScanFusion places them
+struct ScanObject
+{
+    UInt32			mID;			// the same from scan to scan for as long as the object is tracked; never 0
+    Float32			mX, mY;			// cm, of its centre
+    Float32			mVelocityX;		// cm/s
+    Float32			mVelocityY;
+    Float32			mSize;			// cm across
+    UInt32			mMisses;		// scans since it was last seen; its position is predicted meanwhile
+};
+
+// the objects of one scan, published with its tables
+struct ScanObjectList
+{
+    ScanObjectList() : mCaptureTime(0), mNumObjects(0) {}
+
+    UInt64			mCaptureTime;	// of the scan they were tracked to
+    UInt32			mNumObjects;
+    ScanObject		mObjects[kMaxScanObjects];
+};
+
+/*
+ ScanObjectTracker runs on the ingest thread, once per table, published or not. It keeps a polar
+ occupancy grid of the table's angle bins by kScanOccupancyRings range rings built from level 0
+ of the tables: each bin occupies the cell of the ring its distance falls in, the last ring taking
+ whatever was clamped to kScanMaxDistance. A bin only moves to another ring once its distance
+ leaves the current one by more than kScanOccupancyHysteresis, so a surface on a ring's edge does
+ not flicker between two.
+
+ Per scan the bins are compared with their rings, one pass over the angles, and only the cells of
+ the bins that moved are touched. A cell that appears is foreground, part of something that has
+ come into the room, until it has been occupied for kScanObjectBackgroundSeconds in all; then it is
+ background, and stays so while it is hidden behind something for up to kScanObjectForgetSeconds,
+ so whoever walks past a wall leaves no ghost of it behind. Only a cell left vacant longer than that
+ starts its count over, so a stretch of wall first seen behind someone pacing in front of it still
+ joins the room. The foreground is kept as a list of at most one cell per
+ bin; neighbouring bins whose rings lie within kScanObjectRingStep of each other cluster into one
+ object, measured from the scan's own distances. Nothing else of the grid is read, so past the pass
+ over the angles the cost follows how much of the scan is foreground, not the grid's size.
+
+ The tracker holds up to kMaxScanObjects tracks. Each scan every track is predicted forward by its
+ velocity and takes the nearest cluster within kScanObjectGate, closest pairs first; an alpha-beta
+ filter then corrects its position, velocity and size. A cluster left over starts a track, which
+ is published once it has been seen kScanObjectConfirmScans times, and a track left over coasts on
+ its prediction until kScanObjectMaxMisses scans have passed without a cluster. Someone who stands
+ still long enough becomes background, as with ScanMotionDetector, and is dropped.
+
+ The first scan, and the first after a gap longer than kScanObjectMaxGap, becomes the room as it
+ is, with no objects; that is the only time the whole grid is cleared. So does the first table of
+ another size, for which the grid is reallocated.
+ */
+class ScanObjectTracker
+{
+public:
+    ScanObjectTracker();
+
+    void			Reset();
+    void			Process(const LidarScanTable &inTable);
+
+    // the confirmed tracks as of the last scan processed
+    const ScanObjectList &	Objects() const { return mObjects; }
+
+private:
+    enum { kNoRing = 0xFF, kOccupied = 1, kBackground = 2, kSeen = 4 };
+
+    struct Cluster
+    {
+        Float32		mX, mY, mSize;
+    };
+
+    struct Track
+    {
+        UInt32		mID;			// 0 for a free slot
+        Float32		mX, mY;
+        Float32		mVelocityX, mVelocityY;
+        Float32		mSize;
+        UInt32		mHits;
+        UInt32		mMisses;
+    };
+
+    void			Start(const Float32 *inLevel, UInt32);
+    void			Vacate(UInt32 inBin, UInt32 inNow);
+    void			Occupy(UInt32 inBin, UInt32 inRing, UInt32 inNow);
+    void			RemoveForeground(UInt32 inBin);
+    UInt32			FindClusters(const Float32 *inLevel);
+    void			Associate(UInt32 inNumClusters, Float32 inSeconds);
+    void			Publish(UInt64 inCaptureTime);
+
+    void			Resize(UInt32 inNumBins);
+
+    static UInt32	Cell(UInt32 inBin, UInt32 inRing) { return inBin * kScanOccupancyRings + inRing; }
+
+    UInt32			mNumBins;							// of the tables the grid is sized for
+    std::vector<Float32> mCos;							// of each bin's centre
+    std::vector<Float32> mSin;
+    std::vector<UInt8> mRing;							// the cell each bin occupies, or kNoRing
+
+    // per cell; times are milliseconds since the grid started
+    std::vector<UInt8> mFlags;
+    std::vector<UInt32> mSince;							// when it was last occupied
+    std::vector<UInt32> mOccupied;						// for how long, before that
+    std::vector<UInt32> mLastSeen;						// when it was last vacated
+
+    std::vector<UInt32> mForeground;					// bins whose cell is foreground, unordered
+    UInt32			mNumForeground;
+    std::vector<UInt32> mForegroundIndex;				// of each foreground bin in mForeground
+    std::vector<UInt32> mClustered;						// the scan a bin was last clustered in
+    UInt32			mScan;								// counts scans, from 1
+
+    Cluster			mClusters[kMaxScanClusters];
+    Track			mTracks[kMaxScanObjects];
+    UInt32			mNextID;
+    ScanObjectList	mObjects;
+
+    UInt64			mStartTime;							// capture time of the scan the grid started on
+    UInt64			mLastCaptureTime;					// 0 before the first scan
+};
+
+#endif
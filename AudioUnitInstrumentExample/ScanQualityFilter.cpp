@@ -0,0 +1,69 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-scan rejection, clamping and despiking of raw LiDAR samples, before they are binned
+ */
+
+#include "ScanQualityFilter.h"
+#include <algorithm>
+
+static inline std::int32_t Median3(std::int32_t a, std::int32_t b, std::int32_t c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+void ScanQualityFilter::Reserve(UInt32 inMaxSamples)
+{
+    mKeep.resize(std::max<size_t>(mKeep.size(), inMaxSamples));
+    mAngles.resize(std::max<size_t>(mAngles.size(), inMaxSamples));
+    mDistances.resize(std::max<size_t>(mDistances.size(), inMaxSamples));
+    mSignalStrengths.resize(std::max<size_t>(mSignalStrengths.size(), inMaxSamples));
+    mClamped.resize(std::max<size_t>(mClamped.size(), inMaxSamples));
+}
+
+UInt32 ScanQualityFilter::Process(const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                  const std::int32_t *inSignalStrengths, UInt32 inNumSamples)
+{
+    Reserve(inNumSamples);
+    mHasStrengths = inSignalStrengths != NULL;
+
+    // 1. keep flags
+    UInt8 *keep = mKeep.data();
+    if (mHasStrengths) {
+        const std::int32_t threshold = mMinSignalStrength;
+        for (UInt32 i = 0; i < inNumSamples; ++i)
+            keep[i] = UInt8((inSignalStrengths[i] >= threshold) & (inDistances[i] > 0));
+    } else {
+        for (UInt32 i = 0; i < inNumSamples; ++i)
+            keep[i] = UInt8(inDistances[i] > 0);
+    }
+
+    // 2. compaction; a rejected sample is written and then overwritten by the next kept one
+    std::int32_t *angles = mAngles.data(), *clamped = mClamped.data(), *strengths = mSignalStrengths.data();
+    UInt32 n = 0;
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        angles[n] = inAngles[i];
+        clamped[n] = inDistances[i];
+        strengths[n] = mHasStrengths ? inSignalStrengths[i] : 0;
+        n += keep[i];
+    }
+    mNumSamples = n;
+    mNumRejected = inNumSamples - n;
+
+    // 3. range clamp
+    for (UInt32 i = 0; i < n; ++i)
+        clamped[i] = std::min(std::max(clamped[i], 0), kScanMaxDistance);
+
+    // 4. median-of-3 despike around the circle; a scan of fewer than three samples has no spike to tell
+    std::int32_t *distances = mDistances.data();
+    if (!mDespike || n < 3) {
+        std::copy(clamped, clamped + n, distances);
+        return n;
+    }
+    distances[0] = Median3(clamped[n - 1], clamped[0], clamped[1]);
+    for (UInt32 i = 1; i + 1 < n; ++i)
+        distances[i] = Median3(clamped[i - 1], clamped[i], clamped[i + 1]);
+    distances[n - 1] = Median3(clamped[n - 2], clamped[n - 1], clamped[0]);
+    return n;
+}
@@ -0,0 +1,77 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-scan rejection, clamping and despiking of raw LiDAR samples, before they are binned
+ */
+
+#ifndef __ScanQualityFilter_h__
+#define __ScanQualityFilter_h__
+
+#include "LidarScanTable.h"
+#include <vector>
+
+static const std::int32_t kDefaultMinSignalStrength = 10;	// of sweep's 0 to 255; weaker returns are mostly noise
+
+/*
+ ScanQualityFilter runs on the ingest thread, once per scan, between the device and everything that
+ reads its samples: the table builder, the zones, the statistics, the features and the scan ring.
+ The recorder and the scan publisher still get the raw samples, so a replay or a remote host filters
+ them again with its own settings.
+
+ Process() works on the scan's structure-of-arrays in four passes, each a plain loop the compiler
+ vectorizes or a branchless one:
+   1. a keep flag per sample: its signal strength reaches the threshold and its distance is above 0
+      (sweep reports a failed reading as a short or zero distance with a weak signal);
+   2. the kept samples are compacted into the filter's own arrays, in order, by always writing and
+      only advancing on a kept sample;
+   3. each distance is clamped to [0, kScanMaxDistance];
+   4. each distance is replaced by the median of itself and its two neighbours in angle order, the
+      scan wrapping around the circle, which removes a single-sample spike and keeps any edge two
+      samples wide.
+ The holes the rejected samples leave are filled later, by ScanTableBuilder::Finish() interpolating
+ across the empty bins, so the table and everything downstream of it never see an invalid sample.
+ A scan without signal strengths (a network source that sends none) is only clamped and despiked.
+
+ The arrays grow to the largest scan seen, so Reserve() them up front to keep the ingest thread from
+ allocating.
+ */
+class ScanQualityFilter
+{
+public:
+    ScanQualityFilter() : mMinSignalStrength(kDefaultMinSignalStrength), mDespike(true), mHasStrengths(false),
+                          mNumSamples(0), mNumRejected(0) {}
+
+    void					Reserve(UInt32 inMaxSamples);
+
+    // 0 keeps every return however weak
+    void					SetMinSignalStrength(std::int32_t inStrength) { mMinSignalStrength = inStrength; }
+    std::int32_t			MinSignalStrength() const { return mMinSignalStrength; }
+    void					SetDespike(bool inDespike) { mDespike = inDespike; }
+
+    // filters a scan; returns how many of its samples were kept. inSignalStrengths may be NULL.
+    UInt32					Process(const std::int32_t *inAngles, const std::int32_t *inDistances,
+                                    const std::int32_t *inSignalStrengths, UInt32 inNumSamples);
+
+    // the samples the last Process() kept, valid until the next; SignalStrengths() is NULL if the
+    // scan had none
+    UInt32					NumSamples() const { return mNumSamples; }
+    UInt32					NumRejected() const { return mNumRejected; }
+    const std::int32_t *	Angles() const { return mAngles.data(); }
+    const std::int32_t *	Distances() const { return mDistances.data(); }
+    const std::int32_t *	SignalStrengths() const { return mHasStrengths ? mSignalStrengths.data() : NULL; }
+
+private:
+    std::int32_t			mMinSignalStrength;
+    bool					mDespike;
+    bool					mHasStrengths;
+    UInt32					mNumSamples;
+    UInt32					mNumRejected;
+    std::vector<UInt8>		mKeep;
+    std::vector<std::int32_t> mAngles;
+    std::vector<std::int32_t> mDistances;
+    std::vector<std::int32_t> mSignalStrengths;
+    std::vector<std::int32_t> mClamped;		// the distances before despiking
+};
+
+#endif
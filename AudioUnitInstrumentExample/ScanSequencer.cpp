@@ -0,0 +1,90 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Notes timed to the LiDAR beam's rotation, predicted from each scan for the next one
+ */
+
+#include "ScanSequencer.h"
+#include <algorithm>
+#include <cmath>
+
+static const UInt64 kMinRotationNanos = 75000000;		// a little faster than the motor's 10 Hz
+static const UInt64 kMaxRotationNanos = 1500000000;	// a little slower than its 1 Hz
+
+ScanSequencer::ScanSequencer()
+: mTriggers(kScanTriggerQueueSize), mLastCaptureTime(0), mRotationNanos(0)
+{
+    mSettings.mSteps = 0;
+    mSettings.mGroup = 0;
+    mSettings.mLowNote = 48;
+    mSettings.mHighNote = 84;
+    mSettings.mGate = 0.5f;
+    mSettings.mMaxDistance = kScanMaxDistance;
+}
+
+void ScanSequencer::SetSettings(const ScanSequencerSettings &inSettings)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSettings = inSettings;
+}
+
+void ScanSequencer::GetSettings(ScanSequencerSettings &outSettings)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    outSettings = mSettings;
+}
+
+void ScanSequencer::Schedule(UInt64 inCaptureTime, UInt32 inMotorSpeed, const std::int32_t *inAngles,
+                             const std::int32_t *inDistances, UInt32 inNumSamples)
+{
+    ScanSequencerSettings settings;
+    GetSettings(settings);
+
+    // the rotation, from the gap since the last scan; a dropped scan only ever lengthens the gap
+    const UInt64 nominal = inMotorSpeed ? 1000000000 / inMotorSpeed : 0;
+    if (nominal && (mRotationNanos < nominal * 3 / 4 || mRotationNanos > nominal * 5 / 4))
+        mRotationNanos = nominal;
+    const UInt64 gap = mLastCaptureTime && inCaptureTime > mLastCaptureTime ? inCaptureTime - mLastCaptureTime : 0;
+    mLastCaptureTime = inCaptureTime;
+    if (gap >= kMinRotationNanos && gap <= kMaxRotationNanos) {
+        if (mRotationNanos == 0)
+            mRotationNanos = gap;
+        else if (gap > mRotationNanos * 3 / 4 && gap < mRotationNanos * 5 / 4)
+            mRotationNanos = (3 * mRotationNanos + gap) / 4;
+        else if (nominal == 0 && gap < mRotationNanos)
+            mRotationNanos = gap;
+    }
+    if (settings.mSteps == 0 || mRotationNanos == 0 || inNumSamples == 0)
+        return;
+
+    // nearest valid return per step; sweep reports dropped samples as distance 0 or less
+    std::int32_t nearest[kMaxScanSequencerSteps];
+    std::fill(nearest, nearest + settings.mSteps, std::int32_t(-1));
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        std::int32_t distance = inDistances[i];
+        if (distance <= 0) continue;
+        std::int32_t angle = inAngles[i] % kScanFullCircle;
+        if (angle < 0) angle += kScanFullCircle;
+        UInt32 step = UInt32((std::int64_t)angle * settings.mSteps / kScanFullCircle);
+        if (nearest[step] < 0 || distance < nearest[step])
+            nearest[step] = distance;
+    }
+
+    const UInt64 gateNanos = UInt64(Float64(mRotationNanos) / settings.mSteps * settings.mGate);
+    const Float32 noteRange = Float32(settings.mHighNote) - Float32(settings.mLowNote);
+    for (UInt32 i = 1; i <= settings.mSteps; ++i) {
+        std::int32_t distance = nearest[i % settings.mSteps];
+        if (distance < 0 || distance >= settings.mMaxDistance)
+            continue;	// a rest
+        Float32 closeness = 1.f - Float32(distance) / Float32(settings.mMaxDistance);
+        ScanTriggerEvent *trigger = mTriggers.WriteItem();
+        if (!trigger) return;	// the instance isn't rendering
+        trigger->mStartTime = inCaptureTime + mRotationNanos * i / settings.mSteps;
+        trigger->mEndTime = trigger->mStartTime + gateNanos;
+        trigger->mGroup = UInt8(settings.mGroup);
+        trigger->mNote = UInt8(lroundf(Float32(settings.mLowNote) + closeness * noteRange));
+        trigger->mVelocity = UInt8(1 + lroundf(closeness * 126.f));
+        mTriggers.AdvanceWritePtr();
+    }
+}
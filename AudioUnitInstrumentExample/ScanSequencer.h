@@ -0,0 +1,89 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Notes timed to the LiDAR beam's rotation, predicted from each scan for the next one
+ */
+
+#ifndef __ScanSequencer_h__
+#define __ScanSequencer_h__
+
+#include "LidarScanTable.h"
+#include "LockFreeFIFO.h"
+#include <mutex>
+
+static const UInt32 kMaxScanSequencerSteps = 64;
+static const UInt32 kScanTriggerQueueSize = 256;	// two rotations of kMaxScanSequencerSteps, and room to spare
+
+// what kAudioUnitCustomProperty_ScanSequencer sets
+struct ScanSequencerSettings
+{
+    UInt32			mSteps;			// trigger points per rotation, equally spaced from angle 0; 0 (the default) stops it
+    UInt32			mGroup;			// the group (MIDI channel) the notes play on
+    UInt32			mLowNote;		// for a return at mMaxDistance
+    UInt32			mHighNote;		// for one touching the sensor
+    Float32			mGate;			// of a step that a note sounds, 0.05 to 1
+    std::int32_t	mMaxDistance;	// cm, 1 to kScanMaxDistance; a step with no return nearer is a rest
+
+    bool			IsValid() const
+    {
+        return mSteps <= kMaxScanSequencerSteps && mGroup < 16 && mLowNote < 128 && mHighNote < 128
+            && mGate >= 0.05f && mGate <= 1.f && mMaxDistance >= 1 && mMaxDistance <= kScanMaxDistance;
+    }
+};
+
+// a note the beam will play; its end is never later than the next trigger's start
+struct ScanTriggerEvent
+{
+    UInt64			mStartTime;		// host time in nanoseconds, on the clock of the scans' capture times
+    UInt64			mEndTime;
+    UInt8			mGroup;
+    UInt8			mNote;
+    UInt8			mVelocity;
+};
+
+// the sequencer's writer is the ingest thread, its reader the instance's render thread
+typedef LockFreeFIFO<ScanTriggerEvent> ScanTriggerQueue;
+
+/*
+ A ScanSequencer turns the rotating beam into a step sequencer. Each step is an equal sector of the
+ circle, starting at angle 0; the nearest return in it, if nearer than mMaxDistance, is a note, its
+ pitch and velocity rising as the object comes closer. The steps play as the beam crosses the start
+ of their sectors, so they fall on a grid set by the motor rather than whenever a scan or a MIDI
+ message happens to arrive.
+
+ The ingest thread calls Schedule() with each scan, which ends as the beam comes back to angle 0. By
+ then the beam is already into the next rotation, so the scan's steps are predicted for it: step k at
+ the capture time plus k / steps of a rotation, with step 0 a whole rotation on, where the next scan
+ takes over. The rotation is measured between the scans' capture times, kept within a quarter of
+ the motor speed asked for when one is set, and a scan that can't be timed schedules nothing. The
+ triggers go into the queue, preallocated, for the render thread, which only turns their times into
+ frame offsets in the cycle they fall in; a trigger that finds the queue full is dropped.
+ */
+class ScanSequencer
+{
+public:
+    ScanSequencer();
+
+    // any thread; the next scan schedules with them
+    void				SetSettings(const ScanSequencerSettings &inSettings);
+    void				GetSettings(ScanSequencerSettings &outSettings);
+
+    // the ingest thread: the steps of the rotation after the one scanned. inMotorSpeed is the speed
+    // asked of the device in Hz, or 0 if it keeps its own.
+    void				Schedule(UInt64 inCaptureTime, UInt32 inMotorSpeed, const std::int32_t *inAngles,
+                                 const std::int32_t *inDistances, UInt32 inNumSamples);
+    // forgets the rotation, when the scans move to another clock
+    void				ResetTiming() { mLastCaptureTime = 0; mRotationNanos = 0; }
+
+    ScanTriggerQueue &	Triggers() { return mTriggers; }
+
+private:
+    std::mutex				mMutex;		// guards mSettings
+    ScanSequencerSettings	mSettings;
+    ScanTriggerQueue		mTriggers;
+    UInt64					mLastCaptureTime;	// the ingest thread's
+    UInt64					mRotationNanos;		// smoothed, 0 until one is measured
+};
+
+#endif
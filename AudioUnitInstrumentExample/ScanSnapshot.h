@@ -0,0 +1,139 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Single-producer/single-consumer snapshot handoff between the LiDAR thread and the render thread
+ */
+
+#ifndef __ScanSnapshot_h__
+#define __ScanSnapshot_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ ScanSnapshotBuffer hands snapshots from one producer (the LiDAR ingest thread) to one consumer (the
+ render thread) through a fixed pool of kNumBuffers. The producer fills WriteBuffer() and calls
+ Publish() once a complete scan is in it; the consumer calls ReadBuffer() to get the most recently
+ published snapshot. Neither side ever blocks or allocates, and the consumer never sees a
+ half-written buffer.
+
+ The consumer holds each buffer it can still read: the current one, the one it replaced, which stays
+ readable as PreviousBuffer() until the next ReadBuffer() that takes a fresh one (so a consumer that
+ fades from one scan to the next releases the old one by not reading again until it is done with
+ it), and any it pinned with Retain(). A buffer whose last hold is dropped is only marked reclaimed;
+ the producer takes it back into its free set at its next Publish(), so nothing about a buffer's
+ reuse happens on the consumer's side. Release() may be called from any thread that shares the
+ consumer's work, such as a render worker.
+
+ With 4 buffers nothing can be pinned beyond the current and previous snapshots. Each buffer more
+ lets one more old snapshot stay pinned while new ones keep arriving; once every spare buffer is
+ pinned, Publish() returns false and the consumer keeps the newest snapshot it has until a pin is
+ dropped.
+
+ There must be exactly one producer thread and one consumer thread.
+ */
+template <class T, UInt32 kNumBuffers = 4>
+class ScanSnapshotBuffer
+{
+public:
+    typedef UInt32      Handle;     // of a buffer pinned by Retain()
+
+    ScanSnapshotBuffer()
+    : mMiddle(kEmpty), mReclaimed(0), mBack(0), mFreeMask(0), mFront(1), mPrevious(1)
+    {
+        static_assert(kNumBuffers >= 4 && kNumBuffers <= 32, "the free and reclaimed sets are 32-bit masks");
+        for (UInt32 i = 2; i < kNumBuffers; ++i)
+            mFreeMask |= 1U << i;
+        for (UInt32 i = 0; i < kNumBuffers; ++i)
+            mHolds[i].store(0, std::memory_order_relaxed);
+        mHolds[mFront].store(2, std::memory_order_relaxed);   // as the current and the previous snapshot
+    }
+
+    // --- producer side ---
+
+    T &                 WriteBuffer() { return mBuffers[mBack]; }
+
+    // hands the write buffer to the consumer and takes a free one to write next. false if every
+    // other buffer is held by the consumer, in which case the write buffer keeps the snapshot.
+    bool                Publish()
+    {
+        mFreeMask |= mReclaimed.exchange(0, std::memory_order_acquire);
+        if (mFreeMask == 0)
+            return false;
+        UInt32 prev = mMiddle.exchange(mBack | kFreshBit, std::memory_order_acq_rel);
+        // a snapshot the consumer never took is free again
+        if (prev & kFreshBit)
+            mFreeMask |= 1U << (prev & kIndexMask);
+        mBack = LowestBit(mFreeMask);
+        mFreeMask &= ~(1U << mBack);
+        return true;
+    }
+
+    // --- consumer side ---
+
+    // returns the newest published snapshot; the reference stays valid until the second call that
+    // takes a fresh one, the first making it PreviousBuffer().
+    const T &           ReadBuffer()
+    {
+        if (mMiddle.load(std::memory_order_relaxed) & kFreshBit) {
+            UInt32 prev = mMiddle.exchange(kEmpty, std::memory_order_acq_rel);
+            Drop(mPrevious);
+            mPrevious = mFront;     // its hold as the current snapshot becomes its hold as the previous one
+            mFront = prev & kIndexMask;
+            mHolds[mFront].store(1, std::memory_order_relaxed);
+        }
+        return mBuffers[mFront];
+    }
+
+    // the snapshot the newest one replaced
+    const T &           PreviousBuffer() const { return mBuffers[mPrevious]; }
+
+    // pins the snapshot ReadBuffer() last returned until the handle is released
+    Handle              Retain()
+    {
+        mHolds[mFront].fetch_add(1, std::memory_order_relaxed);
+        return mFront;
+    }
+    const T &           Buffer(Handle inHandle) const { return mBuffers[inHandle]; }
+    void                Release(Handle inHandle) { Drop(inHandle); }
+
+private:
+    enum { kIndexMask = 0xFF, kFreshBit = 0x100, kEmpty = kIndexMask };
+
+    ScanSnapshotBuffer(const ScanSnapshotBuffer &);
+    ScanSnapshotBuffer & operator=(const ScanSnapshotBuffer &);
+
+    static UInt32       LowestBit(UInt32 inMask)
+    {
+        UInt32 index = 0;
+        while (!(inMask & (1U << index)))
+            ++index;
+        return index;
+    }
+
+    // only the buffer a hold was taken on is changed, and the current one is never dropped to 0, so
+    // a hold dropped on another thread cannot race one taken here
+    void                Drop(UInt32 inIndex)
+    {
+        if (mHolds[inIndex].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            mReclaimed.fetch_or(1U << inIndex, std::memory_order_release);
+    }
+
+    T                   mBuffers[kNumBuffers];
+    std::atomic<UInt32> mMiddle;        // kEmpty, or the index of a published buffer plus kFreshBit
+    std::atomic<UInt32> mReclaimed;     // buffers the consumer has let go of, for the producer
+    std::atomic<UInt32> mHolds[kNumBuffers];    // the consumer's holds on each buffer
+    UInt32              mBack;          // owned by the producer
+    UInt32              mFreeMask;      // owned by the producer
+    UInt32              mFront;         // owned by the consumer
+    UInt32              mPrevious;      // owned by the consumer
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Per-scan distance statistics, computed once on the ingest thread
+ */
+
+#ifndef __ScanStatistics_h__
+#define __ScanStatistics_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+struct ScanStatistics
+{
+    ScanStatistics() : mMean(0.f), mRMS(0.f), mMin(0.f), mMax(0.f), mMedian(0.f), mInverseMean(0.f) {}
+
+    Float32			mMean;
+    Float32			mRMS;
+    Float32			mMin;
+    Float32			mMax;
+    Float32			mMedian;		// approximate, to within one histogram bucket
+    Float32			mInverseMean;	// 1 / mMean, or 0 for an all-zero scan; saves the render thread a divide
+};
+
+/*
+ Computes the statistics of inDistances[0..inNumSamples) after clamping each to
+ [0, inMaxDistance], matching the values that end up in the wavetable.
+
+ Sum, sum of squares, minimum and maximum come out of one pass with integer accumulators, which the
+ compiler vectorizes without needing to reassociate floating point adds. The median is read off a
+ kScanStatisticsBuckets histogram in a second, scalar pass; it only steers normalization, so bucket
+ resolution is plenty.
+ */
+static const UInt32 kScanStatisticsBuckets = 64;
+
+inline void ComputeScanStatistics(const std::int32_t *inDistances, UInt32 inNumSamples, std::int32_t inMaxDistance,
+                                  ScanStatistics &outStats)
+{
+    outStats = ScanStatistics();
+    if (inNumSamples == 0 || inMaxDistance <= 0) return;
+
+    std::int64_t sum = 0, sumOfSquares = 0;
+    std::int32_t lo = inMaxDistance, hi = 0;
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        std::int32_t d = std::min(std::max(inDistances[i], 0), inMaxDistance);
+        sum += d;
+        sumOfSquares += (std::int64_t)d * d;
+        lo = std::min(lo, d);
+        hi = std::max(hi, d);
+    }
+
+    UInt32 histogram[kScanStatisticsBuckets] = { 0 };
+    for (UInt32 i = 0; i < inNumSamples; ++i) {
+        std::int32_t d = std::min(std::max(inDistances[i], 0), inMaxDistance);
+        histogram[(std::int64_t)d * (kScanStatisticsBuckets - 1) / inMaxDistance]++;
+    }
+    UInt32 half = (inNumSamples + 1) / 2, seen = 0, bucket = 0;
+    while (seen + histogram[bucket] < half) seen += histogram[bucket++];
+    // interpolate within the bucket that holds the middle sample
+    Float32 bucketWidth = Float32(inMaxDistance) / (kScanStatisticsBuckets - 1);
+    Float32 within = histogram[bucket] ? Float32(half - seen) / histogram[bucket] : 0.f;
+
+    outStats.mMean = Float32(double(sum) / inNumSamples);
+    outStats.mRMS = Float32(std::sqrt(double(sumOfSquares) / inNumSamples));
+    outStats.mMin = Float32(lo);
+    outStats.mMax = Float32(hi);
+    outStats.mMedian = std::min(std::max((bucket + within) * bucketWidth, outStats.mMin), outStats.mMax);
+    outStats.mInverseMean = sum ? 1.f / outStats.mMean : 0.f;
+}
+
+#endif
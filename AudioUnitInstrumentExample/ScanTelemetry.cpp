@@ -0,0 +1,125 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Optional binary ring of recent LiDAR scans for debug tools
+ */
+
+#include "ScanTelemetry.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
+
+static const UInt32 kDefaultTelemetryRate = 10;	// scans per second
+
+ScanTelemetryTap::ScanTelemetryTap()
+: mHeader(NULL), mSlots(NULL), mMappedSize(0), mMinInterval(0), mNextScanTime(0)
+{
+}
+
+ScanTelemetryTap::~ScanTelemetryTap()
+{
+    Close();
+}
+
+void ScanTelemetryTap::Open()
+{
+    Close();
+
+    const char *path = getenv("LIDARSYNTH_TELEMETRY");
+    if (path == NULL || *path == 0) return;
+
+    UInt32 rate = kDefaultTelemetryRate;
+    if (const char *hz = getenv("LIDARSYNTH_TELEMETRY_HZ")) {
+        int value = atoi(hz);
+        if (value > 0) rate = (UInt32)value;
+    }
+    mMinInterval = 1000000000ULL / rate;
+    mNextScanTime = 0;
+
+    size_t size = sizeof(ScanTelemetryHeader) + kScanTelemetrySlots * sizeof(ScanTelemetrySlot);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror("ScanTelemetryTap: open");
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        perror("ScanTelemetryTap: fstat");
+        close(fd);
+        return;
+    }
+    // a file of any other size was not laid out by this version of the tap, so start it over.
+    bool attach = (size_t)info.st_size == size;
+    if (!attach && ftruncate(fd, (off_t)size) != 0) {
+        perror("ScanTelemetryTap: ftruncate");
+        close(fd);
+        return;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("ScanTelemetryTap: mmap");
+        return;
+    }
+
+    mMappedSize = size;
+    mHeader = reinterpret_cast<ScanTelemetryHeader *>(base);
+    mSlots = reinterpret_cast<ScanTelemetrySlot *>(mHeader + 1);
+
+    if (attach && mHeader->mMagic == kScanTelemetryMagic && mHeader->mVersion == kScanTelemetryVersion
+            && mHeader->mNumSlots == kScanTelemetrySlots && mHeader->mMaxSamples == kScanTelemetryMaxSamples) {
+        // a previous run laid the file out already: keep the heartbeat of a reader that was waiting on it.
+        mHeader->mWriteCount.store(0, std::memory_order_relaxed);
+        for (UInt32 i = 0; i < kScanTelemetrySlots; ++i)
+            mSlots[i].mSequence.store(0, std::memory_order_relaxed);
+        return;
+    }
+
+    // a new or foreign file: no atomic in it has been constructed, so initialize each one before use
+    // and publish the magic last, so a reader never accepts a half-written header.
+    mHeader->mMagic = 0;
+    std::atomic_init(&mHeader->mWriteCount, UInt64(0));
+    std::atomic_init(&mHeader->mReaderHeartbeat, UInt64(0));
+    for (UInt32 i = 0; i < kScanTelemetrySlots; ++i)
+        std::atomic_init(&mSlots[i].mSequence, UInt64(0));
+    mHeader->mVersion = kScanTelemetryVersion;
+    mHeader->mNumSlots = kScanTelemetrySlots;
+    mHeader->mMaxSamples = kScanTelemetryMaxSamples;
+    std::atomic_thread_fence(std::memory_order_release);
+    mHeader->mMagic = kScanTelemetryMagic;
+}
+
+void ScanTelemetryTap::Close()
+{
+    if (mHeader) {
+        munmap(mHeader, mMappedSize);
+        mHeader = NULL;
+        mSlots = NULL;
+        mMappedSize = 0;
+    }
+}
+
+ScanTelemetrySlot *ScanTelemetryTap::BeginScan(UInt64 inNowNanos)
+{
+    mNextScanTime = inNowNanos + mMinInterval;
+
+    UInt64 count = mHeader->mWriteCount.load(std::memory_order_relaxed);
+    ScanTelemetrySlot *slot = &mSlots[count % kScanTelemetrySlots];
+    // odd sequence: the slot is being written
+    slot->mSequence.store(2 * count + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->mCaptureTime = inNowNanos;
+    return slot;
+}
+
+void ScanTelemetryTap::EndScan(ScanTelemetrySlot *inSlot, UInt32 inNumSamples)
+{
+    inSlot->mNumSamples = inNumSamples;
+    UInt64 count = mHeader->mWriteCount.load(std::memory_order_relaxed);
+    inSlot->mSequence.store(2 * count + 2, std::memory_order_release);
+    mHeader->mWriteCount.store(count + 1, std::memory_order_release);
+}
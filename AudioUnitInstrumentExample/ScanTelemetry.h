@@ -0,0 +1,107 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Optional binary ring of recent LiDAR scans for debug tools
+ */
+
+#ifndef __ScanTelemetry_h__
+#define __ScanTelemetry_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ The telemetry tap replaces printing every sample from the LiDAR thread. When the environment
+ variable LIDARSYNTH_TELEMETRY names a file, the ingest thread maps that file and keeps the most
+ recent kScanTelemetrySlots scans in it, at most LIDARSYNTH_TELEMETRY_HZ scans per second
+ (default 10). Any process can map the same file read-only to look at them.
+
+ A reader announces itself by storing CAHostTimeBase::GetCurrentTimeInNanos() into
+ mReaderHeartbeat at least once a second; scans are only copied while a reader is alive, so the
+ ingest thread pays for one relaxed load per scan when nobody is listening and nothing at all when
+ the tap is disabled.
+
+ File layout (host byte order):
+	ScanTelemetryHeader
+	ScanTelemetrySlot[kScanTelemetrySlots]
+
+ Each slot is guarded by a sequence number: odd while the writer is filling it, even once it is
+ complete. A reader copies a slot and accepts it only if mSequence was even and unchanged before and
+ after the copy. mWriteCount is the total number of scans written; the newest is in slot
+ (mWriteCount - 1) % kScanTelemetrySlots.
+
+ The writer stores mMagic last when it lays out a new file; a reader should ignore the file until
+ mMagic and mVersion match.
+ */
+
+static const UInt32 kScanTelemetryMagic = 'LSTm';
+static const UInt32 kScanTelemetryVersion = 1;
+static const UInt32 kScanTelemetrySlots = 16;
+static const UInt32 kScanTelemetryMaxSamples = 2048;
+
+struct ScanTelemetryHeader
+{
+    UInt32                  mMagic;
+    UInt32                  mVersion;
+    UInt32                  mNumSlots;
+    UInt32                  mMaxSamples;
+    std::atomic<UInt64>     mWriteCount;
+    std::atomic<UInt64>     mReaderHeartbeat;		// nanoseconds, written by the reader
+};
+
+struct ScanTelemetrySlot
+{
+    std::atomic<UInt64>     mSequence;
+    UInt64                  mCaptureTime;			// nanoseconds
+    UInt32                  mNumSamples;
+    UInt32                  mReserved;
+    std::int32_t            mAngle[kScanTelemetryMaxSamples];
+    std::int32_t            mDistance[kScanTelemetryMaxSamples];
+    std::int32_t            mSignalStrength[kScanTelemetryMaxSamples];
+};
+
+class ScanTelemetryTap
+{
+public:
+    ScanTelemetryTap();
+    ~ScanTelemetryTap();
+
+    // maps the file named by LIDARSYNTH_TELEMETRY, if any. Call from the ingest thread before the first scan.
+    void					Open();
+    void					Close();
+
+    // true if the tap is enabled, a reader is alive and the rate limit allows another scan.
+    bool					WantsScan(UInt64 inNowNanos)
+    {
+        if (mHeader == NULL) return false;
+        if (inNowNanos < mNextScanTime) return false;
+        UInt64 heartbeat = mHeader->mReaderHeartbeat.load(std::memory_order_relaxed);
+        return inNowNanos < heartbeat + kReaderTimeout;
+    }
+
+    // returns the slot to fill, which holds room for kScanTelemetryMaxSamples samples. Must be followed by EndScan().
+    ScanTelemetrySlot *		BeginScan(UInt64 inNowNanos);
+    void					EndScan(ScanTelemetrySlot *inSlot, UInt32 inNumSamples);
+
+private:
+    static const UInt64		kReaderTimeout = 1000000000ULL;	// a reader that stops beating for a second is gone
+
+    ScanTelemetryTap(const ScanTelemetryTap &);
+    ScanTelemetryTap & operator=(const ScanTelemetryTap &);
+
+    ScanTelemetryHeader *	mHeader;
+    ScanTelemetrySlot *		mSlots;
+    size_t					mMappedSize;
+    UInt64					mMinInterval;
+    UInt64					mNextScanTime;
+};
+
+#endif
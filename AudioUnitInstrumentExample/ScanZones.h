@@ -0,0 +1,105 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Angular sectors of a LiDAR scan, each with its own wavetable and note range
+ */
+
+#ifndef __ScanZones_h__
+#define __ScanZones_h__
+
+#include "LidarScanTable.h"
+#include "ScanObjects.h"
+
+static const UInt32 kMaxScanZones = 8;
+static const UInt32 kFullScanTable = 0;		// LidarScanZones table of the whole circle
+
+// one sector of the scan and the MIDI notes that play it
+struct ScanZone
+{
+    std::int32_t	mStartAngle;	// milli-degrees; any value, taken modulo kScanFullCircle
+    std::int32_t	mSpan;			// milli-degrees, 1 to kScanFullCircle, counter-clockwise from mStartAngle
+    UInt32			mLowNote;		// MIDI note numbers, inclusive
+    UInt32			mHighNote;
+};
+
+/*
+ The value of kAudioUnitCustomProperty_ScanZones. Sectors may overlap, and so may note ranges; a
+ note plays the first zone whose range holds it, and a note outside every range plays the whole
+ scan, which is all there is while mNumZones is 0.
+ */
+struct ScanZoneMap
+{
+    ScanZoneMap() : mNumZones(0) {}
+
+    bool			IsValid() const
+    {
+        if (mNumZones > kMaxScanZones) return false;
+        for (UInt32 i = 0; i < mNumZones; ++i) {
+            const ScanZone &zone = mZones[i];
+            if (zone.mSpan < 1 || zone.mSpan > kScanFullCircle) return false;
+            if (zone.mLowNote > zone.mHighNote || zone.mHighNote > 127) return false;
+        }
+        return true;
+    }
+
+    // the LidarScanZones table a note plays
+    UInt32			TableForNote(UInt32 inNote) const
+    {
+        for (UInt32 i = 0; i < mNumZones; ++i)
+            if (inNote >= mZones[i].mLowNote && inNote <= mZones[i].mHighNote)
+                return 1 + i;
+        return kFullScanTable;
+    }
+
+    bool			operator==(const ScanZoneMap &inOther) const
+    {
+        if (mNumZones != inOther.mNumZones) return false;
+        for (UInt32 i = 0; i < mNumZones; ++i) {
+            const ScanZone &a = mZones[i], &b = inOther.mZones[i];
+            if (a.mStartAngle != b.mStartAngle || a.mSpan != b.mSpan || a.mLowNote != b.mLowNote || a.mHighNote != b.mHighNote)
+                return false;
+        }
+        return true;
+    }
+    bool			operator!=(const ScanZoneMap &inOther) const { return !(*this == inOther); }
+
+    UInt32			mNumZones;
+    ScanZone		mZones[kMaxScanZones];
+};
+
+/*
+ Everything a render cycle reads from one scan, published to each subscriber in a single snapshot
+ swap: the table of the whole circle and one table of each zone in the subscriber's ScanZoneMap,
+ every one resampled onto the full bins of the hub's resolution and band-limited, with statistics of
+ its own sector. A voice keeps to one table, so its reads stay within one contiguous LidarScanTable. The
+ objects tracked through the scans come with them, for mapping to notes and parameters, and so does
+ the zone map the tables were built for, which the hub may change while the subscriber plays: a
+ note picks its table from the map of the snapshot it starts in.
+ */
+struct LidarScanZones
+{
+    LidarScanZones() : mNumTables(1) {}
+
+    UInt64			CaptureTime() const { return mTables[kFullScanTable].mCaptureTime; }
+
+    // a table a voice picked before the zone map changed falls back to the whole scan
+    const LidarScanTable &	Table(UInt32 inIndex) const { return mTables[inIndex < mNumTables ? inIndex : kFullScanTable]; }
+
+    // copies only the tables in use
+    void			CopyFrom(const LidarScanZones &inOther)
+    {
+        mNumTables = inOther.mNumTables;
+        for (UInt32 i = 0; i < mNumTables; ++i)
+            mTables[i] = inOther.mTables[i];
+        mObjects = inOther.mObjects;
+        mZoneMap = inOther.mZoneMap;
+    }
+
+    UInt32			mNumTables;		// 1 + the number of zones
+    LidarScanTable	mTables[1 + kMaxScanZones];
+    ScanObjectList	mObjects;		// tracked up to the scan of the tables (see ScanObjectTracker)
+    ScanZoneMap		mZoneMap;		// the zones of mTables[1] on; a table the map names but not yet built plays the whole scan
+};
+
+#endif
@@ -11,8 +11,9 @@
  
  It illustrates a basic usage of these classes
  
- It artificially limits the number of notes at one time to 12, so the note-stealing
- algorithm is used - you should know how this works!
+ The number of notes at one time is kAudioUnitCustomProperty_Polyphony (kDefaultPolyphony by
+ default, up to kMaxPolyphony), set while the AU is uninitialized; Initialize() preallocates a voice
+ pool of that size, and past it the note-stealing algorithm is used - you should know how this works!
  
  Most of the work you need to do is defining a Note class (see TestNote). AUInstrument manages the
  creation and destruction of notes, the various stages of a note's lifetime.
@@ -27,25 +28,12 @@
  */
 
 #include "SinSynth.h"
-#include <thread>
-#include <zmq.hpp>
-#include <iostream>
-#include <sweep/sweep.hpp>
-#include <boost/circular_buffer.hpp>
-
-const int buf_size = 128;
-boost::circular_buffer<std::int32_t> c_buf(buf_size);
-float moving_average = 0;
-float beta = 0.9;
-
-static const UInt32 kMaxActiveNotes = 8;
+#include "AUSignpost.h"
+#include "CAHostTimeBase.h"
+#include <vector>
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-const double twopi = 2.0 * 3.14159265358979;
-
-inline double pow5(double x) { double x2 = x*x; return x2*x2*x; }
-
 #pragma mark SinSynth Methods
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -59,48 +47,121 @@ static const AudioUnitParameterID kGlobalAmpAttackParam = 1;
 static const CFStringRef kGlobalAmpAttackName = CFSTR("VCA attack");
 static const AudioUnitParameterID kGlobalAmpReleaseParam = 2;
 static const CFStringRef kGlobalAmpReleaseName = CFSTR("VCA release");
+static const AudioUnitParameterID kGlobalScanTimeParam = 3;
+static const CFStringRef kGlobalScanTimeName = CFSTR("scan time");
+static const AudioUnitParameterID kGlobalFreezeParam = 4;
+static const CFStringRef kGlobalFreezeName = CFSTR("freeze scan");
+static const AudioUnitParameterID kGlobalWindowSourceParam = 5;
+static const CFStringRef kGlobalWindowSourceName = CFSTR("window source");
+static const AudioUnitParameterID kGlobalWindowLengthParam = 6;
+static const CFStringRef kGlobalWindowLengthName = CFSTR("window length");
+static const AudioUnitParameterID kGlobalAudibilityFloorParam = 7;
+static const CFStringRef kGlobalAudibilityFloorName = CFSTR("audibility floor");
 
-struct thread_aborted{};  // temporary exception class
-std::atomic<bool> exit_flag(false);
+static const UInt8 kModWheelController = 1;
 
-void check_exit() {
-    if (exit_flag)
-        throw thread_aborted{};
-}
+static const AudioUnitParameterID kPartZoneParam = 0;
+static const CFStringRef kPartZoneName = CFSTR("zone");
+static const AudioUnitParameterID kPartAttackParam = 1;
+static const CFStringRef kPartAttackName = CFSTR("part attack");
+static const AudioUnitParameterID kPartReleaseParam = 2;
+static const CFStringRef kPartReleaseName = CFSTR("part release");
+
+// the sections SinSynth saves in its binary state
+enum
+{
+    kSinSynthState_Config = 'conf',		// SinSynthConfigState, version 1
+    kSinSynthState_Parts = 'part',		// SinSynthPartSettings for every part, version 1
+    kSinSynthState_Scan = 'scan',		// the LidarScanTable last played, flattened, version 2
+    kSinSynthState_GrainCloud = 'gcld',	// GrainCloudSettings, version 1
+    kSinSynthState_VoiceType = 'voic',	// UInt32 VoiceType, version 1
+    kSinSynthState_Sequencer = 'sseq',	// ScanSequencerSettings, version 1
+    kSinSynthState_TableSize = 'tsiz'	// UInt32 kAudioUnitCustomProperty_ScanTableSize, if it was set, version 1
+};
+
+// the properties that are set before initializing, as one section
+struct SinSynthConfigState
+{
+    UInt32			mPolyphony;
+    UInt32			mPartPolyphony[kNumParts];
+    UInt32			mRenderWorkers;
+    UInt32			mEventSliceFrames;
+    UInt32			mEngine;
+    UInt32			mHistoryDepth;
+    UInt32			mTransitionFrames;
+    UInt32			mOversampling;
+    UInt32			mRenderBlockFrames;
+    UInt32			mVelocityCurve;
+    ScanZoneMap		mZones;
+};
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	SinSynth::SinSynth
 //
-// This synth has No inputs, One output
+// This synth has No inputs, One output, and a part for each MIDI channel
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SinSynth::SinSynth(AudioUnit inComponentInstance)
-: AUMonotimbralInstrumentBase(inComponentInstance, 0, 1)
+: AUMultitimbralInstrumentBase(inComponentInstance, 0, 1, kNumParts, kNumParts),
+  mScanZones(&mScanSnapshot.ReadBuffer()),
+  mLastCaptureTime(0),
+  mTransitionFrom(NULL),
+  mTransitionFrames(0),
+  mTransitionLength(0),
+  mTransitionPosition(0),
+  mLastCycleFrames(0),
+  mPolyphony(kDefaultPolyphony),
+  mPartSettingsWriter("SinSynth part settings"),
+  mAppliedPartSettings(0),
+  mNumRenderWorkers(0),
+  mEngine(kOscillatorEngine_Waveform),
+  mHistoryDepth(kDefaultScanHistoryDepth),
+  mTableSize(0),
+  mVoiceType(kVoiceType_Wavetable),
+  mSliceOffset(0),
+  mModulationCoefficient(1.f),
+  mOversampling(1),
+  mVoiceOversampling(1),
+  mVoicesMixed(false),
+  mOfflineRender(0),
+  mOfflineFrames(0),
+  mOfflineRenderNanos(0),
+  mGrainCloudWriter("SinSynth grain cloud"),
+  mGrainCloudApplied(false),
+  mTriggerStarted(false)
 {
     CreateElements();
     
-    Globals()->UseIndexedParameters(3); // we're only defining one param
+    Globals()->UseIndexedParameters(8);
     Globals()->SetParameter (kGlobalVolumeParam, 1.0);
     Globals()->SetParameter (kGlobalAmpAttackParam, 0.0);
     Globals()->SetParameter (kGlobalAmpReleaseParam, 0.0);
+    Globals()->SetParameter (kGlobalScanTimeParam, 0.0);
+    Globals()->SetParameter (kGlobalFreezeParam, 0.0);
+    Globals()->SetParameter (kGlobalWindowSourceParam, kWindowSource_None);
+    Globals()->SetParameter (kGlobalWindowLengthParam, 0.0);
+    Globals()->SetParameter (kGlobalAudibilityFloorParam, -90.0);
+    // a part plays the zones by key and follows the global envelope until it is given its own
+    for (UInt32 i = 0; i < kNumParts; ++i) {
+        AUElement *part = Parts().GetElement(i);
+        part->UseIndexedParameters(3);
+        part->SetParameter (kPartZoneParam, 0.0);
+        part->SetParameter (kPartAttackParam, 0.0);
+        part->SetParameter (kPartReleaseParam, 0.0);
+        mPartPolyphony[i] = 0;
+        mPartEnvelopes[i].mAttackStep = mPartEnvelopes[i].mReleaseStep = 0.f;
+        mPartSettings.Pending().mVersions[i] = 0;
+    }
+    RegisterParameterBlock(mPartSettings);
+    RegisterParameterBlock(mGrainCloud);
+    SetEventSliceFrames(kDefaultEventSliceFrames);
+    // a host that sets parameters from its render thread must never wait on a property call
+    UseRealtimeMutex();
     
-    // subscriber Lidar values
-    std::thread subscriber([](){
-        sweep::sweep device{"/dev/cu.usbserial-DM00KVQW"};
-        device.start_scanning();
-        while (true) try {
-            const sweep::scan scan = device.get_scan();
-            for (const sweep::sample& sample : scan.samples) {
-                std::cout << sample.distance << std::endl;
-                c_buf.push_back(sample.distance);
-                // add 1. to avoid zero division error
-                moving_average = beta * moving_average + (1 - beta) * sample.distance + 1.;
-            }
-            check_exit();
-        } catch (thread_aborted& e){
-            //
-        }
-    });
-    subscriber.detach();
+    // subscribe to the shared LiDAR device
+    mDeviceHub = LidarDeviceHub::Acquire();
+    mDeviceHub->AddSubscriber(&mScanSnapshot, mZoneMap);
+    mDeviceHub->AddStatsSource(this);
+    mDeviceHub->AddSequencer(&mSequencer);
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -109,7 +170,42 @@ SinSynth::SinSynth(AudioUnit inComponentInstance)
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SinSynth::~SinSynth()
 {
-    exit_flag = true;
+    mDeviceHub->RemoveSequencer(&mSequencer);
+    mDeviceHub->RemoveStatsSource(this);
+    mDeviceHub->RemoveSubscriber(&mScanSnapshot);
+    mDeviceHub->Release();
+}
+
+void SinSynth::SwitchDeviceHub(LidarDeviceHub *inHub)
+{
+    mDeviceHub->RemoveSequencer(&mSequencer);
+    mDeviceHub->RemoveStatsSource(this);
+    mDeviceHub->RemoveSubscriber(&mScanSnapshot);
+    mDeviceHub->Release();
+    // uninitialized, so the render thread isn't reading; what the old hub scheduled is on another clock
+    ScanTriggerQueue &triggers = mSequencer.Triggers();
+    triggers.AdvanceReadPtr(triggers.ReadableItems());
+    mSequencer.ResetTiming();
+    mTriggerStarted = false;
+    mDeviceHub = inHub;
+    mDeviceHub->AddSubscriber(&mScanSnapshot, mZoneMap);
+    mDeviceHub->AddStatsSource(this);
+    mDeviceHub->AddSequencer(&mSequencer);
+}
+
+// reads only the render timing, through its sequence count, and the event queue's indices
+void SinSynth::GetSynthStats(SynthStatsInstance &outStats)
+{
+    AURenderTimingStatistics timing;
+    RenderTiming().GetStatistics(timing);
+    outStats.mQualityLevel = timing.mQualityLevel;
+    outStats.mEventQueueDepth = QueuedEvents();
+    outStats.mNumCycles = timing.mNumCycles;
+    outStats.mNumOverruns = timing.mNumOverruns;
+    outStats.mMeanLoad = Float32(timing.mMeanLoad);
+    outStats.mMaxLoad = Float32(timing.mMaxLoad);
+    outStats.mP99SourceLatency = Float32(timing.mP99SourceLatency);
+    memcpy(outStats.mHistogram, timing.mHistogram, sizeof(outStats.mHistogram));
 }
 
 
@@ -118,6 +214,14 @@ void SinSynth::Cleanup()
 #if DEBUG_PRINT
     printf("SinSynth::Cleanup\n");
 #endif
+    // stop every note and empty the note lists, so that Initialize() may reallocate the voices
+    AUMultitimbralInstrumentBase::Reset(kAudioUnitScope_Global, 0);
+    for (UInt32 i = 0; i < mVoices.Count(); ++i)
+        mVoices.Voice(i)->Unfreeze();
+    if (mDeviceHub->IsOffline())
+        SwitchDeviceHub(LidarDeviceHub::Acquire());
+    mGrainPool.Cancel();
+    AUMultitimbralInstrumentBase::Cleanup();
 }
 
 OSStatus SinSynth::Initialize()
@@ -125,9 +229,78 @@ OSStatus SinSynth::Initialize()
 #if DEBUG_PRINT
     printf("->SinSynth::Initialize\n");
 #endif
-    AUMonotimbralInstrumentBase::Initialize();
+    AUMultitimbralInstrumentBase::Initialize();
+    
+    // an offline render replays the log from its first scan on the render clock, through a hub of its own
+    if (mOfflineRender && !mDeviceHub->IsOffline())
+        if (LidarDeviceHub *hub = LidarDeviceHub::CreateOffline())
+            SwitchDeviceHub(hub);
+    mOfflineFrames = 0;
+    mOfflineRenderNanos = 0;
     
-    SetNotes(kNumNotes, kMaxActiveNotes, mTestNotes, sizeof(TestNote));
+    // each part's pool holds its polyphony and, beyond it, room for soft voice stealing to
+    // fast-release the notes it steals
+    UInt32 partNotes[kNumParts], numNotes = 0;
+    for (UInt32 i = 0; i < kNumParts; ++i) {
+        UInt32 polyphony = mPartPolyphony[i] ? std::min(mPartPolyphony[i], mPolyphony) : mPolyphony;
+        GetPartElement(i)->SetMaxPolyphony(polyphony);
+        partNotes[i] = polyphony + std::max(polyphony / 2, 1U);
+        numNotes += partNotes[i];
+    }
+    if (!mVoices.Resize(numNotes))
+        return kAudio_MemFullError;
+    mVoiceBank.Resize(mVoices.Count());
+    mVoiceBank.SetEngine(OscillatorEngine(mEngine));
+    // a string's line is as long as its period at the voices' rate, so only plucked voices get an arena
+    mPluckBank.Resize(IsPlucked() ? mVoices.Count() : 0, GetSampleRate() * mOversampling);
+    // an instance without zones of its own plays the hub's, from the LIDARSYNTH_CONFIG file
+    ScanZoneMap zoneMap = mZoneMap;
+    if (zoneMap.mNumZones == 0)
+        mDeviceHub->GetConfigZones(zoneMap);
+    // the hub is shared, so the resolution last set in the process is the one every instance plays
+    if (mTableSize != 0)
+        mDeviceHub->SetTableBits(ScanTableBitsForSize(mTableSize));
+    mHistory.Resize(mHistoryDepth, 1 + zoneMap.mNumZones, mDeviceHub->TableBits());
+    mLastCaptureTime = 0;	// so that the first cycle starts the fresh history from the current scan
+    mTransitionFrom = NULL;
+    for (UInt32 i = 0; i < mVoices.Count(); ++i)
+        mVoices.Voice(i)->slot = i;
+    // past stereo every zone's notes mix into a bus of their own, panned or encoded to where the zone faces
+    UInt32 numChannels = GetOutput(0)->GetStreamFormat().NumberChannels();
+    if (numChannels > 2) {
+        mPanner.Configure(mOutputChannelLayout.IsValid() ? &mOutputChannelLayout.Layout() : NULL, numChannels, zoneMap);
+        SetMonoBuses(1 + zoneMap.mNumZones);
+    } else
+        SetMonoBuses(1);
+    // oversampled, every bus is decimated on its own before it is panned
+    SetMonoOversampling(mOversampling);
+    mVoiceOversampling = mOversampling;
+    mVoiceBank.SetLinearInterpolation(true);
+    mNoteTables.SetSampleRate(GetSampleRate() * mOversampling);
+    UInt32 numDecimators = mOversampling > 1 ? NumMonoBuses() : 0;
+    mDecimators.resize(numDecimators);
+    for (UInt32 i = 0; i < numDecimators; ++i)
+        mDecimators[i].Prepare(mOversampling, GetMaxFramesPerSlice());
+    mOversampledMix.assign(numDecimators * size_t(GetMaxFramesPerSlice()) * mOversampling, 0.f);
+    mBusMixed.assign(numDecimators, false);
+    mDecimated.assign(numDecimators * size_t(GetMaxFramesPerSlice()), 0.f);
+    mDecimatedBlocks.assign(numDecimators, NULL);
+    mVoicesMixed = false;
+    mModulation.resize(Groups().GetNumberOfElements());
+    for (UInt32 i = 0; i < mModulation.size(); ++i)
+        mModulation[i].Resize(GetMaxFramesPerSlice());
+    mModulationCoefficient = ControlRateModulation::Coefficient(GetSampleRate());
+    // the grain pool runs to a megabyte or so that only a cloud plays, so it is allocated on the
+    // helper thread once one first does; the cloud then starts over from the settings of that cycle.
+    // A bounce must not depend on when the helper gets to it, so offline the pool is allocated here.
+    mGrainCloudApplied = false;
+    if (mOfflineRender)
+        mGrainPool.PrepareNow(PrepareGrains, this);
+    else
+        mGrainPool.Defer(PrepareGrains, this);
+    SetPartNotes(mVoices.Count(), mPolyphony, mVoices.First(), mVoices.Stride(), partNotes);
+    SetVoiceRenderWorkers(mNumRenderWorkers);
+    SeedScanFromState();
 #if DEBUG_PRINT
     printf("<-SinSynth::Initialize\n");
 #endif
@@ -135,6 +308,222 @@ OSStatus SinSynth::Initialize()
     return noErr;
 }
 
+// turns the sequencer's triggers due in this call into note events at their frames. A trigger is
+// consumed once its note has ended; one that ended before the call began, as those scheduled while
+// the instance was not rendering have, is dropped unplayed.
+void SinSynth::ScheduleRenderEvents(const AudioTimeStamp &inTimeStamp, UInt32 inNumberFrames)
+{
+    ScanTriggerQueue &triggers = mSequencer.Triggers();
+    UInt32 numTriggers = triggers.ReadableItems();
+    if (numTriggers == 0)
+        return;
+    
+    // offline, the triggers are on the render clock, which BeginRenderCycle() is about to advance
+    UInt64 renderNanos = 0;
+    if (mDeviceHub->IsOffline())
+        renderNanos = kOfflineClockStart + UInt64(Float64(mOfflineFrames) * 1.0e9 / GetSampleRate());
+    else if (inTimeStamp.mFlags & kAudioTimeStampHostTimeValid)
+        renderNanos = CAHostTimeBase::ConvertToNanos(inTimeStamp.mHostTime);
+    const Float64 framesPerNano = GetSampleRate() * 1.0e-9;
+    const UInt64 endNanos = renderNanos + UInt64(inNumberFrames / framesPerNano);
+    // without the host's time every trigger plays at the start of the call it is taken in, and ends
+    // at the start of the next, so that its note-on and note-off never share a frame
+    auto frameAt = [&](UInt64 inNanos) {
+        return renderNanos && inNanos > renderNanos
+            ? std::min(UInt32((inNanos - renderNanos) * framesPerNano), inNumberFrames - 1) : 0;
+    };
+    
+    UInt32 taken = 0;
+    for (; taken < numTriggers; ++taken) {
+        const ScanTriggerEvent &trigger = *triggers.ReadItemAt(taken);
+        bool startedNow = false;
+        if (!mTriggerStarted) {
+            if (renderNanos && trigger.mStartTime >= endNanos)
+                break;
+            if (renderNanos && trigger.mEndTime < renderNanos)
+                continue;
+            MusicDeviceNoteParams params;
+            params.argCount = 2;
+            params.mPitch = trigger.mNote;
+            params.mVelocity = trigger.mVelocity;
+            if (!ScheduleEvent(SynthEvent::kEventType_NoteOn, trigger.mGroup, trigger.mNote, frameAt(trigger.mStartTime), &params))
+                break;
+            mTriggerStarted = startedNow = true;
+        }
+        if (renderNanos ? trigger.mEndTime >= endNanos : startedNow)
+            break;
+        if (!ScheduleEvent(SynthEvent::kEventType_NoteOff, trigger.mGroup, trigger.mNote, frameAt(trigger.mEndTime), NULL))
+            break;
+        mTriggerStarted = false;
+    }
+    if (taken)
+        triggers.AdvanceReadPtr(taken);
+}
+
+void SinSynth::BeginRenderCycle(UInt32 inNumberFrames)
+{
+    // offline, this thread ingests the scans due by the cycle's first frame before it reads the snapshot
+    if (mDeviceHub->IsOffline()) {
+        mOfflineRenderNanos = kOfflineClockStart + UInt64(Float64(mOfflineFrames) * 1.0e9 / GetSampleRate());
+        mDeviceHub->RenderOffline(mOfflineRenderNanos);
+        mOfflineFrames += inNumberFrames;
+    }
+    // pick up the newest scan once per render cycle so that every note renders from the same table.
+    // While a crossfade is under way the scan it fades from is still being read: the snapshot buffer
+    // keeps it only until the next read that takes a fresh scan, so the next scan waits for the fade.
+    if (mTransitionFrom != NULL) {
+        mTransitionPosition += mLastCycleFrames;
+        if (mTransitionPosition >= mTransitionLength)
+            mTransitionFrom = NULL;
+    }
+    if (mTransitionFrom == NULL) {
+        const LidarScanZones *zones = &mScanSnapshot.ReadBuffer();
+        if (zones != mScanZones) {
+            AU_SIGNPOST_EVENT("SnapshotSwap");
+            // the last session's scan hands over to live data with a fade, even if scans don't usually fade
+            mTransitionLength = mTransitionFrames;
+            if (QualityLevel() >= kQualityStep_Transition)
+                mTransitionLength /= 4;
+            if (mScanZones->CaptureTime() == kCachedScanCaptureTime)
+                mTransitionLength = std::max(mTransitionLength, UInt32(GetSampleRate() * kCachedScanHandoverSeconds));
+            if (mTransitionLength > 0) {
+                mTransitionFrom = &mScanSnapshot.PreviousBuffer();
+                mTransitionPosition = 0;
+            }
+        }
+        mScanZones = zones;
+    }
+    mLastCycleFrames = inNumberFrames;
+    // a silent cycle renders no group, so the decimators never heard the voices stop
+    if (!mVoicesMixed)
+        for (UInt32 i = 0; i < mDecimators.size(); ++i)
+            mDecimators[i].Reset();
+    mVoicesMixed = false;
+    // a scan's latency runs from its capture to the host time of the first cycle that plays it.
+    // The table a new instance starts from may be long stale, so it is not counted.
+    UInt64 captureTime = mScanZones->CaptureTime();
+    if (captureTime != mLastCaptureTime) {
+        const AudioTimeStamp &renderTime = CurrentRenderTime();
+        if (mLastCaptureTime != 0 && !mDeviceHub->IsOffline()) {
+            UInt64 renderNanos = (renderTime.mFlags & kAudioTimeStampHostTimeValid)
+                ? CAHostTimeBase::ConvertToNanos(renderTime.mHostTime) : CAHostTimeBase::GetCurrentTimeInNanos();
+            RenderTiming().RecordSourceLatency((SInt64(renderNanos) - SInt64(captureTime)) * 1.0e-9);
+        }
+        mLastCaptureTime = captureTime;
+        mHistory.Push(*mScanZones, OscillatorEngine(mEngine));
+    }
+    RenderTrace().SetSourceID(captureTime);
+    // the notes' tables follow the voices' rate and the envelope times of this cycle
+    const Float64 voiceRate = GetSampleRate() * mVoiceOversampling;
+    if (voiceRate != mNoteTables.SampleRate())
+        mNoteTables.SetSampleRate(voiceRate);
+    mNoteTables.SetEnvelopeTimes(GlobalParameters()[kGlobalAmpAttackParam], GlobalParameters()[kGlobalAmpReleaseParam]);
+    for (UInt32 i = 0; i < kNumParts; ++i) {
+        AUElement *part = Parts().GetElement(i);
+        mPartEnvelopes[i] = mNoteTables.Envelope(part->GetParameter(kPartAttackParam), part->GetParameter(kPartReleaseParam));
+    }
+    // each channel's bend, and its mod wheel, which sets how far the nearest return in the scan gates
+    // its level: at full wheel the notes sound only as loud as something is close. A channel with
+    // nothing sounding starts its next note where the controls are, rather than gliding there.
+    const LidarScanTable &scan = mScanZones->Table(kFullScanTable);
+    const Float32 closeness = scan.mCaptureTime != 0 ? 1.f - scan.mStats.mMin / Float32(kScanMaxDistance) : 1.f;
+    for (UInt32 i = 0; i < mModulation.size(); ++i) {
+        SynthGroupElement *group = GroupElements()[i];
+        if (!group->IsSounding())
+            mModulation[i].Reset();
+        const Float32 wheel = static_cast<MidiControls*>(group->GetMIDIControlHandler())->GetControl(kModWheelController) / 128.f;
+        mModulation[i].Evaluate(group->GetPitchBend(), 1.f - wheel * (1.f - closeness), inNumberFrames, mModulationCoefficient);
+    }
+    // 0 plays the current scan; above 0 every voice scrubs back through the history
+    mVoiceBank.SetMorph(&mHistory, GlobalParameters()[kGlobalScanTimeParam]);
+    // a releasing voice that has fallen below the floor in the mix ends, and its note is free again
+    const Float32 audibilityFloor = std::pow(10.f, GlobalParameters()[kGlobalAudibilityFloorParam] / 20.f);
+    mVoiceBank.SetAudibilityFloor(audibilityFloor);
+    mPluckBank.SetAudibilityFloor(audibilityFloor);
+    // volume is de-zippered with a linear ramp across the block, the same for every note, toward
+    // where a scheduled ramp leaves it at the end of the block
+    mVolume.BeginBlock(GlobalParameterEnds()[kGlobalVolumeParam], inNumberFrames);
+}
+
+// the base class sheds the polyphony; the voices' interpolation and oversampling are ours, and the
+// crossfade length is read when a fade starts. A string's pitch is its line's length at the rate it
+// was started at, so plucked voices keep theirs.
+void SinSynth::QualityLevelChanged(UInt32 inLevel)
+{
+    mVoiceBank.SetLinearInterpolation(inLevel < kQualityStep_Interpolation);
+    mVoiceOversampling = inLevel < kQualityStep_Oversampling || IsPlucked() ? mOversampling : 1;
+}
+
+void SinSynth::BeginRenderSlice(UInt32 inOffsetFrames, UInt32 inNumFrames)
+{
+    mSliceVolume = mVolume.Slice(inOffsetFrames);
+    mSliceOffset = inOffsetFrames;
+    mVoiceBank.SetTransition(mTransitionFrom, mTransitionPosition + inOffsetFrames, mTransitionLength);
+}
+
+// oversampled, MixMonoBuses() has summed every sounding group's buses; they are decimated once here,
+// and a bus no group added to this slice is decimated from silence, so its filter's tail runs out
+void SinSynth::EndRenderSlice(UInt32 inOffsetFrames, UInt32 inNumFrames)
+{
+    MixGrains(inNumFrames);
+    if (mDecimators.empty())
+        return;
+    AudioBufferList *output = OutputBufferList(0);
+    if (output == NULL)
+        return;
+    const UInt32 maxFrames = GetMaxFramesPerSlice();
+    const UInt32 numBuses = UInt32(mDecimators.size());
+    bool sounding = false;
+    for (UInt32 bus = 0; bus < numBuses; ++bus) {
+        const Float32 *mix = mBusMixed[bus] ? &mOversampledMix[bus * size_t(maxFrames) * mOversampling] : NULL;
+        Float32 *decimated = &mDecimated[bus * size_t(maxFrames)];
+        mDecimatedBlocks[bus] = mDecimators[bus].Process(mix, decimated, inNumFrames) ? decimated : NULL;
+        sounding = sounding || mDecimatedBlocks[bus] != NULL;
+        mBusMixed[bus] = false;
+    }
+    mVoicesMixed = true;
+    if (!sounding)
+        return;
+    if (numBuses > 1)
+        mPanner.Mix(DSPKernels(), *output, &mDecimatedBlocks[0], numBuses, inNumFrames);
+    else
+        AUMultitimbralInstrumentBase::MixMonoBuses(*output, &mDecimatedBlocks[0], numBuses, inNumFrames);
+}
+
+// the grains render at the output rate, whatever the voices' oversampling, into one block that is
+// added to every channel at the slice's volume
+void SinSynth::MixGrains(UInt32 inNumFrames)
+{
+    // live, the first cycles of the first cloud go without grains while the pool is prepared
+    if (!mGrainPool.IsReady()) {
+        if (mGrainCloud.Current().mDensity > 0.f)
+            mGrainPool.Request();
+        return;
+    }
+    if (!mGrainCloudApplied) {
+        mGrains.SetCloud(mGrainCloud.Current());
+        mGrainCloudApplied = true;
+    }
+    if (!mGrains.IsSounding() || inNumFrames > mGrainMix.size())
+        return;
+    AudioBufferList *output = OutputBufferList(0);
+    if (output == NULL)
+        return;
+    memset(&mGrainMix[0], 0, inNumFrames * sizeof(Float32));
+    mGrains.Render(*mScanZones, 1.f, &mGrainMix[0], inNumFrames);
+    mSliceVolume.Apply(&mGrainMix[0], 0, inNumFrames);
+    const Float32 *mix = &mGrainMix[0];
+    AUMultitimbralInstrumentBase::MixMonoBuses(*output, &mix, 1, inNumFrames);
+}
+
+// on the helper thread; the render thread does not touch mGrains or mGrainMix until this is done
+void SinSynth::PrepareGrains(void *inContext)
+{
+    SinSynth *synth = static_cast<SinSynth *>(inContext);
+    synth->mGrains.Resize(kMaxGrains, synth->GetSampleRate());
+    synth->mGrainMix.assign(synth->GetMaxFramesPerSlice(), 0.f);
+}
+
 AUElement* SinSynth::CreateElement(AudioUnitScope scope,
                                    AudioUnitElement element)
 {
@@ -149,10 +538,654 @@ AUElement* SinSynth::CreateElement(AudioUnitScope scope,
     }
 }
 
+UInt32 SinSynth::SupportedNumChannels(const AUChannelInfo** outInfo)
+{
+    static const AUChannelInfo sChannels[1] = { {0, -1} };
+    if (outInfo) *outInfo = sChannels;
+    return sizeof (sChannels) / sizeof (AUChannelInfo);
+}
+
+bool SinSynth::ValidFormat(AudioUnitScope					inScope,
+                           AudioUnitElement					inElement,
+                           const CAStreamBasicDescription  & inNewFormat)
+{
+    if (inScope == kAudioUnitScope_Output && inNewFormat.NumberChannels() > kMaxOutputChannels)
+        return false;
+    return AUMultitimbralInstrumentBase::ValidFormat(inScope, inElement, inNewFormat);
+}
+
+// the output takes any layout with as many channels as its format; these are the ones a host is
+// offered for the current count
+UInt32 SinSynth::GetChannelLayoutTags(AudioUnitScope				scope,
+                                      AudioUnitElement				element,
+                                      AudioChannelLayoutTag *		outLayoutTags)
+{
+    if (scope != kAudioUnitScope_Output)
+        return AUMultitimbralInstrumentBase::GetChannelLayoutTags(scope, element, outLayoutTags);
+    if (element != 0) COMPONENT_THROW(kAudioUnitErr_InvalidElement);
+    
+    const UInt32 numChannels = GetOutput(element)->GetStreamFormat().NumberChannels();
+    AudioChannelLayoutTag tags[4];
+    UInt32 numTags = 0;
+    switch (numChannels) {
+        case 1 :	tags[numTags++] = kAudioChannelLayoutTag_Mono; break;
+        case 2 :	tags[numTags++] = kAudioChannelLayoutTag_Stereo; break;
+        case 4 :	tags[numTags++] = kAudioChannelLayoutTag_Quadraphonic; break;
+        case 5 :	tags[numTags++] = kAudioChannelLayoutTag_Pentagonal; break;
+        case 6 :	tags[numTags++] = kAudioChannelLayoutTag_Hexagonal; break;
+        case 8 :	tags[numTags++] = kAudioChannelLayoutTag_Octagonal; break;
+        default :	tags[numTags++] = kAudioChannelLayoutTag_DiscreteInOrder | numChannels; break;
+    }
+    // the Ambisonic formats SpatialPanner encodes, for a decoder downstream
+    if (numChannels == 4)
+        tags[numTags++] = kAudioChannelLayoutTag_Ambisonic_B_Format;
+    if (numChannels == 4 || numChannels == 9 || numChannels == 16)
+        tags[numTags++] = kAmbisonicACNLayoutTag | numChannels;
+    tags[numTags++] = kAudioChannelLayoutTag_UseChannelDescriptions;
+    if (outLayoutTags)
+        std::copy(tags, tags + numTags, outLayoutTags);
+    return numTags;
+}
+
+UInt32 SinSynth::GetAudioChannelLayout(AudioUnitScope			scope,
+                                       AudioUnitElement			element,
+                                       AudioChannelLayout *		outLayoutPtr,
+                                       Boolean &				outWritable)
+{
+    if (scope != kAudioUnitScope_Output)
+        return AUMultitimbralInstrumentBase::GetAudioChannelLayout(scope, element, outLayoutPtr, outWritable);
+    if (element != 0) COMPONENT_THROW(kAudioUnitErr_InvalidElement);
+    
+    UInt32 size = mOutputChannelLayout.IsValid() ? mOutputChannelLayout.Size() : 0;
+    if (size > 0 && outLayoutPtr)
+        memcpy(outLayoutPtr, mOutputChannelLayout, size);
+    outWritable = true;
+    return size;
+}
+
+// the panning gains are worked out from the layout by Initialize(); a layout that no longer matches
+// the output format by then is ignored, and the speakers are taken to be an even ring
+OSStatus SinSynth::SetAudioChannelLayout(AudioUnitScope				scope,
+                                         AudioUnitElement			element,
+                                         const AudioChannelLayout *	inLayout)
+{
+    if (scope != kAudioUnitScope_Output)
+        return AUMultitimbralInstrumentBase::SetAudioChannelLayout(scope, element, inLayout);
+    if (element != 0) return kAudioUnitErr_InvalidElement;
+    if (IsInitialized()) return kAudioUnitErr_Initialized;
+    
+    UInt32 layoutChannels = inLayout ? CAAudioChannelLayout::NumberChannels(*inLayout) : 0;
+    if (inLayout != NULL && GetOutput(element)->GetStreamFormat().NumberChannels() != layoutChannels)
+        return kAudioUnitErr_InvalidPropertyValue;
+    
+    if (inLayout)
+        mOutputChannelLayout = inLayout;
+    else
+        mOutputChannelLayout = CAAudioChannelLayout();
+    return noErr;
+}
+
+OSStatus SinSynth::RemoveAudioChannelLayout(AudioUnitScope scope, AudioUnitElement element)
+{
+    if (scope != kAudioUnitScope_Output)
+        return AUMultitimbralInstrumentBase::RemoveAudioChannelLayout(scope, element);
+    if (element != 0) return kAudioUnitErr_InvalidElement;
+    if (IsInitialized()) return kAudioUnitErr_Initialized;
+    
+    mOutputChannelLayout = CAAudioChannelLayout();
+    return noErr;
+}
+
+// called past stereo, with a bus for each zone, or with every sounding group's buses when the
+// voices are oversampled, which are summed for EndRenderSlice() to bring down to the output rate
+void SinSynth::MixMonoBuses(AudioBufferList &ioBus, const Float32 *const *inBuses, UInt32 inNumBuses,
+                            UInt32 inNumberFrames)
+{
+    if (!mDecimators.empty()) {
+        const size_t busFrames = size_t(GetMaxFramesPerSlice()) * mOversampling;
+        const UInt32 numFrames = inNumberFrames * mOversampling;
+        for (UInt32 bus = 0; bus < inNumBuses; ++bus) {
+            if (inBuses[bus] == NULL)
+                continue;
+            Float32 *mix = &mOversampledMix[bus * busFrames];
+            if (mBusMixed[bus])
+                DSPKernels().Add(inBuses[bus], mix, 1, numFrames);
+            else
+                memcpy(mix, inBuses[bus], numFrames * sizeof(Float32));
+            mBusMixed[bus] = true;
+        }
+        return;
+    }
+    if (inNumBuses > 1)
+        mPanner.Mix(DSPKernels(), ioBus, inBuses, inNumBuses, inNumberFrames);
+    else
+        AUMultitimbralInstrumentBase::MixMonoBuses(ioBus, inBuses, inNumBuses, inNumberFrames);
+}
+
+// On the render thread, before Render(): the parts set since the version applied last take all
+// three parameters at once, so the cycle's envelopes and tables are worked out from them together.
+void SinSynth::ParameterBlockChanged(AUParameterBlockBase &inBlock)
+{
+    if (&inBlock == &mGrainCloud) {
+        // before the pool is prepared, MixGrains applies the cloud once it is
+        if (mGrainCloudApplied)
+            mGrains.SetCloud(mGrainCloud.Current());
+        return;
+    }
+    if (&inBlock != &mPartSettings)
+        return;
+    const PartSettingsBlock &block = mPartSettings.Current();
+    for (UInt32 i = 0; i < kNumParts; ++i) {
+        if (block.mVersions[i] <= mAppliedPartSettings)
+            continue;
+        AUElement *part = Parts().GetElement(i);
+        part->SetParameter(kPartZoneParam, block.mParts[i].mZone);
+        part->SetParameter(kPartAttackParam, block.mParts[i].mAttack);
+        part->SetParameter(kPartReleaseParam, block.mParts[i].mRelease);
+    }
+    mAppliedPartSettings = mPartSettings.Version();
+}
+
+UInt32 SinSynth::TableForNote(SynthPartElement *inPart, UInt32 inKey) const
+{
+    // the map of the scan being played, which came with its tables
+    const ScanZoneMap &zoneMap = mScanZones->mZoneMap;
+    UInt32 zone = UInt32(inPart->GetParameter(kPartZoneParam));
+    return zone == 0 ? zoneMap.TableForNote(inKey) : std::min(zone - 1, zoneMap.mNumZones);
+}
+
+WavetableWindow SinSynth::WindowForNote(const MusicDeviceNoteParams &inParams, UInt32 inKey) const
+{
+    Float32 position = 0.f;
+    switch (UInt32(GlobalParameters()[kGlobalWindowSourceParam])) {
+        case kWindowSource_Velocity:
+            position = inParams.mVelocity / 127.f;
+            break;
+        case kWindowSource_Key:
+            position = Float32(inKey) / 127.f;
+            break;
+        case kWindowSource_NoteControl:
+            // argCount counts the pitch and velocity ahead of the controls
+            for (UInt32 i = 2; i < inParams.argCount; ++i)
+                if (inParams.mControls[i - 2].mID == kSinSynthNoteControl_WindowPosition)
+                    position = inParams.mControls[i - 2].mValue;
+            break;
+        default:
+            return kWavetableFullWindow;
+    }
+    return WavetableWindowAt(position, UInt32(GlobalParameters()[kGlobalWindowLengthParam]));
+}
+
+Float64 SinSynth::GetLatency()
+{
+    return mDecimators.empty() ? 0. : mDecimators[0].Latency() / GetSampleRate();
+}
+
+void SinSynth::SaveBinaryState(AUBinaryStateWriter &ioWriter)
+{
+    SinSynthConfigState config;
+    config.mPolyphony = mPolyphony;
+    for (UInt32 i = 0; i < kNumParts; ++i)
+        config.mPartPolyphony[i] = mPartPolyphony[i];
+    config.mRenderWorkers = mNumRenderWorkers;
+    config.mEventSliceFrames = EventSliceFrames();
+    config.mEngine = mEngine;
+    config.mHistoryDepth = mHistoryDepth;
+    config.mTransitionFrames = mTransitionFrames;
+    config.mOversampling = mOversampling;
+    config.mRenderBlockFrames = RenderBlockFrames();
+    config.mVelocityCurve = mNoteTables.Curve();
+    config.mZones = mZoneMap;
+    ioWriter.AddSection(kSinSynthState_Config, 1, config);
+    
+    SinSynthPartSettings parts[kNumParts];
+    for (UInt32 i = 0; i < kNumParts; ++i)
+        GetProperty(kAudioUnitCustomProperty_PartSettings, kAudioUnitScope_Part, i, &parts[i]);
+    ioWriter.AddSection(kSinSynthState_Parts, 1, parts);
+    
+    GrainCloudSettings cloud;
+    GetProperty(kAudioUnitCustomProperty_GrainCloud, kAudioUnitScope_Global, 0, &cloud);
+    ioWriter.AddSection(kSinSynthState_GrainCloud, 1, cloud);
+    ioWriter.AddSection(kSinSynthState_VoiceType, 1, mVoiceType);
+    ScanSequencerSettings sequencer;
+    mSequencer.GetSettings(sequencer);
+    ioWriter.AddSection(kSinSynthState_Sequencer, 1, sequencer);
+    if (mTableSize != 0)
+        ioWriter.AddSection(kSinSynthState_TableSize, 1, mTableSize);
+    
+    // the scan is most of the state, so it goes into the writer flattened, at its own resolution
+    LidarScanTable table;
+    if (mDeviceHub->CopyLastTable(table)) {
+        std::vector<char> flat(table.FlatBytes());
+        table.Flatten(flat.data());
+        ioWriter.AddSection(kSinSynthState_Scan, 2, flat.data(), UInt32(flat.size()));
+    }
+}
+
+void SinSynth::RestoreBinaryState(const AUBinaryStateReader &inReader)
+{
+    // each value goes through its property, so a state from a build with other limits is checked the
+    // same way a host's values are; the ones refused, or set while initialized, are left as they are
+    SinSynthConfigState config;
+    if (inReader.ReadSection(kSinSynthState_Config, 1, config)) {
+        SetProperty(kAudioUnitCustomProperty_Polyphony, kAudioUnitScope_Global, 0, &config.mPolyphony, sizeof(UInt32));
+        for (UInt32 i = 0; i < kNumParts; ++i)
+            SetProperty(kAudioUnitCustomProperty_PartPolyphony, kAudioUnitScope_Part, i, &config.mPartPolyphony[i], sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_RenderWorkers, kAudioUnitScope_Global, 0, &config.mRenderWorkers, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_EventSliceFrames, kAudioUnitScope_Global, 0, &config.mEventSliceFrames, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_OscillatorEngine, kAudioUnitScope_Global, 0, &config.mEngine, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_ScanHistoryDepth, kAudioUnitScope_Global, 0, &config.mHistoryDepth, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_ScanTransitionFrames, kAudioUnitScope_Global, 0, &config.mTransitionFrames, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_Oversampling, kAudioUnitScope_Global, 0, &config.mOversampling, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_RenderBlockFrames, kAudioUnitScope_Global, 0, &config.mRenderBlockFrames, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_VelocityCurve, kAudioUnitScope_Global, 0, &config.mVelocityCurve, sizeof(UInt32));
+        SetProperty(kAudioUnitCustomProperty_ScanZones, kAudioUnitScope_Global, 0, &config.mZones, sizeof(ScanZoneMap));
+    }
+    
+    SinSynthPartSettings parts[kNumParts];
+    if (inReader.ReadSection(kSinSynthState_Parts, 1, parts))
+        for (UInt32 i = 0; i < kNumParts; ++i)
+            SetProperty(kAudioUnitCustomProperty_PartSettings, kAudioUnitScope_Part, i, &parts[i], sizeof(SinSynthPartSettings));
+    
+    GrainCloudSettings cloud;
+    if (inReader.ReadSection(kSinSynthState_GrainCloud, 1, cloud))
+        SetProperty(kAudioUnitCustomProperty_GrainCloud, kAudioUnitScope_Global, 0, &cloud, sizeof(GrainCloudSettings));
+    UInt32 voiceType;
+    if (inReader.ReadSection(kSinSynthState_VoiceType, 1, voiceType))
+        SetProperty(kAudioUnitCustomProperty_VoiceType, kAudioUnitScope_Global, 0, &voiceType, sizeof(UInt32));
+    ScanSequencerSettings sequencer;
+    if (inReader.ReadSection(kSinSynthState_Sequencer, 1, sequencer))
+        SetProperty(kAudioUnitCustomProperty_ScanSequencer, kAudioUnitScope_Global, 0, &sequencer, sizeof(ScanSequencerSettings));
+    UInt32 tableSize;
+    if (inReader.ReadSection(kSinSynthState_TableSize, 1, tableSize))
+        SetProperty(kAudioUnitCustomProperty_ScanTableSize, kAudioUnitScope_Global, 0, &tableSize, sizeof(UInt32));
+    
+    // the scan waits in the state until Initialize() asks for it
+    if (IsInitialized())
+        SeedScanFromState();
+}
+
+// hands the restored state's scan to the hub, to play until the device's first one, if the hub has
+// none yet; it is read out of the state only then, so a host that restores and never initializes, or
+// whose device is already streaming, never copies it
+void SinSynth::SeedScanFromState()
+{
+    if (mDeviceHub->IsOffline())
+        return;
+    UInt32 version, size;
+    const void *scan = RestoredBinaryState().Section(kSinSynthState_Scan, version, size);
+    if (scan == NULL || version != 2 || mDeviceHub->HasTable())
+        return;
+    LidarScanTable table;
+    if (table.Unflatten(scan, size))
+        mDeviceHub->SeedTable(table);
+}
+
+OSStatus SinSynth::GetPropertyInfo(AudioUnitPropertyID	inID,
+                                   AudioUnitScope		inScope,
+                                   AudioUnitElement		inElement,
+                                   UInt32 &				outDataSize,
+                                   Boolean &			outWritable)
+{
+    if (inScope == kAudioUnitScope_Global) {
+        if (inID == kAudioUnitCustomProperty_LidarDeviceState) {
+            outDataSize = sizeof(UInt32);
+            outWritable = false;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_Polyphony || inID == kAudioUnitCustomProperty_RenderWorkers
+            || inID == kAudioUnitCustomProperty_EventSliceFrames || inID == kAudioUnitCustomProperty_OscillatorEngine
+            || inID == kAudioUnitCustomProperty_ScanHistoryDepth || inID == kAudioUnitCustomProperty_ScanTransitionFrames
+            || inID == kAudioUnitCustomProperty_Oversampling || inID == kAudioUnitCustomProperty_RenderBlockFrames
+            || inID == kAudioUnitCustomProperty_VelocityCurve || inID == kAudioUnitCustomProperty_VoiceType
+            || inID == kAudioUnitCustomProperty_ScanTableSize || inID == kAudioUnitProperty_OfflineRender) {
+            outDataSize = sizeof(UInt32);
+            outWritable = true;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanZones) {
+            outDataSize = sizeof(ScanZoneMap);
+            outWritable = true;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_IngestStatistics) {
+            outDataSize = sizeof(LidarIngestStatistics);
+            outWritable = true;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_DeviceSettings) {
+            outDataSize = sizeof(LidarDeviceSettings);
+            outWritable = true;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_GrainCloud) {
+            outDataSize = sizeof(GrainCloudSettings);
+            outWritable = true;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanSequencer) {
+            outDataSize = sizeof(ScanSequencerSettings);
+            outWritable = true;
+            return noErr;
+        }
+    }
+    if (inScope == kAudioUnitScope_Part && inID == kAudioUnitCustomProperty_PartPolyphony) {
+        if (inElement >= kNumParts) return kAudioUnitErr_InvalidElement;
+        outDataSize = sizeof(UInt32);
+        outWritable = true;
+        return noErr;
+    }
+    if (inScope == kAudioUnitScope_Part && inID == kAudioUnitCustomProperty_PartSettings) {
+        if (inElement >= kNumParts) return kAudioUnitErr_InvalidElement;
+        outDataSize = sizeof(SinSynthPartSettings);
+        outWritable = true;
+        return noErr;
+    }
+    return AUMultitimbralInstrumentBase::GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
+}
+
+OSStatus SinSynth::GetProperty(AudioUnitPropertyID	inID,
+                               AudioUnitScope		inScope,
+                               AudioUnitElement		inElement,
+                               void *				outData)
+{
+    if (inScope == kAudioUnitScope_Global) {
+        if (inID == kAudioUnitCustomProperty_LidarDeviceState) {
+            *(UInt32 *)outData = mDeviceHub->State();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanTableSize) {
+            *(UInt32 *)outData = mTableSize ? mTableSize : 1U << mDeviceHub->TableBits();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_Polyphony) {
+            *(UInt32 *)outData = mPolyphony;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_RenderWorkers) {
+            *(UInt32 *)outData = mNumRenderWorkers;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_EventSliceFrames) {
+            *(UInt32 *)outData = EventSliceFrames();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanZones) {
+            *(ScanZoneMap *)outData = mZoneMap;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_OscillatorEngine) {
+            *(UInt32 *)outData = mEngine;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanHistoryDepth) {
+            *(UInt32 *)outData = mHistoryDepth;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanTransitionFrames) {
+            *(UInt32 *)outData = mTransitionFrames;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_Oversampling) {
+            *(UInt32 *)outData = mOversampling;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_RenderBlockFrames) {
+            *(UInt32 *)outData = RenderBlockFrames();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_VelocityCurve) {
+            *(UInt32 *)outData = mNoteTables.Curve();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_VoiceType) {
+            *(UInt32 *)outData = mVoiceType;
+            return noErr;
+        }
+        if (inID == kAudioUnitProperty_OfflineRender) {
+            *(UInt32 *)outData = mOfflineRender;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_IngestStatistics) {
+            mDeviceHub->GetIngestStatistics(*(LidarIngestStatistics *)outData);
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_DeviceSettings) {
+            mDeviceHub->GetDeviceSettings(*(LidarDeviceSettings *)outData);
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_GrainCloud) {
+            CAMutex::Locker lock(mGrainCloudWriter);
+            *(GrainCloudSettings *)outData = mGrainCloud.Pending();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanSequencer) {
+            mSequencer.GetSettings(*(ScanSequencerSettings *)outData);
+            return noErr;
+        }
+    }
+    if (inScope == kAudioUnitScope_Part && inID == kAudioUnitCustomProperty_PartPolyphony) {
+        if (inElement >= kNumParts) return kAudioUnitErr_InvalidElement;
+        *(UInt32 *)outData = mPartPolyphony[inElement];
+        return noErr;
+    }
+    if (inScope == kAudioUnitScope_Part && inID == kAudioUnitCustomProperty_PartSettings) {
+        if (inElement >= kNumParts) return kAudioUnitErr_InvalidElement;
+        AUElement *part = Parts().GetElement(inElement);
+        SinSynthPartSettings &settings = *(SinSynthPartSettings *)outData;
+        settings.mZone = part->GetParameter(kPartZoneParam);
+        settings.mAttack = part->GetParameter(kPartAttackParam);
+        settings.mRelease = part->GetParameter(kPartReleaseParam);
+        return noErr;
+    }
+    return AUMultitimbralInstrumentBase::GetProperty(inID, inScope, inElement, outData);
+}
+
+OSStatus SinSynth::SetProperty(AudioUnitPropertyID	inID,
+                               AudioUnitScope		inScope,
+                               AudioUnitElement		inElement,
+                               const void *			inData,
+                               UInt32				inDataSize)
+{
+    if (inScope == kAudioUnitScope_Global) {
+        if (inID == kAudioUnitCustomProperty_Polyphony) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 polyphony = *(const UInt32 *)inData;
+            if (polyphony < 1 || polyphony > kMaxPolyphony) return kAudioUnitErr_InvalidPropertyValue;
+            mPolyphony = polyphony;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_RenderWorkers) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 numWorkers = *(const UInt32 *)inData;
+            if (numWorkers > kMaxRenderWorkers) return kAudioUnitErr_InvalidPropertyValue;
+            mNumRenderWorkers = numWorkers;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_EventSliceFrames) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 sliceFrames = *(const UInt32 *)inData;
+            if (sliceFrames > kMaxEventSliceFrames) return kAudioUnitErr_InvalidPropertyValue;
+            SetEventSliceFrames(sliceFrames);
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanZones) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(ScanZoneMap)) return kAudioUnitErr_InvalidPropertyValue;
+            const ScanZoneMap &zones = *(const ScanZoneMap *)inData;
+            if (!zones.IsValid()) return kAudioUnitErr_InvalidPropertyValue;
+            mZoneMap = zones;
+            mDeviceHub->SetSubscriberZones(&mScanSnapshot, mZoneMap);
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_OscillatorEngine) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 engine = *(const UInt32 *)inData;
+            if (engine != kOscillatorEngine_Waveform && engine != kOscillatorEngine_Spectral) return kAudioUnitErr_InvalidPropertyValue;
+            mEngine = engine;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanHistoryDepth) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 depth = *(const UInt32 *)inData;
+            if (depth < 1 || depth > kMaxScanHistoryDepth) return kAudioUnitErr_InvalidPropertyValue;
+            mHistoryDepth = depth;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanTableSize) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 size = *(const UInt32 *)inData;
+            if (ScanTableBitsForSize(size) == 0) return kAudioUnitErr_InvalidPropertyValue;
+            mTableSize = size;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanTransitionFrames) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 frames = *(const UInt32 *)inData;
+            if (frames > kMaxScanTransitionFrames) return kAudioUnitErr_InvalidPropertyValue;
+            mTransitionFrames = frames;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_Oversampling) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 factor = *(const UInt32 *)inData;
+            if (factor != 1 && factor != 2 && factor != kMaxOversampling) return kAudioUnitErr_InvalidPropertyValue;
+            mOversampling = factor;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_RenderBlockFrames) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 blockFrames = *(const UInt32 *)inData;
+            if (blockFrames != 0 && (blockFrames < kMinRenderBlockFrames || blockFrames > kMaxRenderBlockFrames
+                                     || (blockFrames & (blockFrames - 1)) != 0))
+                return kAudioUnitErr_InvalidPropertyValue;
+            SetRenderBlockFrames(blockFrames);
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_VelocityCurve) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 curve = *(const UInt32 *)inData;
+            if (curve >= kNumVelocityCurves) return kAudioUnitErr_InvalidPropertyValue;
+            mNoteTables.SetVelocityCurve(VelocityCurve(curve));
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_VoiceType) {
+            if (IsInitialized()) return kAudioUnitErr_Initialized;
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            UInt32 voiceType = *(const UInt32 *)inData;
+            if (voiceType >= kNumVoiceTypes) return kAudioUnitErr_InvalidPropertyValue;
+            mVoiceType = voiceType;
+            return noErr;
+        }
+        if (inID == kAudioUnitProperty_OfflineRender) {
+            // hosts set this while initialized too; the scan source follows at the next Initialize()
+            if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+            mOfflineRender = *(const UInt32 *)inData;
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_IngestStatistics) {
+            mDeviceHub->ResetIngestStatistics();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_DeviceSettings) {
+            if (inDataSize < sizeof(LidarDeviceSettings)) return kAudioUnitErr_InvalidPropertyValue;
+            const LidarDeviceSettings &settings = *(const LidarDeviceSettings *)inData;
+            if (!settings.IsValid()) return kAudioUnitErr_InvalidPropertyValue;
+            mDeviceHub->SetDeviceSettings(settings);
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_GrainCloud) {
+            if (inDataSize < sizeof(GrainCloudSettings)) return kAudioUnitErr_InvalidPropertyValue;
+            const GrainCloudSettings &cloud = *(const GrainCloudSettings *)inData;
+            if (!cloud.IsValid()) return kAudioUnitErr_InvalidPropertyValue;
+            CAMutex::Locker lock(mGrainCloudWriter);
+            mGrainCloud.Pending() = cloud;
+            mGrainCloud.Publish();
+            return noErr;
+        }
+        if (inID == kAudioUnitCustomProperty_ScanSequencer) {
+            if (inDataSize < sizeof(ScanSequencerSettings)) return kAudioUnitErr_InvalidPropertyValue;
+            const ScanSequencerSettings &settings = *(const ScanSequencerSettings *)inData;
+            if (!settings.IsValid()) return kAudioUnitErr_InvalidPropertyValue;
+            mSequencer.SetSettings(settings);
+            return noErr;
+        }
+    }
+    if (inScope == kAudioUnitScope_Part && inID == kAudioUnitCustomProperty_PartPolyphony) {
+        if (inElement >= kNumParts) return kAudioUnitErr_InvalidElement;
+        if (IsInitialized()) return kAudioUnitErr_Initialized;
+        if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+        UInt32 polyphony = *(const UInt32 *)inData;
+        if (polyphony > kMaxPolyphony) return kAudioUnitErr_InvalidPropertyValue;
+        mPartPolyphony[inElement] = polyphony;
+        return noErr;
+    }
+    if (inScope == kAudioUnitScope_Part && inID == kAudioUnitCustomProperty_PartSettings) {
+        if (inElement >= kNumParts) return kAudioUnitErr_InvalidElement;
+        if (inDataSize < sizeof(SinSynthPartSettings)) return kAudioUnitErr_InvalidPropertyValue;
+        const SinSynthPartSettings &settings = *(const SinSynthPartSettings *)inData;
+        if (!(settings.mZone >= 0.f && settings.mZone <= 1 + kMaxScanZones)
+            || !(settings.mAttack >= 0.f && settings.mAttack <= 5.f)
+            || !(settings.mRelease >= 0.f && settings.mRelease <= 5.f))
+            return kAudioUnitErr_InvalidPropertyValue;
+        CAMutex::Locker lock(mPartSettingsWriter);
+        PartSettingsBlock &block = mPartSettings.Pending();
+        block.mParts[inElement] = settings;
+        block.mVersions[inElement] = mPartSettings.NextVersion();
+        mPartSettings.Publish();
+        return noErr;
+    }
+    return AUMultitimbralInstrumentBase::SetProperty(inID, inScope, inElement, inData, inDataSize);
+}
+
 OSStatus SinSynth::GetParameterInfo(AudioUnitScope inScope,
                                     AudioUnitParameterID inParameterID,
                                     AudioUnitParameterInfo &outParameterInfo)
 {
+    if (inScope == kAudioUnitScope_Part) {
+        switch (inParameterID) {
+            case kPartZoneParam:
+                AUBase::FillInParameterName (outParameterInfo, kPartZoneName, false);
+                outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // 0 plays each key's zone of kAudioUnitCustomProperty_ScanZones, 1 the whole scan, 2 the
+                // first zone, 3 the second and so on; past the last zone there is, the last
+                outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+                outParameterInfo.minValue = 0;
+                outParameterInfo.maxValue = 1 + kMaxScanZones;
+                outParameterInfo.defaultValue = 0;
+                break;
+                
+            case kPartAttackParam:
+            case kPartReleaseParam:
+                AUBase::FillInParameterName (outParameterInfo, inParameterID == kPartAttackParam ? kPartAttackName : kPartReleaseName, false);
+                outParameterInfo.flags = SetAudioUnitParameterDisplayType (0, kAudioUnitParameterFlag_DisplaySquareRoot);
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // 0 follows the global VCA time
+                outParameterInfo.unit = kAudioUnitParameterUnit_Seconds;
+                outParameterInfo.minValue = 0.0;
+                outParameterInfo.maxValue = 5.0;
+                outParameterInfo.defaultValue = 0.0;
+                break;
+                
+            default:
+                return kAudioUnitErr_InvalidParameter;
+        }
+        return noErr;
+    }
     if (inScope != kAudioUnitScope_Global) {
         return kAudioUnitErr_InvalidScope;
     } else {
@@ -193,6 +1226,67 @@ OSStatus SinSynth::GetParameterInfo(AudioUnitScope inScope,
                 outParameterInfo.defaultValue = 0.001;
                 break;
                 
+            case kGlobalScanTimeParam:
+                AUBase::FillInParameterName (outParameterInfo, kGlobalScanTimeName, false);
+                outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // 0 is the newest scan, 1 the oldest in the kAudioUnitCustomProperty_ScanHistoryDepth history
+                outParameterInfo.unit = kAudioUnitParameterUnit_Generic;
+                outParameterInfo.minValue = 0.0;
+                outParameterInfo.maxValue = 1.0;
+                outParameterInfo.defaultValue = 0.0;
+                break;
+                
+            case kGlobalFreezeParam:
+                AUBase::FillInParameterName (outParameterInfo, kGlobalFreezeName, false);
+                outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // on, each note keeps the scan it started with for as long as it sounds
+                outParameterInfo.unit = kAudioUnitParameterUnit_Boolean;
+                outParameterInfo.minValue = 0.0;
+                outParameterInfo.maxValue = 1.0;
+                outParameterInfo.defaultValue = 0.0;
+                break;
+                
+            case kGlobalWindowSourceParam:
+                AUBase::FillInParameterName (outParameterInfo, kGlobalWindowSourceName, false);
+                outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // a WindowSource, read as each note starts
+                outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+                outParameterInfo.minValue = 0;
+                outParameterInfo.maxValue = kNumWindowSources - 1;
+                outParameterInfo.defaultValue = kWindowSource_None;
+                break;
+                
+            case kGlobalWindowLengthParam:
+                AUBase::FillInParameterName (outParameterInfo, kGlobalWindowLengthName, false);
+                outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // octaves shorter than the whole table, read as each note starts: 1 is half of it. A
+                // window stops at 1 << kWavetableMinWindowBits entries, however small the table.
+                outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+                outParameterInfo.minValue = 0;
+                outParameterInfo.maxValue = kWavetableMaxWindowOctaves;
+                outParameterInfo.defaultValue = 0;
+                break;
+                
+            case kGlobalAudibilityFloorParam:
+                AUBase::FillInParameterName (outParameterInfo, kGlobalAudibilityFloorName, false);
+                outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable;
+                outParameterInfo.flags += kAudioUnitParameterFlag_IsReadable;
+                
+                // relative to full scale; a releasing note ends once it is below it
+                outParameterInfo.unit = kAudioUnitParameterUnit_Decibels;
+                outParameterInfo.minValue = -120.0;
+                outParameterInfo.maxValue = -60.0;
+                outParameterInfo.defaultValue = -90.0;
+                break;
+                
             default:
                 return kAudioUnitErr_InvalidParameter;
         }
@@ -205,6 +1299,67 @@ OSStatus SinSynth::GetParameterInfo(AudioUnitScope inScope,
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
+bool TestNote::Attack(const MusicDeviceNoteParams &inParams)
+{
+#if DEBUG_PRINT
+    printf("TestNote::Attack %p %d\n", this, GetState());
+#endif
+    SinSynth *synth = static_cast<SinSynth*>(GetAudioUnit());
+    // a stolen note may still hold the scan it was frozen to
+    Unfreeze();
+    // the note's zone, its key's or its part's, is fixed for its lifetime, so it keeps reading one
+    // table, and so is its window of it; oversampled or windowed, a brighter level of it stays under
+    // the voices' Nyquist
+    const NoteTables &tables = synth->Tables();
+    UInt32 tableLevel = NoteTables::Covers(GetPitch(), GetPitchBend()) ? tables.TableLevel(GetMidiKey())
+                      : ScanTableLevelForFrequency(Frequency(), tables.SampleRate());
+    // a string takes its table once, here, so it needs no pin and has no window
+    if (synth->IsPlucked()) {
+        synth->PluckBank().Start(slot, synth->ScanZones(), synth->TableForNote(GetPart(), GetMidiKey()), tableLevel,
+                                 Frequency(), tables.Peak(UInt32(inParams.mVelocity)));
+        return true;
+    }
+    // a frozen note pins the cycle's snapshot; the ingest thread reuses it once the last pin is gone
+    const LidarScanZones *snapshot = NULL;
+    if (synth->GlobalParameters()[kGlobalFreezeParam] >= 0.5f) {
+        pin = synth->ScanSnapshot().Retain();
+        frozen = true;
+        snapshot = &synth->ScanSnapshot().Buffer(pin);
+    }
+    const WavetableWindow window = synth->WindowForNote(inParams, GetMidiKey());
+    synth->VoiceBank().Start(slot, synth->TableForNote(GetPart(), GetMidiKey()), tableLevel,
+                             tables.Peak(UInt32(inParams.mVelocity)), snapshot, window);
+    return true;
+}
+
+void TestNote::Unfreeze()
+{
+    if (!frozen) return;
+    SinSynth *synth = static_cast<SinSynth*>(GetAudioUnit());
+    synth->VoiceBank().Unfreeze(slot);
+    synth->ScanSnapshot().Release(pin);
+    frozen = false;
+}
+
+// may be called on a render worker; dropping a pin only marks the snapshot for the ingest thread
+void TestNote::NoteEnded(UInt32 inFrame)
+{
+    Unfreeze();
+    SynthNote::NoteEnded(inFrame);
+}
+
+UInt32 TestNote::MonoBus() const
+{
+    SinSynth *synth = static_cast<SinSynth*>(GetAudioUnit());
+    return synth->IsPlucked() ? synth->PluckBank().Table(slot) : synth->VoiceBank().Table(slot);
+}
+
+Float32 TestNote::Amplitude()
+{
+    SinSynth *synth = static_cast<SinSynth*>(GetAudioUnit());
+    return synth->IsPlucked() ? synth->PluckBank().Level(slot) : synth->VoiceBank().Level(slot);
+}
+
 void TestNote::Release(UInt32 inFrame)
 {
     SynthNote::Release(inFrame);
@@ -232,14 +1387,6 @@ void TestNote::Kill(UInt32 inFrame) // voice is being stolen.
 OSStatus TestNote::Render(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, AudioBufferList** inBufferList, UInt32 inOutBusCount)
 {
     float *left, *right;
-    /* ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~
-     Changes to this parameter (kGlobalVolumeParam) are not being de-zippered;
-     Left as an exercise for the reader
-     ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ ~ */
-    float globalVol = GetGlobalParameter(kGlobalVolumeParam);
-    float globalAmpAttack = GetGlobalParameter(kGlobalAmpAttackParam);
-    float globalAmpRelease = GetGlobalParameter(kGlobalAmpReleaseParam);
-    
     // TestNote only writes into the first bus regardless of what is handed to us.
     const int bus0 = 0;
     int numChans = inBufferList[bus0]->mNumberBuffers;
@@ -248,105 +1395,136 @@ OSStatus TestNote::Render(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Audi
     left = (float*)inBufferList[bus0]->mBuffers[0].mData;
     right = numChans == 2 ? (float*)inBufferList[bus0]->mBuffers[1].mData : 0;
     
-    double sampleRate = SampleRate();
-    double freq = Frequency() * (twopi/sampleRate);
-    
-    
-#if DEBUG_PRINT_RENDER
-    printf("TestNote::Render %p %d %g %g\n", this, GetState(), phase, amp);
-#endif
+    return RenderFrames(inNumFrames, left, right);
+}
+
+// every channel carries the same signal, so the group mixes one mono block into all of them
+OSStatus TestNote::RenderMono(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono)
+{
+    return RenderFrames(inNumFrames, ioMono, NULL);
+}
+
+// the envelope's direction and slope are fixed for the whole render call, so stepping the attack
+// and release times does not click. A note on a plain key at the tables' rate costs a few loads;
+// the bend is left to the channel's modulation.
+template <class Bank>
+bool TestNote::PrepareBlock(Bank &ioBank, const NoteTables &inTables,
+                            const PartEnvelope &inEnvelope, double inSampleRate)
+{
+    const bool tabled = inSampleRate == inTables.SampleRate();
+    UInt32 increment = tabled && NoteTables::Covers(GetPitch(), 0.f) ? inTables.Increment(GetMidiKey())
+                     : WavetablePhaseIncrement(TuningA() * pow(2., (GetPitch() - 69.) / 12.) / inSampleRate);
+    // the tables' steps are per frame at their own rate
+    const Float32 peak = tabled ? ioBank.Peak(slot) : ioBank.Peak(slot) * Float32(inTables.SampleRate() / inSampleRate);
     switch (GetState())
     {
         case kNoteState_Attacked :
         case kNoteState_Sostenutoed :
         case kNoteState_ReleasedButSostenutoed :
         case kNoteState_ReleasedButSustained :
-        {
-            for (UInt32 frame=0; frame<inNumFrames; ++frame)
-            {
-                // if (amp < maxamp) amp += up_slope;
-                if (amp < maxamp) amp += maxamp / (sampleRate * globalAmpAttack);
-                if (amp > maxamp) amp = maxamp;
-                // float out = pow5(sin(phase)) * amp * globalVol;  // original
-                int idx = int(phase/twopi*buf_size);
-                float val;
-                try {
-                    val = (c_buf[idx] < 1000) ? c_buf[idx] : 1000;
-                } catch (...) {
-                    val = 0.;
-                }
-                float out = (val - moving_average) / moving_average * amp * globalVol;
-                phase += freq;
-                if (phase > twopi) phase -= twopi;
-                left[frame] += out;
-                if (right) right[frame] += out;
-            }
-        }
-            break;
+            ioBank.SetBlock(slot, increment, kVoiceEnvelope_Rising, peak * inEnvelope.mAttackStep);
+            return true;
             
         case kNoteState_Released :
-        {
-            UInt32 endFrame = 0xFFFFFFFF;
-            for (UInt32 frame=0; frame<inNumFrames; ++frame)
-            {
-                // if (amp > 0.0) amp += dn_slope;
-                if (amp > 0.0) amp -= maxamp / (sampleRate * globalAmpRelease);
-                else if (endFrame == 0xFFFFFFFF) endFrame = frame;
-                // float out = pow5(sin(phase)) * amp * globalVol;  // original
-                int idx = int(phase/twopi*buf_size);
-                float val;
-                try {
-                    val = (c_buf[idx] < 1000) ? c_buf[idx] : 1000;
-                } catch (...) {
-                    val = 0.;
-                }
-                float out = (val - moving_average) / moving_average * amp * globalVol;
-                // float out = (c_buf[idx] - moving_average) / moving_average * amp * globalVol;
-                phase += freq;
-                left[frame] += out;
-                if (right) right[frame] += out;
-            }
-            if (endFrame != 0xFFFFFFFF) {
-#if DEBUG_PRINT
-                printf("TestNote::NoteEnded  %p %d %g %g\n", this, GetState(), phase, amp);
-#endif
-                NoteEnded(endFrame);
-            }
-        }
-            break;
-            
         case kNoteState_FastReleased :
-        {
-            UInt32 endFrame = 0xFFFFFFFF;
-            for (UInt32 frame=0; frame<inNumFrames; ++frame)
-            {
-                if (amp > 0.0) amp += fast_dn_slope;
-                else if (endFrame == 0xFFFFFFFF) endFrame = frame;
-                // float out = pow5(sin(phase)) * amp * globalVol;  // original
-                int idx = int(phase/twopi*buf_size);
-                float val;
-                try {
-                    val = (c_buf[idx] < 1000) ? c_buf[idx] : 1000;
-                } catch (...) {
-                    val = 0.;
-                }
-                float out = (val - moving_average) / moving_average * amp * globalVol;
-                //float out = (c_buf[idx] - moving_average) / moving_average * amp * globalVol;
-                phase += freq;
-                left[frame] += out;
-                if (right) right[frame] += out;
-            }
-            if (endFrame != 0xFFFFFFFF) {
+            ioBank.SetBlock(slot, increment, kVoiceEnvelope_Falling,
+                            peak * (GetState() == kNoteState_Released ? inEnvelope.mReleaseStep : inTables.FastReleaseStep()));
+            return true;
+            
+        default :
+            return false;
+    }
+}
+
+// a string's line was sized for the voices' rate, so outside the mono buses, which run at it, an
+// oversampled string plays that many times sharp
+OSStatus TestNote::RenderFrames(UInt32 inNumFrames, float *left, float *right)
+{
+    SinSynth *synth = static_cast<SinSynth*>(GetAudioUnit());
+    UInt32 endFrame;
+    const ControlRateModulation &modulation = synth->Modulation(GetGroup());
+    if (synth->IsPlucked()) {
+        PluckVoiceBank &bank = synth->PluckBank();
+        if (!PrepareBlock(bank, synth->Tables(), synth->Envelope(GetPart()), SampleRate()))
+            return noErr;
+        if (right)
+            bank.Render<true>(synth->Volume(), modulation, synth->SliceOffset(), &slot, 1, &endFrame, left, right, inNumFrames);
+        else
+            bank.Render<false>(synth->Volume(), modulation, synth->SliceOffset(), &slot, 1, &endFrame, left, NULL, inNumFrames);
+    } else {
+        WavetableVoiceBank &bank = synth->VoiceBank();
+        if (!PrepareBlock(bank, synth->Tables(), synth->Envelope(GetPart()), SampleRate()))
+            return noErr;
+        
+#if DEBUG_PRINT_RENDER
+        printf("TestNote::Render %p %d %g\n", this, GetState(), bank.Level(slot));
+#endif
+        if (right)
+            bank.Render<true>(synth->ScanZones(), synth->Volume(), modulation, synth->SliceOffset(), &slot, 1, &endFrame,
+                              left, right, inNumFrames);
+        else
+            bank.Render<false>(synth->ScanZones(), synth->Volume(), modulation, synth->SliceOffset(), &slot, 1, &endFrame,
+                               left, NULL, inNumFrames);
+    }
+    
+    // a releasing note ends on the first frame that starts below the audibility floor, a string also
+    // once it has decayed away
+    if (endFrame < inNumFrames) {
 #if DEBUG_PRINT
-                printf("TestNote::NoteEnded  %p %d %g %g\n", this, GetState(), phase, amp);
+        printf("TestNote::NoteEnded  %p %d %g\n", this, GetState(), Amplitude());
 #endif
-                NoteEnded(endFrame);
+        NoteEnded(endFrame);
+    }
+    return noErr;
+}
+
+// the group's mono notes are all TestNotes; render them kWavetableVoiceBatch slots at a time, at the
+// oversampled rate when there is one. While load shedding has the voices at a lower rate, each of
+// their frames is held across the bus's frames at the oversampled rate, so that the decimators keep
+// running and the latency does not jump.
+OSStatus TestNote::RenderMonoNotes(SynthNote *const *inNotes, UInt32 inNumNotes, UInt32 inStep,
+                                   UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono)
+{
+    SinSynth *synth = static_cast<SinSynth*>(GetAudioUnit());
+    WavetableVoiceBank &bank = synth->VoiceBank();
+    PluckVoiceBank &pluckBank = synth->PluckBank();
+    const bool plucked = synth->IsPlucked();
+    const NoteTables &tables = synth->Tables();
+    const UInt32 oversampling = synth->VoiceOversampling();
+    const UInt32 hold = synth->MonoOversampling() / oversampling;
+    const double sampleRate = SampleRate() * oversampling;
+    const SmoothedParameter volume = synth->Volume().Oversampled(oversampling);
+    const ControlRateModulation &modulation = synth->Modulation(GetGroup());
+    const UInt32 numFrames = inNumFrames / hold;
+    
+    TestNote *notes[kWavetableVoiceBatch];
+    UInt32 slots[kWavetableVoiceBatch], endFrames[kWavetableVoiceBatch];
+    for (UInt32 first = 0; first < inNumNotes; first += kWavetableVoiceBatch) {
+        UInt32 last = std::min(first + kWavetableVoiceBatch, inNumNotes);
+        UInt32 count = 0;
+        for (UInt32 i = first; i < last; ++i) {
+            TestNote *note = static_cast<TestNote*>(inNotes[i * inStep]);
+            const PartEnvelope &envelope = synth->Envelope(note->GetPart());
+            if (plucked ? note->PrepareBlock(pluckBank, tables, envelope, sampleRate)
+                        : note->PrepareBlock(bank, tables, envelope, sampleRate)) {
+                notes[count] = note;
+                slots[count++] = note->slot;
             }
         }
-            break;
-        default :
-            break;
+        if (plucked)
+            pluckBank.Render<false>(volume, modulation, synth->SliceOffset(), slots, count, endFrames,
+                                    ioMono, NULL, numFrames, oversampling);
+        else
+            bank.Render<false>(synth->ScanZones(), volume, modulation, synth->SliceOffset(), slots, count, endFrames,
+                               ioMono, NULL, numFrames, oversampling);
+        for (UInt32 k = 0; k < count; ++k)
+            if (endFrames[k] < numFrames)
+                notes[k]->NoteEnded(endFrames[k] / oversampling);
     }
+    // the bus was zeroed for this call, so the voices' frames spread out in place from the end
+    if (hold > 1)
+        for (UInt32 frame = numFrames; frame-- > 0; )
+            for (UInt32 i = 0; i < hold; ++i)
+                ioMono[frame * hold + hold - 1 - i] = ioMono[frame];
     return noErr;
 }
-
@@ -8,38 +8,225 @@
 
 #include "AUInstrumentBase.h"
 #include "SinSynthVersion.h"
+#include "LidarDeviceHub.h"
+#include "SynthStats.h"
+#include "WavetableVoiceBank.h"
+#include "PluckVoiceBank.h"
+#include "NoteTables.h"
+#include "ControlRateModulation.h"
+#include "VoicePool.h"
+#include "SpatialPanner.h"
+#include "HalfBandDecimator.h"
+#include "GrainScheduler.h"
+#include "ScanSequencer.h"
+#include "AUDeferredResources.h"
+#include "CAAudioChannelLayout.h"
 
-static const UInt32 kNumNotes = 12;
+static const UInt32 kDefaultPolyphony = 8;
+static const UInt32 kMaxPolyphony = 1024;
+static const UInt32 kMaxRenderWorkers = 7;
+static const UInt32 kDefaultEventSliceFrames = 32;
+static const UInt32 kMaxEventSliceFrames = 4096;
+static const UInt32 kMaxScanTransitionFrames = 192000;
+static const Float64 kCachedScanHandoverSeconds = 0.5;	// least fade from the last session's scan to live data
+static const UInt32 kMinRenderBlockFrames = 8;
+static const UInt32 kMaxRenderBlockFrames = 1024;
+static const UInt32 kNumParts = 16;	// one for each MIDI channel
 
-struct TestNote : public SynthNote
+// a part's zone, attack and release parameters, as kAudioUnitCustomProperty_PartSettings sets them
+struct SinSynthPartSettings
 {
+    Float32		mZone;
+    Float32		mAttack;	// seconds, 0 to follow the global VCA attack
+    Float32		mRelease;	// seconds, 0 to follow the global VCA release
+};
+
+// custom properties id's must be 64000 or greater
+// see <AudioUnit/AudioUnitProperties.h> for a list of Apple-defined standard properties
+enum
+{
+    // read-only, global scope: UInt32 holding the LidarDeviceState of the shared LiDAR device.
+    // Until the state reaches kLidarState_Streaming the synth plays a fallback sine table, or the
+    // last session's scan; while it is kLidarState_Reconnecting it plays the last scan it was sent.
+    kAudioUnitCustomProperty_LidarDeviceState = 65536,
+    
+    // read/write, global scope: UInt32 number of notes that may sound at once, 1 to kMaxPolyphony.
+    // Can only be set while the AU is uninitialized; the voices are allocated by Initialize().
+    kAudioUnitCustomProperty_Polyphony = 65537,
+    
+    // read/write, global scope: UInt32 number of worker threads, 0 to kMaxRenderWorkers, that share
+    // the voices with the render thread once enough are sounding. 0 (the default) keeps rendering on
+    // the render thread alone. Can only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_RenderWorkers = 65538,
+    
+    // read/write, global scope: UInt32 shortest slice, 0 to kMaxEventSliceFrames, that a render call
+    // is split into so that MIDI events start at their own frame rather than at the start of the
+    // buffer. 0 performs every event at the start of the buffer. Can only be set while the AU is
+    // uninitialized.
+    kAudioUnitCustomProperty_EventSliceFrames = 65539,
+    
+    // read/write, global scope: ScanZoneMap splitting the scan into up to kMaxScanZones sectors, each
+    // played by its own range of notes from a table of its own. The hub builds the zones' tables from
+    // the next scan on. Can only be set while the AU is uninitialized. Without zones of its own the
+    // instance plays those of the hub's LIDARSYNTH_CONFIG file, which can change while it plays; the
+    // buses and history of those zones are sized for the file's zones when the AU is initialized.
+    kAudioUnitCustomProperty_ScanZones = 65543,
+    
+    // read/write, global scope: UInt32 OscillatorEngine, kOscillatorEngine_Waveform (the default) to
+    // play the scan as a waveform or kOscillatorEngine_Spectral to play it as a spectral envelope.
+    // Can only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_OscillatorEngine = 65544,
+    
+    // read/write, global scope: UInt32 number of recent scans, 1 to kMaxScanHistoryDepth, that the
+    // scan time parameter scrubs through (kDefaultScanHistoryDepth by default). Can only be set while
+    // the AU is uninitialized; the history is allocated by Initialize().
+    kAudioUnitCustomProperty_ScanHistoryDepth = 65545,
+    
+    // read/write, global scope: UInt32 number of frames, 0 to kMaxScanTransitionFrames, over which the
+    // voices crossfade from each scan to the next. 0 (the default) switches tables at the start of
+    // the cycle the scan arrives in. A scan arriving during a crossfade waits for it to finish. Can
+    // only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_ScanTransitionFrames = 65546,
+    
+    // read/write, global scope: UInt32 factor, 1 (the default), 2 or 4, of the rate the voices are
+    // rendered at over the output's. The voice mix is decimated back to the output rate, so the
+    // scan's sharp edges alias far less without running the whole host faster. Can only be set while
+    // the AU is uninitialized.
+    kAudioUnitCustomProperty_Oversampling = 65547,
+    
+    // read/write, global scope: UInt32 frames, 0 or a power of two from kMinRenderBlockFrames to
+    // kMaxRenderBlockFrames, that the voices are always rendered in whatever the host asks for; a
+    // FIFO carries the rest of a block over to the next render call. Events land at the start of
+    // their block, up to a block late. 0 (the default) renders the host's buffers as they come,
+    // sliced for the events. Can only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_RenderBlockFrames = 65548,
+    
+    // read/write, global scope: UInt32 VelocityCurve that maps a note's velocity to its peak level,
+    // kVelocityCurve_Cubed by default. Can only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_VelocityCurve = 65549,
+    
+    // read/write, global scope: LidarIngestStatistics of the scans reaching the shared device hub,
+    // since it started or the statistics were last reset; setting it, with any value, resets them.
+    kAudioUnitCustomProperty_IngestStatistics = 65550,
+    
+    // read/write, global scope: LidarDeviceSettings of the shared device, its motor speed, sample
+    // rate and serial port; zero fields keep the device's own. Can be set at any time: the hub
+    // applies it between two scans, and it holds for every instance in the process.
+    kAudioUnitCustomProperty_DeviceSettings = 65551,
+    
+    // read/write, part scope: UInt32 number of notes, up to the instrument's polyphony, that the part
+    // may sound at once; 0 (the default) gives it the instrument's polyphony. Each part's voices are
+    // allocated by Initialize(), so this can only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_PartPolyphony = 65552,
+    
+    // read/write, part scope: SinSynthPartSettings, the part's zone, attack and release parameters
+    // together. Can be set at any time: the render thread takes all three in the same cycle, so a
+    // note never starts with the new zone and the old envelope. Getting it reads the parameters.
+    kAudioUnitCustomProperty_PartSettings = 65553,
+    
+    // read/write, global scope: UInt32 number of bins in each scan table, a power of two from 64 to
+    // 8192; set only while uninitialized. Initialize() hands it to the shared device hub, which
+    // reallocates its tables, so the last size set in the process is the one every instance plays.
+    // Until it is set, it reads the hub's, by default 1 << LIDARSYNTH_SCAN_TABLE_BITS. A daemon's or
+    // a remote host's tables of another size are binned again from their samples.
+    kAudioUnitCustomProperty_ScanTableSize = 65554,
+    
+    // read/write, global scope: GrainCloudSettings of the grain cloud, a stream of short windowed
+    // grains of a scan table mixed in over the notes; a density of 0 (the default) stops it. Can be
+    // set at any time: the render thread takes the whole struct at the top of a cycle.
+    kAudioUnitCustomProperty_GrainCloud = 65555,
+    
+    // read/write, global scope: UInt32 VoiceType, kVoiceType_Wavetable (the default) for notes that
+    // play the scan as a waveform or kVoiceType_Pluck for plucked strings seeded from it at each note
+    // on. Can only be set while the AU is uninitialized.
+    kAudioUnitCustomProperty_VoiceType = 65556,
+    
+    // read/write, global scope: ScanSequencerSettings of the sequencer that plays a note at each
+    // step of the beam's rotation, from the nearest return in the step's sector; 0 steps (the
+    // default) stops it. Can be set at any time: the next scan's steps are scheduled with it.
+    kAudioUnitCustomProperty_ScanSequencer = 65557
+};
+
+// what a note is, as kAudioUnitCustomProperty_VoiceType sets it
+enum VoiceType
+{
+    kVoiceType_Wavetable = 0,	// an oscillator reading the scan for as long as it sounds
+    kVoiceType_Pluck = 1,		// a Karplus-Strong string, excited by the scan at attack (PluckVoiceBank)
+    kNumVoiceTypes
+};
+
+// what places a note's table window (the window source parameter); the window length parameter
+// sets how many octaves shorter than the whole table it is
+enum WindowSource
+{
+    kWindowSource_None = 0,			// every note plays the whole table
+    kWindowSource_Velocity = 1,		// soft notes read the start of the table, loud ones its end
+    kWindowSource_Key = 2,			// low keys read the start, high keys the end
+    kWindowSource_NoteControl = 3,	// the note's kSinSynthNoteControl_WindowPosition control
+    kNumWindowSources
+};
+
+// the ID of a MusicDeviceNoteParams control, 0 to 1, that places the window of a note started with
+// MusicDeviceStartNote() under kWindowSource_NoteControl; a note without it reads from the start
+static const AudioUnitParameterID kSinSynthNoteControl_WindowPosition = 'wpos';
+
+/*
+ A TestNote only keeps its slot in the instrument's WavetableVoiceBank, or in its PluckVoiceBank
+ under kVoiceType_Pluck; the oscillator and envelope live there, so that RenderMonoNotes() renders a group's whole share of notes in one batch. The
+ voice state is all Float32 apart from the phase, a 32-bit fixed-point accumulator that never
+ drifts however long the note is held; doubles only appear in the per-block phase increment.
+ */
+struct TestNote final : public SynthNote
+{
+    TestNote() : slot(0), frozen(false), pin(0) {}
     virtual	~TestNote() {}
     
-    virtual bool Attack(const MusicDeviceNoteParams &inParams)
-    {
-#if DEBUG_PRINT
-        printf("TestNote::Attack %p %d\n", this, GetState());
-#endif
-        sampleRate = SampleRate();
-        phase = 0.;
-        amp = 0.;
-        maxamp = 0.4 * pow(inParams.mVelocity/127., 3.);
-        up_slope = maxamp / (0.1 * sampleRate);
-        dn_slope = -maxamp / (0.9 * sampleRate);
-        fast_dn_slope = -maxamp / (0.005 * sampleRate);
-        return true;
-    }
+    virtual bool			Attack(const MusicDeviceNoteParams &inParams);
     virtual void			Kill(UInt32 inFrame); // voice is being stolen.
     virtual void			Release(UInt32 inFrame);
     virtual void			FastRelease(UInt32 inFrame);
-    virtual Float32			Amplitude() { return amp; } // used for finding quietest note for voice stealing.
+    virtual Float32			Amplitude(); // used for finding quietest note for voice stealing.
     virtual OSStatus		Render(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, AudioBufferList** inBufferList, UInt32 inOutBusCount);
+    virtual bool			CanRenderMono() const { return true; }
+    virtual UInt32			MonoBus() const;	// the note's LidarScanZones table
+    virtual OSStatus		RenderMono(UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono);
+    virtual OSStatus		RenderMonoNotes(SynthNote *const *inNotes, UInt32 inNumNotes, UInt32 inStep,
+                                            UInt64 inAbsoluteSampleFrame, UInt32 inNumFrames, Float32 *ioMono);
+    OSStatus				RenderFrames(UInt32 inNumFrames, float *left, float *right);	// right may be NULL
+    
+    virtual void			NoteEnded(UInt32 inFrame);
     
-    double sampleRate, phase, amp, maxamp;
-    double up_slope, dn_slope, fast_dn_slope;
+    // sets up the note's slot for this render call, with its part's envelope and its pitch before any
+    // bend, which the channel's ControlRateModulation applies; false if the note is not sounding
+    template <class Bank>
+    bool					PrepareBlock(Bank &ioBank, const NoteTables &inTables,
+                                         const PartEnvelope &inEnvelope, double inSampleRate);
+    
+    // drops the note's pin on the snapshot it was frozen to, if any
+    void					Unfreeze();
+    
+    UInt32 slot;	// in SinSynth::VoiceBank(), fixed when the voices are allocated
+    bool frozen;	// pin holds a snapshot of SinSynth::ScanSnapshot()
+    LidarScanSnapshot::Handle pin;
 };
 
-class SinSynth : public AUMonotimbralInstrumentBase
+/*
+ SinSynth is multitimbral: part N plays MIDI channel N to begin with (kMusicDeviceProperty_PartGroup
+ moves it), with its own zone, envelope times and polyphony, the part parameters and
+ kAudioUnitCustomProperty_PartPolyphony. The voices are laid out as one contiguous pool per part, so
+ a part that fills up steals only from its own channel, and a channel with nothing sounding is not
+ rendered at all.
+
+ With LIDARSYNTH_PUBLISH_STATS set, each instance also reports its render timing and queue depths to
+ the device hub's SynthStatsPublisher, as a SynthStatsSource.
+
+ When the host sets kAudioUnitProperty_OfflineRender and LIDARSYNTH_REPLAY names a scan log, the
+ next Initialize() moves the instance to a hub of its own (LidarDeviceHub::CreateOffline()) that has
+ no ingest thread: each render cycle processes the log's scans due by its first frame, counted on
+ the render clock, so a bounce runs as fast as the voices render and comes out the same every time.
+ Each initialization starts the log over; Cleanup() goes back to the shared hub.
+ */
+class SinSynth : public AUMultitimbralInstrumentBase, public SynthStatsSource
 {
 public:
     SinSynth(AudioUnit inComponentInstance);
@@ -49,9 +236,60 @@ public:
     virtual void				Cleanup();
     virtual OSStatus			Version() { return kSinSynthVersion; }
     
+    // the stats publisher's thread
+    virtual void				GetSynthStats(SynthStatsInstance &outStats);
+    
+    virtual void				ScheduleRenderEvents(const AudioTimeStamp &inTimeStamp, UInt32 inNumberFrames);
+    virtual void				BeginRenderCycle(UInt32 inNumberFrames);
+    virtual void				BeginRenderSlice(UInt32 inOffsetFrames, UInt32 inNumFrames);
+    virtual void				EndRenderSlice(UInt32 inOffsetFrames, UInt32 inNumFrames);
+    virtual bool				IsSoundingWithoutNotes() const { return mGrains.IsSounding(); }
+    
     virtual AUElement*			CreateElement(AudioUnitScope scope,
                                               AudioUnitElement element);
     
+    // any number of output channels up to kMaxOutputChannels; above 2 the zones are panned around them,
+    // or encoded as Ambisonics when the output's layout says so
+    virtual UInt32				SupportedNumChannels(const AUChannelInfo** outInfo);
+    virtual bool				ValidFormat(AudioUnitScope					inScope,
+                                            AudioUnitElement				inElement,
+                                            const CAStreamBasicDescription  & inNewFormat);
+    
+    virtual UInt32				GetChannelLayoutTags(AudioUnitScope				scope,
+                                                     AudioUnitElement			element,
+                                                     AudioChannelLayoutTag *	outLayoutTags);
+    virtual UInt32				GetAudioChannelLayout(AudioUnitScope			scope,
+                                                      AudioUnitElement			element,
+                                                      AudioChannelLayout *		outLayoutPtr,
+                                                      Boolean &					outWritable);
+    virtual OSStatus			SetAudioChannelLayout(AudioUnitScope			scope,
+                                                      AudioUnitElement			element,
+                                                      const AudioChannelLayout *	inLayout);
+    virtual OSStatus			RemoveAudioChannelLayout(AudioUnitScope scope, AudioUnitElement element);
+    
+    virtual void				MixMonoBuses(AudioBufferList &ioBus, const Float32 *const *inBuses, UInt32 inNumBuses,
+                                             UInt32 inNumberFrames);
+    
+    // the decimators' delay, when the voices are oversampled
+    virtual Float64				GetLatency();
+    
+    virtual OSStatus			GetPropertyInfo(AudioUnitPropertyID	inID,
+                                                AudioUnitScope			inScope,
+                                                AudioUnitElement		inElement,
+                                                UInt32 &				outDataSize,
+                                                Boolean &				outWritable);
+    
+    virtual OSStatus			GetProperty(AudioUnitPropertyID		inID,
+                                            AudioUnitScope			inScope,
+                                            AudioUnitElement		inElement,
+                                            void *					outData);
+    
+    virtual OSStatus			SetProperty(AudioUnitPropertyID		inID,
+                                            AudioUnitScope			inScope,
+                                            AudioUnitElement		inElement,
+                                            const void *			inData,
+                                            UInt32					inDataSize);
+    
     virtual OSStatus			GetParameterInfo(AudioUnitScope	inScope,
                                                  AudioUnitParameterID inParameterID,
                                                  AudioUnitParameterInfo &outParameterInfo);
@@ -62,7 +300,119 @@ public:
         return (MidiControls *) group->GetMIDIControlHandler();
     }
     
+    // the scan snapshot for the current render cycle; only valid on the render thread.
+    const LidarScanZones &		ScanZones() const { return *mScanZones; }
+    const ScanZoneMap &			ZoneMap() const { return mZoneMap; }
+    LidarScanSnapshot &			ScanSnapshot() { return mScanSnapshot; }
+    
+    // the hub this instance holds: the shared one, or while initialized for an offline render its own
+    LidarDeviceHub &			DeviceHub() { return *mDeviceHub; }
+    // the render clock of the current cycle, which the offline hub's capture times are on; 0 unless
+    // rendering offline
+    UInt64						OfflineRenderNanos() const { return mOfflineRenderNanos; }
+    
+    // every note's oscillator and envelope, indexed by TestNote::slot, and the volume ramp they share
+    WavetableVoiceBank &			VoiceBank() { return mVoiceBank; }
+    // the strings instead, under kVoiceType_Pluck; empty otherwise
+    PluckVoiceBank &			PluckBank() { return mPluckBank; }
+    bool						IsPlucked() const { return mVoiceType == kVoiceType_Pluck; }
+    const SmoothedParameter &	Volume() const { return mSliceVolume; }
+    
+    // the velocity curve, per-key increments and envelope steps, current as of this render cycle
+    const NoteTables &			Tables() const { return mNoteTables; }
+    // a part's envelope steps, its own times or the global ones, current as of this render cycle
+    const PartEnvelope &		Envelope(const SynthPartElement *inPart) const { return mPartEnvelopes[inPart->GetIndex()]; }
+    // a channel's pitch bend and level for this render cycle, and the first frame of the slice being
+    // rendered within it
+    const ControlRateModulation &	Modulation(const SynthGroupElement *inGroup) const { return mModulation[inGroup->GetIndex()]; }
+    UInt32						SliceOffset() const { return mSliceOffset; }
+    
+    // the table a note on inKey plays in a part, by the part's zone parameter
+    UInt32						TableForNote(SynthPartElement *inPart, UInt32 inKey) const;
+    // the window of the table a note plays, by the window parameters of this render call
+    WavetableWindow				WindowForNote(const MusicDeviceNoteParams &inParams, UInt32 inKey) const;
+    
+    // the rate the voices render at, as a multiple of the output's: MonoOversampling(), or 1 while
+    // load shedding holds each voice frame across the oversampled ones
+    UInt32						VoiceOversampling() const { return mVoiceOversampling; }
+    
+protected:
+    virtual void				QualityLevelChanged(UInt32 inLevel);
+    virtual void				ParameterBlockChanged(AUParameterBlockBase &inBlock);
+    
+    // the configuration, every part's settings and the scan being played, packed into the class info
+    // (see AUBinaryState.h); the configuration only takes while uninitialized, as its properties do
+    virtual void				SaveBinaryState(AUBinaryStateWriter &ioWriter);
+    virtual void				RestoreBinaryState(const AUBinaryStateReader &inReader);
+    
+    // moves the scan snapshot and the stats source from the current hub, which is released, to inHub;
+    // only while uninitialized
+    virtual void				SwitchDeviceHub(LidarDeviceHub *inHub);
+    
 private:
+    void						SeedScanFromState();
+    void						MixGrains(UInt32 inNumFrames);
+    static void					PrepareGrains(void *inContext);
     
-    TestNote mTestNotes[kNumNotes];
+    
+    LidarDeviceHub *			mDeviceHub;
+    LidarScanSnapshot			mScanSnapshot;
+    const LidarScanZones *		mScanZones;
+    ScanZoneMap					mZoneMap;
+    UInt64						mLastCaptureTime;	// of the scan the previous cycle rendered from
+    const LidarScanZones *		mTransitionFrom;	// the scan being faded out, or NULL
+    UInt32						mTransitionFrames;
+    UInt32						mTransitionLength;	// of the fade under way
+    UInt32						mTransitionPosition;	// of the current cycle's first frame in the fade
+    UInt32						mLastCycleFrames;
+    
+    UInt32						mPolyphony;
+    UInt32						mPartPolyphony[kNumParts];	// 0 takes mPolyphony
+    PartEnvelope				mPartEnvelopes[kNumParts];
+    // every part's settings as last set through kAudioUnitCustomProperty_PartSettings, each with
+    // the version of the block that set it
+    struct PartSettingsBlock
+    {
+        SinSynthPartSettings	mParts[kNumParts];
+        UInt64					mVersions[kNumParts];
+    };
+    AUParameterBlock<PartSettingsBlock>	mPartSettings;
+    CAMutex						mPartSettingsWriter;	// serializes the property's setters
+    UInt64						mAppliedPartSettings;	// the version the render thread last applied
+    UInt32						mNumRenderWorkers;
+    UInt32						mEngine;	// OscillatorEngine
+    UInt32						mHistoryDepth;
+    UInt32						mTableSize;	// kAudioUnitCustomProperty_ScanTableSize, 0 until set
+    ScanHistory					mHistory;	// of the scans played, owned by the render thread
+    VoicePool<TestNote>			mVoices;
+    WavetableVoiceBank			mVoiceBank;
+    UInt32						mVoiceType;	// VoiceType
+    PluckVoiceBank				mPluckBank;
+    NoteTables					mNoteTables;
+    SmoothedParameter			mVolume;	// kGlobalVolumeParam, ramped across each render call
+    SmoothedParameter			mSliceVolume;	// mVolume's ramp over the slice being rendered
+    UInt32						mSliceOffset;
+    std::vector<ControlRateModulation>	mModulation;	// one for each group
+    Float32						mModulationCoefficient;
+    CAAudioChannelLayout		mOutputChannelLayout;	// as the host set it, if it did
+    SpatialPanner				mPanner;	// of each zone's notes, with more than 2 output channels
+    UInt32						mOversampling;
+    UInt32						mVoiceOversampling;
+    std::vector<VoiceDecimator>	mDecimators;	// one for each mono bus, when oversampling
+    std::vector<Float32>		mOversampledMix;	// every group's share of each bus, summed over the slice
+    std::vector<bool>			mBusMixed;		// whether any group added to the bus this slice
+    std::vector<Float32>		mDecimated;		// each bus at the output rate
+    std::vector<const Float32 *> mDecimatedBlocks;
+    bool						mVoicesMixed;	// since the last render cycle began
+    UInt32						mOfflineRender;	// kAudioUnitProperty_OfflineRender, as the host set it
+    UInt64						mOfflineFrames;	// rendered since an offline hub was switched to
+    UInt64						mOfflineRenderNanos;
+    AUParameterBlock<GrainCloudSettings>	mGrainCloud;	// as last set through kAudioUnitCustomProperty_GrainCloud
+    CAMutex						mGrainCloudWriter;	// serializes the property's setters
+    GrainScheduler				mGrains;	// owned by the render thread once its pool is prepared
+    std::vector<Float32>		mGrainMix;	// a slice of the grains, before it is mixed into the output
+    AUDeferredResources			mGrainPool;	// mGrains' pool and mGrainMix, allocated once a cloud first plays
+    bool						mGrainCloudApplied;	// to mGrains, since its pool was prepared
+    ScanSequencer				mSequencer;	// fed by the hub's ingest thread
+    bool						mTriggerStarted;	// the note of the sequencer's first trigger has been scheduled
 };
@@ -0,0 +1,366 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Headless offline render benchmark for SinSynth
+ */
+
+/*
+ SinSynthBenchmark renders SinSynth as fast as it can, with no host and no component manager, and
+ reports how long that took. It constructs the SinSynth object directly, initializes it at each of
+ the requested buffer sizes and polyphonies in turn, and drives it the way a host would: MIDI note
+ events through MIDIEvent(), the entry point MusicDeviceMIDIEvent() dispatches to, then one DoRender()
+ per buffer with a running sample time.
+
+ The notes follow a fixed script so that runs compare: the polyphony's worth of notes is held from
+ the start, and every --note-ms the oldest one is released and a new one started at the next pitch,
+ at an offset inside the buffer. Every voice is sounding all the time, so the cost per voice is the
+ cycle time divided by the polyphony.
+
+ The scans come from LIDARSYNTH_REPLAY, through the same replay path the AU uses without the
+ sensor: --replay names a recorded scan log (see ScanLog.h), and without it a synthetic log of a
+ slowly turning scene is written to a temporary file first. The replay runs in real time, so the
+ wavetable changes at the recording's scan rate in wall-clock time, whatever the render speed.
+
+ For each configuration it prints the render speed relative to real time, the nanoseconds per frame
+ per voice, and the distribution of cycle times against the cycle's budget (frames / sample rate).
+
+ Build it as a command line tool from this file and the SinSynth target's sources and settings,
+ linking libSinSynthEngine.a, AudioToolbox, CoreAudio, CoreFoundation and SinSynth's LiDAR
+ libraries. For example:
+
+	SinSynthBenchmark --seconds 20 --frames 64,256,1024 --polyphony 8,64,256 --workers 3
+ */
+
+#include "SinSynth.h"
+#include "ScanLog.h"
+#include "CAHostTimeBase.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+enum
+{
+    kMidiMessage_NoteOff 			= 0x80,
+    kMidiMessage_NoteOn 			= 0x90
+};
+
+static const UInt32 kSyntheticScans = 600;			// a minute of scans at 10 Hz, replayed in a loop
+static const UInt32 kSyntheticSamplesPerScan = 500;
+static const UInt64 kSyntheticScanPeriod = 100000000;	// nanoseconds
+static const UInt32 kStreamingTimeoutMilliseconds = 2000;
+static const UInt32 kLowestNote = 36;				// of the script's notes
+static const UInt32 kNoteRange = 60;
+
+struct BenchmarkOptions
+{
+    BenchmarkOptions() : mSeconds(10.), mSampleRate(44100.), mNoteMilliseconds(250.), mNumWorkers(0),
+                         mEngine(kOscillatorEngine_Waveform), mTransitionFrames(0), mNumChannels(2), mNumZones(0),
+                         mOversampling(1), mBlockFrames(0) {}
+
+    Float64					mSeconds;				// of audio per configuration
+    Float64					mSampleRate;
+    Float64					mNoteMilliseconds;		// between successive note changes
+    UInt32					mNumWorkers;
+    UInt32					mEngine;				// OscillatorEngine
+    UInt32					mTransitionFrames;		// of each crossfade between scans
+    UInt32					mNumChannels;			// of the output; past 2 the zones are panned around them
+    UInt32					mNumZones;				// equal sectors, splitting the notes played between them
+    UInt32					mOversampling;			// of the voices
+    UInt32					mBlockFrames;			// of the fixed render blocks, 0 for none
+    std::vector<UInt32>		mFrames;
+    std::vector<UInt32>		mPolyphonies;
+    std::string				mReplayPath;
+};
+
+static void Usage(const char *inName)
+{
+    fprintf(stderr,
+            "usage: %s [--seconds S] [--sample-rate HZ] [--frames N[,N...]] [--polyphony N[,N...]]\n"
+            "          [--workers N] [--engine waveform|spectral] [--transition FRAMES] [--note-ms MS]\n"
+            "          [--channels N] [--zones N] [--oversampling 1|2|4]\n"
+            "          [--block-frames N] [--replay SCANLOG]\n", inName);
+    exit(1);
+}
+
+static std::vector<UInt32> ParseList(const char *inList)
+{
+    std::vector<UInt32> values;
+    for (const char *p = inList; *p; ) {
+        char *end;
+        unsigned long value = strtoul(p, &end, 10);
+        if (end == p || value == 0)
+            return std::vector<UInt32>();
+        values.push_back(UInt32(value));
+        p = (*end == ',') ? end + 1 : end;
+    }
+    return values;
+}
+
+static BenchmarkOptions ParseOptions(int argc, const char *argv[])
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (i + 1 >= argc)
+            Usage(argv[0]);
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--seconds"))
+            options.mSeconds = atof(value);
+        else if (!strcmp(arg, "--sample-rate"))
+            options.mSampleRate = atof(value);
+        else if (!strcmp(arg, "--frames"))
+            options.mFrames = ParseList(value);
+        else if (!strcmp(arg, "--polyphony"))
+            options.mPolyphonies = ParseList(value);
+        else if (!strcmp(arg, "--workers"))
+            options.mNumWorkers = UInt32(atoi(value));
+        else if (!strcmp(arg, "--engine") && !strcmp(value, "waveform"))
+            options.mEngine = kOscillatorEngine_Waveform;
+        else if (!strcmp(arg, "--engine") && !strcmp(value, "spectral"))
+            options.mEngine = kOscillatorEngine_Spectral;
+        else if (!strcmp(arg, "--transition"))
+            options.mTransitionFrames = UInt32(atoi(value));
+        else if (!strcmp(arg, "--channels"))
+            options.mNumChannels = UInt32(atoi(value));
+        else if (!strcmp(arg, "--zones"))
+            options.mNumZones = UInt32(atoi(value));
+        else if (!strcmp(arg, "--oversampling"))
+            options.mOversampling = UInt32(atoi(value));
+        else if (!strcmp(arg, "--block-frames"))
+            options.mBlockFrames = UInt32(atoi(value));
+        else if (!strcmp(arg, "--note-ms"))
+            options.mNoteMilliseconds = atof(value);
+        else if (!strcmp(arg, "--replay"))
+            options.mReplayPath = value;
+        else
+            Usage(argv[0]);
+    }
+    if (options.mFrames.empty())
+        options.mFrames.push_back(512);
+    if (options.mPolyphonies.empty())
+        options.mPolyphonies.push_back(32);
+    if (!(options.mSeconds > 0) || !(options.mSampleRate > 0) || !(options.mNoteMilliseconds > 0)
+        || options.mNumChannels < 1 || options.mNumChannels > kMaxOutputChannels || options.mNumZones > kMaxScanZones
+        || (options.mOversampling != 1 && options.mOversampling != 2 && options.mOversampling != kMaxOversampling))
+        Usage(argv[0]);
+    return options;
+}
+
+// a room with a wall at 2-8 m and an object circling the sensor, one revolution every 6 seconds
+static bool WriteSyntheticScanLog(const char *inPath)
+{
+    ScanLogWriter writer;
+    if (!writer.Open(inPath))
+        return false;
+
+    std::vector<std::int32_t> angles(kSyntheticSamplesPerScan), distances(kSyntheticSamplesPerScan);
+    for (UInt32 scan = 0; scan < kSyntheticScans; ++scan) {
+        double objectAngle = 2.0 * M_PI * scan / 60.0;
+        for (UInt32 i = 0; i < kSyntheticSamplesPerScan; ++i) {
+            double angle = 2.0 * M_PI * i / kSyntheticSamplesPerScan;
+            double distance = 500.0 + 300.0 * std::sin(3.0 * angle);
+            double fromObject = std::remainder(angle - objectAngle, 2.0 * M_PI);
+            if (std::fabs(fromObject) < 0.2)
+                distance = 80.0 + 100.0 * std::fabs(fromObject);
+            angles[i] = std::int32_t(i * kScanFullCircle / kSyntheticSamplesPerScan);
+            distances[i] = (i % 37 == 0) ? 0 : std::int32_t(distance);	// a few dropped returns
+        }
+        writer.Write(scan * kSyntheticScanPeriod, angles.data(), distances.data(), NULL, kSyntheticSamplesPerScan);
+    }
+    writer.Close();
+    return true;
+}
+
+static OSStatus SetUInt32Property(SinSynth &inSynth, AudioUnitPropertyID inID, UInt32 inValue)
+{
+    return inSynth.DispatchSetProperty(inID, kAudioUnitScope_Global, 0, &inValue, sizeof(inValue));
+}
+
+// inNumZones sectors round the circle, sharing out the range of notes the script plays
+static ScanZoneMap EqualZones(UInt32 inNumZones)
+{
+    ScanZoneMap map;
+    map.mNumZones = inNumZones;
+    for (UInt32 i = 0; i < inNumZones; ++i) {
+        ScanZone &zone = map.mZones[i];
+        zone.mStartAngle = std::int32_t(i * (kScanFullCircle / inNumZones));
+        zone.mSpan = kScanFullCircle / std::int32_t(inNumZones);
+        zone.mLowNote = kLowestNote + i * kNoteRange / inNumZones;
+        zone.mHighNote = kLowestNote + (i + 1) * kNoteRange / inNumZones - 1;
+    }
+    return map;
+}
+
+static void WaitForScans(SinSynth &inSynth)
+{
+    for (UInt32 waited = 0; waited < kStreamingTimeoutMilliseconds; waited += 10) {
+        UInt32 state = kLidarState_Connecting;
+        inSynth.DispatchGetProperty(kAudioUnitCustomProperty_LidarDeviceState, kAudioUnitScope_Global, 0, &state);
+        if (state == kLidarState_Streaming)
+            return;
+        if (state == kLidarState_Failed)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    fprintf(stderr, "SinSynthBenchmark: no scans arrived; rendering the fallback table\n");
+}
+
+static double Percentile(const std::vector<UInt64> &inSorted, double inFraction)
+{
+    size_t index = size_t(inFraction * (inSorted.size() - 1) + 0.5);
+    return CAHostTimeBase::ConvertToNanos(inSorted[index]) * 1.0e-3;
+}
+
+static OSStatus RunConfiguration(const BenchmarkOptions &inOptions, UInt32 inFrames, UInt32 inPolyphony)
+{
+    ComponentBase::sNewInstanceType = ComponentBase::kAudioComponentInstance;
+    SinSynth *synth = new SinSynth(NULL);
+    synth->PostConstructor();
+
+    AudioStreamBasicDescription format;
+    OSStatus err = synth->DispatchGetProperty(kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format);
+    format.mSampleRate = inOptions.mSampleRate;
+    format.mChannelsPerFrame = inOptions.mNumChannels;
+    if (!err) err = synth->DispatchSetProperty(kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format, sizeof(format));
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitProperty_MaximumFramesPerSlice, inFrames);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_Polyphony, inPolyphony);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_RenderWorkers, inOptions.mNumWorkers);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_OscillatorEngine, inOptions.mEngine);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_ScanTransitionFrames, inOptions.mTransitionFrames);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_Oversampling, inOptions.mOversampling);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_RenderBlockFrames, inOptions.mBlockFrames);
+    if (!err && inOptions.mNumZones > 0) {
+        ScanZoneMap zones = EqualZones(inOptions.mNumZones);
+        err = synth->DispatchSetProperty(kAudioUnitCustomProperty_ScanZones, kAudioUnitScope_Global, 0, &zones, sizeof(zones));
+    }
+    if (!err) err = synth->DoInitialize();
+    if (err) {
+        fprintf(stderr, "SinSynthBenchmark: cannot set up %u frames, polyphony %u: %d\n",
+                (unsigned)inFrames, (unsigned)inPolyphony, (int)err);
+        synth->PreDestructor();
+        delete synth;
+        return err;
+    }
+    WaitForScans(*synth);
+
+    UInt32 numChannels = format.mChannelsPerFrame;
+    std::vector<Float32> samples(numChannels * inFrames);
+    std::vector<UInt8> bufferListMemory(offsetof(AudioBufferList, mBuffers) + numChannels * sizeof(AudioBuffer));
+    AudioBufferList &bufferList = *(AudioBufferList *)bufferListMemory.data();
+
+    UInt64 numCycles = UInt64(std::ceil(inOptions.mSeconds * inOptions.mSampleRate / inFrames));
+    UInt64 noteInterval = std::max<UInt64>(1, UInt64(inOptions.mNoteMilliseconds * 1.0e-3 * inOptions.mSampleRate));
+    std::vector<UInt64> cycleTimes;
+    cycleTimes.reserve(numCycles);
+
+    // notes 36 upwards, wrapping within five octaves. Above 60 voices pitches repeat, and a note-off
+    // releases one of the notes at its pitch, which keeps inPolyphony of them held just the same.
+    UInt64 nextNoteChange = 0, numNoteChanges = 0;
+    for (UInt32 i = 0; i < inPolyphony; ++i)
+        synth->MIDIEvent(kMidiMessage_NoteOn, kLowestNote + i % kNoteRange, 100, 0);
+
+    AudioTimeStamp timeStamp;
+    memset(&timeStamp, 0, sizeof(timeStamp));
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid;
+
+    UInt64 runStart = CAHostTimeBase::GetTheCurrentTime();
+    for (UInt64 cycle = 0; cycle < numCycles && !err; ++cycle) {
+        UInt64 sampleTime = cycle * inFrames;
+        while (nextNoteChange < sampleTime + inFrames) {
+            if (nextNoteChange >= sampleTime) {
+                UInt32 offset = UInt32(nextNoteChange - sampleTime);
+                UInt64 oldest = numNoteChanges, newest = numNoteChanges + inPolyphony;
+                synth->MIDIEvent(kMidiMessage_NoteOff, kLowestNote + UInt32(oldest % kNoteRange), 0, offset);
+                synth->MIDIEvent(kMidiMessage_NoteOn, kLowestNote + UInt32(newest % kNoteRange), 100, offset);
+                numNoteChanges++;
+            }
+            nextNoteChange += noteInterval;
+        }
+
+        bufferList.mNumberBuffers = numChannels;
+        for (UInt32 ch = 0; ch < numChannels; ++ch) {
+            bufferList.mBuffers[ch].mNumberChannels = 1;
+            bufferList.mBuffers[ch].mDataByteSize = inFrames * sizeof(Float32);
+            bufferList.mBuffers[ch].mData = &samples[ch * inFrames];
+        }
+        timeStamp.mSampleTime = Float64(sampleTime);
+        timeStamp.mHostTime = CAHostTimeBase::GetTheCurrentTime();
+
+        AudioUnitRenderActionFlags flags = 0;
+        UInt64 start = CAHostTimeBase::GetTheCurrentTime();
+        err = synth->DoRender(flags, timeStamp, 0, inFrames, bufferList);
+        cycleTimes.push_back(CAHostTimeBase::GetTheCurrentTime() - start);
+    }
+    Float64 wallSeconds = CAHostTimeBase::ConvertToNanos(CAHostTimeBase::GetTheCurrentTime() - runStart) * 1.0e-9;
+
+    if (err) {
+        fprintf(stderr, "SinSynthBenchmark: render failed at %u frames, polyphony %u: %d\n",
+                (unsigned)inFrames, (unsigned)inPolyphony, (int)err);
+    } else {
+        UInt64 totalTime = 0;
+        for (size_t i = 0; i < cycleTimes.size(); ++i)
+            totalTime += cycleTimes[i];
+        Float64 budget = 1.0e6 * inFrames / inOptions.mSampleRate;	// microseconds
+        std::sort(cycleTimes.begin(), cycleTimes.end());
+        UInt64 numOverBudget = 0;
+        for (size_t i = 0; i < cycleTimes.size(); ++i)
+            if (CAHostTimeBase::ConvertToNanos(cycleTimes[i]) * 1.0e-3 > budget)
+                numOverBudget++;
+
+        Float64 nsPerFrameVoice = Float64(CAHostTimeBase::ConvertToNanos(totalTime)) / (Float64(numCycles) * inFrames * inPolyphony);
+        printf("%6u frames %5u voices  %8.1fx real time  %8.3f ns/frame/voice\n",
+               (unsigned)inFrames, (unsigned)inPolyphony, inOptions.mSeconds / wallSeconds, nsPerFrameVoice);
+        printf("    cycle us: min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  (budget %.1f, %llu of %llu over)\n",
+               Percentile(cycleTimes, 0.), Percentile(cycleTimes, 0.5), Percentile(cycleTimes, 0.9),
+               Percentile(cycleTimes, 0.99), Percentile(cycleTimes, 0.999), Percentile(cycleTimes, 1.), budget,
+               (unsigned long long)numOverBudget, (unsigned long long)cycleTimes.size());
+    }
+
+    synth->PreDestructor();
+    delete synth;
+    return err;
+}
+
+int main(int argc, const char * argv[])
+{
+    BenchmarkOptions options = ParseOptions(argc, argv);
+
+    // the hub reads the environment when its ingest thread starts, with the first SinSynth
+    std::string replayPath = options.mReplayPath;
+    char syntheticPath[] = "/tmp/SinSynthBenchmark.XXXXXX";
+    if (replayPath.empty()) {
+        int fd = mkstemp(syntheticPath);
+        if (fd < 0 || (close(fd), !WriteSyntheticScanLog(syntheticPath))) {
+            fprintf(stderr, "SinSynthBenchmark: cannot write a synthetic scan log to %s\n", syntheticPath);
+            return 1;
+        }
+        replayPath = syntheticPath;
+    }
+    setenv("LIDARSYNTH_REPLAY", replayPath.c_str(), 1);
+    unsetenv("LIDARSYNTH_REPLAY_SPEED");
+
+    printf("SinSynth: %.1f s at %.0f Hz per configuration, %u workers, %s engine, %u-frame transitions, %u channels, %u zones, %ux voices, %u-frame blocks, scans from %s\n",
+           options.mSeconds, options.mSampleRate, (unsigned)options.mNumWorkers,
+           options.mEngine == kOscillatorEngine_Spectral ? "spectral" : "waveform", (unsigned)options.mTransitionFrames,
+           (unsigned)options.mNumChannels, (unsigned)options.mNumZones, (unsigned)options.mOversampling,
+           (unsigned)options.mBlockFrames, options.mReplayPath.empty() ? "a synthetic log" : options.mReplayPath.c_str());
+
+    int result = 0;
+    for (size_t f = 0; f < options.mFrames.size(); ++f)
+        for (size_t p = 0; p < options.mPolyphonies.size(); ++p)
+            if (RunConfiguration(options, options.mFrames[f], options.mPolyphonies[p]) != noErr)
+                result = 1;
+
+    if (options.mReplayPath.empty())
+        unlink(syntheticPath);
+    return result;
+}
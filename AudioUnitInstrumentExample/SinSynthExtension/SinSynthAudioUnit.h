@@ -0,0 +1,37 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ SinSynth as a version 3 audio unit, rendered straight from its render block
+ */
+
+#import <AudioToolbox/AudioToolbox.h>
+
+/*
+ SinSynthAudioUnit wraps a SinSynth object in an AUAudioUnit, the way SinSynthBenchmark drives one:
+ constructed directly, with no component instance, and called without going through the version 2
+ dispatch table. Everything that dispatches or allocates happens in -allocateRenderResources: the
+ output bus's format and the maximum frames are handed to the synth as properties, and the synth is
+ initialized, which sizes the output buffer its render falls back on when the host passes none.
+
+ The render block captures the SinSynth pointer itself, never the Objective-C object. Per cycle it
+ walks the host's realtime event list, which arrives sorted by time, handing each MIDI message to
+ MIDIEvent() and each parameter change to SetParameter() at its offset into the buffer, then calls
+ AUBase::DoRender() once. That skips AUMethodRender's flag juggling, its exception frame and the
+ lookup of the instance from the plug-in's storage; DoRender still times the cycle, guards against
+ denormals and takes the parameter blocks, as it does for a version 2 host.
+
+ Parameter addresses carry the scope: a global parameter's address is its ID, and part p's parameter
+ i is ((p + 1) << 16) | i. A ramp is applied as a step to its target; the synth smooths the volume
+ itself.
+
+ Build it with ARC, with the SinSynth target's sources and settings, linking libSinSynthEngine.a,
+ into an audio unit extension, or call +registerForInProcessUse to instantiate it in a host's own
+ process.
+ */
+@interface SinSynthAudioUnit : AUAudioUnit
+
+// registers the class under SinSynth's component description, as 'aumu' 'jsin' 'Demo'
++ (void)registerForInProcessUse;
+
+@end
@@ -0,0 +1,234 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ SinSynth as a version 3 audio unit, rendered straight from its render block
+ */
+
+#import "SinSynthAudioUnit.h"
+#import <AVFoundation/AVFoundation.h>
+#include "SinSynth.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+static const AudioComponentDescription kSinSynthDescription = { kAudioUnitType_MusicDevice, kSinSynthSubtype, 'Demo', 0, 0 };
+static const UInt32 kPartAddressShift = 16;		// of the part number in a parameter address
+static const AUParameterAddress kParameterIDMask = 0xFFFF;
+
+static AUParameterAddress ParameterAddress(AudioUnitScope inScope, AudioUnitElement inElement, AudioUnitParameterID inID)
+{
+    AUParameterAddress part = inScope == kAudioUnitScope_Part ? inElement + 1 : 0;
+    return (part << kPartAddressShift) | inID;
+}
+
+static void DecodeParameterAddress(AUParameterAddress inAddress, AudioUnitScope &outScope,
+                                   AudioUnitElement &outElement, AudioUnitParameterID &outID)
+{
+    AudioUnitElement part = AudioUnitElement(inAddress >> kPartAddressShift);
+    outScope = part == 0 ? kAudioUnitScope_Global : kAudioUnitScope_Part;
+    outElement = part == 0 ? 0 : part - 1;
+    outID = AudioUnitParameterID(inAddress & kParameterIDMask);
+}
+
+static NSError *StatusError(OSStatus inStatus)
+{
+    return [NSError errorWithDomain:NSOSStatusErrorDomain code:inStatus userInfo:nil];
+}
+
+@implementation SinSynthAudioUnit
+{
+    SinSynth *				_synth;
+    AUAudioUnitBus *		_outputBus;
+    AUAudioUnitBusArray *	_outputBusArray;
+    AUParameterTree *		_parameterTree;
+}
+
++ (void)registerForInProcessUse
+{
+    [AUAudioUnit registerSubclass:self
+           asComponentDescription:kSinSynthDescription
+                             name:@"Demo: SinSynth"
+                          version:kSinSynthVersion];
+}
+
+- (instancetype)initWithComponentDescription:(AudioComponentDescription)componentDescription
+                                     options:(AudioComponentInstantiationOptions)options
+                                       error:(NSError **)outError
+{
+    self = [super initWithComponentDescription:componentDescription options:options error:outError];
+    if (self == nil)
+        return nil;
+
+    ComponentBase::sNewInstanceType = ComponentBase::kAudioComponentInstance;
+    _synth = new SinSynth(NULL);
+    _synth->PostConstructor();
+
+    AVAudioFormat *format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100. channels:2];
+    _outputBus = [[AUAudioUnitBus alloc] initWithFormat:format error:outError];
+    if (_outputBus == nil)
+        return nil;
+    _outputBusArray = [[AUAudioUnitBusArray alloc] initWithAudioUnit:self
+                                                             busType:AUAudioUnitBusTypeOutput
+                                                              busses:@[ _outputBus ]];
+    [self buildParameterTree];
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_synth != NULL) {
+        _synth->PreDestructor();
+        delete _synth;
+    }
+}
+
+// the global parameters, then each part's, read from the synth's own parameter info
+- (void)buildParameterTree
+{
+    NSMutableArray<AUParameter *> *parameters = [NSMutableArray array];
+    const AudioUnitScope scopes[] = { kAudioUnitScope_Global, kAudioUnitScope_Part };
+    for (AudioUnitScope scope : scopes) {
+        UInt32 numParameters = 0;
+        _synth->GetParameterList(scope, NULL, numParameters);
+        std::vector<AudioUnitParameterID> ids(numParameters);
+        if (numParameters > 0)
+            _synth->GetParameterList(scope, ids.data(), numParameters);
+        const UInt32 numElements = scope == kAudioUnitScope_Part ? kNumParts : 1;
+        for (UInt32 element = 0; element < numElements; ++element) {
+            for (AudioUnitParameterID parameterID : ids) {
+                AUParameter *parameter = [self parameterWithID:parameterID scope:scope element:element];
+                if (parameter != nil)
+                    [parameters addObject:parameter];
+            }
+        }
+    }
+    _parameterTree = [AUParameterTree createTreeWithChildren:parameters];
+
+    SinSynth *synth = _synth;
+    _parameterTree.implementorValueObserver = ^(AUParameter *param, AUValue value) {
+        AudioUnitScope scope;
+        AudioUnitElement element;
+        AudioUnitParameterID parameterID;
+        DecodeParameterAddress(param.address, scope, element, parameterID);
+        synth->SetParameter(parameterID, scope, element, value, 0);
+    };
+    _parameterTree.implementorValueProvider = ^AUValue(AUParameter *param) {
+        AudioUnitScope scope;
+        AudioUnitElement element;
+        AudioUnitParameterID parameterID;
+        DecodeParameterAddress(param.address, scope, element, parameterID);
+        AudioUnitParameterValue value = 0;
+        synth->GetParameter(parameterID, scope, element, value);
+        return value;
+    };
+}
+
+- (AUParameter *)parameterWithID:(AudioUnitParameterID)inID scope:(AudioUnitScope)inScope element:(AudioUnitElement)inElement
+{
+    AudioUnitParameterInfo info;
+    memset(&info, 0, sizeof(info));
+    if (_synth->GetParameterInfo(inScope, inID, info) != noErr)
+        return nil;
+    NSString *name = (info.flags & kAudioUnitParameterFlag_HasCFNameString)
+        ? [NSString stringWithString:(__bridge NSString *)info.cfNameString] : [NSString stringWithUTF8String:info.name];
+    if (info.flags & kAudioUnitParameterFlag_CFNameRelease)
+        CFRelease(info.cfNameString);
+    if (inScope == kAudioUnitScope_Part)
+        name = [NSString stringWithFormat:@"part %u %@", (unsigned)inElement + 1, name];
+
+    AUParameterAddress address = ParameterAddress(inScope, inElement, inID);
+    AUParameter *parameter = [AUParameterTree createParameterWithIdentifier:[NSString stringWithFormat:@"%llu", (unsigned long long)address]
+                                                                      name:name
+                                                                   address:address
+                                                                       min:info.minValue
+                                                                       max:info.maxValue
+                                                                      unit:info.unit
+                                                                  unitName:nil
+                                                                     flags:info.flags
+                                                              valueStrings:nil
+                                                       dependentParameters:nil];
+    AudioUnitParameterValue value = info.defaultValue;
+    _synth->GetParameter(inID, inScope, inElement, value);
+    parameter.value = value;
+    return parameter;
+}
+
+- (AUParameterTree *)parameterTree
+{
+    return _parameterTree;
+}
+
+- (AUAudioUnitBusArray *)outputBusses
+{
+    return _outputBusArray;
+}
+
+// no inputs, and as many outputs as the host likes: past 2 the synth pans its zones around them
+- (NSArray<NSNumber *> *)channelCapabilities
+{
+    return @[ @0, @-1 ];
+}
+
+- (BOOL)allocateRenderResourcesAndReturnError:(NSError **)outError
+{
+    if (![super allocateRenderResourcesAndReturnError:outError])
+        return NO;
+
+    AudioStreamBasicDescription format = *_outputBus.format.streamDescription;
+    UInt32 maxFrames = self.maximumFramesToRender;
+    OSStatus err = _synth->DispatchSetProperty(kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format, sizeof(format));
+    if (!err) err = _synth->DispatchSetProperty(kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &maxFrames, sizeof(maxFrames));
+    if (!err) err = _synth->DoInitialize();
+    if (err) {
+        if (outError != NULL)
+            *outError = StatusError(err);
+        [super deallocateRenderResources];
+        return NO;
+    }
+    return YES;
+}
+
+- (void)deallocateRenderResources
+{
+    _synth->DoCleanup();
+    [super deallocateRenderResources];
+}
+
+- (AUInternalRenderBlock)internalRenderBlock
+{
+    // only the synth itself is captured; the block never touches the Objective-C object
+    SinSynth *synth = _synth;
+
+    return ^AUAudioUnitStatus(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+                              AVAudioFrameCount frameCount, NSInteger outputBusNumber, AudioBufferList *outputData,
+                              const AURenderEvent *realtimeEventListHead, AURenderPullInputBlock pullInputBlock) {
+        const AUEventSampleTime cycleStart = AUEventSampleTime(timestamp->mSampleTime);
+        for (const AURenderEvent *event = realtimeEventListHead; event != NULL; event = event->head.next) {
+            // an event due before the buffer, or sent as immediate, lands on its first frame
+            const AUEventSampleTime offset = event->head.eventSampleTime - cycleStart;
+            const UInt32 frame = offset <= 0 ? 0 : UInt32(std::min<AUEventSampleTime>(offset, frameCount - 1));
+            switch (event->head.eventType) {
+                case AURenderEventMIDI: {
+                    const AUMIDIEvent &midi = event->MIDI;
+                    synth->MIDIEvent(midi.data[0], midi.length > 1 ? midi.data[1] : 0, midi.length > 2 ? midi.data[2] : 0, frame);
+                    break;
+                }
+                case AURenderEventParameter:
+                case AURenderEventParameterRamp: {
+                    AudioUnitScope scope;
+                    AudioUnitElement element;
+                    AudioUnitParameterID parameterID;
+                    DecodeParameterAddress(event->parameter.parameterAddress, scope, element, parameterID);
+                    synth->SetParameter(parameterID, scope, element, event->parameter.value, frame);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        return synth->DoRender(*actionFlags, *timestamp, UInt32(outputBusNumber), frameCount, *outputData);
+    };
+}
+
+@end
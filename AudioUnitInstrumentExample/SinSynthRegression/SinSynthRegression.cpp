@@ -0,0 +1,952 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Golden-output and timing regression runner for SinSynth
+ */
+
+/*
+ SinSynthRegression renders SinSynth from a recorded scan log and a Standard MIDI File and checks
+ the result twice over: the sound against a golden render, and the cycle times against a timing
+ baseline, both recorded earlier with --record from the same inputs and settings. It prints one
+ summary line with a verdict for each and exits nonzero if either fails, so an optimization comes
+ with proof that it changed nothing audible and that it is faster.
+
+ The render must be the same on every run, so the scans do not come through the hub's real-time
+ replay. The hub is pointed at an empty replay, which it gives up on at once, and the instance is
+ taken off its subscribers; the runner then plays the hub's part itself, between render cycles:
+ each scan of the log goes through the quality filter, the table builder and the mip-map builder
+ with the hub's default settings, scans the hub would find unchanged are skipped as it skips them,
+ and the table is published into the instance's snapshot before the first cycle that starts at or
+ after the scan's time in the log, counted from its first scan. The first scan is there before the
+ first cycle; after the last one the synth keeps playing it. Zones are not set, so the voices play
+ the whole scan. Since scans change only between cycles, a golden render holds for one --frames.
+
+ The MIDI file may be of format 0 or 1, its tracks merged, with tempo changes (or SMPTE timing)
+ honoured; channel messages are sent to MIDIEvent() at their offsets in the cycle, and meta and
+ system exclusive events are skipped. The render runs --tail seconds past the last event so that
+ releases are heard out.
+
+ Quality is the signal-to-noise ratio of the render against the golden one, the golden render being
+ the signal and the difference the noise; it passes at --min-snr dB or better, and a bit-identical
+ render reports an infinite ratio. The golden render is a 32-bit float WAV file, so it can be
+ listened to. Performance is judged on the 50th, 90th and 99th percentiles of the cycle times,
+ which must each be within --max-slowdown of the baseline's (a negative value demands a speedup);
+ the 99.9th percentile and the longest cycle are printed but not judged, being at the mercy of the
+ machine. Each of the --runs renders builds a fresh synth, and each percentile is the lowest of the
+ runs', the run least disturbed by the rest of the system; every run's sound is checked. Compare
+ timings only on the machine, and with the build settings, the baseline was recorded with.
+
+ Before the renders it runs one check of the hub itself, which the renders bypass: the daemon path
+ with tables of another size than the hub's (see CheckDaemonRebin()). Its verdict is printed on a line
+ of its own and fails the run too; it is skipped while a daemon owns the ring.
+
+ Build it as a command line tool from this file and the SinSynth target's sources and settings,
+ linking libSinSynthEngine.a, AudioToolbox, CoreAudio, CoreFoundation and SinSynth's LiDAR
+ libraries. For example:
+
+	SinSynthRegression --scans room.scanlog --midi etude.mid --golden etude.wav --baseline etude.timing --record
+	SinSynthRegression --scans room.scanlog --midi etude.mid --golden etude.wav --baseline etude.timing
+ */
+
+#include "SinSynth.h"
+#include "ScanLog.h"
+#include "ScanMipMap.h"
+#include "ScanQualityFilter.h"
+#include "ScanStatistics.h"
+#include "CAHostTimeBase.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const UInt64 kFirstCaptureTime = 1000000000;	// nanoseconds; the log's first scan, clear of kCachedScanCaptureTime
+static const UInt32 kChangeThreshold = 1U << kScanTableDefaultBits;	// the hub's default LIDARSYNTH_CHANGE_THRESHOLD
+static const UInt32 kDefaultTempo = 500000;			// microseconds per quarter note, 120 bpm
+static const UInt16 kWaveFormatFloat = 3;
+
+struct RegressionOptions
+{
+    RegressionOptions() : mSampleRate(44100.), mFrames(512), mPolyphony(32), mNumWorkers(0),
+                          mEngine(kOscillatorEngine_Waveform), mTransitionFrames(0), mNumChannels(2),
+                          mOversampling(1), mRuns(5), mTailSeconds(2.), mMinSNR(90.), mMaxSlowdown(0.1), mRecord(false) {}
+
+    Float64					mSampleRate;
+    UInt32					mFrames;				// per cycle
+    UInt32					mPolyphony;
+    UInt32					mNumWorkers;
+    UInt32					mEngine;				// OscillatorEngine
+    UInt32					mTransitionFrames;		// of each crossfade between scans
+    UInt32					mNumChannels;
+    UInt32					mOversampling;			// of the voices
+    UInt32					mRuns;
+    Float64					mTailSeconds;			// rendered after the last MIDI event
+    Float64					mMinSNR;				// dB
+    Float64					mMaxSlowdown;			// a fraction of each baseline percentile
+    bool					mRecord;				// write the golden render and the baseline instead of comparing
+    std::string				mScanPath;
+    std::string				mMidiPath;
+    std::string				mGoldenPath;
+    std::string				mBaselinePath;
+};
+
+static void Usage(const char *inName)
+{
+    fprintf(stderr,
+            "usage: %s --scans SCANLOG --midi FILE.mid --golden FILE.wav --baseline FILE [--record]\n"
+            "          [--sample-rate HZ] [--frames N] [--polyphony N] [--workers N]\n"
+            "          [--engine waveform|spectral] [--transition FRAMES] [--channels N] [--oversampling 1|2|4]\n"
+            "          [--runs N] [--tail S] [--min-snr DB] [--max-slowdown FRACTION]\n", inName);
+    exit(1);
+}
+
+static RegressionOptions ParseOptions(int argc, const char *argv[])
+{
+    RegressionOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "--record")) {
+            options.mRecord = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            Usage(argv[0]);
+        const char *value = argv[++i];
+        if (!strcmp(arg, "--scans"))
+            options.mScanPath = value;
+        else if (!strcmp(arg, "--midi"))
+            options.mMidiPath = value;
+        else if (!strcmp(arg, "--golden"))
+            options.mGoldenPath = value;
+        else if (!strcmp(arg, "--baseline"))
+            options.mBaselinePath = value;
+        else if (!strcmp(arg, "--sample-rate"))
+            options.mSampleRate = atof(value);
+        else if (!strcmp(arg, "--frames"))
+            options.mFrames = UInt32(atoi(value));
+        else if (!strcmp(arg, "--polyphony"))
+            options.mPolyphony = UInt32(atoi(value));
+        else if (!strcmp(arg, "--workers"))
+            options.mNumWorkers = UInt32(atoi(value));
+        else if (!strcmp(arg, "--engine") && !strcmp(value, "waveform"))
+            options.mEngine = kOscillatorEngine_Waveform;
+        else if (!strcmp(arg, "--engine") && !strcmp(value, "spectral"))
+            options.mEngine = kOscillatorEngine_Spectral;
+        else if (!strcmp(arg, "--transition"))
+            options.mTransitionFrames = UInt32(atoi(value));
+        else if (!strcmp(arg, "--channels"))
+            options.mNumChannels = UInt32(atoi(value));
+        else if (!strcmp(arg, "--oversampling"))
+            options.mOversampling = UInt32(atoi(value));
+        else if (!strcmp(arg, "--runs"))
+            options.mRuns = UInt32(atoi(value));
+        else if (!strcmp(arg, "--tail"))
+            options.mTailSeconds = atof(value);
+        else if (!strcmp(arg, "--min-snr"))
+            options.mMinSNR = atof(value);
+        else if (!strcmp(arg, "--max-slowdown"))
+            options.mMaxSlowdown = atof(value);
+        else
+            Usage(argv[0]);
+    }
+    if (options.mScanPath.empty() || options.mMidiPath.empty() || options.mGoldenPath.empty() || options.mBaselinePath.empty()
+        || !(options.mSampleRate > 0) || options.mFrames == 0 || options.mPolyphony == 0 || options.mRuns == 0
+        || !(options.mTailSeconds >= 0) || options.mNumChannels < 1 || options.mNumChannels > kMaxOutputChannels
+        || !(options.mMaxSlowdown > -1.)
+        || (options.mOversampling != 1 && options.mOversampling != 2 && options.mOversampling != kMaxOversampling))
+        Usage(argv[0]);
+    return options;
+}
+
+static bool ReadFile(const char *inPath, std::vector<UInt8> &outData)
+{
+    FILE *file = fopen(inPath, "rb");
+    if (file == NULL)
+        return false;
+    outData.clear();
+    UInt8 chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        outData.insert(outData.end(), chunk, chunk + n);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static bool WriteFile(const char *inPath, const std::vector<UInt8> &inData)
+{
+    FILE *file = fopen(inPath, "wb");
+    if (file == NULL)
+        return false;
+    bool written = fwrite(inData.data(), 1, inData.size(), file) == inData.size();
+    return fclose(file) == 0 && written;
+}
+
+#pragma mark MIDI file
+
+// a channel message, at the frame of the render it falls on
+struct MidiFileEvent
+{
+    UInt64					mFrame;
+    UInt8					mStatus;
+    UInt8					mData1;
+    UInt8					mData2;
+};
+
+// reads big-endian fields and variable-length quantities, failing rather than running off the end
+class MidiFileReader
+{
+public:
+    MidiFileReader(const UInt8 *inBegin, const UInt8 *inEnd) : mPos(inBegin), mEnd(inEnd), mOK(true) {}
+
+    bool					OK() const { return mOK; }
+    bool					AtEnd() const { return mPos >= mEnd; }
+    const UInt8 *			Position() const { return mPos; }
+
+    UInt8					Byte() { return Has(1) ? *mPos++ : 0; }
+    UInt32					Big(UInt32 inBytes)
+    {
+        UInt32 value = 0;
+        for (UInt32 i = 0; i < inBytes; ++i)
+            value = value << 8 | Byte();
+        return value;
+    }
+    UInt32					VariableLength()
+    {
+        UInt32 value = 0;
+        for (UInt32 i = 0; i < 4; ++i) {
+            UInt8 byte = Byte();
+            value = value << 7 | (byte & 0x7F);
+            if (!(byte & 0x80))
+                return value;
+        }
+        mOK = false;
+        return 0;
+    }
+    void					Skip(UInt32 inBytes) { if (Has(inBytes)) mPos += inBytes; }
+
+private:
+    bool					Has(UInt32 inBytes)
+    {
+        if (size_t(mEnd - mPos) < inBytes)
+            mOK = false;
+        return mOK;
+    }
+
+    const UInt8 *			mPos;
+    const UInt8 *			mEnd;
+    bool					mOK;
+};
+
+// an event of a track, in ticks; a tempo change has mTempo set and no message
+struct MidiTrackEvent
+{
+    UInt64					mTick;
+    UInt32					mTempo;					// microseconds per quarter note, 0 for a channel message
+    UInt8					mStatus;
+    UInt8					mData1;
+    UInt8					mData2;
+};
+
+static bool ReadTrack(MidiFileReader &ioTrack, std::vector<MidiTrackEvent> &ioEvents)
+{
+    UInt64 tick = 0;
+    UInt8 runningStatus = 0;
+    while (ioTrack.OK() && !ioTrack.AtEnd()) {
+        tick += ioTrack.VariableLength();
+        UInt8 status = ioTrack.Byte();
+        if (status == 0xFF) {
+            UInt8 type = ioTrack.Byte();
+            UInt32 length = ioTrack.VariableLength();
+            if (type == 0x2F)
+                break;
+            if (type == 0x51 && length == 3) {
+                MidiTrackEvent event = { tick, ioTrack.Big(3), 0, 0, 0 };
+                if (event.mTempo > 0)
+                    ioEvents.push_back(event);
+            } else
+                ioTrack.Skip(length);
+            continue;
+        }
+        if (status == 0xF0 || status == 0xF7) {
+            ioTrack.Skip(ioTrack.VariableLength());
+            runningStatus = 0;
+            continue;
+        }
+        UInt8 data1;
+        if (status < 0x80) {
+            if (runningStatus == 0)
+                return false;
+            data1 = status;
+            status = runningStatus;
+        } else {
+            if (status >= 0xF0)		// system common messages have no place in a file
+                return false;
+            runningStatus = status;
+            data1 = ioTrack.Byte();
+        }
+        const UInt8 type = status & 0xF0;
+        UInt8 data2 = (type == 0xC0 || type == 0xD0) ? 0 : ioTrack.Byte();
+        MidiTrackEvent event = { tick, 0, status, data1, data2 };
+        ioEvents.push_back(event);
+    }
+    return ioTrack.OK();
+}
+
+// the channel messages of every track of the file, in order, timed in frames at inSampleRate
+static bool ReadMidiFile(const char *inPath, Float64 inSampleRate, std::vector<MidiFileEvent> &outEvents)
+{
+    std::vector<UInt8> data;
+    if (!ReadFile(inPath, data)) {
+        fprintf(stderr, "SinSynthRegression: cannot read %s\n", inPath);
+        return false;
+    }
+    MidiFileReader file(data.data(), data.data() + data.size());
+    if (file.Big(4) != 'MThd') {
+        fprintf(stderr, "SinSynthRegression: %s is not a MIDI file\n", inPath);
+        return false;
+    }
+    UInt32 headerLength = file.Big(4);
+    UInt32 format = file.Big(2);
+    UInt32 numTracks = file.Big(2);
+    UInt32 division = file.Big(2);
+    file.Skip(headerLength - std::min<UInt32>(headerLength, 6));
+    if (!file.OK() || format > 1 || division == 0) {
+        fprintf(stderr, "SinSynthRegression: %s is not a MIDI file of format 0 or 1\n", inPath);
+        return false;
+    }
+
+    // every track's events, one track after another; a stable sort by tick keeps each track's order,
+    // and a tempo change in the first track ahead of the other tracks' events at its tick
+    std::vector<MidiTrackEvent> events;
+    for (UInt32 track = 0; track < numTracks && !file.AtEnd(); ) {
+        UInt32 type = file.Big(4);
+        UInt32 length = file.Big(4);
+        if (!file.OK())
+            break;
+        const UInt8 *start = file.Position();
+        file.Skip(length);
+        if (!file.OK())
+            break;
+        if (type != 'MTrk')
+            continue;
+        MidiFileReader reader(start, start + length);
+        if (!ReadTrack(reader, events)) {
+            fprintf(stderr, "SinSynthRegression: track %u of %s is malformed\n", (unsigned)track, inPath);
+            return false;
+        }
+        track++;
+    }
+    if (!file.OK()) {
+        fprintf(stderr, "SinSynthRegression: %s is truncated\n", inPath);
+        return false;
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const MidiTrackEvent &a, const MidiTrackEvent &b) { return a.mTick < b.mTick; });
+
+    // SMPTE timing has a fixed tick; otherwise a tick is a fraction of a quarter note, whose length
+    // the tempo changes set
+    Float64 secondsPerTick;
+    const bool smpte = (division & 0x8000) != 0;
+    if (smpte)
+        secondsPerTick = 1. / (Float64(-SInt8(division >> 8)) * Float64(division & 0xFF));
+    else
+        secondsPerTick = kDefaultTempo * 1.e-6 / division;
+    outEvents.clear();
+    UInt64 lastTick = 0;
+    Float64 seconds = 0.;
+    for (const MidiTrackEvent &event : events) {
+        seconds += (event.mTick - lastTick) * secondsPerTick;
+        lastTick = event.mTick;
+        if (event.mTempo != 0) {
+            if (!smpte)
+                secondsPerTick = event.mTempo * 1.e-6 / division;
+            continue;
+        }
+        MidiFileEvent message = { UInt64(std::llround(seconds * inSampleRate)), event.mStatus, event.mData1, event.mData2 };
+        outEvents.push_back(message);
+    }
+    return true;
+}
+
+#pragma mark Scans
+
+/*
+ The hub's processing of a scan, from ProcessScan(), without the telemetry, recording, features or
+ modulation bus, none of which SinSynth's voices hear.
+ */
+class ScanFeed
+{
+public:
+    ScanFeed() : mHasPublishedLevel(false), mFirstCapture(0), mHasNext(false), mSampleRate(0.) {}
+
+    bool					Open(const char *inPath, Float64 inSampleRate)
+    {
+        mSampleRate = inSampleRate;
+        mHasPublishedLevel = false;
+        if (!mReader.Open(inPath) || !mReader.Next(mNext)) {
+            fprintf(stderr, "SinSynthRegression: %s is not a scan log, or holds no scans\n", inPath);
+            return false;
+        }
+        mFirstCapture = mNext.mCaptureTime;
+        mHasNext = true;
+        return true;
+    }
+
+    // publishes, in order, every scan of the log due by inFrame
+    void					PublishUntil(UInt64 inFrame, LidarScanSnapshot &ioSnapshot)
+    {
+        while (mHasNext && NextFrame() <= inFrame) {
+            Publish(mNext, ioSnapshot);
+            mHasNext = mReader.Next(mNext);
+        }
+    }
+
+private:
+    UInt64					NextFrame() const
+    {
+        UInt64 elapsed = mNext.mCaptureTime > mFirstCapture ? mNext.mCaptureTime - mFirstCapture : 0;
+        return UInt64(std::llround(elapsed * 1.e-9 * mSampleRate));
+    }
+
+    void					Publish(const ScanLogBlock &inBlock, LidarScanSnapshot &ioSnapshot)
+    {
+        mFilter.Process(inBlock.mAngle, inBlock.mDistance, inBlock.mSignalStrength, inBlock.mNumSamples);
+        mBuilder.Begin();
+        mBuilder.AddSamples(mFilter.Angles(), mFilter.Distances(), mFilter.NumSamples());
+        if (!mBuilder.Finish(mTable))
+            return;
+        if (mHasPublishedLevel && ScanTableChange(mTable.mLevel[0], mPublishedLevel, mTable.Size()) < kChangeThreshold)
+            return;
+        mMipMap.Build(mTable);
+        ComputeScanStatistics(mFilter.Distances(), mFilter.NumSamples(), kScanMaxDistance, mTable.mStats);
+        std::copy(mTable.mLevel[0], mTable.mLevel[0] + mTable.Size(), mPublishedLevel);
+        mHasPublishedLevel = true;
+
+        mTable.mCaptureTime = kFirstCaptureTime + (inBlock.mCaptureTime - std::min(inBlock.mCaptureTime, mFirstCapture));
+        LidarScanZones &zones = ioSnapshot.WriteBuffer();
+        zones.mNumTables = 1;
+        zones.mTables[kFullScanTable] = mTable;
+        ioSnapshot.Publish();
+    }
+
+    ScanLogReader			mReader;
+    ScanQualityFilter		mFilter;
+    ScanTableBuilder		mBuilder;
+    ScanMipMapBuilder		mMipMap;
+    LidarScanTable			mTable;
+    Float32					mPublishedLevel[1U << kScanTableDefaultBits];
+    bool					mHasPublishedLevel;
+    UInt64					mFirstCapture;
+    ScanLogBlock			mNext;
+    bool					mHasNext;
+    Float64					mSampleRate;
+};
+
+#pragma mark Golden render and baseline
+
+static void PutLittle(std::vector<UInt8> &ioData, UInt32 inValue, UInt32 inBytes)
+{
+    for (UInt32 i = 0; i < inBytes; ++i)
+        ioData.push_back(UInt8(inValue >> (8 * i)));
+}
+
+static void PutTag(std::vector<UInt8> &ioData, const char *inTag)
+{
+    ioData.insert(ioData.end(), inTag, inTag + 4);
+}
+
+static bool IsTag(const UInt8 *inData, const char *inTag)
+{
+    return memcmp(inData, inTag, 4) == 0;
+}
+
+static UInt32 GetLittle(const UInt8 *inData, UInt32 inBytes)
+{
+    UInt32 value = 0;
+    for (UInt32 i = 0; i < inBytes; ++i)
+        value |= UInt32(inData[i]) << (8 * i);
+    return value;
+}
+
+// interleaved samples as a 32-bit float WAV file
+static bool WriteWaveFile(const char *inPath, const std::vector<Float32> &inSamples, UInt32 inNumChannels, Float64 inSampleRate)
+{
+    const UInt32 dataBytes = UInt32(inSamples.size() * sizeof(Float32));
+    std::vector<UInt8> data;
+    data.reserve(58 + dataBytes);
+    PutTag(data, "RIFF");
+    PutLittle(data, 50 + dataBytes, 4);
+    PutTag(data, "WAVE");
+    PutTag(data, "fmt ");
+    PutLittle(data, 18, 4);
+    PutLittle(data, kWaveFormatFloat, 2);
+    PutLittle(data, inNumChannels, 2);
+    PutLittle(data, UInt32(inSampleRate), 4);
+    PutLittle(data, UInt32(inSampleRate) * inNumChannels * sizeof(Float32), 4);
+    PutLittle(data, inNumChannels * sizeof(Float32), 2);
+    PutLittle(data, 32, 2);
+    PutLittle(data, 0, 2);
+    PutTag(data, "fact");
+    PutLittle(data, 4, 4);
+    PutLittle(data, UInt32(inSamples.size() / inNumChannels), 4);
+    PutTag(data, "data");
+    PutLittle(data, dataBytes, 4);
+    for (Float32 sample : inSamples) {
+        UInt32 bits;
+        memcpy(&bits, &sample, sizeof(bits));
+        PutLittle(data, bits, 4);
+    }
+    return WriteFile(inPath, data);
+}
+
+static bool ReadWaveFile(const char *inPath, std::vector<Float32> &outSamples, UInt32 &outNumChannels, Float64 &outSampleRate)
+{
+    std::vector<UInt8> data;
+    if (!ReadFile(inPath, data) || data.size() < 12 || !IsTag(&data[0], "RIFF") || !IsTag(&data[8], "WAVE"))
+        return false;
+    bool hasFormat = false;
+    for (size_t pos = 12; pos + 8 <= data.size(); ) {
+        const UInt8 *tag = &data[pos];
+        const UInt32 size = GetLittle(&data[pos + 4], 4);
+        pos += 8;
+        if (size > data.size() - pos)
+            return false;
+        if (IsTag(tag, "fmt ") && size >= 16) {
+            if (GetLittle(&data[pos], 2) != kWaveFormatFloat || GetLittle(&data[pos + 14], 2) != 32)
+                return false;
+            outNumChannels = GetLittle(&data[pos + 2], 2);
+            outSampleRate = GetLittle(&data[pos + 4], 4);
+            hasFormat = outNumChannels > 0;
+        } else if (IsTag(tag, "data") && hasFormat) {
+            outSamples.resize(size / sizeof(Float32));
+            for (size_t i = 0; i < outSamples.size(); ++i) {
+                UInt32 bits = GetLittle(&data[pos + i * sizeof(Float32)], 4);
+                memcpy(&outSamples[i], &bits, sizeof(bits));
+            }
+            return true;
+        }
+        pos += size + (size & 1);
+    }
+    return false;
+}
+
+// what the timings are judged on; the rest are printed
+static const Float64 kJudgedPercentiles[] = { 0.5, 0.9, 0.99 };
+static const char * const kJudgedNames[] = { "p50", "p90", "p99" };
+static const UInt32 kNumJudgedPercentiles = 3;
+
+struct CycleTimes
+{
+    Float64					mJudged[kNumJudgedPercentiles];		// microseconds
+    Float64					mP999;
+    Float64					mMax;
+};
+
+static Float64 Percentile(const std::vector<UInt64> &inSorted, Float64 inFraction)
+{
+    size_t index = size_t(inFraction * (inSorted.size() - 1) + 0.5);
+    return CAHostTimeBase::ConvertToNanos(inSorted[index]) * 1.0e-3;
+}
+
+// "key value" lines; the settings must match for the times to compare
+static bool WriteBaseline(const char *inPath, const RegressionOptions &inOptions, const CycleTimes &inTimes)
+{
+    FILE *file = fopen(inPath, "w");
+    if (file == NULL)
+        return false;
+    fprintf(file, "# SinSynthRegression cycle times, microseconds\n");
+    fprintf(file, "frames %u\nsample-rate %.0f\npolyphony %u\nworkers %u\nengine %u\nchannels %u\noversampling %u\n",
+            (unsigned)inOptions.mFrames, inOptions.mSampleRate, (unsigned)inOptions.mPolyphony, (unsigned)inOptions.mNumWorkers,
+            (unsigned)inOptions.mEngine, (unsigned)inOptions.mNumChannels, (unsigned)inOptions.mOversampling);
+    for (UInt32 i = 0; i < kNumJudgedPercentiles; ++i)
+        fprintf(file, "%s %.3f\n", kJudgedNames[i], inTimes.mJudged[i]);
+    fprintf(file, "p99.9 %.3f\nmax %.3f\n", inTimes.mP999, inTimes.mMax);
+    return fclose(file) == 0;
+}
+
+static bool ReadBaseline(const char *inPath, const RegressionOptions &inOptions, CycleTimes &outTimes)
+{
+    FILE *file = fopen(inPath, "r");
+    if (file == NULL) {
+        fprintf(stderr, "SinSynthRegression: cannot read the baseline %s\n", inPath);
+        return false;
+    }
+    std::map<std::string, Float64> values;
+    char line[256], key[64];
+    double value;
+    while (fgets(line, sizeof(line), file))
+        if (line[0] != '#' && sscanf(line, "%63s %lf", key, &value) == 2)
+            values[key] = value;
+    fclose(file);
+
+    const Float64 settings[] = { Float64(inOptions.mFrames), inOptions.mSampleRate, Float64(inOptions.mPolyphony),
+                                 Float64(inOptions.mNumWorkers), Float64(inOptions.mEngine), Float64(inOptions.mNumChannels),
+                                 Float64(inOptions.mOversampling) };
+    const char * const settingNames[] = { "frames", "sample-rate", "polyphony", "workers", "engine", "channels", "oversampling" };
+    for (UInt32 i = 0; i < sizeof(settings) / sizeof(settings[0]); ++i) {
+        if (values.count(settingNames[i]) == 0 || std::fabs(values[settingNames[i]] - settings[i]) > 0.5) {
+            fprintf(stderr, "SinSynthRegression: the baseline %s was recorded with another %s\n", inPath, settingNames[i]);
+            return false;
+        }
+    }
+    for (UInt32 i = 0; i < kNumJudgedPercentiles; ++i) {
+        if (values.count(kJudgedNames[i]) == 0 || !(values[kJudgedNames[i]] > 0.)) {
+            fprintf(stderr, "SinSynthRegression: the baseline %s has no %s\n", inPath, kJudgedNames[i]);
+            return false;
+        }
+        outTimes.mJudged[i] = values[kJudgedNames[i]];
+    }
+    outTimes.mP999 = values["p99.9"];
+    outTimes.mMax = values["max"];
+    return true;
+}
+
+// dB; infinite if the render matches bit for bit. A render of another length has no ratio.
+static Float64 SignalToNoise(const std::vector<Float32> &inGolden, const std::vector<Float32> &inRender)
+{
+    if (inGolden.size() != inRender.size())
+        return -std::numeric_limits<Float64>::infinity();
+    Float64 signal = 0., noise = 0.;
+    for (size_t i = 0; i < inGolden.size(); ++i) {
+        const Float64 difference = Float64(inRender[i]) - inGolden[i];
+        signal += Float64(inGolden[i]) * inGolden[i];
+        noise += difference * difference;
+    }
+    if (noise == 0.)
+        return std::numeric_limits<Float64>::infinity();
+    return signal > 0. ? 10. * std::log10(signal / noise) : -std::numeric_limits<Float64>::infinity();
+}
+
+#pragma mark Render
+
+static OSStatus SetUInt32Property(SinSynth &inSynth, AudioUnitPropertyID inID, UInt32 inValue)
+{
+    return inSynth.DispatchSetProperty(inID, kAudioUnitScope_Global, 0, &inValue, sizeof(inValue));
+}
+
+// one render of the whole piece into outSamples, interleaved, with the time of every cycle in host ticks
+static OSStatus Render(const RegressionOptions &inOptions, const std::vector<MidiFileEvent> &inEvents, UInt64 inNumFrames,
+                       ScanFeed &ioScans, std::vector<Float32> &outSamples, std::vector<UInt64> &outCycleTimes)
+{
+    if (!ioScans.Open(inOptions.mScanPath.c_str(), inOptions.mSampleRate))
+        return -1;
+
+    ComponentBase::sNewInstanceType = ComponentBase::kAudioComponentInstance;
+    SinSynth *synth = new SinSynth(NULL);
+    synth->PostConstructor();
+    // from here on the scans come only from ioScans, and this thread is the snapshot's one producer
+    synth->DeviceHub().RemoveSubscriber(&synth->ScanSnapshot());
+
+    AudioStreamBasicDescription format;
+    OSStatus err = synth->DispatchGetProperty(kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format);
+    format.mSampleRate = inOptions.mSampleRate;
+    format.mChannelsPerFrame = inOptions.mNumChannels;
+    const UInt32 frames = inOptions.mFrames;
+    if (!err) err = synth->DispatchSetProperty(kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &format, sizeof(format));
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitProperty_MaximumFramesPerSlice, frames);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_Polyphony, inOptions.mPolyphony);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_RenderWorkers, inOptions.mNumWorkers);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_OscillatorEngine, inOptions.mEngine);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_ScanTransitionFrames, inOptions.mTransitionFrames);
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_Oversampling, inOptions.mOversampling);
+    // shedding follows the machine's load, which no two runs share
+    if (!err) err = SetUInt32Property(*synth, kAudioUnitCustomProperty_LoadShedding, 0);
+    if (!err) err = synth->DoInitialize();
+    if (err) {
+        fprintf(stderr, "SinSynthRegression: cannot set up the synth: %d\n", (int)err);
+        synth->PreDestructor();
+        delete synth;
+        return err;
+    }
+
+    const UInt32 numChannels = inOptions.mNumChannels;
+    std::vector<Float32> buffers(numChannels * frames);
+    std::vector<UInt8> bufferListMemory(offsetof(AudioBufferList, mBuffers) + numChannels * sizeof(AudioBuffer));
+    AudioBufferList &bufferList = *(AudioBufferList *)bufferListMemory.data();
+    outSamples.assign(inNumFrames * numChannels, 0.f);
+    outCycleTimes.clear();
+    outCycleTimes.reserve(size_t(inNumFrames / frames));
+
+    AudioTimeStamp timeStamp;
+    memset(&timeStamp, 0, sizeof(timeStamp));
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid;
+
+    size_t nextEvent = 0;
+    for (UInt64 sampleTime = 0; sampleTime < inNumFrames && !err; sampleTime += frames) {
+        ioScans.PublishUntil(sampleTime, synth->ScanSnapshot());
+        for (; nextEvent < inEvents.size() && inEvents[nextEvent].mFrame < sampleTime + frames; ++nextEvent) {
+            const MidiFileEvent &event = inEvents[nextEvent];
+            synth->MIDIEvent(event.mStatus, event.mData1, event.mData2,
+                             UInt32(event.mFrame > sampleTime ? event.mFrame - sampleTime : 0));
+        }
+
+        bufferList.mNumberBuffers = numChannels;
+        for (UInt32 ch = 0; ch < numChannels; ++ch) {
+            bufferList.mBuffers[ch].mNumberChannels = 1;
+            bufferList.mBuffers[ch].mDataByteSize = frames * sizeof(Float32);
+            bufferList.mBuffers[ch].mData = &buffers[ch * frames];
+        }
+        timeStamp.mSampleTime = Float64(sampleTime);
+        timeStamp.mHostTime = CAHostTimeBase::GetTheCurrentTime();
+
+        AudioUnitRenderActionFlags flags = 0;
+        UInt64 start = CAHostTimeBase::GetTheCurrentTime();
+        err = synth->DoRender(flags, timeStamp, 0, frames, bufferList);
+        outCycleTimes.push_back(CAHostTimeBase::GetTheCurrentTime() - start);
+
+        const UInt64 numFrames = std::min<UInt64>(frames, inNumFrames - sampleTime);
+        for (UInt32 ch = 0; ch < numChannels; ++ch) {
+            const Float32 *channel = (const Float32 *)bufferList.mBuffers[ch].mData;
+            for (UInt64 i = 0; i < numFrames; ++i)
+                outSamples[(sampleTime + i) * numChannels + ch] = channel[i];
+        }
+    }
+    if (err)
+        fprintf(stderr, "SinSynthRegression: render failed: %d\n", (int)err);
+
+    synth->PreDestructor();
+    delete synth;
+    return err;
+}
+
+#pragma mark Daemon tables of another size
+
+enum CheckResult
+{
+    kCheck_Failed = 0,
+    kCheck_Passed = 1,
+    kCheck_Skipped = 2		// a daemon owns the ring
+};
+
+static const UInt32 kCheckSamples = 720;			// half a degree apart
+static const UInt64 kCheckTimeoutNanos = 2000000000ULL;
+
+// a room of three lobes, with inBump cm more on every eighth sample
+static void MakeCheckScan(std::int32_t inBump, std::vector<std::int32_t> &outAngles, std::vector<std::int32_t> &outDistances)
+{
+    outAngles.resize(kCheckSamples);
+    outDistances.resize(kCheckSamples);
+    for (UInt32 i = 0; i < kCheckSamples; ++i) {
+        outAngles[i] = std::int32_t(i * (kScanFullCircle / kCheckSamples));
+        outDistances[i] = std::int32_t(std::lrint(400. + 150. * std::sin(3. * 2. * M_PI * i / kCheckSamples)))
+                          + (i % 8 == 0 ? inBump : 0);
+    }
+}
+
+// writes one scan into the ring as the daemon does, binned at inBits, and waits until the hub has taken it
+static bool PublishDaemonScan(LidarScanRingWriter &ioRing, LidarDeviceHub &inHub, UInt32 inBits, std::int32_t inBump,
+                              UInt64 inCaptureTime, UInt64 inNumScans)
+{
+    std::vector<std::int32_t> angles, distances;
+    MakeCheckScan(inBump, angles, distances);
+    ScanTableBuilder builder(inBits);
+    ScanMipMapBuilder mipMap(inBits);
+    LidarScanTable table(inBits);
+    builder.Begin();
+    builder.AddSamples(angles.data(), distances.data(), kCheckSamples);
+    if (!builder.Finish(table))
+        return false;
+    mipMap.Build(table);
+    ComputeScanStatistics(distances.data(), kCheckSamples, kScanMaxDistance, table.mStats);
+    table.mCaptureTime = inCaptureTime;
+    ioRing.Publish(table, angles.data(), distances.data(), NULL, kCheckSamples);
+
+    const UInt64 deadline = CAHostTimeBase::GetCurrentTimeInNanos() + kCheckTimeoutNanos;
+    for (UInt64 now = 0; (now = CAHostTimeBase::GetCurrentTimeInNanos()) < deadline; ) {
+        ioRing.SetState(kLidarState_Streaming, now);
+        LidarIngestStatistics statistics;
+        inHub.GetIngestStatistics(statistics);
+        if (statistics.mNumScans >= inNumScans)
+            return true;
+        usleep(5000);
+    }
+    return false;
+}
+
+/*
+ A daemon's table of another size than the hub's is binned again from its samples, and can then be
+ too like the last one to be published. The hub must go back to the table it published, every level
+ of it, rather than keep the new scan's level 0 over the levels of the daemon's table. The check
+ runs the hub's daemon path for real: it plays the daemon on the ring, at one bit more than the
+ hub's resolution, sends a scan and then one a few centimetres off, and compares the table the hub
+ leaves in its cache on stopping with the one it published. It needs the ring to itself, so it is
+ skipped while a daemon runs, and it keeps the hub off the view and away from the user's cache.
+ */
+static CheckResult CheckDaemonRebin()
+{
+    static const char * const kSources[] = { "LIDARSYNTH_REPLAY", "LIDARSYNTH_ENDPOINT", "LIDARSYNTH_TABLES", "LIDARSYNTH_DEVICES",
+                                             "LIDARSYNTH_SYNTHETIC", "LIDARSYNTH_CONFIG", "LIDARSYNTH_CHANGE_THRESHOLD",
+                                             "LIDARSYNTH_LINGER", "LIDARSYNTH_PUBLISH", "LIDARSYNTH_PUBLISH_SCANS", "LIDARSYNTH_RECORD" };
+    for (const char *name : kSources)
+        unsetenv(name);
+    setenv("LIDARSYNTH_DAEMON", "1", 1);
+    setenv("LIDARSYNTH_VIEW", "0", 1);
+    char cachePath[64];
+    snprintf(cachePath, sizeof(cachePath), "/tmp/SinSynthRegression.%d.lastscan", (int)getpid());
+    unlink(cachePath);
+    setenv("LIDARSYNTH_CACHE", cachePath, 1);
+
+    LidarScanRingWriter ring;
+    if (!ring.Create())
+        return kCheck_Skipped;
+    ring.SetState(kLidarState_Streaming, CAHostTimeBase::GetCurrentTimeInNanos());
+
+    const UInt32 hubBits = kScanTableDefaultBits;
+    const UInt32 daemonBits = hubBits < kScanTableMaxBits ? hubBits + 1 : hubBits - 1;
+    LidarDeviceHub *hub = LidarDeviceHub::Acquire();
+    hub->SetTableBits(hubBits);
+    LidarScanTable published;
+    LidarIngestStatistics statistics;
+    bool ok = PublishDaemonScan(ring, *hub, daemonBits, 0, kFirstCaptureTime, 1)
+              && PublishDaemonScan(ring, *hub, daemonBits, 1, kFirstCaptureTime + 100000000, 2)
+              && hub->CopyLastTable(published);
+    hub->GetIngestStatistics(statistics);
+    hub->Release();
+    ring.Close();
+    unsetenv("LIDARSYNTH_DAEMON");
+    unsetenv("LIDARSYNTH_VIEW");
+    if (!ok || statistics.mNumUnchangedScans != 1) {
+        fprintf(stderr, "SinSynthRegression: the hub did not take the daemon's scans as expected\n");
+        unlink(cachePath);
+        return kCheck_Failed;
+    }
+
+    ScanCache cache;
+    LidarScanTable cached;
+    ok = cache.Load(cached) && cached.Bits() == hubBits && published.Bits() == hubBits
+         && cached.mStats.mMean == published.mStats.mMean;
+    for (UInt32 level = 0; ok && level < cached.Levels(); ++level)
+        ok = !memcmp(cached.mLevel[level], published.mLevel[level], cached.Size() * sizeof(Float32))
+             && !memcmp(cached.mSpectrum[level], published.mSpectrum[level], cached.Size() * sizeof(Float32));
+    unlink(cachePath);
+    return ok ? kCheck_Passed : kCheck_Failed;
+}
+
+int main(int argc, const char * argv[])
+{
+    RegressionOptions options = ParseOptions(argc, argv);
+
+    std::vector<MidiFileEvent> events;
+    if (!ReadMidiFile(options.mMidiPath.c_str(), options.mSampleRate, events))
+        return 1;
+    const UInt64 numFrames = (events.empty() ? 0 : events.back().mFrame)
+                             + UInt64(std::ceil(options.mTailSeconds * options.mSampleRate));
+    if (numFrames == 0) {
+        fprintf(stderr, "SinSynthRegression: nothing to render\n");
+        return 1;
+    }
+
+    // before any render, since it needs a hub of its own, which stops before the renders' starts
+    const CheckResult daemonCheck = CheckDaemonRebin();
+    printf("SinSynthRegression: daemon tables of another size %s
+",
+           daemonCheck == kCheck_Passed ? "PASS" : daemonCheck == kCheck_Failed ? "FAIL" : "skipped, a daemon is running");
+
+    // the hub reads the environment when its ingest thread starts, with the first SinSynth. An
+    // empty replay keeps it from opening the sensor or the daemon, and without the cache it never
+    // has a table to hand a new subscriber.
+    setenv("LIDARSYNTH_REPLAY", "/dev/null", 1);
+    setenv("LIDARSYNTH_CACHE", "0", 1);
+
+    std::vector<Float32> golden;
+    UInt32 goldenChannels = 0;
+    Float64 goldenRate = 0.;
+    bool hasGolden = false;
+    if (!options.mRecord) {
+        hasGolden = ReadWaveFile(options.mGoldenPath.c_str(), golden, goldenChannels, goldenRate);
+        if (!hasGolden)
+            fprintf(stderr, "SinSynthRegression: cannot read the golden render %s\n", options.mGoldenPath.c_str());
+        else if (goldenChannels != options.mNumChannels || goldenRate != Float64(UInt32(options.mSampleRate))) {
+            fprintf(stderr, "SinSynthRegression: the golden render has %u channels at %.0f Hz\n", (unsigned)goldenChannels, goldenRate);
+            hasGolden = false;
+        }
+    }
+
+    printf("SinSynth: %s with scans from %s, %.1f s at %.0f Hz, %u frames, %u voices, %u workers, %s engine, %u runs\n",
+           options.mMidiPath.c_str(), options.mScanPath.c_str(), numFrames / options.mSampleRate, options.mSampleRate,
+           (unsigned)options.mFrames, (unsigned)options.mPolyphony, (unsigned)options.mNumWorkers,
+           options.mEngine == kOscillatorEngine_Spectral ? "spectral" : "waveform", (unsigned)options.mRuns);
+
+    ScanFeed *scans = new ScanFeed;
+    std::vector<Float32> samples, firstSamples;
+    std::vector<UInt64> cycleTimes;
+    CycleTimes best;
+    Float64 worstSNR = std::numeric_limits<Float64>::infinity();
+    for (UInt32 run = 0; run < options.mRuns; ++run) {
+        if (Render(options, events, numFrames, *scans, samples, cycleTimes) != noErr) {
+            delete scans;
+            return 1;
+        }
+        std::sort(cycleTimes.begin(), cycleTimes.end());
+        for (UInt32 i = 0; i < kNumJudgedPercentiles; ++i) {
+            Float64 time = Percentile(cycleTimes, kJudgedPercentiles[i]);
+            best.mJudged[i] = run == 0 ? time : std::min(best.mJudged[i], time);
+        }
+        best.mP999 = run == 0 ? Percentile(cycleTimes, 0.999) : std::min(best.mP999, Percentile(cycleTimes, 0.999));
+        best.mMax = run == 0 ? Percentile(cycleTimes, 1.) : std::min(best.mMax, Percentile(cycleTimes, 1.));
+
+        // recording, the first run is the golden one and the others must agree with it
+        const std::vector<Float32> &reference = options.mRecord ? firstSamples : golden;
+        if (options.mRecord && run == 0)
+            firstSamples = samples;
+        else if (!options.mRecord || run > 0)
+            worstSNR = std::min(worstSNR, SignalToNoise(reference, samples));
+    }
+    delete scans;
+
+    printf("    cycle us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f  (best of %u runs)\n",
+           best.mJudged[0], best.mJudged[1], best.mJudged[2], best.mP999, best.mMax, (unsigned)options.mRuns);
+
+    if (options.mRecord) {
+        if (worstSNR < options.mMinSNR)
+            fprintf(stderr, "SinSynthRegression: the runs disagree by %.1f dB SNR; the render is not deterministic\n", worstSNR);
+        if (!WriteWaveFile(options.mGoldenPath.c_str(), firstSamples, options.mNumChannels, options.mSampleRate)
+            || !WriteBaseline(options.mBaselinePath.c_str(), options, best)) {
+            fprintf(stderr, "SinSynthRegression: cannot write %s or %s\n", options.mGoldenPath.c_str(), options.mBaselinePath.c_str());
+            return 1;
+        }
+        printf("SinSynthRegression: recorded %s and %s\n", options.mGoldenPath.c_str(), options.mBaselinePath.c_str());
+        return worstSNR < options.mMinSNR || daemonCheck == kCheck_Failed ? 1 : 0;
+    }
+
+    const bool qualityPass = hasGolden && worstSNR >= options.mMinSNR;
+    char quality[128];
+    if (!hasGolden)
+        snprintf(quality, sizeof(quality), "no golden render");
+    else if (std::isinf(worstSNR) && worstSNR > 0)
+        snprintf(quality, sizeof(quality), "identical");
+    else if (golden.size() != samples.size())
+        snprintf(quality, sizeof(quality), "%zu frames, golden %zu", samples.size() / options.mNumChannels,
+                 golden.size() / options.mNumChannels);
+    else
+        snprintf(quality, sizeof(quality), "SNR %.1f dB, minimum %.1f", worstSNR, options.mMinSNR);
+
+    CycleTimes baseline;
+    bool performancePass = ReadBaseline(options.mBaselinePath.c_str(), options, baseline);
+    std::string performance;
+    if (performancePass) {
+        char change[64];
+        for (UInt32 i = 0; i < kNumJudgedPercentiles; ++i) {
+            const Float64 ratio = best.mJudged[i] / baseline.mJudged[i];
+            performancePass = performancePass && ratio <= 1. + options.mMaxSlowdown;
+            snprintf(change, sizeof(change), "%s%s %+.1f%%", i ? ", " : "", kJudgedNames[i], (ratio - 1.) * 100.);
+            performance += change;
+        }
+        snprintf(change, sizeof(change), ", allowed %+.1f%%", options.mMaxSlowdown * 100.);
+        performance += change;
+    } else
+        performance = "no comparable baseline";
+
+    const bool pass = qualityPass && performancePass && daemonCheck != kCheck_Failed;
+    printf("SinSynthRegression: quality %s (%s)  performance %s (%s)  => %s\n", qualityPass ? "PASS" : "FAIL", quality,
+           performancePass ? "PASS" : "FAIL", performance.c_str(), pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
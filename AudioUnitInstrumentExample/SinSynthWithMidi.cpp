@@ -10,13 +10,19 @@
  This is a subclass of SinSynth that demonstrates how to use the midi output properties kAudioUnitProperty_MIDIOutputCallbackInfo,
  and kAudioUnitProperty_MIDIOutputCallback defined in AudioUnitProperties.h.
  Using these properties, the SinSynthWithMidi simply passes through the midi data it receives. Use of these properties requires host support.
+ It also sends what changes in the LiDAR scan on channel kFeatureMIDIChannel: each sector's nearest
+ return as controller kFeatureFirstController + sector, and an object inside the sector's zone as
+ note kFeatureFirstNote + sector, held while it stays there.
  
  To build a version of the SinSynth with this functionality, activate the "SinSynth with MIDI Output" target in Xcode.
  */
 
 #include "SinSynth.h"
+#include "ScanFeatures.h"
+#include "CAHostTimeBase.h"
 #include <CoreMIDI/CoreMIDI.h>
-#include <vector>
+#include <algorithm>
+#include <atomic>
 
 typedef struct MIDIMessageInfoStruct {
     UInt8	status;
@@ -26,22 +32,25 @@ typedef struct MIDIMessageInfoStruct {
     UInt32	startFrame;
 } MIDIMessageInfoStruct;
 
+static const UInt8 kFeatureMIDIChannel = 15;
+static const UInt8 kFeatureFirstController = 20;	// general purpose controllers, one per sector
+static const UInt8 kFeatureFirstNote = 60;
 
+/*
+ MIDIOutputCallbackHelper collects the MIDI events the synth receives and passes them to the host's
+ output callback once per render cycle. The events go through a fixed single-producer,
+ single-consumer ring, so they may arrive on another thread than the render thread. Nothing here
+ allocates, recurses or prints: a full ring drops the event and counts it, and a full packet list
+ is sent and started again in the same loop.
+ */
 class MIDIOutputCallbackHelper 
 {
-    enum  { kSizeofMIDIBuffer = 512 };
+    enum  { kSizeofMIDIBuffer = 512, kMIDIEventRingSize = 256 };
     
 public:
-    MIDIOutputCallbackHelper()
+    MIDIOutputCallbackHelper() : mMIDIMessageRing(kMIDIEventRingSize), mDroppedEvents(0), mLastCallbackError(noErr)
     {
-        mMIDIMessageList.reserve (64);
         mMIDICallbackStruct.midiOutputCallback = NULL;
-        mMIDIBuffer = new Byte[kSizeofMIDIBuffer];
-    }
-    
-    ~MIDIOutputCallbackHelper()
-    {
-        delete [] mMIDIBuffer;
     }
     
     void SetCallbackInfo (AUMIDIOutputCallback & callback, void *userData)
@@ -56,8 +65,14 @@ public:
                                           UInt8		data2,
                                           UInt32		inStartFrame );
     
-    void FireAtTimeStamp(const AudioTimeStamp &inTimeStamp);
+    // inExtra are events of the render thread's own, in startFrame order, merged with the queued ones
+    void FireAtTimeStamp(const AudioTimeStamp &inTimeStamp,
+                         const MIDIMessageInfoStruct *inExtra = NULL, UInt32 inNumExtra = 0);
     
+    // events lost to a full ring, and the last error the callback returned, for debugging off the render thread
+    UInt32 DroppedEvents() const { return mDroppedEvents.load(std::memory_order_relaxed); }
+    UInt32 QueuedEvents() const { return mMIDIMessageRing.ApproximateItems(); }
+    OSStatus LastCallbackError() const { return mLastCallbackError.load(std::memory_order_relaxed); }
     
 private:
     MIDIPacketList		  * PacketList()
@@ -65,13 +80,16 @@ private:
         return (MIDIPacketList *)mMIDIBuffer;
     }
     
+    void SendPacketList(const AudioTimeStamp &inTimeStamp);
+    MIDIPacket *AddPacket(const AudioTimeStamp &inTimeStamp, MIDIPacket *inPacket, const MIDIMessageInfoStruct &inItem);
     
-    Byte *						mMIDIBuffer;
+    alignas(8) Byte				mMIDIBuffer[kSizeofMIDIBuffer];
     
     AUMIDIOutputCallbackStruct	mMIDICallbackStruct;
     
-    typedef std::vector<MIDIMessageInfoStruct> MIDIMessageList;
-    MIDIMessageList				mMIDIMessageList;
+    LockFreeFIFO<MIDIMessageInfoStruct> mMIDIMessageRing;
+    std::atomic<UInt32>			mDroppedEvents;
+    std::atomic<OSStatus>		mLastCallbackError;
 };
 
 class SinSynthWithMidi : public SinSynth {
@@ -102,13 +120,24 @@ public:
                              UInt8							data2,
                              UInt32							inStartFrame);
     
+    OSStatus HandleMidiEvents(const AUMIDIEvent *inEvents, UInt32 inNumEvents);
+    
     OSStatus Render(AudioUnitRenderActionFlags &	ioActionFlags,
                     const AudioTimeStamp &			inTimeStamp,
                     UInt32							inNumberFrames);
     
+    virtual void GetSynthStats(SynthStatsInstance &outStats);
+    
+protected:
+    // the feature queue follows the scans to the offline hub and back
+    virtual void SwitchDeviceHub(LidarDeviceHub *inHub);
+    
 private:
+    UInt32 TakeFeatureEvents(const AudioTimeStamp &inTimeStamp, UInt32 inNumberFrames, MIDIMessageInfoStruct *outEvents);
+    
     MIDIOutputCallbackHelper	mCallbackHelper;
-    TestNote					mTestNotes[kNumNotes];
+    ScanFeatureQueue			mFeatureQueue;
+    UInt64						mLastRenderNanos;	// host time of the previous render call, 0 before the first one
 };
 
 #pragma mark MIDIOutputCallbackHelper Methods
@@ -121,57 +150,72 @@ void MIDIOutputCallbackHelper::AddMIDIEvent(UInt8	status,
                                             UInt8		data2,
                                             UInt32		inStartFrame)
 {
-    MIDIMessageInfoStruct info = {status, channel, data1, data2, inStartFrame};
-    mMIDIMessageList.push_back(info);
+    MIDIMessageInfoStruct *info = mMIDIMessageRing.WriteItem();
+    if (!info) {
+        mDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    MIDIMessageInfoStruct event = {status, channel, data1, data2, inStartFrame};
+    *info = event;
+    mMIDIMessageRing.AdvanceWritePtr();
 }
 
-void MIDIOutputCallbackHelper::FireAtTimeStamp(const AudioTimeStamp &inTimeStamp) 
+void MIDIOutputCallbackHelper::SendPacketList(const AudioTimeStamp &inTimeStamp)
 {
-    if (!mMIDIMessageList.empty())
+    OSStatus result = (*mMIDICallbackStruct.midiOutputCallback) (mMIDICallbackStruct.userData, &inTimeStamp, 0, PacketList());
+    if (result != noErr)
+        mLastCallbackError.store(result, std::memory_order_relaxed);
+}
+
+MIDIPacket *MIDIOutputCallbackHelper::AddPacket(const AudioTimeStamp &inTimeStamp, MIDIPacket *inPacket, const MIDIMessageInfoStruct &inItem)
+{
+    MIDIPacketList *pktlist = PacketList();
+    Byte midiStatusByte = inItem.status + inItem.channel;
+    const Byte data[3] = { midiStatusByte, inItem.data1, inItem.data2 };
+    // AUMIDIBase hands us the status with the channel masked off
+    UInt32 midiDataCount = ((inItem.status == 0xC0 || inItem.status == 0xD0) ? 2 : 3);
+    MIDIPacket *next = MIDIPacketListAdd (pktlist, kSizeofMIDIBuffer, inPacket, inItem.startFrame, midiDataCount, data);
+    if (!next)
+    {
+        // send what we have, then start the list again with this event
+        SendPacketList(inTimeStamp);
+        inPacket = MIDIPacketListInit(pktlist);
+        next = MIDIPacketListAdd (pktlist, kSizeofMIDIBuffer, inPacket, inItem.startFrame, midiDataCount, data);
+    }
+    return next ? next : MIDIPacketListInit(pktlist);
+}
+
+void MIDIOutputCallbackHelper::FireAtTimeStamp(const AudioTimeStamp &inTimeStamp,
+                                               const MIDIMessageInfoStruct *inExtra, UInt32 inNumExtra)
+{
+    // take everything queued so far; without a callback it is simply dropped
+    UInt32 numEvents = mMIDIMessageRing.ReadableItems();
+    if (!numEvents && !inNumExtra)
+        return;
+    
+    if (mMIDICallbackStruct.midiOutputCallback)
     {
-        if (mMIDICallbackStruct.midiOutputCallback)
+        // synthesize the packet list, and send it whenever it fills up
+        MIDIPacketList *pktlist = PacketList();
+        MIDIPacket *pkt = MIDIPacketListInit(pktlist);
+        
+        UInt32 i = 0, j = 0;
+        while (i < numEvents || j < inNumExtra)
         {
-            // synthesize the packet list and call the MIDIOutputCallback
-            // iterate through the vector and get each item
-            MIDIPacketList *pktlist = PacketList();
-            
-            MIDIPacket *pkt = MIDIPacketListInit(pktlist);
-            
-            for (MIDIMessageList::iterator iter = mMIDIMessageList.begin(); iter != mMIDIMessageList.end(); iter++)
-            {
-                const MIDIMessageInfoStruct & item = *iter;
-                
-                Byte midiStatusByte = item.status + item.channel;
-                const Byte data[3] = { midiStatusByte, item.data1, item.data2 };
-                UInt32 midiDataCount = ((item.status == 0xC || item.status == 0xD) ? 2 : 3);
-                pkt = MIDIPacketListAdd (pktlist,
-                                         kSizeofMIDIBuffer,
-                                         pkt,
-                                         item.startFrame,
-                                         midiDataCount,
-                                         data);
-                if (!pkt)
-                {
-                    // send what we have and then clear the buffer and then go through this again
-                    // issue the callback with what we got
-                    OSStatus result = (*mMIDICallbackStruct.midiOutputCallback) (mMIDICallbackStruct.userData, &inTimeStamp, 0, pktlist);
-                    if (result != noErr)
-                        printf("error calling output callback: %d", (int) result);
-                    
-                    // clear stuff we've already processed, and fire again
-                    mMIDIMessageList.erase (mMIDIMessageList.begin(), iter);
-                    FireAtTimeStamp(inTimeStamp);
-                    return;
-                }
+            const MIDIMessageInfoStruct *queued = i < numEvents ? mMIDIMessageRing.ReadItemAt(i) : NULL;
+            if (queued && (j == inNumExtra || queued->startFrame <= inExtra[j].startFrame)) {
+                pkt = AddPacket(inTimeStamp, pkt, *queued);
+                ++i;
+            } else {
+                pkt = AddPacket(inTimeStamp, pkt, inExtra[j]);
+                ++j;
             }
-            
-            // fire callback
-            OSStatus result = (*mMIDICallbackStruct.midiOutputCallback) (mMIDICallbackStruct.userData, &inTimeStamp, 0, pktlist);
-            if (result != noErr)
-                printf("error calling output callback: %d", (int) result);
         }
-        mMIDIMessageList.clear();
+        
+        if (pktlist->numPackets)
+            SendPacketList(inTimeStamp);
     }
+    mMIDIMessageRing.AdvanceReadPtr(numEvents);
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -187,8 +231,9 @@ AUDIOCOMPONENT_ENTRY(AUMusicDeviceFactory, SinSynthWithMidi)
 // This synth has No inputs, One output
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SinSynthWithMidi::SinSynthWithMidi(AudioUnit inComponentInstance)
-: SinSynth(inComponentInstance)
+: SinSynth(inComponentInstance), mFeatureQueue(kScanFeatureQueueSize), mLastRenderNanos(0)
 {
+    DeviceHub().AddFeatureSubscriber(&mFeatureQueue);
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -196,7 +241,28 @@ SinSynthWithMidi::SinSynthWithMidi(AudioUnit inComponentInstance)
 //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SinSynthWithMidi::~SinSynthWithMidi()
-{}
+{
+    // before the MIDI output goes, not in SinSynth's destructor
+    DeviceHub().RemoveStatsSource(this);
+    DeviceHub().RemoveFeatureSubscriber(&mFeatureQueue);
+}
+
+void SinSynthWithMidi::SwitchDeviceHub(LidarDeviceHub *inHub)
+{
+    DeviceHub().RemoveFeatureSubscriber(&mFeatureQueue);
+    // uninitialized, so the render thread isn't reading; what the old hub sent is on another clock
+    mFeatureQueue.AdvanceReadPtr(mFeatureQueue.ReadableItems());
+    SinSynth::SwitchDeviceHub(inHub);
+    DeviceHub().AddFeatureSubscriber(&mFeatureQueue);
+    mLastRenderNanos = 0;
+}
+
+void SinSynthWithMidi::GetSynthStats(SynthStatsInstance &outStats)
+{
+    SinSynth::GetSynthStats(outStats);
+    outStats.mMIDIOutDepth = mCallbackHelper.QueuedEvents();
+    outStats.mNumDroppedEvents = mCallbackHelper.DroppedEvents();
+}
 
 OSStatus SinSynthWithMidi::GetPropertyInfo(		AudioUnitPropertyID				inID,
                                                       AudioUnitScope					inScope,
@@ -258,19 +324,78 @@ OSStatus SinSynthWithMidi::SetProperty(	AudioUnitPropertyID 			inID,
 
 OSStatus SinSynthWithMidi::HandleMidiEvent(UInt8 status, UInt8 channel, UInt8 data1, UInt8 data2, UInt32 inStartFrame)
 {
-    // snag the midi event and then store it in a vector
+    // snag the midi event and queue it for the output callback
     mCallbackHelper.AddMIDIEvent(status, channel, data1, data2, inStartFrame);
     
     return AUMIDIBase::HandleMidiEvent(status, channel, data1, data2, inStartFrame);
 }
 
+OSStatus SinSynthWithMidi::HandleMidiEvents(const AUMIDIEvent *inEvents, UInt32 inNumEvents)
+{
+    // a packet list's events skip HandleMidiEvent(), so they are snagged here
+    for (UInt32 i = 0; i < inNumEvents; ++i)
+        mCallbackHelper.AddMIDIEvent(inEvents[i].mStatus, inEvents[i].mChannel, inEvents[i].mData1, inEvents[i].mData2,
+                                     inEvents[i].mStartFrame);
+    
+    return SinSynth::HandleMidiEvents(inEvents, inNumEvents);
+}
+
 OSStatus SinSynthWithMidi::Render(   AudioUnitRenderActionFlags &		ioActionFlags,
                                      const AudioTimeStamp &			inTimeStamp,
                                      UInt32							inNumberFrames)
 {
-    OSStatus result = AUInstrumentBase::Render(ioActionFlags, inTimeStamp, inNumberFrames);
+    OSStatus result = SinSynth::Render(ioActionFlags, inTimeStamp, inNumberFrames);
     if (result == noErr) {
-        mCallbackHelper.FireAtTimeStamp(inTimeStamp);
+        MIDIMessageInfoStruct features[kScanFeatureQueueSize];
+        UInt32 numFeatures = TakeFeatureEvents(inTimeStamp, inNumberFrames, features);
+        mCallbackHelper.FireAtTimeStamp(inTimeStamp, features, numFeatures);
     }
     return result;
 }
+
+// Drains the feature queue into MIDI events. A scan captured during the previous render call is
+// placed as far into this one, so the events keep their spacing at one buffer of extra latency.
+UInt32 SinSynthWithMidi::TakeFeatureEvents(const AudioTimeStamp &inTimeStamp, UInt32 inNumberFrames, MIDIMessageInfoStruct *outEvents)
+{
+    // offline, the features' capture times are on the render clock, and so is the cycle
+    UInt64 renderNanos = OfflineRenderNanos();
+    if (renderNanos == 0 && (inTimeStamp.mFlags & kAudioTimeStampHostTimeValid))
+        renderNanos = CAHostTimeBase::ConvertToNanos(inTimeStamp.mHostTime);
+    Float64 framesPerNano = GetSampleRate() * 1.0e-9;
+    
+    UInt32 numEvents = mFeatureQueue.ReadableItems();
+    for (UInt32 i = 0; i < numEvents; ++i) {
+        const ScanFeatureEvent &feature = *mFeatureQueue.ReadItemAt(i);
+        
+        UInt32 startFrame = 0;
+        if (renderNanos && mLastRenderNanos && feature.mCaptureTime > mLastRenderNanos) {
+            Float64 frame = (feature.mCaptureTime - mLastRenderNanos) * framesPerNano;
+            startFrame = UInt32(std::min(frame, Float64(inNumberFrames - 1)));
+        }
+        
+        MIDIMessageInfoStruct &event = outEvents[i];
+        event.channel = kFeatureMIDIChannel;
+        event.startFrame = startFrame;
+        switch (feature.mKind) {
+            case kScanFeature_Nearest:
+                event.status = 0xB0;
+                event.data1 = kFeatureFirstController + feature.mSector;
+                event.data2 = feature.mValue;
+                break;
+            case kScanFeature_ZoneEnter:
+                event.status = 0x90;
+                event.data1 = kFeatureFirstNote + feature.mSector;
+                event.data2 = std::max(feature.mValue, UInt8(1));	// velocity 0 would be a note-off
+                break;
+            default:
+                event.status = 0x80;
+                event.data1 = kFeatureFirstNote + feature.mSector;
+                event.data2 = 0;
+                break;
+        }
+    }
+    mFeatureQueue.AdvanceReadPtr(numEvents);
+    
+    mLastRenderNanos = renderNanos;
+    return numEvents;
+}
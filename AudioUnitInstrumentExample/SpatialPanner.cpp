@@ -0,0 +1,348 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Precomputed panning and Ambisonic encoding gains that place each zone of the LiDAR scan at its angle
+ */
+
+#include "SpatialPanner.h"
+#if __APPLE__
+    #include <AudioToolbox/AudioFormat.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const Float32 kPanLevel = 1.41421356f;	// sqrt(2), the power of a block fanned out to both channels of a stereo output
+static const Float32 kDegrees = 3.14159265f / 180.f;
+static const Float32 kOffRing = -1000.f;		// azimuth of a channel that gets no panned signal
+static const Float32 kFuMaW = 0.70710678f;		// of W in a FuMa B-format encoding
+
+// degrees clockwise from front centre, the usual position of the speaker a label names, or kOffRing
+// for one that has no place on a horizontal ring; false if the label does not say where it is
+static bool LabelAzimuth(AudioChannelLabel inLabel, Float32 &outAzimuth)
+{
+    switch (inLabel) {
+        case kAudioChannelLabel_Center :
+        case kAudioChannelLabel_Mono :				outAzimuth = 0.f; return true;
+        case kAudioChannelLabel_LeftCenter :		outAzimuth = -15.f; return true;
+        case kAudioChannelLabel_RightCenter :		outAzimuth = 15.f; return true;
+        case kAudioChannelLabel_Left :				outAzimuth = -30.f; return true;
+        case kAudioChannelLabel_Right :				outAzimuth = 30.f; return true;
+        case kAudioChannelLabel_LeftWide :			outAzimuth = -60.f; return true;
+        case kAudioChannelLabel_RightWide :			outAzimuth = 60.f; return true;
+        case kAudioChannelLabel_LeftSurroundDirect :	outAzimuth = -90.f; return true;
+        case kAudioChannelLabel_RightSurroundDirect :	outAzimuth = 90.f; return true;
+        case kAudioChannelLabel_LeftSurround :		outAzimuth = -110.f; return true;
+        case kAudioChannelLabel_RightSurround :		outAzimuth = 110.f; return true;
+        case kAudioChannelLabel_RearSurroundLeft :	outAzimuth = -150.f; return true;
+        case kAudioChannelLabel_RearSurroundRight :	outAzimuth = 150.f; return true;
+        case kAudioChannelLabel_CenterSurround :	outAzimuth = 180.f; return true;
+
+        case kAudioChannelLabel_LFEScreen :
+        case kAudioChannelLabel_LFE2 :
+        case kAudioChannelLabel_TopCenterSurround :
+        case kAudioChannelLabel_VerticalHeightLeft :
+        case kAudioChannelLabel_VerticalHeightCenter :
+        case kAudioChannelLabel_VerticalHeightRight :
+        case kAudioChannelLabel_TopBackLeft :
+        case kAudioChannelLabel_TopBackCenter :
+        case kAudioChannelLabel_TopBackRight :		outAzimuth = kOffRing; return true;
+
+        default :									return false;
+    }
+}
+
+// the layouts named for a regular polygon of speakers, with the speakers where the name says
+static bool RingLayoutAzimuths(AudioChannelLayoutTag inTag, Float32 *outAzimuths)
+{
+    static const Float32 kQuadraphonic[] = { -45.f, 45.f, -135.f, 135.f };				// L R Ls Rs
+    static const Float32 kPentagonal[] = { -72.f, 72.f, -144.f, 144.f, 0.f };			// L R Rls Rrs C
+    static const Float32 kHexagonal[] = { -60.f, 60.f, -120.f, 120.f, 0.f, 180.f };		// L R Rls Rrs C Cs
+    static const Float32 kOctagonal[] = { -45.f, 45.f, -135.f, 135.f, 0.f, 180.f, -90.f, 90.f };	// L R Rls Rrs C Cs Ls Rs
+    const Float32 *azimuths;
+    UInt32 count;
+    switch (inTag) {
+        case kAudioChannelLayoutTag_Quadraphonic :	azimuths = kQuadraphonic; count = 4; break;
+        case kAudioChannelLayoutTag_Pentagonal :	azimuths = kPentagonal; count = 5; break;
+        case kAudioChannelLayoutTag_Hexagonal :		azimuths = kHexagonal; count = 6; break;
+        case kAudioChannelLayoutTag_Octagonal :		azimuths = kOctagonal; count = 8; break;
+        default :									return false;
+    }
+    std::copy(azimuths, azimuths + count, outAzimuths);
+    return true;
+}
+
+// the channels inLayout describes
+static UInt32 LayoutChannels(const AudioChannelLayout &inLayout)
+{
+    switch (inLayout.mChannelLayoutTag) {
+        case kAudioChannelLayoutTag_UseChannelDescriptions :	return inLayout.mNumberChannelDescriptions;
+        case kAudioChannelLayoutTag_UseChannelBitmap :			return UInt32(__builtin_popcount(inLayout.mChannelBitmap));
+        default :												return AudioChannelLayoutTag_GetNumberOfChannels(inLayout.mChannelLayoutTag);
+    }
+}
+
+// the azimuth of each of inNumChannels channels of inLayout; false if the layout does not place them all
+static bool SpeakerAzimuths(const AudioChannelLayout &inLayout, UInt32 inNumChannels, Float32 *outAzimuths)
+{
+    AudioChannelLayoutTag tag = inLayout.mChannelLayoutTag;
+    if (RingLayoutAzimuths(tag, outAzimuths))
+        return true;
+
+    // anything but a list of descriptions is expanded into one, where Audio Toolbox can; elsewhere
+    // the layout gets an even ring
+    std::vector<char> expanded;
+    const AudioChannelLayout *layout = &inLayout;
+    if (tag != kAudioChannelLayoutTag_UseChannelDescriptions) {
+#if __APPLE__
+        AudioFormatPropertyID property = kAudioFormatProperty_ChannelLayoutForTag;
+        UInt32 specifierSize = sizeof(tag);
+        const void *specifier = &tag;
+        if (tag == kAudioChannelLayoutTag_UseChannelBitmap) {
+            property = kAudioFormatProperty_ChannelLayoutForBitmap;
+            specifierSize = sizeof(inLayout.mChannelBitmap);
+            specifier = &inLayout.mChannelBitmap;
+        }
+        UInt32 size = 0;
+        if (AudioFormatGetPropertyInfo(property, specifierSize, specifier, &size) != noErr || size < sizeof(AudioChannelLayout))
+            return false;
+        expanded.resize(size);
+        if (AudioFormatGetProperty(property, specifierSize, specifier, &size, &expanded[0]) != noErr)
+            return false;
+        layout = (const AudioChannelLayout *)&expanded[0];
+#else
+        return false;
+#endif
+    }
+    if (layout->mNumberChannelDescriptions < inNumChannels)
+        return false;
+
+    bool anyOnRing = false;
+    for (UInt32 channel = 0; channel < inNumChannels; ++channel) {
+        const AudioChannelDescription &description = layout->mChannelDescriptions[channel];
+        Float32 &azimuth = outAzimuths[channel];
+        if (description.mChannelFlags & kAudioChannelFlags_SphericalCoordinates)
+            azimuth = description.mCoordinates[kAudioChannelCoordinates_Azimuth];
+        else if (description.mChannelFlags & kAudioChannelFlags_RectangularCoordinates)
+            azimuth = std::atan2(description.mCoordinates[kAudioChannelCoordinates_LeftRight],
+                                 description.mCoordinates[kAudioChannelCoordinates_BackFront]) / kDegrees;
+        else if (!LabelAzimuth(description.mChannelLabel, azimuth))
+            return false;
+        anyOnRing |= azimuth != kOffRing;
+    }
+    return anyOnRing;
+}
+
+// constant-power gains in outGains for a source at inAzimuth, between the two ring speakers either side of it
+static void PanSource(Float32 inAzimuth, const Float32 *inSpeakers, UInt32 inNumChannels, Float32 *outGains)
+{
+    // the ring speakers in order of azimuth, 0 to 360
+    UInt32 ring[kMaxOutputChannels];
+    Float32 angle[kMaxOutputChannels];
+    UInt32 numSpeakers = 0;
+    for (UInt32 channel = 0; channel < inNumChannels; ++channel) {
+        outGains[channel] = 0.f;
+        if (inSpeakers[channel] != kOffRing)
+            ring[numSpeakers++] = channel;
+    }
+    if (numSpeakers == 0) return;
+    for (UInt32 k = 0; k < numSpeakers; ++k) {
+        Float32 a = std::fmod(inSpeakers[ring[k]], 360.f);
+        angle[ring[k]] = a < 0.f ? a + 360.f : a;
+    }
+    std::sort(ring, ring + numSpeakers, [&angle](UInt32 a, UInt32 b) { return angle[a] < angle[b]; });
+    if (numSpeakers == 1) {
+        outGains[ring[0]] = kPanLevel;
+        return;
+    }
+
+    for (UInt32 k = 0; k < numSpeakers; ++k) {
+        UInt32 first = ring[k], second = ring[(k + 1) % numSpeakers];
+        Float32 arc = angle[second] - angle[first];
+        if (k + 1 == numSpeakers) arc += 360.f;
+        Float32 offset = std::fmod(inAzimuth - angle[first], 360.f);
+        if (offset < 0.f) offset += 360.f;
+        if (offset >= arc) continue;
+
+        Float32 g1, g2;
+        if (arc < 179.f) {
+            // solve for the gains that add the speakers' unit vectors up to the source's direction
+            Float32 px = std::sin(inAzimuth * kDegrees), py = std::cos(inAzimuth * kDegrees);
+            Float32 ax = std::sin(angle[first] * kDegrees), ay = std::cos(angle[first] * kDegrees);
+            Float32 bx = std::sin(angle[second] * kDegrees), by = std::cos(angle[second] * kDegrees);
+            Float32 det = ax * by - ay * bx;
+            g1 = std::max((px * by - py * bx) / det, 0.f);
+            g2 = std::max((py * ax - px * ay) / det, 0.f);
+        } else {
+            // the pair spans half the circle or more, where the vectors cannot place the source: pan
+            // by how far across the gap it is
+            Float32 t = offset / arc * (90.f * kDegrees);
+            g1 = std::cos(t);
+            g2 = std::sin(t);
+        }
+        Float32 norm = kPanLevel / std::max(std::sqrt(g1 * g1 + g2 * g2), 1.0e-6f);
+        outGains[first] = g1 * norm;
+        outGains[second] = g2 * norm;
+        return;
+    }
+}
+
+// the order of an Ambisonic layout, and whether it is the traditional W X Y Z B-format (FuMa, with W
+// 3 dB down) rather than ACN channel order with SN3D normalization; false for any other layout
+static bool AmbisonicFormat(AudioChannelLayoutTag inTag, UInt32 inNumChannels, UInt32 &outOrder, bool &outFuMa)
+{
+    if (inTag == kAudioChannelLayoutTag_Ambisonic_B_Format && inNumChannels == 4) {
+        outOrder = 1;
+        outFuMa = true;
+        return true;
+    }
+    if ((inTag & 0xFFFF0000) != kAmbisonicACNLayoutTag)
+        return false;
+    for (UInt32 order = 0; order <= kMaxAmbisonicOrder; ++order)
+        if ((order + 1) * (order + 1) == inNumChannels) {
+            outOrder = order;
+            outFuMa = false;
+            return true;
+        }
+    return false;
+}
+
+// the associated Legendre function P(n, m) at inX, without the Condon-Shortley phase
+static Float32 Legendre(UInt32 inN, UInt32 inM, Float32 inX)
+{
+    const Float32 s = std::sqrt(std::max(1.f - inX * inX, 0.f));
+    Float32 pmm = 1.f;
+    for (UInt32 i = 1; i <= inM; ++i)
+        pmm *= Float32(2 * i - 1) * s;
+    if (inN == inM) return pmm;
+    Float32 pm1 = inX * Float32(2 * inM + 1) * pmm;
+    for (UInt32 l = inM + 2; l <= inN; ++l) {
+        Float32 pl = (Float32(2 * l - 1) * inX * pm1 - Float32(l + inM - 1) * pmm) / Float32(l - inM);
+        pmm = pm1;
+        pm1 = pl;
+    }
+    return pm1;
+}
+
+static Float32 Factorial(UInt32 inN)
+{
+    Float32 f = 1.f;
+    for (UInt32 i = 2; i <= inN; ++i)
+        f *= Float32(i);
+    return f;
+}
+
+// the real spherical harmonics of a source on the horizon at inAzimuth, counter-clockwise in radians
+// from the front, one per channel of the format
+static void EncodeAmbisonic(Float32 inAzimuth, UInt32 inOrder, bool inFuMa, Float32 *outGains)
+{
+    if (inFuMa) {
+        outGains[0] = kFuMaW;
+        outGains[1] = std::cos(inAzimuth);
+        outGains[2] = std::sin(inAzimuth);
+        outGains[3] = 0.f;
+        return;
+    }
+    for (UInt32 n = 0; n <= inOrder; ++n)
+        for (SInt32 m = -SInt32(n); m <= SInt32(n); ++m) {
+            UInt32 am = UInt32(m < 0 ? -m : m);
+            Float32 norm = std::sqrt(Float32(am ? 2 : 1) * Factorial(n - am) / Factorial(n + am));
+            Float32 harmonic = norm * Legendre(n, am, 0.f);
+            outGains[n * (n + 1) + m] = harmonic * (m >= 0 ? std::cos(Float32(am) * inAzimuth) : std::sin(Float32(am) * inAzimuth));
+        }
+}
+
+// the centre of a zone's sector, in degrees counter-clockwise from the sensor's 0 as the zones' angles run
+static Float32 ZoneCentre(const ScanZone &inZone)
+{
+    return (Float32(inZone.mStartAngle) + 0.5f * Float32(inZone.mSpan)) * 0.001f;
+}
+
+void SpatialPanner::Configure(const AudioChannelLayout *inLayout, UInt32 inNumChannels, const ScanZoneMap &inZones)
+{
+    mNumChannels = std::min(inNumChannels, kMaxOutputChannels);
+    mNumSources = 1 + inZones.mNumZones;
+    for (UInt32 channel = 0; channel < kMaxOutputChannels; ++channel)
+        std::fill(mGains[channel], mGains[channel] + kMaxPanSources, 0.f);
+    if (mNumChannels == 0) return;
+
+    Float32 gains[kMaxOutputChannels];
+    UInt32 order;
+    bool fuma;
+    if (inLayout != NULL && AmbisonicFormat(inLayout->mChannelLayoutTag, mNumChannels, order, fuma)) {
+        // the whole scan, with no direction, goes in W alone; each zone is encoded at its centre
+        mGains[0][kFullScanTable] = fuma ? kFuMaW : 1.f;
+        for (UInt32 i = 0; i < inZones.mNumZones; ++i) {
+            EncodeAmbisonic(ZoneCentre(inZones.mZones[i]) * kDegrees, order, fuma, gains);
+            for (UInt32 channel = 0; channel < mNumChannels; ++channel)
+                mGains[channel][1 + i] = gains[channel];
+        }
+        return;
+    }
+
+    Float32 speakers[kMaxOutputChannels];
+    bool placed = inLayout != NULL && LayoutChannels(*inLayout) == mNumChannels
+        && SpeakerAzimuths(*inLayout, mNumChannels, speakers);
+    if (!placed)
+        for (UInt32 channel = 0; channel < mNumChannels; ++channel)
+            speakers[channel] = 360.f * channel / mNumChannels;
+
+    // the whole scan: the same power as a panned source, shared by every ring speaker
+    UInt32 numSpeakers = 0;
+    for (UInt32 channel = 0; channel < mNumChannels; ++channel)
+        numSpeakers += speakers[channel] != kOffRing;
+    for (UInt32 channel = 0; channel < mNumChannels; ++channel)
+        mGains[channel][kFullScanTable] = speakers[channel] != kOffRing ? kPanLevel / std::sqrt(Float32(numSpeakers)) : 0.f;
+
+    for (UInt32 i = 0; i < inZones.mNumZones; ++i) {
+        PanSource(-ZoneCentre(inZones.mZones[i]), speakers, mNumChannels, gains);
+        for (UInt32 channel = 0; channel < mNumChannels; ++channel)
+            mGains[channel][1 + i] = gains[channel];
+    }
+}
+
+// adds inCount blocks, each scaled by its gain, into every inStride'th sample of ioOut, four blocks
+// per pass so that each output sample is loaded and stored once for every four
+template <bool kInterleaved>
+static void AddBlocks(const CADSPKernels &inKernels, Float32 *ioOut, UInt32 inStride, const Float32 *const *inBlocks,
+                      const Float32 *inGains, UInt32 inCount, UInt32 inNumberFrames)
+{
+    const UInt32 stride = kInterleaved ? inStride : 1;
+    UInt32 k = 0;
+    for (; k + 4 <= inCount; k += 4) {
+        const Float32 *a = inBlocks[k], *b = inBlocks[k + 1], *c = inBlocks[k + 2], *d = inBlocks[k + 3];
+        const Float32 ga = inGains[k], gb = inGains[k + 1], gc = inGains[k + 2], gd = inGains[k + 3];
+        for (UInt32 frame = 0; frame < inNumberFrames; ++frame)
+            ioOut[frame * stride] += ga * a[frame] + gb * b[frame] + gc * c[frame] + gd * d[frame];
+    }
+    for (; k < inCount; ++k)
+        inKernels.Mix(inBlocks[k], inGains[k], ioOut, stride, inNumberFrames);
+}
+
+void SpatialPanner::Mix(const CADSPKernels &inKernels, AudioBufferList &ioBus, const Float32 *const *inSources,
+                        UInt32 inNumSources, UInt32 inNumberFrames) const
+{
+    inNumSources = std::min(inNumSources, mNumSources);
+    UInt32 channel = 0;
+    for (UInt32 i = 0; i < ioBus.mNumberBuffers; ++i) {
+        const AudioBuffer &buffer = ioBus.mBuffers[i];
+        const UInt32 stride = buffer.mNumberChannels;
+        for (UInt32 j = 0; j < stride && channel < mNumChannels; ++j, ++channel) {
+            // only the blocks this channel hears
+            const Float32 *blocks[kMaxPanSources];
+            Float32 gains[kMaxPanSources];
+            UInt32 count = 0;
+            for (UInt32 source = 0; source < inNumSources; ++source) {
+                if (inSources[source] == NULL || mGains[channel][source] == 0.f) continue;
+                blocks[count] = inSources[source];
+                gains[count++] = mGains[channel][source];
+            }
+            Float32 *out = (Float32 *)buffer.mData + j;
+            if (stride == 1)
+                AddBlocks<false>(inKernels, out, 1, blocks, gains, count, inNumberFrames);
+            else
+                AddBlocks<true>(inKernels, out, stride, blocks, gains, count, inNumberFrames);
+        }
+    }
+}
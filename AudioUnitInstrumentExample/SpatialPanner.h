@@ -0,0 +1,64 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Precomputed panning and Ambisonic encoding gains that place each zone of the LiDAR scan at its angle
+ */
+
+#ifndef __SpatialPanner_h__
+#define __SpatialPanner_h__
+
+#include "ScanZones.h"
+#include "CADSPKernels.h"
+
+static const UInt32 kMaxOutputChannels = 32;
+static const UInt32 kMaxPanSources = 1 + kMaxScanZones;	// one per LidarScanZones table
+static const UInt32 kMaxAmbisonicOrder = 3;				// 16 channels
+
+// kAudioChannelLayoutTag_HOA_ACN_SN3D, ORed with the number of channels, which older SDKs do not define
+static const AudioChannelLayoutTag kAmbisonicACNLayoutTag = 190U << 16;
+
+/*
+ SpatialPanner mixes one mono block per LidarScanZones table into a multichannel output. Each zone's
+ block is placed at the centre of its sector, with the sensor's 0 degrees at front centre and azimuth
+ running the opposite way to the zones' angles; the whole-scan block, which has no direction, is
+ spread evenly over every speaker. The speakers come from the output's AudioChannelLayout: the
+ azimuth of each channel's description, or the usual position of its label (heights and LFE are left
+ out of the ring), or, for a layout that does not place them, an even ring in channel order starting
+ at front centre and going clockwise.
+
+ Configure() works out the gain of every block in every channel once, when the AU is initialized:
+ amplitude panning between the two speakers either side of the source (2D VBAP), normalized to
+ constant power. Mix() is then just that gain matrix applied to the blocks, a few branch-free
+ multiply-adds per frame that the compiler vectorizes, whatever the number of channels.
+
+ An Ambisonic layout is encoded instead of panned, for a decoder downstream: the first-order
+ B-format tag (W X Y Z) or kAmbisonicACNLayoutTag with 4, 9 or 16 channels (ACN order, SN3D, up to
+ kMaxAmbisonicOrder). The zones are encoded on the horizon at their centres,
+ counter-clockwise from the front as Ambisonic azimuths run, and the whole scan goes in W; the gains
+ are the spherical harmonics of those directions, so the mix costs the same as panning.
+ */
+class SpatialPanner
+{
+public:
+    SpatialPanner() : mNumChannels(0), mNumSources(0) {}
+
+    // inLayout may be NULL, or describe some other number of channels, for an even ring; not
+    // real-time safe
+    void			Configure(const AudioChannelLayout *inLayout, UInt32 inNumChannels, const ScanZoneMap &inZones);
+
+    UInt32			NumChannels() const { return mNumChannels; }
+    Float32			Gain(UInt32 inChannel, UInt32 inSource) const { return mGains[inChannel][inSource]; }
+
+    // adds inSources[t], the block of table t or NULL if nothing played it, to the channels of ioBus;
+    // the blocks left over after the fours go through inKernels' Mix()
+    void			Mix(const CADSPKernels &inKernels, AudioBufferList &ioBus, const Float32 *const *inSources,
+                        UInt32 inNumSources, UInt32 inNumberFrames) const;
+
+private:
+    UInt32			mNumChannels;
+    UInt32			mNumSources;
+    Float32			mGains[kMaxOutputChannels][kMaxPanSources];
+};
+
+#endif
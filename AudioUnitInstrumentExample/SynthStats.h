@@ -0,0 +1,62 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Frames of a process's render, ingest and queue statistics, and the instances that report into them
+ */
+
+#ifndef __SynthStats_h__
+#define __SynthStats_h__
+
+#include "AURenderTiming.h"
+
+static const UInt32 kSynthStatsMaxInstances = 32;		// per frame; more are left out
+
+// one synth instance's part of a frame
+struct SynthStatsInstance
+{
+    UInt32			mInstanceID;			// counts the instances the process has registered
+    UInt32			mQualityLevel;			// steps of load shedding in force
+    UInt32			mEventQueueDepth;		// note and parameter events waiting for the render thread
+    UInt32			mMIDIOutDepth;			// MIDI messages waiting to go out; 0 for a unit without MIDI output
+    UInt64			mNumCycles;
+    UInt64			mNumOverruns;			// cycles past the render timing's overrun threshold: deadline misses
+    UInt64			mNumDroppedEvents;		// MIDI output that found its queue full
+    Float32			mMeanLoad;				// of a cycle's budget
+    Float32			mMaxLoad;
+    Float32			mP99SourceLatency;		// seconds
+    UInt32			mHistogram[kAURenderTimingHistogramBins];	// cycles by load, as in AURenderTimingStatistics
+};
+
+/*
+ A frame is a SynthStatsHeader followed by mNumInstances SynthStatsInstance records, in host byte
+ order, as the table network sends them. Every count runs from when the instance, or the hub, was
+ created or its statistics last reset, so a monitor takes differences between frames for rates.
+ */
+struct SynthStatsHeader
+{
+    UInt32			mMagic;
+    UInt32			mVersion;
+    UInt32			mSequence;				// counts the publisher's frames
+    UInt32			mProcessID;
+    UInt64			mTime;					// host time in nanoseconds
+    UInt32			mDeviceState;			// LidarDeviceState
+    UInt32			mNumInstances;
+    UInt64			mNumScans;
+    UInt64			mNumReconnects;
+    UInt64			mNumRejectedSamples;
+    UInt64			mNumUnchangedScans;
+    Float32			mMeanScanInterval;		// seconds
+    Float32			mScanIntervalJitter;	// seconds
+};
+
+// what a synth instance reports; called on the publisher's thread, so it may only read what the
+// render thread writes through atomics or a sequence count, and must never take the unit's mutex
+class SynthStatsSource
+{
+public:
+    virtual ~SynthStatsSource() {}
+    virtual void	GetSynthStats(SynthStatsInstance &outStats) = 0;
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ ZeroMQ publisher of a process's render, ingest and queue statistics, for monitoring a fleet of hosts
+ */
+
+#include "SynthStatsPublisher.h"
+#include "LidarDeviceHub.h"
+#include "CAHostTimeBase.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+
+#if __APPLE__
+	#include <pthread.h>
+#endif
+
+static const UInt32 kSynthStatsMagic = 'LSst';
+static const UInt32 kSynthStatsVersion = 1;
+
+SynthStatsPublisher::SynthStatsPublisher(const char *inEndpoint, Float64 inInterval, LidarDeviceHub &inHub)
+: mHub(inHub), mIntervalNanos(UInt64(std::max(inInterval, 0.01) * 1e9)), mContext(1), mSocket(mContext, ZMQ_PUB),
+  mNextInstanceID(0), mExit(false), mSequence(0)
+{
+    int linger = 0, highWaterMark = 4;
+    mSocket.setsockopt(ZMQ_LINGER, &linger, sizeof(linger));
+    mSocket.setsockopt(ZMQ_SNDHWM, &highWaterMark, sizeof(highWaterMark));
+    mSocket.bind(inEndpoint);
+
+    mFrame.resize(sizeof(SynthStatsHeader) + kSynthStatsMaxInstances * sizeof(SynthStatsInstance));
+    mSources.reserve(kSynthStatsMaxInstances);
+    mThread = std::thread(&SynthStatsPublisher::PublishThread, this);
+}
+
+SynthStatsPublisher::~SynthStatsPublisher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mExitMutex);
+        mExit = true;
+    }
+    mExitCondition.notify_all();
+    mThread.join();
+}
+
+void SynthStatsPublisher::AddSource(SynthStatsSource *inSource)
+{
+    std::lock_guard<std::mutex> lock(mSourceMutex);
+    Source source = { inSource, mNextInstanceID++ };
+    mSources.push_back(source);
+}
+
+void SynthStatsPublisher::RemoveSource(SynthStatsSource *inSource)
+{
+    std::lock_guard<std::mutex> lock(mSourceMutex);
+    mSources.erase(std::remove_if(mSources.begin(), mSources.end(),
+                                  [inSource](const Source &s) { return s.mSource == inSource; }),
+                   mSources.end());
+}
+
+void SynthStatsPublisher::RemoveAllSources()
+{
+    std::lock_guard<std::mutex> lock(mSourceMutex);
+    mSources.clear();
+}
+
+void SynthStatsPublisher::PublishThread()
+{
+#if __APPLE__
+    // monitoring must never compete with the ingest or render threads
+    pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#endif
+    std::unique_lock<std::mutex> lock(mExitMutex);
+    while (!mExitCondition.wait_for(lock, std::chrono::nanoseconds(mIntervalNanos), [this]{ return mExit; })) {
+        lock.unlock();
+        Publish();
+        lock.lock();
+    }
+}
+
+void SynthStatsPublisher::Publish()
+{
+    SynthStatsHeader &header = *(SynthStatsHeader *)mFrame.data();
+    SynthStatsInstance *instances = (SynthStatsInstance *)(mFrame.data() + sizeof(SynthStatsHeader));
+
+    LidarIngestStatistics ingest;
+    mHub.GetIngestStatistics(ingest);
+    memset(&header, 0, sizeof(header));
+    header.mMagic = kSynthStatsMagic;
+    header.mVersion = kSynthStatsVersion;
+    header.mSequence = ++mSequence;
+    header.mProcessID = UInt32(getpid());
+    header.mTime = CAHostTimeBase::GetCurrentTimeInNanos();
+    header.mDeviceState = mHub.State();
+    header.mNumScans = ingest.mNumScans;
+    header.mNumReconnects = ingest.mNumReconnects;
+    header.mNumRejectedSamples = ingest.mNumRejectedSamples;
+    header.mNumUnchangedScans = ingest.mNumUnchangedScans;
+    header.mMeanScanInterval = Float32(ingest.mMeanInterval);
+    header.mScanIntervalJitter = Float32(ingest.mIntervalJitter);
+
+    UInt32 numInstances = 0;
+    {
+        std::lock_guard<std::mutex> lock(mSourceMutex);
+        for (const Source &source : mSources) {
+            if (numInstances == kSynthStatsMaxInstances)
+                break;
+            SynthStatsInstance &instance = instances[numInstances++];
+            memset(&instance, 0, sizeof(instance));
+            source.mSource->GetSynthStats(instance);
+            instance.mInstanceID = source.mInstanceID;
+        }
+    }
+    header.mNumInstances = numInstances;
+
+    mSocket.send(mFrame.data(), sizeof(SynthStatsHeader) + numInstances * sizeof(SynthStatsInstance), ZMQ_DONTWAIT);
+}
@@ -0,0 +1,75 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ ZeroMQ publisher of a process's render, ingest and queue statistics, for monitoring a fleet of hosts
+ */
+
+#ifndef __SynthStatsPublisher_h__
+#define __SynthStatsPublisher_h__
+
+#include "SynthStats.h"
+#include <zmq.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class LidarDeviceHub;
+
+static const Float64 kDefaultSynthStatsInterval = 1.;	// seconds between frames
+
+/*
+ SynthStatsPublisher runs one thread at utility priority that, every interval, gathers the statistics
+ of the device hub and of each registered instance into a frame and sends it on a ZMQ PUB socket,
+ without blocking: a monitor that falls behind loses frames, which are cumulative anyway. The device
+ hub creates it when LIDARSYNTH_PUBLISH_STATS names an endpoint (for example tcp://<host>:5557), with
+ LIDARSYNTH_STATS_INTERVAL seconds between frames, so one monitor can subscribe to every host of a
+ rig instead of reading each instance's properties.
+
+ The render thread never waits for it: the render timing is read through its sequence count, and
+ the queue depths with relaxed loads of the FIFOs' indices. The sources are guarded by a mutex that
+ only the publisher's thread and AddSource() and RemoveSource() take, none of them on a render
+ thread. Binding throws zmq::error_t.
+ */
+class SynthStatsPublisher
+{
+public:
+    SynthStatsPublisher(const char *inEndpoint, Float64 inInterval, LidarDeviceHub &inHub);
+    ~SynthStatsPublisher();
+
+    void					AddSource(SynthStatsSource *inSource);
+    // once this returns the source is no longer read; removing one that isn't there does nothing
+    void					RemoveSource(SynthStatsSource *inSource);
+    void					RemoveAllSources();
+
+private:
+    SynthStatsPublisher(const SynthStatsPublisher &);
+    SynthStatsPublisher & operator=(const SynthStatsPublisher &);
+
+    void					PublishThread();
+    void					Publish();
+
+    struct Source
+    {
+        SynthStatsSource *	mSource;
+        UInt32				mInstanceID;
+    };
+
+    LidarDeviceHub &		mHub;
+    UInt64					mIntervalNanos;
+    zmq::context_t			mContext;
+    zmq::socket_t			mSocket;
+    std::mutex				mSourceMutex;		// guards mSources and mNextInstanceID
+    std::vector<Source>		mSources;
+    UInt32					mNextInstanceID;
+    std::mutex				mExitMutex;			// guards mExit
+    std::condition_variable	mExitCondition;
+    bool					mExit;
+    std::thread				mThread;
+    std::vector<UInt8>		mFrame;				// owned by the thread
+    UInt32					mSequence;
+};
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Procedural LiDAR scans of a parametric room, for load testing without a device
+ */
+
+#include "SyntheticScene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static const Float64 kDegreesToRadians = M_PI / 180.;
+static const Float64 kMaxRayDistance = 1.e6;			// cm; a ray that leaves the room through a gap
+static const Float64 kStrongestReturn = 200.;			// signal strength up close
+static const Float64 kStrengthFalloff = 0.04;			// per cm
+static const std::int32_t kWeakestReturn = 10;
+
+SyntheticSceneSettings::SyntheticSceneSettings()
+: mRoomWidth(800.f), mRoomDepth(600.f), mNumBlobs(3), mBlobRadius(25.f), mBlobSpeed(100.f), mNoise(1.f),
+  mDropout(0.02f), mHoleSamples(8), mRotationRate(10.f), mSamplesPerScan(1000), mSeed(1), mRealTime(true)
+{
+}
+
+bool SyntheticSceneSettings::Parse(const char *inText)
+{
+    // "1", or anything else without an '=', takes the defaults
+    std::string text(inText);
+    size_t start = 0;
+    while (start < text.size() && text.find('=') != std::string::npos) {
+        size_t end = text.find(',', start);
+        std::string pair = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        start = end == std::string::npos ? text.size() : end + 1;
+        size_t equals = pair.find('=');
+        if (equals == std::string::npos) {
+            fprintf(stderr, "SyntheticScene: %s is not key=value\n", pair.c_str());
+            return false;
+        }
+        const std::string key = pair.substr(0, equals);
+        const Float64 value = atof(pair.c_str() + equals + 1);
+        if (key == "width") mRoomWidth = Float32(value);
+        else if (key == "depth") mRoomDepth = Float32(value);
+        else if (key == "blobs") mNumBlobs = UInt32(std::max(value, 0.));
+        else if (key == "radius") mBlobRadius = Float32(value);
+        else if (key == "speed") mBlobSpeed = Float32(value);
+        else if (key == "noise") mNoise = Float32(value);
+        else if (key == "dropout") mDropout = Float32(value);
+        else if (key == "hole") mHoleSamples = UInt32(std::max(value, 0.));
+        else if (key == "rate") mRotationRate = Float32(value);
+        else if (key == "samples") mSamplesPerScan = UInt32(std::max(value, 0.));
+        else if (key == "seed") mSeed = UInt32(std::max(value, 0.));
+        else if (key == "realtime") mRealTime = value != 0.;
+        else {
+            fprintf(stderr, "SyntheticScene: unknown key %s\n", key.c_str());
+            return false;
+        }
+    }
+    if (!(mRoomWidth > 0.f && mRoomDepth > 0.f) || mNumBlobs > kSyntheticSceneMaxBlobs || mBlobRadius < 0.f
+        || mNoise < 0.f || !(mDropout >= 0.f && mDropout < 1.f) || mHoleSamples == 0 || !(mRotationRate > 0.f)
+        || mSamplesPerScan == 0) {
+        fprintf(stderr, "SyntheticScene: %s is out of range\n", inText);
+        return false;
+    }
+    return true;
+}
+
+// xorshift64*: the same sequence everywhere, unlike the standard library's distributions
+UInt64 SyntheticScene::Random::Next()
+{
+    mState ^= mState >> 12;
+    mState ^= mState << 25;
+    mState ^= mState >> 27;
+    return mState * 0x2545F4914F6CDD1DULL;
+}
+
+// the sum of four uniforms, scaled: bell-shaped and bounded, which is all the noise needs
+Float64 SyntheticScene::Random::Gaussian()
+{
+    return (Uniform() + Uniform() + Uniform() + Uniform() - 2.) * 1.7320508075688772;
+}
+
+SyntheticScene::SyntheticScene(const SyntheticSceneSettings &inSettings, const ScanPose &inViewpoint, UInt32 inViewpointIndex)
+: mSettings(inSettings), mViewpoint(inViewpoint), mRandom(UInt64(inSettings.mSeed) << 8 | inViewpointIndex), mNumScans(0)
+{
+    // the blobs come from the seed alone, so every viewpoint sees the same ones
+    Random layout(inSettings.mSeed);
+    const Float64 halfWidth = std::max(mSettings.mRoomWidth * 0.5 - mSettings.mBlobRadius, 0.);
+    const Float64 halfDepth = std::max(mSettings.mRoomDepth * 0.5 - mSettings.mBlobRadius, 0.);
+    const Float64 step = mSettings.mBlobSpeed / mSettings.mRotationRate;
+    for (UInt32 i = 0; i < mSettings.mNumBlobs; ++i) {
+        Blob &blob = mBlobs[i];
+        blob.mX = (layout.Uniform() * 2. - 1.) * halfWidth;
+        blob.mY = (layout.Uniform() * 2. - 1.) * halfDepth;
+        const Float64 heading = layout.Uniform() * 2. * M_PI;
+        blob.mVX = step * std::cos(heading);
+        blob.mVY = step * std::sin(heading);
+    }
+}
+
+// cm from the viewpoint to the first wall or blob along the direction, a unit vector
+Float64 SyntheticScene::CastRay(Float64 inDirectionX, Float64 inDirectionY) const
+{
+    const Float64 x = mViewpoint.mX, y = mViewpoint.mY;
+    const Float64 halfWidth = mSettings.mRoomWidth * 0.5, halfDepth = mSettings.mRoomDepth * 0.5;
+
+    // the walls, from inside; a viewpoint outside the room sees the far walls, which will do
+    Float64 nearest = kMaxRayDistance;
+    if (inDirectionX > 0.) nearest = std::min(nearest, (halfWidth - x) / inDirectionX);
+    else if (inDirectionX < 0.) nearest = std::min(nearest, (-halfWidth - x) / inDirectionX);
+    if (inDirectionY > 0.) nearest = std::min(nearest, (halfDepth - y) / inDirectionY);
+    else if (inDirectionY < 0.) nearest = std::min(nearest, (-halfDepth - y) / inDirectionY);
+
+    const Float64 radiusSquared = Float64(mSettings.mBlobRadius) * mSettings.mBlobRadius;
+    for (UInt32 i = 0; i < mSettings.mNumBlobs; ++i) {
+        const Float64 cx = mBlobs[i].mX - x, cy = mBlobs[i].mY - y;
+        const Float64 along = cx * inDirectionX + cy * inDirectionY;
+        if (along <= 0.)
+            continue;
+        const Float64 discriminant = along * along - (cx * cx + cy * cy - radiusSquared);
+        if (discriminant < 0.)
+            continue;
+        const Float64 hit = along - std::sqrt(discriminant);
+        if (hit > 0. && hit < nearest)
+            nearest = hit;
+    }
+    return std::max(nearest, 0.);
+}
+
+void SyntheticScene::MoveBlobs()
+{
+    const Float64 halfWidth = std::max(mSettings.mRoomWidth * 0.5 - mSettings.mBlobRadius, 0.);
+    const Float64 halfDepth = std::max(mSettings.mRoomDepth * 0.5 - mSettings.mBlobRadius, 0.);
+    for (UInt32 i = 0; i < mSettings.mNumBlobs; ++i) {
+        Blob &blob = mBlobs[i];
+        blob.mX += blob.mVX;
+        blob.mY += blob.mVY;
+        if (blob.mX > halfWidth || blob.mX < -halfWidth) {
+            blob.mX = std::max(std::min(blob.mX, halfWidth), -halfWidth);
+            blob.mVX = -blob.mVX;
+        }
+        if (blob.mY > halfDepth || blob.mY < -halfDepth) {
+            blob.mY = std::max(std::min(blob.mY, halfDepth), -halfDepth);
+            blob.mVY = -blob.mVY;
+        }
+    }
+}
+
+void SyntheticScene::NextScan(std::vector<std::int32_t> &outAngles, std::vector<std::int32_t> &outDistances,
+                              std::vector<std::int32_t> &outSignalStrengths)
+{
+    const UInt32 n = mSettings.mSamplesPerScan;
+    outAngles.resize(n);
+    outDistances.resize(n);
+    outSignalStrengths.resize(n);
+
+    // a hole starts often enough that the mean hole length times the starts gives the dropout
+    const Float64 holeStart = mSettings.mDropout / (mSettings.mHoleSamples * (1. - mSettings.mDropout) + mSettings.mDropout);
+    const Float64 step = Float64(kScanFullCircle) / n;
+    UInt32 hole = 0;
+    for (UInt32 i = 0; i < n; ++i) {
+        std::int32_t angle = std::int32_t(std::lround((i + (mRandom.Uniform() - 0.5) * 0.5) * step));
+        angle = angle < 0 ? angle + kScanFullCircle : angle % kScanFullCircle;
+        outAngles[i] = angle;
+
+        if (hole == 0 && mRandom.Uniform() < holeStart)
+            hole = 1 + UInt32(mRandom.Uniform() * (2 * mSettings.mHoleSamples - 1));
+        if (hole > 0) {
+            --hole;
+            outDistances[i] = 0;
+            outSignalStrengths[i] = 0;
+            continue;
+        }
+
+        const Float64 theta = (angle * 0.001 + mViewpoint.mRotation) * kDegreesToRadians;
+        const Float64 distance = CastRay(std::cos(theta), std::sin(theta)) + mRandom.Gaussian() * mSettings.mNoise;
+        outDistances[i] = std::max(std::int32_t(std::lround(distance)), 1);
+        outSignalStrengths[i] = std::max(std::int32_t(kStrongestReturn - distance * kStrengthFalloff), kWeakestReturn);
+    }
+
+    MoveBlobs();
+    mNumScans++;
+}
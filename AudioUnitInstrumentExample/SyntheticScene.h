@@ -0,0 +1,95 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Procedural LiDAR scans of a parametric room, for load testing without a device
+ */
+
+#ifndef __SyntheticScene_h__
+#define __SyntheticScene_h__
+
+#include "ScanFusion.h"
+#include <vector>
+
+static const UInt32 kSyntheticSceneMaxBlobs = 64;
+
+// what LIDARSYNTH_SYNTHETIC sets, as comma-separated key=value pairs; a key left out keeps its default
+struct SyntheticSceneSettings
+{
+    SyntheticSceneSettings();
+
+    // false, with a message on stderr, if inText has a key it doesn't know or a value out of range
+    bool			Parse(const char *inText);
+
+    Float32			mRoomWidth;			// cm along x, "width"; the room is centred on the origin
+    Float32			mRoomDepth;			// cm along y, "depth"
+    UInt32			mNumBlobs;			// "blobs": round obstacles wandering the room, people say
+    Float32			mBlobRadius;		// cm, "radius"
+    Float32			mBlobSpeed;			// cm/s, "speed"
+    Float32			mNoise;				// cm, "noise": the spread of each distance
+    Float32			mDropout;			// "dropout": the fraction of samples lost in holes, 0 to 1
+    UInt32			mHoleSamples;		// "hole": the mean length of a hole, in samples
+    Float32			mRotationRate;		// scans per second, "rate"
+    UInt32			mSamplesPerScan;	// "samples"
+    UInt32			mSeed;				// "seed"
+    bool			mRealTime;			// "realtime": 0 generates as fast as the hub takes the scans
+};
+
+/*
+ SyntheticScene stands in for a device: a rectangular room with blobs moving through it in straight
+ lines, bouncing off the walls, scanned from a viewpoint by casting one ray per sample. Each distance
+ gets noise, each scan loses samples in holes of consecutive dropouts (distance and signal strength
+ 0, as the sensor reports a missed return), and the signal strength falls with distance, so the
+ quality filter has the work it has on real data. The angles step evenly around the circle with a
+ little jitter, as a spinning head's do.
+
+ The scene is deterministic: scan N of a seed is the same on every run and every machine, whatever
+ the pacing. The blobs move on the scan count, not the clock, and come from the seed alone, so
+ several scenes of one seed seen from different viewpoints (one per device of a fused rig) see the
+ same room at the same scan; the noise and the holes also take the viewpoint's index, so those
+ devices don't all miss the same samples.
+
+ NextScan() fills the arrays it is given, which it grows once to the scan size, and allocates
+ nothing after that.
+ */
+class SyntheticScene
+{
+public:
+    SyntheticScene(const SyntheticSceneSettings &inSettings, const ScanPose &inViewpoint = ScanPose(),
+                   UInt32 inViewpointIndex = 0);
+
+    const SyntheticSceneSettings &Settings() const { return mSettings; }
+
+    // the next scan as the device at the viewpoint reports it: angles in milli-degrees from its own
+    // zero, distances in cm
+    void					NextScan(std::vector<std::int32_t> &outAngles, std::vector<std::int32_t> &outDistances,
+                                     std::vector<std::int32_t> &outSignalStrengths);
+    UInt64					NumScans() const { return mNumScans; }
+
+private:
+    struct Random
+    {
+        explicit Random(UInt64 inSeed) : mState(inSeed * 0x9E3779B97F4A7C15ULL + 1) {}
+        UInt64				Next();
+        Float64				Uniform() { return Float64(Next() >> 11) * (1. / 9007199254740992.); }		// [0, 1)
+        Float64				Gaussian();		// mean 0, deviation 1, near enough
+        UInt64				mState;
+    };
+
+    struct Blob
+    {
+        Float64				mX, mY;			// cm
+        Float64				mVX, mVY;		// cm per scan
+    };
+
+    Float64					CastRay(Float64 inDirectionX, Float64 inDirectionY) const;
+    void					MoveBlobs();
+
+    SyntheticSceneSettings	mSettings;
+    ScanPose				mViewpoint;
+    Random					mRandom;		// noise, jitter and holes
+    Blob					mBlobs[kSyntheticSceneMaxBlobs];
+    UInt64					mNumScans;
+};
+
+#endif
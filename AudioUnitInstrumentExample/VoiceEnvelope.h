@@ -0,0 +1,93 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Linear attack/release envelope rendered a block at a time
+ */
+
+#ifndef __VoiceEnvelope_h__
+#define __VoiceEnvelope_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+// a voice's envelope is rendered at most this many frames at a time, into a buffer on the stack
+static const UInt32 kVoiceEnvelopeMaxFrames = 256;
+
+enum VoiceEnvelopeMode
+{
+    kVoiceEnvelope_Rising,		// towards the peak, then holding it
+    kVoiceEnvelope_Falling		// towards zero; the voice ends once it gets there
+};
+
+/*
+ VoiceEnvelope ramps linearly between 0 and a peak level. The step is set once per block; Ramp()
+ works out analytically where inside the block the ramp reaches its target, writes the linear
+ segment and the flat segment after it as two branch-free loops, and leaves the per-frame levels
+ in a buffer the voice kernel multiplies by. The direction is a template parameter, so each mode
+ compiles to its own loop. Everything is single precision, so the ramp fills as many lanes per
+ vector as the voice kernel that reads it. The step comes from NoteTables.
+
+ A falling envelope may be given a floor, the level below which the voice can no longer be heard;
+ it then ends on the first frame that starts below the floor rather than at zero. Floor() turns an
+ audibility floor relative to the mix into the envelope's own terms, for a voice scaled by inGain.
+ */
+class VoiceEnvelope
+{
+public:
+    VoiceEnvelope() : mLevel(0.f), mPeak(0.f) {}
+
+    void			Start(Float32 inPeak) { mLevel = 0.f; mPeak = inPeak; }
+    Float32			Level() const { return mLevel; }
+    Float32			Peak() const { return mPeak; }
+
+    /*
+     Writes the level after each of inNumFrames frames to outRamp, moving by inStep (>= 0) per frame
+     in the direction of kMode, and returns how many of those frames started above inFloor (>= 0),
+     which a rising envelope ignores. When a falling envelope returns less than inNumFrames, it has
+     finished releasing.
+     */
+    template <VoiceEnvelopeMode kMode>
+    UInt32			Ramp(Float32 inStep, Float32 *outRamp, UInt32 inNumFrames, Float32 inFloor = 0.f)
+    {
+        const Float32 level = mLevel;
+        const Float32 slope = kMode == kVoiceEnvelope_Rising ? inStep : -inStep;
+        const Float32 target = kMode == kVoiceEnvelope_Rising ? mPeak : 0.f;
+
+        // frames until the target is reached; the last of them lands on it exactly
+        Float32 toTarget = inStep > 0.f ? std::max(std::ceil((target - level) / slope), 0.f) : HUGE_VALF;
+        UInt32 rampFrames = UInt32(std::min(toTarget, Float32(inNumFrames)));
+
+        for (UInt32 frame = 0; frame < rampFrames; ++frame)
+            outRamp[frame] = level + slope * Float32(frame + 1);
+        if (rampFrames > 0 && Float32(rampFrames) == toTarget)
+            outRamp[rampFrames - 1] = target;
+        for (UInt32 frame = rampFrames; frame < inNumFrames; ++frame)
+            outRamp[frame] = target;
+
+        if (inNumFrames > 0) mLevel = outRamp[inNumFrames - 1];
+        if (kMode == kVoiceEnvelope_Rising) return inNumFrames;
+        if (level <= inFloor) return 0;
+        if (inFloor <= 0.f) return rampFrames;
+        // frame n starts at level - inStep * n, so the first frame at or below the floor is found directly
+        const Float32 toFloor = inStep > 0.f ? std::ceil((level - inFloor) / inStep) : HUGE_VALF;
+        return UInt32(std::min(toFloor, Float32(rampFrames)));
+    }
+
+    static Float32	Floor(Float32 inFloor, Float32 inGain)
+    {
+        return inGain > 0.f ? inFloor / inGain : HUGE_VALF;
+    }
+
+private:
+    Float32			mLevel;
+    Float32			mPeak;
+};
+
+#endif
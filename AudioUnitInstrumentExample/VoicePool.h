@@ -0,0 +1,73 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Preallocated, cache-aligned storage for an instrument's notes
+ */
+
+#ifndef __VoicePool_h__
+#define __VoicePool_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+    #include <CoreAudio/CoreAudioTypes.h>
+#else
+    #include "CoreAudioTypes.h"
+#endif
+
+#include <cstdlib>
+#include <new>
+
+static const UInt32 kVoicePoolAlignment = 64;	// one cache line
+
+/*
+ VoicePool<T> owns Count() notes of type T, each starting on its own cache line so that voices
+ rendered back to back never share one. Stride() is the distance between them, to pass to
+ AUInstrumentBase::SetNotes. Resize() allocates and must only be called off the render thread,
+ while the AU is uninitialized; nothing else allocates.
+ */
+template <class T>
+class VoicePool
+{
+public:
+    VoicePool() : mStorage(NULL), mCount(0) {}
+    ~VoicePool() { Free(); }
+
+    static UInt32		Stride() { return (sizeof(T) + kVoicePoolAlignment - 1) / kVoicePoolAlignment * kVoicePoolAlignment; }
+
+    // returns false (and keeps the current pool) if the allocation fails
+    bool				Resize(UInt32 inCount)
+    {
+        if (inCount == mCount) return true;
+        void *storage = NULL;
+        if (inCount > 0 && posix_memalign(&storage, kVoicePoolAlignment, size_t(inCount) * Stride()) != 0)
+            return false;
+        Free();
+        mStorage = static_cast<char *>(storage);
+        for (UInt32 i = 0; i < inCount; ++i)
+            new (mStorage + size_t(i) * Stride()) T;
+        mCount = inCount;
+        return true;
+    }
+
+    UInt32				Count() const { return mCount; }
+    T *					First() { return reinterpret_cast<T *>(mStorage); }
+    T *					Voice(UInt32 inIndex) { return reinterpret_cast<T *>(mStorage + size_t(inIndex) * Stride()); }
+
+private:
+    void				Free()
+    {
+        for (UInt32 i = 0; i < mCount; ++i)
+            Voice(i)->~T();
+        free(mStorage);
+        mStorage = NULL;
+        mCount = 0;
+    }
+
+    VoicePool(const VoicePool &);
+    VoicePool & operator=(const VoicePool &);
+
+    char *				mStorage;
+    UInt32				mCount;
+};
+
+#endif
@@ -0,0 +1,303 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Block renderer for one wavetable voice, with SSE, AVX and NEON paths
+ */
+
+#include "WavetableVoice.h"
+#include "CAVectorUnit.h"
+
+#if defined(__SSE2__)
+	#include <immintrin.h>
+	#define WAVETABLE_VOICE_X86 1
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define WAVETABLE_VOICE_NEON 1
+#endif
+
+// the window's first entry and the two masks, read once per block; the table pointer starts at the
+// window, so a whole-table voice indexes exactly as it did before there were windows
+struct ScalarWindow
+{
+    explicit ScalarWindow(const WavetableVoiceBlock &inBlock)
+        : table(inBlock.mTable + inBlock.mWindowStart), shift(inBlock.mWindowShift), mask(inBlock.mWindowMask),
+          fractionMask((1U << inBlock.mWindowShift) - 1), halfEntry(1U << (inBlock.mWindowShift - 1)),
+          fractionScale(inBlock.mFractionScale) {}
+
+    const Float32 *	table;
+    UInt32			shift, mask, fractionMask, halfEntry;
+    Float32			fractionScale;
+};
+
+template <bool kLinear>
+static inline Float32 ReadTable(const ScalarWindow &inWindow, UInt32 inPhase)
+{
+    // the rounding add overflows past the window's last entry, so the nearest entry wraps too
+    if (!kLinear)
+        return inWindow.table[(inPhase + inWindow.halfEntry) >> inWindow.shift];
+    UInt32 index = inPhase >> inWindow.shift;
+    Float32 fraction = Float32(inPhase & inWindow.fractionMask) * inWindow.fractionScale;
+    Float32 a = inWindow.table[index], b = inWindow.table[(index + 1) & inWindow.mask];
+    return a + (b - a) * fraction;
+}
+
+template <bool kStereo, bool kLinear>
+static void RenderWavetableVoiceScalar(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                       Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    const ScalarWindow window(inBlock);
+    UInt32 phase = ioPhase, inc = inBlock.mIncrement;
+    const UInt32 step = UInt32(inBlock.mIncrementStep);
+    for (UInt32 frame = 0; frame < inNumFrames; ++frame) {
+        Float32 out = (ReadTable<kLinear>(window, phase) - inBlock.mOffset) * inBlock.mGain * inEnvelope[frame];
+        phase += inc;
+        inc += step;
+        ioLeft[frame] += out;
+        if (kStereo) ioRight[frame] += out;
+    }
+    ioPhase = phase;
+}
+
+template <bool kStereo>
+void RenderWavetableVoiceScalar(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    RenderWavetableVoiceScalar<kStereo, true>(inBlock, ioPhase, inEnvelope, ioLeft, ioRight, inNumFrames);
+}
+
+template void RenderWavetableVoiceScalar<false>(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
+template void RenderWavetableVoiceScalar<true>(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
+
+#if WAVETABLE_VOICE_X86
+
+// a block's window in the registers the SSE and AVX kernels index with
+struct WindowSSE
+{
+    explicit WindowSSE(const WavetableVoiceBlock &inBlock)
+        : shift(_mm_cvtsi32_si128(int(inBlock.mWindowShift))), mask(_mm_set1_epi32(inBlock.mWindowMask)),
+          fractionMask(_mm_set1_epi32((1U << inBlock.mWindowShift) - 1)), halfEntry(_mm_set1_epi32(1U << (inBlock.mWindowShift - 1))),
+          fractionScale(_mm_set1_ps(inBlock.mFractionScale)) {}
+
+    __m128i			shift, mask, fractionMask, halfEntry;
+    __m128			fractionScale;
+};
+
+// phase index and interpolation fraction of four lanes; the second index is wrapped to the window.
+static inline __m128 SplitPhaseSSE(const WindowSSE &inWindow, __m128i inPhase, SInt32 *outIndex0, SInt32 *outIndex1)
+{
+    __m128i index = _mm_srl_epi32(inPhase, inWindow.shift);
+    _mm_storeu_si128((__m128i *)outIndex0, index);
+    _mm_storeu_si128((__m128i *)outIndex1, _mm_and_si128(_mm_add_epi32(index, _mm_set1_epi32(1)), inWindow.mask));
+    __m128i fraction = _mm_and_si128(inPhase, inWindow.fractionMask);
+    return _mm_mul_ps(_mm_cvtepi32_ps(fraction), inWindow.fractionScale);
+}
+
+// the window's entries nearest the phases of four lanes
+static inline __m128 ReadNearestSSE(const WindowSSE &inWindow, const Float32 *inTable, __m128i inPhase)
+{
+    alignas(16) SInt32 index[4];
+    _mm_store_si128((__m128i *)index, _mm_srl_epi32(_mm_add_epi32(inPhase, inWindow.halfEntry), inWindow.shift));
+    return _mm_set_ps(inTable[index[3]], inTable[index[2]], inTable[index[1]], inTable[index[0]]);
+}
+
+template <bool kStereo, bool kLinear>
+static void RenderWavetableVoiceSSE(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                    Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    // lane k is sum(inc + j * step, j < k) ahead of the phase
+    UInt32 inc = inBlock.mIncrement;
+    const UInt32 step = UInt32(inBlock.mIncrementStep);
+    __m128i phaseStep = _mm_set_epi32(3 * inc + 3 * step, 2 * inc + step, inc, 0);
+    const __m128i phaseStepStep = _mm_set_epi32(12 * step, 8 * step, 4 * step, 0);
+    const __m128 offset = _mm_set1_ps(inBlock.mOffset), gain = _mm_set1_ps(inBlock.mGain);
+    const WindowSSE window(inBlock);
+    const Float32 *table = inBlock.mTable + inBlock.mWindowStart;
+
+    UInt32 phase = ioPhase;
+    UInt32 frame = 0;
+    for (; frame + 4 <= inNumFrames; frame += 4) {
+        __m128i p = _mm_add_epi32(_mm_set1_epi32(phase), phaseStep);
+        __m128 value;
+        if (kLinear) {
+            alignas(16) SInt32 i0[4], i1[4];
+            __m128 fraction = SplitPhaseSSE(window, p, i0, i1);
+            __m128 a = _mm_set_ps(table[i0[3]], table[i0[2]], table[i0[1]], table[i0[0]]);
+            __m128 b = _mm_set_ps(table[i1[3]], table[i1[2]], table[i1[1]], table[i1[0]]);
+            value = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction));
+        } else
+            value = ReadNearestSSE(window, table, p);
+
+        __m128 gainAmp = _mm_mul_ps(gain, _mm_loadu_ps(inEnvelope + frame));
+        __m128 out = _mm_mul_ps(_mm_sub_ps(value, offset), gainAmp);
+        _mm_storeu_ps(ioLeft + frame, _mm_add_ps(_mm_loadu_ps(ioLeft + frame), out));
+        if (kStereo) _mm_storeu_ps(ioRight + frame, _mm_add_ps(_mm_loadu_ps(ioRight + frame), out));
+
+        phase += 4 * inc + 6 * step;
+        inc += 4 * step;
+        phaseStep = _mm_add_epi32(phaseStep, phaseStepStep);
+    }
+    ioPhase = phase;
+    if (frame < inNumFrames) {
+        WavetableVoiceBlock tail = inBlock;
+        tail.mIncrement = inc;
+        RenderWavetableVoiceScalar<kStereo, kLinear>(tail, ioPhase, inEnvelope + frame, ioLeft + frame, kStereo ? ioRight + frame : NULL, inNumFrames - frame);
+    }
+}
+
+// the project builds for the SSE baseline; only this function may use AVX instructions.
+template <bool kStereo, bool kLinear>
+__attribute__((target("avx")))
+static void RenderWavetableVoiceAVX(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                    Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    // AVX1 has no 256-bit integer lanes, so the phase stage runs as two SSE halves
+    UInt32 inc = inBlock.mIncrement;
+    const UInt32 step = UInt32(inBlock.mIncrementStep);
+    __m128i phaseStepLo = _mm_set_epi32(3 * inc + 3 * step, 2 * inc + step, inc, 0);
+    __m128i phaseStepHi = _mm_set_epi32(7 * inc + 21 * step, 6 * inc + 15 * step, 5 * inc + 10 * step, 4 * inc + 6 * step);
+    const __m128i phaseStepStepLo = _mm_set_epi32(24 * step, 16 * step, 8 * step, 0);
+    const __m128i phaseStepStepHi = _mm_set_epi32(56 * step, 48 * step, 40 * step, 32 * step);
+    const __m256 offset = _mm256_set1_ps(inBlock.mOffset), gain = _mm256_set1_ps(inBlock.mGain);
+    const WindowSSE window(inBlock);
+    const Float32 *table = inBlock.mTable + inBlock.mWindowStart;
+
+    UInt32 phase = ioPhase;
+    UInt32 frame = 0;
+    for (; frame + 8 <= inNumFrames; frame += 8) {
+        __m128i p = _mm_set1_epi32(phase);
+        __m256 value;
+        if (kLinear) {
+            alignas(32) SInt32 i0[8], i1[8];
+            __m128 fractionLo = SplitPhaseSSE(window, _mm_add_epi32(p, phaseStepLo), i0, i1);
+            __m128 fractionHi = SplitPhaseSSE(window, _mm_add_epi32(p, phaseStepHi), i0 + 4, i1 + 4);
+            __m256 fraction = _mm256_insertf128_ps(_mm256_castps128_ps256(fractionLo), fractionHi, 1);
+            __m256 a = _mm256_set_ps(table[i0[7]], table[i0[6]], table[i0[5]], table[i0[4]],
+                                     table[i0[3]], table[i0[2]], table[i0[1]], table[i0[0]]);
+            __m256 b = _mm256_set_ps(table[i1[7]], table[i1[6]], table[i1[5]], table[i1[4]],
+                                     table[i1[3]], table[i1[2]], table[i1[1]], table[i1[0]]);
+            value = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fraction));
+        } else {
+            __m128 lo = ReadNearestSSE(window, table, _mm_add_epi32(p, phaseStepLo));
+            __m128 hi = ReadNearestSSE(window, table, _mm_add_epi32(p, phaseStepHi));
+            value = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+        }
+
+        __m256 gainAmp = _mm256_mul_ps(gain, _mm256_loadu_ps(inEnvelope + frame));
+        __m256 out = _mm256_mul_ps(_mm256_sub_ps(value, offset), gainAmp);
+        _mm256_storeu_ps(ioLeft + frame, _mm256_add_ps(_mm256_loadu_ps(ioLeft + frame), out));
+        if (kStereo) _mm256_storeu_ps(ioRight + frame, _mm256_add_ps(_mm256_loadu_ps(ioRight + frame), out));
+
+        phase += 8 * inc + 28 * step;
+        inc += 8 * step;
+        phaseStepLo = _mm_add_epi32(phaseStepLo, phaseStepStepLo);
+        phaseStepHi = _mm_add_epi32(phaseStepHi, phaseStepStepHi);
+    }
+    ioPhase = phase;
+    if (frame < inNumFrames) {
+        WavetableVoiceBlock tail = inBlock;
+        tail.mIncrement = inc;
+        RenderWavetableVoiceSSE<kStereo, kLinear>(tail, ioPhase, inEnvelope + frame, ioLeft + frame, kStereo ? ioRight + frame : NULL, inNumFrames - frame);
+    }
+}
+
+#endif // WAVETABLE_VOICE_X86
+
+#if WAVETABLE_VOICE_NEON
+
+template <bool kStereo, bool kLinear>
+static void RenderWavetableVoiceNEON(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                     Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    UInt32 inc = inBlock.mIncrement;
+    const UInt32 step = UInt32(inBlock.mIncrementStep);
+    const uint32_t kPhaseStep[4] = { 0, inc, 2 * inc + step, 3 * inc + 3 * step };
+    const uint32_t kPhaseStepStep[4] = { 0, 4 * step, 8 * step, 12 * step };
+    uint32x4_t phaseStep = vld1q_u32(kPhaseStep);
+    const uint32x4_t phaseStepStep = vld1q_u32(kPhaseStepStep);
+    const float32x4_t offset = vdupq_n_f32(inBlock.mOffset);
+    // a negative count shifts right
+    const int32x4_t shift = vdupq_n_s32(-SInt32(inBlock.mWindowShift));
+    const uint32x4_t mask = vdupq_n_u32(inBlock.mWindowMask), fractionMask = vdupq_n_u32((1U << inBlock.mWindowShift) - 1);
+    const uint32x4_t halfEntry = vdupq_n_u32(1U << (inBlock.mWindowShift - 1));
+    const Float32 fractionScale = inBlock.mFractionScale;
+    const Float32 *table = inBlock.mTable + inBlock.mWindowStart;
+
+    UInt32 phase = ioPhase;
+    UInt32 frame = 0;
+    for (; frame + 4 <= inNumFrames; frame += 4) {
+        uint32x4_t p = vaddq_u32(vdupq_n_u32(phase), phaseStep);
+        float32x4_t value;
+        if (kLinear) {
+            uint32x4_t index = vshlq_u32(p, shift);
+            float32x4_t fraction = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(p, fractionMask)), fractionScale);
+            uint32_t i0[4], i1[4];
+            vst1q_u32(i0, index);
+            vst1q_u32(i1, vandq_u32(vaddq_u32(index, vdupq_n_u32(1)), mask));
+            Float32 a[4] = { table[i0[0]], table[i0[1]], table[i0[2]], table[i0[3]] };
+            Float32 b[4] = { table[i1[0]], table[i1[1]], table[i1[2]], table[i1[3]] };
+            float32x4_t va = vld1q_f32(a);
+            value = vmlaq_f32(va, vsubq_f32(vld1q_f32(b), va), fraction);
+        } else {
+            uint32_t i0[4];
+            vst1q_u32(i0, vshlq_u32(vaddq_u32(p, halfEntry), shift));
+            Float32 a[4] = { table[i0[0]], table[i0[1]], table[i0[2]], table[i0[3]] };
+            value = vld1q_f32(a);
+        }
+
+        float32x4_t out = vmulq_f32(vmulq_n_f32(vsubq_f32(value, offset), inBlock.mGain), vld1q_f32(inEnvelope + frame));
+        vst1q_f32(ioLeft + frame, vaddq_f32(vld1q_f32(ioLeft + frame), out));
+        if (kStereo) vst1q_f32(ioRight + frame, vaddq_f32(vld1q_f32(ioRight + frame), out));
+
+        phase += 4 * inc + 6 * step;
+        inc += 4 * step;
+        phaseStep = vaddq_u32(phaseStep, phaseStepStep);
+    }
+    ioPhase = phase;
+    if (frame < inNumFrames) {
+        WavetableVoiceBlock tail = inBlock;
+        tail.mIncrement = inc;
+        RenderWavetableVoiceScalar<kStereo, kLinear>(tail, ioPhase, inEnvelope + frame, ioLeft + frame, kStereo ? ioRight + frame : NULL, inNumFrames - frame);
+    }
+}
+
+#endif // WAVETABLE_VOICE_NEON
+
+template <bool kStereo, bool kLinear>
+static WavetableVoiceKernel PickWavetableVoiceKernel()
+{
+#if WAVETABLE_VOICE_X86
+    if (CAVectorUnit::HasAVX1()) return RenderWavetableVoiceAVX<kStereo, kLinear>;
+    if (CAVectorUnit::HasSSE2()) return RenderWavetableVoiceSSE<kStereo, kLinear>;
+#elif WAVETABLE_VOICE_NEON
+    // NEON is part of every arm64 CPU, but CAVectorUnit only reports it when built with CA_ARM_NEON
+    return RenderWavetableVoiceNEON<kStereo, kLinear>;
+#endif
+    return RenderWavetableVoiceScalar<kStereo, kLinear>;
+}
+
+// picked at load time, so the render thread never pays for the sysctl or a static-init guard;
+// indexed by kLinear, then kStereo
+static const WavetableVoiceKernel sWavetableVoiceKernel[2][2] = {
+    { PickWavetableVoiceKernel<false, false>(), PickWavetableVoiceKernel<true, false>() },
+    { PickWavetableVoiceKernel<false, true>(), PickWavetableVoiceKernel<true, true>() }
+};
+
+template <bool kStereo>
+void RenderWavetableVoice(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                          Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    sWavetableVoiceKernel[true][kStereo](inBlock, ioPhase, inEnvelope, ioLeft, ioRight, inNumFrames);
+}
+
+template <bool kStereo>
+void RenderWavetableVoiceNearest(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                 Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    sWavetableVoiceKernel[false][kStereo](inBlock, ioPhase, inEnvelope, ioLeft, ioRight, inNumFrames);
+}
+
+template void RenderWavetableVoice<false>(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
+template void RenderWavetableVoice<true>(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
+template void RenderWavetableVoiceNearest<false>(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
+template void RenderWavetableVoiceNearest<true>(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
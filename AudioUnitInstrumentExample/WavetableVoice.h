@@ -0,0 +1,117 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Block renderer for one wavetable voice, with SSE, AVX and NEON paths
+ */
+
+#ifndef __WavetableVoice_h__
+#define __WavetableVoice_h__
+
+#include "LidarScanTable.h"
+#include <algorithm>
+
+// a window's length is the table's size >> octaves, down to 1 << kWavetableMinWindowBits entries
+static const UInt32 kWavetableMinWindowBits = 3;
+static const UInt32 kWavetableMaxWindowOctaves = kScanTableMaxBits - kWavetableMinWindowBits;
+
+/*
+ The part of the table one cycle of a voice reads, picked by a note whatever the size of the tables
+ it goes on to play: mOctaves shorter than the table, down to 1 << kWavetableMinWindowBits entries,
+ starting mPosition (0 to 1) of the way from the table's first entry to the last start that keeps
+ the window inside the table. WavetableVoiceBlock::SetWindow() places it in a table of a given size.
+ */
+struct WavetableWindow
+{
+    Float32			mPosition;
+    UInt32			mOctaves;
+};
+
+static const WavetableWindow kWavetableFullWindow = { 0.f, 0 };
+
+inline WavetableWindow WavetableWindowAt(Float32 inPosition, UInt32 inOctaves)
+{
+    WavetableWindow window = { std::min(std::max(inPosition, 0.f), 1.f), std::min(inOctaves, kWavetableMaxWindowOctaves) };
+    return window;
+}
+
+// how many octaves shorter than a table of inTableBits the window is
+inline UInt32 WavetableWindowOctaves(const WavetableWindow &inWindow, UInt32 inTableBits)
+{
+    return std::min(inWindow.mOctaves, inTableBits - kWavetableMinWindowBits);
+}
+
+// a window k octaves shorter than the table holds k octaves fewer of a level's harmonics per cycle,
+// so the level k brighter than the whole table's stays just as far under Nyquist
+inline UInt32 WavetableWindowLevel(UInt32 inTableLevel, const WavetableWindow &inWindow, UInt32 inTableBits)
+{
+    const UInt32 octaves = WavetableWindowOctaves(inWindow, inTableBits);
+    return inTableLevel > octaves ? inTableLevel - octaves : 0;
+}
+
+// everything a voice needs for one render call; the caller fills it in once per block.
+struct WavetableVoiceBlock
+{
+    const Float32 *	mTable;			// one level of a table, or a row of the morph history
+    Float32			mOffset;		// subtracted from every table value (the scan mean)
+    Float32			mGain;			// applied after the offset (inverse mean times volume)
+    UInt32			mIncrement;		// phase advance of the first frame, in units of 2^-32 of a cycle
+    SInt32			mIncrementStep;	// change of the phase advance from each frame to the next, for a glide
+    UInt32			mWindowStart;	// first table entry of the voice's window
+    UInt32			mWindowShift;	// 32 - the window's bits: the phase's top bits index the window
+    UInt32			mWindowMask;	// the window's length - 1
+    Float32			mFractionScale;	// 2^-mWindowShift, turning the phase's low bits into a fraction
+
+    /*
+     Places inWindow in mTable, 1 << inTableBits entries long. A voice's phase is a fraction of a
+     cycle of its window: its top bits index the window, the rest are the interpolation fraction, and
+     its 32-bit overflow wraps at the window's end, exactly as it does for the whole table; only the
+     shift and the mask change, so a voice keeps its phase from a table of one size to another.
+     */
+    void			SetWindow(const WavetableWindow &inWindow, UInt32 inTableBits)
+    {
+        const UInt32 bits = inTableBits - WavetableWindowOctaves(inWindow, inTableBits);
+        mWindowStart = UInt32(inWindow.mPosition * Float32((1U << inTableBits) - (1U << bits)) + 0.5f);
+        mWindowShift = 32 - bits;
+        mWindowMask = (1U << bits) - 1;
+        mFractionScale = 1.f / Float32(1U << mWindowShift);
+    }
+};
+
+// phase increment for a frequency, in cycles per frame; above Nyquist it is pinned to Nyquist
+inline UInt32 WavetablePhaseIncrement(double inCyclesPerFrame)
+{
+    return UInt32(std::min(std::max(inCyclesPerFrame, 0.), 0.5) * 4294967296.0);
+}
+
+/*
+ Renders inNumFrames frames of one voice and accumulates them into ioLeft, and into ioRight as well
+ when kStereo is true; ioRight is not touched otherwise.
+ ioPhase is a 32-bit fixed-point fraction of a cycle, so it wraps by overflowing, and is advanced
+ past the block on return. inEnvelope holds the amplitude of every frame (see VoiceEnvelope). The
+ phase advance ramps linearly by inBlock.mIncrementStep a frame; a vector kernel carries the ramp's
+ second-order term in its lane offsets, so a glide costs one more add per step.
+
+ Each frame reads the block's window of the table with linear interpolation between neighbouring
+ entries, wrapping at the window's end. RenderWavetableVoice() picks the widest kernel the CPU has, once, through CAVectorUnit: AVX
+ for eight frames per step, SSE2 or NEON for four, otherwise the scalar reference, which is also
+ exported so the vector kernels can be checked against it.
+
+ RenderWavetableVoiceNearest() reads the entry nearest the phase instead, one read a frame rather
+ than two, for an instrument shedding load; the table's steps then show up as aliasing.
+ */
+typedef void (*WavetableVoiceKernel)(const WavetableVoiceBlock &, UInt32 &, const Float32 *, Float32 *, Float32 *, UInt32);
+
+template <bool kStereo>
+void RenderWavetableVoice(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                          Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames);
+
+template <bool kStereo>
+void RenderWavetableVoiceNearest(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                 Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames);
+
+template <bool kStereo>
+void RenderWavetableVoiceScalar(const WavetableVoiceBlock &inBlock, UInt32 &ioPhase, const Float32 *inEnvelope,
+                                Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames);
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Structure-of-arrays oscillator and envelope state for every voice of an instrument
+ */
+
+#include "WavetableVoiceBank.h"
+
+void WavetableVoiceBank::Resize(UInt32 inCount)
+{
+    mPhase.assign(inCount, 0);
+    mIncrement.assign(inCount, 0);
+    mTable.assign(inCount, kFullScanTable);
+    mTableLevel.assign(inCount, 0);
+    mFrozen.assign(inCount, NULL);
+    mWindow.assign(inCount, kWavetableFullWindow);
+    mEnvelope.assign(inCount, VoiceEnvelope());
+    mStep.assign(inCount, 0.f);
+    mMode.assign(inCount, UInt8(kVoiceEnvelope_Rising));
+}
+
+void WavetableVoiceBank::SetUpBlock(const LidarScanZones &inZones, UInt32 inSlot, bool inMorph,
+                                    Float32 *ioMorphed, WavetableVoiceBlock &ioBlock) const
+{
+    const LidarScanTable &table = inZones.Table(mTable[inSlot]);
+    // the level is picked for the largest table; each table, and the history, maps it onto its own size
+    const UInt32 bits = inMorph ? mMorphHistory->Bits() : table.Bits();
+    const UInt32 level = WavetableWindowLevel(ScanTableLevel(mTableLevel[inSlot], bits), mWindow[inSlot], bits);
+    if (inMorph) {
+        // the history's rows are already normalized
+        mMorphHistory->Blend(mTable[inSlot], level, mMorphTime, ioMorphed);
+        ioBlock.mOffset = 0.f;
+        ioBlock.mGain = 1.f;
+        ioBlock.mTable = ioMorphed;
+    } else if (mEngine == kOscillatorEngine_Spectral) {
+        // a spectral table already has no DC and a peak of at most 1
+        ioBlock.mOffset = 0.f;
+        ioBlock.mGain = 1.f;
+        ioBlock.mTable = table.mSpectrum[level];
+    } else {
+        // each zone's table is normalized by the statistics of its own sector
+        ioBlock.mOffset = table.mStats.mMean;
+        ioBlock.mGain = table.mStats.mInverseMean;
+        ioBlock.mTable = table.mLevel[level];
+    }
+    ioBlock.mIncrement = mIncrement[inSlot];
+    ioBlock.mIncrementStep = 0;
+    ioBlock.SetWindow(mWindow[inSlot], bits);
+}
+
+// a slot's increment under a bend ratio, pinned to Nyquist like WavetablePhaseIncrement()
+static inline UInt32 BentIncrement(UInt32 inIncrement, Float32 inRatio)
+{
+    return UInt32(std::min(Float64(inIncrement) * inRatio, 2147483648.0));
+}
+
+// returns the first frame of the block that starts below the audibility floor on the way down, or
+// inNumFrames if there is none
+template <VoiceEnvelopeMode kMode, bool kStereo>
+UInt32 WavetableVoiceBank::RenderSlot(WavetableVoiceBlock &ioBlock, WavetableVoiceBlock *ioFromBlock,
+                                      const SmoothedParameter &inVolume, const ControlRateModulation &inModulation,
+                                      UInt32 inCycleFrame, UInt32 inSlot, UInt32 inOversampling,
+                                      Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames)
+{
+    Float32 ramp[kVoiceEnvelopeMaxFrames];
+    Float32 fromRamp[kVoiceEnvelopeMaxFrames];
+    VoiceEnvelope &envelope = mEnvelope[inSlot];
+    const Float32 step = mStep[inSlot];
+    const UInt32 increment = mIncrement[inSlot];
+    UInt32 phase = mPhase[inSlot];
+    UInt32 endFrame = inNumFrames;
+    const UInt32 transitionPosition = mTransitionPosition * inOversampling;
+    const UInt32 transitionFrames = mTransitionFrames * inOversampling;
+    const WavetableVoiceKernel render = mLinear ? RenderWavetableVoice<kStereo> : RenderWavetableVoiceNearest<kStereo>;
+    // settled, the modulation is a constant increment and gain, folded into the blocks
+    const bool gliding = !inModulation.IsStatic();
+    // the envelope's floor is the mix's over the loudest the volume and the gain get in this block, so
+    // a release is only cut short once it is inaudible all the way through
+    const Float32 envelopeFloor = kMode == kVoiceEnvelope_Falling && mFloor > 0.f
+        ? VoiceEnvelope::Floor(mFloor, std::max(inVolume.Start(), inVolume.Value()) * inModulation.MaxGain()) : 0.f;
+    if (!gliding) {
+        ioBlock.mIncrement = BentIncrement(increment, inModulation.Ratio(0));
+        ioBlock.mGain *= inModulation.Gain(0);
+        if (ioFromBlock != NULL) {
+            ioFromBlock->mIncrement = ioBlock.mIncrement;
+            ioFromBlock->mGain *= inModulation.Gain(0);
+        }
+    }
+    const UInt32 periodFrames = kControlRateFrames * inOversampling;
+    const UInt32 cycleStart = inCycleFrame * inOversampling;
+    for (UInt32 frame = 0; frame < inNumFrames; frame += kVoiceEnvelopeMaxFrames) {
+        UInt32 numFrames = std::min(inNumFrames - frame, kVoiceEnvelopeMaxFrames);
+        UInt32 sounding = envelope.Ramp<kMode>(step, ramp, numFrames, envelopeFloor);
+        inVolume.Apply(ramp, frame, numFrames);
+        if (kMode == kVoiceEnvelope_Falling && sounding < numFrames)
+            endFrame = std::min(endFrame, frame + sounding);
+        UInt32 position = transitionPosition + frame;
+        const bool fading = ioFromBlock != NULL && position < transitionFrames;
+        if (fading) {
+            // split the ramp between the two tables; both start from the same phase
+            const Float32 scale = 1.f / Float32(transitionFrames);
+            for (UInt32 i = 0; i < numFrames; ++i) {
+                Float32 fade = std::min(Float32(position + i) * scale, 1.f);
+                fromRamp[i] = ramp[i] * (1.f - fade);
+                ramp[i] *= fade;
+            }
+        }
+        // gliding, each control period's share of the block ramps the increment and the gain on its own
+        for (UInt32 start = 0, length = 0; start < numFrames; start += length) {
+            length = numFrames - start;
+            if (gliding) {
+                const UInt32 cyclePosition = cycleStart + frame + start;
+                const UInt32 point = std::min(cyclePosition / periodFrames, inModulation.NumPoints() - 2);
+                const UInt32 periodEnd = point * periodFrames + inModulation.PeriodFrames(point) * inOversampling;
+                if (periodEnd > cyclePosition)
+                    length = std::min(length, periodEnd - cyclePosition);
+                const Float32 into = Float32(cyclePosition - point * periodFrames);
+                const Float32 scale = 1.f / Float32(inModulation.PeriodFrames(point) * inOversampling);
+                const Float32 ratio = inModulation.Ratio(point), ratioStep = (inModulation.Ratio(point + 1) - ratio) * scale;
+                const Float32 gain = inModulation.Gain(point), gainStep = (inModulation.Gain(point + 1) - gain) * scale;
+                const UInt32 first = BentIncrement(increment, ratio + ratioStep * into);
+                const UInt32 last = BentIncrement(increment, ratio + ratioStep * (into + Float32(length)));
+                ioBlock.mIncrement = first;
+                ioBlock.mIncrementStep = SInt32((SInt64(last) - SInt64(first)) / SInt64(length));
+                for (UInt32 i = 0; i < length; ++i) {
+                    const Float32 level = gain + gainStep * (into + Float32(i));
+                    ramp[start + i] *= level;
+                    if (fading) fromRamp[start + i] *= level;
+                }
+                if (ioFromBlock != NULL) {
+                    ioFromBlock->mIncrement = ioBlock.mIncrement;
+                    ioFromBlock->mIncrementStep = ioBlock.mIncrementStep;
+                }
+            }
+            Float32 *left = ioLeft + frame + start, *right = kStereo ? ioRight + frame + start : NULL;
+            if (fading) {
+                UInt32 fromPhase = phase;
+                render(*ioFromBlock, fromPhase, fromRamp + start, left, right, length);
+            }
+            render(ioBlock, phase, ramp + start, left, right, length);
+        }
+    }
+    mPhase[inSlot] = phase;
+    return endFrame;
+}
+
+template <bool kStereo>
+void WavetableVoiceBank::Render(const LidarScanZones &inZones, const SmoothedParameter &inVolume,
+                                const ControlRateModulation &inModulation, UInt32 inCycleFrame, const UInt32 *inSlots, UInt32 inNumSlots, UInt32 *outEndFrames,
+                                Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames, UInt32 inOversampling)
+{
+    WavetableVoiceBlock block, fromBlock;
+    Float32 morphed[kScanTableMaxSize];
+    const bool morph = mMorphHistory != NULL && mMorphTime > 0.f && mMorphHistory->Count() > 0;
+    const bool transition = !morph && mTransitionFrom != NULL && mTransitionPosition < mTransitionFrames;
+    for (UInt32 i = 0; i < inNumSlots; ++i) {
+        UInt32 slot = inSlots[i];
+        WavetableVoiceBlock *from = NULL;
+        if (mFrozen[slot] != NULL) {
+            SetUpBlock(*mFrozen[slot], slot, false, NULL, block);
+        } else {
+            SetUpBlock(inZones, slot, morph, morphed, block);
+            if (transition) {
+                SetUpBlock(*mTransitionFrom, slot, false, NULL, fromBlock);
+                from = &fromBlock;
+            }
+        }
+        outEndFrames[i] = mMode[slot] == kVoiceEnvelope_Rising
+            ? RenderSlot<kVoiceEnvelope_Rising, kStereo>(block, from, inVolume, inModulation, inCycleFrame, slot, inOversampling,
+                                                         ioLeft, ioRight, inNumFrames)
+            : RenderSlot<kVoiceEnvelope_Falling, kStereo>(block, from, inVolume, inModulation, inCycleFrame, slot, inOversampling,
+                                                          ioLeft, ioRight, inNumFrames);
+    }
+}
+
+template void WavetableVoiceBank::Render<false>(const LidarScanZones &, const SmoothedParameter &, const ControlRateModulation &, UInt32,
+                                               const UInt32 *, UInt32, UInt32 *, Float32 *, Float32 *, UInt32, UInt32);
+template void WavetableVoiceBank::Render<true>(const LidarScanZones &, const SmoothedParameter &, const ControlRateModulation &, UInt32,
+                                              const UInt32 *, UInt32, UInt32 *, Float32 *, Float32 *, UInt32, UInt32);
@@ -0,0 +1,151 @@
+/*
+ See LICENSE.txt for this sample’s licensing information
+
+ Abstract:
+ Structure-of-arrays oscillator and envelope state for every voice of an instrument
+ */
+
+#ifndef __WavetableVoiceBank_h__
+#define __WavetableVoiceBank_h__
+
+#include "WavetableVoice.h"
+#include "ScanZones.h"
+#include "ScanHistory.h"
+#include "VoiceEnvelope.h"
+#include "SmoothedParameter.h"
+#include "ControlRateModulation.h"
+#include <vector>
+
+// voices a caller gathers per Render() call, which bounds its stack arrays of slots and end frames
+static const UInt32 kWavetableVoiceBatch = 64;
+
+/*
+ WavetableVoiceBank holds what a single-oscillator voice needs from one render call to the next,
+ in one contiguous array per field, with one slot per note. A note keeps only its slot number, so a
+ group's whole share of voices renders in one Render() call that walks the arrays instead of chasing
+ note pointers and making a virtual call per voice.
+
+ Resize() allocates and must only be called off the render thread, while the AU is uninitialized.
+ Everything else is real-time safe. Different slots may be set up and rendered concurrently.
+ */
+class WavetableVoiceBank
+{
+public:
+    WavetableVoiceBank() : mEngine(kOscillatorEngine_Waveform), mMorphHistory(NULL), mMorphTime(0.f),
+                           mTransitionFrom(NULL), mTransitionPosition(0), mTransitionFrames(0), mFloor(0.f), mLinear(true) {}
+
+    void			Resize(UInt32 inCount);
+    UInt32			Count() const { return UInt32(mPhase.size()); }
+
+    // like Resize(), only while the AU is uninitialized
+    void			SetEngine(OscillatorEngine inEngine) { mEngine = inEngine; }
+
+    // per render call: with inTime above 0 every voice plays a blend of inHistory's scans, inTime of
+    // the way back to the oldest, instead of the current one (see ScanHistory::Blend)
+    void			SetMorph(const ScanHistory *inHistory, Float32 inTime)
+    {
+        mMorphHistory = inHistory;
+        mMorphTime = inTime;
+    }
+
+    // per render call: false reads each voice's nearest table entry rather than interpolating (see
+    // RenderWavetableVoiceNearest), for an instrument shedding load
+    void			SetLinearInterpolation(bool inLinear) { mLinear = inLinear; }
+
+    // per render call: the linear level, relative to full scale after the volume and the channel's
+    // gain, below which a releasing voice is taken to be inaudible and ends; 0 releases to silence
+    void			SetAudibilityFloor(Float32 inFloor) { mFloor = inFloor; }
+
+    // per render slice: with inFrom not NULL every voice fades from its table of inFrom to its table
+    // of the current scan, the slice starting inPosition frames into a fade of inFrames. inFrom must
+    // stay valid until the fade is over. A morph takes precedence.
+    void			SetTransition(const LidarScanZones *inFrom, UInt32 inPosition, UInt32 inFrames)
+    {
+        mTransitionFrom = inFrom;
+        mTransitionPosition = inPosition;
+        mTransitionFrames = inFrames;
+    }
+
+    // restarts a slot at phase 0, reading mip-map level inTableLevel of LidarScanZones table inTable,
+    // as ScanTableLevelForFrequency picks it for the largest table, its envelope rising towards inPeak.
+    // With inFrozen not NULL the slot reads that snapshot instead of the current one, with no morph or
+    // transition, until Start() or Unfreeze(); it must stay valid until then. Each cycle of the slot
+    // plays inWindow of the table (see WavetableWindow), whichever scan, morph or transition it reads.
+    void			Start(UInt32 inSlot, UInt32 inTable, UInt32 inTableLevel, Float32 inPeak,
+                          const LidarScanZones *inFrozen = NULL, const WavetableWindow &inWindow = kWavetableFullWindow)
+    {
+        mPhase[inSlot] = 0;
+        mTable[inSlot] = inTable;
+        mTableLevel[inSlot] = inTableLevel;
+        mFrozen[inSlot] = inFrozen;
+        mWindow[inSlot] = inWindow;
+        mEnvelope[inSlot].Start(inPeak);
+    }
+    void			Unfreeze(UInt32 inSlot) { mFrozen[inSlot] = NULL; }
+
+    UInt32			Table(UInt32 inSlot) const { return mTable[inSlot]; }
+    Float32			Level(UInt32 inSlot) const { return mEnvelope[inSlot].Level(); }
+    Float32			Peak(UInt32 inSlot) const { return mEnvelope[inSlot].Peak(); }
+
+    // per render call: the phase increment before any pitch bend, and the envelope's direction and
+    // speed (see VoiceEnvelope::Step)
+    void			SetBlock(UInt32 inSlot, UInt32 inIncrement, VoiceEnvelopeMode inMode, Float32 inStep)
+    {
+        mIncrement[inSlot] = inIncrement;
+        mMode[inSlot] = UInt8(inMode);
+        mStep[inSlot] = inStep;
+    }
+
+    /*
+     Renders the inNumSlots slots listed in inSlots, each from its own table of inZones, scaled by
+     inVolume's ramp for this block, and accumulates them into ioLeft, and into ioRight as well when kStereo is true. outEndFrames[i] receives the first frame at which slot inSlots[i]
+     starts below the audibility floor on its way down, or inNumFrames if it is still sounding. During a
+     transition each slot also renders its table of the previous scan, at the same phase, and the two
+     are crossfaded linearly. inOversampling is how many of inNumFrames make one frame of the
+     transition; the increments, envelope steps and volume ramp must already be at that rate.
+
+     Every slot's increment is scaled by inModulation's bend ratio and its level by its gain, both
+     ramping linearly between the control points; the block starts inCycleFrame output frames into
+     the render cycle the modulation was evaluated for. While the modulation moves, each slot's
+     kernel runs once per control period rather than once per envelope block.
+     */
+    template <bool kStereo>
+    void			Render(const LidarScanZones &inZones, const SmoothedParameter &inVolume,
+                           const ControlRateModulation &inModulation, UInt32 inCycleFrame,
+                           const UInt32 *inSlots, UInt32 inNumSlots, UInt32 *outEndFrames,
+                           Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames, UInt32 inOversampling = 1);
+
+private:
+    // points ioBlock at the slot's table of inZones, or at its blend of the morph history in ioMorphed
+    void			SetUpBlock(const LidarScanZones &inZones, UInt32 inSlot, bool inMorph,
+                               Float32 *ioMorphed, WavetableVoiceBlock &ioBlock) const;
+
+    template <VoiceEnvelopeMode kMode, bool kStereo>
+    UInt32			RenderSlot(WavetableVoiceBlock &ioBlock, WavetableVoiceBlock *ioFromBlock,
+                               const SmoothedParameter &inVolume, const ControlRateModulation &inModulation,
+                               UInt32 inCycleFrame, UInt32 inSlot, UInt32 inOversampling,
+                               Float32 *ioLeft, Float32 *ioRight, UInt32 inNumFrames);
+
+    WavetableVoiceBank(const WavetableVoiceBank &);
+    WavetableVoiceBank & operator=(const WavetableVoiceBank &);
+
+    std::vector<UInt32>			mPhase;			// fixed-point fraction of a cycle; see WavetableVoice.h
+    std::vector<UInt32>			mIncrement;
+    std::vector<UInt32>			mTable;			// LidarScanZones table picked for the note's zone at attack
+    std::vector<UInt32>			mTableLevel;	// mip-map level of the largest table, picked for the note's pitch at attack
+    std::vector<const LidarScanZones *>	mFrozen;	// the snapshot pinned at attack, or NULL
+    std::vector<WavetableWindow>	mWindow;	// picked at attack
+    std::vector<VoiceEnvelope>	mEnvelope;
+    std::vector<Float32>		mStep;
+    std::vector<UInt8>			mMode;			// VoiceEnvelopeMode
+    OscillatorEngine			mEngine;
+    const ScanHistory *			mMorphHistory;
+    Float32						mMorphTime;
+    const LidarScanZones *		mTransitionFrom;
+    UInt32						mTransitionPosition;
+    UInt32						mTransitionFrames;
+    Float32						mFloor;			// SetAudibilityFloor()
+    bool						mLinear;
+};
+
+#endif
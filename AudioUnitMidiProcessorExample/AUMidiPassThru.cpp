@@ -9,20 +9,29 @@ MIDI Processor AU
 #include "AUMidiPassThru.h"
 
 static const int kMIDIPacketListSize = 2048;
+static const UInt32 kOutputEventFIFOSize = 512;		// a power of two; 4 KB of events
 
 AUDIOCOMPONENT_ENTRY(AUMIDIEffectFactory, AUMidiPassThru)
 
+// bytes of the list buffer in use, given the last packet MIDIPacketListAdd returned
+static UInt32 PacketListBytes(const MIDIPacketList* inList, const MIDIPacket* inLastPacket)
+{
+    const Byte* end = inLastPacket->data + inLastPacket->length;
+    return UInt32(end - (const Byte*)inList);
+}
+
 #pragma mark AUMidiPassThru
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	AUMidiPassThru::SetProperty
 //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-AUMidiPassThru::AUMidiPassThru(AudioUnit component) : AUMIDIEffectBase(component), mOutputPacketFIFO(LockFreeFIFO<MIDIPacket>(32))
+AUMidiPassThru::AUMidiPassThru(AudioUnit component) : AUMIDIEffectBase(component), mOutputEventFIFO(kOutputEventFIFOSize)
 {
 	CreateElements();
     
     mMIDIOutCB.midiOutputCallback = nullptr;
+    memset(&mOutputStatistics, 0, sizeof(mOutputStatistics));
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -33,6 +42,18 @@ AUMidiPassThru::~AUMidiPassThru()
 {
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AUMidiPassThru::Initialize
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus AUMidiPassThru::Initialize()
+{
+    OSStatus result = AUMIDIEffectBase::Initialize();
+    if (result == noErr)
+        memset(&mOutputStatistics, 0, sizeof(mOutputStatistics));
+    return result;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	AUMidiPassThru::SetProperty
 //
@@ -52,6 +73,11 @@ OSStatus AUMidiPassThru::GetPropertyInfo(AudioUnitPropertyID inID, AudioUnitScop
                 outWritable = true;
                 outDataSize = sizeof(AUMIDIOutputCallbackStruct);
                 return noErr;
+                
+            case kAudioUnitCustomProperty_MIDIOutputStatistics:
+                outWritable = false;
+                outDataSize = sizeof(AUMidiPassThruOutputStatistics);
+                return noErr;
         }
 	}
 	return AUMIDIEffectBase::GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
@@ -68,11 +94,17 @@ OSStatus AUMidiPassThru::GetProperty( AudioUnitPropertyID inID, AudioUnitScope i
         switch (inID)
 		{
             case kAudioUnitProperty_MIDIOutputCallbackInfo:
+            {
                 CFStringRef string = CFSTR("midiOut");
                 CFArrayRef array = CFArrayCreate(kCFAllocatorDefault, (const void**)&string, 1, nullptr);
                 CFRelease(string);
                 *((CFArrayRef*)outData) = array;
                 return noErr;
+            }
+                
+            case kAudioUnitCustomProperty_MIDIOutputStatistics:
+                *((AUMidiPassThruOutputStatistics*)outData) = mOutputStatistics;
+                return noErr;
 		}
 	}
 	return AUMIDIEffectBase::GetProperty(inID, inScope, inElement, outData);
@@ -105,18 +137,20 @@ OSStatus AUMidiPassThru::HandleMidiEvent(UInt8 status, UInt8 channel, UInt8 data
 {
     if (!IsInitialized()) return kAudioUnitErr_Uninitialized;
   
-    MIDIPacket* packet = mOutputPacketFIFO.WriteItem();
-    mOutputPacketFIFO.AdvanceWritePtr();
-    
-    if (packet == NULL)
+    // a full FIFO drops the event; it must not be advanced over the reader
+    MIDIEventRecord* event = mOutputEventFIFO.WriteItem();
+    if (event == NULL)
+    {
+        CAAtomicIncrement32((volatile SInt32*)&mOutputStatistics.mDroppedEvents);
         return kAudioUnitErr_FailedInitialization;
+    }
     
-    memset(packet->data, 0, sizeof(Byte)*256);
-    packet->length = 3;
-    packet->data[0] = status | channel;
-    packet->data[1] = data1;
-    packet->data[2] = data2;
-    packet->timeStamp = inOffsetSampleFrame;
+    event->mOffsetSampleFrame = inOffsetSampleFrame;
+    event->mLength = 3;
+    event->mData[0] = status | channel;
+    event->mData[1] = data1;
+    event->mData[2] = data2;
+    mOutputEventFIFO.AdvanceWritePtr();
     
 	return noErr;
 }
@@ -130,28 +164,51 @@ OSStatus AUMidiPassThru::Render (AudioUnitRenderActionFlags &ioActionFlags, cons
     Byte listBuffer[kMIDIPacketListSize];
     MIDIPacketList* packetList = (MIDIPacketList*)listBuffer;
     MIDIPacket* packetListIterator = MIDIPacketListInit(packetList);
+    UInt32 cycleBytes = 0;
   
-    MIDIPacket* packet = mOutputPacketFIFO.ReadItem();
-    while (packet != NULL)
+    // take every event queued so far in one pass and release them all at once
+    UInt32 numEvents = mOutputEventFIFO.ReadableItems();
+    for (UInt32 i = 0; i < numEvents; ++i)
     {
         //----------------------------------------------------------------------//
         // This is where the midi packets get processed
         //
         //----------------------------------------------------------------------//
         
-        if (packetListIterator == NULL) return noErr;
-        packetListIterator = MIDIPacketListAdd(packetList, kMIDIPacketListSize, packetListIterator, packet->timeStamp, packet->length, packet->data);
-        mOutputPacketFIFO.AdvanceReadPtr();
-        packet = mOutputPacketFIFO.ReadItem();
+        const MIDIEventRecord* event = mOutputEventFIFO.ReadItemAt(i);
+        MIDIPacket* next = MIDIPacketListAdd(packetList, kMIDIPacketListSize, packetListIterator, event->mOffsetSampleFrame, event->mLength, event->mData);
+        if (next == NULL)
+        {
+            // the list is full: send it and carry on with this event in a fresh list, within this cycle
+            cycleBytes += PacketListBytes(packetList, packetListIterator);
+            if (mMIDIOutCB.midiOutputCallback != NULL)
+            {
+                mMIDIOutCB.midiOutputCallback(mMIDIOutCB.userData, &inTimeStamp, 0, packetList);
+                ++mOutputStatistics.mPacketListsSent;
+            }
+            ++mOutputStatistics.mOverflowFlushes;
+            packetListIterator = MIDIPacketListInit(packetList);
+            next = MIDIPacketListAdd(packetList, kMIDIPacketListSize, packetListIterator, event->mOffsetSampleFrame, event->mLength, event->mData);
+        }
+        packetListIterator = next;
     }
+    mOutputEventFIFO.AdvanceReadPtr(numEvents);
     
-    if (mMIDIOutCB.midiOutputCallback != NULL && packetList->numPackets > 0)
+    if (packetList->numPackets > 0)
     {
-        mMIDIOutCB.midiOutputCallback(mMIDIOutCB.userData, &inTimeStamp, 0, packetList);
+        cycleBytes += PacketListBytes(packetList, packetListIterator);
+        if (mMIDIOutCB.midiOutputCallback != NULL)
+        {
+            mMIDIOutCB.midiOutputCallback(mMIDIOutCB.userData, &inTimeStamp, 0, packetList);
+            ++mOutputStatistics.mPacketListsSent;
+        }
     }
+    
+    mOutputStatistics.mEventsSent += numEvents;
+    if (numEvents > mOutputStatistics.mMaxEventsPerCycle)
+        mOutputStatistics.mMaxEventsPerCycle = numEvents;
+    if (cycleBytes > mOutputStatistics.mMaxPacketListBytesPerCycle)
+        mOutputStatistics.mMaxPacketListBytesPerCycle = cycleBytes;
       
     return noErr;
 }
-
-
-
@@ -13,8 +13,36 @@ MIDI Processor AU
 #include <CoreMIDI/CoreMIDI.h>
 #include "AUMIDIEffectBase.h"
 #include "LockFreeFIFO.h"
+#include "CAAtomic.h"
 
 
+// custom properties id's must be 64000 or greater
+// see <AudioUnit/AudioUnitProperties.h> for a list of Apple-defined standard properties
+enum
+{
+    // read-only, global scope: AUMidiPassThruOutputStatistics counted since the AU was last initialized
+    kAudioUnitCustomProperty_MIDIOutputStatistics = 65536
+};
+
+// what Render has sent to the MIDI output callback, for sizing kMIDIPacketListSize to the traffic
+struct AUMidiPassThruOutputStatistics
+{
+    UInt64 mEventsSent;
+    UInt64 mPacketListsSent;        // callbacks, including the flushes below
+    UInt32 mOverflowFlushes;        // lists sent before the end of a cycle because the list buffer was full
+    UInt32 mDroppedEvents;          // events HandleMidiEvent turned away because the event FIFO was full
+    UInt32 mMaxEventsPerCycle;
+    UInt32 mMaxPacketListBytesPerCycle; // list buffer one cycle's events need to go in a single callback
+};
+
+// one queued 1-3 byte MIDI message; Render packs a cycle's worth into a MIDIPacketList at once
+struct MIDIEventRecord
+{
+    UInt32 mOffsetSampleFrame;
+    UInt8 mLength;
+    UInt8 mData[3];
+};
+
 #pragma mark - AUMidiPassThru
 class AUMidiPassThru : public AUMIDIEffectBase
 {
@@ -22,6 +50,8 @@ public:
 	AUMidiPassThru(AudioUnit component);
 	virtual ~AUMidiPassThru();
 
+	virtual OSStatus Initialize();
+
 	virtual OSStatus GetPropertyInfo(AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement, UInt32& outDataSize, Boolean& outWritable );
 
 	virtual OSStatus GetProperty(AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement, void* outData);
@@ -39,7 +69,10 @@ public:
 private:
     AUMIDIOutputCallbackStruct mMIDIOutCB;
   
-    LockFreeFIFO<MIDIPacket> mOutputPacketFIFO;
+    LockFreeFIFO<MIDIEventRecord> mOutputEventFIFO;
+    
+    // written by the render thread, except mDroppedEvents which HandleMidiEvent counts atomically
+    AUMidiPassThruOutputStatistics mOutputStatistics;
   
 };
 
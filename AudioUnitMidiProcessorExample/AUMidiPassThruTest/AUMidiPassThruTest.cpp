@@ -11,12 +11,35 @@ See LICENSE.txt for this sample’s licensing information
  In this example, the rendering chain consists of a DLS synth AU and Default Output AU connected
  using an AUGraph. Each midi note is first processed by the midi processor AU and then handed over 
  to the DLS synth AU which renders it to audio.
+ 
+ Run with --benchmark to use it as a load generator instead. No graph or output device is used:
+ the midi processor is rendered offline, buffer after buffer, while events are scheduled at a
+ steady rate in sample time, mixed notes (on/off pairs) and control changes, and the events that
+ come back through the midi output callback are matched in order against the ones sent. It
+ reports the time each render call took against the buffer's duration, the latency of every
+ event from MusicDeviceMIDIEvent to the output callback, any change in its start frame, and the
+ events the unit refused, lost or reordered. Options:
+ 
+	--rate N			events per second of audio (default 10000)
+	--cc-percent N		share of control changes, the rest being notes (default 50)
+	--seconds N			length of audio to render (default 10)
+	--frames N			frames per render call (default 512)
+	--sample-rate N		(default 44100)
+	--subtype XXXX		four-char subtype of the midi processor to load (default AUMidiPassThru's)
+	--manufacturer XXXX	(default appl)
+ 
+ The tool exits with status 1 if any event was dropped, lost or out of order.
 */
 
 #include <AudioToolbox/AudioToolbox.h>
 #include <CoreFoundation/CoreFoundation.h>
 #include <CoreMIDI/CoreMIDI.h>
+#include <mach/mach_time.h>
+#include <math.h>
+#include <algorithm>
 #include <deque>
+#include <string.h>
+#include <vector>
 
 #include "CAXException.h"
 #include "AUMidiPassThruVersion.h"
@@ -25,6 +48,7 @@ enum
 {
     kMidiMessage_NoteOff 			= 0x80,
 	kMidiMessage_NoteOn 			= 0x90,
+	kMidiMessage_ControlChange 		= 0xB0,
 };
 
 
@@ -130,8 +154,312 @@ end:
     exit(err);
 }
 
+#pragma mark - Benchmark
+
+// AUMidiPassThru's read-only statistics property (see AUMidiPassThru.h); other units won't have it
+enum
+{
+    kAudioUnitCustomProperty_MIDIOutputStatistics = 65536
+};
+
+struct AUMidiPassThruOutputStatistics
+{
+    UInt64 mEventsSent;
+    UInt64 mPacketListsSent;
+    UInt32 mOverflowFlushes;
+    UInt32 mDroppedEvents;
+    UInt32 mMaxEventsPerCycle;
+    UInt32 mMaxPacketListBytesPerCycle;
+};
+
+struct BenchmarkOptions
+{
+    Float64     mEventRate = 10000;
+    UInt32      mCCPercent = 50;
+    Float64     mSeconds = 10;
+    UInt32      mFrames = 512;
+    Float64     mSampleRate = 44100;
+    OSType      mSubType = AUMidiPassThru_COMP_SUBTYPE;
+    OSType      mManufacturer = kAudioUnitManufacturer_Apple;
+};
+
+// an event that was accepted by the midi processor and has not come back yet
+struct PendingEvent
+{
+    Float64     mSampleTime;        // the frame it was scheduled for
+    UInt64      mSendTime;          // host time just before MusicDeviceMIDIEvent
+    Byte        mData[3];
+};
+
+struct BenchmarkState
+{
+    std::deque<PendingEvent>    mPending;
+    Float64                     mCycleSampleTime = 0;   // start of the render call in progress
+    std::vector<Float64>        mLatencies;             // seconds, send to output callback
+    UInt64                      mReceived = 0;
+    UInt64                      mMismatched = 0;        // came back out of order, altered or unexpected
+    UInt64                      mRetimed = 0;           // came back at a different frame
+    Float64                     mMaxFrameShift = 0;
+};
+
+static Float64 gHostTicksToSeconds = 0;
+
+static bool ParseFourCC(const char* inString, OSType& outCode)
+{
+    if (strlen(inString) != 4)
+        return false;
+    outCode = (OSType(Byte(inString[0])) << 24) | (OSType(Byte(inString[1])) << 16) | (OSType(Byte(inString[2])) << 8) | OSType(Byte(inString[3]));
+    return true;
+}
+
+static bool ParseBenchmarkOptions(int argc, const char * argv[], BenchmarkOptions& outOptions)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool ok = true;
+        
+        if (!strcmp(arg, "--benchmark"))
+            continue;
+        else if (value == nullptr)
+            ok = false;
+        else if (!strcmp(arg, "--rate"))
+            ok = (outOptions.mEventRate = atof(value)) > 0;
+        else if (!strcmp(arg, "--cc-percent"))
+            ok = (outOptions.mCCPercent = atoi(value)) <= 100;
+        else if (!strcmp(arg, "--seconds"))
+            ok = (outOptions.mSeconds = atof(value)) > 0;
+        else if (!strcmp(arg, "--frames"))
+            ok = (outOptions.mFrames = atoi(value)) > 0;
+        else if (!strcmp(arg, "--sample-rate"))
+            ok = (outOptions.mSampleRate = atof(value)) > 0;
+        else if (!strcmp(arg, "--subtype"))
+            ok = ParseFourCC(value, outOptions.mSubType);
+        else if (!strcmp(arg, "--manufacturer"))
+            ok = ParseFourCC(value, outOptions.mManufacturer);
+        else
+            ok = false;
+        
+        if (!ok)
+        {
+            printf("ERROR: bad option %s%s%s\n", arg, value ? " " : "", value ? value : "");
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+// the k-th event of the load: every note on is followed by its note off, control changes cycle
+// through 16 channels and 32 controllers; cc or note is chosen by spreading mCCPercent evenly
+static void MakeBenchmarkEvent(UInt64 inIndex, UInt32 inCCPercent, Byte outData[3])
+{
+    static UInt64 sNotes = 0;
+    bool isCC = ((inIndex + 1) * inCCPercent) / 100 != (inIndex * inCCPercent) / 100;
+    if (isCC)
+    {
+        outData[0] = kMidiMessage_ControlChange | Byte(inIndex & 0x0F);
+        outData[1] = Byte(1 + (inIndex >> 4) % 32);
+        outData[2] = Byte(inIndex & 0x7F);
+    }
+    else
+    {
+        UInt64 note = sNotes++;
+        outData[0] = ((note & 1) ? kMidiMessage_NoteOff : kMidiMessage_NoteOn) | Byte((note >> 1) & 0x0F);
+        outData[1] = Byte(36 + (note >> 1) % 48);
+        outData[2] = (note & 1) ? 0 : 100;
+    }
+}
+
+static Float64 Percentile(std::vector<Float64>& ioValues, Float64 inFraction)
+{
+    if (ioValues.empty())
+        return 0;
+    size_t index = std::min(ioValues.size() - 1, size_t(inFraction * (ioValues.size() - 1) + 0.5));
+    std::nth_element(ioValues.begin(), ioValues.begin() + index, ioValues.end());
+    return ioValues[index];
+}
+
+static Float64 Mean(const std::vector<Float64>& inValues)
+{
+    Float64 sum = 0;
+    for (Float64 value : inValues)
+        sum += value;
+    return inValues.empty() ? 0 : sum / inValues.size();
+}
+
+// midi output callback for the benchmark: match what comes back against the pending events
+static OSStatus BenchmarkMidiOutputProc (void *							userData,
+                                         const AudioTimeStamp *			timeStamp,
+                                         UInt32							midiOutNum,
+                                         const struct MIDIPacketList *	pktlist)
+{
+    BenchmarkState& state = *(BenchmarkState*)userData;
+    UInt64 now = mach_absolute_time();
+    
+    const MIDIPacket *packet = pktlist->packet;
+    for (UInt32 i = 0; i < pktlist->numPackets; ++i)
+    {
+        // a packet can hold several messages that share a time stamp
+        UInt16 pos = 0;
+        while (pos < packet->length)
+        {
+            const Byte* message = packet->data + pos;
+            UInt16 length = ((message[0] & 0xE0) == 0xC0) ? 2 : 3;
+            pos += length;
+            ++state.mReceived;
+            
+            if (state.mPending.empty() || length != 3 || memcmp(state.mPending.front().mData, message, 3) != 0)
+            {
+                ++state.mMismatched;
+                continue;
+            }
+            
+            const PendingEvent& sent = state.mPending.front();
+            state.mLatencies.push_back((now - sent.mSendTime) * gHostTicksToSeconds);
+            Float64 frameShift = state.mCycleSampleTime + packet->timeStamp - sent.mSampleTime;
+            if (frameShift != 0)
+            {
+                ++state.mRetimed;
+                state.mMaxFrameShift = std::max(state.mMaxFrameShift, fabs(frameShift));
+            }
+            state.mPending.pop_front();
+        }
+        packet = MIDIPacketNext(packet);
+    }
+    return noErr;
+}
+
+static int RunBenchmark(const BenchmarkOptions& inOptions)
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    gHostTicksToSeconds = Float64(timebase.numer) / timebase.denom * 1.0e-9;
+    
+    AudioComponentDescription midiProcessorDesc{ kAudioUnitType_MIDIProcessor, inOptions.mSubType, inOptions.mManufacturer, 0, 0};
+    AudioUnit unit = nullptr;
+    AudioBufferList* dummyBufferList = nullptr;
+    BenchmarkState state;
+    std::vector<Float64> cycleTimes;
+    UInt64 eventsScheduled = 0, eventsRefused = 0;
+    int status = 0;
+    
+    try {
+        AudioComponent comp = AudioComponentFindNext(nullptr, &midiProcessorDesc);
+        XThrowIf(comp == nullptr, -1, "Couldn't find the midi processor. Did you build the AUMidiPassThru target?");
+        XThrowIfError(AudioComponentInstanceNew(comp, &unit), "AudioComponentInstanceNew");
+        XThrowIfError(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0, &inOptions.mFrames, sizeof(inOptions.mFrames)), "AudioUnitSetProperty: kAudioUnitProperty_MaximumFramesPerSlice");
+        XThrowIfError(AudioUnitInitialize(unit), "AudioUnitInitialize");
+        
+        AUMIDIOutputCallbackStruct midiOutputCallbackStruct;
+        midiOutputCallbackStruct.midiOutputCallback = BenchmarkMidiOutputProc;
+        midiOutputCallbackStruct.userData = &state;
+        XThrowIfError(AudioUnitSetProperty(unit, kAudioUnitProperty_MIDIOutputCallback, kAudioUnitScope_Global, 0, &midiOutputCallbackStruct, sizeof(midiOutputCallbackStruct)), "AudioUnitSetProperty: kAudioUnitProperty_MIDIOutputCallback");
+        
+        // a dummy bufferlist to satisfy some AUBase checks, as in main()
+        AudioStreamBasicDescription outputFormat;
+        UInt32 propSize = sizeof(outputFormat);
+        XThrowIfError(AudioUnitGetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &outputFormat, &propSize), "AudioUnitGetProperty: kAudioUnitProperty_StreamFormat");
+        UInt32 numBuffers = std::max(outputFormat.mChannelsPerFrame, 1U);
+        dummyBufferList = (AudioBufferList*) calloc(1, sizeof(AudioBufferList) + (numBuffers - 1) * sizeof(AudioBuffer));
+        dummyBufferList->mNumberBuffers = numBuffers;
+        for (UInt32 i = 0; i < numBuffers; ++i)
+            dummyBufferList->mBuffers[i].mNumberChannels = 1;
+        
+        const UInt64 numCycles = UInt64(inOptions.mSeconds * inOptions.mSampleRate / inOptions.mFrames + 0.5);
+        const Float64 framesPerEvent = inOptions.mSampleRate / inOptions.mEventRate;
+        const Float64 budget = inOptions.mFrames / inOptions.mSampleRate;
+        cycleTimes.reserve(numCycles);
+        state.mLatencies.reserve(size_t(inOptions.mEventRate * inOptions.mSeconds) + 1024);
+        
+        printf("Rendering %.1f s at %.0f Hz, %u frames per call, %.0f events/s (%u%% control changes)...\n",
+               inOptions.mSeconds, inOptions.mSampleRate, (unsigned)inOptions.mFrames, inOptions.mEventRate, (unsigned)inOptions.mCCPercent);
+        
+        Float64 nextEventTime = 0;
+        for (UInt64 cycle = 0; cycle < numCycles; ++cycle)
+        {
+            AudioTimeStamp timeStamp;
+            memset(&timeStamp, 0, sizeof(timeStamp));
+            timeStamp.mSampleTime = Float64(cycle * inOptions.mFrames);
+            timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+            const Float64 cycleEnd = timeStamp.mSampleTime + inOptions.mFrames;
+            
+            // startFrame bookkeeping: each event goes in at its own frame within this buffer
+            while (nextEventTime < cycleEnd)
+            {
+                PendingEvent event;
+                event.mSampleTime = floor(nextEventTime);
+                MakeBenchmarkEvent(eventsScheduled++, inOptions.mCCPercent, event.mData);
+                nextEventTime += framesPerEvent;
+                
+                UInt32 offset = UInt32(event.mSampleTime - timeStamp.mSampleTime);
+                event.mSendTime = mach_absolute_time();
+                if (MusicDeviceMIDIEvent(unit, event.mData[0], event.mData[1], event.mData[2], offset) == noErr)
+                    state.mPending.push_back(event);
+                else
+                    ++eventsRefused;
+            }
+            
+            state.mCycleSampleTime = timeStamp.mSampleTime;
+            AudioUnitRenderActionFlags flags = 0;
+            UInt64 start = mach_absolute_time();
+            XThrowIfError(AudioUnitRender(unit, &flags, &timeStamp, 0, inOptions.mFrames, dummyBufferList), "AudioUnitRender");
+            cycleTimes.push_back((mach_absolute_time() - start) * gHostTicksToSeconds);
+        }
+        
+        // report
+        const UInt64 lost = state.mPending.size();
+        printf("\n");
+        printf("events:      %llu scheduled, %llu refused by the unit, %llu received, %llu never came back\n",
+               eventsScheduled, eventsRefused, state.mReceived, lost);
+        printf("             %llu out of order or altered, %llu moved (by up to %.0f frames)\n",
+               state.mMismatched, state.mRetimed, state.mMaxFrameShift);
+        printf("render call: mean %.2f us, p99 %.2f us, max %.2f us (%.2f%% of the %.2f ms buffer at max)\n",
+               Mean(cycleTimes) * 1e6, Percentile(cycleTimes, 0.99) * 1e6, Percentile(cycleTimes, 1.0) * 1e6,
+               Percentile(cycleTimes, 1.0) / budget * 100, budget * 1e3);
+        printf("latency:     mean %.2f us, p99 %.2f us, max %.2f us from MusicDeviceMIDIEvent to the output callback\n",
+               Mean(state.mLatencies) * 1e6, Percentile(state.mLatencies, 0.99) * 1e6, Percentile(state.mLatencies, 1.0) * 1e6);
+        
+        AUMidiPassThruOutputStatistics stats;
+        propSize = sizeof(stats);
+        if (AudioUnitGetProperty(unit, kAudioUnitCustomProperty_MIDIOutputStatistics, kAudioUnitScope_Global, 0, &stats, &propSize) == noErr && propSize == sizeof(stats))
+        {
+            printf("unit:        %llu events in %llu packet lists, %u overflow flushes, %u dropped, at most %u events and %u list bytes per call\n",
+                   stats.mEventsSent, stats.mPacketListsSent, (unsigned)stats.mOverflowFlushes, (unsigned)stats.mDroppedEvents,
+                   (unsigned)stats.mMaxEventsPerCycle, (unsigned)stats.mMaxPacketListBytesPerCycle);
+        }
+        
+        if (eventsRefused || lost || state.mMismatched)
+            status = 1;
+    }
+    
+    catch (CAXException &e) {
+        printf("ERROR: %s: %d\n\n", e.mOperation, e.mError);
+        status = 1;
+    }
+    
+    free(dummyBufferList);
+    if (unit)
+        AudioComponentInstanceDispose(unit);
+    return status;
+}
+
+#pragma mark - main
+
 int main(int argc, const char * argv[])
 {
+    if (argc > 1)
+    {
+        BenchmarkOptions options;
+        if (strcmp(argv[1], "--benchmark") != 0 || !ParseBenchmarkOptions(argc, argv, options))
+        {
+            printf("usage: %s [--benchmark [--rate N] [--cc-percent N] [--seconds N] [--frames N] [--sample-rate N] [--subtype XXXX] [--manufacturer XXXX]]\n", argv[0]);
+            return 1;
+        }
+        return RunBenchmark(options);
+    }
+    
     OSStatus result = noErr;
     
     AUGraph graph = nullptr;
@@ -20,6 +20,38 @@ Offline AU
 
 #include "AUBase.h"
 #include "ReverseOfflineUnitVersion.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Rather than pulling its input one small backwards-moving slice per render, the unit pulls
+// a long stretch of input forwards into memory, ending at the first slice it needs, and then
+// serves that slice and the ones before it from memory until it runs off the front of the
+// stretch. This custom property sets how long the stretch is.
+//
+// read/write, global scope, Float64, in seconds; 0 pulls every slice from the input directly.
+// It can only be set while the unit is uninitialized.
+enum {
+	kAudioUnitCustomProperty_ReverseCacheDuration = 65540
+};
+
+// read/write, global scope, UInt32: how many threads besides the render thread reverse each
+// stretch once it has been pulled; 0 reverses it on the render thread. Set while uninitialized.
+//
+// read-only, global scope, UInt64: output frames rendered since the last preflight, for
+// reporting the progress of a bounce against kAudioUnitOfflineProperty_OutputSize.
+enum {
+	kAudioUnitCustomProperty_ReverseWorkerThreads = 65541,
+	kAudioUnitCustomProperty_ReverseFramesRendered = 65542
+};
+
+static const Float64 kDefaultReverseCacheDuration = 4.0;
+static const Float64 kMaxReverseCacheDuration = 600.0;
+static const UInt32 kMaxReverseWorkerThreads = 16;
+static const UInt32 kMinFramesPerReverseSegment = 16384;	// below this a thread costs more than it saves
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____ReverseOfflineUnit
@@ -32,6 +64,7 @@ class ReverseOfflineUnit : public AUBase
 {
 public:
 								ReverseOfflineUnit(AudioUnit component);
+	virtual						~ReverseOfflineUnit();
 	
 	virtual OSStatus			GetPropertyInfo(	AudioUnitPropertyID		inID,
 													AudioUnitScope			inScope,
@@ -52,6 +85,7 @@ public:
 
 		// same logic as AUEffectBase
 	virtual OSStatus 	Initialize();
+	virtual void		Cleanup();
 														
 	virtual bool				StreamFormatWritable(	AudioUnitScope		scope,
 														AudioUnitElement	element);
@@ -71,8 +105,43 @@ public:
 	virtual bool			CanScheduleParameters() const { return false; }
 	
 private:
+		// pulls the input frames [inEnd - the cache length, inEnd), clipped at mStartOffset, into the cache
+	OSStatus			FillCache(	AudioUnitRenderActionFlags &	ioActionFlags,
+									const AudioTimeStamp &			inTimeStamp,
+									SInt64							inEnd);
+
+	void				InvalidateCache() { mCacheFrames = 0; }
+
+		// reverses every channel of the cached stretch in place, split across the worker threads
+	void				ReverseCache();
+	void				ReverseCacheSegment(UInt32 inSegment, UInt32 inNumSegments);
+	static void			ReverseSegment(Float32 *inData, UInt32 inNumFrames, UInt32 inSegment, UInt32 inNumSegments);
+
+		// the workers live from Initialize to Cleanup; worker i reverses segment i + 1 of each stretch
+	void				StartWorkers();
+	void				StopWorkers();
+	void				WorkerThread(UInt32 inSegment, UInt32 inGeneration);
+
 	UInt64			mNumInputSamples;
 	UInt64			mStartOffset;
+
+	Float64					mCacheDuration;
+	UInt32					mCacheCapacity;		// frames per channel; 0 when caching is off
+	std::vector<Float32>	mCache;				// one run of mCacheCapacity frames per channel, reversed:
+												// frame 0 is the input at mCacheStart + mCacheFrames - 1
+	SInt64					mCacheStart;		// the input sample time of the earliest cached frame
+	UInt32					mCacheFrames;		// how many frames are valid
+	UInt32					mNumWorkerThreads;
+	UInt64					mFramesRendered;
+
+	std::vector<std::thread>	mWorkers;
+	std::mutex					mWorkMutex;			// guards the rest
+	std::condition_variable		mWorkReady;			// a stretch is ready, or the workers should quit
+	std::condition_variable		mWorkDone;			// the last worker finished its segment
+	UInt32						mWorkGeneration;	// counts the stretches handed to the workers
+	UInt32						mWorkSegments;		// of the current stretch
+	UInt32						mWorkPending;		// workers still busy with it
+	bool						mWorkQuit;
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -86,10 +155,29 @@ AUDIOCOMPONENT_ENTRY(AUBaseFactory, ReverseOfflineUnit)
 ReverseOfflineUnit::ReverseOfflineUnit(AudioUnit component)
 	: AUBase(component, 1, 1), 
 	  mNumInputSamples(0),
-	  mStartOffset (0)
+	  mStartOffset (0),
+	  mCacheDuration (kDefaultReverseCacheDuration),
+	  mCacheCapacity (0),
+	  mCacheStart (0),
+	  mCacheFrames (0),
+	  mNumWorkerThreads (std::min(std::max(std::thread::hardware_concurrency(), 1U) - 1, 3U)),
+	  mFramesRendered (0),
+	  mWorkGeneration (0),
+	  mWorkSegments (0),
+	  mWorkPending (0),
+	  mWorkQuit (false)
 {
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::~ReverseOfflineUnit
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ReverseOfflineUnit::~ReverseOfflineUnit()
+{
+	StopWorkers();
+}
+
 
 #pragma mark ____ReverseOfflineProperties
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -127,6 +215,18 @@ OSStatus			ReverseOfflineUnit::GetPropertyInfo (AudioUnitPropertyID	inID,
 					return noErr;
 				}
 				return kAudioUnitErr_InvalidProperty;
+			case kAudioUnitCustomProperty_ReverseCacheDuration:
+				outDataSize = sizeof(mCacheDuration);
+				outWritable = true;
+				return noErr;
+			case kAudioUnitCustomProperty_ReverseWorkerThreads:
+				outDataSize = sizeof(mNumWorkerThreads);
+				outWritable = true;
+				return noErr;
+			case kAudioUnitCustomProperty_ReverseFramesRendered:
+				outDataSize = sizeof(mFramesRendered);
+				outWritable = false;
+				return noErr;
 		}
 	}
 	return AUBase::GetPropertyInfo (inID, inScope, inElement, outDataSize, outWritable);
@@ -162,6 +262,15 @@ OSStatus			ReverseOfflineUnit::GetProperty (AudioUnitPropertyID 		inID,
 					return noErr;
 				}
 				return kAudioUnitErr_InvalidProperty;
+			case kAudioUnitCustomProperty_ReverseCacheDuration:
+				*(Float64*)outData = mCacheDuration;
+				return noErr;
+			case kAudioUnitCustomProperty_ReverseWorkerThreads:
+				*(UInt32*)outData = mNumWorkerThreads;
+				return noErr;
+			case kAudioUnitCustomProperty_ReverseFramesRendered:
+				*(UInt64*)outData = mFramesRendered;
+				return noErr;
 		}
 	}
 	return AUBase::GetProperty (inID, inScope, inElement, outData);
@@ -184,11 +293,30 @@ OSStatus			ReverseOfflineUnit::SetProperty(AudioUnitPropertyID 	inID,
 			case kAudioUnitOfflineProperty_InputSize:
 				if (inDataSize < sizeof(UInt64)) return kAudioUnitErr_InvalidPropertyValue;
 				mNumInputSamples = *(UInt64*)inData;
+				InvalidateCache();
 				return noErr;
 
 			case kAudioUnitOfflineProperty_StartOffset:
 				if (inDataSize < sizeof(UInt64)) return kAudioUnitErr_InvalidPropertyValue;
 				mStartOffset = *(UInt64*)inData;
+				InvalidateCache();
+				return noErr;
+
+			case kAudioUnitCustomProperty_ReverseCacheDuration:
+			{
+				if (inDataSize < sizeof(Float64)) return kAudioUnitErr_InvalidPropertyValue;
+				if (IsInitialized()) return kAudioUnitErr_Initialized;
+				Float64 duration = *(Float64*)inData;
+				if (!(duration >= 0 && duration <= kMaxReverseCacheDuration)) return kAudioUnitErr_InvalidPropertyValue;
+				mCacheDuration = duration;
+				return noErr;
+			}
+
+			case kAudioUnitCustomProperty_ReverseWorkerThreads:
+				if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+				if (IsInitialized()) return kAudioUnitErr_Initialized;
+				if (*(UInt32*)inData > kMaxReverseWorkerThreads) return kAudioUnitErr_InvalidPropertyValue;
+				mNumWorkerThreads = *(UInt32*)inData;
 				return noErr;
 		}
 	}
@@ -252,9 +380,30 @@ OSStatus 	ReverseOfflineUnit::Initialize()
             return kAudioUnitErr_FormatNotSupported;
     }
 
+		// the cache always holds at least one whole slice, so any render can be served from it
+	const CAStreamBasicDescription &inputFormat = GetInput(0)->GetStreamFormat();
+	mCacheCapacity = 0;
+	if (mCacheDuration > 0)
+		mCacheCapacity = std::max(UInt32(mCacheDuration * inputFormat.mSampleRate), GetMaxFramesPerSlice());
+	mCache.assign(size_t(mCacheCapacity) * inputFormat.NumberChannelStreams(), 0.f);
+	InvalidateCache();
+	StartWorkers();
+
     return noErr;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::Cleanup
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::Cleanup()
+{
+	StopWorkers();
+	std::vector<Float32>().swap(mCache);
+	mCacheCapacity = 0;
+	InvalidateCache();
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	ReverseOfflineUnit::StreamFormatWritable
 //
@@ -288,6 +437,8 @@ OSStatus 	ReverseOfflineUnit::Render(	AudioUnitRenderActionFlags &ioActionFlags,
 		return kAudioUnitErr_InvalidOfflineRender;
 
 	if (preflight) {
+		InvalidateCache();
+		mFramesRendered = 0;
 		ioActionFlags |= kAudioOfflineUnitRenderAction_Complete;
 		return noErr;
 	}
@@ -326,27 +477,51 @@ OSStatus 	ReverseOfflineUnit::Render(	AudioUnitRenderActionFlags &ioActionFlags,
 	AUOutputElement *theOutput = GetOutput(0);	// throws if error
 	AUInputElement *theInput = GetInput(0);
 	
-	OSStatus result = theInput->PullInput (ioActionFlags, ts, 0 /* element */, numFramesToPull);
-	
-	if (result) return result;
-
-	// ok - now we reverse our input data
-	// if we have a remainder we need to zero out the output buffer
-	
-	AudioBufferList &inputBuffer = theInput->GetBufferList();
 	AudioBufferList &outputBuffer = theOutput->GetBufferList();
 	
-	// we'll do the reverse one channel at a time...
-	for (UInt32 i = 0; i < inputBuffer.mNumberBuffers; ++i) 
+	SInt64 firstFrame = SInt64(ts.mSampleTime);
+	SInt64 endFrame = firstFrame + numFramesToPull;
+	
+	if (mCacheCapacity > 0 && firstFrame >= SInt64(mStartOffset) && endFrame <= SInt64(mNumInputSamples))
 	{
-		Float32* inSampleData = (Float32*)inputBuffer.mBuffers[i].mData;
-		Float32* outSampleData = (Float32*)outputBuffer.mBuffers[i].mData;
+			// the slices move backwards, so once a slice isn't cached, neither are the ones
+			// before it: refill with the stretch that ends where this slice does
+		if (firstFrame < mCacheStart || endFrame > mCacheStart + SInt64(mCacheFrames)) {
+			OSStatus result = FillCache (ioActionFlags, inTimeStamp, endFrame);
+			if (result) return result;
+		}
 		
+			// the cache is already reversed, so the slice is one straight copy per channel
+		size_t offset = size_t(mCacheStart + mCacheFrames - endFrame);
+		UInt32 numChannels = std::min(UInt32(mCache.size() / mCacheCapacity), UInt32(outputBuffer.mNumberBuffers));
+		for (UInt32 i = 0; i < numChannels; ++i) 
+			memcpy(outputBuffer.mBuffers[i].mData, &mCache[size_t(i) * mCacheCapacity + offset], numFramesToPull * sizeof(Float32));
+	}
+	else
+	{
+		OSStatus result = theInput->PullInput (ioActionFlags, ts, 0 /* element */, numFramesToPull);
 		
-		for (SInt32 in = numFramesToPull, out = 0; --in >= 0 ;++out)
-			outSampleData[out] = inSampleData[in];
+		if (result) return result;
+
+		// ok - now we reverse our input data
+		// if we have a remainder we need to zero out the output buffer
+		
+		AudioBufferList &inputBuffer = theInput->GetBufferList();
+		
+		// we'll do the reverse one channel at a time...
+		for (UInt32 i = 0; i < inputBuffer.mNumberBuffers; ++i) 
+		{
+			Float32* inSampleData = (Float32*)inputBuffer.mBuffers[i].mData;
+			Float32* outSampleData = (Float32*)outputBuffer.mBuffers[i].mData;
+			
+			
+			for (SInt32 in = numFramesToPull, out = 0; --in >= 0 ;++out)
+				outSampleData[out] = inSampleData[in];
+		}
 	}
 
+	mFramesRendered += numFramesToPull;
+
 	if (renderPhaseComplete) {
 		UInt32 numValidBytes = numFramesToPull * sizeof (Float32);
 			// we just need to reset the numbytes field as that indicates the valid portion of the buffer
@@ -359,3 +534,152 @@ OSStatus 	ReverseOfflineUnit::Render(	AudioUnitRenderActionFlags &ioActionFlags,
 
 	return noErr;
 }
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::FillCache
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus	ReverseOfflineUnit::FillCache(	AudioUnitRenderActionFlags &	ioActionFlags,
+											const AudioTimeStamp &			inTimeStamp,
+											SInt64							inEnd)
+{
+	SInt64 start = std::max(SInt64(mStartOffset), inEnd - SInt64(mCacheCapacity));
+	UInt32 numFrames = UInt32(inEnd - start);
+	UInt32 numChannels = UInt32(mCache.size() / mCacheCapacity);
+	UInt32 maxFramesPerPull = GetMaxFramesPerSlice();
+	
+	InvalidateCache();
+	AUInputElement *theInput = GetInput(0);
+	AudioTimeStamp ts (inTimeStamp);
+	
+		// forwards, in the largest slices the input's buffers can take
+	for (UInt32 done = 0; done < numFrames; ) {
+		UInt32 numFramesToPull = std::min(maxFramesPerPull, numFrames - done);
+		ts.mSampleTime = Float64(start + done);
+		
+		AudioUnitRenderActionFlags flags = ioActionFlags;
+		OSStatus result = theInput->PullInput (flags, ts, 0 /* element */, numFramesToPull);
+		if (result) return result;
+		
+		AudioBufferList &inputBuffer = theInput->GetBufferList();
+		UInt32 n = std::min(numChannels, UInt32(inputBuffer.mNumberBuffers));
+		for (UInt32 i = 0; i < n; ++i)
+			memcpy(&mCache[size_t(i) * mCacheCapacity + done], inputBuffer.mBuffers[i].mData, numFramesToPull * sizeof(Float32));
+		
+		done += numFramesToPull;
+	}
+	
+	mCacheStart = start;
+	mCacheFrames = numFrames;
+	ReverseCache();
+	return noErr;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::ReverseSegment
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::ReverseSegment(Float32 *inData, UInt32 inNumFrames, UInt32 inSegment, UInt32 inNumSegments)
+{
+		// segment s swaps the pairs (k, n - 1 - k) for its share of k in [0, n / 2), so no two
+		// segments touch the same frame
+	UInt32 numPairs = inNumFrames / 2;
+	UInt32 first = UInt32(UInt64(numPairs) * inSegment / inNumSegments);
+	UInt32 last = UInt32(UInt64(numPairs) * (inSegment + 1) / inNumSegments);
+	for (UInt32 k = first; k < last; ++k)
+		std::swap(inData[k], inData[inNumFrames - 1 - k]);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::ReverseCacheSegment
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::ReverseCacheSegment(UInt32 inSegment, UInt32 inNumSegments)
+{
+	UInt32 numChannels = UInt32(mCache.size() / mCacheCapacity);
+	for (UInt32 i = 0; i < numChannels; ++i)
+		ReverseSegment(&mCache[size_t(i) * mCacheCapacity], mCacheFrames, inSegment, inNumSegments);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::ReverseCache
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::ReverseCache()
+{
+	UInt32 numChannels = UInt32(mCache.size() / mCacheCapacity);
+	UInt32 numSegments = std::min(UInt32(mWorkers.size()) + 1, UInt32(std::max(UInt64(mCacheFrames) * numChannels / kMinFramesPerReverseSegment, UInt64(1))));
+	if (numSegments == 1) {
+		ReverseCacheSegment(0, 1);
+		return;
+	}
+	
+		// every worker wakes for the stretch, and those past numSegments have nothing to do;
+		// the render thread takes segment 0 itself
+	{
+		std::lock_guard<std::mutex> lock(mWorkMutex);
+		mWorkSegments = numSegments;
+		mWorkPending = UInt32(mWorkers.size());
+		++mWorkGeneration;
+	}
+	mWorkReady.notify_all();
+	ReverseCacheSegment(0, numSegments);
+	std::unique_lock<std::mutex> lock(mWorkMutex);
+	mWorkDone.wait(lock, [this] { return mWorkPending == 0; });
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::StartWorkers
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::StartWorkers()
+{
+	StopWorkers();
+		// without a cache every slice is reversed as it is pulled, which is too short to split
+	if (mCacheCapacity == 0) return;
+	mWorkQuit = false;
+	for (UInt32 i = 0; i < mNumWorkerThreads; ++i)
+		mWorkers.push_back(std::thread(&ReverseOfflineUnit::WorkerThread, this, i + 1, mWorkGeneration));
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::StopWorkers
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::StopWorkers()
+{
+	if (mWorkers.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(mWorkMutex);
+		mWorkQuit = true;
+	}
+	mWorkReady.notify_all();
+	for (size_t i = 0; i < mWorkers.size(); ++i)
+		mWorkers[i].join();
+	mWorkers.clear();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	ReverseOfflineUnit::WorkerThread
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		ReverseOfflineUnit::WorkerThread(UInt32 inSegment, UInt32 inGeneration)
+{
+		// the generation comes from StartWorkers, so a stretch handed out before this thread runs isn't missed
+	std::unique_lock<std::mutex> lock(mWorkMutex);
+	UInt32 generation = inGeneration;
+	for (;;) {
+		mWorkReady.wait(lock, [this, generation] { return mWorkQuit || mWorkGeneration != generation; });
+		if (mWorkQuit) return;
+		generation = mWorkGeneration;
+		UInt32 numSegments = mWorkSegments;
+		
+		lock.unlock();
+		if (inSegment < numSegments)
+			ReverseCacheSegment(inSegment, numSegments);
+		lock.lock();
+		
+		if (--mWorkPending == 0)
+			mWorkDone.notify_one();
+	}
+}
@@ -401,6 +401,13 @@ public:
 	}
 		
 
+		// fills outCurve[i] with the parameter value for the linear value i / (inNumSteps - 1)
+	void						FillCurve (Float32 *outCurve, UInt32 inNumSteps) const
+	{
+								for (UInt32 i = 0; i < inNumSteps; ++i)
+									outCurve[i] = ParamValueFromMIDILinear (Float32(i) / Float32(inNumSteps - 1));
+	}
+
 		// The CALLER of this method must ensure that the status byte's MIDI Command (ignoring the channel) matches!!!
 	bool						MIDI_Matches (UInt8 inChannel, UInt8 inData1, UInt8 inData2, Float32 &outLinear) const;
 	
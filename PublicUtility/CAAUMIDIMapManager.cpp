@@ -10,8 +10,137 @@ Part of Core Audio Public Utility Classes
 #include <AudioToolbox/AudioUnitUtilities.h>
 
 CAAUMIDIMapManager::CAAUMIDIMapManager()
+	: mControllerTable(NULL), mReadingControllerTable(false)
 {	
 	hotMapping = false;	
+	RebuildControllerTable();
+}
+
+CAAUMIDIMapManager::~CAAUMIDIMapManager()
+{
+	delete mControllerTable.load();
+	for (size_t i = 0; i < mRetiredControllerTables.size(); ++i)
+		delete mRetiredControllerTables[i];
+}
+
+// the direct slot a map fills on one channel, or -1 if it isn't a control change or pitch bend
+int		CAAUMIDIMapManager::DirectSlot (const CAAUMIDIMap &inMap, UInt32 inChannel)
+{
+	if (inMap.IsControlChange())
+		return int((inChannel << 7) | (inMap.mData1 & 0x7F));
+	if (inMap.IsPitchBend())
+		return int(kFirstPitchBendSlot + inChannel);
+	return -1;
+}
+
+void	CAAUMIDIMapManager::RebuildControllerTable()
+{
+	ControllerTable *newTable = new ControllerTable;
+	ControllerTable &table = *newTable;
+	
+		// count each slot's maps and the size of the curves, then lay the slots out one after
+		// another and fill them in
+	UInt32 counts[kNumDirectSlots] = { 0 };
+	UInt32 numCurveValues = 0;
+	for (ParameterMaps::iterator i = mParameterMaps.begin(); i < mParameterMaps.end(); ++i) {
+		CAAUMIDIMap &map = *i;
+		if (DirectSlot(map, 0) < 0) continue;
+		for (UInt32 channel = 0; channel < 16; ++channel)
+			if (map.IsAnyChannel() || SInt32(channel) == map.Channel())
+				counts[DirectSlot(map, channel)]++;
+		numCurveValues += map.IsPitchBend() ? kPitchBendCurveSize : kControllerCurveSize;
+	}
+	
+	table.mFirst[0] = 0;
+	for (UInt32 slot = 0; slot < kNumDirectSlots; ++slot)
+		table.mFirst[slot + 1] = table.mFirst[slot] + counts[slot];
+	table.mMaps.resize(table.mFirst[kNumDirectSlots]);
+	table.mCurves.resize(numCurveValues);
+	
+	UInt32 curve = 0;
+	for (ParameterMaps::iterator i = mParameterMaps.begin(); i < mParameterMaps.end(); ++i) {
+		CAAUMIDIMap &map = *i;
+		if (DirectSlot(map, 0) < 0) continue;
+		
+		UInt32 curveSize = map.IsPitchBend() ? kPitchBendCurveSize : kControllerCurveSize;
+		map.FillCurve (&table.mCurves[curve], curveSize);
+		
+		ControllerMap entry;
+		entry.mParameterID = map.mParameterID;
+		entry.mScope = map.mScope;
+		entry.mElement = map.mElement;
+		entry.mCurve = curve;
+		entry.mBipolar = map.IsBipolar() ? (map.IsBipolar_OnValue() ? 1 : -1) : 0;
+		curve += curveSize;
+		
+		for (UInt32 channel = 0; channel < 16; ++channel) {
+			if (map.IsAnyChannel() || SInt32(channel) == map.Channel()) {
+				UInt32 slot = DirectSlot(map, channel);
+				table.mMaps[table.mFirst[slot + 1] - counts[slot]--] = entry;
+			}
+		}
+	}
+	
+	ControllerTable *oldTable = mControllerTable.exchange(newTable);
+	if (oldTable)
+		mRetiredControllerTables.push_back(oldTable);
+	ReclaimControllerTables();
+}
+
+	// The reader raises mReadingControllerTable before it loads mControllerTable and lowers it after its
+	// last use, all sequentially consistent. So if the flag reads false after the exchange, any read in
+	// flight has finished and any later one loads the new table: none of the retired tables is held.
+	// If it reads true they wait for the next rebuild.
+void	CAAUMIDIMapManager::ReclaimControllerTables()
+{
+	if (mRetiredControllerTables.empty() || mReadingControllerTable.load())
+		return;
+	for (size_t i = 0; i < mRetiredControllerTables.size(); ++i)
+		delete mRetiredControllerTables[i];
+	mRetiredControllerTables.clear();
+}
+
+	// inValue indexes the curves; a switch looks at inSwitchByte, as MIDI_Matches does
+bool	CAAUMIDIMapManager::HandleDirectSlot(UInt32 inSlot, UInt32 inValue, UInt8 inSwitchByte, UInt32 inBufferOffset, AUBase &inAUBase)
+{
+	mReadingControllerTable.store(true);
+	const ControllerTable &table = *mControllerTable.load();
+	UInt32 first = table.mFirst[inSlot], last = table.mFirst[inSlot + 1];
+	if (first == last) {
+		mReadingControllerTable.store(false);
+		return false;
+	}
+	
+	UInt32 curveEnd = (inSlot >= kFirstPitchBendSlot ? kPitchBendCurveSize : kControllerCurveSize) - 1;
+	
+	AudioUnitEvent event;
+	event.mEventType = kAudioUnitEvent_ParameterValueChange;
+	event.mArgument.mParameter.mAudioUnit = inAUBase.GetComponentInstance();
+	
+	bool ret_value = false;
+	for (UInt32 i = first; i < last; ++i) {
+		const ControllerMap &map = table.mMaps[i];
+		
+		UInt32 index = inValue;
+		if (map.mBipolar > 0) {
+			if (inSwitchByte < 64) continue;
+			index = curveEnd;
+		} else if (map.mBipolar < 0) {
+			if (inSwitchByte > 63) continue;
+			index = 0;
+		}
+		
+		inAUBase.SetParameter (map.mParameterID, map.mScope, map.mElement, table.mCurves[map.mCurve + index], inBufferOffset);
+		
+		event.mArgument.mParameter.mParameterID = map.mParameterID;
+		event.mArgument.mParameter.mScope = map.mScope;
+		event.mArgument.mParameter.mElement = map.mElement;
+		
+		AUEventListenerNotify(NULL, NULL, &event);
+		ret_value = true;
+	}
+	mReadingControllerTable.store(false);
+	return ret_value;
 }
 
 static void FillInMap (CAAUMIDIMap &map, AUBase &That)
@@ -47,6 +176,7 @@ OSStatus	CAAUMIDIMapManager::SortedInsertToParamaterMaps	(AUParameterMIDIMapping
 	}
 	
 	std::sort(mParameterMaps.begin(), mParameterMaps.end(), CompareMIDIMap());	
+	RebuildControllerTable();
 	
 	return noErr;
 }
@@ -71,6 +201,8 @@ void CAAUMIDIMapManager::SortedRemoveFromParameterMaps(AUParameterMIDIMapping *m
 			outMapDidChange = true;
 		}
 	}
+	if (outMapDidChange)
+		RebuildControllerTable();
 }
 
 void	CAAUMIDIMapManager::ReplaceAllMaps (AUParameterMIDIMapping* inMappings, UInt32 inNumMaps, AUBase &That)
@@ -85,6 +217,7 @@ void	CAAUMIDIMapManager::ReplaceAllMaps (AUParameterMIDIMapping* inMappings, UIn
 	}
 
 	std::sort(mParameterMaps.begin(),mParameterMaps.end(), CompareMIDIMap());	
+	RebuildControllerTable();
 }
 
 bool CAAUMIDIMapManager::HandleHotMapping(UInt8 	inStatus,
@@ -156,6 +289,11 @@ bool CAAUMIDIMapManager::FindParameterMapEventMatch(	UInt8			inStatus,
 	if (inStatus == 0x90 && !inData2)
 		inStatus = 0x80 | inChannel;
 	
+	if (inStatus == 0xB0)
+		return HandleDirectSlot ((UInt32(inChannel & 0xF) << 7) | (inData1 & 0x7F), inData2 & 0x7F, inData2, inBufferOffset, inAUBase);
+	if (inStatus == 0xE0)
+		return HandleDirectSlot (kFirstPitchBendSlot + (inChannel & 0xF), (UInt32(inData2 & 0x7F) << 7) | (inData1 & 0x7F), inData1, inBufferOffset, inAUBase);
+	
 	//used to test for midi matches once map is made
 	CAAUMIDIMap tempMap;
 	tempMap.mStatus = inStatus | inChannel;
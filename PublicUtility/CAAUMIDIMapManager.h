@@ -11,6 +11,7 @@ Part of Core Audio Public Utility Classes
 
 #include "AUBase.h"
 #include "CAAUMIDIMap.h"
+#include <atomic>
 #include <vector>
 #include <AudioToolbox/AudioUnitUtilities.h>
 
@@ -24,9 +25,48 @@ protected:
 	bool								hotMapping;
 	AUParameterMIDIMapping				mHotMap;
 	
+		// Control changes and pitch bends, by far the densest mapped messages, skip the search through
+		// mParameterMaps: every (channel, controller) pair and every channel's pitch bend has a slot
+		// listing the maps it triggers, and each of those maps has its parameter value for every
+		// possible MIDI value already worked out. The table is rebuilt whenever the maps change, into
+		// a new table that is never written again once published. The one it replaces is retired, and is
+		// freed by a later rebuild (or the destructor) once the render thread has been seen outside
+		// HandleDirectSlot since the swap, so it is never freed or reused while the reader may hold it.
+	enum {
+		kNumControllerSlots = 16 * 128,						// channel << 7 | controller number
+		kFirstPitchBendSlot = kNumControllerSlots,			// + channel
+		kNumDirectSlots = kFirstPitchBendSlot + 16,
+		kControllerCurveSize = 128,
+		kPitchBendCurveSize = 16384
+	};
+	
+	struct ControllerMap {
+		AudioUnitParameterID			mParameterID;
+		AudioUnitScope					mScope;
+		AudioUnitElement				mElement;
+		UInt32							mCurve;			// index in mCurves of the value for MIDI value 0
+		SInt8							mBipolar;		// 0, or the on (1) / off (-1) state of a switch
+	};
+	
+	struct ControllerTable {
+		UInt32							mFirst[kNumDirectSlots + 1];	// slot s is mMaps[mFirst[s], mFirst[s + 1])
+		std::vector<ControllerMap>		mMaps;
+		std::vector<Float32>			mCurves;		// shared by the channels of an any-channel map
+	};
+	
+	std::atomic<ControllerTable *>		mControllerTable;		// published; read by HandleDirectSlot
+	std::atomic<bool>					mReadingControllerTable;	// HandleDirectSlot is between its load and its last use
+	std::vector<ControllerTable *>		mRetiredControllerTables;	// replaced, possibly still held by the reader
+	
+	static int				DirectSlot(const CAAUMIDIMap &inMap, UInt32 inChannel);
+	void					RebuildControllerTable();
+	void					ReclaimControllerTables();
+	bool					HandleDirectSlot(UInt32 inSlot, UInt32 inValue, UInt8 inSwitchByte, UInt32 inBufferOffset, AUBase &inAUBase);
+	
 public:
 					
 							CAAUMIDIMapManager();
+							~CAAUMIDIMapManager();
 	
 	UInt32					NumMaps(){return static_cast<UInt32>(mParameterMaps.size());}
 	void					GetMaps(AUParameterMIDIMapping* maps);
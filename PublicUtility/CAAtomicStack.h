@@ -140,6 +140,108 @@ protected:
 	T *		mHead;
 };
 
+#if __cplusplus >= 201103L
+#include <atomic>
+#include <stdint.h>
+
+//  TAtomicStack's interface on std::atomic, safe for any number of threads pushing and popping.
+//  The head carries a count in the bits above the pointer that every successful pop advances, so
+//  a pop whose item was popped and pushed back meanwhile sees a changed head and retries instead
+//  of linking in a stale next pointer (the ABA problem). Pushes release their items' contents to
+//  whoever pops them. Items may be reused but must not be freed while another thread may be
+//  popping, since a losing pop still reads its candidate's next().
+//  class T must implement T *& next().
+template <class T>
+class TAtomicTaggedStack {
+public:
+	TAtomicTaggedStack() : mHead(0) { }
+	
+	// non-atomic routines, for use when initializing/deinitializing
+	void	push_NA(T *item)
+	{
+		item->next() = pointer(mHead.load(std::memory_order_relaxed));
+		mHead.store(make(item, 0), std::memory_order_relaxed);
+	}
+	
+	T *		pop_NA()
+	{
+		T *result = pointer(mHead.load(std::memory_order_relaxed));
+		if (result)
+			mHead.store(make(result->next(), 0), std::memory_order_relaxed);
+		return result;
+	}
+	
+	bool	empty() const { return pointer(mHead.load(std::memory_order_acquire)) == NULL; }
+	
+	// atomic routines
+	void	push_atomic(T *item) { push_multiple_atomic(item, item); }
+	
+	void	push_multiple_atomic(T *first, T *last)
+		// pushes the linked list first -> ... -> last, keeping its order
+	{
+		Word head_ = mHead.load(std::memory_order_relaxed);
+		do {
+			last->next() = pointer(head_);
+		} while (!mHead.compare_exchange_weak(head_, make(first, tag(head_)), std::memory_order_release, std::memory_order_relaxed));
+	}
+	
+	void	push_multiple_atomic(T *item)
+		// pushes entire linked list headed by item
+	{
+		T *tail = item;
+		while (tail->next())
+			tail = tail->next();
+		push_multiple_atomic(item, tail);
+	}
+	
+	T *		pop_atomic()
+	{
+		Word head_ = mHead.load(std::memory_order_acquire);
+		T *result;
+		do {
+			if ((result = pointer(head_)) == NULL)
+				break;
+		} while (!mHead.compare_exchange_weak(head_, make(result->next(), tag(head_) + 1), std::memory_order_acquire, std::memory_order_acquire));
+		return result;
+	}
+	
+	T *		pop_atomic_single_reader() { return pop_atomic(); }
+	
+	T *		pop_all()
+		// takes the whole list in one exchange, newest first
+	{
+		Word head_ = mHead.load(std::memory_order_relaxed);
+		while (pointer(head_) != NULL
+			   && !mHead.compare_exchange_weak(head_, make(NULL, tag(head_) + 1), std::memory_order_acquire, std::memory_order_relaxed))
+			;
+		return pointer(head_);
+	}
+	
+	T *		pop_all_reversed()
+		// takes the whole list in one exchange, oldest first
+	{
+		T *p = pop_all(), *reversed = NULL, *next;
+		while (p != NULL) {
+			next = p->next();
+			p->next() = reversed;
+			reversed = p;
+			p = next;
+		}
+		return reversed;
+	}
+	
+private:
+	typedef uint64_t Word;
+	enum { kPointerBits = sizeof(void *) == 8 ? 48 : 32 };		// user space addresses fit in 48 bits
+	
+	static T *	pointer(Word w) { return (T *)(uintptr_t)(w & ((Word(1) << kPointerBits) - 1)); }
+	static Word	tag(Word w) { return w >> kPointerBits; }
+	static Word	make(T *p, Word inTag) { return Word(uintptr_t(p)) | (inTag << kPointerBits); }
+	
+	std::atomic<Word>	mHead;
+};
+#endif // __cplusplus >= 201103L
+
 #if ((MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_5) && !TARGET_OS_WIN32)
 #include <libkern/OSAtomic.h>
 
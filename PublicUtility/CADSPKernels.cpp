@@ -0,0 +1,467 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+#include "CADSPKernels.h"
+
+#if CA_DSP_USE_ACCELERATE
+	#include <Accelerate/Accelerate.h>
+#endif
+
+#if defined(__SSE2__)
+	#include <immintrin.h>
+	#define CA_DSP_X86 1
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define CA_DSP_NEON 1
+#endif
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Scalar
+
+static void		MultiplyScalar(	const Float32 *inA, UInt32 inStrideA, const Float32 *inB, UInt32 inStrideB,
+								Float32 *outC, UInt32 inStrideC, UInt32 inCount)
+{
+	for (UInt32 i = 0; i < inCount; ++i)
+		outC[i * inStrideC] = inA[i * inStrideA] * inB[i * inStrideB];
+}
+
+static void		AddScalar(const Float32 *inA, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	for (UInt32 i = 0; i < inCount; ++i)
+		ioC[i * inStrideC] += inA[i];
+}
+
+static void		MixScalar(const Float32 *inA, Float32 inGain, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	for (UInt32 i = 0; i < inCount; ++i)
+		ioC[i * inStrideC] += inA[i] * inGain;
+}
+
+static void		ScaleOffsetScalar(const Float32 *inA, Float32 inScale, Float32 inOffset, Float32 *outC, UInt32 inCount)
+{
+	for (UInt32 i = 0; i < inCount; ++i)
+		outC[i] = inA[i] * inScale + inOffset;
+}
+
+static void		ComplexMultiplyAddScalar(	const Float32 *inAReal, const Float32 *inAImag,
+											const Float32 *inBReal, const Float32 *inBImag,
+											Float32 *ioReal, Float32 *ioImag, UInt32 inCount)
+{
+	for (UInt32 i = 0; i < inCount; ++i) {
+		ioReal[i] += inAReal[i] * inBReal[i] - inAImag[i] * inBImag[i];
+		ioImag[i] += inAReal[i] * inBImag[i] + inAImag[i] * inBReal[i];
+	}
+}
+
+// each sample's phase is worked out from the first, so the iterations are independent
+static UInt32	TableLookupScalar(	const Float32 *inTable, UInt32 inTableBits, UInt32 inPhase, UInt32 inIncrement,
+									Float32 *outC, UInt32 inCount)
+{
+	const UInt32 shift = 32 - inTableBits, mask = (1U << inTableBits) - 1, fractionMask = (1U << shift) - 1;
+	const Float32 fractionScale = 1.f / Float32(1U << shift);
+	for (UInt32 i = 0; i < inCount; ++i) {
+		UInt32 phase = inPhase + i * inIncrement, index = phase >> shift;
+		Float32 a = inTable[index], b = inTable[(index + 1) & mask];
+		outC[i] = a + (b - a) * (Float32(phase & fractionMask) * fractionScale);
+	}
+	return inPhase + inCount * inIncrement;
+}
+
+// The recursion leaves nothing to run side by side within a section, and vDSP_biquad keeps its
+// state in single precision, with a setup allocated for each set of coefficients, so every table
+// runs the sections this way.
+static void		BiquadCascadeScalar(	const CABiquadCoefficients *inSections, CABiquadState *ioStates, UInt32 inNumSections,
+										const Float32 *inSource, UInt32 inSourceStride,
+										Float32 *outDest, UInt32 inDestStride, UInt32 inCount)
+{
+	if (inNumSections == 0) {
+		if (inSource != outDest)
+			for (UInt32 i = 0; i < inCount; ++i)
+				outDest[i * inDestStride] = inSource[i * inSourceStride];
+		return;
+	}
+	for (UInt32 s = 0; s < inNumSections; ++s) {
+		// in locals, so the compiler can hold them in registers across the loop
+		const CABiquadCoefficients c = inSections[s];
+		CABiquadState z = ioStates[s];
+		const Float32 *source = s == 0 ? inSource : outDest;
+		const UInt32 sourceStride = s == 0 ? inSourceStride : inDestStride;
+		for (UInt32 i = 0; i < inCount; ++i) {
+			Float32 input = source[i * sourceStride];
+			Float32 output = Float32(c.mA0 * input + c.mA1 * z.mX1 + c.mA2 * z.mX2 - c.mB1 * z.mY1 - c.mB2 * z.mY2);
+			z.mX2 = z.mX1;
+			z.mX1 = input;
+			z.mY2 = z.mY1;
+			z.mY1 = output;
+			outDest[i * inDestStride] = output;
+		}
+		ioStates[s] = z;
+	}
+}
+
+static const CADSPKernels sScalarKernels = {
+	CADSPKernels::kBackend_Scalar, "scalar",
+	MultiplyScalar, AddScalar, MixScalar, ScaleOffsetScalar, ComplexMultiplyAddScalar,
+	TableLookupScalar, BiquadCascadeScalar
+};
+
+#if CA_DSP_X86
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____SSE2
+
+// the vector loops take contiguous buffers; anything strided, and the last few samples, go to
+// the scalar kernels
+static void		MultiplySSE2(	const Float32 *inA, UInt32 inStrideA, const Float32 *inB, UInt32 inStrideB,
+								Float32 *outC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideA == 1 && inStrideB == 1 && inStrideC == 1)
+		for (; i + 4 <= inCount; i += 4)
+			_mm_storeu_ps(outC + i, _mm_mul_ps(_mm_loadu_ps(inA + i), _mm_loadu_ps(inB + i)));
+	MultiplyScalar(inA + i * inStrideA, inStrideA, inB + i * inStrideB, inStrideB, outC + i * inStrideC, inStrideC, inCount - i);
+}
+
+static void		AddSSE2(const Float32 *inA, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideC == 1)
+		for (; i + 4 <= inCount; i += 4)
+			_mm_storeu_ps(ioC + i, _mm_add_ps(_mm_loadu_ps(ioC + i), _mm_loadu_ps(inA + i)));
+	AddScalar(inA + i, ioC + i * inStrideC, inStrideC, inCount - i);
+}
+
+static void		MixSSE2(const Float32 *inA, Float32 inGain, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideC == 1) {
+		const __m128 gain = _mm_set1_ps(inGain);
+		for (; i + 4 <= inCount; i += 4)
+			_mm_storeu_ps(ioC + i, _mm_add_ps(_mm_loadu_ps(ioC + i), _mm_mul_ps(_mm_loadu_ps(inA + i), gain)));
+	}
+	MixScalar(inA + i, inGain, ioC + i * inStrideC, inStrideC, inCount - i);
+}
+
+static void		ScaleOffsetSSE2(const Float32 *inA, Float32 inScale, Float32 inOffset, Float32 *outC, UInt32 inCount)
+{
+	const __m128 scale = _mm_set1_ps(inScale), offset = _mm_set1_ps(inOffset);
+	UInt32 i = 0;
+	for (; i + 4 <= inCount; i += 4)
+		_mm_storeu_ps(outC + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(inA + i), scale), offset));
+	ScaleOffsetScalar(inA + i, inScale, inOffset, outC + i, inCount - i);
+}
+
+static void		ComplexMultiplyAddSSE2(	const Float32 *inAReal, const Float32 *inAImag,
+										const Float32 *inBReal, const Float32 *inBImag,
+										Float32 *ioReal, Float32 *ioImag, UInt32 inCount)
+{
+	UInt32 i = 0;
+	for (; i + 4 <= inCount; i += 4) {
+		__m128 ar = _mm_loadu_ps(inAReal + i), ai = _mm_loadu_ps(inAImag + i);
+		__m128 br = _mm_loadu_ps(inBReal + i), bi = _mm_loadu_ps(inBImag + i);
+		_mm_storeu_ps(ioReal + i, _mm_add_ps(_mm_loadu_ps(ioReal + i), _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))));
+		_mm_storeu_ps(ioImag + i, _mm_add_ps(_mm_loadu_ps(ioImag + i), _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br))));
+	}
+	ComplexMultiplyAddScalar(inAReal + i, inAImag + i, inBReal + i, inBImag + i, ioReal + i, ioImag + i, inCount - i);
+}
+
+// without a gather the table is read one point at a time, but the phases, the indices and the
+// interpolation are four wide. AVX has no gather either, so its table shares this one.
+static UInt32	TableLookupSSE2(	const Float32 *inTable, UInt32 inTableBits, UInt32 inPhase, UInt32 inIncrement,
+									Float32 *outC, UInt32 inCount)
+{
+	const UInt32 shift = 32 - inTableBits, mask = (1U << inTableBits) - 1;
+	const __m128i shiftCount = _mm_cvtsi32_si128(int(shift));
+	const __m128i fractionMask = _mm_set1_epi32(int((1U << shift) - 1));
+	const __m128 fractionScale = _mm_set1_ps(1.f / Float32(1U << shift));
+	const __m128i step = _mm_set1_epi32(int(4 * inIncrement));
+	__m128i phase = _mm_setr_epi32(int(inPhase), int(inPhase + inIncrement), int(inPhase + 2 * inIncrement), int(inPhase + 3 * inIncrement));
+
+	UInt32 i = 0;
+	for (; i + 4 <= inCount; i += 4) {
+		UInt32 index[4];
+		_mm_storeu_si128((__m128i *)index, _mm_srl_epi32(phase, shiftCount));
+		__m128 a = _mm_setr_ps(inTable[index[0]], inTable[index[1]], inTable[index[2]], inTable[index[3]]);
+		__m128 b = _mm_setr_ps(inTable[(index[0] + 1) & mask], inTable[(index[1] + 1) & mask],
+							   inTable[(index[2] + 1) & mask], inTable[(index[3] + 1) & mask]);
+		__m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(phase, fractionMask)), fractionScale);
+		_mm_storeu_ps(outC + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fraction)));
+		phase = _mm_add_epi32(phase, step);
+	}
+	return TableLookupScalar(inTable, inTableBits, inPhase + i * inIncrement, inIncrement, outC + i, inCount - i);
+}
+
+static const CADSPKernels sSSE2Kernels = {
+	CADSPKernels::kBackend_SSE2, "SSE2",
+	MultiplySSE2, AddSSE2, MixSSE2, ScaleOffsetSSE2, ComplexMultiplyAddSSE2,
+	TableLookupSSE2, BiquadCascadeScalar
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____AVX
+
+// built for AVX whatever the rest of the file is built for; ForVectorUnit() only hands them out
+// when the CPU has it
+#define CA_DSP_AVX __attribute__((target("avx")))
+
+CA_DSP_AVX static void	MultiplyAVX(	const Float32 *inA, UInt32 inStrideA, const Float32 *inB, UInt32 inStrideB,
+										Float32 *outC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideA == 1 && inStrideB == 1 && inStrideC == 1)
+		for (; i + 8 <= inCount; i += 8)
+			_mm256_storeu_ps(outC + i, _mm256_mul_ps(_mm256_loadu_ps(inA + i), _mm256_loadu_ps(inB + i)));
+	MultiplySSE2(inA + i * inStrideA, inStrideA, inB + i * inStrideB, inStrideB, outC + i * inStrideC, inStrideC, inCount - i);
+}
+
+CA_DSP_AVX static void	AddAVX(const Float32 *inA, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideC == 1)
+		for (; i + 8 <= inCount; i += 8)
+			_mm256_storeu_ps(ioC + i, _mm256_add_ps(_mm256_loadu_ps(ioC + i), _mm256_loadu_ps(inA + i)));
+	AddSSE2(inA + i, ioC + i * inStrideC, inStrideC, inCount - i);
+}
+
+CA_DSP_AVX static void	MixAVX(const Float32 *inA, Float32 inGain, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideC == 1) {
+		const __m256 gain = _mm256_set1_ps(inGain);
+		for (; i + 8 <= inCount; i += 8)
+			_mm256_storeu_ps(ioC + i, _mm256_add_ps(_mm256_loadu_ps(ioC + i), _mm256_mul_ps(_mm256_loadu_ps(inA + i), gain)));
+	}
+	MixSSE2(inA + i, inGain, ioC + i * inStrideC, inStrideC, inCount - i);
+}
+
+CA_DSP_AVX static void	ScaleOffsetAVX(const Float32 *inA, Float32 inScale, Float32 inOffset, Float32 *outC, UInt32 inCount)
+{
+	const __m256 scale = _mm256_set1_ps(inScale), offset = _mm256_set1_ps(inOffset);
+	UInt32 i = 0;
+	for (; i + 8 <= inCount; i += 8)
+		_mm256_storeu_ps(outC + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(inA + i), scale), offset));
+	ScaleOffsetSSE2(inA + i, inScale, inOffset, outC + i, inCount - i);
+}
+
+CA_DSP_AVX static void	ComplexMultiplyAddAVX(	const Float32 *inAReal, const Float32 *inAImag,
+												const Float32 *inBReal, const Float32 *inBImag,
+												Float32 *ioReal, Float32 *ioImag, UInt32 inCount)
+{
+	UInt32 i = 0;
+	for (; i + 8 <= inCount; i += 8) {
+		__m256 ar = _mm256_loadu_ps(inAReal + i), ai = _mm256_loadu_ps(inAImag + i);
+		__m256 br = _mm256_loadu_ps(inBReal + i), bi = _mm256_loadu_ps(inBImag + i);
+		_mm256_storeu_ps(ioReal + i, _mm256_add_ps(_mm256_loadu_ps(ioReal + i), _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi))));
+		_mm256_storeu_ps(ioImag + i, _mm256_add_ps(_mm256_loadu_ps(ioImag + i), _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br))));
+	}
+	ComplexMultiplyAddSSE2(inAReal + i, inAImag + i, inBReal + i, inBImag + i, ioReal + i, ioImag + i, inCount - i);
+}
+
+static const CADSPKernels sAVXKernels = {
+	CADSPKernels::kBackend_AVX, "AVX",
+	MultiplyAVX, AddAVX, MixAVX, ScaleOffsetAVX, ComplexMultiplyAddAVX,
+	TableLookupSSE2, BiquadCascadeScalar
+};
+
+#define CA_DSP_VECTOR_TABLE_LOOKUP TableLookupSSE2
+
+#endif // CA_DSP_X86
+
+#if CA_DSP_NEON
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____NEON
+
+static void		MultiplyNEON(	const Float32 *inA, UInt32 inStrideA, const Float32 *inB, UInt32 inStrideB,
+								Float32 *outC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideA == 1 && inStrideB == 1 && inStrideC == 1)
+		for (; i + 4 <= inCount; i += 4)
+			vst1q_f32(outC + i, vmulq_f32(vld1q_f32(inA + i), vld1q_f32(inB + i)));
+	MultiplyScalar(inA + i * inStrideA, inStrideA, inB + i * inStrideB, inStrideB, outC + i * inStrideC, inStrideC, inCount - i);
+}
+
+static void		AddNEON(const Float32 *inA, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideC == 1)
+		for (; i + 4 <= inCount; i += 4)
+			vst1q_f32(ioC + i, vaddq_f32(vld1q_f32(ioC + i), vld1q_f32(inA + i)));
+	AddScalar(inA + i, ioC + i * inStrideC, inStrideC, inCount - i);
+}
+
+static void		MixNEON(const Float32 *inA, Float32 inGain, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	UInt32 i = 0;
+	if (inStrideC == 1)
+		for (; i + 4 <= inCount; i += 4)
+			vst1q_f32(ioC + i, vmlaq_n_f32(vld1q_f32(ioC + i), vld1q_f32(inA + i), inGain));
+	MixScalar(inA + i, inGain, ioC + i * inStrideC, inStrideC, inCount - i);
+}
+
+static void		ScaleOffsetNEON(const Float32 *inA, Float32 inScale, Float32 inOffset, Float32 *outC, UInt32 inCount)
+{
+	const float32x4_t offset = vdupq_n_f32(inOffset);
+	UInt32 i = 0;
+	for (; i + 4 <= inCount; i += 4)
+		vst1q_f32(outC + i, vmlaq_n_f32(offset, vld1q_f32(inA + i), inScale));
+	ScaleOffsetScalar(inA + i, inScale, inOffset, outC + i, inCount - i);
+}
+
+static void		ComplexMultiplyAddNEON(	const Float32 *inAReal, const Float32 *inAImag,
+										const Float32 *inBReal, const Float32 *inBImag,
+										Float32 *ioReal, Float32 *ioImag, UInt32 inCount)
+{
+	UInt32 i = 0;
+	for (; i + 4 <= inCount; i += 4) {
+		float32x4_t ar = vld1q_f32(inAReal + i), ai = vld1q_f32(inAImag + i);
+		float32x4_t br = vld1q_f32(inBReal + i), bi = vld1q_f32(inBImag + i);
+		vst1q_f32(ioReal + i, vmlsq_f32(vmlaq_f32(vld1q_f32(ioReal + i), ar, br), ai, bi));
+		vst1q_f32(ioImag + i, vmlaq_f32(vmlaq_f32(vld1q_f32(ioImag + i), ar, bi), ai, br));
+	}
+	ComplexMultiplyAddScalar(inAReal + i, inAImag + i, inBReal + i, inBImag + i, ioReal + i, ioImag + i, inCount - i);
+}
+
+static UInt32	TableLookupNEON(	const Float32 *inTable, UInt32 inTableBits, UInt32 inPhase, UInt32 inIncrement,
+									Float32 *outC, UInt32 inCount)
+{
+	const UInt32 shift = 32 - inTableBits, mask = (1U << inTableBits) - 1;
+	const int32x4_t shiftCount = vdupq_n_s32(-int(shift));
+	const uint32x4_t fractionMask = vdupq_n_u32((1U << shift) - 1);
+	const Float32 fractionScale = 1.f / Float32(1U << shift);
+	const uint32x4_t step = vdupq_n_u32(4 * inIncrement);
+	const UInt32 start[4] = { inPhase, inPhase + inIncrement, inPhase + 2 * inIncrement, inPhase + 3 * inIncrement };
+	uint32x4_t phase = vld1q_u32(start);
+
+	UInt32 i = 0;
+	for (; i + 4 <= inCount; i += 4) {
+		UInt32 index[4];
+		vst1q_u32(index, vshlq_u32(phase, shiftCount));
+		Float32 a[4] = { inTable[index[0]], inTable[index[1]], inTable[index[2]], inTable[index[3]] };
+		Float32 b[4] = { inTable[(index[0] + 1) & mask], inTable[(index[1] + 1) & mask],
+						 inTable[(index[2] + 1) & mask], inTable[(index[3] + 1) & mask] };
+		float32x4_t va = vld1q_f32(a);
+		float32x4_t fraction = vmulq_n_f32(vcvtq_f32_u32(vandq_u32(phase, fractionMask)), fractionScale);
+		vst1q_f32(outC + i, vmlaq_f32(va, vsubq_f32(vld1q_f32(b), va), fraction));
+		phase = vaddq_u32(phase, step);
+	}
+	return TableLookupScalar(inTable, inTableBits, inPhase + i * inIncrement, inIncrement, outC + i, inCount - i);
+}
+
+static const CADSPKernels sNEONKernels = {
+	CADSPKernels::kBackend_NEON, "NEON",
+	MultiplyNEON, AddNEON, MixNEON, ScaleOffsetNEON, ComplexMultiplyAddNEON,
+	TableLookupNEON, BiquadCascadeScalar
+};
+
+#define CA_DSP_VECTOR_TABLE_LOOKUP TableLookupNEON
+
+#endif // CA_DSP_NEON
+
+#if CA_DSP_USE_ACCELERATE
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Accelerate
+
+static void		MultiplyAccelerate(	const Float32 *inA, UInt32 inStrideA, const Float32 *inB, UInt32 inStrideB,
+									Float32 *outC, UInt32 inStrideC, UInt32 inCount)
+{
+	vDSP_vmul(inA, inStrideA, inB, inStrideB, outC, inStrideC, inCount);
+}
+
+static void		AddAccelerate(const Float32 *inA, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	vDSP_vadd(inA, 1, ioC, inStrideC, ioC, inStrideC, inCount);
+}
+
+static void		MixAccelerate(const Float32 *inA, Float32 inGain, Float32 *ioC, UInt32 inStrideC, UInt32 inCount)
+{
+	vDSP_vsma(inA, 1, &inGain, ioC, inStrideC, ioC, inStrideC, inCount);
+}
+
+static void		ScaleOffsetAccelerate(const Float32 *inA, Float32 inScale, Float32 inOffset, Float32 *outC, UInt32 inCount)
+{
+	vDSP_vsmsa(inA, 1, &inScale, &inOffset, outC, 1, inCount);
+}
+
+static void		ComplexMultiplyAddAccelerate(	const Float32 *inAReal, const Float32 *inAImag,
+												const Float32 *inBReal, const Float32 *inBImag,
+												Float32 *ioReal, Float32 *ioImag, UInt32 inCount)
+{
+	DSPSplitComplex a = { const_cast<Float32 *>(inAReal), const_cast<Float32 *>(inAImag) };
+	DSPSplitComplex b = { const_cast<Float32 *>(inBReal), const_cast<Float32 *>(inBImag) };
+	DSPSplitComplex c = { ioReal, ioImag };
+	vDSP_zvma(&a, 1, &b, 1, &c, 1, &c, 1, inCount);
+}
+
+// vDSP has no table read that wraps, so that comes from the hand-written kernels
+#if !defined(CA_DSP_VECTOR_TABLE_LOOKUP)
+	#define CA_DSP_VECTOR_TABLE_LOOKUP TableLookupScalar
+#endif
+
+static const CADSPKernels sAccelerateKernels = {
+	CADSPKernels::kBackend_Accelerate, "Accelerate",
+	MultiplyAccelerate, AddAccelerate, MixAccelerate, ScaleOffsetAccelerate, ComplexMultiplyAddAccelerate,
+	CA_DSP_VECTOR_TABLE_LOOKUP, BiquadCascadeScalar
+};
+
+#endif // CA_DSP_USE_ACCELERATE
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____CADSPKernels
+
+const CADSPKernels &	CADSPKernels::ForVectorUnit(SInt32 inVectorUnitType)
+{
+#if CA_DSP_NEON
+	return *ForBackend(CA_DSP_USE_ACCELERATE ? kBackend_Accelerate : kBackend_NEON);
+#else
+	if (inVectorUnitType <= kVecNone || inVectorUnitType == kVecAltivec)
+		return sScalarKernels;
+	#if CA_DSP_USE_ACCELERATE
+		return sAccelerateKernels;
+	#elif CA_DSP_X86
+		if (inVectorUnitType >= kVecAVX1 && inVectorUnitType < kVecNeon)
+			return sAVXKernels;
+		if (inVectorUnitType >= kVecSSE2 && inVectorUnitType < kVecNeon)
+			return sSSE2Kernels;
+	#endif
+	return sScalarKernels;
+#endif
+}
+
+const CADSPKernels *	CADSPKernels::ForBackend(Backend inBackend)
+{
+	switch (inBackend)
+	{
+		case kBackend_Scalar:
+			return &sScalarKernels;
+#if CA_DSP_X86
+		case kBackend_SSE2:
+			return &sSSE2Kernels;
+		case kBackend_AVX:
+			return CAVectorUnit::HasAVX1() ? &sAVXKernels : NULL;
+#elif CA_DSP_NEON
+		case kBackend_NEON:
+			return &sNEONKernels;
+#endif
+#if CA_DSP_USE_ACCELERATE
+		case kBackend_Accelerate:
+			return &sAccelerateKernels;
+#endif
+		default:
+			return NULL;
+	}
+}
+
+// picked at load time, so the render thread never pays for the sysctl or a static-init guard
+static const CADSPKernels &sDefaultKernels = CADSPKernels::ForVectorUnit(CAVectorUnit::GetVectorUnitType());
+
+const CADSPKernels &	CADSPKernels::Default()
+{
+	return sDefaultKernels;
+}
@@ -0,0 +1,113 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+#ifndef __CADSPKernels_h__
+#define __CADSPKernels_h__
+
+#include "CAVectorUnit.h"
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+// vDSP is used wherever Accelerate is there to link against, unless the build says otherwise
+#if !defined(CA_DSP_USE_ACCELERATE)
+	#if defined(__APPLE__)
+		#define CA_DSP_USE_ACCELERATE 1
+	#else
+		#define CA_DSP_USE_ACCELERATE 0
+	#endif
+#endif
+
+// y = a0 x + a1 x[-1] + a2 x[-2] - b1 y[-1] - b2 y[-2]
+struct CABiquadCoefficients
+{
+	double	mA0;
+	double	mA1;
+	double	mA2;
+	double	mB1;
+	double	mB2;
+};
+
+struct CABiquadState
+{
+	double	mX1;
+	double	mX2;
+	double	mY1;
+	double	mY2;
+};
+
+/*
+	CADSPKernels is a table of the inner loops the example units share, in as many versions as
+	there are ways to run them: plain C++, SSE2, AVX and NEON written out by hand, and Accelerate's
+	vDSP on the Mac. ForVectorUnit() hands out the best table for a CAVectorUnit type; a unit asks
+	once, in Initialize(), and keeps the reference, so the render thread only pays for an indirect
+	call. Every table has every kernel: where a backend has nothing better, it uses the next one's.
+
+	Strides are in samples. Unless a kernel says otherwise its buffers must not overlap, but for
+	an output that is also an input at the same stride.
+*/
+struct CADSPKernels
+{
+	enum Backend
+	{
+		kBackend_Scalar			= 0,
+		kBackend_SSE2			= 1,
+		kBackend_AVX			= 2,
+		kBackend_NEON			= 3,
+		kBackend_Accelerate		= 4
+	};
+
+	Backend			mBackend;
+	const char *	mName;
+
+	// outC[i * inStrideC] = inA[i * inStrideA] * inB[i * inStrideB]
+	void			(*Multiply)(	const Float32 *inA, UInt32 inStrideA, const Float32 *inB, UInt32 inStrideB,
+									Float32 *outC, UInt32 inStrideC, UInt32 inCount);
+
+	// ioC[i * inStrideC] += inA[i]
+	void			(*Add)(			const Float32 *inA, Float32 *ioC, UInt32 inStrideC, UInt32 inCount);
+
+	// ioC[i * inStrideC] += inA[i] * inGain
+	void			(*Mix)(			const Float32 *inA, Float32 inGain, Float32 *ioC, UInt32 inStrideC, UInt32 inCount);
+
+	// outC[i] = inA[i] * inScale + inOffset
+	void			(*ScaleOffset)(	const Float32 *inA, Float32 inScale, Float32 inOffset, Float32 *outC, UInt32 inCount);
+
+	// ioReal[i] + j ioImag[i] += (inAReal[i] + j inAImag[i]) * (inBReal[i] + j inBImag[i])
+	void			(*ComplexMultiplyAdd)(	const Float32 *inAReal, const Float32 *inAImag,
+											const Float32 *inBReal, const Float32 *inBImag,
+											Float32 *ioReal, Float32 *ioImag, UInt32 inCount);
+
+	// reads one cycle of 2^inTableBits points at a phase that wraps at 2^32, starting at inPhase and
+	// advancing inIncrement per sample, interpolating linearly between the points. Returns the
+	// phase after the last sample.
+	UInt32			(*TableLookup)(	const Float32 *inTable, UInt32 inTableBits, UInt32 inPhase, UInt32 inIncrement,
+									Float32 *outC, UInt32 inCount);
+
+	// runs inCount samples through inNumSections sections, one after the other. Each section keeps
+	// its state in double but rounds its output to Float32 before feeding it back, as the filters
+	// written out by hand do. inSource may be outDest.
+	void			(*BiquadCascade)(	const CABiquadCoefficients *inSections, CABiquadState *ioStates, UInt32 inNumSections,
+										const Float32 *inSource, UInt32 inSourceStride,
+										Float32 *outDest, UInt32 inDestStride, UInt32 inCount);
+
+	// the best table for a CAVectorUnit type: kVecNone, as when CA_NoVector is set, gets the scalar
+	// kernels, except on ARM, where NEON is always there but CAVectorUnit only reports it when
+	// built with CA_ARM_NEON
+	static const CADSPKernels &		ForVectorUnit(SInt32 inVectorUnitType);
+
+	// one backend's table, to compare them; NULL if this build or this CPU doesn't have it
+	static const CADSPKernels *		ForBackend(Backend inBackend);
+
+	// ForVectorUnit(CAVectorUnit::GetVectorUnitType()), looked up when the library loads
+	static const CADSPKernels &		Default();
+};
+
+#endif // __CADSPKernels_h__
@@ -0,0 +1,93 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+#ifndef __CADenormalGuard_h__
+#define __CADenormalGuard_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(__i386__)
+	#include <xmmintrin.h>
+	#define CA_DENORMAL_GUARD_X86 1
+#elif defined(__aarch64__) || defined(__arm__)
+	#define CA_DENORMAL_GUARD_ARM 1
+#endif
+
+/*
+	CADenormalGuard turns on flush-to-zero for the thread that constructs it, and puts the floating
+	point mode back as it was when it goes out of scope. On x86 that is MXCSR's FTZ and DAZ bits, so
+	denormal results and operands both become zero; on ARM it is the FZ bit of FPCR (FPSCR on 32-bit
+	ARM), which covers both. A filter's feedback or a release tail decaying toward zero otherwise
+	spends its last few thousand samples on denormals, which x86 handles in microcode at many times
+	the cost of a normal operation.
+
+	Engaged() tells whether the guard had to change the mode, i.e. the thread was not already
+	flushing: a host that sets the mode itself, or a unit nested inside another's render, leaves it
+	false. Reading and writing the control register costs a few cycles and never traps.
+*/
+class CADenormalGuard
+{
+public:
+	explicit CADenormalGuard(bool inEnable = true)
+		: mSaved(0), mEngaged(false)
+	{
+		if (!inEnable)
+			return;
+		mSaved = GetMode();
+		if ((mSaved & kFlushBits) != kFlushBits) {
+			SetMode(mSaved | kFlushBits);
+			mEngaged = true;
+		}
+	}
+
+	~CADenormalGuard()
+	{
+		if (mEngaged)
+			SetMode(mSaved);
+	}
+
+	bool				Engaged() const { return mEngaged; }
+
+	// whether the calling thread flushes denormals to zero, whoever turned it on
+	static bool			IsFlushing() { return kFlushBits != 0 && (GetMode() & kFlushBits) == kFlushBits; }
+
+private:
+	CADenormalGuard(const CADenormalGuard &);
+	CADenormalGuard &	operator=(const CADenormalGuard &);
+
+#if CA_DENORMAL_GUARD_X86
+	enum { kFlushBits = 0x8040 };		// FTZ | DAZ
+	typedef UInt32		Mode;
+	static Mode			GetMode() { return _mm_getcsr(); }
+	static void			SetMode(Mode inMode) { _mm_setcsr(inMode); }
+#elif CA_DENORMAL_GUARD_ARM && defined(__aarch64__)
+	enum { kFlushBits = 1 << 24 };		// FZ
+	typedef UInt64		Mode;
+	static Mode			GetMode() { Mode mode; __asm__ __volatile__("mrs %0, fpcr" : "=r"(mode)); return mode; }
+	static void			SetMode(Mode inMode) { __asm__ __volatile__("msr fpcr, %0" : : "r"(inMode)); }
+#elif CA_DENORMAL_GUARD_ARM
+	enum { kFlushBits = 1 << 24 };		// FZ
+	typedef UInt32		Mode;
+	static Mode			GetMode() { Mode mode; __asm__ __volatile__("vmrs %0, fpscr" : "=r"(mode)); return mode; }
+	static void			SetMode(Mode inMode) { __asm__ __volatile__("vmsr fpscr, %0" : : "r"(inMode)); }
+#else
+	// nothing to set; the guard never engages
+	enum { kFlushBits = 0 };
+	typedef UInt32		Mode;
+	static Mode			GetMode() { return 0; }
+	static void			SetMode(Mode) { }
+#endif
+
+	Mode				mSaved;
+	bool				mEngaged;
+};
+
+#endif // __CADenormalGuard_h__
@@ -17,11 +17,16 @@ Float64			CAHostTimeBase::sInverseFrequency = 0;
 UInt32			CAHostTimeBase::sMinDelta = 0;
 UInt32			CAHostTimeBase::sToNanosNumerator = 0;
 UInt32			CAHostTimeBase::sToNanosDenominator = 0;
+CAHostTimeBase::FixedRatio	CAHostTimeBase::sToNanos = { 0, 0 };
+CAHostTimeBase::FixedRatio	CAHostTimeBase::sFromNanos = { 0, 0 };
 pthread_once_t	CAHostTimeBase::sIsInited = PTHREAD_ONCE_INIT;
 #if Track_Host_TimeBase
 UInt64			CAHostTimeBase::sLastTime = 0;
 #endif
 
+//	set the conversions up at load time, so that ConvertToNanos and ConvertFromNanos go straight to the multiply
+static const Float64	sLoadTimeFrequency = CAHostTimeBase::GetFrequency();
+
 //=============================================================================
 //	CAHostTimeBase
 //
@@ -48,8 +53,15 @@ void	CAHostTimeBase::Initialize()
 		sToNanosNumerator = 1000000000ULL;
 		sToNanosDenominator = *((UInt64*)&theFrequency);
 		sFrequency = static_cast<Float64>(*((UInt64*)&theFrequency));
+	#else
+		sMinDelta = 1;
+		sToNanosNumerator = 1;
+		sToNanosDenominator = 1;
+		sFrequency = 1000000000.0;
 	#endif
 	sInverseFrequency = 1.0 / sFrequency;
+	sFromNanos = MakeFixedRatio(sToNanosDenominator, sToNanosNumerator);
+	sToNanos = MakeFixedRatio(sToNanosNumerator, sToNanosDenominator);
 	
 	#if	Log_Host_Time_Base_Parameters
 		DebugPrintf("Host Time Base Parameters");
@@ -59,3 +71,30 @@ void	CAHostTimeBase::Initialize()
 		DebugPrintf(" To Nanos Denominator:   %lu", (unsigned long)sToNanosDenominator);
 	#endif
 }
+
+CAHostTimeBase::FixedRatio	CAHostTimeBase::MakeFixedRatio(UInt32 inNumerator, UInt32 inDenominator)
+{
+	FixedRatio theRatio;
+	theRatio.mWhole = inNumerator / inDenominator;
+	theRatio.mFraction = 0;
+
+	//	long division of the remainder, one bit of the fraction at a time
+	UInt64 theRemainder = inNumerator % inDenominator;
+	for(UInt32 theBit = 0; theBit < 64; ++theBit)
+	{
+		theRemainder <<= 1;
+		theRatio.mFraction <<= 1;
+		if(theRemainder >= inDenominator)
+		{
+			theRemainder -= inDenominator;
+			theRatio.mFraction |= 1;
+		}
+	}
+	
+	//	rounding up keeps the truncated product from landing one short of an exact answer
+	if(theRemainder != 0)
+	{
+		++theRatio.mFraction;
+	}
+	return theRatio;
+}
@@ -26,7 +26,9 @@ Part of Core Audio Public Utility Classes
 	#include <windows.h>
 	#include "WinPThreadDefs.h"
 #else
-	#error	Unsupported operating system
+	//	any other POSIX system: host time is CLOCK_MONOTONIC in nanoseconds
+	#include <pthread.h>
+	#include <time.h>
 #endif
 
 #include "CADebugPrintf.h"
@@ -65,7 +67,17 @@ public:
 	static UInt64			MultiplyByRatio(UInt64 inMuliplicand, UInt32 inNumerator, UInt32 inDenominator);
 	
 private:
+	//	a ratio as a 64.64 fixed point number, rounded up so that exact multiples convert exactly
+	struct FixedRatio
+	{
+		UInt64				mWhole;
+		UInt64				mFraction;
+	};
+
 	static void				Initialize();
+	static FixedRatio		MakeFixedRatio(UInt32 inNumerator, UInt32 inDenominator);
+	static UInt64			MultiplyByFixedRatio(UInt64 inMuliplicand, const FixedRatio& inRatio);
+	static bool				IsInitialized() { return (sToNanos.mWhole | sToNanos.mFraction) != 0; }
 	
 	static pthread_once_t	sIsInited;
 	
@@ -74,6 +86,8 @@ private:
 	static UInt32			sMinDelta;
 	static UInt32			sToNanosNumerator;
 	static UInt32			sToNanosDenominator;
+	static FixedRatio		sToNanos;
+	static FixedRatio		sFromNanos;
 #if Track_Host_TimeBase
 	static UInt64			sLastTime;
 #endif
@@ -89,6 +103,10 @@ inline UInt64	CAHostTimeBase::GetTheCurrentTime()
 		LARGE_INTEGER theValue;
 		QueryPerformanceCounter(&theValue);
 		theTime = *((UInt64*)&theValue);
+	#else
+		struct timespec theValue;
+		clock_gettime(CLOCK_MONOTONIC, &theValue);
+		theTime = static_cast<UInt64>(theValue.tv_sec) * 1000000000ULL + static_cast<UInt64>(theValue.tv_nsec);
 	#endif
 	
 	#if	Track_Host_TimeBase
@@ -111,9 +129,13 @@ inline UInt64	CAHostTimeBase::GetTheCurrentTime()
 
 inline UInt64	CAHostTimeBase::ConvertToNanos(UInt64 inHostTime)
 {
-	pthread_once(&sIsInited, Initialize);
+	//	the ratios are set up at load time; this only catches a static initializer that runs first
+	if(!IsInitialized())
+	{
+		pthread_once(&sIsInited, Initialize);
+	}
 	
-	UInt64 theAnswer = MultiplyByRatio(inHostTime, sToNanosNumerator, sToNanosDenominator);
+	UInt64 theAnswer = MultiplyByFixedRatio(inHostTime, sToNanos);
 	#if CoreAudio_Debug
 		if(((sToNanosNumerator > sToNanosDenominator) && (theAnswer < inHostTime)) || ((sToNanosDenominator > sToNanosNumerator) && (theAnswer > inHostTime)))
 		{
@@ -126,9 +148,12 @@ inline UInt64	CAHostTimeBase::ConvertToNanos(UInt64 inHostTime)
 
 inline UInt64	CAHostTimeBase::ConvertFromNanos(UInt64 inNanos)
 {
-	pthread_once(&sIsInited, Initialize);
+	if(!IsInitialized())
+	{
+		pthread_once(&sIsInited, Initialize);
+	}
 
-	UInt64 theAnswer = MultiplyByRatio(inNanos, sToNanosDenominator, sToNanosNumerator);
+	UInt64 theAnswer = MultiplyByFixedRatio(inNanos, sFromNanos);
 	#if CoreAudio_Debug
 		if(((sToNanosDenominator > sToNanosNumerator) && (theAnswer < inNanos)) || ((sToNanosNumerator > sToNanosDenominator) && (theAnswer > inNanos)))
 		{
@@ -193,4 +218,22 @@ inline UInt64	CAHostTimeBase::MultiplyByRatio(UInt64 inMuliplicand, UInt32 inNum
 	return static_cast<UInt64>(theAnswer);
 }
 
+inline UInt64	CAHostTimeBase::MultiplyByFixedRatio(UInt64 inMuliplicand, const FixedRatio& inRatio)
+{
+	//	the whole part times the multiplicand, plus the high half of the fraction times it: no division
+	UInt64 theAnswer = inMuliplicand * inRatio.mWhole;
+#if defined(__SIZEOF_INT128__)
+	theAnswer += static_cast<UInt64>((static_cast<__uint128_t>(inMuliplicand) * inRatio.mFraction) >> 64);
+#else
+	UInt64 theMultiplicandLo = inMuliplicand & 0xFFFFFFFFULL;
+	UInt64 theMultiplicandHi = inMuliplicand >> 32;
+	UInt64 theFractionLo = inRatio.mFraction & 0xFFFFFFFFULL;
+	UInt64 theFractionHi = inRatio.mFraction >> 32;
+	UInt64 theHiLo = theMultiplicandHi * theFractionLo;
+	UInt64 theMiddle = ((theMultiplicandLo * theFractionLo) >> 32) + (theHiLo & 0xFFFFFFFFULL) + theMultiplicandLo * theFractionHi;
+	theAnswer += theMultiplicandHi * theFractionHi + (theHiLo >> 32) + (theMiddle >> 32);
+#endif
+	return theAnswer;
+}
+
 #endif
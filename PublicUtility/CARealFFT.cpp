@@ -0,0 +1,229 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+#include "CARealFFT.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	CARealFFT::CARealFFT
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+CARealFFT::CARealFFT()
+	: mSize(0), mKernels(NULL)
+#if CA_DSP_USE_ACCELERATE
+	, mSetup(NULL), mLog2Size(0)
+#endif
+{
+}
+
+CARealFFT::CARealFFT(const CARealFFT &inOther)
+	: mSize(0), mKernels(NULL)
+#if CA_DSP_USE_ACCELERATE
+	, mSetup(NULL), mLog2Size(0)
+#endif
+{
+	*this = inOther;
+}
+
+CARealFFT &		CARealFFT::operator=(const CARealFFT &inOther)
+{
+	if (this != &inOther) {
+		Release();
+		if (inOther.mSize)
+			Prepare(inOther.mSize, *inOther.mKernels);
+	}
+	return *this;
+}
+
+CARealFFT::~CARealFFT()
+{
+	Release();
+}
+
+void		CARealFFT::Release()
+{
+#if CA_DSP_USE_ACCELERATE
+	if (mSetup) {
+		vDSP_destroy_fftsetup(mSetup);
+		mSetup = NULL;
+	}
+#endif
+	mSize = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	CARealFFT::Prepare
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		CARealFFT::Prepare(UInt32 inSize, const CADSPKernels &inKernels)
+{
+	Release();
+	mSize = inSize;
+	mKernels = &inKernels;
+	const UInt32 half = inSize / 2;
+
+	UInt32 bits = 0;
+	while ((1U << bits) < half)
+		++bits;
+
+	mReal.assign(half, 0.f);
+	mImag.assign(half, 0.f);
+
+#if CA_DSP_USE_ACCELERATE
+	if (inKernels.mBackend == CADSPKernels::kBackend_Accelerate) {
+		mLog2Size = bits + 1;
+		mSetup = vDSP_create_fftsetup(mLog2Size, kFFTRadix2);
+		if (mSetup) {
+			mBitReverse.clear();
+			mCos.clear();
+			mSin.clear();
+			mSplitCos.clear();
+			mSplitSin.clear();
+			return;
+		}
+	}
+#endif
+
+	mBitReverse.resize(half);
+	for (UInt32 i = 0; i < half; ++i) {
+		UInt32 reversed = 0;
+		for (UInt32 b = 0; b < bits; ++b)
+			if (i & (1U << b))
+				reversed |= 1U << (bits - 1 - b);
+		mBitReverse[i] = reversed;
+	}
+
+	mCos.resize(half / 2 + 1);
+	mSin.resize(half / 2 + 1);
+	for (UInt32 k = 0; k <= half / 2; ++k) {
+		mCos[k] = Float32(cos(2. * M_PI * k / half));
+		mSin[k] = Float32(sin(2. * M_PI * k / half));
+	}
+
+	mSplitCos.resize(half + 1);
+	mSplitSin.resize(half + 1);
+	for (UInt32 k = 0; k <= half; ++k) {
+		mSplitCos[k] = Float32(cos(2. * M_PI * k / inSize));
+		mSplitSin[k] = Float32(-sin(2. * M_PI * k / inSize));
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	CARealFFT::Transform
+//
+//	in-place radix-2 transform of mSize / 2 complex samples, unscaled both ways
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		CARealFFT::Transform(Float32 *ioReal, Float32 *ioImag, bool inInverse) const
+{
+	const UInt32 size = mSize / 2;
+	for (UInt32 i = 0; i < size; ++i) {
+		UInt32 j = mBitReverse[i];
+		if (i < j) {
+			std::swap(ioReal[i], ioReal[j]);
+			std::swap(ioImag[i], ioImag[j]);
+		}
+	}
+	const Float32 sign = inInverse ? 1.f : -1.f;
+	for (UInt32 half = 1; half < size; half <<= 1) {
+		UInt32 stride = size / (2 * half);
+		for (UInt32 start = 0; start < size; start += 2 * half) {
+			for (UInt32 k = 0; k < half; ++k) {
+				Float32 wr = mCos[k * stride], wi = sign * mSin[k * stride];
+				UInt32 a = start + k, b = a + half;
+				Float32 tr = ioReal[b] * wr - ioImag[b] * wi;
+				Float32 ti = ioReal[b] * wi + ioImag[b] * wr;
+				ioReal[b] = ioReal[a] - tr;
+				ioImag[b] = ioImag[a] - ti;
+				ioReal[a] += tr;
+				ioImag[a] += ti;
+			}
+		}
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	CARealFFT::Forward
+//
+//	The even samples go in the real part and the odd ones in the imaginary part; bin k of the
+//	result is then E[k] + e^(-2 pi i k / N) O[k], where E and O, the spectra of the even and odd
+//	samples, are the conjugate-symmetric and antisymmetric parts of the half-size transform.
+//	vDSP_fft_zrip does the same, but returns twice the spectrum, with the Nyquist bin's real
+//	part packed into the imaginary part of bin 0.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		CARealFFT::Forward(const Float32 *inTime, Float32 *outReal, Float32 *outImag)
+{
+	const UInt32 half = mSize / 2;
+#if CA_DSP_USE_ACCELERATE
+	if (mSetup) {
+		DSPSplitComplex split = { outReal, outImag };
+		vDSP_ctoz((const DSPComplex *)inTime, 2, &split, 1, half);
+		vDSP_fft_zrip(mSetup, &split, 1, mLog2Size, kFFTDirection_Forward);
+		const Float32 scale = 0.5f;
+		outReal[half] = outImag[0] * scale;
+		outImag[0] = outImag[half] = 0.f;
+		vDSP_vsmul(outReal, 1, &scale, outReal, 1, half);
+		vDSP_vsmul(outImag + 1, 1, &scale, outImag + 1, 1, half - 1);
+		return;
+	}
+#endif
+	Float32 *re = &mReal[0], *im = &mImag[0];
+	for (UInt32 n = 0; n < half; ++n) {
+		re[n] = inTime[2 * n];
+		im[n] = inTime[2 * n + 1];
+	}
+	Transform(re, im, false);
+
+	for (UInt32 k = 0; k <= half; ++k) {
+		UInt32 a = k & (half - 1), b = (half - k) & (half - 1);
+		Float32 er = 0.5f * (re[a] + re[b]), ei = 0.5f * (im[a] - im[b]);
+		Float32 orr = 0.5f * (im[a] + im[b]), oi = -0.5f * (re[a] - re[b]);
+		Float32 wr = mSplitCos[k], wi = mSplitSin[k];
+		outReal[k] = er + wr * orr - wi * oi;
+		outImag[k] = ei + wr * oi + wi * orr;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	CARealFFT::Inverse
+//
+//	Recovers E and O from X[k] and conj(X[N / 2 - k]), recombines them as E + i O and inverts
+//	the half-size transform, which leaves the even samples in the real part and the odd ones in
+//	the imaginary part. vDSP's inverse of the packed spectrum is already scaled by N.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		CARealFFT::Inverse(const Float32 *inReal, const Float32 *inImag, Float32 *outTime)
+{
+	const UInt32 half = mSize / 2;
+	Float32 *re = &mReal[0], *im = &mImag[0];
+#if CA_DSP_USE_ACCELERATE
+	if (mSetup) {
+		memcpy(re, inReal, half * sizeof(Float32));
+		memcpy(im, inImag, half * sizeof(Float32));
+		im[0] = inReal[half];
+		DSPSplitComplex split = { re, im };
+		vDSP_fft_zrip(mSetup, &split, 1, mLog2Size, kFFTDirection_Inverse);
+		vDSP_ztoc(&split, 1, (DSPComplex *)outTime, 2, half);
+		return;
+	}
+#endif
+	for (UInt32 k = 0; k < half; ++k) {
+		Float32 er = inReal[k] + inReal[half - k], ei = inImag[k] - inImag[half - k];
+		Float32 dr = inReal[k] - inReal[half - k], di = inImag[k] + inImag[half - k];
+		// O = (X[k] - conj(X[N / 2 - k])) e^(2 pi i k / N)
+		Float32 wr = mSplitCos[k], wi = -mSplitSin[k];
+		Float32 orr = dr * wr - di * wi, oi = dr * wi + di * wr;
+		re[k] = er - oi;
+		im[k] = ei + orr;
+	}
+	Transform(re, im, true);
+
+	for (UInt32 n = 0; n < half; ++n) {
+		outTime[2 * n] = re[n];
+		outTime[2 * n + 1] = im[n];
+	}
+}
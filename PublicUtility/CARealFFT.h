@@ -0,0 +1,57 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+#ifndef __CARealFFT_h__
+#define __CARealFFT_h__
+
+#include "CADSPKernels.h"
+#include <vector>
+
+#if CA_DSP_USE_ACCELERATE
+	#include <Accelerate/Accelerate.h>
+#endif
+
+/*
+	CARealFFT transforms Size() real samples, a power of two of at least 4, through one complex
+	transform of half the size. The spectrum is Size() / 2 + 1 bins in separate real and imaginary
+	arrays. Prepare() picks vDSP's transform when it is given the Accelerate kernels, and a radix-2
+	one of its own otherwise; both give the same results but for rounding. A copy prepares a
+	transform of its own.
+*/
+class CARealFFT
+{
+public:
+	CARealFFT();
+	CARealFFT(const CARealFFT &inOther);
+	CARealFFT &			operator=(const CARealFFT &inOther);
+	~CARealFFT();
+
+	// not real-time safe
+	void				Prepare(UInt32 inSize, const CADSPKernels &inKernels = CADSPKernels::Default());
+	UInt32				Size() const { return mSize; }
+
+	void				Forward(const Float32 *inTime, Float32 *outReal, Float32 *outImag);
+	// the inverse of Forward, scaled by Size()
+	void				Inverse(const Float32 *inReal, const Float32 *inImag, Float32 *outTime);
+
+private:
+	void				Release();
+	void				Transform(Float32 *ioReal, Float32 *ioImag, bool inInverse) const;
+
+	UInt32				mSize;
+	const CADSPKernels *	mKernels;
+	std::vector<UInt32>	mBitReverse;		// of the half-size transform
+	std::vector<Float32>	mCos, mSin;		// its twiddles
+	std::vector<Float32>	mSplitCos, mSplitSin;	// e^(-2 pi i k / mSize), separating the even and odd samples
+	std::vector<Float32>	mReal, mImag;	// scratch
+#if CA_DSP_USE_ACCELERATE
+	FFTSetup			mSetup;
+	vDSP_Length			mLog2Size;
+#endif
+};
+
+#endif // __CARealFFT_h__
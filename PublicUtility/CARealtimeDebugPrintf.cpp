@@ -0,0 +1,247 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+//==================================================================================================
+//	Includes
+//==================================================================================================
+
+//	Self Include
+#include "CARealtimeDebugPrintf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#if __APPLE__
+	#include <pthread.h>
+#endif
+
+//==================================================================================================
+//	The per-thread rings
+//
+//	Each ring has a single writer, the thread that owns it, and a single reader, whichever thread
+//	holds sDrainMutex. Reserve() links unowned rings into a list that only grows; a thread adopts
+//	one on its first call, and when the thread exits its ring is left for the next new thread to
+//	adopt once it has been drained, so the list stays about as long as the most threads that ever
+//	logged at once.
+//==================================================================================================
+
+namespace {
+
+struct Ring {
+	CARealtimeDebugPrintf::Record	mRecords[CARealtimeDebugPrintf::kRingSize];
+	std::atomic<UInt32>				mWriteIndex;
+	std::atomic<UInt32>				mReadIndex;
+	std::atomic<bool>				mOwned;
+	Ring *							mNext;		// set once, before the ring is published
+
+	Ring() : mWriteIndex(0), mReadIndex(0), mOwned(false), mNext(NULL) { }
+};
+
+std::atomic<Ring *>		sRings(NULL);
+std::atomic<UInt32>		sNumDroppedRecords(0);
+std::mutex				sDrainMutex;
+std::once_flag			sDrainThreadOnce;
+
+const UInt32			kRingMask = CARealtimeDebugPrintf::kRingSize - 1;
+const int				kDrainIntervalMilliseconds = 20;
+
+void	DrainThread()
+{
+#if __APPLE__
+	pthread_set_qos_class_self_np(QOS_CLASS_UTILITY, 0);
+#endif
+	for (;;) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(kDrainIntervalMilliseconds));
+		CARealtimeDebugPrintf::Flush();
+	}
+}
+
+// gives up the thread's ring when the thread exits
+struct RingOwner {
+	Ring *	mRing;
+	RingOwner() : mRing(NULL) { }
+	~RingOwner() { if (mRing) mRing->mOwned.store(false, std::memory_order_release); }
+};
+
+thread_local RingOwner	tRingOwner;
+
+bool	IsFree(const Ring &inRing)
+{
+	return !inRing.mOwned.load(std::memory_order_acquire)
+		&& inRing.mReadIndex.load(std::memory_order_acquire) == inRing.mWriteIndex.load(std::memory_order_relaxed);
+}
+
+// adopts a reserved or abandoned ring that has been drained; NULL if there is none. Never allocates.
+Ring *	AcquireRing()
+{
+	for (Ring *ring = sRings.load(std::memory_order_acquire); ring != NULL; ring = ring->mNext) {
+		bool owned = false;
+		if (ring->mReadIndex.load(std::memory_order_acquire) == ring->mWriteIndex.load(std::memory_order_relaxed)
+			&& ring->mOwned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+			return ring;
+	}
+	return NULL;
+}
+
+// formats one record a conversion at a time, each with its argument cast to what the
+// conversion expects, since the arguments can't be handed back to vfprintf as a va_list
+void	WriteRecord(const CARealtimeDebugPrintf::Record &inRecord, FILE *inFile)
+{
+	char line[1024];
+	size_t length = 0;
+	UInt8 argument = 0;
+	const char *p = inRecord.mFormat;
+
+	while (*p && length < sizeof(line) - 1) {
+		if (*p != '%') {
+			line[length++] = *p++;
+			continue;
+		}
+		if (p[1] == '%') {
+			line[length++] = '%';
+			p += 2;
+			continue;
+		}
+
+		// flags, width and precision are kept; length modifiers are replaced by the record's own
+		char spec[32];
+		size_t specLength = 0;
+		spec[specLength++] = *p++;
+		while (*p && strchr("-+ #0123456789.", *p) && specLength < sizeof(spec) - 4)
+			spec[specLength++] = *p++;
+		while (*p && strchr("hlLqjzt", *p))
+			++p;
+		char conversion = *p;
+		if (conversion == 0)
+			break;
+		++p;
+
+		UInt64 value = argument < inRecord.mNumArguments ? inRecord.mArguments[argument] : 0;
+		char type = argument < inRecord.mNumArguments ? inRecord.mTypes[argument] : 'u';
+		++argument;
+
+		int written;
+		if (strchr("eEfFgGaA", conversion)) {
+			spec[specLength++] = conversion;
+			spec[specLength] = 0;
+			double d = 0;
+			if (type == 'd')
+				memcpy(&d, &value, sizeof(d));
+			else
+				d = (type == 'i') ? double(SInt64(value)) : double(value);
+			written = snprintf(line + length, sizeof(line) - length, spec, d);
+		} else if (conversion == 's' || conversion == 'p') {
+			spec[specLength++] = conversion;
+			spec[specLength] = 0;
+			const void *pointer = (const void *)uintptr_t(value);
+			if (conversion == 's' && pointer == NULL)
+				pointer = "(null)";
+			written = snprintf(line + length, sizeof(line) - length, spec, pointer);
+		} else {
+			spec[specLength++] = 'l';
+			spec[specLength++] = 'l';
+			spec[specLength++] = (conversion == 'c' || conversion == 'i') ? 'd' : conversion;
+			spec[specLength] = 0;
+			if (type == 'd') {
+				double d;
+				memcpy(&d, &value, sizeof(d));
+				value = UInt64(SInt64(d));
+			}
+			if (conversion == 'c')
+				written = snprintf(line + length, sizeof(line) - length, "%c", int(value));
+			else
+				written = snprintf(line + length, sizeof(line) - length, spec, (long long)value);
+		}
+		if (written < 0)
+			break;
+		length = std::min(length + size_t(written), sizeof(line) - 1);
+	}
+	line[length] = 0;
+	fprintf(inFile, "%s\n", line);
+}
+
+}	// namespace
+
+//==================================================================================================
+//	CARealtimeDebugPrintf
+//==================================================================================================
+
+void	CARealtimeDebugPrintf::Reserve(UInt32 inNumThreads)
+{
+	std::call_once(sDrainThreadOnce, [] { std::thread(DrainThread).detach(); });
+
+	// the mutex keeps two callers from both counting the same free rings
+	static std::mutex sReserveMutex;
+	std::lock_guard<std::mutex> lock(sReserveMutex);
+	UInt32 numFree = 0;
+	for (Ring *ring = sRings.load(std::memory_order_acquire); ring != NULL; ring = ring->mNext)
+		if (IsFree(*ring))
+			++numFree;
+	for ( ; numFree < inNumThreads; ++numFree) {
+		Ring *ring = new Ring;
+		ring->mNext = sRings.load(std::memory_order_relaxed);
+		while (!sRings.compare_exchange_weak(ring->mNext, ring, std::memory_order_release, std::memory_order_relaxed))
+			;
+	}
+}
+
+CARealtimeDebugPrintf::Record *	CARealtimeDebugPrintf::BeginRecord()
+{
+	Ring *ring = tRingOwner.mRing;
+	if (ring == NULL && (ring = tRingOwner.mRing = AcquireRing()) == NULL) {
+		sNumDroppedRecords.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	UInt32 writeIndex = ring->mWriteIndex.load(std::memory_order_relaxed);
+	if (((writeIndex + 1) & kRingMask) == ring->mReadIndex.load(std::memory_order_acquire)) {
+		sNumDroppedRecords.fetch_add(1, std::memory_order_relaxed);
+		return NULL;
+	}
+	return &ring->mRecords[writeIndex];
+}
+
+void	CARealtimeDebugPrintf::EndRecord()
+{
+	Ring *ring = tRingOwner.mRing;
+	UInt32 writeIndex = ring->mWriteIndex.load(std::memory_order_relaxed);
+	ring->mWriteIndex.store((writeIndex + 1) & kRingMask, std::memory_order_release);
+}
+
+void	CARealtimeDebugPrintf::Flush()
+{
+	std::lock_guard<std::mutex> lock(sDrainMutex);
+	static UInt32 sReportedDrops = 0;
+
+	bool wrote = false;
+	for (Ring *ring = sRings.load(std::memory_order_acquire); ring != NULL; ring = ring->mNext) {
+		UInt32 readIndex = ring->mReadIndex.load(std::memory_order_relaxed);
+		UInt32 writeIndex = ring->mWriteIndex.load(std::memory_order_acquire);
+		for ( ; readIndex != writeIndex; readIndex = (readIndex + 1) & kRingMask) {
+			WriteRecord(ring->mRecords[readIndex], stderr);
+			wrote = true;
+		}
+		ring->mReadIndex.store(readIndex, std::memory_order_release);
+	}
+
+	UInt32 drops = sNumDroppedRecords.load(std::memory_order_relaxed);
+	if (drops != sReportedDrops) {
+		fprintf(stderr, "DebugPrintfRT: %u records dropped\n", (unsigned)(drops - sReportedDrops));
+		sReportedDrops = drops;
+		wrote = true;
+	}
+	if (wrote)
+		fflush(stderr);
+}
+
+UInt32	CARealtimeDebugPrintf::NumDroppedRecords()
+{
+	return sNumDroppedRecords.load(std::memory_order_relaxed);
+}
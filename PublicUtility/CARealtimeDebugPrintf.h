@@ -0,0 +1,115 @@
+/*
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Part of Core Audio Public Utility Classes
+*/
+
+#if !defined(__CARealtimeDebugPrintf_h__)
+#define __CARealtimeDebugPrintf_h__
+
+//=============================================================================
+//	Includes
+//=============================================================================
+
+#include "CADebugPrintf.h"
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+//=============================================================================
+//	CARealtimeDebugPrintf
+//
+//	DebugPrintf for the render thread. DebugPrintfRT(format, ...) takes the same format strings
+//	as DebugPrintf, but instead of formatting it copies the format and up to kMaxArguments
+//	arguments into a fixed-size record on a ring owned by the calling thread. A low-priority
+//	thread drains every thread's ring, formats the records and writes them to stderr, so the
+//	caller never touches stdio, takes a lock or allocates. Reserve() starts that thread and makes
+//	the rings, off the render thread; a thread's first call adopts one of them, and a thread that
+//	finds none, or a full ring, drops the record and counts it.
+//
+//	The format must be a string literal, or otherwise outlive the drain. So must the text behind
+//	any %s argument: only the pointer is recorded. Unlike DebugPrintf, this is compiled in
+//	whether or not DEBUG is set.
+//=============================================================================
+
+class CARealtimeDebugPrintf
+{
+public:
+	enum {
+		kMaxArguments	= 6,
+		kRingSize		= 512		// records per thread; a power of two
+	};
+
+	struct Record {
+		const char *		mFormat;
+		UInt8				mNumArguments;
+		char				mTypes[kMaxArguments];		// 'i' signed, 'u' unsigned, 'd' floating point, 'p' pointer
+		UInt64				mArguments[kMaxArguments];
+	};
+
+	template <typename... Arguments>
+	static void			Log(const char *inFormat, Arguments... inArguments)
+						{
+							static_assert(sizeof...(Arguments) <= kMaxArguments, "too many arguments for DebugPrintfRT");
+							Record *record = BeginRecord();
+							if (record == NULL)
+								return;
+							record->mFormat = inFormat;
+							record->mNumArguments = 0;
+							Store(*record, inArguments...);
+							EndRecord();
+						}
+
+	// starts the drain thread and makes sure at least inNumThreads rings are free for threads that
+	// have yet to log. Allocates and may create a thread: call it from Initialize(), not Render().
+	static void			Reserve(UInt32 inNumThreads);
+
+	// formats and writes whatever has been logged so far, on the calling thread
+	static void			Flush();
+
+	// records lost to full rings since the process started
+	static UInt32		NumDroppedRecords();
+
+private:
+	static Record *		BeginRecord();
+	static void			EndRecord();
+
+	static void			Store(Record &) { }
+
+	template <typename T, typename... Rest>
+	static void			Store(Record &ioRecord, T inArgument, Rest... inRest)
+						{
+							StoreOne(ioRecord, inArgument);
+							Store(ioRecord, inRest...);
+						}
+
+	template <typename T>
+	static void			StoreOne(Record &ioRecord, T inArgument)
+						{
+							UInt8 i = ioRecord.mNumArguments++;
+							if (std::is_floating_point<T>::value) {
+								double value = double(inArgument);
+								ioRecord.mTypes[i] = 'd';
+								memcpy(&ioRecord.mArguments[i], &value, sizeof(value));
+							} else if (std::is_signed<T>::value) {
+								ioRecord.mTypes[i] = 'i';
+								ioRecord.mArguments[i] = UInt64(SInt64(inArgument));
+							} else {
+								ioRecord.mTypes[i] = 'u';
+								ioRecord.mArguments[i] = UInt64(inArgument);
+							}
+						}
+
+	template <typename T>
+	static void			StoreOne(Record &ioRecord, T *inArgument)
+						{
+							UInt8 i = ioRecord.mNumArguments++;
+							ioRecord.mTypes[i] = 'p';
+							ioRecord.mArguments[i] = UInt64(uintptr_t(inArgument));
+						}
+};
+
+#define	DebugPrintfRT(inFormat, ...)	CARealtimeDebugPrintf::Log(inFormat, ## __VA_ARGS__)
+
+#endif
@@ -47,9 +47,9 @@ public:
 	TThreadSafeList() { }
 	~TThreadSafeList()
 	{
-		mActiveList.free_all();
-		mPendingList.free_all();
-		mFreeList.free_all();
+		FreeAll(mActiveList);
+		FreeAll(mPendingList);
+		FreeAll(mFreeList);
 	}
 	
 	// These may be called on any thread
@@ -83,24 +83,16 @@ public:
 	
 	void	update()		// must only be called from one thread
 	{
-		NodeStack reversed;
 		Node *event, *node, *next;
-		bool workDone = false;
 		
-		// reverse the events so they are in order
-		event = mPendingList.pop_all();
-		while (event != NULL) {
-			next = event->mNext;
-			reversed.push_NA(event);
-			event = next;
-			workDone = true;
-		}
-		if (workDone) {
-			//reversed.dump("pending popped");
+		// take all the events at once, in the order they were made
+		Node *events = mPendingList.pop_all_reversed();
+		if (events != NULL) {
 			//mActiveList.dump("active before update");
 			
 			// now process them
-			while ((event = reversed.pop_NA()) != NULL) {
+			while ((event = events) != NULL) {
+				events = event->mNext;
 				switch (event->mEventType) {
 				case kAdd:
 					{
@@ -177,19 +169,26 @@ private:
 private:
 	class NodeStack : public TAtomicStack<Node> {
 	public:
-		void free_all() {
-			Node *node;
-			while ((node = this->pop_NA()) != NULL)
-				free(node);
-		}
-		
 		Node **	phead() { return &this->mHead; }
 		Node *	head() const { return this->mHead; }
 	};
+	
+#if __cplusplus >= 201103L
+	typedef TAtomicTaggedStack<Node>	SharedNodeStack;
+#else
+	typedef NodeStack					SharedNodeStack;
+#endif
+
+	template <class S>
+	static void	FreeAll(S &stack) {
+		Node *node;
+		while ((node = stack.pop_NA()) != NULL)
+			free(node);
+	}
 
-	NodeStack	mActiveList;	// what's actually in the container - only accessed on one thread
-	NodeStack	mPendingList;	// add or remove requests - threadsafe
-	NodeStack	mFreeList;		// free nodes for reuse - threadsafe
+	NodeStack		mActiveList;	// what's actually in the container - only accessed on one thread
+	SharedNodeStack	mPendingList;	// add or remove requests - threadsafe
+	SharedNodeStack	mFreeList;		// free nodes for reuse - threadsafe
 };
 
 #endif // __CAThreadSafeList_h__
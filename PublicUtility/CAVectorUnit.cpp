@@ -8,7 +8,7 @@ Part of Core Audio Public Utility Classes
 
 #include "CAVectorUnit.h"
 
-#if !TARGET_OS_WIN32
+#if TARGET_OS_MAC
 	#include <sys/sysctl.h>
 #elif HAS_IPP
 	#include "ippdefs.h"
@@ -150,6 +150,19 @@ SInt32	CAVectorUnit_Examine()
 		result = kVecNeon;
 	#endif
 	}
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	// any other system on x86: ask the CPU
+	__builtin_cpu_init();
+	if (getenv("CA_NoVector") == NULL) {
+		if (__builtin_cpu_supports("avx"))
+			result = kVecAVX1;
+		else if (__builtin_cpu_supports("sse3"))
+			result = kVecSSE3;
+		else if (__builtin_cpu_supports("sse2"))
+			result = kVecSSE2;
+	}
+#elif CA_ARM_NEON
+	result = kVecNeon;
 #endif
 	gCAVectorUnitType = result;
 	return result;
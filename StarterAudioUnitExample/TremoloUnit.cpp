@@ -18,7 +18,8 @@ AUDIOCOMPONENT_ENTRY(AUBaseFactory, TremoloUnit)
 //	TremoloUnit::TremoloUnit
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // The constructor for new TremoloUnit audio units
-TremoloUnit::TremoloUnit (AudioUnit component) : AUEffectBase (component) {
+TremoloUnit::TremoloUnit (AudioUnit component)
+	: AUEffectBase (component), mPhase (0), mKernels (&CADSPKernels::Default ()) {
 
 	// This method, defined in the AUBase superclass, ensures that the required audio unit
 	//  elements are created and initialized.
@@ -51,6 +52,18 @@ TremoloUnit::TremoloUnit (AudioUnit component) : AUEffectBase (component) {
 	SetAFactoryPresetAsCurrent (
 		kPresets [kPreset_Default]
 	);
+
+	// By default, the nearest object sets the tremolo frequency and the mean closeness of 
+	//	the scan sets its depth, so the tremolo grows faster and deeper as things approach.
+	AULidarModulationMapping mappings [] = {
+		{kAudioUnitScope_Global, 0, kParameter_Frequency, kAULidarModulationMapping_Logarithmic, 0, 0, kAULidarModulation_Nearest, 0},
+		{kAudioUnitScope_Global, 0, kParameter_Depth, 0, 0, 0, kAULidarModulation_Mean, 0}
+	};
+	mModulator.SetMappings (*this, mappings, sizeof (mappings) / sizeof (mappings [0]));
+
+	// A session may hold many tremolos that never hear a sound, so the kernels and the gain
+	//	envelope wait for the first one; until then the input passes straight through.
+	SetDefersKernels (true);
         
 	#if AU_DEBUG_DISPATCHER
 		mDebugDispatcher = new AUDebugDispatcher (this);
@@ -58,6 +71,88 @@ TremoloUnit::TremoloUnit (AudioUnit component) : AUEffectBase (component) {
 }
 
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Initialize
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Picks the DSP kernels for this CPU and opens the LiDAR modulation bus. Without a scanner
+//	running nothing is ever published on the bus, and the parameters behave as usual. The
+//	gain envelope is sized by PrepareKernels, along with the kernels.
+ComponentResult TremoloUnit::Initialize () {
+
+	ComponentResult result = AUEffectBase::Initialize ();
+	if (result == noErr) {
+		mKernels = &CADSPKernels::ForVectorUnit (GetVectorUnitType ());
+		WaveTable (kDefaultValue_Tremolo_Waveform);	// builds the shared wave tables, if no instance has yet
+		mModulator.Open ();
+	}
+	return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::PrepareKernels
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Runs on the helper thread when the first sound arrives: the kernels, and the gain envelope
+//	they share, sized for the maximum frames per slice.
+void TremoloUnit::PrepareKernels () {
+
+	AUEffectBase::PrepareKernels ();
+	mGainEnvelope.assign (GetMaxFramesPerSlice (), 0.f);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Cleanup
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloUnit::Cleanup () {
+
+	mModulator.Close ();
+	AUEffectBase::Cleanup ();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Render
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Writes the latest scan's features into the mapped parameters, if a new scan has arrived,
+//	and then renders as usual.
+OSStatus TremoloUnit::Render (
+	AudioUnitRenderActionFlags	&ioActionFlags,
+	const AudioTimeStamp		&inTimeStamp,
+	UInt32						inFramesToProcess
+) {
+	mModulator.Apply (*this);
+	return AUEffectBase::Render (ioActionFlags, inTimeStamp, inFramesToProcess);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::ProcessBufferLists
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Called once per render, or once per slice when the host schedules parameter changes within
+//	a buffer, so the envelope always starts at the first frame the kernels are about to process
+//	and reflects the parameters for that slice.
+OSStatus TremoloUnit::ProcessBufferLists (
+	AudioUnitRenderActionFlags	&ioActionFlags,
+	const AudioBufferList		&inBuffer,
+	AudioBufferList				&outBuffer,
+	UInt32						inFramesToProcess
+) {
+	if (inFramesToProcess > mGainEnvelope.size ())
+		return kAudioUnitErr_TooManyFramesToProcess;
+
+	GenerateGainEnvelope (inFramesToProcess);
+	return AUEffectBase::ProcessBufferLists (ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Reset
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ComponentResult TremoloUnit::Reset (
+	AudioUnitScope			inScope,
+	AudioUnitElement		inElement
+) {
+	mPhase = 0;
+	return AUEffectBase::Reset (inScope, inElement);
+}
+
+
 #pragma mark ____Parameters
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -183,14 +278,15 @@ ComponentResult TremoloUnit::GetParameterValueStrings (
 //	TremoloUnit::GetPropertyInfo
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 ComponentResult TremoloUnit::GetPropertyInfo (
-	// This audio unit doesn't define any custom properties, so it uses this generic code for
-	// this method.
+	// The only custom property is the LiDAR modulation mapping, which the modulator handles.
 	AudioUnitPropertyID	inID,
 	AudioUnitScope		inScope,
 	AudioUnitElement	inElement,
 	UInt32				&outDataSize,
 	Boolean				&outWritable
 ) {
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LidarModulationMappings)
+		return mModulator.GetPropertyInfo (outDataSize, outWritable);
 	return AUEffectBase::GetPropertyInfo (inID, inScope, inElement, outDataSize, outWritable);
 }
 
@@ -198,16 +294,31 @@ ComponentResult TremoloUnit::GetPropertyInfo (
 //	TremoloUnit::GetProperty
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 ComponentResult TremoloUnit::GetProperty (
-	// This audio unit doesn't define any custom properties, so it uses this generic code for
-	// this method.
 	AudioUnitPropertyID inID,
 	AudioUnitScope 		inScope,
 	AudioUnitElement 	inElement,
 	void				*outData
 ) {
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LidarModulationMappings)
+		return mModulator.GetProperty (outData);
 	return AUEffectBase::GetProperty (inID, inScope, inElement, outData);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::SetProperty
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ComponentResult TremoloUnit::SetProperty (
+	AudioUnitPropertyID inID,
+	AudioUnitScope 		inScope,
+	AudioUnitElement 	inElement,
+	const void			*inData,
+	UInt32				inDataSize
+) {
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitCustomProperty_LidarModulationMappings)
+		return mModulator.SetProperty (*this, inData, inDataSize);
+	return AUEffectBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
+}
+
 #pragma mark ____Factory Presets
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -323,216 +434,140 @@ OSStatus TremoloUnit::NewFactoryPresetSet (
 
 
 
-#pragma mark ____TremoloUnitEffectKernel
+#pragma mark ____Tremolo Envelope
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	TremoloUnit::TremoloUnitKernel::TremoloUnitKernel()
-//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This is the constructor for the TremoloUnitKernel helper class, which holds the DSP code 
-//  for the audio unit. TremoloUnit is an n-to-n audio unit; one kernel object gets built for 
-//  each channel in the audio unit.
-//
-// The first line of the method consists of the constructor method declarator and constructor-
-//  initializer. In addition to calling the appropriate superclasses, this code initializes two 
-//  member variables:
-//
-// mCurrentScale:		a factor for correlating points in the current wave table to
-//						the audio signal sampling frequency. to produce the desired
-//						tremolo frequency
-// mSamplesProcessed:	a global count of samples processed. it allows the tremolo effect
-//						to be continuous over data input buffer boundaries
-//
-// (In the Xcode template, the header file contains the call to the superclass constructor.)
-TremoloUnit::TremoloUnitKernel::TremoloUnitKernel (AUEffectBase *inAudioUnit ) : AUKernelBase (inAudioUnit),
-	mSamplesProcessed (0), mCurrentScale (0)
-{	
-	// Generates a wave table that represents one cycle of a sine wave, normalized so that
-	//  it never goes negative and so it ranges between 0 and 1; this sine wave specifies 
-	//  how to vary the volume during one cycle of tremolo.
-	for (int i = 0; i < kWaveArraySize; ++i) {
-		double radians = i * 2.0 * M_PI / kWaveArraySize;
-		mSine [i] = (sin (radians) + 1.0) * 0.5;
-	}
+//	TremoloUnit::WaveTable()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The wave tables depend on nothing but their size, so all TremoloUnit instances share one
+//  copy, built on first use. (sin() isn't constexpr, so they can't be built by the compiler.)
+//  Initialize asks for them, so the one-time cost never lands on the render thread.
+const float *TremoloUnit::WaveTable (int inWaveform) {
+
+	struct Tables {
+		float	mSine [kWaveArraySize];		// The wave table for the tremolo sine wave.
+		float	mSquare [kWaveArraySize];	// The wave table for the tremolo square wave.
+
+		Tables () {
+			// Generates a wave table that represents one cycle of a sine wave, normalized so that
+			//  it never goes negative and so it ranges between 0 and 1; this sine wave specifies 
+			//  how to vary the volume during one cycle of tremolo.
+			for (int i = 0; i < kWaveArraySize; ++i) {
+				double radians = i * 2.0 * M_PI / kWaveArraySize;
+				mSine [i] = (sin (radians) + 1.0) * 0.5;
+			}
 
-	// Does the same for a pseudo square wave, with nice rounded corners to avoid pops.
-	for (int i = 0; i < kWaveArraySize; ++i) {
-		double radians = i * 2.0 * M_PI / kWaveArraySize;
-		radians = radians + 0.32; // shift the wave over for a smoother start
-		mSquare [i] =
-			(
-				sin (radians) +	// Sums the odd harmonics, scaled for a nice final waveform
-				0.3 * sin (3 * radians) +
-				0.15 * sin (5 * radians) +
-				0.075 * sin (7 * radians) +
-				0.0375 * sin (9 * radians) +
-				0.01875 * sin (11 * radians) +
-				0.009375 * sin (13 * radians) +
-				0.8			// Shifts the value so it doesn't go negative.
-			) * 0.63;		// Scales the waveform so the peak value is close 
-							//  to unity gain.
-	}
+			// Does the same for a pseudo square wave, with nice rounded corners to avoid pops.
+			for (int i = 0; i < kWaveArraySize; ++i) {
+				double radians = i * 2.0 * M_PI / kWaveArraySize;
+				radians = radians + 0.32; // shift the wave over for a smoother start
+				mSquare [i] =
+					(
+						sin (radians) +	// Sums the odd harmonics, scaled for a nice final waveform
+						0.3 * sin (3 * radians) +
+						0.15 * sin (5 * radians) +
+						0.075 * sin (7 * radians) +
+						0.0375 * sin (9 * radians) +
+						0.01875 * sin (11 * radians) +
+						0.009375 * sin (13 * radians) +
+						0.8			// Shifts the value so it doesn't go negative.
+					) * 0.63;		// Scales the waveform so the peak value is close 
+									//  to unity gain.
+			}
+		}
+	};
 
-	// Gets the samples per second of the audio stream provided to the audio unit. 
-	// Obtaining this value here in the constructor assumes that the sample rate
-	// will not change during one instantiation of the audio unit.
-	mSampleFrequency = GetSampleRate ();
+	static const Tables sTables;
+	return (inWaveform == kSineWave_Tremolo_Waveform) ? sTables.mSine : sTables.mSquare;
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	TremoloUnit::TremoloUnitKernel::Reset()
+//	TremoloUnit::GenerateGainEnvelope
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// Because we're calculating each output sample based on a unique input sample, there's no 
-// need to clear any buffers. We simply reinitialize the variables that were initialized on
-// instantiation of the kernel object.
-void TremoloUnit::TremoloUnitKernel::Reset() {
-	mCurrentScale		= 0;
-	mSamplesProcessed	= 0;
+// Reads and checks the parameters once for the slice, then computes the gain of every sample
+//	frame in one loop.
+void TremoloUnit::GenerateGainEnvelope (UInt32 inFramesToProcess) {
+
+	Float32	tremoloFrequency,		// The tremolo frequency requested by the user via the audio unit's view.
+			tremoloDepth;			// The tremolo depth requested by the user via the audio unit's view.
+			
+	int		tremoloWaveform;		// The tremolo waveform type requested by the user via the audio unit's view.
+
+	
+	// Once per slice, gets the tremolo frequency (in Hz) from the user 
+	//	via the audio unit view.
+	tremoloFrequency = GetParameter (kParameter_Frequency);
+	
+	// Once per slice, gets the depth (in percent) from the user via 
+	//	the audio unit view.
+	tremoloDepth = GetParameter (kParameter_Depth);
+
+	// Once per slice, gets the tremolo waveform type from the user via 
+	//	the audio unit view.
+	tremoloWaveform =  (int) GetParameter (kParameter_Waveform);
+	
+	// Assigns a pointer to the wave table for the user-selected tremolo wave form.
+	const float *waveTable = WaveTable (tremoloWaveform);
+	
+	// Performs bounds checking on the parameters.
+	if (tremoloFrequency	< kMinimumValue_Tremolo_Freq)
+		tremoloFrequency	= kMinimumValue_Tremolo_Freq;
+	if (tremoloFrequency	> kMaximumValue_Tremolo_Freq)
+		tremoloFrequency	= kMaximumValue_Tremolo_Freq;
+
+	if (tremoloDepth		< kMinimumValue_Tremolo_Depth)
+		tremoloDepth		= kMinimumValue_Tremolo_Depth;
+	if (tremoloDepth		> kMaximumValue_Tremolo_Depth)
+		tremoloDepth		= kMaximumValue_Tremolo_Depth;
+	
+	// Calculates how far the phase advances per audio sample: the fraction of a tremolo
+	//  cycle that one sample spans, scaled so that a whole cycle is 2^32.
+	//
+	//	Say that the audio sample frequency is 10 kHz and that the tremolo frequency is 
+	//	10.0 Hz. One cycle then spans 1,000 samples, and each sample advances the phase
+	//	by 2^32 / 1,000. Since the index into the wave table is the top kWaveArrayBits
+	//	bits of the phase, that steps through the table about 2 points per sample.
+	const UInt32 phaseIncrement = (UInt32) (tremoloFrequency / GetSampleRate () * 4294967296.0);
+
+	// The tremolo gain for a raw wave table value w is (w * depth - depth + 100) / 100,
+	//  which is w * gainScale + gainOffset.
+	const Float32 gainScale = tremoloDepth * 0.01;
+	const Float32 gainOffset = 1.0 - gainScale;
+
+	Float32 *gain = &mGainEnvelope [0];
+	
+	// Reads the wave table, interpolating between its points, and advances the phase past the
+	//	frames just generated, ready for the next slice; then turns the wave into gain, in place.
+	mPhase = mKernels -> TableLookup (waveTable, kWaveArrayBits, mPhase, phaseIncrement, gain, inFramesToProcess);
+	mKernels -> ScaleOffset (gain, gainScale, gainOffset, gain, inFramesToProcess);
 }
 
+
+#pragma mark ____TremoloUnitEffectKernel
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	TremoloUnit::TremoloUnitKernel::Process
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This method contains the DSP code. 
+// This method contains the DSP code. TremoloUnit is an n-to-n audio unit; one kernel object
+//	gets built for each channel in the audio unit, and each one applies the gain envelope 
+//	that TremoloUnit::ProcessBufferLists generated for the slice to its channel.
 void TremoloUnit::TremoloUnitKernel::Process (
 	const Float32 	*inSourceP,			// The audio sample input buffer.
 	Float32		 	*inDestP,			// The audio sample output buffer.
 	UInt32 			inSamplesToProcess,	// The number of samples in the input buffer.
-	UInt32			inNumChannels,		// The number of input channels. This is always equal to 1 
-										//   because there is always one kernel object instantiated
-										//   per channel of audio.
+	UInt32			inNumChannels,		// The distance between consecutive samples of this channel:
+										//   1 for non-interleaved audio, or the number of
+										//   interleaved channels.
 	bool			&ioSilence			// A Boolean flag indicating whether the input to the audio 
 										//   unit consists of silence, with a TRUE value indicating 
 										//   silence.
 ) {
 	// Ignores the request to perform the Process method if the input to the audio unit is silence.
-	if (!ioSilence) {
-
-		// Assigns a pointer variable to the start of the audio sample input buffer.
-		const Float32 *sourceP = inSourceP;
-
-		// Assigns a pointer variable to the start of the audio sample output buffer.
-		Float32	*destP = inDestP,
-				inputSample,			// The current audio sample to process.
-				outputSample,			// The current audio output sample resulting from one iteration of the
-										//   processing loop.
-				tremoloFrequency,		// The tremolo frequency requested by the user via the audio unit's view.
-				tremoloDepth,			// The tremolo depth requested by the user via the audio unit's view.
-				samplesPerTremoloCycle,	// The number of audio samples in one cycle of the tremolo waveform.
-				rawTremoloGain,			// The tremolo gain for the current audio sample, as stored in the wave table.
-				tremoloGain;			// The adjusted tremolo gain for the current audio sample, considering the 
-										//   Depth parameter.
-				
-		int		tremoloWaveform;		// The tremolo waveform type requested by the user via the audio unit's view.
+	if (ioSilence)
+		return;
 
-		
-		// Once per input buffer, gets the tremolo frequency (in Hz) from the user 
-		//	via the audio unit view.
-		tremoloFrequency = GetParameter (kParameter_Frequency);
-		
-		// Once per input buffer, gets the depth (in percent) from the user via 
-		//	the audio unit view.
-		tremoloDepth = GetParameter (kParameter_Depth);
-
-		// Once per input buffer, gets the tremolo waveform type from the user via 
-		//	the audio unit view.
-		tremoloWaveform =  (int) GetParameter (kParameter_Waveform);
-		
-		// Assigns a pointer to the wave table for the user-selected tremolo wave form.
-		if (tremoloWaveform == kSineWave_Tremolo_Waveform)  {
-			waveArrayPointer = &mSine [0];
-		} else {
-			waveArrayPointer = &mSquare [0];
-		}
-		
-		// Performs bounds checking on the parameters.
-		if (tremoloFrequency	< kMinimumValue_Tremolo_Freq)
-			tremoloFrequency	= kMinimumValue_Tremolo_Freq;
-		if (tremoloFrequency	> kMaximumValue_Tremolo_Freq)
-			tremoloFrequency	= kMaximumValue_Tremolo_Freq;
-
-		if (tremoloDepth		< kMinimumValue_Tremolo_Depth)
-			tremoloDepth		= kMinimumValue_Tremolo_Depth;
-		if (tremoloDepth		> kMaximumValue_Tremolo_Depth)
-			tremoloDepth		= kMaximumValue_Tremolo_Depth;
-		
-		// Calculates the number of audio samples per cycle of tremolo frequency.
-		samplesPerTremoloCycle	= mSampleFrequency / tremoloFrequency;
-		
-		// Calculates the scaling factor to use for applying the wave table to the current sampling 
-		//  frequency and tremolo frequency.
-		mNextScale				= kWaveArraySize / samplesPerTremoloCycle;
-		/*
-			An explanation of the scaling factor (mNextScale)
-			-------------------------------------------------
-			Say that the audio sample frequency is 10 kHz and that the tremolo frequency is 
-			10.0 Hz. the number of audio samples per tremolo cycle is then 1,000.
-			
-			For a wave table of length 1,000, the scaling factor is then unity (1.0). This means 
-			that the wave table happens to be the exact size needed for each point in the table 
-			to correspond to exactly one sample.
-
-			If the tremolo frequency slows to 1.0 Hz, then the number of samples per tremolo 
-			cycle rises to 10,000. The scaling factor is then 0.1. This means that every 10th 
-			element of the wave table array corresponds to a sample.
-			
-			If the tremolo frequency increases to 20 Hz, the samples per tremolo cycle lowers to
-			500. The scaling factor is then 1,000/500 = 2.0. In this case, two samples in a row 
-			need to make use of the same point in the wave table.
-		*/
-			
-		// The sample processing loop: processes the current batch of samples, one sample at a time.
-		for (int i = inSamplesToProcess; i > 0; --i) {
-		
-			// The following statement calculates the position in the wave table ("index") to 
-			// use for the current sample. This position, along with the calculation of 
-			// mNextScale, is the only subtle math for this audio unit.
-			//
-			// "index" is the position marker in the wave table. The wave table is an array; 
-			//		index varies from 0 to kWaveArraySize.
-			//
-			//	"index" is also the number of samples processed since the last 
-			//	counter reset, divided by the number of samples that play during one pass 
-			//	through the wave table, modulo the size of the wave table (see "An explanation...",
-			//  above).
-			int index = static_cast<long>(mSamplesProcessed * mCurrentScale) % kWaveArraySize;
-
-			// If the user has moved the tremolo frequency slider, changes the scale factor
-			// at the next positive zero crossing of the tremolo sine wave and resets the 
-			// mSamplesProcessed value so it stays in sync with the index position.
-			if ((mNextScale != mCurrentScale) && (index == 0)) {
-				mCurrentScale = mNextScale;
-				mSamplesProcessed = 0;
-			}
-
-			// If the audio unit runs for a long time without the user moving the
-			// tremolo frequency slider, resets the mSamplesProcessed value at the 
-			// next positive zero crossing of the tremolo sine wave.
-			if ((mSamplesProcessed >= sampleLimit) && (index == 0))
-				mSamplesProcessed = 0;
-
-			// Gets the raw tremolo gain from the appropriate wave table.
-			rawTremoloGain = waveArrayPointer [index];
-
-			// Calculates the final tremolo gain according to the depth setting.
-			tremoloGain			= (rawTremoloGain * tremoloDepth - tremoloDepth + 100.0) * 0.01;
-			
-			// Gets the next input sample.
-			inputSample			= *sourceP;
-			
-			// Calculates the next output sample.
-			outputSample		= (inputSample * tremoloGain);
-			
-			// Stores the output sample in the output buffer.
-			*destP				= outputSample;
-			
-			// Advances to the next sample location in the input and output buffers.
-			sourceP				+= 1;
-			destP				+= 1;
-			
-			// Increments the global samples counter.
-			mSamplesProcessed	+= 1;
-		}
-	}
+	const TremoloUnit *unit = static_cast<TremoloUnit *> (mAudioUnit);
+	unit -> mKernels -> Multiply (
+		inSourceP, inNumChannels, &unit -> mGainEnvelope [0], 1, inDestP, inNumChannels, inSamplesToProcess
+	);
 }
-
-
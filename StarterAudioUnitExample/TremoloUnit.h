@@ -8,6 +8,8 @@ Tremolo Effect AU
 
 #include "AUEffectBase.h"
 #include "TremoloUnitVersion.h"
+#include "AULidarModulation.h"
+#include "CADSPKernels.h"
 
 #if AU_DEBUG_DISPATCHER
 	#include "AUDebugDispatcher.h"
@@ -112,6 +114,35 @@ public:
 #endif
 	
 	virtual AUKernelBase *NewKernel () {return new TremoloUnitKernel(this);}
+
+	// Opens and closes the LiDAR modulation bus along with the audio unit's resources.
+	virtual ComponentResult Initialize ();
+	virtual void Cleanup ();
+
+	// Sizes the gain envelope along with the kernels, once there is sound to process.
+	virtual void PrepareKernels ();
+
+	// Applies the LiDAR modulation to the parameters before the kernels read them.
+	virtual OSStatus Render (
+		AudioUnitRenderActionFlags	&ioActionFlags,
+		const AudioTimeStamp		&inTimeStamp,
+		UInt32						inFramesToProcess
+	);
+
+	// Generates the tremolo gain envelope for the slice once, then has the kernels apply it
+	//	to their channels.
+	virtual OSStatus ProcessBufferLists (
+		AudioUnitRenderActionFlags	&ioActionFlags,
+		const AudioBufferList		&inBuffer,
+		AudioBufferList				&outBuffer,
+		UInt32						inFramesToProcess
+	);
+
+	// Restarts the tremolo cycle, as well as resetting the kernels.
+	virtual ComponentResult Reset (
+		AudioUnitScope			inScope,
+		AudioUnitElement		inElement
+	);
 	
 	virtual	ComponentResult GetParameterValueStrings (
 		AudioUnitScope			inScope,
@@ -139,6 +170,14 @@ public:
 		AudioUnitElement		inElement,
 		void					*outData
 	);
+
+	virtual ComponentResult SetProperty (
+		AudioUnitPropertyID		inID,
+		AudioUnitScope			inScope,
+		AudioUnitElement		inElement,
+		const void				*inData,
+		UInt32					inDataSize
+	);
 	
  	// report that the audio unit supports the 
 	//	kAudioUnitProperty_TailTime property
@@ -163,7 +202,7 @@ public:
 protected:
 	class TremoloUnitKernel : public AUKernelBase {
 		public:
-			TremoloUnitKernel (AUEffectBase *inAudioUnit);
+			TremoloUnitKernel (AUEffectBase *inAudioUnit) : AUKernelBase (inAudioUnit) {}
 			
 			// *Required* overides for the process method for this effect
 			// processes one channel of interleaved samples
@@ -171,34 +210,39 @@ protected:
 				const Float32 	*inSourceP,
 				Float32		 	*inDestP,
 				UInt32 			inFramesToProcess,
-				UInt32			inNumChannels, // equal to 1
+				UInt32			inNumChannels, // the sample stride; 1 for non-interleaved audio
 				bool			&ioSilence
 		);
-		
-        virtual void Reset ();
-		
-		private:
-			enum	{kWaveArraySize = 2000};	// The number of points in the wave table.
-			float	mSine [kWaveArraySize];		// The wave table for the tremolo sine wave.
-			float	mSquare [kWaveArraySize];	// The wave table for the tremolo square wave.
-			float	*waveArrayPointer;			// Points to the wave table to use for the current audio input buffer.
-			Float32 mSampleFrequency;			// The "sample rate" of the audio signal being processed
-			long	mSamplesProcessed;			// The number of samples processed since the audio unit
-												//   started rendering or since this variable was last
-												//   reset to 0. We have to keep track of this because
-												//   we vary the tremolo continuously and independently
-												//   of the input buffer size.
-			enum	{sampleLimit = (int) 10E6};	// To keep the value of mSamplesProcessed within a 
-												//   reasonable limit. 10E6 is equivalent to the number   
-												//   of samples in 100 seconds of 96 kHz audio.
-			float	mCurrentScale;				// There are two scaling factors to allow the audio unit
-												//   to switch to a new scaling factor at the beginning
-												//   of the tremolo waveform, no matter when the user
-												//   changes the tremolo frequency. mCurrentScale is 
-												//   the scaling factor in use.
-			float	mNextScale;					// The scaling factor that the user most recently requested
-												//   by moving the tremolo frequency slider
 	};
+
+private:
+	// Returns the shared wave table for kSineWave_Tremolo_Waveform or kSquareWave_Tremolo_Waveform.
+	//   The tables are built the first time an instance asks for them.
+	static const float *WaveTable (int inWaveform);
+
+	// Fills mGainEnvelope [0 .. inFramesToProcess) with the tremolo gain for each sample 
+	//   frame, advancing mPhase past them.
+	void GenerateGainEnvelope (UInt32 inFramesToProcess);
+
+	enum	{kWaveArrayBits = 11};		// The wave tables hold 2^kWaveArrayBits points, a power
+										//   of two so the top bits of the phase index them directly
+										//   and the ones below interpolate between the points.
+	enum	{kWaveArraySize = 1 << kWaveArrayBits};
+
+	UInt32	mPhase;						// The position in the tremolo cycle, with one full cycle 
+										//   spanning the whole 2^32 range so the phase wraps by
+										//   itself. A change of tremolo frequency only changes how
+										//   fast the phase advances, so the gain never jumps and
+										//   the new frequency takes effect right away.
+	std::vector<Float32> mGainEnvelope;	// The gain for each sample frame of the slice being 
+										//   processed. Every channel gets the same tremolo, so it is
+										//   computed once and each kernel just multiplies by it.
+										//   Sized for the maximum frames per slice in PrepareKernels.
+
+	AULidarModulator	mModulator;		// Maps the LiDAR scan features to the parameters.
+
+	const CADSPKernels	*mKernels;		// The envelope and gain loops for this CPU's vector unit,
+										//   picked in Initialize.
 };
 
 #endif